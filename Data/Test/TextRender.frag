@@ -1,8 +1,9 @@
 #version 430
 layout (location = 0) in vec2 inCoord;
+layout (location = 1) in vec4 inColor;
 layout (location = 0) out vec4 outFragColor;
-uniform sampler2D fontTex;
+layout (binding = 1) uniform sampler2D fontTex;
 void main()
 {
-  outFragColor = texture(fontTex, inCoord);
+  outFragColor = vec4(inColor.rgb, inColor.a * texture(fontTex, inCoord).a);
 }
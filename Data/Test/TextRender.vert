@@ -1,13 +1,24 @@
 #version 430
-layout (location = 0) in vec3 inPos;
-layout (location = 1) in vec2 inCoord;
+// one glyph quad per instance, corners from the vertex index (triangle strip)
+layout (location = 0) in vec4 inRect;
+layout (location = 1) in vec4 inUV;
+layout (location = 2) in vec4 inColor;
 layout (location = 0) out vec2 outCoord;
+layout (location = 1) out vec4 outColor;
+// FontRenderer::Viewport, written every frame
+layout (binding = 0) uniform Viewport
+{
+  vec2 invSize;
+} viewport;
 out gl_PerVertex 
 {
     vec4 gl_Position;   
 };
 void main() 
 {
-	outCoord = inCoord;
-	gl_Position = vec4(inPos, 1.0);
-}
\ No newline at end of file
+	vec2 corner = vec2(gl_VertexIndex & 1, gl_VertexIndex >> 1);
+	vec2 pixel = inRect.xy + corner * inRect.zw;
+	outCoord = mix(inUV.xy, inUV.zw, corner);
+	outColor = inColor;
+	gl_Position = vec4(pixel * viewport.invSize * 2.0 - 1.0, 0.0, 1.0);
+}
@@ -0,0 +1,31 @@
+#version 430
+layout (location = 0) in vec2 inCoord;
+layout (location = 1) in vec4 inColor;
+layout (location = 0) out vec4 outFragColor;
+layout (binding = 1) uniform sampler2D fontTex;
+// DistanceFieldFont::ShaderParams
+layout (binding = 2) uniform Field
+{
+  // texels between the values 0 and 1, 2 * DistanceFieldFont::Options::Range
+  float distanceSpan;
+  // 1 for SDF, the value is in alpha, 4 for MSDF
+  uint channels;
+} field;
+
+float median(float r, float g, float b)
+{
+  return max(min(r, g), min(max(r, g), b));
+}
+
+void main()
+{
+  // field texels per screen pixel, from the derivatives of the coordinates
+  vec2 unitRange = vec2(field.distanceSpan) / vec2(textureSize(fontTex, 0));
+  vec2 screenTexSize = vec2(1.0) / fwidth(inCoord);
+  float screenPxRange = max(0.5 * dot(unitRange, screenTexSize), 1.0);
+  vec4 texel = texture(fontTex, inCoord);
+  float value = field.channels == 1u ? texel.a : median(texel.r, texel.g, texel.b);
+  float distance = value - 0.5;
+  float coverage = clamp(distance * screenPxRange + 0.5, 0.0, 1.0);
+  outFragColor = vec4(inColor.rgb, inColor.a * coverage);
+}
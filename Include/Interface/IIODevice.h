@@ -10,7 +10,9 @@
 enum IOFlag
 {
   IORead=1,
-  IOWrite
+  IOWrite,
+  /// with IORead or IOWrite, bypass the page cache where the device supports it
+  IODirect=4
 };
 
 struct K3D_API IIODevice
@@ -10,7 +10,13 @@ enum class VtxFormat : uint32
 	POS3_F32_NOR3_F32_UV2_F32,
 	POS3_F32_NOR3_F32_UV2X2_F32,
 	POS3_F32_NOR3_F32_UV2X3_F32,
-	PER_INSTANCE // all components are seperated
+	PER_INSTANCE, // all components are seperated
+	// quantized: positions are 16 bit unorm within the mesh bounding box,
+	// normals octahedral snorm8, uvs half floats, see VertexCodec
+	POS3_U16,
+	POS3_U16_UV2_F16,
+	POS3_U16_NOR_OCT8,
+	POS3_U16_NOR_OCT8_UV2_F16
 };
 
 enum class PrimType : uint32 
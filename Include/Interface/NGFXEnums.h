@@ -117,6 +117,7 @@ enum NGFXBlendFactor
   NGFX_BLEND_FACTOR_DEST_COLOR,
   NGFX_BLEND_FACTOR_SRC_ALPHA,
   NGFX_BLEND_FACTOR_DEST_ALPHA,
+  NGFX_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
   NGFX_BLEND_FACTOR_NUM
 };
 
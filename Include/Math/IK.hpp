@@ -1,36 +1,466 @@
 /***********************************************
  *  Kaleido3D Math Library (Inverse Kinematics Solver)
- *  Implements Jacobian, CCD and FABRIK
+ *  Implements CCD and FABRIK
  *  Author  : Qin Zhou
  *  Date    : 2017/2/18
  *  Email   : dsotsen@gmail.com
  ***********************************************/
+#pragma once
+#ifndef __IK_hpp__
+#define __IK_hpp__
+
 #include "kMath.hpp"
+#include "kGeometry.hpp"
+#include <vector>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define K3D_IK_SSE 1
+#include <xmmintrin.h>
+#endif
 
 NS_MATHLIB_BEGIN
 
-class Joint
+/// joints of a chain, including the end effector
+const uint32 kMaxIKJoints = 32;
+
+/// \brief a joint of a chain in model space. Chains are solved on positions,
+/// the bone of a joint runs to the next one and keeps its length.
+struct Joint
+{
+    Vec3f   Position;
+    /// largest angle in radians between the bone of this joint and the bone
+    /// before it, Pi or more is free; unused at the root
+    float   MaxBend;
+
+    Joint() : MaxBend(3.14159265f) {}
+    Joint(Vec3f const& position, float maxBend = 3.14159265f) : Position(position), MaxBend(maxBend) {}
+};
+
+/// \brief chains of the same number of joints and their targets, 4 chains
+/// per group as structure of arrays, which the solvers run on at once.
+/// Padding chains have zero length bones and are never iterated.
+class IKBatch
 {
+public:
+    IKBatch() : m_NumChains(0), m_NumJoints(0) {}
+
+    void Resize(uint32 numChains, uint32 numJoints)
+    {
+        assert(numJoints >= 2 && numJoints <= kMaxIKJoints);
+        m_NumChains = numChains;
+        m_NumJoints = numJoints;
+        uint32 groups = (numChains + 3) / 4;
+        m_Positions.assign(groups * numJoints * 12, 0.0f);
+        m_MaxBend.assign(groups * numJoints * 4, 3.14159265f);
+        m_Targets.assign(groups * 12, 0.0f);
+        m_Iterations.assign(groups * 4, 0);
+        m_Distance.assign(groups * 4, 0.0f);
+    }
+
+    uint32 GetNumChains() const { return m_NumChains; }
+    uint32 GetNumJoints() const { return m_NumJoints; }
+    uint32 GetNumGroups() const { return (m_NumChains + 3) / 4; }
+
+    void SetChain(uint32 chain, const Joint * joints, Vec3f const& target)
+    {
+        uint32 group = chain / 4, lane = chain % 4;
+        for (uint32 j = 0; j < m_NumJoints; j++)
+        {
+            float * p = Positions(group, j);
+            p[lane] = joints[j].Position.x;
+            p[4 + lane] = joints[j].Position.y;
+            p[8 + lane] = joints[j].Position.z;
+            MaxBend(group, j)[lane] = joints[j].MaxBend;
+        }
+        float * t = Target(group);
+        t[lane] = target.x;
+        t[4 + lane] = target.y;
+        t[8 + lane] = target.z;
+    }
+
+    void GetChain(uint32 chain, Joint * joints) const
+    {
+        uint32 group = chain / 4, lane = chain % 4;
+        for (uint32 j = 0; j < m_NumJoints; j++)
+        {
+            const float * p = Positions(group, j);
+            joints[j].Position = Vec3f(p[lane], p[4 + lane], p[8 + lane]);
+            joints[j].MaxBend = MaxBend(group, j)[lane];
+        }
+    }
+
+    /// of the last solve
+    uint32 GetIterations(uint32 chain) const { return m_Iterations[chain]; }
+    /// from the end effector to the target, after the last solve
+    float GetDistance(uint32 chain) const { return m_Distance[chain]; }
+
+    /// x, y and z of 4 chains
+    float * Positions(uint32 group, uint32 joint) { return &m_Positions[(group * m_NumJoints + joint) * 12]; }
+    const float * Positions(uint32 group, uint32 joint) const { return &m_Positions[(group * m_NumJoints + joint) * 12]; }
+    float * MaxBend(uint32 group, uint32 joint) { return &m_MaxBend[(group * m_NumJoints + joint) * 4]; }
+    const float * MaxBend(uint32 group, uint32 joint) const { return &m_MaxBend[(group * m_NumJoints + joint) * 4]; }
+    float * Target(uint32 group) { return &m_Targets[group * 12]; }
+    const float * Target(uint32 group) const { return &m_Targets[group * 12]; }
+    uint32 * Iterations(uint32 group) { return &m_Iterations[group * 4]; }
+    float * Distance(uint32 group) { return &m_Distance[group * 4]; }
+
 private:
-    tMatrixNxN<float, 4>    m_LocalMatrix;
-    tMatrixNxN<float, 4>    m_WorldMatrix;
-    tVectorN<float, 3>      m_Direction;
-    tVectorN<float, 3>      m_Dof;
+    uint32              m_NumChains;
+    uint32              m_NumJoints;
+    std::vector<float>  m_Positions;
+    std::vector<float>  m_MaxBend;
+    std::vector<float>  m_Targets;
+    std::vector<uint32> m_Iterations;
+    std::vector<float>  m_Distance;
 };
 
+namespace IKDetail
+{
+    /// one chain
+    struct Lane1
+    {
+        typedef float V;
+        typedef bool M;
+        enum { Width = 1 };
+
+        static KFORCE_INLINE V Set(float f) { return f; }
+        static KFORCE_INLINE V Load(const float * p) { return *p; }
+        static KFORCE_INLINE void Store(float * p, V v) { *p = v; }
+        static KFORCE_INLINE V Sqrt(V v) { return ::sqrtf(v); }
+        static KFORCE_INLINE V Max(V a, V b) { return a > b ? a : b; }
+        static KFORCE_INLINE V Abs(V v) { return ::fabsf(v); }
+        static KFORCE_INLINE V Select(M m, V a, V b) { return m ? a : b; }
+        static KFORCE_INLINE M Less(V a, V b) { return a < b; }
+        static KFORCE_INLINE M And(M a, M b) { return a && b; }
+        static KFORCE_INLINE bool Any(M m) { return m; }
+    };
+
+#if K3D_IK_SSE
+    struct Float4
+    {
+        __m128 v;
+        Float4() {}
+        Float4(__m128 x) : v(x) {}
+    };
+    KFORCE_INLINE Float4 operator + (Float4 a, Float4 b) { return _mm_add_ps(a.v, b.v); }
+    KFORCE_INLINE Float4 operator - (Float4 a, Float4 b) { return _mm_sub_ps(a.v, b.v); }
+    KFORCE_INLINE Float4 operator * (Float4 a, Float4 b) { return _mm_mul_ps(a.v, b.v); }
+    KFORCE_INLINE Float4 operator / (Float4 a, Float4 b) { return _mm_div_ps(a.v, b.v); }
+
+    /// 4 chains of a group
+    struct Lane4
+    {
+        typedef Float4 V;
+        typedef Float4 M;
+        enum { Width = 4 };
+
+        static KFORCE_INLINE V Set(float f) { return _mm_set1_ps(f); }
+        static KFORCE_INLINE V Load(const float * p) { return _mm_loadu_ps(p); }
+        static KFORCE_INLINE void Store(float * p, V v) { _mm_storeu_ps(p, v.v); }
+        static KFORCE_INLINE V Sqrt(V v) { return _mm_sqrt_ps(v.v); }
+        static KFORCE_INLINE V Max(V a, V b) { return _mm_max_ps(a.v, b.v); }
+        static KFORCE_INLINE V Abs(V v) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), v.v); }
+        static KFORCE_INLINE V Select(M m, V a, V b) { return _mm_or_ps(_mm_and_ps(m.v, a.v), _mm_andnot_ps(m.v, b.v)); }
+        static KFORCE_INLINE M Less(V a, V b) { return _mm_cmplt_ps(a.v, b.v); }
+        static KFORCE_INLINE M And(M a, M b) { return _mm_and_ps(a.v, b.v); }
+        static KFORCE_INLINE bool Any(M m) { return _mm_movemask_ps(m.v) != 0; }
+    };
+#endif
+
+    template <class L>
+    struct Vec3
+    {
+        typedef typename L::V V;
+        V x, y, z;
+
+        Vec3() {}
+        Vec3(V _x, V _y, V _z) : x(_x), y(_y), z(_z) {}
+
+        friend KFORCE_INLINE Vec3 operator + (Vec3 const& a, Vec3 const& b) { return Vec3(a.x + b.x, a.y + b.y, a.z + b.z); }
+        friend KFORCE_INLINE Vec3 operator - (Vec3 const& a, Vec3 const& b) { return Vec3(a.x - b.x, a.y - b.y, a.z - b.z); }
+        friend KFORCE_INLINE Vec3 operator * (Vec3 const& a, V s) { return Vec3(a.x * s, a.y * s, a.z * s); }
+        friend KFORCE_INLINE V Dot(Vec3 const& a, Vec3 const& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+        friend KFORCE_INLINE Vec3 Cross(Vec3 const& a, Vec3 const& b) { return Vec3(a.y * b.z - b.y * a.z, a.z * b.x - b.z * a.x, a.x * b.y - b.x * a.y); }
+        friend KFORCE_INLINE V Length(Vec3 const& a) { return L::Sqrt(Dot(a, a)); }
+        /// zero vectors stay zero
+        friend KFORCE_INLINE Vec3 Normalize(Vec3 const& a) { return a * (L::Set(1.0f) / L::Sqrt(L::Max(Dot(a, a), L::Set(1e-30f)))); }
+        friend KFORCE_INLINE Vec3 Select(typename L::M m, Vec3 const& a, Vec3 const& b) { return Vec3(L::Select(m, a.x, b.x), L::Select(m, a.y, b.y), L::Select(m, a.z, b.z)); }
+    };
+
+    /// \brief limits unit 'd' to the cone of half angle acos(cosMax) about unit
+    /// 'u'. A 'd' opposite to 'u' bends towards an arbitrary perpendicular.
+    template <class L>
+    KFORCE_INLINE Vec3<L> Cone(Vec3<L> const& d, Vec3<L> const& u, typename L::V cosMax, typename L::V sinMax, typename L::M & violated)
+    {
+        typedef typename L::V V;
+        V c = Dot(d, u);
+        violated = L::Less(c, cosMax);
+        Vec3<L> perp = d - u * c;
+        V zero = L::Set(0.0f);
+        Vec3<L> fallback = Select(L::Less(L::Abs(u.x), L::Set(0.9f)), Vec3<L>(zero, u.z, zero - u.y), Vec3<L>(zero - u.z, zero, u.x));
+        perp = Normalize(Select(L::Less(Dot(perp, perp), L::Set(1e-12f)), fallback, perp));
+        return Select(violated, u * cosMax + perp * sinMax, d);
+    }
+
+    /// \brief rotates joints (first, count) about p[first] by the rotation
+    /// taking unit 'a' to unit 'b', where 'mask' is set
+    template <class L>
+    KFORCE_INLINE void Rotate(Vec3<L> * p, uint32 first, uint32 count, Vec3<L> const& a, Vec3<L> const& b, typename L::M mask)
+    {
+        typedef typename L::V V;
+        V c = Dot(a, b);
+        Vec3<L> k = Cross(a, b);
+        // R v = c v + k x v + (k . v) k / (1 + c)
+        V f = L::Set(1.0f) / L::Max(L::Set(1.0f) + c, L::Set(1e-6f));
+        for (uint32 j = first + 1; j < count; j++)
+        {
+            Vec3<L> v = p[j] - p[first];
+            Vec3<L> r = v * c + Cross(k, v) + k * (Dot(k, v) * f);
+            p[j] = Select(mask, p[first] + r, p[j]);
+        }
+    }
+
+    /// one pass from the end effector to the root, each joint turning the end
+    /// effector towards the target, then back into its limit
+    struct CCDStep
+    {
+        template <class L>
+        static KFORCE_INLINE void Run(Vec3<L> * p, uint32 count, Vec3<L> const& target, typename L::V const *,
+            typename L::V const * cosMax, typename L::V const * sinMax)
+        {
+            typename L::M all = L::Less(L::Set(0.0f), L::Set(1.0f)), violated;
+            for (uint32 i = count - 1; i-- > 0; )
+            {
+                Rotate(p, i, count, Normalize(p[count - 1] - p[i]), Normalize(target - p[i]), all);
+                if (i == 0)
+                    continue;
+                Vec3<L> d = Normalize(p[i + 1] - p[i]);
+                Vec3<L> limited = Cone(d, Normalize(p[i] - p[i - 1]), cosMax[i], sinMax[i], violated);
+                Rotate(p, i, count, d, limited, violated);
+            }
+        }
+    };
+
+    /// the end effector to the target and back to the root, limits applied
+    /// both ways; the pass back is last, so the result respects them
+    struct FABRIKStep
+    {
+        template <class L>
+        static KFORCE_INLINE void Run(Vec3<L> * p, uint32 count, Vec3<L> const& target, typename L::V const * lengths,
+            typename L::V const * cosMax, typename L::V const * sinMax)
+        {
+            typename L::M violated;
+            Vec3<L> root = p[0];
+            p[count - 1] = target;
+            for (uint32 i = count - 1; i-- > 0; )
+            {
+                Vec3<L> d = Normalize(p[i] - p[i + 1]);
+                if (i + 2 < count)
+                    d = Cone(d, Normalize(p[i + 1] - p[i + 2]), cosMax[i + 1], sinMax[i + 1], violated);
+                p[i] = p[i + 1] + d * lengths[i];
+            }
+            p[0] = root;
+            for (uint32 i = 0; i + 1 < count; i++)
+            {
+                Vec3<L> d = Normalize(p[i + 1] - p[i]);
+                if (i > 0)
+                    d = Cone(d, Normalize(p[i] - p[i - 1]), cosMax[i], sinMax[i], violated);
+                p[i + 1] = p[i] + d * lengths[i];
+            }
+        }
+    };
+
+    /// \brief iterates 'Step' until the end effector is within 'tolerance' of
+    /// the target, stops getting closer or 'maxIterations' pass. Targets out
+    /// of reach take one step. Lanes that are done keep their joints while
+    /// the others go on.
+    template <class L, class Step>
+    void Solve(Vec3<L> * p, uint32 count, Vec3<L> const& target, const typename L::V * maxBend,
+        uint32 maxIterations, float tolerance, typename L::V & iterations, typename L::V & distance)
+    {
+        typedef typename L::V V;
+        typedef typename L::M M;
+        V lengths[kMaxIKJoints], cosMax[kMaxIKJoints], sinMax[kMaxIKJoints];
+        for (uint32 j = 0; j < count; j++)
+        {
+            lengths[j] = j + 1 < count ? Length(p[j + 1] - p[j]) : L::Set(0.0f);
+            float c[L::Width], s[L::Width], bend[L::Width];
+            L::Store(bend, maxBend[j]);
+            for (uint32 i = 0; i < (uint32)L::Width; i++)
+            {
+                c[i] = bend[i] < 3.14159265f ? ::cosf(bend[i]) : -2.0f;
+                s[i] = bend[i] < 3.14159265f ? ::sinf(bend[i]) : 0.0f;
+            }
+            cosMax[j] = L::Load(c);
+            sinMax[j] = L::Load(s);
+        }
+        V limit = L::Set(tolerance), progress = L::Set(tolerance * 0.01f), one = L::Set(1.0f), zero = L::Set(0.0f);
+        Vec3<L> saved[kMaxIKJoints];
+        distance = Length(p[count - 1] - target);
+        M active = L::Less(limit, distance);
+
+        // out of reach the closest pose is the chain stretched towards the target
+        V reach = zero;
+        for (uint32 j = 0; j + 1 < count; j++)
+            reach = reach + lengths[j];
+        M inside = L::Less(Length(target - p[0]), reach);
+        Vec3<L> direction = Normalize(target - p[0]);
+        for (uint32 j = 1; j < count; j++)
+            p[j] = Select(active, Select(inside, p[j], p[j - 1] + direction * lengths[j - 1]), p[j]);
+        iterations = L::Select(active, L::Select(inside, zero, one), zero);
+        distance = Length(p[count - 1] - target);
+        active = L::And(active, inside);
+        for (uint32 n = 0; n < maxIterations && L::Any(active); n++)
+        {
+            for (uint32 j = 0; j < count; j++)
+                saved[j] = p[j];
+            Step::template Run<L>(p, count, target, lengths, cosMax, sinMax);
+            for (uint32 j = 0; j < count; j++)
+                p[j] = Select(active, p[j], saved[j]);
+            V d = Length(p[count - 1] - target);
+            M closer = L::Less(d + progress, distance);
+            iterations = iterations + L::Select(active, one, zero);
+            distance = L::Select(active, d, distance);
+            active = L::And(active, L::And(L::Less(limit, d), closer));
+        }
+    }
+}
+
+/// \brief iterative solver of chains of joints for a target of the end
+/// effector. The root stays, every bone keeps its length.
 class IKSolver
 {
-    
+public:
+    struct Result
+    {
+        uint32  Iterations;
+        /// from the end effector to the target
+        float   Distance;
+    };
+
+    IKSolver() : m_MaxIterations(16), m_Tolerance(0.001f) {}
+    virtual ~IKSolver() {}
+
+    void SetMaxIterations(uint32 maxIterations) { m_MaxIterations = maxIterations; }
+    /// iterations stop once the end effector is this close
+    void SetTolerance(float tolerance) { m_Tolerance = tolerance; }
+    uint32 GetMaxIterations() const { return m_MaxIterations; }
+    float GetTolerance() const { return m_Tolerance; }
+
+    /// solves 'joints', root first, in place
+    virtual Result Solve(Joint * joints, uint32 count, Vec3f const& target) const = 0;
+    /// \brief solves every chain of 'batch' in place, 4 at once on SSE;
+    /// separate batches may be solved on separate threads
+    /// \param scalar one chain at a time, for comparison
+    virtual void Solve(IKBatch & batch, bool scalar = false) const = 0;
+
+protected:
+    template <class Step>
+    Result SolveChain(Joint * joints, uint32 count, Vec3f const& target) const
+    {
+        typedef IKDetail::Vec3<IKDetail::Lane1> V3;
+        assert(count >= 2 && count <= kMaxIKJoints);
+        V3 p[kMaxIKJoints];
+        float bend[kMaxIKJoints], iterations;
+        for (uint32 j = 0; j < count; j++)
+        {
+            p[j] = V3(joints[j].Position.x, joints[j].Position.y, joints[j].Position.z);
+            bend[j] = joints[j].MaxBend;
+        }
+        Result result;
+        IKDetail::Solve<IKDetail::Lane1, Step>(p, count, V3(target.x, target.y, target.z), bend,
+            m_MaxIterations, m_Tolerance, iterations, result.Distance);
+        for (uint32 j = 0; j < count; j++)
+            joints[j].Position = Vec3f(p[j].x, p[j].y, p[j].z);
+        result.Iterations = (uint32)iterations;
+        return result;
+    }
+
+    template <class Step>
+    void SolveBatch(IKBatch & batch, bool scalar) const
+    {
+        uint32 count = batch.GetNumJoints();
+        for (uint32 g = 0; g < batch.GetNumGroups(); g++)
+        {
+#if K3D_IK_SSE
+            if (!scalar)
+            {
+                SolveGroup<IKDetail::Lane4, Step>(batch, g, 0, count);
+                continue;
+            }
+#endif
+            for (uint32 lane = 0; lane < 4; lane++)
+                SolveGroup<IKDetail::Lane1, Step>(batch, g, lane, count);
+        }
+    }
+
+private:
+    /// L::Width chains of group 'g' from 'lane'
+    template <class L, class Step>
+    void SolveGroup(IKBatch & batch, uint32 g, uint32 lane, uint32 count) const
+    {
+        typedef IKDetail::Vec3<L> V3;
+        V3 p[kMaxIKJoints];
+        typename L::V bend[kMaxIKJoints], iterations, distance;
+        for (uint32 j = 0; j < count; j++)
+        {
+            const float * position = batch.Positions(g, j) + lane;
+            p[j] = V3(L::Load(position), L::Load(position + 4), L::Load(position + 8));
+            bend[j] = L::Load(batch.MaxBend(g, j) + lane);
+        }
+        const float * t = batch.Target(g) + lane;
+        IKDetail::Solve<L, Step>(p, count, V3(L::Load(t), L::Load(t + 4), L::Load(t + 8)), bend,
+            m_MaxIterations, m_Tolerance, iterations, distance);
+        for (uint32 j = 0; j < count; j++)
+        {
+            float * position = batch.Positions(g, j) + lane;
+            L::Store(position, p[j].x);
+            L::Store(position + 4, p[j].y);
+            L::Store(position + 8, p[j].z);
+        }
+        float n[L::Width];
+        L::Store(n, iterations);
+        for (uint32 i = 0; i < (uint32)L::Width; i++)
+            batch.Iterations(g)[lane + i] = (uint32)n[i];
+        L::Store(batch.Distance(g) + lane, distance);
+    }
+
+    uint32  m_MaxIterations;
+    float   m_Tolerance;
 };
 
+/// \brief cyclic coordinate descent: each joint in turn rotates the rest of
+/// the chain to point the end effector at the target
 class CCDIKSolver : public IKSolver
 {
-    
+public:
+    Result Solve(Joint * joints, uint32 count, Vec3f const& target) const override
+    {
+        return SolveChain<IKDetail::CCDStep>(joints, count, target);
+    }
+
+    void Solve(IKBatch & batch, bool scalar = false) const override
+    {
+        SolveBatch<IKDetail::CCDStep>(batch, scalar);
+    }
 };
 
+/// \brief forward and backward reaching: places the joints along the lines
+/// to the target and back to the root, usually in fewer iterations than CCD
 class FABRIKSolver : public IKSolver
 {
+public:
+    Result Solve(Joint * joints, uint32 count, Vec3f const& target) const override
+    {
+        return SolveChain<IKDetail::FABRIKStep>(joints, count, target);
+    }
 
+    void Solve(IKBatch & batch, bool scalar = false) const override
+    {
+        SolveBatch<IKDetail::FABRIKStep>(batch, scalar);
+    }
 };
 
 NS_MATHLIB_END
+
+#endif
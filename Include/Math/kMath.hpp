@@ -221,7 +221,7 @@ struct tVectorN<T, 3>
   void init( U *s_offset )
   {
     assert( sizeof(U) <= sizeof(T) && s_offset );
-    ::memcpy( m_data, s_offset, 4 * sizeof(U) );
+    ::memcpy( m_data, s_offset, 3 * sizeof(U) );
   }
   //-------------------------------------------------------
 
@@ -269,7 +269,7 @@ struct tVectorN<T, 4>
   typedef T value_type;
   tVectorN() { m_data[ 0 ] = 0; m_data[ 1 ] = 0; m_data[ 2 ] = 0; m_data[ 3 ] = 0; }
   tVectorN( T x, T y, T z, T w ) { m_data[ 0 ] = x; m_data[ 1 ] = y;  m_data[ 2 ] = z; m_data[ 3 ] = w; }
-  tVectorN( const tVectorN<T, 3> &vec, T w ) { m_data[ 0 ] = vec[ 0 ]; m_data[ 1 ] = vec[ 1 ]; m_data[ 2 ] = vec[ 2 ]; m_data[ 0 ] = w; }
+  tVectorN( const tVectorN<T, 3> &vec, T w ) { m_data[ 0 ] = vec[ 0 ]; m_data[ 1 ] = vec[ 1 ]; m_data[ 2 ] = vec[ 2 ]; m_data[ 3 ] = w; }
   tVectorN( const T *ptr )	{ this->template init<T>( ptr ); }
 
   T& operator [] ( int index )				{ assert( index < 4 && "tVector4 : index < 4 -- Failed !" ); return m_data[ index ]; }
@@ -456,6 +456,22 @@ KFORCE_INLINE tVectorN<T, N> operator * (const tMatrixNxN<T, N> &a, const tVecto
   return result;
 }
 
+//! \fn	template <typename T> KFORCE_INLINE tVectorN<T, 4> Transform(const tMatrixNxN<T, 4> &m, const tVectorN<T, 4> &v)
+//! \brief	Transforms a vector by a column major matrix, m[0] * x + m[1] * y + m[2] * z + m[3] * w.
+//! \param	m	The matrix, columns first as MakeTranslationMatrix builds it.
+//! \param	v	The vector, w is 1 for points and 0 for directions.
+//! \return	The transformed vector.
+template <typename T>
+KFORCE_INLINE tVectorN<T, 4> Transform( const tMatrixNxN<T, 4> &m, const tVectorN<T, 4> &v )
+{
+  tVectorN<T, 4> result;
+  for ( int i = 0; i < 4; i++ )
+  {
+    result[ i ] = m[ 0 ][ i ] * v[ 0 ] + m[ 1 ][ i ] * v[ 1 ] + m[ 2 ][ i ] * v[ 2 ] + m[ 3 ][ i ] * v[ 3 ];
+  }
+  return result;
+}
+
 //! \fn	template <typename T, int N> KFORCE_INLINE std::ostream & operator<< (std::ostream & os, const tVectorN<T, N> &vec)
 //! \brief	&lt;&lt;&lt;typename T,int N&gt; casting operator.
 //! \param [in,out]	os	The operating system.
@@ -589,6 +605,15 @@ public:
     return Result;
   }
 
+  friend KFORCE_INLINE tMatrixNxN<T, 4> Transpose( const tMatrixNxN<T, 4> &a )
+  {
+    tMatrixNxN<T, 4> result;
+    for ( int i = 0; i < 4; i++ )
+      for ( int j = 0; j < 4; j++ )
+        result[ i ][ j ] = a[ j ][ i ];
+    return result;
+  }
+
   KFORCE_INLINE tMatrixNxN<T, 4> Inverse()
   {
     tMatrixNxN<T, 4> result;
@@ -1015,6 +1040,47 @@ private:
   };
 };
 //--------------------Quaternion Operations With Matrix Math-------------------//
+// Quaternions as tVectorN<T, 4> of x, y, z, w, unlike Quaternion which keeps w first.
+
+//! \brief	Hamilton product, the rotation of b followed by a.
+template <typename T>
+KFORCE_INLINE tVectorN<T, 4> QuaternionMultiply( const tVectorN<T, 4> &a, const tVectorN<T, 4> &b )
+{
+  return tVectorN<T, 4>(
+    a[ 3 ] * b[ 0 ] + a[ 0 ] * b[ 3 ] + a[ 1 ] * b[ 2 ] - a[ 2 ] * b[ 1 ],
+    a[ 3 ] * b[ 1 ] - a[ 0 ] * b[ 2 ] + a[ 1 ] * b[ 3 ] + a[ 2 ] * b[ 0 ],
+    a[ 3 ] * b[ 2 ] + a[ 0 ] * b[ 1 ] - a[ 1 ] * b[ 0 ] + a[ 2 ] * b[ 3 ],
+    a[ 3 ] * b[ 3 ] - a[ 0 ] * b[ 0 ] - a[ 1 ] * b[ 1 ] - a[ 2 ] * b[ 2 ] );
+}
+
+//! \brief	The inverse of a unit quaternion.
+template <typename T>
+KFORCE_INLINE tVectorN<T, 4> QuaternionConjugate( const tVectorN<T, 4> &q )
+{
+  return tVectorN<T, 4>( -q[ 0 ], -q[ 1 ], -q[ 2 ], q[ 3 ] );
+}
+
+//! \brief	Rotates x, y and z of v by the unit quaternion q, w of v is kept.
+template <typename T>
+KFORCE_INLINE tVectorN<T, 4> QuaternionRotate( const tVectorN<T, 4> &q, const tVectorN<T, 4> &v )
+{
+  tVectorN<T, 4> r = QuaternionMultiply( QuaternionMultiply( q, tVectorN<T, 4>( v[ 0 ], v[ 1 ], v[ 2 ], T( 0 ) ) ), QuaternionConjugate( q ) );
+  r[ 3 ] = v[ 3 ];
+  return r;
+}
+
+//! \brief	The column major rotation matrix of the unit quaternion q.
+template <typename T>
+KFORCE_INLINE tMatrixNxN<T, 4> QuaternionToMatrix( const tVectorN<T, 4> &q )
+{
+  T x = q[ 0 ], y = q[ 1 ], z = q[ 2 ], w = q[ 3 ];
+  tMatrixNxN<T, 4> result;
+  result[ 0 ] = tVectorN<T, 4>( T( 1 ) - T( 2 ) * (y * y + z * z), T( 2 ) * (x * y + w * z), T( 2 ) * (x * z - w * y), T( 0 ) );
+  result[ 1 ] = tVectorN<T, 4>( T( 2 ) * (x * y - w * z), T( 1 ) - T( 2 ) * (x * x + z * z), T( 2 ) * (y * z + w * x), T( 0 ) );
+  result[ 2 ] = tVectorN<T, 4>( T( 2 ) * (x * z + w * y), T( 2 ) * (y * z - w * x), T( 1 ) - T( 2 ) * (x * x + y * y), T( 0 ) );
+  result[ 3 ] = tVectorN<T, 4>( T( 0 ), T( 0 ), T( 0 ), T( 1 ) );
+  return result;
+}
 
 //--------------------CODE BELOW IS FROM MINIENGINE----------------------------//
 //
@@ -1068,4 +1134,9 @@ static KFORCE_INLINE T Clamp(const T X, const T Min, const T Max)
 
 NS_MATHLIB_END
 
+// ENABLE_MATH_SIMD: float vectors and matrices on SSE, AVX or NEON
+#if K3D_MATH_SIMD
+#include "kVec4Mat4_SIMD.hpp"
+#endif
+
 #endif
@@ -0,0 +1,159 @@
+#pragma once
+#ifndef __kMath_NEON_hpp__
+#define __kMath_NEON_hpp__
+
+#include "../Config/Config.h"
+#include <arm_neon.h>
+
+/// the functions of kMath_SSE.hpp on NEON, for kVec4Mat4_SIMD.hpp
+typedef float32x4_t vec4x32;
+
+KFORCE_INLINE vec4x32 simd_add(vec4x32 const & a, vec4x32 const & b) {
+	return vaddq_f32(a, b);
+}
+
+KFORCE_INLINE vec4x32 simd_sub(vec4x32 const & a, vec4x32 const & b) {
+	return vsubq_f32(a, b);
+}
+
+KFORCE_INLINE vec4x32 simd_mul(vec4x32 const & a, vec4x32 const & b) {
+	return vmulq_f32(a, b);
+}
+
+KFORCE_INLINE vec4x32 simd_div(vec4x32 const & a, vec4x32 const & b) {
+#if defined(__aarch64__) || defined(_M_ARM64)
+	return vdivq_f32(a, b);
+#else
+	// two Newton-Raphson steps on the estimate
+	vec4x32 r = vrecpeq_f32(b);
+	r = vmulq_f32(vrecpsq_f32(b, r), r);
+	r = vmulq_f32(vrecpsq_f32(b, r), r);
+	return vmulq_f32(a, r);
+#endif
+}
+
+KFORCE_INLINE vec4x32 simd_sqrt(vec4x32 const & v) {
+#if defined(__aarch64__) || defined(_M_ARM64)
+	return vsqrtq_f32(v);
+#else
+	vec4x32 r = vrsqrteq_f32(v);
+	r = vmulq_f32(vrsqrtsq_f32(vmulq_f32(v, r), r), r);
+	r = vmulq_f32(vrsqrtsq_f32(vmulq_f32(v, r), r), r);
+	// v * 1/sqrt(v) is NaN at 0
+	uint32x4_t zero = vceqq_f32(v, vdupq_n_f32(0.0f));
+	return vbslq_f32(zero, v, vmulq_f32(v, r));
+#endif
+}
+
+KFORCE_INLINE vec4x32 simd_set(float v) {
+	return vdupq_n_f32(v);
+}
+
+KFORCE_INLINE vec4x32 simd_set(float x, float y, float z, float w) {
+	float v[4] = { x, y, z, w };
+	return vld1q_f32(v);
+}
+
+KFORCE_INLINE vec4x32 simd_load(const float * p) {
+	return vld1q_f32(p);
+}
+
+KFORCE_INLINE void simd_store(float * p, vec4x32 const & v) {
+	vst1q_f32(p, v);
+}
+
+KFORCE_INLINE float simd_get_x(vec4x32 const & v) {
+	return vgetq_lane_f32(v, 0);
+}
+
+KFORCE_INLINE vec4x32 simd_splat_x(vec4x32 const & v) { return vdupq_lane_f32(vget_low_f32(v), 0); }
+KFORCE_INLINE vec4x32 simd_splat_y(vec4x32 const & v) { return vdupq_lane_f32(vget_low_f32(v), 1); }
+KFORCE_INLINE vec4x32 simd_splat_z(vec4x32 const & v) { return vdupq_lane_f32(vget_high_f32(v), 0); }
+KFORCE_INLINE vec4x32 simd_splat_w(vec4x32 const & v) { return vdupq_lane_f32(vget_high_f32(v), 1); }
+KFORCE_INLINE vec4x32 simd_swizzle_yxwz(vec4x32 const & v) { return vrev64q_f32(v); }
+KFORCE_INLINE vec4x32 simd_swizzle_zwxy(vec4x32 const & v) { return vextq_f32(v, v, 2); }
+KFORCE_INLINE vec4x32 simd_swizzle_wzyx(vec4x32 const & v) { vec4x32 r = vrev64q_f32(v); return vextq_f32(r, r, 2); }
+
+/// the dot product in every lane
+KFORCE_INLINE vec4x32 simd_dot(vec4x32 const & a, vec4x32 const & b) {
+	vec4x32 dot = vmulq_f32(a, b);
+	dot = vaddq_f32(dot, vextq_f32(dot, dot, 2));
+	return vaddq_f32(dot, vrev64q_f32(dot));
+}
+
+KFORCE_INLINE vec4x32 simd_reciprocal_sqrt(vec4x32 const & v) {
+	return vrsqrteq_f32(v);
+}
+
+KFORCE_INLINE vec4x32 simd_reciprocal_length(vec4x32 const & v) {
+	return simd_reciprocal_sqrt(simd_dot(v, v));
+}
+
+KFORCE_INLINE vec4x32 simd_reciprocal(vec4x32 const & v) {
+	return vrecpeq_f32(v);
+}
+
+KFORCE_INLINE vec4x32 simd_normalize(vec4x32 const & v) {
+	return simd_mul(v, simd_reciprocal_length(v));
+}
+
+/// m[0] * v.x + m[1] * v.y + m[2] * v.z + m[3] * v.w
+KFORCE_INLINE vec4x32 simd_matrix4_transform(const void* _m, vec4x32 const & v) {
+	const vec4x32 *m = (const vec4x32*)_m;
+	vec4x32 a0 = vaddq_f32(vmulq_f32(m[0], simd_splat_x(v)), vmulq_f32(m[1], simd_splat_y(v)));
+	vec4x32 a1 = vaddq_f32(vmulq_f32(m[2], simd_splat_z(v)), vmulq_f32(m[3], simd_splat_w(v)));
+	return vaddq_f32(a0, a1);
+}
+
+/// a * b of column major matrices, 'result' may alias neither
+KFORCE_INLINE void simd_matrix4_mul(void* result, void* a, void* b) {
+	vec4x32 *in2 = (vec4x32*)b;
+	vec4x32 *out = (vec4x32*)result;
+	for (int c = 0; c < 4; c++)
+		out[c] = simd_matrix4_transform(a, in2[c]);
+}
+
+KFORCE_INLINE void simd_matrix4_transpose(void* _src, void* _dest) {
+	vec4x32 *src = (vec4x32*)_src;
+	vec4x32 *dest = (vec4x32*)_dest;
+	float32x4x2_t t01 = vtrnq_f32(src[0], src[1]);
+	float32x4x2_t t23 = vtrnq_f32(src[2], src[3]);
+	dest[0] = vcombine_f32(vget_low_f32(t01.val[0]), vget_low_f32(t23.val[0]));
+	dest[1] = vcombine_f32(vget_low_f32(t01.val[1]), vget_low_f32(t23.val[1]));
+	dest[2] = vcombine_f32(vget_high_f32(t01.val[0]), vget_high_f32(t23.val[0]));
+	dest[3] = vcombine_f32(vget_high_f32(t01.val[1]), vget_high_f32(t23.val[1]));
+}
+
+/// \brief cofactors on 2x2 sub determinants, as tMatrixNxN<T, 4>::Inverse;
+/// lane shuffles cost more than they save on NEON
+KFORCE_INLINE void simd_matrix4_inverse(void* _src, void* _dest) {
+	const float *m = (const float*)_src;
+	float *inv = (float*)_dest;
+	float s0 = m[0] * m[5] - m[4] * m[1];
+	float s1 = m[0] * m[6] - m[4] * m[2];
+	float s2 = m[0] * m[7] - m[4] * m[3];
+	float s3 = m[1] * m[6] - m[5] * m[2];
+	float s4 = m[1] * m[7] - m[5] * m[3];
+	float s5 = m[2] * m[7] - m[6] * m[3];
+	float c5 = m[10] * m[15] - m[14] * m[11];
+	float c4 = m[9] * m[15] - m[13] * m[11];
+	float c3 = m[9] * m[14] - m[13] * m[10];
+	float c2 = m[8] * m[15] - m[12] * m[11];
+	float c1 = m[8] * m[14] - m[12] * m[10];
+	float c0 = m[8] * m[13] - m[12] * m[9];
+	float id = 1.0f / (s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0);
+	float r[16] = {
+		(m[5] * c5 - m[6] * c4 + m[7] * c3) * id, (-m[1] * c5 + m[2] * c4 - m[3] * c3) * id,
+		(m[13] * s5 - m[14] * s4 + m[15] * s3) * id, (-m[9] * s5 + m[10] * s4 - m[11] * s3) * id,
+		(-m[4] * c5 + m[6] * c2 - m[7] * c1) * id, (m[0] * c5 - m[2] * c2 + m[3] * c1) * id,
+		(-m[12] * s5 + m[14] * s2 - m[15] * s1) * id, (m[8] * s5 - m[10] * s2 + m[11] * s1) * id,
+		(m[4] * c4 - m[5] * c2 + m[7] * c0) * id, (-m[0] * c4 + m[1] * c2 - m[3] * c0) * id,
+		(m[12] * s4 - m[13] * s2 + m[15] * s0) * id, (-m[8] * s4 + m[9] * s2 - m[11] * s0) * id,
+		(-m[4] * c3 + m[5] * c1 - m[6] * c0) * id, (m[0] * c3 - m[1] * c1 + m[2] * c0) * id,
+		(-m[12] * s3 + m[13] * s1 - m[14] * s0) * id, (m[8] * s3 - m[9] * s1 + m[10] * s0) * id,
+	};
+	for (int i = 0; i < 16; i++)
+		inv[i] = r[i];
+}
+
+#endif
@@ -4,6 +4,13 @@
 
 #include "../Config/Config.h"
 #include <xmmintrin.h>
+#include <emmintrin.h>
+#if defined(__SSE4_1__) || defined(__AVX__)
+#include <smmintrin.h>
+#endif
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
 
 #define _MM_PERM2_X			0
 #define _MM_PERM2_Y			1
@@ -18,22 +25,59 @@ KFORCE_INLINE vec4x32 _mm_rcp_ss_nr(vec4x32 v) {
 	return _mm_sub_ss(_mm_add_ss(iv, iv), _mm_mul_ss(v, _mm_mul_ss(iv, iv)));
 }
 
-KFORCE_INLINE vec4x32 simd_add(vec4x32 & a, vec4x32 & b) {
+KFORCE_INLINE vec4x32 simd_add(vec4x32 const & a, vec4x32 const & b) {
 	return _mm_add_ps(a, b);
 }
 
+KFORCE_INLINE vec4x32 simd_sub(vec4x32 const & a, vec4x32 const & b) {
+	return _mm_sub_ps(a, b);
+}
+
+/// the dot product in every lane
 KFORCE_INLINE vec4x32 simd_dot(vec4x32 const & a, vec4x32 const & b) {
+#if defined(__SSE4_1__) || defined(__AVX__)
+	return _mm_dp_ps(a, b, 0xff);
+#else
 	vec4x32 dot = _mm_mul_ps(a, b);
-	vec4x32 tmp = _mm_shuffle_ps(dot, dot, _MM_SHUFFLE(0, 0, 3, 2));
+	vec4x32 tmp = _mm_shuffle_ps(dot, dot, _MM_SHUFFLE(1, 0, 3, 2));
 	dot = _mm_add_ps(dot, tmp);
-	tmp = _mm_shuffle_ps(dot, dot, _MM_SHUFFLE(0, 0, 0, 1));
+	tmp = _mm_shuffle_ps(dot, dot, _MM_SHUFFLE(2, 3, 0, 1));
 	return _mm_add_ps(dot, tmp);
+#endif
 }
 
 KFORCE_INLINE vec4x32 simd_mul(vec4x32 const & a, vec4x32 const & b) {
 	return _mm_mul_ps(a, b);
 }
 
+KFORCE_INLINE vec4x32 simd_div(vec4x32 const & a, vec4x32 const & b) {
+	return _mm_div_ps(a, b);
+}
+
+KFORCE_INLINE vec4x32 simd_sqrt(vec4x32 const & v) {
+	return _mm_sqrt_ps(v);
+}
+
+KFORCE_INLINE vec4x32 simd_load(const float * p) {
+	return _mm_loadu_ps(p);
+}
+
+KFORCE_INLINE void simd_store(float * p, vec4x32 const & v) {
+	_mm_storeu_ps(p, v);
+}
+
+KFORCE_INLINE float simd_get_x(vec4x32 const & v) {
+	return _mm_cvtss_f32(v);
+}
+
+KFORCE_INLINE vec4x32 simd_splat_x(vec4x32 const & v) { return _MM_SWIZZLE(v, X, X, X, X); }
+KFORCE_INLINE vec4x32 simd_splat_y(vec4x32 const & v) { return _MM_SWIZZLE(v, Y, Y, Y, Y); }
+KFORCE_INLINE vec4x32 simd_splat_z(vec4x32 const & v) { return _MM_SWIZZLE(v, Z, Z, Z, Z); }
+KFORCE_INLINE vec4x32 simd_splat_w(vec4x32 const & v) { return _MM_SWIZZLE(v, W, W, W, W); }
+KFORCE_INLINE vec4x32 simd_swizzle_yxwz(vec4x32 const & v) { return _MM_SWIZZLE(v, Y, X, W, Z); }
+KFORCE_INLINE vec4x32 simd_swizzle_zwxy(vec4x32 const & v) { return _MM_SWIZZLE(v, Z, W, X, Y); }
+KFORCE_INLINE vec4x32 simd_swizzle_wzyx(vec4x32 const & v) { return _MM_SWIZZLE(v, W, Z, Y, X); }
+
 KFORCE_INLINE vec4x32 simd_set(float v) {
 	return _mm_set_ps1(v);
 }
@@ -59,7 +103,26 @@ KFORCE_INLINE vec4x32 simd_normalize(vec4x32 const & v) {
 	return simd_mul(v, simd_reciprocal_length(v));
 }
 
+/// a * b of column major matrices, 'result' may alias neither
 KFORCE_INLINE void simd_matrix4_mul(void* result, void* a, void* b) {
+#if defined(__AVX__)
+	// two columns of the result at once, each half of b01 and b23 is a column of b
+	const float *in1 = (const float*)a;
+	const float *in2 = (const float*)b;
+	float *out = (float*)result;
+	__m256 a0 = _mm256_broadcast_ps((const __m128*)in1);
+	__m256 a1 = _mm256_broadcast_ps((const __m128*)(in1 + 4));
+	__m256 a2 = _mm256_broadcast_ps((const __m128*)(in1 + 8));
+	__m256 a3 = _mm256_broadcast_ps((const __m128*)(in1 + 12));
+	for (int c = 0; c < 4; c += 2) {
+		__m256 b01 = _mm256_loadu_ps(in2 + c * 4);
+		__m256 m0 = _mm256_mul_ps(a0, _mm256_shuffle_ps(b01, b01, _MM_SHUFFLE(0, 0, 0, 0)));
+		__m256 m1 = _mm256_mul_ps(a1, _mm256_shuffle_ps(b01, b01, _MM_SHUFFLE(1, 1, 1, 1)));
+		__m256 m2 = _mm256_mul_ps(a2, _mm256_shuffle_ps(b01, b01, _MM_SHUFFLE(2, 2, 2, 2)));
+		__m256 m3 = _mm256_mul_ps(a3, _mm256_shuffle_ps(b01, b01, _MM_SHUFFLE(3, 3, 3, 3)));
+		_mm256_storeu_ps(out + c * 4, _mm256_add_ps(_mm256_add_ps(m0, m1), _mm256_add_ps(m2, m3)));
+	}
+#else
 	vec4x32 *in1 = (vec4x32*)a;
 	vec4x32 *in2 = (vec4x32*)b;
 	vec4x32 *out = (vec4x32*)result;
@@ -134,6 +197,23 @@ KFORCE_INLINE void simd_matrix4_mul(void* result, void* a, void* b) {
 
 		out[3] = a2;
 	}
+#endif
+}
+
+KFORCE_INLINE void simd_matrix4_transpose(void* _src, void* _dest) {
+	vec4x32 *src = (vec4x32*)_src;
+	vec4x32 *dest = (vec4x32*)_dest;
+	vec4x32 r0 = src[0], r1 = src[1], r2 = src[2], r3 = src[3];
+	_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+	dest[0] = r0; dest[1] = r1; dest[2] = r2; dest[3] = r3;
+}
+
+/// m[0] * v.x + m[1] * v.y + m[2] * v.z + m[3] * v.w
+KFORCE_INLINE vec4x32 simd_matrix4_transform(const void* _m, vec4x32 const & v) {
+	const vec4x32 *m = (const vec4x32*)_m;
+	vec4x32 a0 = _mm_add_ps(_mm_mul_ps(m[0], _MM_SWIZZLE(v, X, X, X, X)), _mm_mul_ps(m[1], _MM_SWIZZLE(v, Y, Y, Y, Y)));
+	vec4x32 a1 = _mm_add_ps(_mm_mul_ps(m[2], _MM_SWIZZLE(v, Z, Z, Z, Z)), _mm_mul_ps(m[3], _MM_SWIZZLE(v, W, W, W, W)));
+	return _mm_add_ps(a0, a1);
 }
 
 KFORCE_INLINE void simd_matrix4_inverse(void* _src, void* _dest) {
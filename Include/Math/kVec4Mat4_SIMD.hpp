@@ -1,22 +1,26 @@
 #pragma once
+#ifndef __kVec4Mat4_SIMD_hpp__
+#define __kVec4Mat4_SIMD_hpp__
 
 #include "kMath.hpp"
 
-#if K3DPLATFORM_OS_WIN || K3DPLATFORM_OS_LINUX || K3DPLATFORM_OS_MAC
-#define __ENABLE_SSE__ 1
-#elif K3DPLATFORM_OS_ANDROID
-#define __ENABLE_NEON__ 1
-#endif
-
-#if __ENABLE_SSE__
-#include "kMath_SSE.hpp"
-#elif __ENABLE_NEON__
+// The backend follows the target of the compiler: NEON on ARM, SSE2 on x86
+// with SSE4.1 dot products and AVX matrix products where enabled (-msse4.1,
+// -mavx, /arch:AVX). Include this before anything uses Vec4f or Mat4f, or
+// build with ENABLE_MATH_SIMD so kMath.hpp includes it.
+#if defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM) || defined(_M_ARM64)
+#define K3D_MATH_NEON 1
 #include "kMath_NEON.hpp"
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define K3D_MATH_SSE 1
+#include "kMath_SSE.hpp"
+#else
+#error "kVec4Mat4_SIMD.hpp needs SSE2 or NEON"
 #endif
 
 NS_MATHLIB_BEGIN
   template <>
-  class tVectorN<float, 4>
+  struct tVectorN<float, 4>
   {
   public:
     enum { Len = 4 };
@@ -26,14 +30,15 @@ NS_MATHLIB_BEGIN
 	KFORCE_INLINE tVectorN(vec4x32 _simd) { data = _simd; }
 	KFORCE_INLINE tVectorN(float x, float y, float z, float w) { data = simd_set(x, y, z, w); }
 
-	KFORCE_INLINE explicit tVectorN(const float *ptr)	{ this->init(ptr); }
+	KFORCE_INLINE tVectorN(const float *ptr)	{ this->init(ptr); }
 	KFORCE_INLINE explicit tVectorN(float ones){ data = simd_set(ones); }
 	KFORCE_INLINE tVectorN(const tVectorN<float, 3>& vec3, float w)
     {
-		data = simd_set(vec3[0],vec3[2],vec3[2],w);
+		data = simd_set(vec3[0],vec3[1],vec3[2],w);
     }
 
-	KFORCE_INLINE void init(const float *ptr) { data = simd_set(ptr[0], ptr[1], ptr[2], ptr[3]); }
+	template <class U>
+	KFORCE_INLINE void init(const U *ptr) { assert( sizeof(U) == sizeof(float) && ptr ); data = simd_load((const float*)ptr); }
 
     KFORCE_INLINE float& operator [] ( int index )				{ assert( index < 4 && "tVector4 : index < 4 -- Failed !" ); return d[ index ]; }
     KFORCE_INLINE const float operator [] ( int index )const	{ assert( index < 4 && "tVector4 : index < 4 -- Failed !" ); return d[ index ]; }
@@ -48,11 +53,11 @@ NS_MATHLIB_BEGIN
       return tVectorN<float, 3>( d[0], d[1], d[2] );
     }
 
-    KFORCE_INLINE tVectorN<float, 3> ToVec3()
+    KFORCE_INLINE tVectorN<float, 3> ToVec3() const
     {
         return tVectorN<float, 3>( d[0], d[1], d[2] );
     }
-	
+
 	KFORCE_INLINE operator vec4x32 () const
     {
       return data;
@@ -67,17 +72,47 @@ NS_MATHLIB_BEGIN
 
   KFORCE_INLINE float DotProduct( const tVectorN<float, 4>& a, const tVectorN<float, 4>& b )
   {
-	  vec4x32 result = simd_dot((vec4x32)a, (vec4x32)b);
-#if __ENABLE_SSE__
-	  return result.m128_f32[0];
-#endif
+	  return simd_get_x(simd_dot((vec4x32)a, (vec4x32)b));
+  }
+
+  KFORCE_INLINE tVectorN<float, 4> operator + (const tVectorN<float, 4> &a, const tVectorN<float, 4> &b)
+  {
+    return simd_add((vec4x32)a, (vec4x32)b);
+  }
+
+  KFORCE_INLINE tVectorN<float, 4> operator - (const tVectorN<float, 4> &a, const tVectorN<float, 4> &b)
+  {
+    return simd_sub((vec4x32)a, (vec4x32)b);
+  }
+
+  KFORCE_INLINE tVectorN<float, 4> operator * (const tVectorN<float, 4> &a, const tVectorN<float, 4> &b)
+  {
+    return simd_mul((vec4x32)a, (vec4x32)b);
+  }
+
+  KFORCE_INLINE tVectorN<float, 4> operator + (const tVectorN<float, 4> &a, const float &b)
+  {
+    return simd_add((vec4x32)a, simd_set(b));
   }
 
-  KFORCE_INLINE tVectorN<float, 4> operator / (const tVectorN<float, 4> &a, const float factor)
+  KFORCE_INLINE tVectorN<float, 4> operator - (const tVectorN<float, 4> &a, const float &b)
   {
-    float f = 1.0f / factor;// little optimize
-    vec4x32 res = simd_mul((vec4x32)a, simd_set(f));
-    return tVectorN<float, 4>( res );
+    return simd_sub((vec4x32)a, simd_set(b));
+  }
+
+  KFORCE_INLINE tVectorN<float, 4> operator * (const tVectorN<float, 4> &a, const float &factor)
+  {
+    return simd_mul((vec4x32)a, simd_set(factor));
+  }
+
+  KFORCE_INLINE tVectorN<float, 4> operator / (const tVectorN<float, 4> &a, const float &factor)
+  {
+    return simd_div((vec4x32)a, simd_set(factor));
+  }
+
+  KFORCE_INLINE tVectorN<float, 4> Normalize( const tVectorN<float, 4> &v )
+  {
+    return simd_div((vec4x32)v, simd_sqrt(simd_dot((vec4x32)v, (vec4x32)v)));
   }
 
   template <>
@@ -123,10 +158,24 @@ NS_MATHLIB_BEGIN
       return data[ 0 ];
     }
 
+    KFORCE_INLINE tMatrixNxN Inverse() const
+    {
+      tMatrixNxN result;
+      simd_matrix4_inverse((void*)data, result.data);
+      return result;
+    }
+
+    friend KFORCE_INLINE tMatrixNxN Transpose( const tMatrixNxN &a )
+    {
+      tMatrixNxN result;
+      simd_matrix4_transpose((void*)a.data, result.data);
+      return result;
+    }
+
   private:
     tVectorN<float, 4> data[ 4 ];
   };
-  
+
   KFORCE_INLINE tMatrixNxN<float, 4> operator * (const tMatrixNxN<float, 4> &a, const tMatrixNxN<float, 4> &b)
   {
     tMatrixNxN<float, 4> res;
@@ -134,5 +183,86 @@ NS_MATHLIB_BEGIN
     return res;
   }
 
+  KFORCE_INLINE tMatrixNxN<float, 4> operator + (const tMatrixNxN<float, 4> &a, const tMatrixNxN<float, 4> &b)
+  {
+    tMatrixNxN<float, 4> res;
+    for ( int i = 0; i < 4; i++ )
+      res[ i ] = a[ i ] + b[ i ];
+    return res;
+  }
+
+  KFORCE_INLINE tMatrixNxN<float, 4> operator - (const tMatrixNxN<float, 4> &a, const tMatrixNxN<float, 4> &b)
+  {
+    tMatrixNxN<float, 4> res;
+    for ( int i = 0; i < 4; i++ )
+      res[ i ] = a[ i ] - b[ i ];
+    return res;
+  }
+
+  // each component the dot product of a[i] and b, as the generic operator
+  KFORCE_INLINE tVectorN<float, 4> operator * (const tMatrixNxN<float, 4> &a, const tVectorN<float, 4> &b)
+  {
+    tMatrixNxN<float, 4> t = Transpose( a );
+    return simd_matrix4_transform(&t, (vec4x32)b);
+  }
+
+  KFORCE_INLINE tVectorN<float, 4> Transform( const tMatrixNxN<float, 4> &m, const tVectorN<float, 4> &v )
+  {
+    return simd_matrix4_transform(&m, (vec4x32)v);
+  }
+
+  KFORCE_INLINE tVectorN<float, 4> QuaternionMultiply( const tVectorN<float, 4> &a, const tVectorN<float, 4> &b )
+  {
+    // a.w b + a.x (bw, -bz, by, -bx) + a.y (bz, bw, -bx, -by) + a.z (-by, bx, bw, -bz)
+    vec4x32 qa = a, qb = b;
+    vec4x32 r = simd_mul(simd_splat_w(qa), qb);
+    r = simd_add(r, simd_mul(simd_mul(simd_splat_x(qa), simd_swizzle_wzyx(qb)), simd_set(1.f, -1.f, 1.f, -1.f)));
+    r = simd_add(r, simd_mul(simd_mul(simd_splat_y(qa), simd_swizzle_zwxy(qb)), simd_set(1.f, 1.f, -1.f, -1.f)));
+    return simd_add(r, simd_mul(simd_mul(simd_splat_z(qa), simd_swizzle_yxwz(qb)), simd_set(-1.f, 1.f, 1.f, -1.f)));
+  }
+
+  KFORCE_INLINE tVectorN<float, 4> QuaternionConjugate( const tVectorN<float, 4> &q )
+  {
+    return simd_mul((vec4x32)q, simd_set(-1.f, -1.f, -1.f, 1.f));
+  }
+
+  KFORCE_INLINE tVectorN<float, 4> QuaternionRotate( const tVectorN<float, 4> &q, const tVectorN<float, 4> &v )
+  {
+    tVectorN<float, 4> r = QuaternionMultiply( QuaternionMultiply( q, simd_mul((vec4x32)v, simd_set(1.f, 1.f, 1.f, 0.f)) ), QuaternionConjugate( q ) );
+    r[ 3 ] = v[ 3 ];
+    return r;
+  }
+
+  KFORCE_INLINE tMatrixNxN<float, 4> QuaternionToMatrix( const tVectorN<float, 4> &q )
+  {
+    // 2 q q^T, then the columns pick and combine its terms
+    vec4x32 v = q, v2 = simd_add(v, v);
+    vec4x32 xx = simd_mul(simd_splat_x(v), v2), yy = simd_mul(simd_splat_y(v), v2);
+    vec4x32 zz = simd_mul(simd_splat_z(v), v2), ww = simd_mul(simd_splat_w(v), v2);
+    float x2[4], y2[4], z2[4], w2[4];
+    simd_store(x2, xx); simd_store(y2, yy); simd_store(z2, zz); simd_store(w2, ww);
+    tMatrixNxN<float, 4> result;
+    result[ 0 ] = tVectorN<float, 4>( 1.f - (y2[1] + z2[2]), x2[1] + w2[2], x2[2] - w2[1], 0.f );
+    result[ 1 ] = tVectorN<float, 4>( x2[1] - w2[2], 1.f - (x2[0] + z2[2]), y2[2] + w2[0], 0.f );
+    result[ 2 ] = tVectorN<float, 4>( x2[2] + w2[1], y2[2] - w2[0], 1.f - (x2[0] + y2[1]), 0.f );
+    result[ 3 ] = tVectorN<float, 4>( 0.f, 0.f, 0.f, 1.f );
+    return result;
+  }
+
+  // "avx", "sse4.1", "sse2" or "neon"
+  KFORCE_INLINE const char * GetSIMDBackend()
+  {
+#if K3D_MATH_NEON
+    return "neon";
+#elif defined(__AVX__)
+    return "avx";
+#elif defined(__SSE4_1__)
+    return "sse4.1";
+#else
+    return "sse2";
+#endif
+  }
+
 NS_MATHLIB_END
 
+#endif
@@ -0,0 +1,559 @@
+#include "Kaleido3D.h"
+#include "Animation.h"
+#include "Dispatch/ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define K3D_ANIMATION_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace k3d
+{
+	namespace Animation
+	{
+		namespace
+		{
+			/// smallest three components lie in [-1/sqrt(2), 1/sqrt(2)], 15 bits each
+			const float kRotationStep = 1.41421356f / 32767.0f;
+			const float kRotationBias = -0.70710678f;
+			const uint32 kRotationMask = 0x7fff;
+			/// largest component w, the others within a step of 0
+			const uint16 kIdentityRotation[3] = { 0x8000 | 16384, 0x8000 | 16384, 16384 };
+
+			void EncodeRotation(const float * q, uint16 * values)
+			{
+				uint32 largest = 0;
+				for (uint32 i = 1; i < 4; i++)
+				{
+					if (fabsf(q[i]) > fabsf(q[largest]))
+						largest = i;
+				}
+				// q and -q are the same rotation, the dropped component is positive
+				float sign = q[largest] < 0.0f ? -1.0f : 1.0f;
+				for (uint32 i = 0, c = 0; i < 4; i++)
+				{
+					if (i == largest)
+						continue;
+					float v = roundf((sign * q[i] - kRotationBias) / kRotationStep);
+					values[c++] = (uint16)std::min(std::max(v, 0.0f), (float)kRotationMask);
+				}
+				values[0] |= (largest & 1) << 15;
+				values[1] |= (largest >> 1) << 15;
+			}
+
+			void DecodeRotation(const uint16 * values, float * q)
+			{
+				uint32 largest = (values[0] >> 15) | ((values[1] >> 15) << 1);
+				float c[3];
+				for (uint32 i = 0; i < 3; i++)
+					c[i] = (values[i] & kRotationMask) * kRotationStep + kRotationBias;
+				float w = sqrtf(std::max(0.0f, 1.0f - (c[0] * c[0] + c[1] * c[1] + c[2] * c[2])));
+				for (uint32 i = 0, k = 0; i < 4; i++)
+					q[i] = i == largest ? w : c[k++];
+			}
+
+			/// nlerp on the shorter arc
+			void InterpolateRotation(const float * a, const float * b, float alpha, float * q)
+			{
+				float dot = a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3];
+				float beta = dot < 0.0f ? -alpha : alpha;
+				for (uint32 i = 0; i < 4; i++)
+					q[i] = a[i] * (1.0f - alpha) + b[i] * beta;
+				float length = sqrtf(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+				for (uint32 i = 0; i < 4; i++)
+					q[i] = q[i] / length;
+			}
+
+			/// \brief displacement of a point 'radius' away, 2 r sin(angle / 2). With
+			/// the chord d = |a - b| on the near hemisphere, 1 - dot^2 is
+			/// d^2 / 2 (2 - d^2 / 2), which keeps small angles out of float noise.
+			float RotationError(const float * a, const float * b, float radius)
+			{
+				float dot = a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3];
+				float sign = dot < 0.0f ? -1.0f : 1.0f, chord = 0.0f;
+				for (uint32 i = 0; i < 4; i++)
+					chord += (a[i] - sign * b[i]) * (a[i] - sign * b[i]);
+				return 2.0f * radius * sqrtf(std::max(0.0f, chord * 0.5f * (2.0f - chord * 0.5f)));
+			}
+
+			/// \brief keys of a track of 'numFrames' frames: each key is placed as far
+			/// from the one before as 'error(first, last, frame)' allows for every
+			/// frame between them. Quantization is part of the error, so a track
+			/// constant after quantization keeps one key.
+			template <class Error>
+			void ReduceTrack(uint32 numFrames, float maxError, bool reduce, Error error, std::vector<uint32> & keys)
+			{
+				keys.assign(1, 0);
+				bool constant = reduce;
+				for (uint32 f = 0; f < numFrames && constant; f++)
+					constant = error(0, 0, f) <= maxError;
+				if (constant)
+					return;
+				for (uint32 first = 0; first + 1 < numFrames; )
+				{
+					uint32 last = first + 1;
+					while (reduce && last + 1 < numFrames)
+					{
+						bool fits = true;
+						for (uint32 f = first + 1; f <= last && fits; f++)
+							fits = error(first, last + 1, f) <= maxError;
+						if (!fits)
+							break;
+						last++;
+					}
+					keys.push_back(last);
+					first = last;
+				}
+			}
+
+			inline float Alpha(uint32 first, uint32 last, uint32 frame)
+			{
+				return last > first ? (float)(frame - first) / (last - first) : 0.0f;
+			}
+		}
+
+		void Pose::Resize(uint32 numBones)
+		{
+			if (numBones == m_NumBones && !m_Data.empty())
+				return;
+			m_NumBones = numBones;
+			Transform4 identity = {};
+			for (uint32 i = 0; i < 4; i++)
+				identity.RotW[i] = 1.0f;
+			m_Data.assign((numBones + 3) / 4, identity);
+		}
+
+		Transform Pose::GetTransform(uint32 bone) const
+		{
+			Transform4 const& t = m_Data[bone / 4];
+			uint32 i = bone % 4;
+			return { { t.RotX[i], t.RotY[i], t.RotZ[i], t.RotW[i] }, { t.PosX[i], t.PosY[i], t.PosZ[i] } };
+		}
+
+		void Pose::SetTransform(uint32 bone, Transform const& transform)
+		{
+			Transform4 & t = m_Data[bone / 4];
+			uint32 i = bone % 4;
+			t.RotX[i] = transform.Rotation[0];
+			t.RotY[i] = transform.Rotation[1];
+			t.RotZ[i] = transform.Rotation[2];
+			t.RotW[i] = transform.Rotation[3];
+			t.PosX[i] = transform.Translation[0];
+			t.PosY[i] = transform.Translation[1];
+			t.PosZ[i] = transform.Translation[2];
+		}
+
+#if K3D_ANIMATION_SSE2
+		namespace
+		{
+			inline __m128 Select(__m128 mask, __m128 a, __m128 b)
+			{
+				return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+			}
+
+			/// DecodeRotation of 4 keys, the 3 values of lane i at values[c * 4 + i]
+			void DecodeRotation4(const int32 * values, __m128 * q)
+			{
+				__m128i v0 = _mm_loadu_si128((const __m128i *)values);
+				__m128i v1 = _mm_loadu_si128((const __m128i *)(values + 4));
+				__m128i v2 = _mm_loadu_si128((const __m128i *)(values + 8));
+				__m128i largest = _mm_or_si128(_mm_srli_epi32(v0, 15), _mm_slli_epi32(_mm_srli_epi32(v1, 15), 1));
+				__m128i mask = _mm_set1_epi32((int)kRotationMask);
+				__m128 step = _mm_set1_ps(kRotationStep), bias = _mm_set1_ps(kRotationBias);
+				__m128 c0 = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(v0, mask)), step), bias);
+				__m128 c1 = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(v1, mask)), step), bias);
+				__m128 c2 = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(v2, mask)), step), bias);
+				__m128 sum = _mm_add_ps(_mm_add_ps(_mm_mul_ps(c0, c0), _mm_mul_ps(c1, c1)), _mm_mul_ps(c2, c2));
+				__m128 w = _mm_sqrt_ps(_mm_max_ps(_mm_setzero_ps(), _mm_sub_ps(_mm_set1_ps(1.0f), sum)));
+				__m128 is0 = _mm_castsi128_ps(_mm_cmpeq_epi32(largest, _mm_setzero_si128()));
+				__m128 is1 = _mm_castsi128_ps(_mm_cmpeq_epi32(largest, _mm_set1_epi32(1)));
+				__m128 is2 = _mm_castsi128_ps(_mm_cmpeq_epi32(largest, _mm_set1_epi32(2)));
+				__m128 is3 = _mm_castsi128_ps(_mm_cmpeq_epi32(largest, _mm_set1_epi32(3)));
+				q[0] = Select(is0, w, c0);
+				q[1] = Select(is0, c0, Select(is1, w, c1));
+				q[2] = Select(_mm_or_ps(is0, is1), c1, Select(is2, w, c2));
+				q[3] = Select(is3, w, c2);
+			}
+
+			/// InterpolateRotation of 4 lanes
+			void InterpolateRotation4(__m128 const * a, __m128 const * b, __m128 alpha, __m128 * q)
+			{
+				__m128 dot = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(a[0], b[0]), _mm_mul_ps(a[1], b[1])), _mm_mul_ps(a[2], b[2])), _mm_mul_ps(a[3], b[3]));
+				__m128 beta = Select(_mm_cmplt_ps(dot, _mm_setzero_ps()), _mm_xor_ps(alpha, _mm_set1_ps(-0.0f)), alpha);
+				__m128 inverse = _mm_sub_ps(_mm_set1_ps(1.0f), alpha);
+				for (uint32 i = 0; i < 4; i++)
+					q[i] = _mm_add_ps(_mm_mul_ps(a[i], inverse), _mm_mul_ps(b[i], beta));
+				__m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(q[0], q[0]), _mm_mul_ps(q[1], q[1])), _mm_mul_ps(q[2], q[2])), _mm_mul_ps(q[3], q[3])));
+				for (uint32 i = 0; i < 4; i++)
+					q[i] = _mm_div_ps(q[i], length);
+			}
+		}
+#endif
+
+		/// \brief samples clips. Key lookup is scalar, decoding and interpolation
+		/// run on 4 bones at once; both paths take the same steps.
+		struct Sampler
+		{
+			/// keys around 'position' of 'track', alpha of the second
+			static void Locate(Clip const& clip, uint32 track, float position, uint32 & k0, uint32 & k1, float & alpha)
+			{
+				Clip::Track const& t = clip.m_Tracks[track];
+				k0 = k1 = t.FirstKey;
+				alpha = 0.0f;
+				if (t.NumKeys == 1)
+					return;
+				const uint16 * frames = clip.m_KeyFrames.data() + t.FirstKey;
+				uint32 i = (uint32)(std::upper_bound(frames, frames + t.NumKeys, (uint16)position) - frames) - 1;
+				if (i + 1 >= t.NumKeys)
+				{
+					k0 = k1 = t.FirstKey + t.NumKeys - 1;
+					return;
+				}
+				k0 = t.FirstKey + i;
+				k1 = k0 + 1;
+				alpha = (position - frames[i]) / (frames[i + 1] - frames[i]);
+			}
+
+			static void SampleScalar(Clip const& clip, float position, Pose & pose)
+			{
+				uint32 numBones = clip.m_NumBones;
+				const uint16 * values = clip.m_Values.data();
+				for (uint32 b = 0; b < numBones; b++)
+				{
+					Transform transform;
+					uint32 k0, k1;
+					float alpha, q0[4], q1[4];
+					Locate(clip, b, position, k0, k1, alpha);
+					DecodeRotation(values + k0 * 3, q0);
+					DecodeRotation(values + k1 * 3, q1);
+					InterpolateRotation(q0, q1, alpha, transform.Rotation);
+					Locate(clip, numBones + b, position, k0, k1, alpha);
+					const float * range = &clip.m_Ranges[b * 6];
+					for (uint32 c = 0; c < 3; c++)
+					{
+						float t0 = range[c] + values[k0 * 3 + c] * range[3 + c];
+						float t1 = range[c] + values[k1 * 3 + c] * range[3 + c];
+						transform.Translation[c] = t0 * (1.0f - alpha) + t1 * alpha;
+					}
+					pose.SetTransform(b, transform);
+				}
+			}
+
+#if K3D_ANIMATION_SSE2
+			static void SampleSse(Clip const& clip, float position, Pose & pose)
+			{
+				uint32 numBones = clip.m_NumBones;
+				const uint16 * values = clip.m_Values.data();
+				Transform4 * data = pose.GetData();
+				for (uint32 group = 0; group * 4 < numBones; group++)
+				{
+					// the keys of the 4 bones, unused lanes decode to the identity
+					int32 r0[12], r1[12], t0[12], t1[12];
+					float rotationAlpha[4], translationAlpha[4], minimum[12], step[12];
+					for (uint32 lane = 0; lane < 4; lane++)
+					{
+						uint32 b = group * 4 + lane, k0, k1;
+						if (b >= numBones)
+						{
+							for (uint32 c = 0; c < 3; c++)
+							{
+								r0[c * 4 + lane] = r1[c * 4 + lane] = kIdentityRotation[c];
+								t0[c * 4 + lane] = t1[c * 4 + lane] = 0;
+								minimum[c * 4 + lane] = step[c * 4 + lane] = 0.0f;
+							}
+							rotationAlpha[lane] = translationAlpha[lane] = 0.0f;
+							continue;
+						}
+						Locate(clip, b, position, k0, k1, rotationAlpha[lane]);
+						for (uint32 c = 0; c < 3; c++)
+						{
+							r0[c * 4 + lane] = values[k0 * 3 + c];
+							r1[c * 4 + lane] = values[k1 * 3 + c];
+						}
+						Locate(clip, numBones + b, position, k0, k1, translationAlpha[lane]);
+						for (uint32 c = 0; c < 3; c++)
+						{
+							t0[c * 4 + lane] = values[k0 * 3 + c];
+							t1[c * 4 + lane] = values[k1 * 3 + c];
+							minimum[c * 4 + lane] = clip.m_Ranges[b * 6 + c];
+							step[c * 4 + lane] = clip.m_Ranges[b * 6 + 3 + c];
+						}
+					}
+					__m128 q0[4], q1[4], q[4];
+					DecodeRotation4(r0, q0);
+					DecodeRotation4(r1, q1);
+					InterpolateRotation4(q0, q1, _mm_loadu_ps(rotationAlpha), q);
+					// padding stays the exact identity
+					__m128 used = _mm_castsi128_ps(_mm_cmplt_epi32(_mm_setr_epi32(0, 1, 2, 3), _mm_set1_epi32((int)(numBones - group * 4))));
+					for (uint32 i = 0; i < 4; i++)
+						q[i] = _mm_and_ps(used, q[i]);
+					q[3] = Select(used, q[3], _mm_set1_ps(1.0f));
+					Transform4 & out = data[group];
+					_mm_storeu_ps(out.RotX, q[0]);
+					_mm_storeu_ps(out.RotY, q[1]);
+					_mm_storeu_ps(out.RotZ, q[2]);
+					_mm_storeu_ps(out.RotW, q[3]);
+					__m128 alpha = _mm_loadu_ps(translationAlpha), inverse = _mm_sub_ps(_mm_set1_ps(1.0f), alpha);
+					float * positions[3] = { out.PosX, out.PosY, out.PosZ };
+					for (uint32 c = 0; c < 3; c++)
+					{
+						__m128 lo = _mm_loadu_ps(minimum + c * 4), s = _mm_loadu_ps(step + c * 4);
+						__m128 a = _mm_add_ps(lo, _mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *)(t0 + c * 4))), s));
+						__m128 b = _mm_add_ps(lo, _mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *)(t1 + c * 4))), s));
+						_mm_storeu_ps(positions[c], _mm_add_ps(_mm_mul_ps(a, inverse), _mm_mul_ps(b, alpha)));
+					}
+				}
+			}
+#endif
+		};
+
+		Clip::Clip()
+			: m_NumBones(0)
+			, m_NumFrames(0)
+			, m_SampleRate(30.0f)
+		{
+		}
+
+		bool Clip::Build(Transform const * frames, uint32 numFrames, uint32 numBones, float sampleRate, Options const& options, Stats * stats)
+		{
+			if (!numFrames || !numBones || numFrames > 65536 || sampleRate <= 0.0f)
+				return false;
+			auto start = std::chrono::high_resolution_clock::now();
+			m_NumBones = numBones;
+			m_NumFrames = numFrames;
+			m_SampleRate = sampleRate;
+			m_Tracks.resize(numBones * 2);
+			m_Ranges.resize(numBones * 6);
+			std::vector<uint16> keyFrames[2], keyValues[2];
+			std::vector<uint16> quantized(numFrames * 3);
+			std::vector<float> raw(numFrames * 4), decoded(numFrames * 4);
+			std::vector<uint32> keys;
+
+			for (uint32 b = 0; b < numBones; b++)
+			{
+				// rotations, normalized
+				for (uint32 f = 0; f < numFrames; f++)
+				{
+					const float * q = frames[f * numBones + b].Rotation;
+					float length = sqrtf(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+					for (uint32 i = 0; i < 4; i++)
+						raw[f * 4 + i] = length > 0.0f ? q[i] / length : (i == 3 ? 1.0f : 0.0f);
+					EncodeRotation(&raw[f * 4], &quantized[f * 3]);
+					DecodeRotation(&quantized[f * 3], &decoded[f * 4]);
+				}
+				ReduceTrack(numFrames, options.MaxError, options.ReduceKeys, [&](uint32 first, uint32 last, uint32 frame)
+				{
+					float q[4];
+					InterpolateRotation(&decoded[first * 4], &decoded[last * 4], Alpha(first, last, frame), q);
+					return RotationError(q, &raw[frame * 4], options.Radius);
+				}, keys);
+				m_Tracks[b] = { (uint32)keyFrames[0].size(), (uint32)keys.size() };
+				for (uint32 key : keys)
+				{
+					keyFrames[0].push_back((uint16)key);
+					keyValues[0].insert(keyValues[0].end(), &quantized[key * 3], &quantized[key * 3] + 3);
+				}
+
+				// translations, 16 bits in the range of the track
+				float * range = &m_Ranges[b * 6];
+				for (uint32 c = 0; c < 3; c++)
+				{
+					float lo = frames[b].Translation[c], hi = lo;
+					for (uint32 f = 1; f < numFrames; f++)
+					{
+						lo = std::min(lo, frames[f * numBones + b].Translation[c]);
+						hi = std::max(hi, frames[f * numBones + b].Translation[c]);
+					}
+					range[c] = lo;
+					range[3 + c] = (hi - lo) / 65535.0f;
+				}
+				for (uint32 f = 0; f < numFrames; f++)
+				{
+					for (uint32 c = 0; c < 3; c++)
+					{
+						float t = frames[f * numBones + b].Translation[c];
+						float v = range[3 + c] > 0.0f ? roundf((t - range[c]) / range[3 + c]) : 0.0f;
+						quantized[f * 3 + c] = (uint16)std::min(std::max(v, 0.0f), 65535.0f);
+						decoded[f * 4 + c] = range[c] + quantized[f * 3 + c] * range[3 + c];
+					}
+				}
+				ReduceTrack(numFrames, options.MaxError, options.ReduceKeys, [&](uint32 first, uint32 last, uint32 frame)
+				{
+					float alpha = Alpha(first, last, frame), error = 0.0f;
+					for (uint32 c = 0; c < 3; c++)
+					{
+						float d = decoded[first * 4 + c] * (1.0f - alpha) + decoded[last * 4 + c] * alpha - frames[frame * numBones + b].Translation[c];
+						error += d * d;
+					}
+					return sqrtf(error);
+				}, keys);
+				m_Tracks[numBones + b] = { (uint32)keyFrames[1].size(), (uint32)keys.size() };
+				for (uint32 key : keys)
+				{
+					keyFrames[1].push_back((uint16)key);
+					keyValues[1].insert(keyValues[1].end(), &quantized[key * 3], &quantized[key * 3] + 3);
+				}
+			}
+
+			// translation keys follow the rotation keys
+			uint32 rotationKeys = (uint32)keyFrames[0].size();
+			for (uint32 b = 0; b < numBones; b++)
+				m_Tracks[numBones + b].FirstKey += rotationKeys;
+			m_KeyFrames = keyFrames[0];
+			m_KeyFrames.insert(m_KeyFrames.end(), keyFrames[1].begin(), keyFrames[1].end());
+			m_Values = keyValues[0];
+			m_Values.insert(m_Values.end(), keyValues[1].begin(), keyValues[1].end());
+
+			if (stats)
+			{
+				stats->RawBytes = (uint64)numFrames * numBones * sizeof(Transform);
+				stats->Bytes = GetSize();
+				stats->RawKeys = numFrames * numBones * 2;
+				stats->Keys = (uint32)m_KeyFrames.size();
+				// measured on the sampled poses
+				stats->MaxError = 0.0f;
+				Pose pose;
+				for (uint32 f = 0; f < numFrames; f++)
+				{
+					pose.Resize(numBones);
+					Sampler::SampleScalar(*this, (float)f, pose);
+					for (uint32 b = 0; b < numBones; b++)
+					{
+						Transform sampled = pose.GetTransform(b);
+						Transform const& source = frames[f * numBones + b];
+						float q[4], length = sqrtf(source.Rotation[0] * source.Rotation[0] + source.Rotation[1] * source.Rotation[1]
+							+ source.Rotation[2] * source.Rotation[2] + source.Rotation[3] * source.Rotation[3]);
+						for (uint32 i = 0; i < 4; i++)
+							q[i] = source.Rotation[i] / length;
+						float d[3] = { sampled.Translation[0] - source.Translation[0], sampled.Translation[1] - source.Translation[1],
+							sampled.Translation[2] - source.Translation[2] };
+						stats->MaxError = std::max(stats->MaxError, RotationError(sampled.Rotation, q, options.Radius));
+						stats->MaxError = std::max(stats->MaxError, sqrtf(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]));
+					}
+				}
+				stats->Milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+			}
+			return true;
+		}
+
+		uint64 Clip::GetSize() const
+		{
+			return sizeof(Clip) + m_Tracks.size() * sizeof(Track) + m_KeyFrames.size() * sizeof(uint16)
+				+ m_Values.size() * sizeof(uint16) + m_Ranges.size() * sizeof(float);
+		}
+
+		void Clip::Sample(float time, Pose & pose, bool scalar) const
+		{
+			pose.Resize(m_NumBones);
+			float position = std::min(std::max(time * m_SampleRate, 0.0f), (float)(m_NumFrames - 1));
+#if K3D_ANIMATION_SSE2
+			if (!scalar)
+			{
+				Sampler::SampleSse(*this, position, pose);
+				return;
+			}
+#endif
+			K3D_UNUSED(scalar);
+			Sampler::SampleScalar(*this, position, pose);
+		}
+
+		void Blend(Pose const& a, Pose const& b, float weight, Pose & result, bool scalar)
+		{
+			result.Resize(a.GetNumBones());
+			uint32 groups = (a.GetNumBones() + 3) / 4;
+			Transform4 const * pa = a.GetData(), * pb = b.GetData();
+			Transform4 * out = result.GetData();
+#if K3D_ANIMATION_SSE2
+			if (!scalar)
+			{
+				__m128 alpha = _mm_set1_ps(weight), inverse = _mm_set1_ps(1.0f - weight);
+				for (uint32 g = 0; g < groups; g++)
+				{
+					__m128 qa[4] = { _mm_loadu_ps(pa[g].RotX), _mm_loadu_ps(pa[g].RotY), _mm_loadu_ps(pa[g].RotZ), _mm_loadu_ps(pa[g].RotW) };
+					__m128 qb[4] = { _mm_loadu_ps(pb[g].RotX), _mm_loadu_ps(pb[g].RotY), _mm_loadu_ps(pb[g].RotZ), _mm_loadu_ps(pb[g].RotW) };
+					__m128 q[4];
+					InterpolateRotation4(qa, qb, alpha, q);
+					__m128 ta[3] = { _mm_loadu_ps(pa[g].PosX), _mm_loadu_ps(pa[g].PosY), _mm_loadu_ps(pa[g].PosZ) };
+					__m128 tb[3] = { _mm_loadu_ps(pb[g].PosX), _mm_loadu_ps(pb[g].PosY), _mm_loadu_ps(pb[g].PosZ) };
+					_mm_storeu_ps(out[g].RotX, q[0]);
+					_mm_storeu_ps(out[g].RotY, q[1]);
+					_mm_storeu_ps(out[g].RotZ, q[2]);
+					_mm_storeu_ps(out[g].RotW, q[3]);
+					_mm_storeu_ps(out[g].PosX, _mm_add_ps(_mm_mul_ps(ta[0], inverse), _mm_mul_ps(tb[0], alpha)));
+					_mm_storeu_ps(out[g].PosY, _mm_add_ps(_mm_mul_ps(ta[1], inverse), _mm_mul_ps(tb[1], alpha)));
+					_mm_storeu_ps(out[g].PosZ, _mm_add_ps(_mm_mul_ps(ta[2], inverse), _mm_mul_ps(tb[2], alpha)));
+				}
+				return;
+			}
+#endif
+			K3D_UNUSED(scalar);
+			for (uint32 bone = 0; bone < a.GetNumBones(); bone++)
+			{
+				Transform ta = a.GetTransform(bone), tb = b.GetTransform(bone), t;
+				InterpolateRotation(ta.Rotation, tb.Rotation, weight, t.Rotation);
+				for (uint32 c = 0; c < 3; c++)
+					t.Translation[c] = ta.Translation[c] * (1.0f - weight) + tb.Translation[c] * weight;
+				result.SetTransform(bone, t);
+			}
+		}
+
+		void LocalToModel(Pose const& pose, const int32 * parents, kMath::Mat4f * model)
+		{
+			for (uint32 bone = 0; bone < pose.GetNumBones(); bone++)
+			{
+				Transform t = pose.GetTransform(bone);
+				float x = t.Rotation[0], y = t.Rotation[1], z = t.Rotation[2], w = t.Rotation[3];
+				kMath::Mat4f local;
+				local[0] = { 1.0f - 2.0f * (y * y + z * z), 2.0f * (x * y + w * z), 2.0f * (x * z - w * y), 0.0f };
+				local[1] = { 2.0f * (x * y - w * z), 1.0f - 2.0f * (x * x + z * z), 2.0f * (y * z + w * x), 0.0f };
+				local[2] = { 2.0f * (x * z + w * y), 2.0f * (y * z - w * x), 1.0f - 2.0f * (x * x + y * y), 0.0f };
+				local[3] = { t.Translation[0], t.Translation[1], t.Translation[2], 1.0f };
+				model[bone] = parents[bone] >= 0 ? model[parents[bone]] * local : local;
+			}
+		}
+
+		void Evaluate(Job const * jobs, uint32 count, bool scalar, Dispatch::ThreadPool * workers, EvaluateStats * stats)
+		{
+			auto start = std::chrono::high_resolution_clock::now();
+			Dispatch::ThreadPool & pool = workers ? *workers : Dispatch::ThreadPool::Global();
+			pool.ParallelFor(0, count, 16, [&](uint32 begin, uint32 end)
+			{
+				Pose other;
+				for (uint32 i = begin; i < end; i++)
+				{
+					Job const& job = jobs[i];
+					job.A->Sample(job.TimeA, *job.Target, scalar);
+					if (job.B && job.Weight > 0.0f)
+					{
+						job.B->Sample(job.TimeB, other, scalar);
+						Blend(*job.Target, other, job.Weight, *job.Target, scalar);
+					}
+				}
+			});
+			if (stats)
+			{
+				stats->Jobs = count;
+				stats->Samples = count;
+				for (uint32 i = 0; i < count; i++)
+				{
+					if (jobs[i].B && jobs[i].Weight > 0.0f)
+						stats->Samples++;
+				}
+				stats->Milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+			}
+		}
+
+		const char * GetKernel()
+		{
+#if K3D_ANIMATION_SSE2
+			return "sse2";
+#else
+			return "scalar";
+#endif
+		}
+	}
+}
@@ -0,0 +1,170 @@
+#ifndef __Animation_h__
+#define __Animation_h__
+#pragma once
+
+#include <Math/kMath.hpp>
+#include <Math/kGeometry.hpp>
+#include <vector>
+
+namespace Dispatch
+{
+	class	ThreadPool;
+}
+
+namespace k3d
+{
+	/// Skeletal animation clips compressed per track and sampled into local
+	/// poses. Rotations are stored as smallest three quaternions in 48 bits,
+	/// translations as 16 bits per component in the range of their track, and
+	/// every track keeps only the keys it needs to stay within an error bound.
+	/// Poses are structure of arrays of 4 bones so sampling and blending run
+	/// on SSE2 where the build targets it, characters in parallel on a
+	/// thread pool.
+	namespace Animation
+	{
+		struct Transform
+		{
+			/// unit quaternion x, y, z, w
+			float	Rotation[4];
+			float	Translation[3];
+		};
+
+		/// 4 bones, structure of arrays
+		struct Transform4
+		{
+			float	RotX[4], RotY[4], RotZ[4], RotW[4];
+			float	PosX[4], PosY[4], PosZ[4];
+		};
+
+		/// \brief local transforms of the bones of a skeleton, padded to a
+		/// multiple of 4 with identities
+		class K3D_API Pose
+		{
+		public:
+			Pose() : m_NumBones(0) {}
+
+			void				Resize(uint32 numBones);
+			uint32				GetNumBones() const { return m_NumBones; }
+			Transform			GetTransform(uint32 bone) const;
+			void				SetTransform(uint32 bone, Transform const& transform);
+
+			Transform4 *		GetData() { return m_Data.data(); }
+			Transform4 const *	GetData() const { return m_Data.data(); }
+
+		private:
+			uint32					m_NumBones;
+			std::vector<Transform4>	m_Data;
+		};
+
+		/// \brief a compressed clip of uniformly sampled local transforms
+		class K3D_API Clip
+		{
+		public:
+			struct Options
+			{
+				/// largest error of a sampled transform at a key frame of the
+				/// source: distance for translations, displacement of a point
+				/// Radius away from the bone for rotations
+				float	MaxError;
+				float	Radius;
+				/// false keeps every frame, quantized
+				bool	ReduceKeys;
+
+				Options()
+					: MaxError(0.0005f)
+					, Radius(0.2f)
+					, ReduceKeys(true)
+				{
+				}
+			};
+
+			struct Stats
+			{
+				/// of the float transforms of every frame
+				uint64	RawBytes;
+				/// of the compressed clip, GetSize()
+				uint64	Bytes;
+				uint32	RawKeys;
+				/// rotation and translation keys kept
+				uint32	Keys;
+				/// largest error at the source frames, in the units of MaxError
+				float	MaxError;
+				double	Milliseconds;
+			};
+
+			Clip();
+
+			/// \param frames numFrames x numBones transforms, frame by frame
+			/// \return false without frames or bones, or above 65536 frames
+			bool				Build(Transform const * frames, uint32 numFrames, uint32 numBones, float sampleRate,
+									Options const& options = Options(), Stats * stats = nullptr);
+
+			uint32				GetNumBones() const { return m_NumBones; }
+			float				GetDuration() const { return m_NumFrames > 1 ? (m_NumFrames - 1) / m_SampleRate : 0.0f; }
+			/// bytes of the compressed data
+			uint64				GetSize() const;
+
+			/// \brief the pose at 'time', clamped to the clip, resized to GetNumBones()
+			/// \param scalar the scalar reference, for comparison
+			void				Sample(float time, Pose & pose, bool scalar = false) const;
+
+		private:
+			friend struct Sampler;
+
+			struct Track
+			{
+				uint32	FirstKey;
+				uint32	NumKeys;
+			};
+
+			uint32					m_NumBones;
+			uint32					m_NumFrames;
+			float					m_SampleRate;
+			/// rotation tracks then translation tracks, NumBones each
+			std::vector<Track>		m_Tracks;
+			/// frame of every key, ascending per track
+			std::vector<uint16>		m_KeyFrames;
+			/// 3 per key, rotation keys then translation keys
+			std::vector<uint16>		m_Values;
+			/// minimum and quantization step of the 3 components of every translation track
+			std::vector<float>		m_Ranges;
+		};
+
+		/// nlerp of the rotations and lerp of the translations, 'weight' of 'b'
+		K3D_API void	Blend(Pose const& a, Pose const& b, float weight, Pose & result, bool scalar = false);
+
+		/// \brief model space matrices of 'pose', column major
+		/// \param parents the parent of every bone, before it, -1 for roots
+		K3D_API void	LocalToModel(Pose const& pose, const int32 * parents, kMath::Mat4f * model);
+
+		/// one character of a frame: A at TimeA, blended with B at TimeB if set
+		struct Job
+		{
+			Clip const *	A;
+			float			TimeA;
+			Clip const *	B;
+			float			TimeB;
+			/// of B
+			float			Weight;
+			Pose *			Target;
+		};
+
+		struct EvaluateStats
+		{
+			uint32	Jobs;
+			/// clips sampled, 2 for a blended job
+			uint32	Samples;
+			double	Milliseconds;
+		};
+
+		/// \brief samples and blends every job, clips of a job must have the same bones
+		/// \param workers the global pool if null
+		K3D_API void	Evaluate(Job const * jobs, uint32 count, bool scalar = false,
+			Dispatch::ThreadPool * workers = nullptr, EvaluateStats * stats = nullptr);
+
+		/// "sse2" or "scalar"
+		K3D_API const char *	GetKernel();
+	}
+}
+
+#endif
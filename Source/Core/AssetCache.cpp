@@ -0,0 +1,265 @@
+#include "Kaleido3D.h"
+#include "AssetCache.h"
+#include "Os.h"
+#include "LogUtil.h"
+#include "Utils/farmhash.h"
+#include <vector>
+
+using namespace std;
+
+namespace k3d
+{
+	namespace
+	{
+		const uint32 kStampsMagic = 0x5453334B; // "K3ST"
+
+		AssetCacheKey ToKey(util::uint128_t hash)
+		{
+			return AssetCacheKey{ util::Uint128Low64(hash), util::Uint128High64(hash) };
+		}
+
+		kString ToHex(uint64 value)
+		{
+			static const char digits[] = "0123456789abcdef";
+			kString hex(16, KT('0'));
+			for (int i = 15; i >= 0; i--, value >>= 4)
+				hex[i] = (kchar)digits[value & 0xf];
+			return hex;
+		}
+	}
+
+	AssetCache::AssetCache()
+		: m_StampsChanged(false)
+		, m_NumTemps(0)
+	{
+		memset(&m_Stats, 0, sizeof(m_Stats));
+	}
+
+	AssetCache::~AssetCache()
+	{
+		Close();
+	}
+
+	bool AssetCache::Open(const kchar * cacheDir)
+	{
+		Close();
+		if (!Os::Exists(cacheDir) && !Os::MakeDir(cacheDir))
+		{
+			KLOG(Error, AssetCache, "Cann't create cache directory (%s).", cacheDir);
+			return false;
+		}
+		m_Dir = cacheDir;
+		if (m_Dir.back() != KT('/') && m_Dir.back() != KT('\\'))
+			m_Dir += KT('/');
+		memset(&m_Stats, 0, sizeof(m_Stats));
+		LoadStamps();
+		return true;
+	}
+
+	void AssetCache::Close()
+	{
+		if (m_Dir.empty())
+			return;
+		if (m_StampsChanged)
+			SaveStamps();
+		m_Stamps.clear();
+		m_StampsChanged = false;
+		m_Dir.clear();
+	}
+
+	AssetCacheKey AssetCache::HashData(const void * data, size_t size)
+	{
+		return ToKey(util::Hash128((const char*)data, size));
+	}
+
+	AssetCacheKey AssetCache::MakeKey(AssetCacheKey const& source, const void * params, size_t size)
+	{
+		return ToKey(util::Hash128WithSeed((const char*)params, size, util::Uint128(source.Low, source.High)));
+	}
+
+	AssetCacheKey AssetCache::HashFile(const kchar * path)
+	{
+		Os::File file;
+		if (!file.Open(path, IORead))
+			return AssetCacheKey{ 0, 0 };
+		Stamp stamp = { (uint64)file.GetSize(), file.LastModified(), { 0, 0 } };
+		{
+			std::lock_guard<std::mutex> lock(m_Lock);
+			auto found = m_Stamps.find(path);
+			if (found != m_Stamps.end() && found->second.Size == stamp.Size
+				&& found->second.LastModified == stamp.LastModified)
+			{
+				m_Stats.FilesUnchanged++;
+				return found->second.Hash;
+			}
+		}
+		file.Close();
+		if (stamp.Size == 0)
+		{
+			stamp.Hash = HashData(nullptr, 0);
+		}
+		else
+		{
+			Os::MemMapFile map;
+			if (!map.Open(path, IORead))
+				return AssetCacheKey{ 0, 0 };
+			stamp.Hash = HashData(map.FileData(), (size_t)stamp.Size);
+		}
+		std::lock_guard<std::mutex> lock(m_Lock);
+		m_Stamps[path] = stamp;
+		m_StampsChanged = true;
+		m_Stats.FilesHashed++;
+		return stamp.Hash;
+	}
+
+	kString AssetCache::GetEntryPath(AssetCacheKey const& key) const
+	{
+		// 256 sub directories keep the directories small
+		kString high = ToHex(key.High);
+		return m_Dir + high.substr(0, 2) + KT("/") + high + ToHex(key.Low);
+	}
+
+	kString AssetCache::Find(AssetCacheKey const& key, AssetCacheEntry & entry)
+	{
+		if (m_Dir.empty())
+			return kString();
+		kString path = GetEntryPath(key);
+		Os::File file;
+		bool found = file.Open(path.c_str(), IORead)
+			&& file.ReadAt(&entry, sizeof(entry), 0) == sizeof(entry)
+			&& entry.Magic == kAssetCacheMagic
+			&& (uint64)file.GetSize() == sizeof(entry) + entry.Size;
+		std::lock_guard<std::mutex> lock(m_Lock);
+		if (!found)
+		{
+			m_Stats.Misses++;
+			return kString();
+		}
+		m_Stats.Hits++;
+		return path;
+	}
+
+	bool AssetCache::CreateTemp(AssetCacheKey const& key, Os::File & file, kString & tempPath)
+	{
+		if (m_Dir.empty())
+			return false;
+		{
+			std::lock_guard<std::mutex> lock(m_Lock);
+			tempPath = GetEntryPath(key) + KT(".") + ToHex(m_NumTemps++) + KT(".tmp");
+		}
+		if (file.Open(tempPath.c_str(), IOWrite))
+			return true;
+		// the sub directory is created with the first entry in it
+		Os::MakeDir((m_Dir + ToHex(key.High).substr(0, 2)).c_str());
+		return file.Open(tempPath.c_str(), IOWrite);
+	}
+
+	bool AssetCache::Store(AssetCacheKey const& key, AssetCacheEntry const& entry, const void * data)
+	{
+		Os::File file;
+		kString temp;
+		if (!CreateTemp(key, file, temp))
+			return false;
+		bool ok = file.WriteAt(&entry, sizeof(entry), 0) == sizeof(entry)
+			&& file.WriteAt(data, (size_t)entry.Size, sizeof(entry)) == entry.Size;
+		file.Close();
+		return Commit(key, temp, ok);
+	}
+
+	bool AssetCache::Store(AssetCacheKey const& key, AssetCacheEntry const& entry, const kchar * source, uint64 offset)
+	{
+		Os::File sourceFile;
+		Os::File file;
+		kString temp;
+		if (!sourceFile.Open(source, IORead) || !CreateTemp(key, file, temp))
+			return false;
+		bool ok = file.WriteAt(&entry, sizeof(entry), 0) == sizeof(entry)
+			&& file.CopyFrom(sourceFile, offset, (size_t)entry.Size, sizeof(entry)) == entry.Size;
+		file.Close();
+		return Commit(key, temp, ok);
+	}
+
+	bool AssetCache::Commit(AssetCacheKey const& key, kString const& tempPath, bool written)
+	{
+		// two writers of one key write the same bytes, the last rename wins
+		if (!written || !Os::Rename(tempPath.c_str(), GetEntryPath(key).c_str()))
+		{
+			Os::Remove(tempPath.c_str());
+			return false;
+		}
+		std::lock_guard<std::mutex> lock(m_Lock);
+		m_Stats.Stores++;
+		return true;
+	}
+
+	AssetCache::Stats AssetCache::GetStats() const
+	{
+		std::lock_guard<std::mutex> lock(m_Lock);
+		return m_Stats;
+	}
+
+	void AssetCache::LoadStamps()
+	{
+		Os::File file;
+		if (!file.Open((m_Dir + KT("stamps")).c_str(), IORead))
+			return;
+		uint64 size = (uint64)file.GetSize();
+		std::vector<kByte> data((size_t)size);
+		if (size < 2 * sizeof(uint32) || file.ReadAt(data.data(), data.size(), 0) != size)
+			return;
+		const kByte * cursor = data.data();
+		const kByte * end = cursor + size;
+		uint32 header[2];
+		memcpy(header, cursor, sizeof(header));
+		cursor += sizeof(header);
+		if (header[0] != kStampsMagic)
+			return;
+		// a truncated file loses the stamps after the damage, they are hashed again
+		for (uint32 i = 0; i < header[1]; i++)
+		{
+			uint32 length = 0;
+			if ((size_t)(end - cursor) < sizeof(length))
+				break;
+			memcpy(&length, cursor, sizeof(length));
+			cursor += sizeof(length);
+			if ((size_t)(end - cursor) < (uint64)length * sizeof(kchar) + sizeof(Stamp))
+				break;
+			kString path(length, KT('\0'));
+			memcpy(&path[0], cursor, length * sizeof(kchar));
+			cursor += length * sizeof(kchar);
+			Stamp stamp;
+			memcpy(&stamp, cursor, sizeof(stamp));
+			cursor += sizeof(stamp);
+			m_Stamps[path] = stamp;
+		}
+	}
+
+	void AssetCache::SaveStamps()
+	{
+		std::vector<kByte> data;
+		auto append = [&data](const void * bytes, size_t size)
+		{
+			data.insert(data.end(), (const kByte*)bytes, (const kByte*)bytes + size);
+		};
+		uint32 header[2] = { kStampsMagic, (uint32)m_Stamps.size() };
+		append(header, sizeof(header));
+		for (auto & stamp : m_Stamps)
+		{
+			uint32 length = (uint32)stamp.first.size();
+			append(&length, sizeof(length));
+			append(stamp.first.data(), length * sizeof(kchar));
+			append(&stamp.second, sizeof(stamp.second));
+		}
+		kString temp = m_Dir + KT("stamps.tmp");
+		Os::File file;
+		if (!file.Open(temp.c_str(), IOWrite))
+			return;
+		bool ok = file.WriteAt(data.data(), data.size(), 0) == data.size();
+		file.Close();
+		if (!ok || !Os::Rename(temp.c_str(), (m_Dir + KT("stamps")).c_str()))
+		{
+			KLOG(Error, AssetCache, "Failed to write stamps of (%s).", m_Dir.c_str());
+			Os::Remove(temp.c_str());
+		}
+	}
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace Os
+{
+	class	File;
+}
+
+namespace k3d
+{
+	/// \brief 128 bit content hash, see util::Hash128
+	struct AssetCacheKey
+	{
+		uint64	Low;
+		uint64	High;
+
+		bool operator==(AssetCacheKey const& rhs) const { return Low == rhs.Low && High == rhs.High; }
+		bool operator!=(AssetCacheKey const& rhs) const { return !(*this == rhs); }
+		bool IsValid() const { return Low != 0 || High != 0; }
+	};
+
+	struct AssetCacheKeyHash
+	{
+		size_t operator()(AssetCacheKey const& key) const { return (size_t)key.Low; }
+	};
+
+	/// \brief header of a cache entry file, the stored chunk bytes follow
+	struct AssetCacheEntry
+	{
+		uint32				Magic;
+		/// EChunkCompression
+		uint32				Compression;
+		/// stored and decoded size of the chunk
+		uint64				Size;
+		uint64				RawSize;
+		/// of the stored bytes, bundles store equal content once
+		AssetCacheKey		ContentHash;
+	};
+
+	const uint32 kAssetCacheMagic = 0x4843334B; // "K3CH"
+
+	/// \brief local content addressed store of processed chunks.
+	///
+	/// Entries are files named after the key of the input they were made from,
+	/// the key hashes the source content with every parameter of its
+	/// processing (MakeKey), so an entry never goes stale and is shared by
+	/// every bundle built from the same input. Source files are hashed once
+	/// per change, HashFile keeps their size and modification time in the
+	/// 'stamps' file of the cache directory.
+	/// Thread safe.
+	/// \class AssetCache
+	class K3D_API AssetCache
+	{
+	public:
+		struct Stats
+		{
+			uint32	Hits;
+			uint32	Misses;
+			uint32	Stores;
+			/// HashFile calls which read the file
+			uint32	FilesHashed;
+			uint32	FilesUnchanged;
+		};
+
+		AssetCache();
+		~AssetCache();
+
+		/// creates the directory if it doesn't exist
+		bool			Open(const kchar * cacheDir);
+		/// writes the stamps back
+		void			Close();
+		bool			IsOpen() const { return !m_Dir.empty(); }
+
+		/// content hash of a file, an invalid key if it can't be read
+		AssetCacheKey	HashFile(const kchar * path);
+		static AssetCacheKey	HashData(const void * data, size_t size);
+		/// key of 'source' processed with 'params'
+		static AssetCacheKey	MakeKey(AssetCacheKey const& source, const void * params, size_t size);
+
+		/// \param entry header of the cached entry, the stored bytes start at sizeof(AssetCacheEntry)
+		/// \return path of the entry, empty if there is none
+		kString			Find(AssetCacheKey const& key, AssetCacheEntry & entry);
+		/// data holds entry.Size bytes
+		bool			Store(AssetCacheKey const& key, AssetCacheEntry const& entry, const void * data);
+		/// copies entry.Size bytes of 'source' from 'offset'
+		bool			Store(AssetCacheKey const& key, AssetCacheEntry const& entry, const kchar * source, uint64 offset);
+
+		Stats			GetStats() const;
+
+	private:
+		struct Stamp
+		{
+			uint64			Size;
+			uint64			LastModified;
+			AssetCacheKey	Hash;
+		};
+
+		kString			GetEntryPath(AssetCacheKey const& key) const;
+		/// entries are written to a temporary file and renamed into place,
+		/// readers never see a partial entry
+		bool			CreateTemp(AssetCacheKey const& key, Os::File & file, kString & tempPath);
+		bool			Commit(AssetCacheKey const& key, kString const& tempPath, bool written);
+		void			LoadStamps();
+		void			SaveStamps();
+
+		kString									m_Dir;
+		mutable std::mutex						m_Lock;
+		std::unordered_map<kString, Stamp>		m_Stamps;
+		bool									m_StampsChanged;
+		Stats									m_Stats;
+		uint32									m_NumTemps;
+	};
+}
@@ -1,6 +1,10 @@
 #include "Kaleido3D.h"
 #include "AssetManager.h"
 #include "Os.h"
+#include "AsyncIO.h"
+#include "AssetReloader.h"
+#include "Bundle.h"
+#include "Dispatch/ThreadPool.h"
 #include "Core/LogUtil.h"
 #include "ImageData.h"
 #include "App.h"
@@ -26,7 +30,7 @@ namespace k3d
 
 	kString AssetManager::s_envAssetPath;
 
-	AssetManager::AssetManager()/* : m_pThreadPool(nullptr) */
+	AssetManager::AssetManager() : m_pAsyncIO(nullptr), m_pStreamer(nullptr), m_pReloader(nullptr)
 	{
 		m_IsLoading = false;
 		m_HasPendingObject = false;
@@ -35,10 +39,18 @@ namespace k3d
 
 	void AssetManager::Init()
 	{
-		/*if (m_pThreadPool == nullptr)
-			m_pThreadPool = new std::thread_pool(2);*/
+		if (m_pAsyncIO == nullptr)
+		{
+			m_pAsyncIO = new Os::AsyncIO;
+			m_pAsyncIO->Init();
+		}
+		if (m_pStreamer == nullptr)
+		{
+			m_pStreamer = new AssetStreamer(m_pAsyncIO, &Dispatch::ThreadPool::Global());
+		}
 
-		KLOG(Info, "AssetManager"," Initialized With two workers.");
+		KLOG(Info, "AssetManager", " Initialized With %s io backend.",
+			Os::AsyncIO::BackendName(m_pAsyncIO->GetBackend()));
 
 #if K3DPLATFORM_OS_WIN
 		kchar _path[2048] = { 0 };
@@ -46,17 +58,34 @@ namespace k3d
 		if (_len > 0) {
 			KLOG(Info, "AssetManager", "Kaleido3D_Dir Found. ");
 			s_envAssetPath = _path;
-			m_SearchPaths.push_back(_path);
+			AddSearchPath(_path);
 		}
 		else {
 			KLOG(Error, "AssetManager", "Kaleido3D_Dir Not Found.");
 		}
+#elif !K3DPLATFORM_OS_ANDROID
+		VFS().Mount(KT("asset"), std::make_shared<DirectoryMount>(KT("../../Data/")));
 #endif
-		//m_SearchPaths
 	}
 
 	void AssetManager::Shutdown()
 	{
+		if (m_pReloader)
+		{
+			delete m_pReloader;
+			m_pReloader = nullptr;
+		}
+		if (m_pStreamer)
+		{
+			delete m_pStreamer;
+			m_pStreamer = nullptr;
+		}
+		if (m_pAsyncIO)
+		{
+			m_pAsyncIO->Shutdown();
+			delete m_pAsyncIO;
+			m_pAsyncIO = nullptr;
+		}
 		KLOG(Info, "AssetManager", "Shutdown.");
 	}
 
@@ -78,6 +107,7 @@ namespace k3d
 		VSCIter pos = std::find(m_SearchPaths.begin(), m_SearchPaths.end(), kString(path));
 		if (pos == m_SearchPaths.end()) {
 			m_SearchPaths.push_back(kString(path));
+			VFS().Mount(KT(""), std::make_shared<DirectoryMount>(kString(path)));
 		}
 	}
 
@@ -156,31 +186,98 @@ namespace k3d
 	//		);
 	//}
 
+	StreamTicket AssetManager::AsyncLoadObject(const kchar * objPath, StreamRequest const& request)
+	{
+		if (m_pStreamer == nullptr)
+			return 0;
+		StreamRequest tracked = request;
+		tracked.OnComplete = [this, request](StreamResult const& result)
+		{
+			--m_NumPendingObject;
+			if (request.OnComplete)
+				request.OnComplete(result);
+		};
+		++m_NumPendingObject;
+		StreamTicket ticket = m_pStreamer->Load(objPath, tracked);
+		if (ticket == 0)
+			--m_NumPendingObject;
+		return ticket;
+	}
+
+	bool AssetManager::CancelLoad(StreamTicket ticket)
+	{
+		if (m_pStreamer == nullptr || !m_pStreamer->Cancel(ticket))
+			return false;
+		--m_NumPendingObject;
+		return true;
+	}
+
 	void AssetManager::CommitAsynResourceTask(const kchar *fileName, BytesPackage &bp, std::atomic<bool> &finished)
 	{
-		//auto result = m_pThreadPool->enqueue(
-		//	[&bp, &finished](const kchar *name)
-		//{
-		//	//    ++m_NumPendingObject;
-		//	MemMapFile file;
-		//	bool opened = file.Open(name, IORead);
-		//	if (opened)
-		//	{
-		//		int bytes_length = (int)file.GetSize();
-		//		bp.Bytes.reserve(bytes_length);
-		//		file.Read((char*)&bp.Bytes[0], bytes_length);
-		//		file.Close();
-		//	}
-		//	else
-		//	{
-		//		Log::Out(LogLevel::Error, "AssetManager", "CommitSynResourceTask failed. Cannot find file %s.", name);
-		//	}
-		//	finished.store(true, std::memory_order_release);
-
-		//	//    --m_NumPendingObject;
-		//},
-		//	fileName
-		//	);
+		if (m_pAsyncIO == nullptr)
+		{
+			CommitSynResourceTask(fileName, bp);
+			finished.store(true, std::memory_order_release);
+			return;
+		}
+		// the file stays open until the read has completed
+		auto file = std::make_shared<Os::File>();
+		if (!file->Open(fileName, IORead))
+		{
+			KLOG(Error, "AssetManager", "CommitAsynResourceTask failed. Cannot find file %s.", fileName);
+			finished.store(true, std::memory_order_release);
+			return;
+		}
+		int64 length = file->GetSize();
+		bp.Bytes.resize(length);
+		if (length == 0)
+		{
+			finished.store(true, std::memory_order_release);
+			return;
+		}
+		// AsyncIO takes requests of at most 2GB, larger files are read in pieces
+		const int64 kMaxPiece = 1ll << 30;
+		uint32 numPieces = (uint32)((length + kMaxPiece - 1) / kMaxPiece);
+		auto remaining = std::make_shared<std::atomic<uint32>>(numPieces);
+		++m_NumPendingObject;
+		auto complete = [this, file, remaining, &finished](uint32 count)
+		{
+			if (remaining->fetch_sub(count) != count)
+				return;
+			file->Close();
+			--m_NumPendingObject;
+			finished.store(true, std::memory_order_release);
+		};
+		for (uint32 piece = 0; piece < numPieces; piece++)
+		{
+			int64 offset = piece * kMaxPiece;
+			size_t size = (size_t)std::min(kMaxPiece, length - offset);
+			bool queued = m_pAsyncIO->QueueRead(file->GetNativeHandle(), bp.Bytes.data() + offset, size, offset, 0,
+				[size, complete](Os::AsyncIOResult const& result)
+			{
+				if (result.Result < 0 || (size_t)result.Result != size)
+				{
+					KLOG(Error, "AssetManager", "CommitAsynResourceTask read failed (%lld).", (long long)result.Result);
+				}
+				complete(1);
+			});
+			if (queued)
+				continue;
+			if (piece == 0)
+			{
+				// nothing is in flight, read it here instead
+				--m_NumPendingObject;
+				file->Close();
+				CommitSynResourceTask(fileName, bp);
+				finished.store(true, std::memory_order_release);
+				return;
+			}
+			KLOG(Error, "AssetManager", "CommitAsynResourceTask couldn't queue the read of %s.", fileName);
+			m_pAsyncIO->Submit();
+			complete(numPieces - piece);
+			return;
+		}
+		m_pAsyncIO->Submit();
 	}
 
 	void AssetManager::CommitSynResourceTask(const kchar *fileName, BytesPackage &bp)
@@ -203,6 +300,83 @@ namespace k3d
 		m_MeshMap[meshPtr->Name()] = meshPtr;
 	}
 
+	std::vector<SpMesh> AssetManager::ReadChangedMeshes(kString const& bundlePath)
+	{
+		std::vector<SpMesh> meshes;
+		auto reader = std::make_shared<AssetBundleReader>();
+		if (!reader->Open(bundlePath.c_str()))
+		{
+			KLOG(Error, "AssetManager", "Cann't open bundle (%s).", bundlePath.c_str());
+			return meshes;
+		}
+		string path(bundlePath.begin(), bundlePath.end());
+		std::shared_ptr<AssetBundleReader> former;
+		{
+			std::lock_guard<std::mutex> lock(m_MeshBundleLock);
+			former = m_MeshBundles[path];
+		}
+		for (uint32 i = 0; i < reader->GetNumChunks(); i++)
+		{
+			AssetChunkView chunk = reader->GetChunk(i);
+			if (chunk.Type != EAssetType::EMesh)
+				continue;
+			if (former)
+			{
+				AssetChunkView last = former->Find(chunk.Name, chunk.NameLength);
+				if (last.IsValid() && last.Size == chunk.Size && last.RawSize == chunk.RawSize
+					&& last.Compression == chunk.Compression && memcmp(last.Data, chunk.Data, (size_t)chunk.Size) == 0)
+					continue;
+			}
+			SpMesh mesh = MeshData::CreateFromChunk(chunk, reader->GetFile());
+			if (!mesh)
+			{
+				KLOG(Error, "AssetManager", "Invalid mesh chunk (%.*s).", (int)chunk.NameLength, chunk.Name);
+				continue;
+			}
+			meshes.push_back(mesh);
+		}
+		std::lock_guard<std::mutex> lock(m_MeshBundleLock);
+		m_MeshBundles[path] = reader;
+		return meshes;
+	}
+
+	uint32 AssetManager::LoadMeshBundle(const kchar * bundlePath)
+	{
+		auto meshes = ReadChangedMeshes(bundlePath);
+		for (auto & mesh : meshes)
+			m_MeshMap[mesh->Name()] = mesh;
+		return (uint32)meshes.size();
+	}
+
+	bool AssetManager::EnableHotReload(const kchar * dir)
+	{
+		if (m_pReloader == nullptr)
+		{
+			m_pReloader = new AssetReloader;
+			m_pReloader->RegisterImporter(KT(".bundle"), [this](kString const& path) -> AssetReloader::CommitFunc
+			{
+				auto meshes = ReadChangedMeshes(path);
+				if (meshes.empty())
+					return AssetReloader::CommitFunc();
+				return [this, meshes]()
+				{
+					for (auto & mesh : meshes)
+						m_MeshMap[mesh->Name()] = mesh;
+				};
+			});
+		}
+		return m_pReloader->Watch(dir);
+	}
+
+	void AssetManager::UpdateHotReload()
+	{
+		if (m_pReloader == nullptr)
+			return;
+		// a reloaded file may be one the VFS has cached as missing
+		if (m_pReloader->Update() > 0)
+			VFS().InvalidateCache();
+	}
+
 	void AssetManager::Free(char *byte_ptr)
 	{
 		::free(byte_ptr);
@@ -225,9 +399,53 @@ namespace k3d
 	}
 
 
+	/// IIODevice over an asset of a bundle or memory mount
+	class AssetIODevice : public IIODevice
+	{
+	public:
+		explicit AssetIODevice(IAsset * asset) : m_Asset(asset), m_Pos(0) {}
+
+		bool	Open(const kchar *, IOFlag) override { return false; }
+		bool	IsEOF() override { return m_Pos >= m_Asset->GetLength(); }
+		size_t	Read(char * data, size_t len) override
+		{
+			size_t read = (size_t)m_Asset->Read(data, len);
+			m_Pos += read;
+			return read;
+		}
+		size_t	Write(const void *, size_t) override { return 0; }
+		bool	Seek(size_t offset) override
+		{
+			if (!m_Asset->Seek(offset))
+				return false;
+			m_Pos = offset;
+			return true;
+		}
+		bool	Skip(size_t offset) override { return Seek((size_t)m_Pos + offset); }
+		void	Flush() override {}
+		void	Close() override {}
+
+	private:
+		std::unique_ptr<IAsset>	m_Asset;
+		uint64					m_Pos;
+	};
+
 	AssetManager::SpIODevice  AssetManager::OpenAsset(const kchar *assetPath, IOFlag flag, bool fastMode)
 	{
-		kString rawPath = AssetPath(assetPath);
+		kString rawPath;
+		if (flag == IORead)
+		{
+			kString relPath;
+			auto mount = VFS().Resolve(assetPath, relPath);
+			if (mount && !mount->GetHostPath(relPath, rawPath))
+			{
+				IAsset * asset = mount->Open(relPath);
+				if (asset)
+					return SpIODevice(new AssetIODevice(asset));
+			}
+		}
+		if (rawPath.empty())
+			rawPath = AssetPath(assetPath);
 		SpIODevice fileObj = nullptr;
 		if (fastMode) 
 		{
@@ -307,6 +525,9 @@ namespace k3d
 			return new AndroidAsset(asset);
 #else
             std::string relpath(path);
+			IAsset * asset = VFS().Open(kString(relpath.begin(), relpath.end()).c_str());
+			if (asset)
+				return asset;
 			relpath = "../../Data/" + relpath.substr(8, relpath.size() - 8);
 			return new MemmapedAsset(relpath.c_str());
 #endif
@@ -314,4 +535,10 @@ namespace k3d
 		return nullptr;
 	}
 
+	VirtualFileSystem& AssetManager::VFS()
+	{
+		static VirtualFileSystem s_VFS;
+		return s_VFS;
+	}
+
 }
\ No newline at end of file
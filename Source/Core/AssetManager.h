@@ -6,14 +6,23 @@
 #include <Interface/IIODevice.h>
 
 #include "MeshData.h"
+#include "AssetStreamer.h"
+#include "VirtualFileSystem.h"
 
 #include <atomic>
 #include <memory>
+#include <mutex>
+
+namespace Os
+{
+	class	AsyncIO;
+}
 
 namespace k3d
 {
 	class	ImageData;
 	class	Shader;
+	class	AssetReloader;
 	struct	ObjectLoadListener;
 
 	typedef std::shared_ptr< std::vector<kByte> > ByteArray;
@@ -48,12 +57,19 @@ namespace k3d
 		/// \param fileName
 		void LoadAssetDescFile(const char *fileName);
 
-		/// Add Search Path Support
+		/// Add Search Path Support, mounts the directory in the VFS
+		/// after the search paths added before
 		/// \brief AddSearchPath
 		/// \param path
 		void AddSearchPath(const kchar *path);
 
-		//auto AsyncLoadObject(const kchar * objPath, ObjectLoadListener* listener);
+		/// Streams the file through the AssetStreamer, see StreamRequest
+		/// \return ticket for CancelLoad, 0 if the manager is not initialized
+		StreamTicket AsyncLoadObject(const kchar * objPath, StreamRequest const& request);
+
+		bool CancelLoad(StreamTicket ticket);
+
+		AssetStreamer* GetStreamer() const { return m_pStreamer; }
 
 		/*void CommitAsynResourceTask(const kchar *fileName,
 			BytesPackage & bp,
@@ -66,6 +82,8 @@ namespace k3d
 			std::semaphore & sp
 			);*/
 
+		/// Reads the whole file through the async io service,
+		/// 'finished' is set once bp holds the file content
 		void CommitAsynResourceTask(
 			const kchar *fileName,
 			BytesPackage &bp,
@@ -78,6 +96,19 @@ namespace k3d
 
 		void AppendMesh(SpMesh meshPtr);
 
+		/// Appends the meshes of a v2 bundle, the meshes of raw chunks are views
+		/// into the mapped bundle. The bundle stays mapped, a hot reload compares
+		/// its chunks with the former ones and only reads the changed meshes.
+		/// \return number of meshes appended
+		uint32 LoadMeshBundle(const kchar * bundlePath);
+
+		/// Watches 'dir' for changed files, bundles are reloaded by a built-in
+		/// importer, others through the importers registered on GetReloader()
+		bool EnableHotReload(const kchar * dir);
+		/// Applies the finished reloads, called by the engine between two frames
+		void UpdateHotReload();
+		AssetReloader* GetReloader() const { return m_pReloader; }
+
 		//  template <class T>
 		//  void AsynLoadMesh(const char *meshName, void (T::*ptr)(), T*);
 
@@ -109,20 +140,32 @@ namespace k3d
 	public:
 		typedef std::shared_ptr<IIODevice> SpIODevice;
 
+		/// Reads are resolved through the VFS first
 		static SpIODevice		OpenAsset(const kchar * assetPath, IOFlag openFlag = IORead, bool fast = false);
 
 		static kString			AssetPath(const kchar * assetRelativePath);
 
         static IAsset * 		Open(const char* path);
+
+		static VirtualFileSystem&	VFS();
 	protected:
+		/// meshes of the bundle chunks which differ from the last load
+		std::vector<SpMesh>		ReadChangedMeshes(kString const& bundlePath);
+
 		static	kString	 s_envAssetPath;
 
 		std::vector<kString>    m_SearchPaths;
-		//std::thread_pool*        m_pThreadPool;
+		Os::AsyncIO*            m_pAsyncIO;
+		AssetStreamer*          m_pStreamer;
+		AssetReloader*          m_pReloader;
 
 		MapMesh                 m_MeshMap;
 		MapImage                m_ImageMap;
 
+		/// last loaded version of each mesh bundle, replaced on the reload workers
+		std::mutex              m_MeshBundleLock;
+		std::unordered_map<string, std::shared_ptr<AssetBundleReader> >	m_MeshBundles;
+
 		mutable bool            m_IsLoading;
 		mutable bool            m_HasPendingObject;
 
@@ -0,0 +1,202 @@
+#include "Kaleido3D.h"
+#include "AssetReloader.h"
+#include "FileWatcher.h"
+#include "LogUtil.h"
+#include "Dispatch/ThreadPool.h"
+#include <algorithm>
+
+namespace k3d
+{
+	AssetReloader::AssetReloader(Dispatch::ThreadPool * workers)
+		: m_Workers(workers ? workers : &Dispatch::ThreadPool::Global())
+		, m_NumImporting(0)
+	{
+		memset(&m_Stats, 0, sizeof(m_Stats));
+	}
+
+	AssetReloader::~AssetReloader()
+	{
+		Stop();
+	}
+
+	void AssetReloader::RegisterImporter(kString const& extension, ImportFunc && import)
+	{
+		std::lock_guard<std::mutex> lock(m_Lock);
+		m_Importers[extension] = std::move(import);
+	}
+
+	bool AssetReloader::Watch(const kchar * dir, uint32 debounceMs)
+	{
+		if (!m_Watcher)
+		{
+			m_Watcher.reset(new Os::FileWatcher);
+			bool started = m_Watcher->Start([this](std::vector<Os::FileWatcher::Event> const& events)
+			{
+				for (auto & event : events)
+					OnChange(event.Path, event.Actions, event.FirstChange);
+			}, debounceMs);
+			if (!started)
+			{
+				KLOG(Error, AssetReloader, "File watching is not supported here.");
+				m_Watcher.reset();
+				return false;
+			}
+		}
+		if (!m_Watcher->Watch(dir))
+		{
+			KLOG(Error, AssetReloader, "Cann't watch (%s).", dir);
+			return false;
+		}
+		UpdateStamps(dir);
+		return true;
+	}
+
+	void AssetReloader::Stop()
+	{
+		if (m_Watcher)
+		{
+			m_Watcher->Stop();
+			m_Watcher.reset();
+		}
+		std::unique_lock<std::mutex> lock(m_Lock);
+		m_Idle.wait(lock, [this]() { return m_NumImporting == 0; });
+	}
+
+	void AssetReloader::OnChange(kString const& path, uint32 actions, uint64 firstChange)
+	{
+		if (actions & Os::FileWatcher::Overflow)
+		{
+			Rescan(path, firstChange);
+			return;
+		}
+		// a removed file keeps its last version loaded
+		if (actions == Os::FileWatcher::Removed)
+		{
+			std::lock_guard<std::mutex> lock(m_Lock);
+			m_Stamps.erase(path);
+			return;
+		}
+		UpdateStamps(path);
+		QueueImport(path, firstChange);
+	}
+
+	void AssetReloader::Rescan(kString const& dir, uint64 firstChange)
+	{
+		std::vector<std::pair<kString, FileStamp>> files;
+		Os::FileWatcher::Scan(dir.c_str(), [&files](kString const& path, uint64 size, uint64 time)
+		{
+			files.emplace_back(path, FileStamp{ size, time });
+		});
+		std::vector<kString> changed;
+		{
+			std::lock_guard<std::mutex> lock(m_Lock);
+			m_Stats.NumOverflows++;
+			for (auto & file : files)
+			{
+				auto inserted = m_Stamps.emplace(file.first, file.second);
+				FileStamp & stamp = inserted.first->second;
+				if (!inserted.second && stamp.Size == file.second.Size && stamp.ModifyTime == file.second.ModifyTime)
+					continue;
+				stamp = file.second;
+				changed.push_back(file.first);
+			}
+		}
+		KLOG(Warn, AssetReloader, "Lost file events under (%s), %d files changed.", dir.c_str(), (int)changed.size());
+		for (auto & path : changed)
+			QueueImport(path, firstChange);
+	}
+
+	void AssetReloader::UpdateStamps(kString const& path)
+	{
+		Os::FileWatcher::Scan(path.c_str(), [this](kString const& file, uint64 size, uint64 time)
+		{
+			std::lock_guard<std::mutex> lock(m_Lock);
+			m_Stamps[file] = FileStamp{ size, time };
+		});
+	}
+
+	void AssetReloader::QueueImport(kString const& path, uint64 firstChange)
+	{
+		size_t dot = path.find_last_of(KT('.'));
+		if (dot == kString::npos)
+			return;
+		std::lock_guard<std::mutex> lock(m_Lock);
+		auto importer = m_Importers.find(path.substr(dot));
+		if (importer == m_Importers.end())
+			return;
+		m_Stats.NumChanges++;
+		auto inserted = m_Files.emplace(path, FileState{ false, false, firstChange, 0 });
+		FileState & state = inserted.first->second;
+		if (state.Importing)
+		{
+			if (!state.Dirty)
+				state.DirtySince = firstChange;
+			state.Dirty = true;
+			return;
+		}
+		state.Importing = true;
+		state.FirstChange = firstChange;
+		m_NumImporting++;
+		ImportFunc import = importer->second;
+		m_Workers->Submit([this, path, import]() { Import(path, import); });
+	}
+
+	void AssetReloader::Import(kString const& path, ImportFunc const& import)
+	{
+		CommitFunc commit = import(path);
+		std::lock_guard<std::mutex> lock(m_Lock);
+		m_Stats.NumImports++;
+		FileState & state = m_Files[path];
+		if (commit)
+			m_Ready.push_back(ReadyCommit{ std::move(commit), state.FirstChange });
+		else
+			m_Stats.NumEmptyImports++;
+		if (state.Dirty)
+		{
+			// imports of one file never overlap, so commits are applied in change order
+			state.Dirty = false;
+			state.FirstChange = state.DirtySince;
+			m_Workers->Submit([this, path, import]() { Import(path, import); });
+			return;
+		}
+		m_Files.erase(path);
+		if (--m_NumImporting == 0)
+			m_Idle.notify_all();
+	}
+
+	uint32 AssetReloader::Update()
+	{
+		std::vector<ReadyCommit> ready;
+		{
+			std::lock_guard<std::mutex> lock(m_Lock);
+			if (m_Ready.empty())
+				return 0;
+			ready.swap(m_Ready);
+		}
+		for (auto & commit : ready)
+			commit.Commit();
+		uint64 now = Os::FileWatcher::Now();
+		std::lock_guard<std::mutex> lock(m_Lock);
+		for (auto & commit : ready)
+		{
+			double latency = (now - commit.FirstChange) / 1000.0;
+			m_Stats.NumCommits++;
+			m_Stats.LastLatencyMs = latency;
+			m_Stats.MaxLatencyMs = std::max(m_Stats.MaxLatencyMs, latency);
+			m_Stats.TotalLatencyMs += latency;
+		}
+		return (uint32)ready.size();
+	}
+
+	uint32 AssetReloader::GetNumPending()
+	{
+		std::lock_guard<std::mutex> lock(m_Lock);
+		return m_NumImporting + (uint32)m_Ready.size();
+	}
+
+	AssetReloader::Stats AssetReloader::GetStats()
+	{
+		std::lock_guard<std::mutex> lock(m_Lock);
+		return m_Stats;
+	}
+}
@@ -0,0 +1,119 @@
+#ifndef __AssetReloader_h__
+#define __AssetReloader_h__
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace Os
+{
+	class	FileWatcher;
+}
+
+namespace Dispatch
+{
+	class	ThreadPool;
+}
+
+namespace k3d
+{
+	/// AssetReloader
+	/// Hot reload of the files under watched directories. A changed file is
+	/// imported on a worker thread by the importer registered for its extension,
+	/// what the importer returns is applied by Update(), which the engine calls
+	/// between two frames, so no frame sees half of a reload. Only changed files
+	/// are imported; a file which changes again while it is being imported is
+	/// imported once more afterwards. When the watcher loses events the
+	/// directory is scanned and the files whose size or time changed are
+	/// imported.
+	class K3D_API AssetReloader
+	{
+	public:
+		/// swaps the imported asset in, runs in Update()
+		typedef std::function<void()>						CommitFunc;
+		/// runs on a worker thread, returns an empty function if there is nothing to apply
+		typedef std::function<CommitFunc(kString const&)>	ImportFunc;
+
+		struct Stats
+		{
+			/// debounced changes of files with an importer
+			uint32	NumChanges;
+			uint32	NumImports;
+			/// imports with nothing to apply, unchanged content or failures
+			uint32	NumEmptyImports;
+			uint32	NumCommits;
+			/// lost watcher events, each rescans the watched directory
+			uint32	NumOverflows;
+			/// from the first change of a file until its commit
+			double	LastLatencyMs;
+			double	MaxLatencyMs;
+			double	TotalLatencyMs;
+		};
+
+		/// \param workers runs the importers, the global pool if null
+		explicit AssetReloader(Dispatch::ThreadPool * workers = nullptr);
+		~AssetReloader();
+
+		/// \param extension with the dot, e.g. ".bundle"
+		void		RegisterImporter(kString const& extension, ImportFunc && import);
+		/// \param debounceMs see Os::FileWatcher::Start
+		bool		Watch(const kchar * dir, uint32 debounceMs = 50);
+		/// stops watching and waits for the imports in flight
+		void		Stop();
+
+		/// applies the finished imports on the calling thread
+		/// \return number of commits
+		uint32		Update();
+		/// imports in flight or waiting for Update()
+		uint32		GetNumPending();
+		Stats		GetStats();
+
+	private:
+		struct FileState
+		{
+			bool	Importing;
+			/// changed again while importing
+			bool	Dirty;
+			uint64	FirstChange;
+			uint64	DirtySince;
+		};
+
+		struct ReadyCommit
+		{
+			CommitFunc	Commit;
+			uint64		FirstChange;
+		};
+
+		/// of the last version seen
+		struct FileStamp
+		{
+			uint64	Size;
+			uint64	ModifyTime;
+		};
+
+		/// on the watcher thread
+		void		OnChange(kString const& path, uint32 actions, uint64 firstChange);
+		/// imports the files under 'dir' which differ from their stamps
+		void		Rescan(kString const& dir, uint64 firstChange);
+		void		UpdateStamps(kString const& path);
+		void		QueueImport(kString const& path, uint64 firstChange);
+		void		Import(kString const& path, ImportFunc const& import);
+
+		Dispatch::ThreadPool *						m_Workers;
+		std::unique_ptr<Os::FileWatcher>			m_Watcher;
+		std::mutex									m_Lock;
+		std::condition_variable						m_Idle;
+		std::unordered_map<kString, ImportFunc>		m_Importers;
+		std::unordered_map<kString, FileState>		m_Files;
+		std::unordered_map<kString, FileStamp>		m_Stamps;
+		std::vector<ReadyCommit>					m_Ready;
+		uint32										m_NumImporting;
+		Stats										m_Stats;
+	};
+}
+
+#endif
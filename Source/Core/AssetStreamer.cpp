@@ -0,0 +1,451 @@
+#include "Kaleido3D.h"
+#include "AssetStreamer.h"
+#include "AsyncIO.h"
+#include "Dispatch/ThreadPool.h"
+#include "Core/LogUtil.h"
+
+#include <algorithm>
+
+namespace k3d
+{
+	enum class EJobState : uint32
+	{
+		Queued,
+		Opening,
+		Opened,
+		Reading,
+		Decoding,
+		PostProcessing,
+		Dead,
+	};
+
+	struct AssetStreamer::Job
+	{
+		kString							Path;
+		EStreamPriority					Priority;
+		EJobState						State;
+		StreamRequest::DecodeFunc		DecodeStage;
+		StreamRequest::PostProcessFunc	PostProcessStage;
+		std::vector<Waiter>				Waiters;
+		/// number of entries in the priority queues, stale entries are skipped
+		uint32							QueueRefs;
+		bool							Charged;
+		uint64							Size;
+		std::unique_ptr<Os::File>		File;
+		std::shared_ptr< std::vector<kByte> >	Bytes;
+		StreamObject					Object;
+	};
+
+	AssetStreamer::AssetStreamer(Os::AsyncIO * io, Dispatch::ThreadPool * workers, Desc const& desc)
+		: m_IO(io)
+		, m_Workers(workers)
+		, m_Desc(desc)
+		, m_Stalled(nullptr)
+		, m_NextTicket(1)
+		, m_NumJobs(0)
+		, m_BytesInFlight(0)
+		, m_Pumping(false)
+		, m_Stopping(false)
+	{
+		memset(&m_Stats, 0, sizeof(m_Stats));
+	}
+
+	AssetStreamer::~AssetStreamer()
+	{
+		std::unique_lock<std::mutex> lock(m_Lock);
+		m_Stopping = true;
+		// queued loads are dropped, loads past the io stage run to completion
+		for (auto & queue : m_Queues)
+		{
+			for (Job * job : queue)
+			{
+				if (job->State != EJobState::Queued)
+					continue;
+				for (auto & waiter : job->Waiters)
+					m_JobsByTicket.erase(waiter.Ticket);
+				job->Waiters.clear();
+				m_JobsByPath.erase(job->Path);
+				ReleaseJob(job);
+			}
+		}
+		m_IdleCV.wait(lock, [this]() { return m_NumJobs == 0 && !m_Pumping; });
+		for (auto & queue : m_Queues)
+		{
+			for (Job * job : queue)
+			{
+				if (--job->QueueRefs == 0 && job->State == EJobState::Dead)
+					delete job;
+			}
+			queue.clear();
+		}
+	}
+
+	StreamTicket AssetStreamer::Load(const kchar * path, StreamRequest const& request)
+	{
+		StreamTicket ticket = 0;
+		{
+			std::lock_guard<std::mutex> lock(m_Lock);
+			if (m_Stopping)
+				return 0;
+			ticket = m_NextTicket++;
+			m_Stats.NumRequests++;
+			uint32 priority = std::min((uint32)request.Priority, (uint32)EStreamPriority::Count - 1);
+			Job * job = nullptr;
+			auto iter = m_JobsByPath.find(path);
+			if (iter != m_JobsByPath.end())
+			{
+				job = iter->second;
+				m_Stats.NumDeduplicated++;
+				// a more urgent request promotes a load which is still waiting
+				if (job->State == EJobState::Queued && priority < (uint32)job->Priority)
+				{
+					job->Priority = (EStreamPriority)priority;
+					job->QueueRefs++;
+					m_Queues[priority].push_back(job);
+				}
+			}
+			else
+			{
+				job = new Job;
+				job->Path = path;
+				job->Priority = (EStreamPriority)priority;
+				job->State = EJobState::Queued;
+				job->DecodeStage = request.Decode;
+				job->PostProcessStage = request.PostProcess;
+				job->QueueRefs = 1;
+				job->Charged = false;
+				job->Size = 0;
+				m_Queues[priority].push_back(job);
+				m_JobsByPath[job->Path] = job;
+				m_NumJobs++;
+			}
+			Waiter waiter = { ticket, request.OnComplete, request.DeliverOnDispatch };
+			job->Waiters.push_back(waiter);
+			m_JobsByTicket[ticket] = job;
+			if (m_Pumping)
+				return ticket;
+			m_Pumping = true;
+		}
+		m_Workers->Submit([this]() { Pump(); });
+		return ticket;
+	}
+
+	bool AssetStreamer::Cancel(StreamTicket ticket)
+	{
+		std::lock_guard<std::mutex> lock(m_Lock);
+		auto iter = m_JobsByTicket.find(ticket);
+		if (iter == m_JobsByTicket.end())
+			return false;
+		Job * job = iter->second;
+		m_JobsByTicket.erase(iter);
+		auto waiter = std::find_if(job->Waiters.begin(), job->Waiters.end(),
+			[ticket](Waiter const& w) { return w.Ticket == ticket; });
+		job->Waiters.erase(waiter);
+		m_Stats.NumCancelled++;
+		// a load which has started notices it has no waiter left at its next stage
+		if (job->Waiters.empty() && job->State == EJobState::Queued)
+		{
+			m_JobsByPath.erase(job->Path);
+			ReleaseJob(job);
+		}
+		return true;
+	}
+
+	uint32 AssetStreamer::DispatchCompletions(uint32 maxCount)
+	{
+		std::vector<Delivery> deliveries;
+		{
+			std::lock_guard<std::mutex> lock(m_Lock);
+			uint32 count = std::min(maxCount, (uint32)m_Deliveries.size());
+			deliveries.reserve(count);
+			for (uint32 i = 0; i < count; i++)
+			{
+				deliveries.push_back(std::move(m_Deliveries.front()));
+				m_Deliveries.pop_front();
+			}
+		}
+		for (auto & delivery : deliveries)
+		{
+			if (delivery.first)
+				delivery.first(delivery.second);
+		}
+		return (uint32)deliveries.size();
+	}
+
+	void AssetStreamer::WaitIdle()
+	{
+		std::unique_lock<std::mutex> lock(m_Lock);
+		m_IdleCV.wait(lock, [this]() { return m_NumJobs == 0 && !m_Pumping; });
+	}
+
+	uint32 AssetStreamer::GetNumPending()
+	{
+		std::lock_guard<std::mutex> lock(m_Lock);
+		return m_NumJobs;
+	}
+
+	uint64 AssetStreamer::GetBytesInFlight()
+	{
+		std::lock_guard<std::mutex> lock(m_Lock);
+		return m_BytesInFlight;
+	}
+
+	AssetStreamer::Stats AssetStreamer::GetStats()
+	{
+		std::lock_guard<std::mutex> lock(m_Lock);
+		return m_Stats;
+	}
+
+	void AssetStreamer::KickPump()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_Lock);
+			if (m_Pumping)
+				return;
+			m_Pumping = true;
+		}
+		m_Workers->Submit([this]() { Pump(); });
+	}
+
+	/// issues reads by priority until the queues are empty or the budget is spent,
+	/// only one pump runs at a time
+	void AssetStreamer::Pump()
+	{
+		for (;;)
+		{
+			Job * job = nullptr;
+			{
+				std::lock_guard<std::mutex> lock(m_Lock);
+				if (!PopJob(job))
+				{
+					m_Pumping = false;
+					m_IdleCV.notify_all();
+					return;
+				}
+			}
+
+			if (job->State == EJobState::Opening)
+			{
+				job->File.reset(new Os::File);
+				if (!job->File->Open(job->Path.c_str(), IORead))
+				{
+					KLOG(Error, AssetStreamer, "Cann't open file (%s).", job->Path.c_str());
+					job->File.reset();
+					Finish(job, EStreamStatus::Failed);
+					continue;
+				}
+				job->Size = (uint64)job->File->GetSize();
+				job->State = EJobState::Opened;
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(m_Lock);
+				if (job->Waiters.empty())
+				{
+					m_JobsByPath.erase(job->Path);
+					job->File.reset();
+					ReleaseJob(job);
+					continue;
+				}
+				// one oversized load may run alone
+				if (m_BytesInFlight > 0 && m_BytesInFlight + job->Size > m_Desc.BytesInFlightBudget)
+				{
+					m_Stalled = job;
+					m_Pumping = false;
+					m_IdleCV.notify_all();
+					return;
+				}
+				m_BytesInFlight += job->Size;
+				m_Stats.PeakBytesInFlight = std::max(m_Stats.PeakBytesInFlight, m_BytesInFlight);
+				job->Charged = true;
+				job->State = EJobState::Reading;
+			}
+
+			job->Bytes = std::make_shared< std::vector<kByte> >((size_t)job->Size);
+			if (job->Size == 0 ||
+				!m_IO->QueueRead(job->File->GetNativeHandle(), job->Bytes->data(), (size_t)job->Size, 0, 0,
+					[this, job](Os::AsyncIOResult const& result) { OnRead(job, result.Result); }))
+			{
+				OnRead(job, job->Size == 0 ? 0 : -1);
+				continue;
+			}
+			m_IO->Submit();
+		}
+	}
+
+	bool AssetStreamer::PopJob(Job *& job)
+	{
+		if (m_Stalled)
+		{
+			job = m_Stalled;
+			m_Stalled = nullptr;
+			return true;
+		}
+		for (uint32 priority = 0; priority < (uint32)EStreamPriority::Count; priority++)
+		{
+			auto & queue = m_Queues[priority];
+			while (!queue.empty())
+			{
+				Job * front = queue.front();
+				queue.pop_front();
+				front->QueueRefs--;
+				if (front->State == EJobState::Dead)
+				{
+					if (front->QueueRefs == 0)
+						delete front;
+					continue;
+				}
+				// promoted or already started
+				if (front->State != EJobState::Queued || (uint32)front->Priority != priority)
+					continue;
+				front->State = EJobState::Opening;
+				job = front;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void AssetStreamer::OnRead(Job * job, int64 result)
+	{
+		job->File.reset();
+		if (result < 0 || (uint64)result != job->Size)
+		{
+			KLOG(Error, AssetStreamer, "Read failed (%lld).", (long long)result);
+			job->Bytes.reset();
+			Finish(job, EStreamStatus::Failed);
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lock(m_Lock);
+			m_Stats.BytesRead += job->Size;
+			if (job->Waiters.empty())
+			{
+				job->Bytes.reset();
+				m_JobsByPath.erase(job->Path);
+				m_BytesInFlight -= job->Size;
+				job->Charged = false;
+				ReleaseJob(job);
+				job = nullptr;
+			}
+			else
+			{
+				job->State = EJobState::Decoding;
+			}
+		}
+		if (job)
+			m_Workers->Submit([this, job]() { Decode(job); });
+		else
+			KickPump();
+	}
+
+	void AssetStreamer::Decode(Job * job)
+	{
+		bool failed = false;
+		bool wanted = true;
+		{
+			std::lock_guard<std::mutex> lock(m_Lock);
+			wanted = !job->Waiters.empty();
+			// every waiter cancelled after the read, a new request starts a new load
+			if (!wanted)
+			{
+				auto iter = m_JobsByPath.find(job->Path);
+				if (iter != m_JobsByPath.end() && iter->second == job)
+					m_JobsByPath.erase(iter);
+			}
+		}
+		if (!wanted)
+		{
+			job->Bytes.reset();
+			Finish(job, EStreamStatus::Cancelled);
+			return;
+		}
+		if (job->DecodeStage)
+		{
+			job->Object = job->DecodeStage(job->Bytes);
+			job->Bytes.reset();
+			failed = !job->Object;
+		}
+		{
+			std::lock_guard<std::mutex> lock(m_Lock);
+			m_BytesInFlight -= job->Size;
+			job->Charged = false;
+			job->State = EJobState::PostProcessing;
+		}
+		KickPump();
+		if (failed)
+		{
+			Finish(job, EStreamStatus::Failed);
+		}
+		else if (job->PostProcessStage)
+		{
+			m_Workers->Submit([this, job]() { PostProcess(job); });
+		}
+		else
+		{
+			Finish(job, EStreamStatus::Finished);
+		}
+	}
+
+	void AssetStreamer::PostProcess(Job * job)
+	{
+		job->PostProcessStage(job->Object);
+		Finish(job, EStreamStatus::Finished);
+	}
+
+	void AssetStreamer::Finish(Job * job, EStreamStatus status)
+	{
+		std::vector<Delivery> deliveries;
+		{
+			std::lock_guard<std::mutex> lock(m_Lock);
+			auto iter = m_JobsByPath.find(job->Path);
+			if (iter != m_JobsByPath.end() && iter->second == job)
+				m_JobsByPath.erase(iter);
+			if (job->Charged)
+			{
+				m_BytesInFlight -= job->Size;
+				job->Charged = false;
+			}
+			// cancellations were counted by Cancel
+			if (status == EStreamStatus::Failed)
+				m_Stats.NumFailed++;
+			else if (status == EStreamStatus::Finished)
+				m_Stats.NumFinished++;
+
+			StreamResult result;
+			result.Status = status;
+			result.Path = job->Path;
+			result.Bytes = job->Bytes;
+			result.Object = job->Object;
+			for (auto & waiter : job->Waiters)
+			{
+				m_JobsByTicket.erase(waiter.Ticket);
+				if (waiter.DeliverOnDispatch)
+					m_Deliveries.push_back(Delivery(std::move(waiter.OnComplete), result));
+				else
+					deliveries.push_back(Delivery(std::move(waiter.OnComplete), result));
+			}
+			job->Waiters.clear();
+		}
+		for (auto & delivery : deliveries)
+		{
+			if (delivery.first)
+				delivery.first(delivery.second);
+		}
+		{
+			std::lock_guard<std::mutex> lock(m_Lock);
+			ReleaseJob(job);
+		}
+		KickPump();
+	}
+
+	/// m_Lock held
+	void AssetStreamer::ReleaseJob(Job * job)
+	{
+		job->State = EJobState::Dead;
+		m_NumJobs--;
+		if (job->QueueRefs == 0)
+			delete job;
+		m_IdleCV.notify_all();
+	}
+}
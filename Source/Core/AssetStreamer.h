@@ -0,0 +1,167 @@
+#ifndef __AssetStreamer_h__
+#define __AssetStreamer_h__
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace Os
+{
+	class	AsyncIO;
+}
+
+namespace Dispatch
+{
+	class	ThreadPool;
+}
+
+namespace k3d
+{
+	enum class EStreamPriority : uint32
+	{
+		Critical,
+		High,
+		Normal,
+		Low,
+		Count
+	};
+
+	enum class EStreamStatus : uint32
+	{
+		Finished,
+		Failed,
+		Cancelled,
+	};
+
+	typedef uint64											StreamTicket;
+	typedef std::shared_ptr< const std::vector<kByte> >	StreamBytes;
+	typedef std::shared_ptr<void>							StreamObject;
+
+	struct StreamResult
+	{
+		EStreamStatus	Status;
+		kString			Path;
+		/// raw file content, released once the decode stage has run
+		StreamBytes		Bytes;
+		/// output of the decode/post-process stages
+		StreamObject	Object;
+	};
+
+	struct StreamRequest
+	{
+		typedef std::function<StreamObject(StreamBytes const&)>	DecodeFunc;
+		typedef std::function<void(StreamObject&)>				PostProcessFunc;
+		typedef std::function<void(StreamResult const&)>		CompleteFunc;
+
+		EStreamPriority	Priority;
+		/// decode stage, worker thread
+		DecodeFunc		Decode;
+		/// post process stage, worker thread, runs after Decode
+		PostProcessFunc	PostProcess;
+		/// completion, runs on the worker that finished the load or in
+		/// AssetStreamer::DispatchCompletions if DeliverOnDispatch is set
+		CompleteFunc	OnComplete;
+		bool			DeliverOnDispatch;
+
+		StreamRequest()
+			: Priority(EStreamPriority::Normal)
+			, DeliverOnDispatch(false)
+		{}
+	};
+
+	/// AssetStreamer
+	/// Streams files in three pipelined stages: io (Os::AsyncIO), decode and
+	/// post process (worker pool). Loads are scheduled by priority class under
+	/// a bytes-in-flight budget, concurrent requests for the same path share one
+	/// load (the decode functions of the first request are used) and every
+	/// request can be cancelled by its ticket.
+	class K3D_API AssetStreamer
+	{
+	public:
+		struct Desc
+		{
+			/// bytes read but not decoded yet
+			uint64	BytesInFlightBudget;
+
+			Desc() : BytesInFlightBudget(64ull << 20) {}
+		};
+
+		struct Stats
+		{
+			uint64	NumRequests;
+			uint64	NumDeduplicated;
+			uint64	NumCancelled;
+			uint64	NumFailed;
+			uint64	NumFinished;
+			uint64	BytesRead;
+			uint64	PeakBytesInFlight;
+		};
+
+		AssetStreamer(Os::AsyncIO * io, Dispatch::ThreadPool * workers, Desc const& desc = Desc());
+		~AssetStreamer();
+
+		/// non blocking, returns 0 if the streamer is shutting down
+		StreamTicket	Load(const kchar * path, StreamRequest const& request);
+
+		/// the request's OnComplete will not be called if this returns true
+		bool			Cancel(StreamTicket ticket);
+
+		/// delivers completions of requests with DeliverOnDispatch, call once a frame
+		uint32			DispatchCompletions(uint32 maxCount = ~0u);
+
+		/// block until every load has completed
+		void			WaitIdle();
+
+		uint32			GetNumPending();
+		uint64			GetBytesInFlight();
+		Stats			GetStats();
+
+		AssetStreamer(const AssetStreamer&) = delete;
+		AssetStreamer& operator=(const AssetStreamer&) = delete;
+
+	private:
+		struct Job;
+		struct Waiter
+		{
+			StreamTicket				Ticket;
+			StreamRequest::CompleteFunc	OnComplete;
+			bool						DeliverOnDispatch;
+		};
+		typedef std::pair<StreamRequest::CompleteFunc, StreamResult> Delivery;
+
+		void	KickPump();
+		void	Pump();
+		bool	PopJob(Job *& job);
+		void	OnRead(Job * job, int64 result);
+		void	Decode(Job * job);
+		void	PostProcess(Job * job);
+		void	Finish(Job * job, EStreamStatus status);
+		void	ReleaseJob(Job * job);
+
+		Os::AsyncIO *			m_IO;
+		Dispatch::ThreadPool *	m_Workers;
+		Desc					m_Desc;
+
+		std::mutex				m_Lock;
+		std::condition_variable	m_IdleCV;
+		std::deque<Job*>		m_Queues[(uint32)EStreamPriority::Count];
+		Job *					m_Stalled;
+		std::unordered_map<kString, Job*>			m_JobsByPath;
+		std::unordered_map<StreamTicket, Job*>		m_JobsByTicket;
+		std::deque<Delivery>	m_Deliveries;
+		StreamTicket			m_NextTicket;
+		uint32					m_NumJobs;
+		uint64					m_BytesInFlight;
+		bool					m_Pumping;
+		bool					m_Stopping;
+		Stats					m_Stats;
+	};
+}
+
+#endif
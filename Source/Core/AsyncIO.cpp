@@ -0,0 +1,768 @@
+#include "Kaleido3D.h"
+#include "AsyncIO.h"
+#include "LogUtil.h"
+#include "Dispatch/ThreadPool.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if K3DPLATFORM_OS_LINUX && !K3DPLATFORM_OS_ANDROID && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter) &&           \
+  defined(__NR_io_uring_register)
+#define K3D_HAS_IO_URING 1
+#endif
+#endif
+#endif
+
+namespace Os {
+
+struct AsyncIORequest
+{
+  AsyncIOOp Op;
+  File::NativeHandle Fd;
+  kByte* Data;
+  size_t Size;
+  uint64 Offset;
+  /// bytes of earlier short transfers, Data/Size/Offset cover the remainder
+  size_t Done;
+  uint64 UserData;
+  AsyncIOCallback Callback;
+  int32 FixedBuffer;
+#if K3D_HAS_IO_URING
+  struct iovec Vec;
+#endif
+  AsyncIORequest* Next;
+};
+
+class AsyncIOBackend
+{
+public:
+  virtual ~AsyncIOBackend() {}
+  /// called with the AsyncIO lock held, takes requests from the backlog
+  virtual void Issue(std::deque<AsyncIORequest*>& backlog) = 0;
+  virtual bool RegisterBuffers(const AsyncIOBuffer* buffers, uint32 count) = 0;
+  virtual void UnregisterBuffers() = 0;
+  virtual void Shutdown() = 0;
+};
+
+struct AsyncIOPrivate
+{
+  AsyncIO::Backend Type;
+  AsyncIO::Desc Desc;
+  AsyncIOBackend* Impl;
+
+  std::mutex Lock;
+  std::condition_variable StateCV;
+
+  std::vector<std::unique_ptr<AsyncIORequest[]> > RequestBlocks;
+  AsyncIORequest* FreeList;
+  std::vector<AsyncIORequest*> Pending;
+  std::deque<AsyncIORequest*> Backlog;
+  std::deque<AsyncIOResult> Completions;
+  std::vector<AsyncIOBuffer> Buffers;
+  uint32 NumInFlight;
+
+  AsyncIOPrivate()
+    : Type(AsyncIO::Backend::None)
+    , Impl(nullptr)
+    , FreeList(nullptr)
+    , NumInFlight(0)
+  {
+  }
+
+  AsyncIORequest* AllocRequest()
+  {
+    if (!FreeList) {
+      const uint32 blockSize = std::max(64u, Desc.QueueDepth);
+      AsyncIORequest* block = new AsyncIORequest[blockSize];
+      RequestBlocks.emplace_back(block);
+      for (uint32 i = 0; i < blockSize; i++) {
+        block[i].Next = FreeList;
+        FreeList = &block[i];
+      }
+    }
+    AsyncIORequest* req = FreeList;
+    FreeList = req->Next;
+    req->Next = nullptr;
+    return req;
+  }
+
+  /// retire a request, can be called from any backend thread
+  void Complete(AsyncIORequest* req, int64 result)
+  {
+    AsyncIOCallback callback = std::move(req->Callback);
+    req->Callback = nullptr;
+    AsyncIOResult res = { req->UserData, result, req->Op };
+    {
+      std::lock_guard<std::mutex> lock(Lock);
+      req->Next = FreeList;
+      FreeList = req;
+      if (!callback) {
+        Completions.push_back(res);
+        NumInFlight--;
+        StateCV.notify_all();
+        return;
+      }
+    }
+    // the callback may queue new requests, so it runs unlocked and is
+    // accounted as in flight until it returns
+    callback(res);
+    std::lock_guard<std::mutex> lock(Lock);
+    NumInFlight--;
+    StateCV.notify_all();
+  }
+
+  static int64 BlockingIO(AsyncIORequest* req)
+  {
+    size_t done = 0;
+#if K3DPLATFORM_OS_WIN
+    while (done < req->Size) {
+      uint64 offset = req->Offset + done;
+      OVERLAPPED ov = {};
+      ov.Offset = (DWORD)(offset & 0xffffffff);
+      ov.OffsetHigh = (DWORD)(offset >> 32);
+      DWORD toTransfer = (DWORD)std::min<size_t>(req->Size - done, 1u << 30);
+      DWORD transferred = 0;
+      BOOL ok = req->Op == AsyncIOOp::Read
+                  ? ::ReadFile(req->Fd, req->Data + done, toTransfer,
+                               &transferred, &ov)
+                  : ::WriteFile(req->Fd, req->Data + done, toTransfer,
+                                &transferred, &ov);
+      if (!ok) {
+        if (::GetLastError() == ERROR_HANDLE_EOF)
+          break;
+        return done ? (int64)done : -(int64)::GetLastError();
+      }
+      if (transferred == 0)
+        break;
+      done += transferred;
+    }
+#else
+    while (done < req->Size) {
+      ssize_t ret =
+        req->Op == AsyncIOOp::Read
+          ? ::pread(req->Fd, req->Data + done, req->Size - done,
+                    (off_t)(req->Offset + done))
+          : ::pwrite(req->Fd, req->Data + done, req->Size - done,
+                     (off_t)(req->Offset + done));
+      if (ret < 0) {
+        if (errno == EINTR)
+          continue;
+        return done ? (int64)done : -(int64)errno;
+      }
+      if (ret == 0)
+        break;
+      done += (size_t)ret;
+    }
+#endif
+    return (int64)done;
+  }
+};
+
+//--------------------------------------------------------------------------------------------
+// Fallback : positional reads/writes on a worker pool
+
+class PoolBackend : public AsyncIOBackend
+{
+public:
+  PoolBackend(AsyncIOPrivate* owner, uint32 numWorkers)
+    : m_Owner(owner)
+    , m_Workers(numWorkers, "AsyncIO")
+  {
+  }
+
+  void Issue(std::deque<AsyncIORequest*>& backlog) override
+  {
+    while (!backlog.empty()) {
+      AsyncIORequest* req = backlog.front();
+      backlog.pop_front();
+      AsyncIOPrivate* owner = m_Owner;
+      m_Workers.Submit([owner, req]() {
+        owner->Complete(req, AsyncIOPrivate::BlockingIO(req));
+      });
+    }
+  }
+
+  bool RegisterBuffers(const AsyncIOBuffer*, uint32) override { return true; }
+  void UnregisterBuffers() override {}
+  void Shutdown() override { m_Workers.WaitIdle(); }
+
+private:
+  AsyncIOPrivate* m_Owner;
+  Dispatch::ThreadPool m_Workers;
+};
+
+//--------------------------------------------------------------------------------------------
+// Linux io_uring, driven by raw syscalls so there is no liburing dependency
+
+#if K3D_HAS_IO_URING
+static int
+SysIoUringSetup(unsigned entries, struct io_uring_params* p)
+{
+  return (int)::syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int
+SysIoUringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags)
+{
+  return (int)::syscall(
+    __NR_io_uring_enter, fd, toSubmit, minComplete, flags, NULL, 0);
+}
+
+static int
+SysIoUringRegister(int fd, unsigned opcode, const void* arg, unsigned nrArgs)
+{
+  return (int)::syscall(__NR_io_uring_register, fd, opcode, arg, nrArgs);
+}
+
+class IoUringBackend : public AsyncIOBackend
+{
+public:
+  explicit IoUringBackend(AsyncIOPrivate* owner)
+    : m_Owner(owner)
+    , m_RingFd(-1)
+    , m_SqRing(nullptr)
+    , m_CqRing(nullptr)
+    , m_Sqes(nullptr)
+    , m_SqRingSize(0)
+    , m_CqRingSize(0)
+    , m_SqesSize(0)
+    , m_Depth(0)
+    , m_InKernel(0)
+    , m_ToSubmit(0)
+    , m_Reaper(nullptr)
+    , m_HasBuffers(false)
+  {
+  }
+
+  ~IoUringBackend() override { Release(); }
+
+  bool Init(uint32 depth)
+  {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    m_RingFd = SysIoUringSetup(depth, &params);
+    if (m_RingFd < 0)
+      return false;
+
+    m_SqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    m_CqRingSize =
+      params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (singleMap) {
+      m_SqRingSize = m_CqRingSize = std::max(m_SqRingSize, m_CqRingSize);
+    }
+    m_SqRing = (kByte*)::mmap(NULL, m_SqRingSize, PROT_READ | PROT_WRITE,
+                              MAP_SHARED | MAP_POPULATE, m_RingFd,
+                              IORING_OFF_SQ_RING);
+    if (m_SqRing == MAP_FAILED) {
+      m_SqRing = nullptr;
+      return false;
+    }
+    if (singleMap) {
+      m_CqRing = m_SqRing;
+    } else {
+      m_CqRing = (kByte*)::mmap(NULL, m_CqRingSize, PROT_READ | PROT_WRITE,
+                                MAP_SHARED | MAP_POPULATE, m_RingFd,
+                                IORING_OFF_CQ_RING);
+      if (m_CqRing == MAP_FAILED) {
+        m_CqRing = nullptr;
+        return false;
+      }
+    }
+    m_SqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    m_Sqes = (struct io_uring_sqe*)::mmap(NULL, m_SqesSize,
+                                          PROT_READ | PROT_WRITE,
+                                          MAP_SHARED | MAP_POPULATE, m_RingFd,
+                                          IORING_OFF_SQES);
+    if (m_Sqes == MAP_FAILED) {
+      m_Sqes = nullptr;
+      return false;
+    }
+
+    m_SqHead = (unsigned*)(m_SqRing + params.sq_off.head);
+    m_SqTail = (unsigned*)(m_SqRing + params.sq_off.tail);
+    m_SqMask = *(unsigned*)(m_SqRing + params.sq_off.ring_mask);
+    m_SqArray = (unsigned*)(m_SqRing + params.sq_off.array);
+    m_SqEntries = params.sq_entries;
+    m_CqHead = (unsigned*)(m_CqRing + params.cq_off.head);
+    m_CqTail = (unsigned*)(m_CqRing + params.cq_off.tail);
+    m_CqMask = *(unsigned*)(m_CqRing + params.cq_off.ring_mask);
+    m_Cqes = (struct io_uring_cqe*)(m_CqRing + params.cq_off.cqes);
+    // keep completions below the cq capacity, the cq can never overflow
+    m_Depth = std::min(params.sq_entries, params.cq_entries);
+
+    m_Reaper = new Thread([this]() { ReapLoop(); }, "AsyncIO Reaper",
+                          ThreadPriority::High);
+    m_Reaper->Start();
+    return true;
+  }
+
+  void Issue(std::deque<AsyncIORequest*>& backlog) override
+  {
+    uint32 queued = 0;
+    while (!backlog.empty() && m_InKernel < m_Depth) {
+      struct io_uring_sqe* sqe = NextSqe();
+      if (!sqe)
+        break;
+      AsyncIORequest* req = backlog.front();
+      backlog.pop_front();
+      bool isRead = req->Op == AsyncIOOp::Read;
+      if (req->FixedBuffer >= 0 && m_HasBuffers) {
+        sqe->opcode = isRead ? IORING_OP_READ_FIXED : IORING_OP_WRITE_FIXED;
+        sqe->addr = (uint64)(uintptr_t)req->Data;
+        sqe->len = (uint32)req->Size;
+        sqe->buf_index = (uint16)req->FixedBuffer;
+      } else {
+        req->Vec.iov_base = req->Data;
+        req->Vec.iov_len = req->Size;
+        sqe->opcode = isRead ? IORING_OP_READV : IORING_OP_WRITEV;
+        sqe->addr = (uint64)(uintptr_t)&req->Vec;
+        sqe->len = 1;
+      }
+      sqe->fd = req->Fd;
+      sqe->off = req->Offset;
+      sqe->user_data = (uint64)(uintptr_t)req;
+      CommitSqe();
+      m_InKernel++;
+      queued++;
+    }
+    if (queued > 0 || m_ToSubmit > 0)
+      Enter();
+    if (queued > 0)
+      m_Wake.notify_one();
+  }
+
+  bool RegisterBuffers(const AsyncIOBuffer* buffers, uint32 count) override
+  {
+    std::vector<struct iovec> vecs(count);
+    for (uint32 i = 0; i < count; i++) {
+      vecs[i].iov_base = buffers[i].Data;
+      vecs[i].iov_len = buffers[i].Size;
+    }
+    int ret =
+      SysIoUringRegister(m_RingFd, IORING_REGISTER_BUFFERS, vecs.data(), count);
+    m_HasBuffers = ret == 0;
+    if (!m_HasBuffers) {
+      // e.g. RLIMIT_MEMLOCK too small, requests still work unregistered
+      KLOG(Warn, AsyncIO, "io_uring buffer registration failed (%d).", errno);
+    }
+    return m_HasBuffers;
+  }
+
+  void UnregisterBuffers() override
+  {
+    if (m_HasBuffers) {
+      SysIoUringRegister(m_RingFd, IORING_UNREGISTER_BUFFERS, NULL, 0);
+      m_HasBuffers = false;
+    }
+  }
+
+  void Shutdown() override
+  {
+    if (!m_Reaper)
+      return;
+    for (;;) {
+      // user_data 0 is the stop marker of the reaper
+      {
+        std::lock_guard<std::mutex> lock(m_Owner->Lock);
+        struct io_uring_sqe* sqe = NextSqe();
+        if (sqe) {
+          sqe->opcode = IORING_OP_NOP;
+          sqe->user_data = 0;
+          CommitSqe();
+          m_InKernel++;
+          Enter();
+          m_Wake.notify_one();
+          break;
+        }
+        Enter();
+      }
+      // the sq is full, the reaper needs the lock to make room
+      std::this_thread::yield();
+    }
+    m_Reaper->Join();
+    delete m_Reaper;
+    m_Reaper = nullptr;
+    UnregisterBuffers();
+  }
+
+private:
+  struct io_uring_sqe* NextSqe()
+  {
+    unsigned tail = *m_SqTail;
+    unsigned head = __atomic_load_n(m_SqHead, __ATOMIC_ACQUIRE);
+    if (tail - head >= m_SqEntries)
+      return nullptr;
+    struct io_uring_sqe* sqe = &m_Sqes[tail & m_SqMask];
+    memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+  }
+
+  void CommitSqe()
+  {
+    unsigned tail = *m_SqTail;
+    m_SqArray[tail & m_SqMask] = tail & m_SqMask;
+    __atomic_store_n(m_SqTail, tail + 1, __ATOMIC_RELEASE);
+    m_ToSubmit++;
+  }
+
+  void Enter()
+  {
+    while (m_ToSubmit > 0) {
+      int ret = SysIoUringEnter(m_RingFd, m_ToSubmit, 0, 0);
+      if (ret < 0) {
+        if (errno == EINTR)
+          continue;
+        // EAGAIN/EBUSY : left in m_ToSubmit, the reaper submits them
+        break;
+      }
+      m_ToSubmit -= std::min<uint32>(m_ToSubmit, (uint32)ret);
+      if (ret == 0)
+        break;
+    }
+  }
+
+  void ReapLoop()
+  {
+    std::vector<std::pair<AsyncIORequest*, int64> > done;
+    bool stop = false;
+    while (!stop) {
+      uint32 toSubmit = 0, minComplete = 0;
+      {
+        // sqes left by a failed Enter are submitted here, waiting only
+        // when the kernel holds requests that will complete
+        std::unique_lock<std::mutex> lock(m_Owner->Lock);
+        m_Wake.wait(lock, [this]() { return m_InKernel > 0; });
+        toSubmit = m_ToSubmit;
+        minComplete = m_InKernel > m_ToSubmit ? 1 : 0;
+      }
+      int ret = SysIoUringEnter(m_RingFd, toSubmit, minComplete,
+                                IORING_ENTER_GETEVENTS);
+      if (ret < 0) {
+        if (errno == EAGAIN || errno == EBUSY)
+          std::this_thread::yield();
+        else if (errno != EINTR) {
+          KLOG(Error, AsyncIO, "io_uring_enter failed (%d).", errno);
+          break;
+        }
+      }
+      done.clear();
+      {
+        std::lock_guard<std::mutex> lock(m_Owner->Lock);
+        if (ret > 0 && toSubmit > 0)
+          m_ToSubmit -= std::min<uint32>(m_ToSubmit, (uint32)ret);
+        uint32 reaped = 0;
+        unsigned head = *m_CqHead;
+        unsigned tail = __atomic_load_n(m_CqTail, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++, reaped++) {
+          struct io_uring_cqe* cqe = &m_Cqes[head & m_CqMask];
+          if (cqe->user_data == 0) {
+            stop = true;
+            continue;
+          }
+          AsyncIORequest* req = (AsyncIORequest*)(uintptr_t)cqe->user_data;
+          int64 res = (int64)cqe->res;
+          if (res > 0 && (size_t)res < req->Size) {
+            // short transfer, go on with the rest as BlockingIO does
+            req->Data += res;
+            req->Offset += (uint64)res;
+            req->Size -= (size_t)res;
+            req->Done += (size_t)res;
+            m_Owner->Backlog.push_front(req);
+            continue;
+          }
+          if (res >= 0)
+            res += (int64)req->Done;
+          else if (req->Done > 0)
+            res = (int64)req->Done;
+          done.emplace_back(req, res);
+        }
+        __atomic_store_n(m_CqHead, head, __ATOMIC_RELEASE);
+        m_InKernel -= reaped;
+        // refill the ring from the backlog
+        Issue(m_Owner->Backlog);
+      }
+      for (auto& d : done) {
+        m_Owner->Complete(d.first, d.second);
+      }
+    }
+  }
+
+  void Release()
+  {
+    if (m_Sqes)
+      ::munmap(m_Sqes, m_SqesSize);
+    if (m_CqRing && m_CqRing != m_SqRing)
+      ::munmap(m_CqRing, m_CqRingSize);
+    if (m_SqRing)
+      ::munmap(m_SqRing, m_SqRingSize);
+    if (m_RingFd >= 0)
+      ::close(m_RingFd);
+    m_Sqes = nullptr;
+    m_CqRing = m_SqRing = nullptr;
+    m_RingFd = -1;
+  }
+
+  AsyncIOPrivate* m_Owner;
+  int m_RingFd;
+  kByte* m_SqRing;
+  kByte* m_CqRing;
+  struct io_uring_sqe* m_Sqes;
+  size_t m_SqRingSize;
+  size_t m_CqRingSize;
+  size_t m_SqesSize;
+
+  unsigned* m_SqHead;
+  unsigned* m_SqTail;
+  unsigned* m_SqArray;
+  unsigned m_SqMask;
+  unsigned m_SqEntries;
+  unsigned* m_CqHead;
+  unsigned* m_CqTail;
+  unsigned m_CqMask;
+  struct io_uring_cqe* m_Cqes;
+
+  uint32 m_Depth;
+  uint32 m_InKernel;
+  uint32 m_ToSubmit;
+  Thread* m_Reaper;
+  /// the reaper sleeps on it while nothing is in the kernel
+  std::condition_variable m_Wake;
+  bool m_HasBuffers;
+};
+#endif
+
+//--------------------------------------------------------------------------------------------
+
+AsyncIO::AsyncIO()
+  : d(new AsyncIOPrivate)
+{
+}
+
+AsyncIO::~AsyncIO()
+{
+  Shutdown();
+  delete d;
+  d = nullptr;
+}
+
+bool
+AsyncIO::Init(Desc const& desc)
+{
+  if (d->Impl)
+    return true;
+  d->Desc = desc;
+  d->Desc.QueueDepth = std::max(1u, desc.QueueDepth);
+#if K3D_HAS_IO_URING
+  if (!desc.ForceThreadPool) {
+    IoUringBackend* uring = new IoUringBackend(d);
+    if (uring->Init(d->Desc.QueueDepth)) {
+      d->Impl = uring;
+      d->Type = Backend::IoUring;
+    } else {
+      KLOG(Info, AsyncIO, "io_uring unavailable (%d), using thread pool.",
+           errno);
+      delete uring;
+    }
+  }
+#endif
+  if (!d->Impl) {
+    d->Impl = new PoolBackend(d, desc.NumWorkers);
+    d->Type = Backend::ThreadPool;
+  }
+  KLOG(Info, AsyncIO, "Initialized with %s backend.", BackendName(d->Type));
+  return true;
+}
+
+void
+AsyncIO::Shutdown()
+{
+  if (!d->Impl)
+    return;
+  Drain();
+  d->Impl->Shutdown();
+  delete d->Impl;
+  d->Impl = nullptr;
+  d->Type = Backend::None;
+  d->Buffers.clear();
+  d->Completions.clear();
+}
+
+AsyncIO::Backend
+AsyncIO::GetBackend() const
+{
+  return d->Type;
+}
+
+const char*
+AsyncIO::BackendName(Backend backend)
+{
+  switch (backend) {
+    case Backend::IoUring:
+      return "io_uring";
+    case Backend::ThreadPool:
+      return "thread pool";
+    default:
+      return "none";
+  }
+}
+
+bool
+AsyncIO::RegisterBuffers(const AsyncIOBuffer* buffers, uint32 count)
+{
+  if (!d->Impl || !buffers || count == 0)
+    return false;
+  // registration is only allowed on an idle ring
+  Drain();
+  std::lock_guard<std::mutex> lock(d->Lock);
+  d->Impl->UnregisterBuffers();
+  d->Buffers.assign(buffers, buffers + count);
+  d->Impl->RegisterBuffers(buffers, count);
+  return true;
+}
+
+void
+AsyncIO::UnregisterBuffers()
+{
+  if (!d->Impl)
+    return;
+  Drain();
+  std::lock_guard<std::mutex> lock(d->Lock);
+  d->Impl->UnregisterBuffers();
+  d->Buffers.clear();
+}
+
+bool
+AsyncIO::QueueRead(File::NativeHandle file,
+                   void* data,
+                   size_t size,
+                   uint64 offset,
+                   uint64 userData,
+                   AsyncIOCallback callback,
+                   int32 fixedBuffer)
+{
+  return Queue(AsyncIOOp::Read, file, data, size, offset, userData,
+               std::move(callback), fixedBuffer);
+}
+
+bool
+AsyncIO::QueueWrite(File::NativeHandle file,
+                    const void* data,
+                    size_t size,
+                    uint64 offset,
+                    uint64 userData,
+                    AsyncIOCallback callback,
+                    int32 fixedBuffer)
+{
+  return Queue(AsyncIOOp::Write, file, const_cast<void*>(data), size, offset,
+               userData, std::move(callback), fixedBuffer);
+}
+
+bool
+AsyncIO::Queue(AsyncIOOp op,
+               File::NativeHandle file,
+               void* data,
+               size_t size,
+               uint64 offset,
+               uint64 userData,
+               AsyncIOCallback&& callback,
+               int32 fixedBuffer)
+{
+  if (!d->Impl || !data || size > 0x7fffffffu)
+    return false;
+  std::lock_guard<std::mutex> lock(d->Lock);
+  if (fixedBuffer >= 0) {
+    if (fixedBuffer >= (int32)d->Buffers.size())
+      return false;
+    AsyncIOBuffer const& buf = d->Buffers[fixedBuffer];
+    kByte* begin = (kByte*)buf.Data;
+    if ((kByte*)data < begin || (kByte*)data + size > begin + buf.Size)
+      return false;
+  }
+  AsyncIORequest* req = d->AllocRequest();
+  req->Op = op;
+  req->Fd = file;
+  req->Data = (kByte*)data;
+  req->Size = size;
+  req->Offset = offset;
+  req->Done = 0;
+  req->UserData = userData;
+  req->Callback = std::move(callback);
+  req->FixedBuffer = fixedBuffer;
+  d->Pending.push_back(req);
+  return true;
+}
+
+uint32
+AsyncIO::Submit()
+{
+  if (!d->Impl)
+    return 0;
+  std::lock_guard<std::mutex> lock(d->Lock);
+  uint32 count = (uint32)d->Pending.size();
+  if (count == 0)
+    return 0;
+  d->Backlog.insert(d->Backlog.end(), d->Pending.begin(), d->Pending.end());
+  d->Pending.clear();
+  d->NumInFlight += count;
+  d->Impl->Issue(d->Backlog);
+  return count;
+}
+
+uint32
+AsyncIO::PollCompletions(AsyncIOResult* results, uint32 maxResults)
+{
+  std::lock_guard<std::mutex> lock(d->Lock);
+  uint32 count = std::min(maxResults, (uint32)d->Completions.size());
+  for (uint32 i = 0; i < count; i++) {
+    results[i] = d->Completions.front();
+    d->Completions.pop_front();
+  }
+  return count;
+}
+
+uint32
+AsyncIO::WaitCompletions(AsyncIOResult* results,
+                         uint32 minResults,
+                         uint32 maxResults)
+{
+  Submit();
+  minResults = std::min(minResults, maxResults);
+  std::unique_lock<std::mutex> lock(d->Lock);
+  // give up waiting when nothing is left that could complete
+  d->StateCV.wait(lock, [this, minResults]() {
+    return d->Completions.size() >= minResults || d->NumInFlight == 0;
+  });
+  uint32 count = std::min(maxResults, (uint32)d->Completions.size());
+  for (uint32 i = 0; i < count; i++) {
+    results[i] = d->Completions.front();
+    d->Completions.pop_front();
+  }
+  return count;
+}
+
+void
+AsyncIO::Drain()
+{
+  Submit();
+  std::unique_lock<std::mutex> lock(d->Lock);
+  d->StateCV.wait(lock, [this]() { return d->NumInFlight == 0; });
+}
+
+uint32
+AsyncIO::GetNumInFlight() const
+{
+  std::lock_guard<std::mutex> lock(d->Lock);
+  return d->NumInFlight;
+}
+}
@@ -0,0 +1,131 @@
+#ifndef __AsyncIO_h__
+#define __AsyncIO_h__
+
+#include "Os.h"
+#include <functional>
+
+namespace Os {
+
+enum class AsyncIOOp : uint32
+{
+  Read,
+  Write,
+};
+
+/// result of one request, Result is the transferred bytes or -errno
+struct AsyncIOResult
+{
+  uint64 UserData;
+  int64 Result;
+  AsyncIOOp Op;
+};
+
+typedef std::function<void(AsyncIOResult const&)> AsyncIOCallback;
+
+/// registered buffer, reads/writes on it skip page pinning with io_uring
+struct AsyncIOBuffer
+{
+  void* Data;
+  size_t Size;
+};
+
+struct AsyncIOPrivate;
+
+/**
+ * Batched asynchronous file io.
+ * Requests are queued by QueueRead/QueueWrite and issued together by Submit().
+ * On Linux they go through io_uring, otherwise (or when the kernel refuses
+ * io_uring) a pool of workers services them with positional reads/writes.
+ * Completions are delivered to the request callback on the completion
+ * thread, requests without callback are pushed to a completion queue which
+ * is drained by PollCompletions/WaitCompletions.
+ */
+class K3D_API AsyncIO
+{
+public:
+  enum class Backend : uint32
+  {
+    None,
+    IoUring,
+    ThreadPool,
+  };
+
+  struct Desc
+  {
+    /// max requests in flight
+    uint32 QueueDepth;
+    /// workers of the fallback backend, 0 means cpu core count
+    uint32 NumWorkers;
+    bool ForceThreadPool;
+
+    Desc()
+      : QueueDepth(256)
+      , NumWorkers(0)
+      , ForceThreadPool(false)
+    {
+    }
+  };
+
+  AsyncIO();
+  ~AsyncIO();
+
+  bool Init(Desc const& desc = Desc());
+  /// waits for every request in flight, then releases the backend
+  void Shutdown();
+
+  Backend GetBackend() const;
+  static const char* BackendName(Backend backend);
+
+  /// fixed buffers, use the returned slot index as 'fixedBuffer' parameter
+  bool RegisterBuffers(const AsyncIOBuffer* buffers, uint32 count);
+  void UnregisterBuffers();
+
+  /// \param fixedBuffer index of a registered buffer which contains 'data', -1 if none
+  bool QueueRead(File::NativeHandle file,
+                 void* data,
+                 size_t size,
+                 uint64 offset,
+                 uint64 userData,
+                 AsyncIOCallback callback = nullptr,
+                 int32 fixedBuffer = -1);
+  bool QueueWrite(File::NativeHandle file,
+                  const void* data,
+                  size_t size,
+                  uint64 offset,
+                  uint64 userData,
+                  AsyncIOCallback callback = nullptr,
+                  int32 fixedBuffer = -1);
+
+  /// issue queued requests, returns the number of requests submitted
+  uint32 Submit();
+
+  /// non blocking, returns the number of results written to 'results'
+  uint32 PollCompletions(AsyncIOResult* results, uint32 maxResults);
+  /// blocks until at least 'minResults' are available
+  uint32 WaitCompletions(AsyncIOResult* results,
+                         uint32 minResults,
+                         uint32 maxResults);
+
+  /// submit and block until every request has completed
+  void Drain();
+
+  uint32 GetNumInFlight() const;
+
+  AsyncIO(const AsyncIO&) = delete;
+  AsyncIO& operator=(const AsyncIO&) = delete;
+
+private:
+  bool Queue(AsyncIOOp op,
+             File::NativeHandle file,
+             void* data,
+             size_t size,
+             uint64 offset,
+             uint64 userData,
+             AsyncIOCallback&& callback,
+             int32 fixedBuffer);
+
+  AsyncIOPrivate* d;
+};
+}
+
+#endif
@@ -6,7 +6,9 @@
 #include "Os.h"
 #include "LogUtil.h"
 #include "Utils/StringUtils.h"
-#include <list>
+#include "Utils/farmhash.h"
+#include "Dispatch/ThreadPool.h"
+#include <algorithm>
 
 using namespace std;
 
@@ -15,26 +17,19 @@ namespace k3d
 	class AssetBundleImpl
 	{
 	public:
-		Os::File			BundleFile;
-		Archive				Archv;
+		AssetBundleWriter	Writer;
 
 		kString				BundleDir;
-		kString				CacheDir;
 		kString				BundleName;
-		list<MeshData*>		Meshes;
-		list<CameraData*>	Cameras;
-		list<AssetChunk*>	Chunks;
 		bool				Opened;
 
 		void Initialize()
 		{
-			CacheDir = BundleDir + BundleName;
 			auto bundlePath = BundleDir + BundleName + KT(".bundle");
-			Opened = BundleFile.Open(bundlePath.c_str(), IOWrite);
+			Opened = Writer.Open(bundlePath.c_str());
 			if (Opened)
 			{
 				KLOG(Info, AssetBundleImpl, "Initialize");
-				Archv.SetIODevice(&BundleFile);
 			}
 		}
 
@@ -43,107 +38,55 @@ namespace k3d
 			if (Opened)
 			{
 				KLOG(Info, AssetBundleImpl, "Close");
-				BundleFile.Close();
+				Writer.Finish();
+				Opened = false;
 			}
 		}
 
-		uint64 GetMergedTableSize()
+		static void WriteMesh(Archive & archive, MeshData const& mesh)
 		{
-			return Chunks.size() * sizeof(AssetChunk);
+			EMeshVersion mVer = EMeshVersion::VERSION_1_1;
+			archive << mVer;
+			archive << mesh;
+		}
+
+		static void WriteCamera(Archive & archive, CameraData const& camera)
+		{
+			ECamVersion cVer = ECamVersion::VERSION_1_0;
+			archive << cVer;
+			archive << camera;
 		}
 
 		void Serialize(MeshData * mesh)
 		{
 			if (!mesh)
 				return;
-#if K3DPLATFORM_OS_WIN
-			wchar_t name[128];
-			StringUtil::CharToWchar(mesh->Name(), name, 128);
-			auto path = CacheDir + KT("/") + name;
-#else
-			auto path = CacheDir + KT("/") + mesh->Name();
-#endif
-			Os::File file;
 			KLOG(Info, AssetBundleImpl, "Serialize Mesh: %s", mesh->Name());
-			file.Open(path.c_str(),IOWrite);
-			Archive archive;
-			archive.SetIODevice(&file);
-			EMeshVersion mVer = EMeshVersion::VERSION_1_1;
-			archive << mVer;
-			archive << *mesh;
-			AssetChunk* chunk = new AssetChunk;
-			memset(chunk, 0, sizeof(AssetChunk));
-			chunk->Type = EAssetType::EMesh;
-			chunk->Size = file.GetSize();
-			strncpy(chunk->Name, mesh->Name(), 64);
-			Chunks.push_back(chunk);
-			file.Close();
+			Writer.AddChunk(mesh->Name(), EAssetType::EMesh, [mesh](Archive & archive) { WriteMesh(archive, *mesh); });
 		}
 
 		void Serialize(CameraData * camera)
 		{
 			if (!camera)
 				return;
-#if K3DPLATFORM_OS_WIN
-			wchar_t name[128];
-			StringUtil::CharToWchar(camera->Name(), name, 128);
-			auto path = CacheDir + KT("/") + name;
-#else
-			auto path = CacheDir + KT("/") + camera->Name();
-#endif
-			Os::File file;
 			KLOG(Info, AssetBundleImpl, "Serialize Camera: %s", camera->Name());
-			file.Open(path.c_str(), IOWrite);
-			Archive archive;
-			archive.SetIODevice(&file);
-			ECamVersion cVer = ECamVersion::VERSION_1_0;
-			archive << cVer;
-			archive << *camera;
-			AssetChunk* chunk = new AssetChunk;
-			memset(chunk, 0, sizeof(AssetChunk));
-			chunk->Type = EAssetType::ECamera;
-			chunk->Size = file.GetSize();
-			strncpy(chunk->Name, camera->Name(), 64);
-			Chunks.push_back(chunk);
-			file.Close();
+			Writer.AddChunk(camera->Name(), EAssetType::ECamera, [camera](Archive & archive) { WriteCamera(archive, *camera); });
 		}
 
-		// write chunk table
-		void DumpChunkTable()
+		void Serialize(shared_ptr<MeshData> const& mesh)
 		{
-			Archv << GetMergedTableSize();
-			for (auto Chunk : Chunks)
-			{
-				Archv << *Chunk;
-			}
+			if (!mesh)
+				return;
+			KLOG(Info, AssetBundleImpl, "Serialize Mesh: %s", mesh->Name());
+			Writer.AddChunkAsync(mesh->Name(), EAssetType::EMesh, [mesh](Archive & archive) { WriteMesh(archive, *mesh); });
 		}
 
-		void DumpChunk(AssetChunk * chunk)
+		void Serialize(shared_ptr<CameraData> const& camera)
 		{
-			if (!chunk)
+			if (!camera)
 				return;
-
-#if K3DPLATFORM_OS_WIN
-			wchar_t name[128];
-			StringUtil::CharToWchar(chunk->Name, name, 128);
-			auto path = CacheDir + KT("/") + name;
-#else
-			auto path = CacheDir + KT("/")+ chunk->Name;
-#endif
-			Os::File file;
-			bool opened = file.Open(path.c_str(), IORead);
-            if(!opened)
-                return;
-			int64 szFile = file.GetSize();
-			char * data = new char[szFile];
-			file.Read(data, szFile);
-			// Write Chunk header
-			Archv << chunk->Type;
-			Archv.ArrayIn(data, szFile);
-			// Write Chunk tail
-			Archv << EAssetType::EChunkEnd;
-			file.Close();
-			delete[] data;
+			KLOG(Info, AssetBundleImpl, "Serialize Camera: %s", camera->Name());
+			Writer.AddChunkAsync(camera->Name(), EAssetType::ECamera, [camera](Archive & archive) { WriteCamera(archive, *camera); });
 		}
 	};
 
@@ -161,22 +104,20 @@ namespace k3d
 	{
 		d->Serialize(camera);
 	}
+
+	void AssetBundle::Serialize(shared_ptr<MeshData> const& mesh)
+	{
+		d->Serialize(mesh);
+	}
+
+	void AssetBundle::Serialize(shared_ptr<CameraData> const& camera)
+	{
+		d->Serialize(camera);
+	}
 	
 	void AssetBundle::MergeAndBundle(bool deleteCache)
 	{
 		m_IsBundling = true;
-		EAssetVersion bundleVer = EAssetVersion::E20161210u;
-		d->Archv << bundleVer;
-		d->DumpChunkTable();
-		for (auto c : d->Chunks)
-		{
-			d->DumpChunk(c);
-			delete c;
-		}
-		if (deleteCache) 
-		{
-			Os::Remove(d->CacheDir.c_str());
-		}
 		d->Close();
 		m_IsBundling = false;
 	}
@@ -204,8 +145,720 @@ namespace k3d
 
 	void AssetBundle::Prepare()
 	{
-		auto bundleTmpCache = d->BundleDir + d->BundleName;
-		Os::MakeDir(bundleTmpCache.c_str());
+		// nothing to prepare, chunks no longer go through a cache directory
+	}
+
+	//-------------------------------------------------------------------------------
+
+	namespace
+	{
+		uint64 AlignUp(uint64 value, uint64 alignment)
+		{
+			return (value + alignment - 1) / alignment * alignment;
+		}
+
+		/// start of a chunk at or after 'cursor'
+		uint64 PlaceChunk(uint64 cursor, uint64 size, uint64 alignment)
+		{
+			// packed chunks still start on kAssetChunkMinAlignment, so their
+			// vertex, index and block tables can be used in place
+			uint64 start = AlignUp(cursor, kAssetChunkMinAlignment);
+			uint64 boundary = AlignUp(start, alignment);
+			// small chunks are packed as long as they don't straddle a boundary
+			if (size < alignment && start + size <= boundary)
+				return start;
+			return boundary;
+		}
+
+		/// part of every cache key, bump it when the serialization or the
+		/// compression of chunks changes so older cache entries are not used
+		const uint32 kChunkFormatVersion = 1;
+
+		uint32 GetNumBuckets(uint32 numChunks)
+		{
+			// load factor of 0.5 at most
+			uint32 numBuckets = 16;
+			while (numBuckets < numChunks * 2)
+				numBuckets *= 2;
+			return numBuckets;
+		}
+	}
+
+	AssetBundleReader::AssetBundleReader()
+		: m_Header(nullptr), m_Entries(nullptr), m_Buckets(nullptr), m_Names(nullptr)
+	{
+	}
+
+	AssetBundleReader::~AssetBundleReader()
+	{
+		Close();
+	}
+
+	bool AssetBundleReader::Open(const kchar * bundlePath)
+	{
+		Close();
+		Os::MemMapFile::Options options;
+		options.Hint = Os::MemMapFile::Advice::Random;
+		auto file = std::make_shared<Os::MemMapFile>();
+		if (!file->Open(bundlePath, IORead, options))
+		{
+			KLOG(Error, AssetBundleReader, "Cann't open bundle (%s).", bundlePath);
+			return false;
+		}
+		const kByte * data = file->FileData();
+		uint64 size = (uint64)file->GetSize();
+		if (size < sizeof(AssetBundleHeader))
+			return false;
+		auto header = (const AssetBundleHeader*)data;
+		if (header->Version != EAssetVersion::E20170601u || header->Magic != kAssetBundleMagic)
+		{
+			KLOG(Error, AssetBundleReader, "Bundle (%s) is not an indexed bundle.", bundlePath);
+			return false;
+		}
+		// only the tables are checked here, entries are checked when they are looked up
+		// so opening does not touch the whole index
+		bool valid = header->FileSize == size
+			&& header->NumBuckets != 0 && (header->NumBuckets & (header->NumBuckets - 1)) == 0
+			&& header->NumBuckets > header->NumChunks
+			&& header->IndexOffset + (uint64)header->NumChunks * sizeof(AssetIndexEntry) <= header->BucketOffset
+			&& header->BucketOffset + (uint64)header->NumBuckets * sizeof(uint32) <= header->NamesOffset
+			&& header->NamesOffset <= header->DataOffset && header->DataOffset <= size;
+		if (!valid)
+		{
+			KLOG(Error, AssetBundleReader, "Bundle (%s) is corrupted.", bundlePath);
+			return false;
+		}
+		auto entries = (const AssetIndexEntry*)(data + header->IndexOffset);
+		auto buckets = (const uint32*)(data + header->BucketOffset);
+		m_File = file;
+		m_Header = header;
+		m_Entries = entries;
+		m_Buckets = buckets;
+		m_Names = (const char*)data + header->NamesOffset;
+		return true;
+	}
+
+	void AssetBundleReader::Close()
+	{
+		m_File.reset();
+		m_Header = nullptr;
+		m_Entries = nullptr;
+		m_Buckets = nullptr;
+		m_Names = nullptr;
+	}
+
+	uint32 AssetBundleReader::GetNumChunks() const
+	{
+		return m_Header ? m_Header->NumChunks : 0;
+	}
+
+	uint32 AssetBundleReader::GetChunkAlignment() const
+	{
+		return m_Header ? m_Header->ChunkAlignment : 0;
+	}
+
+	AssetChunkView AssetBundleReader::Find(const char * name) const
+	{
+		return Find(name, strlen(name));
+	}
+
+	AssetChunkView AssetBundleReader::Find(const char * name, size_t length) const
+	{
+		if (!m_Header)
+			return AssetChunkView::Invalid();
+		uint64 hash = util::Hash64(name, length);
+		uint32 mask = m_Header->NumBuckets - 1;
+		for (uint32 slot = (uint32)hash & mask; m_Buckets[slot] != 0; slot = (slot + 1) & mask)
+		{
+			if (m_Buckets[slot] > m_Header->NumChunks)
+				break;
+			auto & entry = m_Entries[m_Buckets[slot] - 1];
+			if (entry.NameHash == hash && entry.NameLength == length && IsEntryValid(entry)
+				&& memcmp(m_Names + entry.NameOffset, name, length) == 0)
+				return MakeView(entry);
+		}
+		return AssetChunkView::Invalid();
+	}
+
+	AssetChunkView AssetBundleReader::GetChunk(uint32 index) const
+	{
+		if (index >= GetNumChunks() || !IsEntryValid(m_Entries[index]))
+			return AssetChunkView::Invalid();
+		return MakeView(m_Entries[index]);
+	}
+
+	bool AssetBundleReader::IsEntryValid(AssetIndexEntry const& entry) const
+	{
+		return entry.Offset >= m_Header->DataOffset && entry.Size <= m_Header->FileSize - entry.Offset
+			&& (uint64)entry.NameOffset + entry.NameLength <= m_Header->DataOffset - m_Header->NamesOffset;
+	}
+
+	AssetChunkView AssetBundleReader::MakeView(AssetIndexEntry const& entry) const
+	{
+		return AssetChunkView{ m_File->FileData() + entry.Offset, entry.Size, entry.Type,
+			m_Names + entry.NameOffset, entry.NameLength, entry.Compression, entry.RawSize };
+	}
+
+	bool AssetBundleReader::Decode(AssetChunkView const& view, void * dst, Dispatch::ThreadPool * workers)
+	{
+		if (!view.IsValid())
+			return false;
+		if (view.Compression == EChunkCompression::ENone)
+		{
+			memcpy(dst, view.Data, (size_t)view.Size);
+			return true;
+		}
+		AssetBlockTable table;
+		if (view.Compression != EChunkCompression::ELZ || view.Size < sizeof(table))
+			return false;
+		memcpy(&table, view.Data, sizeof(table));
+		if (table.BlockSize == 0 || table.NumBlocks != (view.RawSize + table.BlockSize - 1) / table.BlockSize
+			|| sizeof(table) + (uint64)table.NumBlocks * sizeof(uint32) > view.Size)
+			return false;
+		// copied out, bundles written before kAssetChunkMinAlignment packed chunks anywhere
+		std::vector<uint32> blocks(table.NumBlocks);
+		memcpy(blocks.data(), view.Data + sizeof(table), blocks.size() * sizeof(uint32));
+		std::vector<uint64> offsets(table.NumBlocks + 1);
+		offsets[0] = sizeof(table) + blocks.size() * sizeof(uint32);
+		for (uint32 b = 0; b < table.NumBlocks; b++)
+		{
+			offsets[b + 1] = offsets[b] + (blocks[b] & ~kAssetBlockStored);
+			if (offsets[b + 1] > view.Size)
+				return false;
+		}
+		std::atomic<bool> ok(true);
+		auto decodeBlocks = [&](uint32 begin, uint32 end)
+		{
+			for (uint32 b = begin; b < end; b++)
+			{
+				kByte * out = (kByte*)dst + (uint64)b * table.BlockSize;
+				size_t raw = (size_t)std::min<uint64>(table.BlockSize, view.RawSize - (uint64)b * table.BlockSize);
+				size_t stored = (size_t)(offsets[b + 1] - offsets[b]);
+				if (blocks[b] & kAssetBlockStored)
+				{
+					if (stored != raw)
+						ok = false;
+					else
+						memcpy(out, view.Data + offsets[b], raw);
+				}
+				else if (LZ::Decompress(view.Data + offsets[b], stored, out, raw) != raw)
+				{
+					ok = false;
+				}
+			}
+		};
+		if (workers && table.NumBlocks > 1)
+			workers->ParallelFor(0, table.NumBlocks, 1, decodeBlocks);
+		else
+			decodeBlocks(0, table.NumBlocks);
+		return ok;
+	}
+
+	bool AssetBundleReader::ReadVersion(const kchar * bundlePath, EAssetVersion & version)
+	{
+		Os::File file;
+		if (!file.Open(bundlePath, IORead))
+			return false;
+		return file.ReadAt(&version, sizeof(version), 0) == sizeof(version);
+	}
+
+	//-------------------------------------------------------------------------------
+
+	struct AssetBundleWriter::PendingChunk
+	{
+		uint32				Index;
+		std::string			Name;
+		EAssetType			Type;
+		uint64				Size;
+		/// in memory unless FilePath is set
+		std::vector<kByte>	Data;
+		kString				FilePath;
+		uint64				FileOffset;
+		/// FilePath is a spill file, removed after it was copied
+		bool				IsSpill;
+		bool				WasSpilled;
+		bool				Failed;
+		EChunkCompression	Compression;
+		LZ::Level			Level;
+		uint32				BlockSize;
+		uint64				RawSize;
+		/// the processing key if the chunk is cached
+		AssetCacheKey		CacheKey;
+		/// of the stored bytes, invalid if they could not be read
+		AssetCacheKey		ContentHash;
+		bool				FromCache;
+	};
+
+	/// serialization target of one chunk, switches to a spill file when the
+	/// writer runs out of memory budget
+	class ChunkBuffer : public IIODevice
+	{
+	public:
+		ChunkBuffer(AssetBundleWriter * writer, AssetBundleWriter::PendingChunk * chunk, kString const& spillPath)
+			: m_Writer(writer), m_Chunk(chunk), m_SpillPath(spillPath), m_Spilled(false)
+		{}
+
+		bool	Open(const kchar *, IOFlag) override { return false; }
+		bool	IsEOF() override { return true; }
+		size_t	Read(char *, size_t) override { return 0; }
+		bool	Seek(size_t) override { return false; }
+		bool	Skip(size_t) override { return false; }
+		void	Flush() override {}
+
+		size_t Write(const void * data, size_t len) override
+		{
+			if (m_Chunk->Failed)
+				return 0;
+			if (!m_Spilled && m_Writer->ReserveMemory(len))
+			{
+				m_Chunk->Data.insert(m_Chunk->Data.end(), (const kByte*)data, (const kByte*)data + len);
+				m_Chunk->Size += len;
+				return len;
+			}
+			if (!m_Spilled && !Spill())
+				return 0;
+			if (m_File.Write(data, len) != len)
+			{
+				m_Chunk->Failed = true;
+				return 0;
+			}
+			m_Chunk->Size += len;
+			return len;
+		}
+
+		void Close() override
+		{
+			if (m_Spilled)
+				m_File.Close();
+		}
+
+	private:
+		bool Spill()
+		{
+			m_Spilled = true;
+			if (!m_File.Open(m_SpillPath.c_str(), IOWrite)
+				|| m_File.Write(m_Chunk->Data.data(), m_Chunk->Data.size()) != m_Chunk->Data.size())
+			{
+				KLOG(Error, AssetBundleWriter, "Failed to write spill file for chunk %s.", m_Chunk->Name.c_str());
+				m_Chunk->Failed = true;
+				return false;
+			}
+			m_Writer->ReleaseMemory(m_Chunk->Data.size());
+			std::vector<kByte>().swap(m_Chunk->Data);
+			m_Chunk->FilePath = m_SpillPath;
+			m_Chunk->IsSpill = true;
+			m_Chunk->WasSpilled = true;
+			return true;
+		}
+
+		AssetBundleWriter *					m_Writer;
+		AssetBundleWriter::PendingChunk *	m_Chunk;
+		kString								m_SpillPath;
+		Os::File							m_File;
+		bool								m_Spilled;
+	};
+
+	AssetBundleWriter::AssetBundleWriter(uint32 chunkAlignment, uint64 memoryBudget)
+		: m_ChunkAlignment(chunkAlignment)
+		, m_Compression(EChunkCompression::ENone)
+		, m_CompressionLevel(LZ::Fast)
+		, m_BlockSize(kAssetBlockSize)
+		, m_Cache(nullptr)
+		, m_MemoryBudget(memoryBudget)
+		, m_BufferedBytes(0)
+	{
+		memset(&m_Stats, 0, sizeof(m_Stats));
+	}
+
+	AssetBundleWriter::~AssetBundleWriter()
+	{
+		if (m_File)
+			Finish();
+	}
+
+	bool AssetBundleWriter::Open(const kchar * bundlePath)
+	{
+		m_Path = bundlePath;
+		m_File.reset(new Os::File);
+		if (!m_File->Open((m_Path + KT(".partial")).c_str(), IOWrite))
+		{
+			m_File.reset();
+			return false;
+		}
+		memset(&m_Stats, 0, sizeof(m_Stats));
+		return true;
+	}
+
+	AssetBundleWriter::PendingChunk * AssetBundleWriter::NewChunk(const char * name, EAssetType type)
+	{
+		std::unique_ptr<PendingChunk> chunk(new PendingChunk);
+		chunk->Index = (uint32)m_Chunks.size();
+		chunk->Name = name;
+		chunk->Type = type;
+		chunk->Size = 0;
+		chunk->FileOffset = 0;
+		chunk->IsSpill = false;
+		chunk->WasSpilled = false;
+		chunk->Failed = false;
+		chunk->Compression = m_Compression;
+		chunk->Level = m_CompressionLevel;
+		chunk->BlockSize = m_BlockSize;
+		chunk->RawSize = 0;
+		chunk->CacheKey = AssetCacheKey{ 0, 0 };
+		chunk->ContentHash = AssetCacheKey{ 0, 0 };
+		chunk->FromCache = false;
+		m_Chunks.push_back(std::move(chunk));
+		return m_Chunks.back().get();
+	}
+
+	void AssetBundleWriter::SerializeChunk(PendingChunk * chunk, SerializeFunc const& serialize)
+	{
+		std::string suffix = "." + std::to_string(chunk->Index) + ".spill";
+		ChunkBuffer buffer(this, chunk, m_Path + kString(suffix.begin(), suffix.end()));
+		Archive archive;
+		archive.SetIODevice(&buffer);
+		serialize(archive);
+		buffer.Close();
+		chunk->RawSize = chunk->Size;
+		if (chunk->Failed)
+			return;
+		if (m_Cache && !chunk->CacheKey.IsValid() && chunk->Compression != EChunkCompression::ENone)
+		{
+			// compressing is the expensive part, the serialized bytes are its source
+			chunk->CacheKey = GetProcessingKey(HashChunk(*chunk), *chunk);
+			if (LoadCachedChunk(chunk))
+				return;
+		}
+		if (chunk->Compression != EChunkCompression::ENone)
+			CompressChunk(chunk);
+		chunk->ContentHash = HashChunk(*chunk);
+		if (m_Cache && chunk->CacheKey.IsValid())
+			StoreCachedChunk(chunk);
+	}
+
+	AssetCacheKey AssetBundleWriter::HashChunk(PendingChunk const& chunk)
+	{
+		if (chunk.FilePath.empty() || chunk.Size == 0)
+			return AssetCache::HashData(chunk.Data.data(), (size_t)chunk.Size);
+		Os::MemMapFile file;
+		if (!file.Open(chunk.FilePath.c_str(), IORead) || (uint64)file.GetSize() < chunk.FileOffset + chunk.Size)
+			return AssetCacheKey{ 0, 0 };
+		return AssetCache::HashData(file.FileData() + chunk.FileOffset, (size_t)chunk.Size);
+	}
+
+	AssetCacheKey AssetBundleWriter::GetProcessingKey(AssetCacheKey const& source, PendingChunk const& chunk) const
+	{
+		uint32 params[] = { kChunkFormatVersion, (uint32)chunk.Type, (uint32)chunk.Compression, (uint32)chunk.Level, chunk.BlockSize };
+		return AssetCache::MakeKey(source, params, sizeof(params));
+	}
+
+	bool AssetBundleWriter::LoadCachedChunk(PendingChunk * chunk)
+	{
+		AssetCacheEntry entry;
+		kString path = m_Cache->Find(chunk->CacheKey, entry);
+		if (path.empty())
+			return false;
+		if (chunk->IsSpill)
+			Os::Remove(chunk->FilePath.c_str());
+		else
+			ReleaseMemory(chunk->Data.size());
+		std::vector<kByte>().swap(chunk->Data);
+		// copied from the cache entry on Finish()
+		chunk->FilePath = path;
+		chunk->FileOffset = sizeof(AssetCacheEntry);
+		chunk->IsSpill = false;
+		chunk->Size = entry.Size;
+		chunk->RawSize = entry.RawSize;
+		chunk->Compression = (EChunkCompression)entry.Compression;
+		chunk->ContentHash = entry.ContentHash;
+		chunk->FromCache = true;
+		return true;
+	}
+
+	void AssetBundleWriter::StoreCachedChunk(PendingChunk * chunk)
+	{
+		if (!chunk->ContentHash.IsValid())
+			return;
+		AssetCacheEntry entry = { kAssetCacheMagic, (uint32)chunk->Compression, chunk->Size, chunk->RawSize, chunk->ContentHash };
+		bool stored = chunk->FilePath.empty()
+			? m_Cache->Store(chunk->CacheKey, entry, chunk->Data.data())
+			: m_Cache->Store(chunk->CacheKey, entry, chunk->FilePath.c_str(), chunk->FileOffset);
+		if (!stored)
+			KLOG(Warn, AssetBundleWriter, "Failed to cache chunk %s.", chunk->Name.c_str());
+	}
+
+	void AssetBundleWriter::CompressChunk(PendingChunk * chunk)
+	{
+		Os::MemMapFile spill;
+		const kByte * src = chunk->Data.data();
+		if (chunk->IsSpill)
+		{
+			if (!spill.Open(chunk->FilePath.c_str(), IORead))
+			{
+				chunk->Compression = EChunkCompression::ENone;
+				return;
+			}
+			src = spill.FileData();
+		}
+		uint64 size = chunk->Size;
+		uint32 blockSize = chunk->BlockSize;
+		AssetBlockTable table = { (uint32)((size + blockSize - 1) / blockSize), blockSize };
+		size_t headerSize = sizeof(AssetBlockTable) + table.NumBlocks * sizeof(uint32);
+		std::vector<kByte> out(headerSize + table.NumBlocks * LZ::CompressBound(blockSize));
+		memcpy(out.data(), &table, sizeof(table));
+		size_t stored = headerSize;
+		for (uint32 b = 0; b < table.NumBlocks; b++)
+		{
+			const kByte * block = src + (uint64)b * blockSize;
+			size_t raw = (size_t)std::min<uint64>(blockSize, size - (uint64)b * blockSize);
+			size_t packed = LZ::Compress(block, raw, out.data() + stored, out.size() - stored, chunk->Level);
+			uint32 blockEntry = (uint32)packed;
+			if (packed == 0 || packed >= raw)
+			{
+				memcpy(out.data() + stored, block, raw);
+				packed = raw;
+				blockEntry = (uint32)raw | kAssetBlockStored;
+			}
+			memcpy(out.data() + sizeof(AssetBlockTable) + b * sizeof(uint32), &blockEntry, sizeof(uint32));
+			stored += packed;
+		}
+		if (stored >= size)
+		{
+			chunk->Compression = EChunkCompression::ENone;
+			return;
+		}
+		out.resize(stored);
+		out.shrink_to_fit();
+		if (chunk->IsSpill)
+		{
+			spill.Close();
+			if (!ReserveMemory(stored))
+			{
+				// still over budget, the compressed chunk replaces the raw one in the spill file
+				Os::File file;
+				if (!file.Open(chunk->FilePath.c_str(), IOWrite) || file.Write(out.data(), stored) != stored)
+				{
+					KLOG(Error, AssetBundleWriter, "Failed to write spill file for chunk %s.", chunk->Name.c_str());
+					chunk->Failed = true;
+				}
+				file.Close();
+				chunk->Size = stored;
+				return;
+			}
+			Os::Remove(chunk->FilePath.c_str());
+			chunk->FilePath.clear();
+			chunk->IsSpill = false;
+		}
+		else
+		{
+			// the compressed bytes keep their share of the raw chunk's reservation
+			ReleaseMemory(chunk->Data.size() - stored);
+		}
+		chunk->Data.swap(out);
+		chunk->Size = stored;
+	}
+
+	void AssetBundleWriter::SetCompression(EChunkCompression compression, LZ::Level level, uint32 blockSize)
+	{
+		m_Compression = compression;
+		m_CompressionLevel = level;
+		m_BlockSize = blockSize;
+	}
+
+	void AssetBundleWriter::AddChunk(const char * name, EAssetType type, const void * data, uint64 size)
+	{
+		AddChunk(name, type, [data, size](Archive & archive) { archive.ArrayIn((const kByte*)data, (size_t)size); });
+	}
+
+	void AssetBundleWriter::AddChunk(const char * name, EAssetType type, SerializeFunc const& serialize)
+	{
+		SerializeChunk(NewChunk(name, type), serialize);
+	}
+
+	void AssetBundleWriter::AddChunkAsync(const char * name, EAssetType type, SerializeFunc && serialize)
+	{
+		SerializeAsync(NewChunk(name, type), std::move(serialize));
+	}
+
+	void AssetBundleWriter::AddChunkCached(const char * name, EAssetType type, AssetCacheKey const& sourceKey, SerializeFunc && serialize)
+	{
+		PendingChunk * chunk = NewChunk(name, type);
+		if (m_Cache && sourceKey.IsValid())
+		{
+			chunk->CacheKey = GetProcessingKey(sourceKey, *chunk);
+			if (LoadCachedChunk(chunk))
+				return;
+		}
+		SerializeAsync(chunk, std::move(serialize));
+	}
+
+	void AssetBundleWriter::SerializeAsync(PendingChunk * chunk, SerializeFunc && serialize)
+	{
+		if (!m_Workers)
+			m_Workers.reset(new Dispatch::ThreadPool(0, "BundleWriter"));
+		auto func = std::make_shared<SerializeFunc>(std::move(serialize));
+		m_Workers->Submit([this, chunk, func]() { SerializeChunk(chunk, *func); });
+	}
+
+	bool AssetBundleWriter::AddFile(const char * name, EAssetType type, const kchar * filePath)
+	{
+		Os::File file;
+		if (!file.Open(filePath, IORead))
+			return false;
+		PendingChunk * chunk = NewChunk(name, type);
+		chunk->Size = (uint64)file.GetSize();
+		chunk->RawSize = chunk->Size;
+		chunk->FilePath = filePath;
+		// copied as is
+		chunk->Compression = EChunkCompression::ENone;
+		chunk->ContentHash = HashChunk(*chunk);
+		return true;
+	}
+
+	bool AssetBundleWriter::ReserveMemory(uint64 size)
+	{
+		uint64 buffered = m_BufferedBytes.fetch_add(size) + size;
+		if (buffered <= m_MemoryBudget)
+			return true;
+		m_BufferedBytes.fetch_sub(size);
+		return false;
 	}
 
+	void AssetBundleWriter::ReleaseMemory(uint64 size)
+	{
+		m_BufferedBytes.fetch_sub(size);
+	}
+
+	bool AssetBundleWriter::Finish()
+	{
+		if (!m_File)
+			return false;
+		if (m_Workers)
+			m_Workers->WaitIdle();
+		uint32 numChunks = (uint32)m_Chunks.size();
+		AssetBundleHeader header;
+		memset(&header, 0, sizeof(header));
+		header.Version = EAssetVersion::E20170601u;
+		header.Magic = kAssetBundleMagic;
+		header.ChunkAlignment = m_ChunkAlignment;
+		header.NumChunks = numChunks;
+		header.NumBuckets = GetNumBuckets(numChunks);
+		header.IndexOffset = AlignUp(sizeof(AssetBundleHeader), 8);
+		header.BucketOffset = header.IndexOffset + (uint64)numChunks * sizeof(AssetIndexEntry);
+
+		std::vector<AssetIndexEntry> entries(numChunks);
+		std::vector<uint32> buckets(header.NumBuckets, 0);
+		std::string names;
+		// index of the chunk whose data an entry uses, equal content is stored once
+		std::vector<uint32> sources(numChunks);
+		std::unordered_map<AssetCacheKey, uint32, AssetCacheKeyHash> contents;
+		for (uint32 i = 0; i < numChunks; i++)
+		{
+			auto & chunk = *m_Chunks[i];
+			auto & entry = entries[i];
+			sources[i] = i;
+			if (chunk.ContentHash.IsValid())
+			{
+				auto inserted = contents.emplace(chunk.ContentHash, i);
+				auto & first = *m_Chunks[inserted.first->second];
+				if (!inserted.second && first.Size == chunk.Size && first.RawSize == chunk.RawSize
+					&& first.Compression == chunk.Compression)
+					sources[i] = inserted.first->second;
+			}
+			memset(&entry, 0, sizeof(entry));
+			entry.NameHash = util::Hash64(chunk.Name.data(), chunk.Name.size());
+			entry.Size = chunk.Size;
+			entry.Type = chunk.Type;
+			entry.Compression = chunk.Compression;
+			entry.RawSize = chunk.RawSize;
+			entry.NameOffset = (uint32)names.size();
+			entry.NameLength = (uint32)chunk.Name.size();
+			names += chunk.Name;
+			uint32 mask = header.NumBuckets - 1;
+			uint32 slot = (uint32)entry.NameHash & mask;
+			while (buckets[slot] != 0)
+				slot = (slot + 1) & mask;
+			buckets[slot] = i + 1;
+		}
+		header.NamesOffset = header.BucketOffset + (uint64)header.NumBuckets * sizeof(uint32);
+		header.DataOffset = AlignUp(header.NamesOffset + names.size(), m_ChunkAlignment);
+		uint64 cursor = header.DataOffset;
+		for (uint32 i = 0; i < numChunks; i++)
+		{
+			if (sources[i] != i)
+			{
+				entries[i].Offset = entries[sources[i]].Offset;
+				continue;
+			}
+			entries[i].Offset = PlaceChunk(cursor, entries[i].Size, m_ChunkAlignment);
+			cursor = entries[i].Offset + entries[i].Size;
+		}
+		header.FileSize = cursor;
+
+		bool ok = std::none_of(m_Chunks.begin(), m_Chunks.end(), [](std::unique_ptr<PendingChunk> const& c) { return c->Failed; })
+			&& m_File->WriteAt(&header, sizeof(header), 0) == sizeof(header)
+			&& m_File->WriteAt(entries.data(), entries.size() * sizeof(AssetIndexEntry), header.IndexOffset) == entries.size() * sizeof(AssetIndexEntry)
+			&& m_File->WriteAt(buckets.data(), buckets.size() * sizeof(uint32), header.BucketOffset) == buckets.size() * sizeof(uint32)
+			&& m_File->WriteAt(names.data(), names.size(), header.NamesOffset) == names.size();
+		// stream the chunks into place, each buffer is freed once written
+		for (uint32 i = 0; i < numChunks; i++)
+		{
+			auto & chunk = *m_Chunks[i];
+			if (sources[i] != i)
+			{
+				m_Stats.NumDeduplicated++;
+				m_Stats.BytesDeduplicated += chunk.Size;
+			}
+			else if (ok && chunk.FilePath.empty())
+			{
+				ok = m_File->WriteAt(chunk.Data.data(), (size_t)chunk.Size, entries[i].Offset) == chunk.Size;
+			}
+			else if (ok)
+			{
+				Os::File file;
+				ok = file.Open(chunk.FilePath.c_str(), IORead)
+					&& m_File->CopyFrom(file, chunk.FileOffset, (size_t)chunk.Size, entries[i].Offset) == chunk.Size;
+			}
+			if (chunk.FromCache)
+				m_Stats.NumCacheHits++;
+			if (chunk.WasSpilled)
+			{
+				m_Stats.NumSpilled++;
+				m_Stats.BytesSpilled += chunk.RawSize;
+			}
+			if (chunk.IsSpill)
+				Os::Remove(chunk.FilePath.c_str());
+			if (chunk.Compression != EChunkCompression::ENone)
+			{
+				m_Stats.NumCompressed++;
+				m_Stats.BytesBeforeCompression += chunk.RawSize;
+				m_Stats.BytesAfterCompression += chunk.Size;
+			}
+			std::vector<kByte>().swap(chunk.Data);
+		}
+		// padding is left as holes, the last byte makes the file size match when
+		// no data ends the file (no or empty chunks)
+		uint64 dataEnd = header.NamesOffset + names.size();
+		for (auto & entry : entries)
+			dataEnd = std::max(dataEnd, entry.Offset + entry.Size);
+		if (ok && dataEnd < header.FileSize)
+		{
+			kByte zero = 0;
+			ok = m_File->WriteAt(&zero, 1, header.FileSize - 1) == 1;
+		}
+		m_File->Close();
+		m_File.reset();
+		// replaced in one step, mappings of the former bundle stay valid
+		kString partial = m_Path + KT(".partial");
+		if (ok)
+			ok = Os::Rename(partial.c_str(), m_Path.c_str());
+		else
+			Os::Remove(partial.c_str());
+		m_Chunks.clear();
+		m_BufferedBytes = 0;
+		m_Stats.BytesWritten = ok ? header.FileSize : 0;
+		if (!ok)
+			KLOG(Error, AssetBundleWriter, "Failed to write bundle.");
+		return ok;
+	}
 }
@@ -1,12 +1,32 @@
 #pragma once
 
 #include <KTL/Archive.hpp>
+#include "AssetCache.h"
+#include "Utils/LZ.h"
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Os
+{
+	class	File;
+	class	MemMapFile;
+}
+
+namespace Dispatch
+{
+	class	ThreadPool;
+}
 
 namespace k3d
 {
 	enum class EAssetVersion : uint64
 	{
 		E20161210u,
+		/// indexed layout, see AssetBundleHeader
+		E20170601u,
 	};
 
 	/// \brief asset type : include shader, mesh, camera, material, image
@@ -18,6 +38,8 @@ namespace k3d
 		EShaderBytes	 = 0x86,
 		EMesh			 = 0x87,
 		ECamera			 = 0x88,
+		EMeshlets		 = 0x89,
+		EMeshLods		 = 0x8A,
 
 		EChunkEnd		 = 0xFF
 	};
@@ -41,6 +63,217 @@ namespace k3d
 		char		Name[64];
 	};
 
+	/// \brief v2 bundle layout, all offsets are from the start of the file
+	///
+	/// AssetBundleHeader
+	/// AssetIndexEntry[NumChunks]
+	/// uint32 Buckets[NumBuckets]		open addressing on the name hash, entry index + 1, 0 is empty
+	/// char Names[]					not terminated, see AssetIndexEntry::NameOffset
+	/// chunk data						chunks start at a multiple of ChunkAlignment, except smaller
+	///									chunks which fit before the next boundary and start at a
+	///									multiple of kAssetChunkMinAlignment; entries with equal
+	///									content share their data
+	///
+	/// A compressed chunk is an AssetBlockTable, the stored size of every block
+	/// (kAssetBlockStored set if the block is stored raw), then the blocks.
+	/// Blocks are BlockSize bytes when decoded, except the last one, and decode
+	/// independently.
+	/// \class AssetBundleHeader
+	struct AssetBundleHeader
+	{
+		EAssetVersion	Version;
+		uint32			Magic;
+		uint32			ChunkAlignment;
+		uint32			NumChunks;
+		uint32			NumBuckets;
+		uint64			IndexOffset;
+		uint64			BucketOffset;
+		uint64			NamesOffset;
+		uint64			DataOffset;
+		uint64			FileSize;
+	};
+
+	enum class EChunkCompression : uint32
+	{
+		ENone,
+		/// Utils/LZ.h, in blocks
+		ELZ,
+	};
+
+	struct AssetIndexEntry
+	{
+		/// util::Hash64 of the name
+		uint64			NameHash;
+		uint64			Offset;
+		uint64			Size;
+		EAssetType		Type;
+		uint32			NameOffset;
+		uint32			NameLength;
+		EChunkCompression	Compression;
+		/// decoded size, equals Size for uncompressed chunks
+		uint64			RawSize;
+	};
+
+	struct AssetBlockTable
+	{
+		uint32			NumBlocks;
+		uint32			BlockSize;
+	};
+
+	const uint32 kAssetBlockStored = 0x80000000u;
+	const uint32 kAssetBlockSize = 256 * 1024;
+
+	const uint32 kAssetBundleMagic = 0x4244334B; // "K3DB"
+	const uint32 kAssetBundleAlignment = 64 * 1024;
+	/// alignment of packed chunks, enough for in-place vertex/index buffers and SIMD loads
+	const uint32 kAssetChunkMinAlignment = 16;
+
+	/// \brief chunk data inside a mapped bundle, valid while the reader is open
+	struct AssetChunkView
+	{
+		/// stored bytes, see Compression
+		const kByte *		Data;
+		uint64				Size;
+		EAssetType			Type;
+		const char *		Name;
+		uint32				NameLength;
+		EChunkCompression	Compression;
+		uint64				RawSize;
+
+		bool IsValid() const { return Data != nullptr; }
+		/// the view of a chunk that isn't there
+		static AssetChunkView Invalid() { return AssetChunkView{ nullptr, 0, EAssetType::EChunkEnd, nullptr, 0, EChunkCompression::ENone, 0 }; }
+	};
+
+	/// \brief read-only access to a v2 bundle through a shared MemMapFile,
+	/// name lookups are one hash probe and return views into the mapping
+	/// \class AssetBundleReader
+	class K3D_API AssetBundleReader
+	{
+	public:
+		AssetBundleReader();
+		~AssetBundleReader();
+
+		bool			Open(const kchar * bundlePath);
+		void			Close();
+		bool			IsOpen() const { return m_Header != nullptr; }
+
+		uint32			GetNumChunks() const;
+		uint32			GetChunkAlignment() const;
+		/// \return an invalid view if the bundle has no such chunk
+		AssetChunkView	Find(const char * name) const;
+		AssetChunkView	Find(const char * name, size_t length) const;
+		AssetChunkView	GetChunk(uint32 index) const;
+		/// keeps the mapping of the views alive after Close()
+		std::shared_ptr<Os::MemMapFile>	GetFile() const { return m_File; }
+
+		/// decodes the chunk into 'dst' of view.RawSize bytes, the blocks of a
+		/// compressed chunk are spread over 'workers' if given
+		static bool		Decode(AssetChunkView const& view, void * dst, Dispatch::ThreadPool * workers = nullptr);
+
+		/// version of the bundle at bundlePath without validating it
+		static bool		ReadVersion(const kchar * bundlePath, EAssetVersion & version);
+
+	private:
+		/// ranges inside the file
+		bool			IsEntryValid(AssetIndexEntry const& entry) const;
+		AssetChunkView	MakeView(AssetIndexEntry const& entry) const;
+
+		std::shared_ptr<Os::MemMapFile>	m_File;
+		const AssetBundleHeader *		m_Header;
+		const AssetIndexEntry *			m_Entries;
+		const uint32 *					m_Buckets;
+		const char *					m_Names;
+	};
+
+	/// \brief writes a v2 bundle in one pass. Chunks are serialized into memory,
+	/// or into spill files next to the bundle once the memory budget is used up;
+	/// Finish() lays out the table from the chunk sizes and streams the chunks
+	/// into place, spill files are copied by the kernel where supported.
+	/// Chunks with equal stored bytes are written once. The bundle is written to
+	/// "<path>.partial" and renamed over 'path' by Finish(), so a reader never
+	/// maps a half written bundle and views into the former one stay valid.
+	/// \class AssetBundleWriter
+	class K3D_API AssetBundleWriter
+	{
+	public:
+		typedef std::function<void(Archive &)> SerializeFunc;
+
+		struct Stats
+		{
+			uint32	NumSpilled;
+			uint64	BytesSpilled;
+			uint64	BytesWritten;
+			uint32	NumCompressed;
+			/// raw and stored bytes of the compressed chunks
+			uint64	BytesBeforeCompression;
+			uint64	BytesAfterCompression;
+			/// chunks taken from the cache instead of being processed
+			uint32	NumCacheHits;
+			/// chunks sharing the data of an earlier chunk
+			uint32	NumDeduplicated;
+			uint64	BytesDeduplicated;
+		};
+
+		explicit AssetBundleWriter(uint32 chunkAlignment = kAssetBundleAlignment, uint64 memoryBudget = 256ull << 20);
+		~AssetBundleWriter();
+
+		bool			Open(const kchar * bundlePath);
+		/// applies to the chunks added after it, chunks which don't get smaller are stored raw
+		void			SetCompression(EChunkCompression compression, LZ::Level level = LZ::Fast, uint32 blockSize = kAssetBlockSize);
+		/// processed chunks are looked up in and added to 'cache': chunks added with a
+		/// source key, and compressed chunks by their serialized bytes
+		void			SetCache(AssetCache * cache) { m_Cache = cache; }
+		/// copies the data
+		void			AddChunk(const char * name, EAssetType type, const void * data, uint64 size);
+		/// serializes on the calling thread
+		void			AddChunk(const char * name, EAssetType type, SerializeFunc const& serialize);
+		/// serializes on a worker thread, chunks keep the order they were added in
+		void			AddChunkAsync(const char * name, EAssetType type, SerializeFunc && serialize);
+		/// like AddChunkAsync, but 'serialize' is skipped if the cache has the chunk made
+		/// from 'sourceKey' with the current settings
+		/// \param sourceKey hash of everything 'serialize' reads, e.g. AssetCache::HashFile of the source
+		void			AddChunkCached(const char * name, EAssetType type, AssetCacheKey const& sourceKey, SerializeFunc && serialize);
+		/// the file is copied on Finish()
+		bool			AddFile(const char * name, EAssetType type, const kchar * filePath);
+		/// waits for the pending serializations and writes the bundle
+		bool			Finish();
+
+		uint32			GetNumChunks() const { return (uint32)m_Chunks.size(); }
+		Stats			GetStats() const { return m_Stats; }
+
+	private:
+		struct PendingChunk;
+		friend class ChunkBuffer;
+
+		PendingChunk *	NewChunk(const char * name, EAssetType type);
+		void			SerializeChunk(PendingChunk * chunk, SerializeFunc const& serialize);
+		void			SerializeAsync(PendingChunk * chunk, SerializeFunc && serialize);
+		void			CompressChunk(PendingChunk * chunk);
+		/// key of the chunk made from 'source' with the settings of 'chunk'
+		AssetCacheKey	GetProcessingKey(AssetCacheKey const& source, PendingChunk const& chunk) const;
+		/// replaces the chunk data with the cache entry of chunk->CacheKey
+		bool			LoadCachedChunk(PendingChunk * chunk);
+		void			StoreCachedChunk(PendingChunk * chunk);
+		static AssetCacheKey	HashChunk(PendingChunk const& chunk);
+		/// takes bytes from the memory budget, false once it is used up
+		bool			ReserveMemory(uint64 size);
+		void			ReleaseMemory(uint64 size);
+
+		std::unique_ptr<Os::File>						m_File;
+		kString											m_Path;
+		uint32											m_ChunkAlignment;
+		EChunkCompression								m_Compression;
+		LZ::Level										m_CompressionLevel;
+		uint32											m_BlockSize;
+		AssetCache *									m_Cache;
+		uint64											m_MemoryBudget;
+		std::atomic<uint64>								m_BufferedBytes;
+		std::vector<std::unique_ptr<PendingChunk>>		m_Chunks;
+		std::unique_ptr<Dispatch::ThreadPool>			m_Workers;
+		Stats											m_Stats;
+	};
+
 	class ImageData;
 	class MeshData;
 	class CameraData;
@@ -54,9 +287,14 @@ namespace k3d
 
 		void Prepare();
 
+		/// serialized before returning
 		void Serialize(MeshData *);
 		void Serialize(CameraData *);
+		/// serialized on a worker thread, the bundle holds the object until then
+		void Serialize(std::shared_ptr<MeshData> const&);
+		void Serialize(std::shared_ptr<CameraData> const&);
 
+		/// \param deleteCache unused, spill files are always removed
 		void MergeAndBundle(bool deleteCache);
 
 	private:
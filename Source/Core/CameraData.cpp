@@ -4,7 +4,9 @@
 namespace k3d
 {
 	CameraData::CameraData()
+		: m_FOV(0.0f), m_FocalLength(0.0f), m_NearPlane(0.0f), m_FarPlane(0.0f)
 	{
+		memset(m_Name, 0, 64);
 	}
 
 	CameraData::~CameraData()
@@ -18,7 +20,10 @@ namespace k3d
 
 	Archive& operator << (class Archive & arch, const CameraData & camera)
 	{
-		arch.ArrayIn(CameraData::ClassName(), 64);
+		// padded, serialized chunks are compared and hashed byte by byte
+		char className[64] = {};
+		strncpy(className, CameraData::ClassName(), 63);
+		arch.ArrayIn(className, 64);
 		arch.ArrayIn(camera.m_Name, 64);
 
 		arch << camera.m_FOV;
@@ -0,0 +1,161 @@
+#include "Kaleido3D.h"
+#include "ThreadPool.h"
+#include <algorithm>
+
+namespace Dispatch {
+
+ThreadPool::ThreadPool(uint32 numThreads,
+                       k3d::String const& name,
+                       ::Os::ThreadPriority priority)
+  : m_NumRunning(0)
+  , m_Stop(false)
+{
+  if (numThreads == 0) {
+    numThreads = std::max(1u, ::Os::GetCpuCoreNum());
+  }
+  m_Workers.reserve(numThreads);
+  for (uint32 i = 0; i < numThreads; i++) {
+    k3d::String threadName(name);
+    threadName.AppendSprintf(" #%d", i);
+    m_Workers.emplace_back(
+      new ::Os::Thread([this]() { WorkerLoop(); }, threadName, priority));
+    m_Workers.back()->Start();
+  }
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_Lock);
+    m_Stop = true;
+  }
+  m_TaskCV.notify_all();
+  for (auto& worker : m_Workers) {
+    worker->Join();
+  }
+  m_Workers.clear();
+}
+
+void
+ThreadPool::Submit(Task&& task)
+{
+  // notify under the lock, the pool may be destroyed as soon as it is released
+  std::lock_guard<std::mutex> lock(m_Lock);
+  m_Tasks.push_back(std::move(task));
+  m_TaskCV.notify_one();
+}
+
+void
+ThreadPool::WaitIdle()
+{
+  std::unique_lock<std::mutex> lock(m_Lock);
+  m_IdleCV.wait(lock, [this]() { return m_Tasks.empty() && m_NumRunning == 0; });
+}
+
+uint32
+ThreadPool::GetNumPending()
+{
+  std::lock_guard<std::mutex> lock(m_Lock);
+  return (uint32)m_Tasks.size() + m_NumRunning;
+}
+
+void
+ThreadPool::WorkerLoop()
+{
+  for (;;) {
+    Task task;
+    {
+      std::unique_lock<std::mutex> lock(m_Lock);
+      m_TaskCV.wait(lock, [this]() { return m_Stop || !m_Tasks.empty(); });
+      if (m_Tasks.empty()) // stopped and drained
+        return;
+      task = std::move(m_Tasks.front());
+      m_Tasks.pop_front();
+      m_NumRunning++;
+    }
+    task();
+    {
+      std::lock_guard<std::mutex> lock(m_Lock);
+      m_NumRunning--;
+      if (m_NumRunning == 0 && m_Tasks.empty())
+        m_IdleCV.notify_all();
+    }
+  }
+}
+
+struct ParallelForState
+{
+  std::atomic<uint32> NextChunk;
+  uint32 NumChunks;
+  uint32 Begin;
+  uint32 End;
+  uint32 Grain;
+  ThreadPool::RangeTask Task;
+
+  std::mutex Lock;
+  std::condition_variable DoneCV;
+  uint32 NumDone;
+
+  // returns false when no chunk is left
+  bool RunOne()
+  {
+    uint32 chunk = NextChunk.fetch_add(1, std::memory_order_relaxed);
+    if (chunk >= NumChunks)
+      return false;
+    uint32 b = Begin + chunk * Grain;
+    uint32 e = std::min(End, b + Grain);
+    Task(b, e);
+    std::lock_guard<std::mutex> lock(Lock);
+    if (++NumDone == NumChunks)
+      DoneCV.notify_all();
+    return true;
+  }
+};
+
+void
+ThreadPool::ParallelFor(uint32 begin,
+                        uint32 end,
+                        uint32 grain,
+                        RangeTask const& task)
+{
+  if (end <= begin)
+    return;
+  grain = std::max(1u, grain);
+  uint32 numChunks = (end - begin + grain - 1) / grain;
+  if (numChunks == 1 || m_Workers.empty()) {
+    for (uint32 b = begin; b < end; b += grain)
+      task(b, std::min(end, b + grain));
+    return;
+  }
+
+  auto state = std::make_shared<ParallelForState>();
+  state->NextChunk.store(0, std::memory_order_relaxed);
+  state->NumChunks = numChunks;
+  state->Begin = begin;
+  state->End = end;
+  state->Grain = grain;
+  state->Task = task;
+  state->NumDone = 0;
+
+  // helpers hold a reference, they may be scheduled after the loop is done
+  uint32 numHelpers = std::min(numChunks - 1, GetNumThreads());
+  for (uint32 i = 0; i < numHelpers; i++) {
+    Submit([state]() {
+      while (state->RunOne()) {
+      }
+    });
+  }
+  while (state->RunOne()) {
+  }
+  std::unique_lock<std::mutex> lock(state->Lock);
+  state->DoneCV.wait(lock,
+                     [&state]() { return state->NumDone == state->NumChunks; });
+}
+
+ThreadPool&
+ThreadPool::Global()
+{
+  static ThreadPool s_GlobalPool(0, "GlobalWorker");
+  return s_GlobalPool;
+}
+}
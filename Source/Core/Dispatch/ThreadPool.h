@@ -0,0 +1,58 @@
+#pragma once
+#include "../Os.h"
+#include <KTL/String.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Dispatch {
+
+/**
+ * Fixed size worker pool, tasks are executed in FIFO order.
+ * ParallelFor lets the calling thread participate, so it is safe to call it
+ * from inside a task without starving the pool.
+ */
+class K3D_API ThreadPool
+{
+public:
+  typedef std::function<void()> Task;
+  typedef std::function<void(uint32 begin, uint32 end)> RangeTask;
+
+  /// \param numThreads 0 means one worker per cpu core
+  explicit ThreadPool(uint32 numThreads = 0,
+                      k3d::String const& name = "Worker",
+                      ::Os::ThreadPriority priority = ::Os::ThreadPriority::Normal);
+  ~ThreadPool();
+
+  void Submit(Task&& task);
+  /// blocks until every submitted task has finished
+  void WaitIdle();
+
+  /// split [begin, end) into chunks of 'grain' and run them on the pool
+  void ParallelFor(uint32 begin, uint32 end, uint32 grain, RangeTask const& task);
+
+  uint32 GetNumThreads() const { return (uint32)m_Workers.size(); }
+  uint32 GetNumPending();
+
+  /// process wide pool shared by the asset pipeline
+  static ThreadPool& Global();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+private:
+  void WorkerLoop();
+
+  std::vector<std::unique_ptr<::Os::Thread> > m_Workers;
+  std::deque<Task> m_Tasks;
+  std::mutex m_Lock;
+  std::condition_variable m_TaskCV;
+  std::condition_variable m_IdleCV;
+  uint32 m_NumRunning;
+  bool m_Stop;
+};
+}
@@ -0,0 +1,422 @@
+#include "Kaleido3D.h"
+#include "FileWatcher.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#if K3DPLATFORM_OS_LINUX
+#include <dirent.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define K3D_HAS_INOTIFY 1
+#endif
+
+namespace Os {
+
+uint64
+FileWatcher::Now()
+{
+  return (uint64)std::chrono::duration_cast<std::chrono::microseconds>(
+           std::chrono::steady_clock::now().time_since_epoch())
+    .count();
+}
+
+#if K3D_HAS_INOTIFY
+struct FileWatcherPrivate
+{
+  struct WatchedDir
+  {
+    std::string Path;
+    bool Recursive;
+    /// passed to Watch(), not only found under another watch
+    bool Root;
+  };
+
+  /// changes of one path, reported once it has been quiet for Debounce
+  struct PendingChange
+  {
+    uint32 Actions;
+    uint64 FirstChange;
+    uint64 LastChange;
+  };
+
+  FileWatcherPrivate()
+    : Fd(-1)
+    , WakeFd(-1)
+    , Loop(nullptr)
+    , Quit(false)
+    , Debounce(0)
+  {
+    Fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    WakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  }
+
+  ~FileWatcherPrivate()
+  {
+    if (Fd >= 0)
+      close(Fd);
+    if (WakeFd >= 0)
+      close(WakeFd);
+  }
+
+  /// \param reportFiles files found in the directories are reported as added,
+  /// for directories which were created while being watched
+  bool AddWatch(std::string const& dir,
+                bool recursive,
+                bool reportFiles,
+                bool root = false)
+  {
+    const uint32 mask = IN_CREATE | IN_DELETE | IN_MODIFY | IN_CLOSE_WRITE |
+                        IN_ATTRIB | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR;
+    int wd = inotify_add_watch(Fd, dir.c_str(), mask);
+    if (wd < 0)
+      return false;
+    {
+      std::lock_guard<std::mutex> lock(Lock);
+      // inotify returns the same wd for a directory which is already watched
+      auto found = Watches.find(wd);
+      root = root || (found != Watches.end() && found->second.Root);
+      Watches[wd] = WatchedDir{ dir, recursive, root };
+      WatchByPath[dir] = wd;
+    }
+    if (!recursive && !reportFiles)
+      return true;
+    DIR* handle = opendir(dir.c_str());
+    if (!handle)
+      return true;
+    while (struct dirent* entry = readdir(handle)) {
+      if (!strcmp(entry->d_name, ".") || !strcmp(entry->d_name, ".."))
+        continue;
+      std::string path = dir + "/" + entry->d_name;
+      struct stat st;
+      if (stat(path.c_str(), &st) != 0)
+        continue;
+      if (S_ISDIR(st.st_mode)) {
+        if (recursive)
+          AddWatch(path, true, reportFiles);
+      } else if (reportFiles) {
+        Merge(path, FileWatcher::Added, FileWatcher::Now());
+      }
+    }
+    closedir(handle);
+    return true;
+  }
+
+  /// 'dir' and the watched directories under it
+  uint32 RemoveWatches(std::string const& dir)
+  {
+    std::lock_guard<std::mutex> lock(Lock);
+    uint32 removed = 0;
+    for (auto it = Watches.begin(); it != Watches.end();) {
+      std::string const& path = it->second.Path;
+      if (path == dir || (path.size() > dir.size() &&
+                          path.compare(0, dir.size(), dir) == 0 &&
+                          path[dir.size()] == '/')) {
+        inotify_rm_watch(Fd, it->first);
+        WatchByPath.erase(path);
+        it = Watches.erase(it);
+        removed++;
+      } else {
+        ++it;
+      }
+    }
+    return removed;
+  }
+
+  /// on the watcher thread only
+  void Merge(std::string const& path, uint32 actions, uint64 now)
+  {
+    auto inserted = Pending.emplace(path, PendingChange{ 0, now, now });
+    inserted.first->second.Actions |= actions;
+    inserted.first->second.LastChange = now;
+  }
+
+  void ReadEvents()
+  {
+    alignas(struct inotify_event) char buffer[64 * 1024];
+    for (;;) {
+      ssize_t len = read(Fd, buffer, sizeof(buffer));
+      if (len <= 0)
+        break;
+      uint64 now = FileWatcher::Now();
+      for (char* p = buffer; p < buffer + len;) {
+        auto event = (const struct inotify_event*)p;
+        p += sizeof(struct inotify_event) + event->len;
+        HandleEvent(*event, now);
+      }
+    }
+  }
+
+  void HandleEvent(struct inotify_event const& event, uint64 now)
+  {
+    if (event.mask & IN_Q_OVERFLOW) {
+      std::vector<std::string> roots;
+      {
+        std::lock_guard<std::mutex> lock(Lock);
+        for (auto& watch : Watches) {
+          if (watch.second.Root)
+            roots.push_back(watch.second.Path);
+        }
+      }
+      for (auto& root : roots)
+        Merge(root, FileWatcher::Overflow, now);
+      return;
+    }
+    WatchedDir dir;
+    {
+      std::lock_guard<std::mutex> lock(Lock);
+      auto found = Watches.find(event.wd);
+      if (found == Watches.end())
+        return;
+      if (event.mask & IN_IGNORED) {
+        WatchByPath.erase(found->second.Path);
+        Watches.erase(found);
+        return;
+      }
+      dir = found->second;
+    }
+    if (event.len == 0)
+      return;
+    std::string path = dir.Path + "/" + event.name;
+    if (event.mask & IN_ISDIR) {
+      if (dir.Recursive && (event.mask & (IN_CREATE | IN_MOVED_TO)))
+        AddWatch(path, true, true);
+      else if (event.mask & IN_MOVED_FROM)
+        RemoveWatches(path);
+      return;
+    }
+    uint32 actions = 0;
+    if (event.mask & (IN_CREATE | IN_MOVED_TO))
+      actions |= FileWatcher::Added;
+    if (event.mask & (IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB))
+      actions |= FileWatcher::Modified;
+    if (event.mask & (IN_DELETE | IN_MOVED_FROM))
+      actions |= FileWatcher::Removed;
+    if (actions)
+      Merge(path, actions, now);
+  }
+
+  /// \return milliseconds until the next pending path settles, -1 if none
+  int Deliver(uint64 now)
+  {
+    std::vector<FileWatcher::Event> events;
+    uint64 next = UINT64_MAX;
+    for (auto it = Pending.begin(); it != Pending.end();) {
+      uint64 settled = it->second.LastChange + Debounce;
+      if (settled <= now) {
+        events.push_back(FileWatcher::Event{ it->first, it->second.Actions,
+                                             it->second.FirstChange });
+        it = Pending.erase(it);
+      } else {
+        next = std::min(next, settled);
+        ++it;
+      }
+    }
+    if (!events.empty())
+      OnEvents(events);
+    return next == UINT64_MAX ? -1 : (int)((next - now + 999) / 1000);
+  }
+
+  void Run()
+  {
+    int timeout = -1;
+    while (!Quit) {
+      struct pollfd fds[2] = { { Fd, POLLIN, 0 }, { WakeFd, POLLIN, 0 } };
+      if (poll(fds, 2, timeout) < 0 && errno != EINTR)
+        break;
+      if (fds[1].revents & POLLIN) {
+        uint64 value;
+        while (read(WakeFd, &value, sizeof(value)) > 0) {
+        }
+      }
+      if (fds[0].revents & POLLIN)
+        ReadEvents();
+      timeout = Deliver(FileWatcher::Now());
+    }
+  }
+
+  int Fd;
+  int WakeFd;
+  Thread* Loop;
+  std::atomic<bool> Quit;
+  uint64 Debounce;
+  FileWatcher::Callback OnEvents;
+
+  mutable std::mutex Lock;
+  std::unordered_map<int, WatchedDir> Watches;
+  std::unordered_map<std::string, int> WatchByPath;
+  std::unordered_map<std::string, PendingChange> Pending;
+};
+
+FileWatcher::FileWatcher()
+  : d(new FileWatcherPrivate)
+{
+}
+
+FileWatcher::~FileWatcher()
+{
+  Stop();
+  delete d;
+  d = nullptr;
+}
+
+bool
+FileWatcher::Start(Callback&& callback, uint32 debounceMs)
+{
+  if (d->Loop || d->Fd < 0 || d->WakeFd < 0)
+    return false;
+  d->OnEvents = std::move(callback);
+  d->Debounce = (uint64)debounceMs * 1000;
+  d->Quit = false;
+  d->Loop = new Thread([this]() { d->Run(); }, "FileWatcher");
+  d->Loop->Start();
+  return true;
+}
+
+void
+FileWatcher::Stop()
+{
+  if (!d->Loop)
+    return;
+  d->Quit = true;
+  uint64 one = 1;
+  ssize_t woken = write(d->WakeFd, &one, sizeof(one));
+  (void)woken;
+  d->Loop->Join();
+  delete d->Loop;
+  d->Loop = nullptr;
+  d->Pending.clear();
+}
+
+bool
+FileWatcher::IsRunning() const
+{
+  return d->Loop != nullptr;
+}
+
+bool
+FileWatcher::Watch(const ::k3d::kchar* dir, bool recursive)
+{
+  if (d->Fd < 0)
+    return false;
+  std::string path(dir);
+  while (path.size() > 1 && path.back() == '/')
+    path.pop_back();
+  {
+    std::lock_guard<std::mutex> lock(d->Lock);
+    auto found = d->WatchByPath.find(path);
+    if (found != d->WatchByPath.end()) {
+      d->Watches[found->second].Root = true;
+      return true;
+    }
+  }
+  return d->AddWatch(path, recursive, false, true);
+}
+
+bool
+FileWatcher::Unwatch(const ::k3d::kchar* dir)
+{
+  std::string path(dir);
+  while (path.size() > 1 && path.back() == '/')
+    path.pop_back();
+  return d->RemoveWatches(path) > 0;
+}
+
+uint32
+FileWatcher::GetNumWatches() const
+{
+  std::lock_guard<std::mutex> lock(d->Lock);
+  return (uint32)d->Watches.size();
+}
+
+bool
+FileWatcher::Scan(const ::k3d::kchar* path, ScanCallback const& callback)
+{
+  struct stat st;
+  if (stat(path, &st) != 0)
+    return false;
+  if (!S_ISDIR(st.st_mode)) {
+    callback(kString(path), (uint64)st.st_size,
+             (uint64)st.st_mtim.tv_sec * 1000000000ull +
+               (uint64)st.st_mtim.tv_nsec);
+    return true;
+  }
+  DIR* handle = opendir(path);
+  if (!handle)
+    return false;
+  while (struct dirent* entry = readdir(handle)) {
+    if (!strcmp(entry->d_name, ".") || !strcmp(entry->d_name, ".."))
+      continue;
+    std::string child = std::string(path) + "/" + entry->d_name;
+    Scan(child.c_str(), callback);
+  }
+  closedir(handle);
+  return true;
+}
+
+#else
+
+struct FileWatcherPrivate
+{
+};
+
+FileWatcher::FileWatcher()
+  : d(new FileWatcherPrivate)
+{
+}
+
+FileWatcher::~FileWatcher()
+{
+  delete d;
+  d = nullptr;
+}
+
+bool
+FileWatcher::Start(Callback&&, uint32)
+{
+  return false;
+}
+
+void
+FileWatcher::Stop()
+{
+}
+
+bool
+FileWatcher::IsRunning() const
+{
+  return false;
+}
+
+bool
+FileWatcher::Watch(const ::k3d::kchar*, bool)
+{
+  return false;
+}
+
+bool
+FileWatcher::Unwatch(const ::k3d::kchar*)
+{
+  return false;
+}
+
+uint32
+FileWatcher::GetNumWatches() const
+{
+  return 0;
+}
+
+bool
+FileWatcher::Scan(const ::k3d::kchar*, ScanCallback const&)
+{
+  return false;
+}
+#endif
+}
@@ -0,0 +1,78 @@
+#ifndef __FileWatcher_h__
+#define __FileWatcher_h__
+
+#include "Os.h"
+#include <functional>
+#include <vector>
+
+namespace Os {
+
+struct FileWatcherPrivate;
+
+/**
+ * Watches directories for changed files.
+ * On Linux the changes come from inotify, a directory created under a
+ * recursive watch is watched as soon as it shows up and the files already in
+ * it are reported as added. Changes of one path are merged until the path has
+ * been quiet for the debounce time, so an editor saving through several
+ * writes produces one event. Events are delivered on the watcher thread.
+ * Watch() fails on platforms without a backend.
+ */
+class K3D_API FileWatcher
+{
+public:
+  enum Action : uint32
+  {
+    Added = 1,
+    Modified = 2,
+    Removed = 4,
+    /// the kernel dropped events, anything under Path, a directory passed to
+    /// Watch(), may have changed
+    Overflow = 8,
+  };
+
+  struct Event
+  {
+    kString Path;
+    /// Action bits of every change merged into the event, a file replaced
+    /// within the debounce time has several, check whether it exists
+    uint32 Actions;
+    /// Now() of the first merged change
+    uint64 FirstChange;
+  };
+
+  typedef std::function<void(std::vector<Event> const&)> Callback;
+  /// path, size and modification time of a file
+  typedef std::function<void(kString const&, uint64, uint64)> ScanCallback;
+
+  FileWatcher();
+  ~FileWatcher();
+
+  /// starts the watcher thread
+  /// \param debounceMs quiet time before the changes of a path are reported
+  bool Start(Callback&& callback, uint32 debounceMs = 50);
+  /// pending changes are dropped
+  void Stop();
+  bool IsRunning() const;
+
+  /// can be called before and after Start()
+  bool Watch(const ::k3d::kchar* dir, bool recursive = true);
+  /// removes the watch of 'dir' and of its watched sub directories
+  bool Unwatch(const ::k3d::kchar* dir);
+  uint32 GetNumWatches() const;
+
+  /// steady clock in microseconds
+  static uint64 Now();
+  /// reports 'path' if it is a file, else the files under it, to find what
+  /// changed while events were lost
+  static bool Scan(const ::k3d::kchar* path, ScanCallback const& callback);
+
+  FileWatcher(const FileWatcher&) = delete;
+  FileWatcher& operator=(const FileWatcher&) = delete;
+
+private:
+  FileWatcherPrivate* d;
+};
+}
+
+#endif
@@ -1,21 +1,412 @@
 #include "Kaleido3D.h"
 #include "ImageData.h"
+#include "Os.h"
 
 //---------------------------------------------------------------
-// DDS image loader implement ??
-namespace k3d 
+// DDS and KTX2 image loader, the levels are views into the file
+namespace k3d
 {
+	namespace
+	{
+		const uint32 kDDSMagic = 0x20534444; // "DDS "
+		const kByte kKTX2Identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+		const uint32 DDSD_DEPTH = 0x800000;
+		const uint32 DDPF_ALPHAPIXELS = 0x1;
+		const uint32 DDPF_FOURCC = 0x4;
+		const uint32 DDPF_RGB = 0x40;
+		const uint32 DDPF_LUMINANCE = 0x20000;
+		const uint32 DDSCAPS2_CUBEMAP = 0x200;
+		const uint32 DDSCAPS2_CUBEMAP_ALLFACES = 0xFC00;
+		const uint32 DDSCAPS2_VOLUME = 0x200000;
+		const uint32 DDS_DIMENSION_TEXTURE1D = 2;
+		const uint32 DDS_DIMENSION_TEXTURE2D = 3;
+		const uint32 DDS_DIMENSION_TEXTURE3D = 4;
+		const uint32 DDS_RESOURCE_MISC_TEXTURECUBE = 0x4;
+
+		struct DDSPixelFormat
+		{
+			uint32	Size;
+			uint32	Flags;
+			uint32	FourCC;
+			uint32	RGBBitCount;
+			uint32	RBitMask;
+			uint32	GBitMask;
+			uint32	BBitMask;
+			uint32	ABitMask;
+		};
+
+		struct DDSHeader
+		{
+			uint32			Size;
+			uint32			Flags;
+			uint32			Height;
+			uint32			Width;
+			uint32			PitchOrLinearSize;
+			uint32			Depth;
+			uint32			MipMapCount;
+			uint32			Reserved1[11];
+			DDSPixelFormat	PixelFormat;
+			uint32			Caps;
+			uint32			Caps2;
+			uint32			Caps3;
+			uint32			Caps4;
+			uint32			Reserved2;
+		};
+
+		struct DDSHeaderDX10
+		{
+			uint32	DXGIFormat;
+			uint32	ResourceDimension;
+			uint32	MiscFlag;
+			uint32	ArraySize;
+			uint32	MiscFlags2;
+		};
+
+		struct KTX2Header
+		{
+			kByte	Identifier[12];
+			uint32	VkFormat;
+			uint32	TypeSize;
+			uint32	PixelWidth;
+			uint32	PixelHeight;
+			uint32	PixelDepth;
+			uint32	LayerCount;
+			uint32	FaceCount;
+			uint32	LevelCount;
+			uint32	SupercompressionScheme;
+			uint32	DfdByteOffset;
+			uint32	DfdByteLength;
+			uint32	KvdByteOffset;
+			uint32	KvdByteLength;
+			uint64	SgdByteOffset;
+			uint64	SgdByteLength;
+		};
+
+		struct KTX2Level
+		{
+			uint64	ByteOffset;
+			uint64	ByteLength;
+			uint64	UncompressedByteLength;
+		};
+
+		static_assert(sizeof(DDSHeader) == 124, "DDS header layout");
+		static_assert(sizeof(DDSHeaderDX10) == 20, "DDS DX10 header layout");
+		static_assert(sizeof(KTX2Header) == 80, "KTX2 header layout");
+		static_assert(sizeof(KTX2Level) == 24, "KTX2 level index layout");
+
+		struct FormatCode
+		{
+			uint32			Code;
+			EImageFormat	Format;
+		};
+
+		const FormatCode kDXGIFormats[] =
+		{
+			{ 2,	EImageFormat::RGBA32_FLOAT },
+			{ 10,	EImageFormat::RGBA16_FLOAT },
+			{ 11,	EImageFormat::RGBA16_UNORM },
+			{ 16,	EImageFormat::RG32_FLOAT },
+			{ 24,	EImageFormat::RGB10A2_UNORM },
+			{ 26,	EImageFormat::RG11B10_FLOAT },
+			{ 28,	EImageFormat::RGBA8_UNORM },
+			{ 29,	EImageFormat::RGBA8_SRGB },
+			{ 34,	EImageFormat::RG16_FLOAT },
+			{ 41,	EImageFormat::R32_FLOAT },
+			{ 49,	EImageFormat::RG8_UNORM },
+			{ 54,	EImageFormat::R16_FLOAT },
+			{ 56,	EImageFormat::R16_UNORM },
+			{ 61,	EImageFormat::R8_UNORM },
+			{ 71,	EImageFormat::BC1_UNORM },
+			{ 72,	EImageFormat::BC1_SRGB },
+			{ 74,	EImageFormat::BC2_UNORM },
+			{ 75,	EImageFormat::BC2_SRGB },
+			{ 77,	EImageFormat::BC3_UNORM },
+			{ 78,	EImageFormat::BC3_SRGB },
+			{ 80,	EImageFormat::BC4_UNORM },
+			{ 81,	EImageFormat::BC4_SNORM },
+			{ 83,	EImageFormat::BC5_UNORM },
+			{ 84,	EImageFormat::BC5_SNORM },
+			{ 87,	EImageFormat::BGRA8_UNORM },
+			// B8G8R8X8, the alpha is undefined
+			{ 88,	EImageFormat::BGRA8_UNORM },
+			{ 91,	EImageFormat::BGRA8_SRGB },
+			{ 93,	EImageFormat::BGRA8_SRGB },
+			{ 95,	EImageFormat::BC6H_UFLOAT },
+			{ 96,	EImageFormat::BC6H_SFLOAT },
+			{ 98,	EImageFormat::BC7_UNORM },
+			{ 99,	EImageFormat::BC7_SRGB },
+		};
+
+		const FormatCode kVkFormats[] =
+		{
+			{ 9,	EImageFormat::R8_UNORM },
+			{ 16,	EImageFormat::RG8_UNORM },
+			{ 37,	EImageFormat::RGBA8_UNORM },
+			{ 43,	EImageFormat::RGBA8_SRGB },
+			{ 44,	EImageFormat::BGRA8_UNORM },
+			{ 50,	EImageFormat::BGRA8_SRGB },
+			// A2B10G10R10_UNORM_PACK32, red in the low bits
+			{ 64,	EImageFormat::RGB10A2_UNORM },
+			{ 70,	EImageFormat::R16_UNORM },
+			{ 76,	EImageFormat::R16_FLOAT },
+			{ 83,	EImageFormat::RG16_FLOAT },
+			{ 91,	EImageFormat::RGBA16_UNORM },
+			{ 97,	EImageFormat::RGBA16_FLOAT },
+			{ 100,	EImageFormat::R32_FLOAT },
+			{ 103,	EImageFormat::RG32_FLOAT },
+			{ 109,	EImageFormat::RGBA32_FLOAT },
+			// B10G11R11_UFLOAT_PACK32
+			{ 122,	EImageFormat::RG11B10_FLOAT },
+			// BC1 RGBA and RGB share the block layout, RGBA is written
+			{ 133,	EImageFormat::BC1_UNORM },
+			{ 134,	EImageFormat::BC1_SRGB },
+			{ 131,	EImageFormat::BC1_UNORM },
+			{ 132,	EImageFormat::BC1_SRGB },
+			{ 135,	EImageFormat::BC2_UNORM },
+			{ 136,	EImageFormat::BC2_SRGB },
+			{ 137,	EImageFormat::BC3_UNORM },
+			{ 138,	EImageFormat::BC3_SRGB },
+			{ 139,	EImageFormat::BC4_UNORM },
+			{ 140,	EImageFormat::BC4_SNORM },
+			{ 141,	EImageFormat::BC5_UNORM },
+			{ 142,	EImageFormat::BC5_SNORM },
+			{ 143,	EImageFormat::BC6H_UFLOAT },
+			{ 144,	EImageFormat::BC6H_SFLOAT },
+			{ 145,	EImageFormat::BC7_UNORM },
+			{ 146,	EImageFormat::BC7_SRGB },
+		};
+
+		template <size_t N>
+		EImageFormat FindFormat(const FormatCode (&table)[N], uint32 code)
+		{
+			for (auto const& entry : table)
+			{
+				if (entry.Code == code)
+					return entry.Format;
+			}
+			return EImageFormat::UNKNOWN;
+		}
+
+		/// the first code of 'format', 0 if there is none
+		template <size_t N>
+		uint32 FindCode(const FormatCode (&table)[N], EImageFormat format)
+		{
+			for (auto const& entry : table)
+			{
+				if (entry.Format == format)
+					return entry.Code;
+			}
+			return 0;
+		}
+
+		constexpr uint32 FourCC(char a, char b, char c, char d)
+		{
+			return (uint32)(uint8)a | ((uint32)(uint8)b << 8) | ((uint32)(uint8)c << 16) | ((uint32)(uint8)d << 24);
+		}
+
+		bool HasMasks(DDSPixelFormat const& pf, uint32 r, uint32 g, uint32 b, uint32 a)
+		{
+			return pf.RBitMask == r && pf.GBitMask == g && pf.BBitMask == b && pf.ABitMask == a;
+		}
+
+		/// format of a DDS file without DX10 header, see GetDXGIFormat of DDSTextureLoader
+		EImageFormat GetLegacyFormat(DDSPixelFormat const& pf)
+		{
+			if (pf.Flags & DDPF_FOURCC)
+			{
+				switch (pf.FourCC)
+				{
+				case FourCC('D', 'X', 'T', '1'): return EImageFormat::BC1_UNORM;
+				// premultiplied alpha is not tracked
+				case FourCC('D', 'X', 'T', '2'):
+				case FourCC('D', 'X', 'T', '3'): return EImageFormat::BC2_UNORM;
+				case FourCC('D', 'X', 'T', '4'):
+				case FourCC('D', 'X', 'T', '5'): return EImageFormat::BC3_UNORM;
+				case FourCC('A', 'T', 'I', '1'):
+				case FourCC('B', 'C', '4', 'U'): return EImageFormat::BC4_UNORM;
+				case FourCC('B', 'C', '4', 'S'): return EImageFormat::BC4_SNORM;
+				case FourCC('A', 'T', 'I', '2'):
+				case FourCC('B', 'C', '5', 'U'): return EImageFormat::BC5_UNORM;
+				case FourCC('B', 'C', '5', 'S'): return EImageFormat::BC5_SNORM;
+				// D3DFORMAT codes
+				case 36: return EImageFormat::RGBA16_UNORM;
+				case 111: return EImageFormat::R16_FLOAT;
+				case 112: return EImageFormat::RG16_FLOAT;
+				case 113: return EImageFormat::RGBA16_FLOAT;
+				case 114: return EImageFormat::R32_FLOAT;
+				case 115: return EImageFormat::RG32_FLOAT;
+				case 116: return EImageFormat::RGBA32_FLOAT;
+				default: return EImageFormat::UNKNOWN;
+				}
+			}
+			if (pf.Flags & DDPF_RGB)
+			{
+				uint32 alpha = (pf.Flags & DDPF_ALPHAPIXELS) ? pf.ABitMask : 0;
+				switch (pf.RGBBitCount)
+				{
+				case 32:
+					if (HasMasks(pf, 0xff, 0xff00, 0xff0000, alpha) && (alpha == 0 || alpha == 0xff000000))
+						return EImageFormat::RGBA8_UNORM;
+					if (HasMasks(pf, 0xff0000, 0xff00, 0xff, alpha) && (alpha == 0 || alpha == 0xff000000))
+						return EImageFormat::BGRA8_UNORM;
+					if (HasMasks(pf, 0x3ff, 0xffc00, 0x3ff00000, alpha) && (alpha == 0 || alpha == 0xc0000000))
+						return EImageFormat::RGB10A2_UNORM;
+					break;
+				case 16:
+					if (HasMasks(pf, 0xffff, 0, 0, alpha) && alpha == 0)
+						return EImageFormat::R16_UNORM;
+					break;
+				}
+				return EImageFormat::UNKNOWN;
+			}
+			if (pf.Flags & DDPF_LUMINANCE)
+			{
+				if (pf.RGBBitCount == 8 && pf.RBitMask == 0xff)
+					return EImageFormat::R8_UNORM;
+				if (pf.RGBBitCount == 16 && pf.RBitMask == 0xffff)
+					return EImageFormat::R16_UNORM;
+				if (pf.RGBBitCount == 16 && pf.RBitMask == 0xff && (pf.Flags & DDPF_ALPHAPIXELS) && pf.ABitMask == 0xff00)
+					return EImageFormat::RG8_UNORM;
+			}
+			return EImageFormat::UNKNOWN;
+		}
+
+		const uint32 DDSD_CAPS = 0x1;
+		const uint32 DDSD_HEIGHT = 0x2;
+		const uint32 DDSD_WIDTH = 0x4;
+		const uint32 DDSD_PITCH = 0x8;
+		const uint32 DDSD_PIXELFORMAT = 0x1000;
+		const uint32 DDSD_MIPMAPCOUNT = 0x20000;
+		const uint32 DDSD_LINEARSIZE = 0x80000;
+		const uint32 DDSCAPS_COMPLEX = 0x8;
+		const uint32 DDSCAPS_TEXTURE = 0x1000;
+		const uint32 DDSCAPS_MIPMAP = 0x400000;
+
+		const uint32 KHR_DF_MODEL_RGBSDA = 1;
+		const uint32 KHR_DF_MODEL_BC1A = 128;
+		const uint32 KHR_DF_CHANNEL_ALPHA = 15;
+		const uint32 KHR_DF_SAMPLE_LINEAR = 0x10;
+
+		void Append(std::vector<kByte> & file, const void * data, size_t size)
+		{
+			file.insert(file.end(), (const kByte*)data, (const kByte*)data + size);
+		}
+
+		struct DFDSample
+		{
+			uint32	Channel;
+			uint32	Offset;
+			uint32	Bits;
+		};
+
+		struct DFDFormat
+		{
+			EImageFormat	Format;
+			bool			SRGB;
+			uint32			NumSamples;
+			DFDSample		Samples[4];
+		};
+
+		const DFDFormat kDFDFormats[] =
+		{
+			{ EImageFormat::R8_UNORM,		false,	1, { { 0, 0, 8 } } },
+			{ EImageFormat::RG8_UNORM,		false,	2, { { 0, 0, 8 }, { 1, 8, 8 } } },
+			{ EImageFormat::RGBA8_UNORM,	false,	4, { { 0, 0, 8 }, { 1, 8, 8 }, { 2, 16, 8 }, { KHR_DF_CHANNEL_ALPHA, 24, 8 } } },
+			{ EImageFormat::RGBA8_SRGB,		true,	4, { { 0, 0, 8 }, { 1, 8, 8 }, { 2, 16, 8 }, { KHR_DF_CHANNEL_ALPHA, 24, 8 } } },
+			{ EImageFormat::BGRA8_UNORM,	false,	4, { { 2, 0, 8 }, { 1, 8, 8 }, { 0, 16, 8 }, { KHR_DF_CHANNEL_ALPHA, 24, 8 } } },
+			{ EImageFormat::BGRA8_SRGB,		true,	4, { { 2, 0, 8 }, { 1, 8, 8 }, { 0, 16, 8 }, { KHR_DF_CHANNEL_ALPHA, 24, 8 } } },
+			// channel 1 of BC1A: the block may hold punch-through alpha
+			{ EImageFormat::BC1_UNORM,		false,	1, { { 1, 0, 64 } } },
+			{ EImageFormat::BC1_SRGB,		true,	1, { { 1, 0, 64 } } },
+			{ EImageFormat::BC3_UNORM,		false,	2, { { KHR_DF_CHANNEL_ALPHA, 0, 64 }, { 0, 64, 64 } } },
+			{ EImageFormat::BC3_SRGB,		true,	2, { { KHR_DF_CHANNEL_ALPHA, 0, 64 }, { 0, 64, 64 } } },
+			{ EImageFormat::BC4_UNORM,		false,	1, { { 0, 0, 64 } } },
+			{ EImageFormat::BC5_UNORM,		false,	2, { { 0, 0, 64 }, { 1, 64, 64 } } },
+			{ EImageFormat::BC7_UNORM,		false,	1, { { 0, 0, 128 } } },
+			{ EImageFormat::BC7_SRGB,		true,	1, { { 0, 0, 128 } } },
+		};
+
+		/// basic data format descriptor of the formats of kDFDFormats, empty for the others
+		std::vector<uint32> MakeDFD(EImageFormat format)
+		{
+			const DFDFormat * desc = nullptr;
+			for (auto const& entry : kDFDFormats)
+			{
+				if (entry.Format == format)
+					desc = &entry;
+			}
+			if (!desc)
+				return std::vector<uint32>();
+			bool compressed = ImageData::IsCompressedFormat(format);
+			// the models of BC1A to BC7 follow each other, the formats come in pairs
+			uint32 model = compressed ? KHR_DF_MODEL_BC1A + ((uint32)format - (uint32)EImageFormat::BC1_UNORM) / 2 : KHR_DF_MODEL_RGBSDA;
+			uint32 blockSize = 24 + 16 * desc->NumSamples;
+			std::vector<uint32> dfd = {
+				4 + blockSize,
+				// vendor 0 (Khronos), descriptor type 0 (basic), version 2
+				0, 2 | (blockSize << 16),
+				// BT.709 primaries, linear or sRGB transfer, straight alpha
+				model | (1 << 8) | ((desc->SRGB ? 2u : 1u) << 16),
+				compressed ? 0x00000303u : 0u,
+				ImageData::GetFormatElementSize(format), 0
+			};
+			for (uint32 s = 0; s < desc->NumSamples; s++)
+			{
+				DFDSample const& sample = desc->Samples[s];
+				// alpha is linear in sRGB formats
+				uint32 qualifiers = desc->SRGB && sample.Channel == KHR_DF_CHANNEL_ALPHA ? KHR_DF_SAMPLE_LINEAR : 0;
+				dfd.push_back(sample.Offset | ((sample.Bits - 1) << 16) | ((sample.Channel | qualifiers) << 24));
+				dfd.push_back(0);
+				dfd.push_back(0);
+				dfd.push_back(compressed ? 0xFFFFFFFFu : (1u << sample.Bits) - 1);
+			}
+			return dfd;
+		}
+
+		uint32 MaxMipLevels(uint32 width, uint32 height, uint32 depth)
+		{
+			uint32 size = std::max(std::max(width, height), depth), levels = 1;
+			while (size > 1)
+			{
+				size >>= 1;
+				levels++;
+			}
+			return levels;
+		}
+	}
+
 	ImageData::ImageData()
 		: m_ImgWidth(0)
 		, m_ImgHeight(0)
+		, m_ImgDepth(0)
 		, m_ImgLayers(0)
 		, m_MipLev(0)
+		, m_ImgType(UNKNOWN)
+		, m_InternalFmt(0)
+		, m_FillFmt(0)
+		, m_DataType(0)
+		, m_ElementSize(0)
+		, m_IsCubeMap(false)
+		, m_IsCompressed(false)
 	{
 	}
 
 	ImageData::~ImageData()
 	{
-		if (!m_ImgData.empty()) m_ImgData.clear();
+		Release();
+	}
+
+	void ImageData::Release()
+	{
+		m_Levels.clear();
+		m_Storage.reset();
+		m_Pixels.clear();
+		m_ImgWidth = m_ImgHeight = m_ImgDepth = m_ImgLayers = 0;
+		m_MipLev = 0;
+		m_ImgType = UNKNOWN;
+		m_InternalFmt = m_FillFmt = m_ElementSize = 0;
+		m_IsCubeMap = m_IsCompressed = false;
 	}
 
 	uint32 ImageData::GetImageSize(uint32 level) const
@@ -36,22 +427,401 @@ namespace k3d
 
 	const void *ImageData::GetLevel(uint32 level, uint32 face) const
 	{
-		assert(level < (uint32)m_MipLev);
-		//  assert( face >= GL_TEXTURE_CUBE_MAP_POSITIVE_X && face <= GL_TEXTURE_CUBE_MAP_NEGATIVE_Z);
-		//  assert( face == GL_TEXTURE_CUBE_MAP_POSITIVE_X || _cubeMap);
-		//  face = face - GL_TEXTURE_CUBE_MAP_POSITIVE_X;
-		assert((face*m_MipLev + level) < (int32)m_ImgData.size());
-		if (level >= (uint32)m_MipLev || (int32)face >= m_ImgLayers)
+		const ImageLevel * desc = GetLevelDesc(level, face);
+		return desc ? desc->Data : nullptr;
+	}
+
+	const ImageLevel * ImageData::GetLevelDesc(uint32 level, uint32 layer) const
+	{
+		if (level >= (uint32)m_MipLev || layer >= m_ImgLayers)
 			return nullptr;
+		return &m_Levels[layer * m_MipLev + level];
+	}
+
+	uint32 ImageData::GetFormatElementSize(EImageFormat format)
+	{
+		switch (format)
+		{
+		case EImageFormat::R8_UNORM:
+			return 1;
+		case EImageFormat::RG8_UNORM:
+		case EImageFormat::R16_UNORM:
+		case EImageFormat::R16_FLOAT:
+			return 2;
+		case EImageFormat::RGBA8_UNORM:
+		case EImageFormat::RGBA8_SRGB:
+		case EImageFormat::BGRA8_UNORM:
+		case EImageFormat::BGRA8_SRGB:
+		case EImageFormat::RGB10A2_UNORM:
+		case EImageFormat::RG11B10_FLOAT:
+		case EImageFormat::RG16_FLOAT:
+		case EImageFormat::R32_FLOAT:
+			return 4;
+		case EImageFormat::RGBA16_UNORM:
+		case EImageFormat::RGBA16_FLOAT:
+		case EImageFormat::RG32_FLOAT:
+			return 8;
+		case EImageFormat::RGBA32_FLOAT:
+			return 16;
+		case EImageFormat::BC1_UNORM:
+		case EImageFormat::BC1_SRGB:
+		case EImageFormat::BC4_UNORM:
+		case EImageFormat::BC4_SNORM:
+			return 8;
+		case EImageFormat::BC2_UNORM:
+		case EImageFormat::BC2_SRGB:
+		case EImageFormat::BC3_UNORM:
+		case EImageFormat::BC3_SRGB:
+		case EImageFormat::BC5_UNORM:
+		case EImageFormat::BC5_SNORM:
+		case EImageFormat::BC6H_UFLOAT:
+		case EImageFormat::BC6H_SFLOAT:
+		case EImageFormat::BC7_UNORM:
+		case EImageFormat::BC7_SRGB:
+			return 16;
+		default:
+			return 0;
+		}
+	}
+
+	bool ImageData::IsCompressedFormat(EImageFormat format)
+	{
+		return format >= EImageFormat::BC1_UNORM && format <= EImageFormat::BC7_SRGB;
+	}
 
-		return m_ImgData[face*m_MipLev + level];
+	bool ImageData::InitLevels(EImageFormat format, uint32 width, uint32 height, uint32 depth, uint32 mipLevels, uint32 layers)
+	{
+		uint32 elementSize = GetFormatElementSize(format);
+		if (!elementSize || !width || !height || !depth || !layers
+			|| !mipLevels || mipLevels > MaxMipLevels(width, height, depth))
+			return false;
+		bool compressed = IsCompressedFormat(format);
+		m_ImgWidth = width;
+		m_ImgHeight = height;
+		m_ImgDepth = depth;
+		m_ImgLayers = layers;
+		m_MipLev = (int32)mipLevels;
+		m_InternalFmt = (uint32)format;
+		m_ElementSize = elementSize;
+		m_IsCompressed = compressed;
+		m_Levels.resize((size_t)mipLevels * layers);
+		for (uint32 level = 0; level < mipLevels; level++)
+		{
+			ImageLevel desc;
+			desc.Data = nullptr;
+			desc.Width = std::max(width >> level, 1u);
+			desc.Height = std::max(height >> level, 1u);
+			desc.Depth = std::max(depth >> level, 1u);
+			uint32 columns = compressed ? (desc.Width + 3) / 4 : desc.Width;
+			desc.Rows = compressed ? (desc.Height + 3) / 4 : desc.Height;
+			desc.RowPitch = columns * elementSize;
+			desc.Size = (uint64)columns * elementSize * desc.Rows * desc.Depth;
+			for (uint32 layer = 0; layer < layers; layer++)
+				m_Levels[layer * mipLevels + level] = desc;
+		}
+		return true;
+	}
+
+	bool ImageData::LoadDDS(const kByte * data, uint64 size)
+	{
+		DDSHeader header;
+		uint64 pos = sizeof(uint32) + sizeof(header);
+		if (size < pos)
+			return false;
+		memcpy(&header, data + sizeof(uint32), sizeof(header));
+		if (header.Size != sizeof(DDSHeader) || header.PixelFormat.Size != sizeof(DDSPixelFormat))
+			return false;
+
+		uint32 width = header.Width, height = header.Height, depth = 1, layers = 1;
+		uint32 mipLevels = header.MipMapCount ? header.MipMapCount : 1;
+		EImageFormat format = EImageFormat::UNKNOWN;
+		Type type = TEXTURE_2D;
+		if ((header.PixelFormat.Flags & DDPF_FOURCC) && header.PixelFormat.FourCC == FourCC('D', 'X', '1', '0'))
+		{
+			DDSHeaderDX10 dx10;
+			if (size < pos + sizeof(dx10))
+				return false;
+			memcpy(&dx10, data + pos, sizeof(dx10));
+			pos += sizeof(dx10);
+			format = FindFormat(kDXGIFormats, dx10.DXGIFormat);
+			m_FillFmt = dx10.DXGIFormat;
+			layers = dx10.ArraySize;
+			switch (dx10.ResourceDimension)
+			{
+			case DDS_DIMENSION_TEXTURE1D:
+				height = 1;
+				break;
+			case DDS_DIMENSION_TEXTURE2D:
+				if (dx10.MiscFlag & DDS_RESOURCE_MISC_TEXTURECUBE)
+				{
+					type = TEXTURE_CUBE;
+					layers *= 6;
+				}
+				break;
+			case DDS_DIMENSION_TEXTURE3D:
+				if (!(header.Flags & DDSD_DEPTH) || layers != 1)
+					return false;
+				type = TEXTURE_3D;
+				depth = header.Depth;
+				break;
+			default:
+				return false;
+			}
+		}
+		else
+		{
+			format = GetLegacyFormat(header.PixelFormat);
+			m_FillFmt = (header.PixelFormat.Flags & DDPF_FOURCC) ? header.PixelFormat.FourCC : 0;
+			if ((header.Flags & DDSD_DEPTH) && (header.Caps2 & DDSCAPS2_VOLUME))
+			{
+				type = TEXTURE_3D;
+				depth = header.Depth;
+			}
+			else if (header.Caps2 & DDSCAPS2_CUBEMAP)
+			{
+				// partial cube maps are not supported by the APIs either
+				if ((header.Caps2 & DDSCAPS2_CUBEMAP_ALLFACES) != DDSCAPS2_CUBEMAP_ALLFACES)
+					return false;
+				type = TEXTURE_CUBE;
+				layers = 6;
+			}
+		}
+		if ((type == TEXTURE_CUBE && width != height)
+			|| !InitLevels(format, width, height, depth, mipLevels, layers))
+			return false;
+
+		// every layer holds its whole mip chain
+		for (auto & level : m_Levels)
+		{
+			if (level.Size > size - pos)
+				return false;
+			level.Data = data + pos;
+			pos += level.Size;
+		}
+		m_ImgType = type;
+		m_IsCubeMap = type == TEXTURE_CUBE;
+		return true;
+	}
+
+	bool ImageData::LoadKTX2(const kByte * data, uint64 size)
+	{
+		KTX2Header header;
+		if (size < sizeof(header))
+			return false;
+		memcpy(&header, data, sizeof(header));
+		// zstd or basis payloads have to be inflated before they can be uploaded
+		if (header.SupercompressionScheme != 0)
+			return false;
+
+		uint32 faces = header.FaceCount, layers = header.LayerCount ? header.LayerCount : 1;
+		uint32 height = header.PixelHeight ? header.PixelHeight : 1;
+		uint32 depth = header.PixelDepth ? header.PixelDepth : 1;
+		uint32 mipLevels = header.LevelCount ? header.LevelCount : 1;
+		Type type = header.PixelDepth ? TEXTURE_3D : faces == 6 ? TEXTURE_CUBE : TEXTURE_2D;
+		if ((faces != 1 && faces != 6) || (faces == 6 && (header.PixelWidth != height || header.PixelDepth))
+			|| (header.PixelDepth && layers != 1))
+			return false;
+		m_FillFmt = header.VkFormat;
+		if (!InitLevels(FindFormat(kVkFormats, header.VkFormat), header.PixelWidth, height, depth, mipLevels, layers * faces))
+			return false;
+
+		uint64 indexEnd = sizeof(header) + (uint64)mipLevels * sizeof(KTX2Level);
+		if (size < indexEnd)
+			return false;
+		for (uint32 level = 0; level < mipLevels; level++)
+		{
+			KTX2Level entry;
+			memcpy(&entry, data + sizeof(header) + level * sizeof(KTX2Level), sizeof(entry));
+			// a level holds the faces of every layer, each with all its depth slices
+			uint64 layerSize = m_Levels[level].Size;
+			if (entry.ByteOffset > size || entry.ByteLength > size - entry.ByteOffset
+				|| entry.ByteLength < layerSize * m_ImgLayers)
+				return false;
+			for (uint32 layer = 0; layer < m_ImgLayers; layer++)
+				m_Levels[layer * mipLevels + level].Data = data + entry.ByteOffset + layer * layerSize;
+		}
+		m_ImgType = type;
+		m_IsCubeMap = type == TEXTURE_CUBE;
+		return true;
+	}
+
+	bool ImageData::Create(EImageFormat format, uint32 width, uint32 height, uint32 mipLevels, uint32 layers, bool cubeMap)
+	{
+		Release();
+		if ((cubeMap && (width != height || layers % 6 != 0)) || !InitLevels(format, width, height, 1, mipLevels, layers))
+		{
+			Release();
+			return false;
+		}
+		uint64 size = 0;
+		for (auto const& level : m_Levels)
+			size += level.Size;
+		m_Pixels.assign((size_t)size, 0);
+		size = 0;
+		for (auto & level : m_Levels)
+		{
+			level.Data = m_Pixels.data() + size;
+			size += level.Size;
+		}
+		m_ImgType = cubeMap ? TEXTURE_CUBE : TEXTURE_2D;
+		m_IsCubeMap = cubeMap;
+		return true;
+	}
+
+	kByte * ImageData::GetLevelData(uint32 level, uint32 layer)
+	{
+		const ImageLevel * desc = GetLevelDesc(level, layer);
+		if (!desc || m_Pixels.empty())
+			return nullptr;
+		return m_Pixels.data() + (desc->Data - m_Pixels.data());
 	}
 
 	bool ImageData::Load(uint8 *dataPtr, uint32 length)
 	{
-		K3D_UNUSED(dataPtr);
-		K3D_UNUSED(length);
-		return false;
+		return LoadView(dataPtr, length, nullptr);
+	}
+
+	bool ImageData::LoadView(const kByte * data, uint64 size, std::shared_ptr<const void> const& storage)
+	{
+		Release();
+		uint32 magic = 0;
+		if (data && size >= sizeof(magic))
+			memcpy(&magic, data, sizeof(magic));
+		bool ok = false;
+		if (magic == kDDSMagic)
+			ok = LoadDDS(data, size);
+		else if (data && size >= sizeof(kKTX2Identifier) && memcmp(data, kKTX2Identifier, sizeof(kKTX2Identifier)) == 0)
+			ok = LoadKTX2(data, size);
+		if (!ok)
+		{
+			Release();
+			return false;
+		}
+		m_Storage = storage;
+		return true;
+	}
+
+	std::shared_ptr<ImageData> ImageData::CreateFromFile(const kchar * path)
+	{
+		auto file = std::make_shared<Os::MemMapFile>();
+		if (!file->Open(path, IORead))
+			return nullptr;
+		auto image = std::make_shared<ImageData>();
+		if (!image->LoadView(file->FileData(), (uint64)file->GetSize(), file))
+			return nullptr;
+		kString name(path);
+		image->SetName(string(name.begin(), name.end()));
+		return image;
+	}
+
+	std::shared_ptr<ImageData> ImageData::CreateFromChunk(AssetChunkView const& chunk,
+		std::shared_ptr<Os::MemMapFile> const& file, Dispatch::ThreadPool * workers)
+	{
+		if (chunk.Type != EAssetType::EImage)
+			return nullptr;
+		auto image = std::make_shared<ImageData>();
+		if (chunk.Compression == EChunkCompression::ENone)
+		{
+			if (!image->LoadView(chunk.Data, chunk.Size, file))
+				return nullptr;
+		}
+		else
+		{
+			auto decoded = std::make_shared<std::vector<kByte>>((size_t)chunk.RawSize);
+			if (!AssetBundleReader::Decode(chunk, decoded->data(), workers)
+				|| !image->LoadView(decoded->data(), decoded->size(), decoded))
+				return nullptr;
+		}
+		image->SetName(string(chunk.Name, chunk.NameLength));
+		return image;
+	}
+
+	bool ImageData::WriteDDS(std::vector<kByte> & file) const
+	{
+		uint32 dxgiFormat = FindCode(kDXGIFormats, GetFormat());
+		if (!dxgiFormat || m_Levels.empty())
+			return false;
+		DDSHeader header;
+		memset(&header, 0, sizeof(header));
+		header.Size = sizeof(header);
+		header.Flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT
+			| (m_IsCompressed ? DDSD_LINEARSIZE : DDSD_PITCH) | (m_ImgType == TEXTURE_3D ? DDSD_DEPTH : 0);
+		header.Height = m_ImgHeight;
+		header.Width = m_ImgWidth;
+		header.PitchOrLinearSize = m_IsCompressed ? (uint32)m_Levels[0].Size : m_Levels[0].RowPitch;
+		header.Depth = m_ImgType == TEXTURE_3D ? m_ImgDepth : 0;
+		header.MipMapCount = m_MipLev;
+		header.PixelFormat.Size = sizeof(DDSPixelFormat);
+		header.PixelFormat.Flags = DDPF_FOURCC;
+		header.PixelFormat.FourCC = FourCC('D', 'X', '1', '0');
+		header.Caps = DDSCAPS_TEXTURE | (m_MipLev > 1 ? DDSCAPS_COMPLEX | DDSCAPS_MIPMAP : 0)
+			| (m_IsCubeMap ? DDSCAPS_COMPLEX : 0);
+		header.Caps2 = m_IsCubeMap ? DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_ALLFACES
+			: m_ImgType == TEXTURE_3D ? DDSCAPS2_VOLUME : 0;
+		DDSHeaderDX10 dx10;
+		dx10.DXGIFormat = dxgiFormat;
+		dx10.ResourceDimension = m_ImgType == TEXTURE_3D ? DDS_DIMENSION_TEXTURE3D : DDS_DIMENSION_TEXTURE2D;
+		dx10.MiscFlag = m_IsCubeMap ? DDS_RESOURCE_MISC_TEXTURECUBE : 0;
+		dx10.ArraySize = m_IsCubeMap ? m_ImgLayers / 6 : m_ImgLayers;
+		dx10.MiscFlags2 = 0;
+
+		file.clear();
+		Append(file, &kDDSMagic, sizeof(kDDSMagic));
+		Append(file, &header, sizeof(header));
+		Append(file, &dx10, sizeof(dx10));
+		for (auto const& level : m_Levels)
+			Append(file, level.Data, (size_t)level.Size);
+		return true;
+	}
+
+	bool ImageData::WriteKTX2(std::vector<kByte> & file) const
+	{
+		uint32 vkFormat = FindCode(kVkFormats, GetFormat());
+		std::vector<uint32> dfd = MakeDFD(GetFormat());
+		if (!vkFormat || dfd.empty() || m_Levels.empty())
+			return false;
+		uint32 faces = m_IsCubeMap ? 6 : 1;
+		KTX2Header header;
+		memcpy(header.Identifier, kKTX2Identifier, sizeof(kKTX2Identifier));
+		header.VkFormat = vkFormat;
+		header.TypeSize = 1;
+		header.PixelWidth = m_ImgWidth;
+		header.PixelHeight = m_ImgHeight;
+		header.PixelDepth = m_ImgType == TEXTURE_3D ? m_ImgDepth : 0;
+		header.LayerCount = m_ImgLayers == faces ? 0 : m_ImgLayers / faces;
+		header.FaceCount = faces;
+		header.LevelCount = m_MipLev;
+		header.SupercompressionScheme = 0;
+		header.DfdByteOffset = sizeof(header) + m_MipLev * sizeof(KTX2Level);
+		header.DfdByteLength = (uint32)(dfd.size() * sizeof(uint32));
+		header.KvdByteOffset = header.KvdByteLength = 0;
+		header.SgdByteOffset = header.SgdByteLength = 0;
+
+		// levels are stored smallest first, aligned to the texel block and 4 bytes,
+		// element sizes are powers of 2
+		uint64 alignment = std::max(m_ElementSize, 4u);
+		std::vector<KTX2Level> index(m_MipLev);
+		uint64 offset = header.DfdByteOffset + header.DfdByteLength;
+		for (int32 level = m_MipLev - 1; level >= 0; level--)
+		{
+			offset = (offset + alignment - 1) / alignment * alignment;
+			index[level].ByteOffset = offset;
+			index[level].ByteLength = index[level].UncompressedByteLength = m_Levels[level].Size * m_ImgLayers;
+			offset += index[level].ByteLength;
+		}
+
+		file.clear();
+		file.reserve((size_t)offset);
+		Append(file, &header, sizeof(header));
+		Append(file, index.data(), index.size() * sizeof(KTX2Level));
+		Append(file, dfd.data(), dfd.size() * sizeof(uint32));
+		for (int32 level = m_MipLev - 1; level >= 0; level--)
+		{
+			file.resize((size_t)index[level].ByteOffset);
+			for (uint32 layer = 0; layer < m_ImgLayers; layer++)
+				Append(file, m_Levels[layer * m_MipLev + level].Data, (size_t)m_Levels[level].Size);
+		}
+		return true;
 	}
 
 	bool ImageData::IsCompressed() const
@@ -116,6 +886,6 @@ namespace k3d
 
 	kByte* ImageData::GetData() const
 	{
-		return &m_ImgData[0][0];
+		return m_Levels.empty() ? nullptr : const_cast<kByte*>(m_Levels[0].Data);
 	}
-}
\ No newline at end of file
+}
@@ -4,12 +4,64 @@
 
 #include "Bundle.h"
 
-namespace k3d 
+namespace k3d
 {
+	/// portable pixel formats of DDS (DXGI_FORMAT, legacy pixel formats) and
+	/// KTX2 (VkFormat) textures
+	enum class EImageFormat : uint32
+	{
+		UNKNOWN,
+		R8_UNORM,
+		RG8_UNORM,
+		RGBA8_UNORM,
+		RGBA8_SRGB,
+		BGRA8_UNORM,
+		BGRA8_SRGB,
+		RGB10A2_UNORM,
+		RG11B10_FLOAT,
+		R16_UNORM,
+		R16_FLOAT,
+		RG16_FLOAT,
+		RGBA16_UNORM,
+		RGBA16_FLOAT,
+		R32_FLOAT,
+		RG32_FLOAT,
+		RGBA32_FLOAT,
+		BC1_UNORM,
+		BC1_SRGB,
+		BC2_UNORM,
+		BC2_SRGB,
+		BC3_UNORM,
+		BC3_SRGB,
+		BC4_UNORM,
+		BC4_SNORM,
+		BC5_UNORM,
+		BC5_SNORM,
+		BC6H_UFLOAT,
+		BC6H_SFLOAT,
+		BC7_UNORM,
+		BC7_SRGB,
+		NUM
+	};
+
+	/// \brief one mip level of one layer (array element or cube face) of an image
+	struct ImageLevel
+	{
+		const kByte *	Data;
+		uint64			Size;
+		uint32			Width;
+		uint32			Height;
+		uint32			Depth;
+		/// bytes of a row of pixels, or of 4x4 blocks if compressed
+		uint32			RowPitch;
+		/// rows of pixels or blocks in a slice
+		uint32			Rows;
+	};
+
 	/// \brief The Image class
 	/// \class Image : client side texture data
 	/// \see  k3dTexture
-	class ImageData
+	class K3D_API ImageData
 	{
 	public:
 		enum Type {
@@ -31,7 +83,9 @@ namespace k3d
 		KOBJECT_PROPERTY_GET(MipLevs, uint32);
 		KOBJECT_PROPERTY_GET(Layers, uint32);
 
+		/// EImageFormat
 		KOBJECT_PROPERTY_GET(InternalFmt, uint32);
+		/// the format code of the file, DXGI_FORMAT or VkFormat
 		KOBJECT_PROPERTY_GET(FillFmt, uint32);
 		KOBJECT_PROPERTY_GET(DataType, uint32);
 		KOBJECT_PROPERTY_GET(Data, kByte*);
@@ -40,16 +94,61 @@ namespace k3d
 		KOBJECT_CLASSNAME(ImageData)
 
 		uint32 GetImageSize(uint32 level) const;
+		/// \param face layer index, array element * 6 + cube face for cube arrays
 		const void * GetLevel(uint32 level, uint32 face) const;
+		/// null if 'level' or 'layer' is out of range
+		const ImageLevel * GetLevelDesc(uint32 level, uint32 layer) const;
+		Type GetType() const { return m_ImgType; }
+		EImageFormat GetFormat() const { return (EImageFormat)m_InternalFmt; }
 
+		/// Parses a DDS (with or without DX10 header) or KTX2 file in place, the
+		/// levels point into 'dataPtr' which has to outlive the image.
 		virtual bool Load(uint8 *dataPtr, uint32 length);
+		/// Load for memory 'storage' owns, the image keeps it alive
+		bool LoadView(const kByte * data, uint64 size, std::shared_ptr<const void> const& storage);
 		virtual bool IsCompressed() const;
 		virtual bool IsCubeMap() const;
+		/// the levels point into memory the image doesn't own (a mapping, decoded
+		/// chunk or the buffer given to Load), they are read-only
+		bool IsView() const { return !m_Levels.empty() && m_Pixels.empty(); }
+
+		/// Allocates the zeroed levels of an image the image owns, in the
+		/// layout of a DDS file (each layer with its mip chain).
+		/// \param layers 6 per cube map if 'cubeMap'
+		bool Create(EImageFormat format, uint32 width, uint32 height, uint32 mipLevels, uint32 layers = 1, bool cubeMap = false);
+		/// writable level of an image made by Create, null for views
+		kByte * GetLevelData(uint32 level, uint32 layer);
+
+		/// \brief image of a mapped DDS or KTX2 file, the levels point into the mapping
+		/// \return null if the file can't be mapped or has no supported format
+		static std::shared_ptr<ImageData>	CreateFromFile(const kchar * path);
+		/// \brief image of a bundle chunk holding a DDS or KTX2 file, a view into
+		/// the mapping of 'file' if the chunk is stored raw, otherwise a view into
+		/// its decoded bytes
+		static std::shared_ptr<ImageData>	CreateFromChunk(AssetChunkView const& chunk,
+			std::shared_ptr<Os::MemMapFile> const& file, Dispatch::ThreadPool * workers = nullptr);
+
+		/// \brief the image as a DDS file with DX10 header
+		/// \return false if DXGI has no code for the format
+		bool WriteDDS(std::vector<kByte> & file) const;
+		/// \brief the image as a KTX2 file without supercompression
+		/// \return false for formats other than 8 bit RGBA, R, RG and BC1, BC3, BC4, BC5, BC7 UNORM/SRGB
+		bool WriteKTX2(std::vector<kByte> & file) const;
+
+		/// bytes of a 4x4 block if compressed, else of a pixel, 0 for UNKNOWN
+		static uint32 GetFormatElementSize(EImageFormat format);
+		static bool IsCompressedFormat(EImageFormat format);
 
 		friend class k3dAssetManager;
-		typedef std::vector<kByte*> ByteVec;
+		typedef std::vector<ImageLevel> LevelVec;
 
 	protected:
+		void      Release();
+		bool      LoadDDS(const kByte * data, uint64 size);
+		bool      LoadKTX2(const kByte * data, uint64 size);
+		/// sets the dimensions and m_Levels to the layer-major layout of
+		/// 'mipLevels' x 'layers' levels
+		bool      InitLevels(EImageFormat format, uint32 width, uint32 height, uint32 depth, uint32 mipLevels, uint32 layers);
 
 		uint32    m_ImgWidth;
 		uint32    m_ImgHeight;
@@ -57,13 +156,17 @@ namespace k3d
 		uint32    m_ImgLayers;
 		//  uint32    m_ImgCnt;
 		int32     m_MipLev;
-		//  Type      m_ImgType;
+		Type      m_ImgType;
 		uint32    m_InternalFmt;
 		uint32    m_FillFmt;
 		uint32    m_DataType;
 		uint32    m_ElementSize;
 
-		ByteVec   m_ImgData;
+		/// layer * m_MipLev + level
+		LevelVec  m_Levels;
+		std::shared_ptr<const void>	m_Storage;
+		/// the levels of Create
+		std::vector<kByte>	m_Pixels;
 
 		bool      m_IsCubeMap;
 		bool      m_IsCompressed;
@@ -22,6 +22,7 @@ namespace k3d
 
 		m_PrimType = PrimType::TRIANGLES;
 		m_VtxFmt = VtxFormat::PER_INSTANCE;
+		m_MaterialID = 0;
 
 		memset(m_MeshName, 0, 96);
 	}
@@ -33,7 +34,15 @@ namespace k3d
 
 	void MeshData::Release()
 	{
-		SAFERELEASEARRAY(m_IndexData);
+		if (m_Storage)
+		{
+			m_Storage.reset();
+		}
+		else
+		{
+			SAFERELEASEARRAY(m_IndexData);
+			ReleaseVertexBuffer();
+		}
 		m_IsLoaded = false;
 		m_NumIndices = 0;
 		m_NumVertices = 0;
@@ -45,6 +54,46 @@ namespace k3d
 		m_VtxFmt = VtxFormat::PER_INSTANCE;
 	}
 
+	void MeshData::ReleaseVertexBuffer()
+	{
+		switch (m_VtxFmt) {
+		case VtxFormat::POS3_F32_NOR3_F32_UV2_F32:
+			SAFERELEASEARRAY(m_P3N3T2Buffer);
+			break;
+		case VtxFormat::POS3_F32_NOR3_F32:
+			SAFERELEASEARRAY(m_P3N3Buffer);
+			break;
+		case VtxFormat::POS3_F32:
+			SAFERELEASEARRAY(m_P3Buffer);
+			break;
+		case VtxFormat::POS3_F32_UV2_F32:
+			SAFERELEASEARRAY(m_P3T2Buffer);
+			break;
+		case VtxFormat::POS4_F32:
+			SAFERELEASEARRAY(m_P4Buffer);
+			break;
+		case VtxFormat::POS3_U16:
+		case VtxFormat::POS3_U16_UV2_F16:
+		case VtxFormat::POS3_U16_NOR_OCT8:
+		case VtxFormat::POS3_U16_NOR_OCT8_UV2_F16:
+			SAFERELEASEARRAY(m_PackedBuffer);
+			break;
+		default:
+			break;
+		}
+		m_P3N3T2Buffer = nullptr;
+	}
+
+	void MeshData::ReplaceVertexBuffer(VtxFormat format, int num, const void * dataPtr)
+	{
+		if (m_Storage)
+			Detach();
+		ReleaseVertexBuffer();
+		m_VtxFmt = format;
+		m_NumVertices = num;
+		SetVertexBuffer(const_cast<void*>(dataPtr));
+	}
+
 	void MeshData::SetMeshName(const char *meshName)
 	{
 		assert(meshName && "MeshName cannot be nullptr");
@@ -58,6 +107,13 @@ namespace k3d
 
 	void MeshData::SetIndexBuffer(std::vector<uint32> &indexBuffer)
 	{
+		if (m_Storage)
+		{
+			// only the vertices of the view are copied out
+			m_IndexData = nullptr;
+			Detach();
+		}
+		SAFERELEASEARRAY(m_IndexData);
 		m_NumIndices = (uint32)indexBuffer.size();
 		if (m_NumIndices != 0) {
 			m_IndexData = new uint32[m_NumIndices];
@@ -67,6 +123,13 @@ namespace k3d
 
 	void MeshData::SetVertexBuffer(void *dataPtr) {
 		assert(m_NumVertices!=0);
+		if (m_Storage)
+		{
+			// only the indices of the view are copied out
+			m_P3Buffer = nullptr;
+			Detach();
+		}
+		ReleaseVertexBuffer();
 		switch (m_VtxFmt) {
 		case VtxFormat::POS3_F32:
 			m_P3Buffer = new Vertex3F[m_NumVertices];
@@ -80,11 +143,141 @@ namespace k3d
 			m_P3N3T2Buffer = new Vertex3F3F2F[m_NumVertices];
 			std::memcpy(m_P3N3T2Buffer, dataPtr, m_NumVertices*sizeof(Vertex3F3F2F));
 			break;
+		case VtxFormat::POS3_F32_UV2_F32:
+			m_P3T2Buffer = new Vertex3F2F[m_NumVertices];
+			std::memcpy(m_P3T2Buffer, dataPtr, m_NumVertices*sizeof(Vertex3F2F));
+			break;
+		case VtxFormat::POS3_U16:
+		case VtxFormat::POS3_U16_UV2_F16:
+		case VtxFormat::POS3_U16_NOR_OCT8:
+		case VtxFormat::POS3_U16_NOR_OCT8_UV2_F16:
+			// the strides are multiples of 4 bytes
+			m_PackedBuffer = new uint32[GetVertexByteWidth(m_VtxFmt, m_NumVertices) / sizeof(uint32)];
+			std::memcpy(m_PackedBuffer, dataPtr, GetVertexByteWidth(m_VtxFmt, m_NumVertices));
+			break;
 		default:
 			break;
 		}
 	}
 			
+	/// bytes of the vertex data operator << writes
+	static uint64 SerializedVertexBytes(VtxFormat format, uint32 numVertices)
+	{
+		switch (format) {
+		case VtxFormat::POS3_F32_NOR3_F32_UV2_F32:
+		case VtxFormat::POS3_F32_NOR3_F32:
+		case VtxFormat::POS3_F32_UV2_F32:
+		case VtxFormat::POS3_F32:
+		case VtxFormat::POS4_F32:
+		case VtxFormat::POS3_U16:
+		case VtxFormat::POS3_U16_UV2_F16:
+		case VtxFormat::POS3_U16_NOR_OCT8:
+		case VtxFormat::POS3_U16_NOR_OCT8_UV2_F16:
+			return (uint64)MeshData::GetVertexStride(format) * numVertices;
+		default:
+			return 0;
+		}
+	}
+
+	bool MeshData::LoadView(const kByte * data, uint64 size, std::shared_ptr<const void> const& storage)
+	{
+		Release();
+		uint64 pos = 0;
+		auto read = [data, size, &pos](void * dst, uint64 bytes)
+		{
+			if (pos + bytes > size)
+				return false;
+			memcpy(dst, data + pos, (size_t)bytes);
+			pos += bytes;
+			return true;
+		};
+		EMeshVersion version = EMeshVersion::VERSION_1_0;
+		if (!read(&version, sizeof(version)) || version != EMeshVersion::VERSION_1_1)
+			return false;
+		// the class name, see operator <<
+		pos += 64;
+		bool ok = read(m_MeshName, 96)
+			&& read(&m_VtxFmt, sizeof(m_VtxFmt)) && read(&m_PrimType, sizeof(m_PrimType))
+			&& read(&m_NumIndices, sizeof(m_NumIndices)) && read(&m_NumVertices, sizeof(m_NumVertices))
+			&& read(&m_MaterialID, sizeof(m_MaterialID))
+			&& read(&m_MaxCorner, sizeof(m_MaxCorner)) && read(&m_MinCorner, sizeof(m_MinCorner));
+		uint64 indexBytes = (uint64)m_NumIndices * sizeof(uint32);
+		uint64 vertexBytes = SerializedVertexBytes(m_VtxFmt, m_NumVertices);
+		if (!ok || pos + indexBytes + vertexBytes > size)
+		{
+			m_NumIndices = 0;
+			m_NumVertices = 0;
+			return false;
+		}
+		const kByte * indices = data + pos;
+		const kByte * vertices = indices + indexBytes;
+		m_IndexData = m_NumIndices ? (uint32*)indices : nullptr;
+		m_P3Buffer = vertexBytes ? (Vertex3F*)vertices : nullptr;
+		m_Storage = storage;
+		if (((uintptr_t)indices | (uintptr_t)vertices) % alignof(uint32) != 0)
+			Detach();
+		m_IsLoaded = true;
+		return true;
+	}
+
+	void MeshData::Detach()
+	{
+		if (!m_Storage)
+			return;
+		const uint32 * indices = m_IndexData;
+		const Vertex3F * vertices = m_P3Buffer;
+		uint64 vertexBytes = SerializedVertexBytes(m_VtxFmt, m_NumVertices);
+		m_IndexData = nullptr;
+		m_P3Buffer = nullptr;
+		if (indices) {
+			m_IndexData = new uint32[m_NumIndices];
+			memcpy(m_IndexData, indices, m_NumIndices * sizeof(uint32));
+		}
+		if (vertices && vertexBytes) {
+			switch (m_VtxFmt) {
+			case VtxFormat::POS3_F32_NOR3_F32_UV2_F32:
+				m_P3N3T2Buffer = new Vertex3F3F2F[m_NumVertices];
+				break;
+			case VtxFormat::POS3_F32_NOR3_F32:
+				m_P3N3Buffer = new Vertex3F3F[m_NumVertices];
+				break;
+			case VtxFormat::POS3_F32_UV2_F32:
+				m_P3T2Buffer = new Vertex3F2F[m_NumVertices];
+				break;
+			case VtxFormat::POS3_F32:
+				m_P3Buffer = new Vertex3F[m_NumVertices];
+				break;
+			case VtxFormat::POS4_F32:
+				m_P4Buffer = new Vertex4F[m_NumVertices];
+				break;
+			default:
+				m_PackedBuffer = new uint32[vertexBytes / sizeof(uint32)];
+				break;
+			}
+			memcpy(m_P3Buffer, vertices, (size_t)vertexBytes);
+		}
+		// released last, it may own the memory copied from
+		m_Storage.reset();
+	}
+
+	std::shared_ptr<MeshData> MeshData::CreateFromChunk(AssetChunkView const& chunk,
+		std::shared_ptr<Os::MemMapFile> const& file, Dispatch::ThreadPool * workers)
+	{
+		auto mesh = std::make_shared<MeshData>();
+		if (chunk.Compression == EChunkCompression::ENone)
+		{
+			if (!mesh->LoadView(chunk.Data, chunk.Size, file))
+				return nullptr;
+			return mesh;
+		}
+		// decoded once into the buffer the mesh keeps
+		auto decoded = std::make_shared<std::vector<kByte>>((size_t)chunk.RawSize);
+		if (!AssetBundleReader::Decode(chunk, decoded->data(), workers)
+			|| !mesh->LoadView(decoded->data(), decoded->size(), decoded))
+			return nullptr;
+		return mesh;
+	}
+
 	Archive & operator >> (Archive &arch, MeshData &mesh)
 	{
 		//  arch.ArrayIn(MeshData::ClassName(), 64);
@@ -125,6 +318,20 @@ namespace k3d
 				mesh.m_P4Buffer = new Vertex4F[mesh.m_NumVertices];
 				arch.ArrayOut<Vertex4F>(mesh.m_P4Buffer, mesh.m_NumVertices);
 				break;
+			case VtxFormat::POS3_F32_UV2_F32:
+				mesh.m_P3T2Buffer = new Vertex3F2F[mesh.m_NumVertices];
+				arch.ArrayOut<Vertex3F2F>(mesh.m_P3T2Buffer, mesh.m_NumVertices);
+				break;
+			case VtxFormat::POS3_U16:
+			case VtxFormat::POS3_U16_UV2_F16:
+			case VtxFormat::POS3_U16_NOR_OCT8:
+			case VtxFormat::POS3_U16_NOR_OCT8_UV2_F16:
+			{
+				uint32 numWords = MeshData::GetVertexByteWidth(mesh.m_VtxFmt, mesh.m_NumVertices) / sizeof(uint32);
+				mesh.m_PackedBuffer = new uint32[numWords];
+				arch.ArrayOut<uint32>(mesh.m_PackedBuffer, numWords);
+				break;
+			}
 			default:
 				break;
 			}
@@ -135,7 +342,10 @@ namespace k3d
 
 	Archive & operator <<(Archive &arch, const MeshData &mesh)
 	{
-		arch.ArrayIn(MeshData::ClassName(), 64);
+		// padded, serialized chunks are compared and hashed byte by byte
+		char className[64] = {};
+		strncpy(className, MeshData::ClassName(), 63);
+		arch.ArrayIn(className, 64);
 		arch.ArrayIn(mesh.m_MeshName, 96);
 
 		arch << mesh.m_VtxFmt;
@@ -167,6 +377,15 @@ namespace k3d
 			case VtxFormat::POS4_F32:
 				arch.ArrayIn<Vertex4F>(mesh.m_P4Buffer, mesh.m_NumVertices);
 				break;
+			case VtxFormat::POS3_F32_UV2_F32:
+				arch.ArrayIn<Vertex3F2F>(mesh.m_P3T2Buffer, mesh.m_NumVertices);
+				break;
+			case VtxFormat::POS3_U16:
+			case VtxFormat::POS3_U16_UV2_F16:
+			case VtxFormat::POS3_U16_NOR_OCT8:
+			case VtxFormat::POS3_U16_NOR_OCT8_UV2_F16:
+				arch.ArrayIn<uint32>(mesh.m_PackedBuffer, MeshData::GetVertexByteWidth(mesh.m_VtxFmt, mesh.m_NumVertices) / sizeof(uint32));
+				break;
 			default:
 				break;
 			}
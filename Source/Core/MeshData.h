@@ -60,6 +60,34 @@ namespace k3d
 		float U, V;
 	};
 
+	/// quantized vertices, see VertexCodec. The position comes first and
+	/// takes 8 bytes, its 4th component holds the normal or is padding.
+	struct KALIGN(4) VertexQ3
+	{
+		uint16 PosX, PosY, PosZ;
+		uint16 Pad;
+	};
+
+	struct KALIGN(4) VertexQ3H2
+	{
+		uint16 PosX, PosY, PosZ;
+		uint16 Pad;
+		uint16 U, V;
+	};
+
+	struct KALIGN(4) VertexQ3O2
+	{
+		uint16 PosX, PosY, PosZ;
+		int8 NorX, NorY;
+	};
+
+	struct KALIGN(4) VertexQ3O2H2
+	{
+		uint16 PosX, PosY, PosZ;
+		int8 NorX, NorY;
+		uint16 U, V;
+	};
+
 	struct KALIGN(4) Normal3F
 	{
 		float x, y, z;
@@ -88,6 +116,20 @@ namespace k3d
 
 		const char * Name() const {	return m_MeshName; }
 		bool		IsLoaded() const { return m_IsLoaded; }
+		/// the buffers point into memory the mesh doesn't own, they are read-only
+		bool		IsView() const { return m_Storage != nullptr; }
+
+		/// Reads a serialized mesh (EMeshVersion, class name, mesh) without copying,
+		/// the index and vertex buffers point into 'data' which 'storage' owns.
+		/// Buffers which are not 4 byte aligned are copied.
+		bool		LoadView(const kByte * data, uint64 size, std::shared_ptr<const void> const& storage);
+		/// copies the buffers of a view into owned arrays, so they can be modified
+		void		Detach();
+		/// \brief mesh of a bundle chunk, a view into the mapping of 'file' if the
+		/// chunk is stored raw, otherwise a view into its decoded bytes
+		/// \return null if the chunk is no valid mesh
+		static std::shared_ptr<MeshData>	CreateFromChunk(AssetChunkView const& chunk,
+			std::shared_ptr<Os::MemMapFile> const& file, Dispatch::ThreadPool * workers = nullptr);
 
 		kMath::AABB GetBoundingBox() const override{ return kMath::AABB(m_MaxCorner, m_MinCorner); }
 		uint32		GetMaterialID() const override { return m_MaterialID; }
@@ -105,6 +147,8 @@ namespace k3d
 
 		float *		GetVertexBuffer() const override { return (float*)&m_P3Buffer[0]; }
 		void		SetVertexBuffer(void* dataPtr);
+		/// frees the vertices and copies 'num' vertices of 'format' from 'dataPtr'
+		void		ReplaceVertexBuffer(VtxFormat format, int num, const void * dataPtr);
 		void		SetVertexNum(int num) { m_NumVertices = num; }
 
 		std::string DumpMeshInfo() 
@@ -131,16 +175,7 @@ namespace k3d
 
 		static uint32	GetVertexByteWidth(VtxFormat format, uint32 vertexNum)
 		{
-			static uint32 elementByteWidth[] = {
-				sizeof(Vertex3F),
-				sizeof(Vertex4F),
-				sizeof(Vertex3F2F),
-				sizeof(Vertex3F3F),
-				sizeof(Vertex3F3F2F)
-			};
-			if (format > VtxFormat::POS3_F32_NOR3_F32_UV2_F32)
-				return 0;
-			return elementByteWidth[(uint32)format] * vertexNum;
+			return GetVertexStride(format) * vertexNum;
 		}
 
 		static uint32	GetVertexStride(VtxFormat format)
@@ -150,13 +185,26 @@ namespace k3d
 				sizeof(Vertex4F),
 				sizeof(Vertex3F2F),
 				sizeof(Vertex3F3F),
-				sizeof(Vertex3F3F2F)
+				sizeof(Vertex3F3F2F),
+				0,
+				0,
+				0,
+				sizeof(VertexQ3),
+				sizeof(VertexQ3H2),
+				sizeof(VertexQ3O2),
+				sizeof(VertexQ3O2H2)
 			};
-			if (format > VtxFormat::POS3_F32_NOR3_F32_UV2_F32)
+			if (format > VtxFormat::POS3_U16_NOR_OCT8_UV2_F16)
 				return 0;
 			return elementByteStride[(uint32)format];
 		}
 
+		/// positions are 16 bit within the bounding box, see VertexCodec
+		static bool		IsQuantized(VtxFormat format)
+		{
+			return format >= VtxFormat::POS3_U16 && format <= VtxFormat::POS3_U16_NOR_OCT8_UV2_F16;
+		}
+
 		static std::string VtxFormatToString(VtxFormat format)
 		{
 			static std::string vtxFormatStr[] = {
@@ -164,9 +212,16 @@ namespace k3d
 				"Vertex4F",
 				"Vertex3F2F",
 				"Vertex3F3F",
-				"Vertex3F3F2F"
+				"Vertex3F3F2F",
+				"Unknown",
+				"Unknown",
+				"Unknown",
+				"VertexQ3",
+				"VertexQ3H2",
+				"VertexQ3O2",
+				"VertexQ3O2H2"
 			};
-			if (format > VtxFormat::POS3_F32_NOR3_F32_UV2_F32)
+			if (format > VtxFormat::POS3_U16_NOR_OCT8_UV2_F16)
 				return "Unknown";
 			return vtxFormatStr[(uint32)format];
 		}
@@ -182,11 +237,15 @@ namespace k3d
 		}
 
 	private:
+		void		ReleaseVertexBuffer();
+
 		MeshData(const MeshData &) = delete;
 		MeshData& operator = (const MeshData &) = delete;
 
 		bool                    m_IsLoaded;
 		char                    m_MeshName[96];
+		/// owner of the buffers of a view
+		std::shared_ptr<const void>	m_Storage;
 				
 		// IndexBuffer
 		PrimType				m_PrimType;
@@ -199,8 +258,11 @@ namespace k3d
 		union {
 			Vertex3F3F2F*		m_P3N3T2Buffer;
 			Vertex3F3F*			m_P3N3Buffer;
+			Vertex3F2F*			m_P3T2Buffer;
 			Vertex3F*			m_P3Buffer;
 			Vertex4F*			m_P4Buffer;
+			/// the quantized formats
+			uint32*				m_PackedBuffer;
 		};
 
 		uint32			        m_MaterialID;
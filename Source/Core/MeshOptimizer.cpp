@@ -0,0 +1,462 @@
+#include "Kaleido3D.h"
+#include "MeshOptimizer.h"
+#include "MeshData.h"
+#include "LogUtil.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace k3d
+{
+	namespace MeshOptimizer
+	{
+		namespace
+		{
+			const uint32 kInvalid = ~0u;
+			/// largest cache Forsyth's scoring models
+			const uint32 kMaxCacheSize = 64;
+
+			/// triangles of every vertex, the first Counts[v] of a vertex are the live ones
+			struct Adjacency
+			{
+				std::vector<uint32>	Offsets;
+				std::vector<uint32>	Triangles;
+				std::vector<uint32>	Counts;
+
+				Adjacency(const uint32 * indices, size_t numIndices, uint32 numVertices)
+					: Offsets(numVertices + 1, 0)
+					, Triangles(numIndices)
+					, Counts(numVertices, 0)
+				{
+					for (size_t i = 0; i < numIndices; i++)
+						Counts[indices[i]]++;
+					for (uint32 v = 0; v < numVertices; v++)
+						Offsets[v + 1] = Offsets[v] + Counts[v];
+					std::vector<uint32> fill(Offsets.begin(), Offsets.end() - 1);
+					for (size_t i = 0; i < numIndices; i++)
+						Triangles[fill[indices[i]]++] = (uint32)(i / 3);
+				}
+
+				const uint32 * Begin(uint32 v) const { return &Triangles[0] + Offsets[v]; }
+
+				/// moves 'triangle' behind the live triangles of 'v'
+				void Remove(uint32 v, uint32 triangle)
+				{
+					uint32 * live = &Triangles[0] + Offsets[v];
+					for (uint32 i = 0; i < Counts[v]; i++)
+					{
+						if (live[i] == triangle)
+						{
+							std::swap(live[i], live[Counts[v] - 1]);
+							Counts[v]--;
+							return;
+						}
+					}
+				}
+			};
+
+			/// FIFO cache of 'size' vertices over time stamps, a vertex is
+			/// cached while less than 'size' vertices were added after it
+			struct FifoCache
+			{
+				std::vector<uint32>	Time;
+				uint32				Now;
+				uint32				Size;
+
+				FifoCache(uint32 numVertices, uint32 size) : Time(numVertices, 0), Now(size + 1), Size(size) {}
+
+				bool Access(uint32 v)
+				{
+					if (Now - Time[v] <= Size)
+						return false;
+					Time[v] = Now++;
+					return true;
+				}
+
+				void Flush() { Now += Size + 1; }
+			};
+
+			float ForsythScore(int cachePosition, uint32 numLive, uint32 cacheSize)
+			{
+				if (numLive == 0)
+					return -1.0f;
+				float score = 0.0f;
+				if (cachePosition >= 0)
+				{
+					// the last triangle's vertices score the same, whatever the order
+					if (cachePosition < 3)
+						score = 0.75f;
+					else
+						score = powf(1.0f - (cachePosition - 3) / (float)(cacheSize - 3), 1.5f);
+				}
+				// favors vertices with few triangles left, to get rid of them
+				return score + 2.0f / sqrtf((float)numLive);
+			}
+
+			void OptimizeForsyth(uint32 * dst, const uint32 * indices, size_t numIndices, uint32 numVertices, uint32 cacheSize)
+			{
+				cacheSize = std::max(4u, std::min(cacheSize, kMaxCacheSize));
+				size_t numTriangles = numIndices / 3;
+				Adjacency adjacency(indices, numIndices, numVertices);
+				std::vector<float> vertexScore(numVertices);
+				for (uint32 v = 0; v < numVertices; v++)
+					vertexScore[v] = ForsythScore(-1, adjacency.Counts[v], cacheSize);
+				std::vector<float> triangleScore(numTriangles);
+				std::vector<uint8> emitted(numTriangles, 0);
+				uint32 best = kInvalid;
+				for (size_t t = 0; t < numTriangles; t++)
+				{
+					triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+					if (best == kInvalid || triangleScore[t] > triangleScore[best])
+						best = (uint32)t;
+				}
+
+				uint32 cache[kMaxCacheSize + 3], newCache[kMaxCacheSize + 3];
+				uint32 cacheCount = 0;
+				size_t cursor = 0;
+				for (size_t out = 0; out < numTriangles; out++)
+				{
+					if (best == kInvalid)
+					{
+						// nothing in the cache has triangles left, the input order decides
+						while (emitted[cursor])
+							cursor++;
+						best = (uint32)cursor;
+					}
+					const uint32 * triangle = indices + best * 3;
+					memcpy(dst + out * 3, triangle, 3 * sizeof(uint32));
+					emitted[best] = 1;
+
+					uint32 newCount = 0;
+					for (uint32 k = 0; k < 3; k++)
+					{
+						adjacency.Remove(triangle[k], best);
+						if (std::find(newCache, newCache + newCount, triangle[k]) == newCache + newCount)
+							newCache[newCount++] = triangle[k];
+					}
+					for (uint32 i = 0; i < cacheCount && newCount < cacheSize + 3; i++)
+					{
+						if (cache[i] != triangle[0] && cache[i] != triangle[1] && cache[i] != triangle[2])
+							newCache[newCount++] = cache[i];
+					}
+					// positions past cacheSize have just been evicted
+					for (uint32 i = 0; i < newCount; i++)
+					{
+						uint32 v = newCache[i];
+						float score = ForsythScore(i < cacheSize ? (int)i : -1, adjacency.Counts[v], cacheSize);
+						float delta = score - vertexScore[v];
+						vertexScore[v] = score;
+						const uint32 * live = adjacency.Begin(v);
+						for (uint32 j = 0; j < adjacency.Counts[v]; j++)
+							triangleScore[live[j]] += delta;
+					}
+					best = kInvalid;
+					float bestScore = 0.0f;
+					cacheCount = std::min(newCount, cacheSize);
+					for (uint32 i = 0; i < cacheCount; i++)
+					{
+						uint32 v = newCache[i];
+						cache[i] = v;
+						const uint32 * live = adjacency.Begin(v);
+						for (uint32 j = 0; j < adjacency.Counts[v]; j++)
+						{
+							if (best == kInvalid || triangleScore[live[j]] > bestScore)
+							{
+								best = live[j];
+								bestScore = triangleScore[best];
+							}
+						}
+					}
+				}
+			}
+
+			void OptimizeTipsify(uint32 * dst, const uint32 * indices, size_t numIndices, uint32 numVertices, uint32 cacheSize)
+			{
+				Adjacency adjacency(indices, numIndices, numVertices);
+				std::vector<uint32> & live = adjacency.Counts;
+				std::vector<uint32> cacheTime(numVertices, 0);
+				uint32 time = cacheSize + 1;
+				std::vector<uint8> emitted(numIndices / 3, 0);
+				std::vector<uint32> deadEnd;
+				deadEnd.reserve(numIndices);
+				std::vector<uint32> candidates;
+				uint32 cursor = 0;
+				size_t out = 0;
+
+				uint32 fan = numVertices > 0 ? 0 : kInvalid;
+				while (fan != kInvalid)
+				{
+					candidates.clear();
+					for (uint32 i = adjacency.Offsets[fan]; i < adjacency.Offsets[fan + 1]; i++)
+					{
+						uint32 t = adjacency.Triangles[i];
+						if (emitted[t])
+							continue;
+						for (uint32 k = 0; k < 3; k++)
+						{
+							uint32 v = indices[t * 3 + k];
+							deadEnd.push_back(v);
+							candidates.push_back(v);
+							live[v]--;
+							if (time - cacheTime[v] > cacheSize)
+								cacheTime[v] = time++;
+						}
+						memcpy(dst + out, indices + t * 3, 3 * sizeof(uint32));
+						out += 3;
+						emitted[t] = 1;
+					}
+
+					// the candidate which stays longest in the cache after its
+					// remaining triangles were fanned, one still in it at least
+					fan = kInvalid;
+					int bestPriority = -1;
+					for (uint32 v : candidates)
+					{
+						if (live[v] == 0)
+							continue;
+						int priority = 0;
+						if (time - cacheTime[v] + 2 * live[v] <= cacheSize)
+							priority = (int)(time - cacheTime[v]);
+						if (priority > bestPriority)
+						{
+							bestPriority = priority;
+							fan = v;
+						}
+					}
+					if (fan != kInvalid)
+						continue;
+					// dead end, the most recent vertex with triangles left
+					while (!deadEnd.empty() && fan == kInvalid)
+					{
+						uint32 v = deadEnd.back();
+						deadEnd.pop_back();
+						if (live[v] > 0)
+							fan = v;
+					}
+					while (fan == kInvalid && cursor < numVertices)
+					{
+						if (live[cursor] > 0)
+							fan = cursor;
+						else
+							cursor++;
+					}
+				}
+			}
+		}
+
+		CacheStats AnalyzeVertexCache(const uint32 * indices, size_t numIndices, uint32 numVertices, uint32 cacheSize)
+		{
+			CacheStats stats;
+			memset(&stats, 0, sizeof(stats));
+			FifoCache cache(numVertices, cacheSize);
+			std::vector<uint8> used(numVertices, 0);
+			for (size_t i = 0; i < numIndices; i++)
+			{
+				uint32 v = indices[i];
+				if (!used[v])
+				{
+					used[v] = 1;
+					stats.NumVertices++;
+				}
+				if (cache.Access(v))
+					stats.NumMisses++;
+			}
+			stats.NumTriangles = (uint32)(numIndices / 3);
+			stats.ACMR = stats.NumTriangles ? (float)stats.NumMisses / stats.NumTriangles : 0.0f;
+			stats.ATVR = stats.NumVertices ? (float)stats.NumMisses / stats.NumVertices : 0.0f;
+			return stats;
+		}
+
+		void OptimizeVertexCache(uint32 * dst, const uint32 * indices, size_t numIndices, uint32 numVertices,
+			ECacheMethod method, uint32 cacheSize)
+		{
+			assert(dst != indices && numIndices % 3 == 0);
+			if (method == ECacheMethod::Tipsify)
+				OptimizeTipsify(dst, indices, numIndices, numVertices, cacheSize);
+			else
+				OptimizeForsyth(dst, indices, numIndices, numVertices, cacheSize);
+		}
+
+		void OptimizeOverdraw(uint32 * dst, const uint32 * indices, size_t numIndices,
+			const float * positions, size_t stride, uint32 numVertices, uint32 cacheSize, float threshold)
+		{
+			assert(dst != indices && numIndices % 3 == 0);
+			size_t numTriangles = numIndices / 3;
+			if (numTriangles == 0)
+				return;
+
+			// hard boundaries where the cache starts over, a triangle missing all three vertices
+			std::vector<uint32> hard;
+			{
+				FifoCache cache(numVertices, cacheSize);
+				for (size_t t = 0; t < numTriangles; t++)
+				{
+					uint32 misses = cache.Access(indices[t * 3]) + cache.Access(indices[t * 3 + 1]) + cache.Access(indices[t * 3 + 2]);
+					if (misses == 3)
+						hard.push_back((uint32)t);
+				}
+				if (hard.empty() || hard[0] != 0)
+					hard.insert(hard.begin(), 0);
+			}
+			// soft boundaries, where the misses of a cluster so far stay within the threshold
+			std::vector<uint32> clusters;
+			{
+				FifoCache cache(numVertices, cacheSize);
+				uint32 totalMisses = 0;
+				for (size_t c = 0; c < hard.size(); c++)
+				{
+					cache.Flush();
+					uint32 end = c + 1 < hard.size() ? hard[c + 1] : (uint32)numTriangles;
+					for (uint32 t = hard[c]; t < end; t++)
+						totalMisses += cache.Access(indices[t * 3]) + cache.Access(indices[t * 3 + 1]) + cache.Access(indices[t * 3 + 2]);
+				}
+				float limit = threshold * totalMisses / numTriangles;
+				for (size_t c = 0; c < hard.size(); c++)
+				{
+					uint32 end = c + 1 < hard.size() ? hard[c + 1] : (uint32)numTriangles;
+					uint32 start = hard[c];
+					uint32 misses = 0;
+					cache.Flush();
+					clusters.push_back(start);
+					for (uint32 t = start; t < end; t++)
+					{
+						misses += cache.Access(indices[t * 3]) + cache.Access(indices[t * 3 + 1]) + cache.Access(indices[t * 3 + 2]);
+						if (t + 1 < end && misses <= limit * (t + 1 - start))
+						{
+							start = t + 1;
+							misses = 0;
+							cache.Flush();
+							clusters.push_back(start);
+						}
+					}
+				}
+			}
+
+			// area weighted centroids and normals
+			auto position = [positions, stride](uint32 v) { return (const float*)((const kByte*)positions + v * stride); };
+			size_t numClusters = clusters.size();
+			std::vector<float> centroids(numClusters * 3, 0.0f), normals(numClusters * 3, 0.0f), areas(numClusters, 0.0f);
+			float meshCentroid[3] = { 0, 0, 0 };
+			float meshArea = 0.0f;
+			for (size_t c = 0; c < numClusters; c++)
+			{
+				uint32 end = c + 1 < numClusters ? clusters[c + 1] : (uint32)numTriangles;
+				for (uint32 t = clusters[c]; t < end; t++)
+				{
+					const float * p0 = position(indices[t * 3]);
+					const float * p1 = position(indices[t * 3 + 1]);
+					const float * p2 = position(indices[t * 3 + 2]);
+					float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+					float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+					float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+					float area = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+					for (int k = 0; k < 3; k++)
+					{
+						float center = (p0[k] + p1[k] + p2[k]) / 3.0f;
+						centroids[c * 3 + k] += center * area;
+						normals[c * 3 + k] += n[k];
+						meshCentroid[k] += center * area;
+					}
+					areas[c] += area;
+					meshArea += area;
+				}
+			}
+			std::vector<float> keys(numClusters, 0.0f);
+			for (size_t c = 0; c < numClusters; c++)
+			{
+				const float * n = &normals[c * 3];
+				float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+				if (areas[c] <= 0.0f || length <= 0.0f || meshArea <= 0.0f)
+					continue;
+				for (int k = 0; k < 3; k++)
+					keys[c] += (centroids[c * 3 + k] / areas[c] - meshCentroid[k] / meshArea) * n[k] / length;
+			}
+			std::vector<uint32> order(numClusters);
+			for (size_t c = 0; c < numClusters; c++)
+				order[c] = (uint32)c;
+			// facing outwards first, they occlude the rest
+			std::stable_sort(order.begin(), order.end(), [&keys](uint32 a, uint32 b) { return keys[a] > keys[b]; });
+
+			size_t out = 0;
+			for (uint32 c : order)
+			{
+				uint32 begin = clusters[c];
+				uint32 end = c + 1 < numClusters ? clusters[c + 1] : (uint32)numTriangles;
+				memcpy(dst + out, indices + begin * 3, (end - begin) * 3 * sizeof(uint32));
+				out += (end - begin) * 3;
+			}
+		}
+
+		uint32 OptimizeVertexFetchRemap(uint32 * remap, const uint32 * indices, size_t numIndices, uint32 numVertices)
+		{
+			std::fill(remap, remap + numVertices, kInvalid);
+			uint32 next = 0;
+			for (size_t i = 0; i < numIndices; i++)
+			{
+				if (remap[indices[i]] == kInvalid)
+					remap[indices[i]] = next++;
+			}
+			uint32 used = next;
+			for (uint32 v = 0; v < numVertices; v++)
+			{
+				if (remap[v] == kInvalid)
+					remap[v] = next++;
+			}
+			return used;
+		}
+
+		bool Optimize(MeshData & mesh, Options const& options, Result * result)
+		{
+			if (mesh.GetPrimType() != PrimType::TRIANGLES || mesh.GetIndexBuffer() == nullptr || mesh.GetIndexNum() % 3 != 0)
+				return false;
+			// separated components can't follow a vertex fetch remap
+			VtxFormat format = mesh.GetVertexFormat();
+			uint32 stride = MeshData::GetVertexStride(format);
+			if (stride == 0 || mesh.GetVertexBuffer() == nullptr)
+				return false;
+			mesh.Detach();
+			uint32 * indices = mesh.GetIndexBuffer();
+			size_t numIndices = (size_t)mesh.GetIndexNum();
+			uint32 numVertices = (uint32)mesh.GetVertexNum();
+			for (size_t i = 0; i < numIndices; i++)
+			{
+				if (indices[i] >= numVertices)
+				{
+					KLOG(Error, MeshOptimizer, "Mesh (%s) has indices out of range.", mesh.Name());
+					return false;
+				}
+			}
+			Result local;
+			local.Before = AnalyzeVertexCache(indices, numIndices, numVertices, options.CacheSize);
+
+			kByte * vertices = (kByte*)mesh.GetVertexBuffer();
+
+			std::vector<uint32> source(indices, indices + numIndices);
+			OptimizeVertexCache(indices, source.data(), numIndices, numVertices, options.Method, options.CacheSize);
+			if (options.OverdrawThreshold > 0.0f && !MeshData::IsQuantized(format))
+			{
+				// every float format starts with the position
+				source.assign(indices, indices + numIndices);
+				OptimizeOverdraw(indices, source.data(), numIndices, (const float*)vertices, stride, numVertices,
+					options.CacheSize, options.OverdrawThreshold);
+			}
+			if (options.ReorderVertexFetch)
+			{
+				std::vector<uint32> remap(numVertices);
+				OptimizeVertexFetchRemap(remap.data(), indices, numIndices, numVertices);
+				for (size_t i = 0; i < numIndices; i++)
+					indices[i] = remap[indices[i]];
+				std::vector<kByte> copy(vertices, vertices + (size_t)stride * numVertices);
+				for (uint32 v = 0; v < numVertices; v++)
+					memcpy(vertices + (size_t)remap[v] * stride, copy.data() + (size_t)v * stride, stride);
+			}
+			local.After = AnalyzeVertexCache(indices, numIndices, numVertices, options.CacheSize);
+			if (result)
+				*result = local;
+			return true;
+		}
+	}
+}
@@ -0,0 +1,90 @@
+#ifndef __MeshOptimizer_h__
+#define __MeshOptimizer_h__
+#pragma once
+
+namespace k3d
+{
+	class MeshData;
+
+	/// Reordering of indexed triangle lists for the post-transform vertex cache,
+	/// overdraw and vertex fetch. Indices are 32 bit, the functions don't depend
+	/// on any graphics api and run on MeshData in offline tools.
+	namespace MeshOptimizer
+	{
+		enum class ECacheMethod : uint32
+		{
+			/// Forsyth, "Linear-Speed Vertex Cache Optimisation", greedy scoring
+			/// against a modeled LRU cache
+			Forsyth = 0,
+			/// Sander et al., "Fast Triangle Reordering for Vertex Locality and
+			/// Reduced Overdraw", fans around vertices, faster and the better
+			/// fit for FIFO caches
+			Tipsify,
+		};
+
+		/// simulated FIFO vertex cache
+		struct CacheStats
+		{
+			uint32	NumTriangles;
+			/// distinct vertices referenced
+			uint32	NumVertices;
+			uint32	NumMisses;
+			/// misses per triangle, 0.5 at best for large meshes, 3 at worst
+			float	ACMR;
+			/// misses per vertex, 1 is optimal
+			float	ATVR;
+		};
+
+		struct Options
+		{
+			ECacheMethod	Method;
+			uint32			CacheSize;
+			/// clusters are sorted front to back (from the outside in) when the
+			/// ACMR may grow by at most this factor, 0 disables the overdraw pass
+			float			OverdrawThreshold;
+			bool			ReorderVertexFetch;
+
+			Options()
+				: Method(ECacheMethod::Tipsify)
+				, CacheSize(16)
+				, OverdrawThreshold(1.05f)
+				, ReorderVertexFetch(true)
+			{
+			}
+		};
+
+		struct Result
+		{
+			CacheStats	Before;
+			CacheStats	After;
+		};
+
+		K3D_API CacheStats	AnalyzeVertexCache(const uint32 * indices, size_t numIndices, uint32 numVertices, uint32 cacheSize = 16);
+
+		/// \param dst numIndices indices, may not alias 'indices'
+		K3D_API void		OptimizeVertexCache(uint32 * dst, const uint32 * indices, size_t numIndices, uint32 numVertices,
+								ECacheMethod method = ECacheMethod::Tipsify, uint32 cacheSize = 16);
+
+		/// Splits a cache optimized list into clusters and sorts them by how
+		/// much they face away from the mesh center, so outer surfaces are
+		/// drawn first. Clusters start where the cache starts over (a triangle
+		/// missing all its vertices), more start where the ACMR of the cluster
+		/// so far is within 'threshold' of the whole list's.
+		/// \param positions 3 floats per vertex, 'stride' bytes apart
+		/// \param dst may not alias 'indices'
+		K3D_API void		OptimizeOverdraw(uint32 * dst, const uint32 * indices, size_t numIndices,
+								const float * positions, size_t stride, uint32 numVertices,
+								uint32 cacheSize = 16, float threshold = 1.05f);
+
+		/// vertices in the order of their first use, unused ones last
+		/// \param remap receives the new index of every vertex
+		/// \return number of vertices used
+		K3D_API uint32		OptimizeVertexFetchRemap(uint32 * remap, const uint32 * indices, size_t numIndices, uint32 numVertices);
+
+		/// Runs the passes of 'options' on a triangle list mesh, views are detached first
+		/// \return false if the mesh has no triangle list or no interleaved vertices
+		K3D_API bool		Optimize(MeshData & mesh, Options const& options = Options(), Result * result = nullptr);
+	}
+}
+
+#endif
@@ -0,0 +1,777 @@
+#include "Kaleido3D.h"
+#include "MeshSimplifier.h"
+#include "MeshData.h"
+#include "MeshOptimizer.h"
+#include "Dispatch/ThreadPool.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+namespace k3d
+{
+	namespace
+	{
+		const uint32 kInvalid = ~0u;
+		/// more than one open edge leaves a vertex
+		const uint32 kMultiple = ~1u;
+		/// normal and uv components
+		const uint32 kMaxAttributes = 5;
+		/// open edges resist moving inwards this much more than surfaces do
+		const float kBorderWeight = 10.0f;
+		/// once a tenth of its goal is reached, a pass collapses edges up to
+		/// this factor of the error at the goal, the edges locked by earlier
+		/// collapses wait for the next pass
+		const float kPassErrorSlack = 1.5f;
+		/// a LOD has to drop at least this share of the triangles before it
+		const float kMinLodReduction = 0.1f;
+
+		enum EVertexKind : uint8
+		{
+			/// collapses along any edge
+			EManifold,
+			/// on one open edge, collapses along it onto the border
+			EBorder,
+			/// one of two vertices split by attributes, collapses with its
+			/// partner along the seam
+			ESeam,
+			/// stays, corners and non manifold vertices
+			ELocked,
+		};
+
+		inline void Sub(float * r, const float * a, const float * b)
+		{
+			r[0] = a[0] - b[0]; r[1] = a[1] - b[1]; r[2] = a[2] - b[2];
+		}
+
+		inline float Dot(const float * a, const float * b)
+		{
+			return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+		}
+
+		inline void Cross(float * r, const float * a, const float * b)
+		{
+			r[0] = a[1] * b[2] - a[2] * b[1];
+			r[1] = a[2] * b[0] - a[0] * b[2];
+			r[2] = a[0] * b[1] - a[1] * b[0];
+		}
+
+		/// squared distance to planes and attribute gradients, summed
+		struct Quadric
+		{
+			float	A00, A11, A22, A10, A20, A21;
+			float	B0, B1, B2;
+			float	C;
+			/// weight of the planes, errors are weighted averages
+			float	W;
+			/// weight of the attribute terms and per attribute the gradient and offset sums
+			float	AW;
+			float	G[kMaxAttributes][3];
+			float	D[kMaxAttributes];
+		};
+
+		void AddQuadric(Quadric & q, Quadric const& r)
+		{
+			const float * src = &r.A00;
+			float * dst = &q.A00;
+			for (size_t k = 0; k < sizeof(Quadric) / sizeof(float); k++)
+				dst[k] += src[k];
+		}
+
+		/// w (n.p + d)^2
+		void AddPlane(Quadric & q, const float * n, float d, float w)
+		{
+			q.A00 += w * n[0] * n[0]; q.A11 += w * n[1] * n[1]; q.A22 += w * n[2] * n[2];
+			q.A10 += w * n[1] * n[0]; q.A20 += w * n[2] * n[0]; q.A21 += w * n[2] * n[1];
+			q.B0 += w * d * n[0]; q.B1 += w * d * n[1]; q.B2 += w * d * n[2];
+			q.C += w * d * d;
+			q.W += w;
+		}
+
+		/// w (g.p + d - s)^2 per attribute s, where g.p + d interpolates s over the triangle
+		void AddAttributes(Quadric & q, const float * p0, const float * p1, const float * p2,
+			const float * s0, const float * s1, const float * s2, uint32 numAttributes, float w)
+		{
+			float e1[3], e2[3];
+			Sub(e1, p1, p0);
+			Sub(e2, p2, p0);
+			float d11 = Dot(e1, e1), d12 = Dot(e1, e2), d22 = Dot(e2, e2);
+			float det = d11 * d22 - d12 * d12;
+			if (det <= 0.0f)
+				return;
+			q.AW += w;
+			for (uint32 c = 0; c < numAttributes; c++)
+			{
+				float ds1 = s1[c] - s0[c], ds2 = s2[c] - s0[c];
+				float x = (d22 * ds1 - d12 * ds2) / det, y = (d11 * ds2 - d12 * ds1) / det;
+				float g[3] = { x * e1[0] + y * e2[0], x * e1[1] + y * e2[1], x * e1[2] + y * e2[2] };
+				float d = s0[c] - Dot(g, p0);
+				q.A00 += w * g[0] * g[0]; q.A11 += w * g[1] * g[1]; q.A22 += w * g[2] * g[2];
+				q.A10 += w * g[1] * g[0]; q.A20 += w * g[2] * g[0]; q.A21 += w * g[2] * g[1];
+				q.B0 += w * d * g[0]; q.B1 += w * d * g[1]; q.B2 += w * d * g[2];
+				q.C += w * d * d;
+				q.G[c][0] += w * g[0]; q.G[c][1] += w * g[1]; q.G[c][2] += w * g[2];
+				q.D[c] += w * d;
+			}
+		}
+
+		float QuadricError(Quadric const& q, const float * p, const float * s, uint32 numAttributes)
+		{
+			double x = p[0], y = p[1], z = p[2];
+			double r = q.A00 * x * x + q.A11 * y * y + q.A22 * z * z
+				+ 2.0 * (q.A10 * x * y + q.A20 * x * z + q.A21 * y * z)
+				+ 2.0 * (q.B0 * x + q.B1 * y + q.B2 * z) + q.C;
+			for (uint32 c = 0; c < numAttributes; c++)
+				r += q.AW * s[c] * s[c] - 2.0 * s[c] * (q.G[c][0] * x + q.G[c][1] * y + q.G[c][2] * z + q.D[c]);
+			return (float)(fabs(r) / (q.W > 0.0f ? q.W : 1.0f));
+		}
+
+		struct Collapse
+		{
+			uint32	Source;
+			uint32	Target;
+			float	Error;
+
+			bool operator < (Collapse const& other) const { return Error < other.Error; }
+		};
+
+		/// state of one Simplify call, vertices are the ones of the mesh
+		class Simplifier
+		{
+		public:
+			Simplifier(MeshData const& mesh, MeshSimplifier::Options const& options,
+				const uint32 * indices, size_t numIndices);
+
+			bool		IsValid() const { return m_NumVertices != 0; }
+			/// \return the error of the worst collapse, relative and squared
+			float		Run(uint32 targetTriangles, float errorLimit);
+
+			std::vector<uint32> const&	GetIndices() const { return m_Indices; }
+			float		GetExtent() const { return m_Extent; }
+
+		private:
+			void		BuildAdjacency();
+			bool		HasEdge(uint32 a, uint32 b) const;
+			/// an edge between any vertices at the positions of 'a' and 'b'
+			bool		HasPositionEdge(uint32 a, uint32 b) const;
+			void		BuildPositionRemap(const float * positions);
+			void		ClassifyVertices(MeshSimplifier::Options const& options);
+			void		BuildQuadrics();
+			/// 'partner' and 'partnerTarget' are set for seams
+			bool		CanCollapse(uint32 source, uint32 target, uint32 & partner, uint32 & partnerTarget) const;
+			float		CollapseError(uint32 source, uint32 target, uint32 partner, uint32 partnerTarget) const;
+			bool		HasTriangleFlip(uint32 source, uint32 target) const;
+			void		RemoveDegenerates();
+
+			uint32						m_NumVertices;
+			uint32						m_NumAttributes;
+			float						m_Extent;
+			/// positions in the unit cube and attributes scaled by their weights
+			std::vector<float>			m_Positions;
+			std::vector<float>			m_Attributes;
+			std::vector<uint32>			m_Indices;
+			/// first vertex at the same position and the next one in a cycle
+			std::vector<uint32>			m_Remap;
+			std::vector<uint32>			m_Wedge;
+			std::vector<uint8>			m_Kind;
+			std::vector<Quadric>		m_Quadrics;
+			/// triangles of each vertex, rebuilt every pass
+			std::vector<uint32>			m_AdjacencyOffsets;
+			std::vector<uint32>			m_Adjacency;
+			/// target of the vertices collapsed in the current pass
+			std::vector<uint32>			m_Collapse;
+		};
+
+		Simplifier::Simplifier(MeshData const& mesh, MeshSimplifier::Options const& options,
+			const uint32 * indices, size_t numIndices)
+			: m_NumVertices(0)
+			, m_NumAttributes(0)
+			, m_Extent(1.0f)
+		{
+			VtxFormat format = mesh.GetVertexFormat();
+			uint32 stride = MeshData::GetVertexStride(format) / sizeof(float);
+			uint32 numVertices = (uint32)mesh.GetVertexNum();
+			const float * vertices = mesh.GetVertexBuffer();
+			if (!stride || MeshData::IsQuantized(format) || !numVertices || !vertices || numIndices % 3)
+				return;
+			for (size_t i = 0; i < numIndices; i++)
+			{
+				if (indices[i] >= numVertices)
+					return;
+			}
+			uint32 normalOffset = 0, uvOffset = 0;
+			switch (format)
+			{
+			case VtxFormat::POS3_F32_NOR3_F32:
+				normalOffset = 3;
+				break;
+			case VtxFormat::POS3_F32_UV2_F32:
+				uvOffset = 3;
+				break;
+			case VtxFormat::POS3_F32_NOR3_F32_UV2_F32:
+				normalOffset = 3;
+				uvOffset = 6;
+				break;
+			default:
+				break;
+			}
+			m_NumAttributes = (normalOffset ? 3 : 0) + (uvOffset ? 2 : 0);
+
+			float lo[3] = { FLT_MAX, FLT_MAX, FLT_MAX }, hi[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+			for (uint32 v = 0; v < numVertices; v++)
+			{
+				for (uint32 k = 0; k < 3; k++)
+				{
+					lo[k] = std::min(lo[k], vertices[v * stride + k]);
+					hi[k] = std::max(hi[k], vertices[v * stride + k]);
+				}
+			}
+			m_Extent = std::max(std::max(hi[0] - lo[0], hi[1] - lo[1]), hi[2] - lo[2]);
+			float scale = m_Extent > 0.0f ? 1.0f / m_Extent : 1.0f;
+			m_Positions.resize((size_t)numVertices * 3);
+			m_Attributes.resize((size_t)numVertices * m_NumAttributes);
+			for (uint32 v = 0; v < numVertices; v++)
+			{
+				const float * src = vertices + (size_t)v * stride;
+				for (uint32 k = 0; k < 3; k++)
+					m_Positions[v * 3 + k] = (src[k] - lo[k]) * scale;
+				float * attributes = m_Attributes.data() + (size_t)v * m_NumAttributes;
+				if (normalOffset)
+				{
+					for (uint32 k = 0; k < 3; k++)
+						*attributes++ = src[normalOffset + k] * options.NormalWeight;
+				}
+				if (uvOffset)
+				{
+					for (uint32 k = 0; k < 2; k++)
+						*attributes++ = src[uvOffset + k] * options.UVWeight;
+				}
+			}
+			m_NumVertices = numVertices;
+			m_Indices.assign(indices, indices + numIndices);
+			m_Collapse.resize(numVertices);
+			for (uint32 v = 0; v < numVertices; v++)
+				m_Collapse[v] = v;
+
+			BuildAdjacency();
+			BuildPositionRemap(m_Positions.data());
+			ClassifyVertices(options);
+			BuildQuadrics();
+		}
+
+		void Simplifier::BuildAdjacency()
+		{
+			m_AdjacencyOffsets.assign(m_NumVertices + 1, 0);
+			for (uint32 index : m_Indices)
+				m_AdjacencyOffsets[index + 1]++;
+			for (uint32 v = 0; v < m_NumVertices; v++)
+				m_AdjacencyOffsets[v + 1] += m_AdjacencyOffsets[v];
+			m_Adjacency.resize(m_Indices.size());
+			std::vector<uint32> fill(m_AdjacencyOffsets.begin(), m_AdjacencyOffsets.end() - 1);
+			for (size_t i = 0; i < m_Indices.size(); i++)
+				m_Adjacency[fill[m_Indices[i]]++] = (uint32)(i / 3);
+		}
+
+		bool Simplifier::HasEdge(uint32 a, uint32 b) const
+		{
+			for (uint32 j = m_AdjacencyOffsets[a]; j < m_AdjacencyOffsets[a + 1]; j++)
+			{
+				const uint32 * triangle = &m_Indices[m_Adjacency[j] * 3];
+				for (uint32 k = 0; k < 3; k++)
+				{
+					if (triangle[k] == a && triangle[(k + 1) % 3] == b)
+						return true;
+				}
+			}
+			return false;
+		}
+
+		bool Simplifier::HasPositionEdge(uint32 a, uint32 b) const
+		{
+			uint32 wa = a;
+			do
+			{
+				uint32 wb = b;
+				do
+				{
+					if (HasEdge(wa, wb))
+						return true;
+					wb = m_Wedge[wb];
+				} while (wb != b);
+				wa = m_Wedge[wa];
+			} while (wa != a);
+			return false;
+		}
+
+		void Simplifier::BuildPositionRemap(const float * positions)
+		{
+			uint32 tableSize = 1;
+			while (tableSize < m_NumVertices * 2)
+				tableSize *= 2;
+			std::vector<uint32> table(tableSize, kInvalid);
+			m_Remap.resize(m_NumVertices);
+			m_Wedge.resize(m_NumVertices);
+			for (uint32 v = 0; v < m_NumVertices; v++)
+			{
+				uint32 bits[3];
+				memcpy(bits, positions + v * 3, sizeof(bits));
+				uint32 slot = ((bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u)) & (tableSize - 1);
+				while (table[slot] != kInvalid && memcmp(positions + table[slot] * 3, bits, sizeof(bits)) != 0)
+					slot = (slot + 1) & (tableSize - 1);
+				if (table[slot] == kInvalid)
+				{
+					table[slot] = v;
+					m_Remap[v] = v;
+					m_Wedge[v] = v;
+				}
+				else
+				{
+					uint32 first = table[slot];
+					m_Remap[v] = first;
+					m_Wedge[v] = m_Wedge[first];
+					m_Wedge[first] = v;
+				}
+			}
+		}
+
+		void Simplifier::ClassifyVertices(MeshSimplifier::Options const& options)
+		{
+			std::vector<uint32> openOut(m_NumVertices, kInvalid), openIn(m_NumVertices, kInvalid);
+			// has an open edge which no other wedge closes
+			std::vector<uint8> border(m_NumVertices);
+			for (size_t i = 0; i < m_Indices.size(); i += 3)
+			{
+				for (uint32 k = 0; k < 3; k++)
+				{
+					uint32 a = m_Indices[i + k], b = m_Indices[i + (k + 1) % 3];
+					if (HasEdge(b, a))
+						continue;
+					openOut[a] = openOut[a] == kInvalid ? b : kMultiple;
+					openIn[b] = openIn[b] == kInvalid ? a : kMultiple;
+					if (!HasPositionEdge(b, a))
+						border[a] = border[b] = 1;
+				}
+			}
+			auto single = [&openOut, &openIn](uint32 v)
+			{
+				return openOut[v] < kMultiple && openIn[v] < kMultiple;
+			};
+			m_Kind.resize(m_NumVertices);
+			for (uint32 v = 0; v < m_NumVertices; v++)
+			{
+				uint32 w = m_Wedge[v];
+				EVertexKind kind = ELocked;
+				if (w == v)
+				{
+					// open edges of a single wedge end at a seam or at the wedges
+					// of a uv pole, the surface is closed around 'v'
+					if (!border[v])
+						kind = EManifold;
+					else if (single(v) && !HasPositionEdge(openOut[v], v) && !HasPositionEdge(v, openIn[v]))
+						kind = EBorder;
+				}
+				else if (m_Wedge[w] == v && single(v) && single(w)
+					&& m_Remap[openOut[v]] == m_Remap[openIn[w]] && m_Remap[openIn[v]] == m_Remap[openOut[w]])
+				{
+					kind = ESeam;
+				}
+				if ((kind == EBorder && options.LockBorder) || (kind == ESeam && options.LockSeams))
+					kind = ELocked;
+				m_Kind[v] = (uint8)kind;
+			}
+		}
+
+		void Simplifier::BuildQuadrics()
+		{
+			m_Quadrics.assign(m_NumVertices, Quadric());
+			memset(m_Quadrics.data(), 0, m_Quadrics.size() * sizeof(Quadric));
+			for (size_t i = 0; i < m_Indices.size(); i += 3)
+			{
+				uint32 i0 = m_Indices[i], i1 = m_Indices[i + 1], i2 = m_Indices[i + 2];
+				const float * p0 = &m_Positions[i0 * 3], * p1 = &m_Positions[i1 * 3], * p2 = &m_Positions[i2 * 3];
+				float e1[3], e2[3], n[3];
+				Sub(e1, p1, p0);
+				Sub(e2, p2, p0);
+				Cross(n, e1, e2);
+				float length = sqrtf(Dot(n, n));
+				if (length <= 0.0f)
+					continue;
+				n[0] /= length; n[1] /= length; n[2] /= length;
+				// weighted by the area
+				float area = length * 0.5f;
+				Quadric q;
+				memset(&q, 0, sizeof(q));
+				AddPlane(q, n, -Dot(n, p0), area);
+				if (m_NumAttributes)
+				{
+					AddAttributes(q, p0, p1, p2, &m_Attributes[i0 * m_NumAttributes], &m_Attributes[i1 * m_NumAttributes],
+						&m_Attributes[i2 * m_NumAttributes], m_NumAttributes, area);
+				}
+				AddQuadric(m_Quadrics[i0], q);
+				AddQuadric(m_Quadrics[i1], q);
+				AddQuadric(m_Quadrics[i2], q);
+
+				// planes through open edges, perpendicular to the triangle, keep borders and seams in place
+				for (uint32 k = 0; k < 3; k++)
+				{
+					uint32 a = m_Indices[i + k], b = m_Indices[i + (k + 1) % 3];
+					if (HasEdge(b, a))
+						continue;
+					float edge[3], perpendicular[3];
+					Sub(edge, &m_Positions[b * 3], &m_Positions[a * 3]);
+					Cross(perpendicular, edge, n);
+					float edgeLength = sqrtf(Dot(perpendicular, perpendicular));
+					if (edgeLength <= 0.0f)
+						continue;
+					perpendicular[0] /= edgeLength; perpendicular[1] /= edgeLength; perpendicular[2] /= edgeLength;
+					float weight = edgeLength * edgeLength * (HasPositionEdge(b, a) ? 1.0f : kBorderWeight);
+					Quadric edgeQuadric;
+					memset(&edgeQuadric, 0, sizeof(edgeQuadric));
+					AddPlane(edgeQuadric, perpendicular, -Dot(perpendicular, &m_Positions[a * 3]), weight);
+					AddQuadric(m_Quadrics[a], edgeQuadric);
+					AddQuadric(m_Quadrics[b], edgeQuadric);
+				}
+			}
+		}
+
+		bool Simplifier::CanCollapse(uint32 source, uint32 target, uint32 & partner, uint32 & partnerTarget) const
+		{
+			partner = partnerTarget = kInvalid;
+			EVertexKind kind = (EVertexKind)m_Kind[source], targetKind = (EVertexKind)m_Kind[target];
+			// onto one wedge of several the triangles of the others would take its attributes
+			if (kind == EManifold)
+				return m_Wedge[target] == target;
+			if (kind == ELocked || (targetKind != kind && targetKind != ELocked))
+				return false;
+			bool forward = HasEdge(source, target), backward = HasEdge(target, source);
+			// borders and seams move along their open edges only
+			if (forward == backward)
+				return false;
+			bool closedByPosition = forward ? HasPositionEdge(target, source) : HasPositionEdge(source, target);
+			if (kind == EBorder)
+				return !closedByPosition;
+			if (!closedByPosition)
+				return false;
+			// the vertex at the target position the other side of the seam is connected to
+			partner = m_Wedge[source];
+			uint32 candidate = target;
+			do
+			{
+				if (candidate != partner && (HasEdge(partner, candidate) || HasEdge(candidate, partner)))
+				{
+					partnerTarget = candidate;
+					return true;
+				}
+				candidate = m_Wedge[candidate];
+			} while (candidate != target);
+			return false;
+		}
+
+		float Simplifier::CollapseError(uint32 source, uint32 target, uint32 partner, uint32 partnerTarget) const
+		{
+			float error = QuadricError(m_Quadrics[source], &m_Positions[target * 3],
+				m_NumAttributes ? &m_Attributes[target * m_NumAttributes] : nullptr, m_NumAttributes);
+			if (partner != kInvalid)
+			{
+				error += QuadricError(m_Quadrics[partner], &m_Positions[partnerTarget * 3],
+					m_NumAttributes ? &m_Attributes[partnerTarget * m_NumAttributes] : nullptr, m_NumAttributes);
+			}
+			return error;
+		}
+
+		bool Simplifier::HasTriangleFlip(uint32 source, uint32 target) const
+		{
+			const float * moved = &m_Positions[target * 3];
+			for (uint32 j = m_AdjacencyOffsets[source]; j < m_AdjacencyOffsets[source + 1]; j++)
+			{
+				const uint32 * triangle = &m_Indices[m_Adjacency[j] * 3];
+				uint32 corners[3] = { m_Collapse[triangle[0]], m_Collapse[triangle[1]], m_Collapse[triangle[2]] };
+				// the triangles on the edge disappear, also those on another
+				// wedge of the target
+				uint32 position = m_Remap[target];
+				if (m_Remap[corners[0]] == position || m_Remap[corners[1]] == position || m_Remap[corners[2]] == position)
+					continue;
+				uint32 k = corners[0] == source ? 0 : corners[1] == source ? 1 : 2;
+				const float * p0 = &m_Positions[corners[k] * 3];
+				const float * p1 = &m_Positions[corners[(k + 1) % 3] * 3];
+				const float * p2 = &m_Positions[corners[(k + 2) % 3] * 3];
+				float e1[3], e2[3], before[3], after[3];
+				Sub(e1, p1, p0);
+				Sub(e2, p2, p0);
+				Cross(before, e1, e2);
+				Sub(e1, p1, moved);
+				Sub(e2, p2, moved);
+				Cross(after, e1, e2);
+				if (Dot(before, after) <= 0.0f)
+					return true;
+			}
+			return false;
+		}
+
+		void Simplifier::RemoveDegenerates()
+		{
+			size_t write = 0;
+			for (size_t i = 0; i < m_Indices.size(); i += 3)
+			{
+				uint32 a = m_Collapse[m_Indices[i]], b = m_Collapse[m_Indices[i + 1]], c = m_Collapse[m_Indices[i + 2]];
+				// corners on different wedges of a position leave no area either
+				if (m_Remap[a] == m_Remap[b] || m_Remap[b] == m_Remap[c] || m_Remap[c] == m_Remap[a])
+					continue;
+				m_Indices[write++] = a;
+				m_Indices[write++] = b;
+				m_Indices[write++] = c;
+			}
+			m_Indices.resize(write);
+			for (uint32 v = 0; v < m_NumVertices; v++)
+				m_Collapse[v] = v;
+		}
+
+		float Simplifier::Run(uint32 targetTriangles, float errorLimit)
+		{
+			float maxError = 0.0f;
+			std::vector<Collapse> collapses;
+			std::vector<uint8> locked(m_NumVertices);
+			while (m_Indices.size() / 3 > targetTriangles)
+			{
+				collapses.clear();
+				for (size_t i = 0; i < m_Indices.size(); i += 3)
+				{
+					for (uint32 k = 0; k < 3; k++)
+					{
+						uint32 a = m_Indices[i + k], b = m_Indices[i + (k + 1) % 3];
+						// inner edges come up twice
+						if (a > b && HasEdge(b, a))
+							continue;
+						Collapse best = { kInvalid, kInvalid, FLT_MAX };
+						uint32 partner, partnerTarget;
+						if (CanCollapse(a, b, partner, partnerTarget))
+							best = { a, b, CollapseError(a, b, partner, partnerTarget) };
+						if (CanCollapse(b, a, partner, partnerTarget))
+						{
+							float error = CollapseError(b, a, partner, partnerTarget);
+							if (error < best.Error)
+								best = { b, a, error };
+						}
+						if (best.Source != kInvalid)
+							collapses.push_back(best);
+					}
+				}
+				if (collapses.empty())
+					break;
+				std::sort(collapses.begin(), collapses.end());
+
+				// a collapse removes two triangles, one on borders
+				size_t goal = std::max<size_t>((m_Indices.size() / 3 - targetTriangles) / 2, 1);
+				std::fill(locked.begin(), locked.end(), 0);
+				size_t performed = 0, flipped = 0;
+				for (auto const& collapse : collapses)
+				{
+					// collapses which flip triangles stay in the list, they don't count against the goal
+					float errorGoal = collapses[std::min(goal + flipped, collapses.size() - 1)].Error * kPassErrorSlack;
+					if (collapse.Error > errorLimit || performed >= goal || (performed > goal / 10 && collapse.Error > errorGoal))
+						break;
+					uint32 source = collapse.Source, target = collapse.Target;
+					// the neighbourhood changed, this pass leaves it alone
+					if (locked[m_Remap[source]] || locked[m_Remap[target]])
+						continue;
+					uint32 partner, partnerTarget;
+					CanCollapse(source, target, partner, partnerTarget);
+					if (HasTriangleFlip(source, target) || (partner != kInvalid && HasTriangleFlip(partner, partnerTarget)))
+					{
+						flipped++;
+						continue;
+					}
+					m_Collapse[source] = target;
+					AddQuadric(m_Quadrics[target], m_Quadrics[source]);
+					if (partner != kInvalid)
+					{
+						m_Collapse[partner] = partnerTarget;
+						AddQuadric(m_Quadrics[partnerTarget], m_Quadrics[partner]);
+					}
+					locked[m_Remap[source]] = locked[m_Remap[target]] = 1;
+					maxError = std::max(maxError, collapse.Error);
+					performed++;
+				}
+				if (!performed)
+					break;
+				RemoveDegenerates();
+				BuildAdjacency();
+			}
+			return maxError;
+		}
+	}
+
+	namespace MeshSimplifier
+	{
+		size_t Simplify(uint32 * dst, const uint32 * indices, size_t numIndices, MeshData const& mesh,
+			Options const& options, Result * result)
+		{
+			Simplifier simplifier(mesh, options, indices, numIndices);
+			if (!simplifier.IsValid())
+				return 0;
+			float limit = options.TargetError * options.TargetError;
+			float error = simplifier.Run(options.TargetTriangles, limit);
+			auto const& simplified = simplifier.GetIndices();
+			std::copy(simplified.begin(), simplified.end(), dst);
+			if (result)
+			{
+				result->NumTriangles = (uint32)simplified.size() / 3;
+				result->Error = sqrtf(error) * simplifier.GetExtent();
+			}
+			return simplified.size();
+		}
+	}
+
+	MeshLodData::MeshLodData()
+		: m_NumVertices(0)
+	{
+		memset(m_MeshName, 0, sizeof(m_MeshName));
+	}
+
+	bool MeshLodData::Build(MeshData const& mesh, BuildOptions const& options)
+	{
+		VtxFormat format = mesh.GetVertexFormat();
+		if (mesh.GetPrimType() != PrimType::TRIANGLES || !mesh.GetIndexBuffer() || !mesh.GetVertexBuffer()
+			|| !MeshData::GetVertexStride(format) || MeshData::IsQuantized(format))
+			return false;
+		strncpy(m_MeshName, mesh.Name(), sizeof(m_MeshName) - 1);
+		m_NumVertices = (uint32)mesh.GetVertexNum();
+		m_Indices.assign(mesh.GetIndexBuffer(), mesh.GetIndexBuffer() + mesh.GetIndexNum());
+		m_Lods.clear();
+		m_Lods.push_back({ 0, (uint32)m_Indices.size(), 0.0f });
+
+		std::vector<uint32> current(m_Indices), next(m_Indices.size()), optimized;
+		float error = 0.0f;
+		for (uint32 lod = 1; lod < options.MaxLods; lod++)
+		{
+			uint32 numTriangles = (uint32)current.size() / 3;
+			MeshSimplifier::Options simplify = options.Simplify;
+			simplify.TargetTriangles = (uint32)(numTriangles * options.Ratio);
+			if (simplify.TargetTriangles < options.MinTriangles)
+				break;
+			MeshSimplifier::Result result;
+			size_t numIndices = MeshSimplifier::Simplify(next.data(), current.data(), current.size(), mesh, simplify, &result);
+			if (!numIndices || numIndices > current.size() * (1.0f - kMinLodReduction))
+				break;
+			// each step deviates from the one before, not from the mesh
+			error += result.Error;
+			optimized.resize(numIndices);
+			MeshOptimizer::OptimizeVertexCache(optimized.data(), next.data(), numIndices, m_NumVertices);
+			m_Lods.push_back({ (uint32)m_Indices.size(), (uint32)numIndices, error });
+			m_Indices.insert(m_Indices.end(), optimized.begin(), optimized.end());
+			current.swap(optimized);
+		}
+		return true;
+	}
+
+	bool MeshLodData::Load(const kByte * data, uint64 size)
+	{
+		uint64 pos = 0;
+		auto read = [data, size, &pos](void * dst, uint64 bytes)
+		{
+			if (pos + bytes > size)
+				return false;
+			memcpy(dst, data + pos, (size_t)bytes);
+			pos += bytes;
+			return true;
+		};
+		EMeshLodVersion version = EMeshLodVersion::VERSION_1_0;
+		uint32 numLods = 0, numIndices = 0;
+		if (!read(&version, sizeof(version)) || version != EMeshLodVersion::VERSION_1_0)
+			return false;
+		// the class name, see operator <<
+		pos += 64;
+		if (!read(m_MeshName, sizeof(m_MeshName)) || !read(&m_NumVertices, sizeof(m_NumVertices))
+			|| !read(&numLods, sizeof(numLods)) || !read(&numIndices, sizeof(numIndices)))
+			return false;
+		m_MeshName[sizeof(m_MeshName) - 1] = 0;
+		if (pos + (uint64)numLods * sizeof(MeshLod) + (uint64)numIndices * sizeof(uint32) > size)
+			return false;
+		m_Lods.resize(numLods);
+		m_Indices.resize(numIndices);
+		read(m_Lods.data(), numLods * sizeof(MeshLod));
+		read(m_Indices.data(), numIndices * sizeof(uint32));
+
+		bool ok = true;
+		for (auto const& lod : m_Lods)
+			ok = ok && lod.IndexCount % 3 == 0 && (uint64)lod.IndexOffset + lod.IndexCount <= numIndices;
+		for (uint32 i = 0; ok && i < numIndices; i++)
+			ok = m_Indices[i] < m_NumVertices;
+		if (!ok)
+		{
+			m_Lods.clear();
+			m_Indices.clear();
+		}
+		return ok;
+	}
+
+	std::shared_ptr<MeshLodData> MeshLodData::CreateFromChunk(AssetChunkView const& chunk, Dispatch::ThreadPool * workers)
+	{
+		if (chunk.Type != EAssetType::EMeshLods)
+			return nullptr;
+		auto lods = std::make_shared<MeshLodData>();
+		if (chunk.Compression == EChunkCompression::ENone)
+			return lods->Load(chunk.Data, chunk.Size) ? lods : nullptr;
+		std::vector<kByte> decoded((size_t)chunk.RawSize);
+		if (!AssetBundleReader::Decode(chunk, decoded.data(), workers)
+			|| !lods->Load(decoded.data(), decoded.size()))
+			return nullptr;
+		return lods;
+	}
+
+	std::string MeshLodData::ChunkName(const char * meshName)
+	{
+		return std::string(meshName) + ".lods";
+	}
+
+	float MeshLodData::ProjectionScale(float fovY, float viewportHeight)
+	{
+		return viewportHeight / (2.0f * tanf(kMath::ToRadian(fovY * 0.5f)));
+	}
+
+	float MeshLodData::GetScreenError(uint32 lod, float distance, float projectionScale) const
+	{
+		return m_Lods[lod].Error * projectionScale / std::max(distance, FLT_MIN);
+	}
+
+	uint32 MeshLodData::SelectLod(float distance, float projectionScale, float maxPixelError) const
+	{
+		for (uint32 lod = GetLodNum(); lod > 1; lod--)
+		{
+			if (GetScreenError(lod - 1, distance, projectionScale) <= maxPixelError)
+				return lod - 1;
+		}
+		return 0;
+	}
+
+	Archive & operator << (Archive & arch, const MeshLodData & lods)
+	{
+		char className[64] = {};
+		strncpy(className, "MeshLodData", 63);
+		arch.ArrayIn(className, 64);
+		arch.ArrayIn(lods.m_MeshName, 96);
+
+		arch << lods.m_NumVertices;
+		arch << (uint32)lods.m_Lods.size();
+		arch << (uint32)lods.m_Indices.size();
+
+		arch.ArrayIn(lods.m_Lods.data(), lods.m_Lods.size());
+		arch.ArrayIn(lods.m_Indices.data(), lods.m_Indices.size());
+		return arch;
+	}
+
+	void BuildMeshLods(std::shared_ptr<MeshData> const * meshes, SpMeshLods * lods, uint32 count,
+		MeshLodData::BuildOptions const& options, Dispatch::ThreadPool * workers)
+	{
+		Dispatch::ThreadPool & pool = workers ? *workers : Dispatch::ThreadPool::Global();
+		pool.ParallelFor(0, count, 1, [meshes, lods, &options](uint32 begin, uint32 end)
+		{
+			for (uint32 i = begin; i < end; i++)
+			{
+				auto chain = std::make_shared<MeshLodData>();
+				lods[i] = meshes[i] && chain->Build(*meshes[i], options) ? chain : nullptr;
+			}
+		});
+	}
+}
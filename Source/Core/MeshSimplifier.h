@@ -0,0 +1,147 @@
+#ifndef __MeshSimplifier_h__
+#define __MeshSimplifier_h__
+#pragma once
+
+#include "Bundle.h"
+
+namespace k3d
+{
+	class MeshData;
+
+	/// Quadric error edge collapse (Garland and Heckbert, "Surface
+	/// Simplification Using Quadric Error Metrics") with the attribute
+	/// quadrics of Hoppe, "New Quadric Metric for Simplifying Meshes with
+	/// Appearance Attributes". Vertices are collapsed onto existing ones, so
+	/// the simplified index lists share the vertex buffer of the mesh.
+	namespace MeshSimplifier
+	{
+		struct Options
+		{
+			/// stop at this many triangles or below
+			uint32	TargetTriangles;
+			/// stop before a collapse would exceed this error, relative to the
+			/// largest extent of the mesh
+			float	TargetError;
+			/// error of a unit normal (or uv) change against a relative position change
+			float	NormalWeight;
+			float	UVWeight;
+			/// open edges keep their vertices, otherwise they only collapse along the border
+			bool	LockBorder;
+			/// vertices split by differing normals or uvs keep their position,
+			/// otherwise both sides collapse along the seam together
+			bool	LockSeams;
+
+			Options()
+				: TargetTriangles(0)
+				, TargetError(0.01f)
+				, NormalWeight(0.5f)
+				, UVWeight(0.5f)
+				, LockBorder(false)
+				, LockSeams(false)
+			{
+			}
+		};
+
+		struct Result
+		{
+			uint32	NumTriangles;
+			/// deviation of the result in mesh units, the attributes included
+			float	Error;
+		};
+
+		/// \param dst numIndices indices at most, may alias 'indices'
+		/// \param mesh the float vertices 'indices' refer to
+		/// \return number of indices in 'dst', 0 if the mesh has no float vertex format
+		K3D_API size_t	Simplify(uint32 * dst, const uint32 * indices, size_t numIndices, MeshData const& mesh,
+							Options const& options, Result * result = nullptr);
+	}
+
+	enum class EMeshLodVersion : uint64
+	{
+		VERSION_1_0 = 201610u
+	};
+
+	struct MeshLod
+	{
+		/// first entry in the index list of MeshLodData
+		uint32	IndexOffset;
+		uint32	IndexCount;
+		/// deviation from the full mesh in mesh units, see MeshLodData::GetScreenError
+		float	Error;
+	};
+
+	/// \brief index lists of a mesh at decreasing detail, all of them index its
+	/// vertex buffer. LOD 0 is the mesh itself. Stored in a bundle as an
+	/// EMeshLods chunk next to the mesh, see ChunkName; like meshlets they
+	/// have to be rebuilt when the mesh is reordered.
+	class K3D_API MeshLodData
+	{
+	public:
+		struct BuildOptions
+		{
+			uint32	MaxLods;
+			/// triangles of each LOD against the one before
+			float	Ratio;
+			/// no LOD gets fewer triangles
+			uint32	MinTriangles;
+			/// Simplify.TargetError is the error limit of every step, its
+			/// TargetTriangles is overridden
+			MeshSimplifier::Options	Simplify;
+
+			BuildOptions()
+				: MaxLods(8)
+				, Ratio(0.5f)
+				, MinTriangles(64)
+			{
+			}
+		};
+
+		MeshLodData();
+
+		/// Simplifies each LOD from the one before, the index lists are
+		/// optimized for the vertex cache. Stops early when the error limit
+		/// prevents a reduction.
+		/// \return false if the mesh has no triangle list of float vertices
+		bool		Build(MeshData const& mesh, BuildOptions const& options = BuildOptions());
+
+		/// Reads a serialized LOD chain (EMeshLodVersion, LOD chain).
+		/// \return false if 'data' is truncated or indexes out of its bounds
+		bool		Load(const kByte * data, uint64 size);
+		/// \return null if the chunk is no valid LOD chain
+		static std::shared_ptr<MeshLodData>	CreateFromChunk(AssetChunkView const& chunk, Dispatch::ThreadPool * workers = nullptr);
+		/// name of the LOD chunk of the mesh 'meshName'
+		static std::string	ChunkName(const char * meshName);
+
+		/// pixels per mesh unit at distance 1, viewportHeight / (2 tan(fovY / 2))
+		/// \param fovY in degrees, like BaseCamera::SetProjection
+		static float	ProjectionScale(float fovY, float viewportHeight);
+		/// projected error of 'lod' in pixels
+		float			GetScreenError(uint32 lod, float distance, float projectionScale) const;
+		/// the coarsest LOD within 'maxPixelError' at 'distance'
+		uint32			SelectLod(float distance, float projectionScale, float maxPixelError = 1.0f) const;
+
+		const char *		Name() const { return m_MeshName; }
+		uint32				GetLodNum() const { return (uint32)m_Lods.size(); }
+		const MeshLod *		GetLods() const { return m_Lods.data(); }
+		const uint32 *		GetIndices() const { return m_Indices.data(); }
+		uint32				GetVertexNum() const { return m_NumVertices; }
+
+		friend K3D_API class Archive& operator << (class Archive & arch, const MeshLodData & lods);
+
+	private:
+		char					m_MeshName[96];
+		uint32					m_NumVertices;
+		std::vector<MeshLod>	m_Lods;
+		std::vector<uint32>		m_Indices;
+	};
+
+	typedef std::shared_ptr<MeshLodData> SpMeshLods;
+
+	/// Builds the LOD chains of 'count' meshes in parallel, one mesh per task.
+	/// \param lods receives a chain per mesh, null where Build failed
+	/// \param workers the global pool if null
+	K3D_API void	BuildMeshLods(std::shared_ptr<MeshData> const * meshes, SpMeshLods * lods, uint32 count,
+						MeshLodData::BuildOptions const& options = MeshLodData::BuildOptions(), Dispatch::ThreadPool * workers = nullptr);
+}
+
+#endif
@@ -0,0 +1,467 @@
+#include "Kaleido3D.h"
+#include "Meshlet.h"
+#include "MeshData.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+namespace k3d
+{
+	namespace
+	{
+		const uint32 kInvalid = ~0u;
+		/// ConeCutoff of meshlets whose triangles can't be culled together
+		const float kNoCone = 2.0f;
+		/// how much a triangle facing off the meshlet's normals may cost, in
+		/// vertices it adds, tighter cones cull more
+		const float kConeWeight = 0.5f;
+
+		inline void Sub(float * r, const float * a, const float * b)
+		{
+			r[0] = a[0] - b[0]; r[1] = a[1] - b[1]; r[2] = a[2] - b[2];
+		}
+
+		inline float Dot(const float * a, const float * b)
+		{
+			return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+		}
+
+		inline float Normalize(float * v)
+		{
+			float length = sqrtf(Dot(v, v));
+			if (length > 0.0f)
+			{
+				v[0] /= length; v[1] /= length; v[2] /= length;
+			}
+			return length;
+		}
+	}
+
+	MeshletData::MeshletData()
+		: m_MaxVertices(kMaxVertices)
+		, m_MaxTriangles(kMaxTriangles)
+	{
+		memset(m_MeshName, 0, sizeof(m_MeshName));
+	}
+
+	bool MeshletData::Build(MeshData const& mesh, uint32 maxVertices, uint32 maxTriangles)
+	{
+		uint32 stride = MeshData::GetVertexStride(mesh.GetVertexFormat());
+		if (mesh.GetPrimType() != PrimType::TRIANGLES || !mesh.GetIndexBuffer() || !mesh.GetVertexBuffer() || !stride
+			|| MeshData::IsQuantized(mesh.GetVertexFormat()))
+			return false;
+		// local indices are 8 bit, a triangle needs 3 new vertices at most
+		maxVertices = std::min(std::max(maxVertices, 3u), 256u);
+		maxTriangles = std::max(maxTriangles, 1u);
+
+		strncpy(m_MeshName, mesh.Name(), sizeof(m_MeshName) - 1);
+		m_MaxVertices = maxVertices;
+		m_MaxTriangles = maxTriangles;
+		m_Meshlets.clear();
+		m_Bounds.clear();
+		m_Vertices.clear();
+		m_Triangles.clear();
+
+		const uint32 * indices = mesh.GetIndexBuffer();
+		uint32 numTriangles = (uint32)mesh.GetIndexNum() / 3;
+		uint32 numVertices = (uint32)mesh.GetVertexNum();
+		const kByte * positions = (const kByte*)mesh.GetVertexBuffer();
+		for (uint32 i = 0; i < numTriangles * 3; i++)
+		{
+			if (indices[i] >= numVertices)
+				return false;
+		}
+		m_Triangles.reserve(numTriangles * 3);
+
+		// triangles of every vertex, the first live[v] of a vertex are not in a meshlet yet
+		std::vector<uint32> offsets(numVertices + 1, 0), adjacency(numTriangles * 3), live(numVertices, 0);
+		for (uint32 i = 0; i < numTriangles * 3; i++)
+			live[indices[i]]++;
+		for (uint32 v = 0; v < numVertices; v++)
+			offsets[v + 1] = offsets[v] + live[v];
+		std::vector<uint32> fill(offsets.begin(), offsets.end() - 1);
+		for (uint32 i = 0; i < numTriangles * 3; i++)
+			adjacency[fill[indices[i]]++] = i / 3;
+		std::vector<float> normals(numTriangles * 3);
+		for (uint32 t = 0; t < numTriangles; t++)
+		{
+			const float * p0 = (const float*)(positions + (size_t)indices[t * 3] * stride);
+			float e1[3], e2[3], * n = &normals[t * 3];
+			Sub(e1, (const float*)(positions + (size_t)indices[t * 3 + 1] * stride), p0);
+			Sub(e2, (const float*)(positions + (size_t)indices[t * 3 + 2] * stride), p0);
+			n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+			n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+			n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+			Normalize(n);
+		}
+
+		// index of every mesh vertex in the meshlet being filled
+		std::vector<uint32> local(numVertices, kInvalid);
+		std::vector<bool> emitted(numTriangles, false);
+		Meshlet meshlet = {};
+		float coneSum[3] = {};
+		uint32 seed = 0, next = kInvalid;
+		auto newVertices = [&](uint32 t)
+		{
+			const uint32 * triangle = indices + t * 3;
+			return (uint32)(local[triangle[0]] == kInvalid)
+				+ (local[triangle[1]] == kInvalid && triangle[1] != triangle[0])
+				+ (local[triangle[2]] == kInvalid && triangle[2] != triangle[0] && triangle[2] != triangle[1]);
+		};
+		auto flush = [&]()
+		{
+			AddMeshlet(meshlet, positions, stride);
+			// the next meshlet starts next to this one, at the triangle with the
+			// fewest free neighbors, so the free area stays in one piece
+			next = kInvalid;
+			uint32 fewest = ~0u;
+			for (uint32 i = 0; i < meshlet.VertexCount; i++)
+			{
+				uint32 v = m_Vertices[meshlet.VertexOffset + i];
+				local[v] = kInvalid;
+				for (uint32 a = 0; a < live[v]; a++)
+				{
+					uint32 t = adjacency[offsets[v] + a];
+					uint32 neighbors = live[indices[t * 3]] + live[indices[t * 3 + 1]] + live[indices[t * 3 + 2]];
+					if (neighbors < fewest)
+					{
+						next = t;
+						fewest = neighbors;
+					}
+				}
+			}
+			meshlet.VertexOffset = (uint32)m_Vertices.size();
+			meshlet.TriangleOffset = (uint32)m_Triangles.size();
+			meshlet.VertexCount = 0;
+			meshlet.TriangleCount = 0;
+			coneSum[0] = coneSum[1] = coneSum[2] = 0.0f;
+		};
+		for (;;)
+		{
+			// grow over the triangles next to the meshlet, the ones adding the
+			// fewest vertices and facing the way the meshlet does come first
+			float axis[3] = { coneSum[0], coneSum[1], coneSum[2] };
+			Normalize(axis);
+			uint32 best = kInvalid;
+			float bestScore = FLT_MAX;
+			for (uint32 i = 0; i < meshlet.VertexCount; i++)
+			{
+				uint32 v = m_Vertices[meshlet.VertexOffset + i];
+				for (uint32 a = 0; a < live[v]; a++)
+				{
+					uint32 t = adjacency[offsets[v] + a];
+					uint32 extra = newVertices(t);
+					if (meshlet.VertexCount + extra > maxVertices)
+						continue;
+					// a triangle which is the last free one of a vertex would
+					// be left behind alone, it goes first
+					const uint32 * triangle = indices + t * 3;
+					if (live[triangle[0]] == 1 || live[triangle[1]] == 1 || live[triangle[2]] == 1)
+						extra = 0;
+					float score = extra + kConeWeight * (1.0f - Dot(&normals[t * 3], axis));
+					if (score < bestScore)
+					{
+						best = t;
+						bestScore = score;
+					}
+				}
+			}
+			if (best == kInvalid)
+			{
+				// the vertices are used up or the meshlet has no neighbors left,
+				// without a neighbor the next one starts at the first free
+				// triangle in index order
+				if (meshlet.TriangleCount)
+					flush();
+				if (next != kInvalid)
+				{
+					best = next;
+				}
+				else
+				{
+					while (seed < numTriangles && emitted[seed])
+						seed++;
+					if (seed == numTriangles)
+						break;
+					best = seed;
+				}
+			}
+
+			const uint32 * triangle = indices + best * 3;
+			for (uint32 k = 0; k < 3; k++)
+			{
+				uint32 & v = local[triangle[k]];
+				if (v == kInvalid)
+				{
+					v = meshlet.VertexCount++;
+					m_Vertices.push_back(triangle[k]);
+				}
+				m_Triangles.push_back((uint8)v);
+				// out of the live triangles of its vertices
+				uint32 * first = &adjacency[offsets[triangle[k]]];
+				for (uint32 a = 0; a < live[triangle[k]]; a++)
+				{
+					if (first[a] == best)
+					{
+						std::swap(first[a], first[--live[triangle[k]]]);
+						break;
+					}
+				}
+			}
+			emitted[best] = true;
+			for (uint32 k = 0; k < 3; k++)
+				coneSum[k] += normals[best * 3 + k];
+			if (++meshlet.TriangleCount == maxTriangles)
+				flush();
+		}
+		return true;
+	}
+
+	void MeshletData::AddMeshlet(Meshlet const& meshlet, const kByte * positions, uint32 stride)
+	{
+		auto position = [&](uint32 v) -> const float *
+		{
+			return (const float*)(positions + (size_t)m_Vertices[meshlet.VertexOffset + v] * stride);
+		};
+		MeshletBounds bounds = {};
+
+		// Ritter's sphere, started from the pair of vertices farthest apart
+		// along one axis and grown to take in the others
+		uint32 minVertex[3] = {}, maxVertex[3] = {};
+		for (uint32 v = 1; v < meshlet.VertexCount; v++)
+		{
+			for (uint32 axis = 0; axis < 3; axis++)
+			{
+				if (position(v)[axis] < position(minVertex[axis])[axis])
+					minVertex[axis] = v;
+				if (position(v)[axis] > position(maxVertex[axis])[axis])
+					maxVertex[axis] = v;
+			}
+		}
+		float span = -1.0f, d[3];
+		for (uint32 axis = 0; axis < 3; axis++)
+		{
+			Sub(d, position(maxVertex[axis]), position(minVertex[axis]));
+			if (Dot(d, d) > span)
+			{
+				span = Dot(d, d);
+				for (uint32 k = 0; k < 3; k++)
+					bounds.Center[k] = (position(maxVertex[axis])[k] + position(minVertex[axis])[k]) * 0.5f;
+				bounds.Radius = sqrtf(span) * 0.5f;
+			}
+		}
+		for (uint32 v = 0; v < meshlet.VertexCount; v++)
+		{
+			Sub(d, position(v), bounds.Center);
+			float distance = sqrtf(Dot(d, d));
+			if (distance > bounds.Radius)
+			{
+				float radius = (bounds.Radius + distance) * 0.5f;
+				for (uint32 k = 0; k < 3; k++)
+					bounds.Center[k] += d[k] * (radius - bounds.Radius) / distance;
+				bounds.Radius = radius;
+			}
+		}
+
+		// the cone axis is the mean normal, the cutoff follows from the normal
+		// farthest from it
+		const uint8 * triangles = m_Triangles.data() + meshlet.TriangleOffset;
+		std::vector<float> normals(meshlet.TriangleCount * 3);
+		for (uint32 t = 0; t < meshlet.TriangleCount; t++)
+		{
+			const float * p0 = position(triangles[t * 3]);
+			float e1[3], e2[3], * n = &normals[t * 3];
+			Sub(e1, position(triangles[t * 3 + 1]), p0);
+			Sub(e2, position(triangles[t * 3 + 2]), p0);
+			n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+			n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+			n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+			Normalize(n);
+			for (uint32 k = 0; k < 3; k++)
+				bounds.ConeAxis[k] += n[k];
+		}
+		float minDot = 1.0f;
+		if (Normalize(bounds.ConeAxis) > 0.0f)
+		{
+			for (uint32 t = 0; t < meshlet.TriangleCount; t++)
+			{
+				const float * n = &normals[t * 3];
+				// degenerate triangles are never drawn
+				if (Dot(n, n) > 0.0f)
+					minDot = std::min(minDot, Dot(n, bounds.ConeAxis));
+			}
+		}
+		else
+		{
+			minDot = 0.0f;
+		}
+		// the apex would move far away for wider cones, which barely cull anyway
+		if (minDot <= 0.1f)
+		{
+			memcpy(bounds.ConeApex, bounds.Center, sizeof(bounds.ConeApex));
+			bounds.ConeCutoff = kNoCone;
+		}
+		else
+		{
+			// the apex lies behind the planes of all triangles, a viewer who
+			// sees it from within the cone sees the back of every triangle
+			float offset = 0.0f;
+			for (uint32 t = 0; t < meshlet.TriangleCount; t++)
+			{
+				const float * n = &normals[t * 3];
+				float toCenter[3];
+				Sub(toCenter, bounds.Center, position(triangles[t * 3]));
+				float facing = Dot(bounds.ConeAxis, n);
+				if (facing > 0.0f)
+					offset = std::max(offset, Dot(toCenter, n) / facing);
+			}
+			for (uint32 k = 0; k < 3; k++)
+				bounds.ConeApex[k] = bounds.Center[k] - bounds.ConeAxis[k] * offset;
+			bounds.ConeCutoff = sqrtf(1.0f - minDot * minDot);
+		}
+
+		m_Meshlets.push_back(meshlet);
+		m_Bounds.push_back(bounds);
+	}
+
+	bool MeshletData::Load(const kByte * data, uint64 size)
+	{
+		uint64 pos = 0;
+		auto read = [data, size, &pos](void * dst, uint64 bytes)
+		{
+			if (pos + bytes > size)
+				return false;
+			memcpy(dst, data + pos, (size_t)bytes);
+			pos += bytes;
+			return true;
+		};
+		EMeshletVersion version = EMeshletVersion::VERSION_1_0;
+		uint32 numMeshlets = 0, numVertices = 0, numTriangleBytes = 0;
+		if (!read(&version, sizeof(version)) || version != EMeshletVersion::VERSION_1_0)
+			return false;
+		// the class name, see operator <<
+		pos += 64;
+		if (!read(m_MeshName, sizeof(m_MeshName))
+			|| !read(&m_MaxVertices, sizeof(m_MaxVertices)) || !read(&m_MaxTriangles, sizeof(m_MaxTriangles))
+			|| !read(&numMeshlets, sizeof(numMeshlets)) || !read(&numVertices, sizeof(numVertices))
+			|| !read(&numTriangleBytes, sizeof(numTriangleBytes)))
+			return false;
+		m_MeshName[sizeof(m_MeshName) - 1] = 0;
+		uint64 arrayBytes = (uint64)numMeshlets * (sizeof(Meshlet) + sizeof(MeshletBounds))
+			+ (uint64)numVertices * sizeof(uint32) + numTriangleBytes;
+		if (pos + arrayBytes > size || m_MaxVertices > 256)
+			return false;
+		m_Meshlets.resize(numMeshlets);
+		m_Bounds.resize(numMeshlets);
+		m_Vertices.resize(numVertices);
+		m_Triangles.resize(numTriangleBytes);
+		read(m_Meshlets.data(), numMeshlets * sizeof(Meshlet));
+		read(m_Bounds.data(), numMeshlets * sizeof(MeshletBounds));
+		read(m_Vertices.data(), numVertices * sizeof(uint32));
+		read(m_Triangles.data(), numTriangleBytes);
+
+		for (auto const& meshlet : m_Meshlets)
+		{
+			bool ok = meshlet.VertexCount <= m_MaxVertices && meshlet.TriangleCount <= m_MaxTriangles
+				&& (uint64)meshlet.VertexOffset + meshlet.VertexCount <= numVertices
+				&& (uint64)meshlet.TriangleOffset + meshlet.TriangleCount * 3ull <= numTriangleBytes;
+			for (uint32 i = 0; ok && i < meshlet.TriangleCount * 3; i++)
+				ok = m_Triangles[meshlet.TriangleOffset + i] < meshlet.VertexCount;
+			if (!ok)
+			{
+				m_Meshlets.clear();
+				m_Bounds.clear();
+				m_Vertices.clear();
+				m_Triangles.clear();
+				return false;
+			}
+		}
+		return true;
+	}
+
+	std::shared_ptr<MeshletData> MeshletData::CreateFromChunk(AssetChunkView const& chunk, Dispatch::ThreadPool * workers)
+	{
+		if (chunk.Type != EAssetType::EMeshlets)
+			return nullptr;
+		auto meshlets = std::make_shared<MeshletData>();
+		if (chunk.Compression == EChunkCompression::ENone)
+			return meshlets->Load(chunk.Data, chunk.Size) ? meshlets : nullptr;
+		std::vector<kByte> decoded((size_t)chunk.RawSize);
+		if (!AssetBundleReader::Decode(chunk, decoded.data(), workers)
+			|| !meshlets->Load(decoded.data(), decoded.size()))
+			return nullptr;
+		return meshlets;
+	}
+
+	std::string MeshletData::ChunkName(const char * meshName)
+	{
+		return std::string(meshName) + ".meshlets";
+	}
+
+	Archive & operator << (Archive & arch, const MeshletData & meshlets)
+	{
+		char className[64] = {};
+		strncpy(className, "MeshletData", 63);
+		arch.ArrayIn(className, 64);
+		arch.ArrayIn(meshlets.m_MeshName, 96);
+
+		arch << meshlets.m_MaxVertices;
+		arch << meshlets.m_MaxTriangles;
+		arch << (uint32)meshlets.m_Meshlets.size();
+		arch << (uint32)meshlets.m_Vertices.size();
+		arch << (uint32)meshlets.m_Triangles.size();
+
+		arch.ArrayIn(meshlets.m_Meshlets.data(), meshlets.m_Meshlets.size());
+		arch.ArrayIn(meshlets.m_Bounds.data(), meshlets.m_Bounds.size());
+		arch.ArrayIn(meshlets.m_Vertices.data(), meshlets.m_Vertices.size());
+		arch.ArrayIn(meshlets.m_Triangles.data(), meshlets.m_Triangles.size());
+		return arch;
+	}
+
+	uint32 CullMeshlets(MeshletData const& meshlets, const kMath::Vec4f planes[6], kMath::Vec3f const& viewPosition,
+		uint32 * visible, MeshletCullStats * stats)
+	{
+		MeshletCullStats counts = {};
+		const float view[3] = { viewPosition[0], viewPosition[1], viewPosition[2] };
+		uint32 numVisible = 0;
+		for (uint32 m = 0; m < meshlets.GetMeshletNum(); m++)
+		{
+			MeshletBounds const& bounds = meshlets.GetBounds()[m];
+			uint32 numTriangles = meshlets.GetMeshlets()[m].TriangleCount;
+			counts.NumMeshlets++;
+			counts.NumTriangles += numTriangles;
+
+			bool outside = false;
+			for (uint32 i = 0; i < 6 && !outside; i++)
+			{
+				float distance = planes[i][0] * bounds.Center[0] + planes[i][1] * bounds.Center[1]
+					+ planes[i][2] * bounds.Center[2] + planes[i][3];
+				outside = distance < -bounds.Radius;
+			}
+			if (outside)
+			{
+				counts.NumFrustumCulled++;
+				counts.NumTrianglesCulled += numTriangles;
+				continue;
+			}
+
+			if (bounds.ConeCutoff <= 1.0f)
+			{
+				float toApex[3];
+				Sub(toApex, bounds.ConeApex, view);
+				if (Dot(toApex, bounds.ConeAxis) >= bounds.ConeCutoff * sqrtf(Dot(toApex, toApex)))
+				{
+					counts.NumBackfaceCulled++;
+					counts.NumTrianglesCulled += numTriangles;
+					continue;
+				}
+			}
+			visible[numVisible++] = m;
+		}
+		if (stats)
+			*stats = counts;
+		return numVisible;
+	}
+}
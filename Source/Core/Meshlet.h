@@ -0,0 +1,114 @@
+#ifndef __Meshlet_h__
+#define __Meshlet_h__
+#pragma once
+
+#include <Math/kMath.hpp>
+#include <Math/kGeometry.hpp>
+#include "Bundle.h"
+
+namespace k3d
+{
+	class MeshData;
+
+	enum class EMeshletVersion : uint64
+	{
+		VERSION_1_0 = 201610u
+	};
+
+	/// triangles of a meshlet index its own vertex list with 8 bit indices
+	struct Meshlet
+	{
+		/// first entry in the vertex list of MeshletData
+		uint32	VertexOffset;
+		/// first byte in the triangle list of MeshletData, 3 per triangle
+		uint32	TriangleOffset;
+		uint32	VertexCount;
+		uint32	TriangleCount;
+	};
+
+	struct MeshletBounds
+	{
+		float	Center[3];
+		float	Radius;
+		/// Every triangle faces away from a viewer at V if
+		/// dot(normalize(ConeApex - V), ConeAxis) >= ConeCutoff.
+		/// The cutoff is above 1 when the normals spread too much for a cone.
+		float	ConeApex[3];
+		float	ConeAxis[3];
+		float	ConeCutoff;
+	};
+
+	struct MeshletCullStats
+	{
+		uint32	NumMeshlets;
+		uint32	NumFrustumCulled;
+		uint32	NumBackfaceCulled;
+		uint32	NumTriangles;
+		uint32	NumTrianglesCulled;
+	};
+
+	/// \brief clusters of a triangle list mesh, each small enough for one
+	/// mesh shader workgroup, with bounds for culling them as a whole.
+	/// Stored in a bundle as an EMeshlets chunk next to the mesh it was built
+	/// from, see ChunkName. The vertex list indexes the vertices of that mesh,
+	/// so meshlets have to be rebuilt whenever the mesh is reordered.
+	class K3D_API MeshletData
+	{
+	public:
+		static const uint32 kMaxVertices = 64;
+		static const uint32 kMaxTriangles = 124;
+
+		MeshletData();
+
+		/// Grows meshlets over the triangle adjacency of 'mesh', preferring
+		/// triangles which add few vertices and face the way the meshlet does.
+		/// New meshlets start next to the last one, or at the first free
+		/// triangle in index order, so a cache optimized mesh splits best.
+		/// \param maxVertices at most 256
+		/// \return false if the mesh has no triangle list or quantized vertices
+		bool		Build(MeshData const& mesh, uint32 maxVertices = kMaxVertices, uint32 maxTriangles = kMaxTriangles);
+
+		/// Reads a serialized meshlet list (EMeshletVersion, meshlets).
+		/// \return false if 'data' is truncated or indexes out of its bounds
+		bool		Load(const kByte * data, uint64 size);
+		/// \return null if the chunk is no valid meshlet list
+		static std::shared_ptr<MeshletData>	CreateFromChunk(AssetChunkView const& chunk, Dispatch::ThreadPool * workers = nullptr);
+		/// name of the meshlet chunk of the mesh 'meshName'
+		static std::string	ChunkName(const char * meshName);
+
+		const char *			Name() const { return m_MeshName; }
+		uint32					GetMeshletNum() const { return (uint32)m_Meshlets.size(); }
+		uint32					GetTriangleNum() const { return (uint32)m_Triangles.size() / 3; }
+		const Meshlet *			GetMeshlets() const { return m_Meshlets.data(); }
+		const MeshletBounds *	GetBounds() const { return m_Bounds.data(); }
+		/// mesh vertex indices
+		const uint32 *			GetVertices() const { return m_Vertices.data(); }
+		const uint8 *			GetTriangles() const { return m_Triangles.data(); }
+
+		friend K3D_API class Archive& operator << (class Archive & arch, const MeshletData & meshlets);
+
+	private:
+		void		AddMeshlet(Meshlet const& meshlet, const kByte * positions, uint32 stride);
+
+		char						m_MeshName[96];
+		uint32						m_MaxVertices;
+		uint32						m_MaxTriangles;
+		std::vector<Meshlet>		m_Meshlets;
+		std::vector<MeshletBounds>	m_Bounds;
+		std::vector<uint32>			m_Vertices;
+		std::vector<uint8>			m_Triangles;
+	};
+
+	typedef std::shared_ptr<MeshletData> SpMeshlets;
+
+	/// \brief CPU reference of the per meshlet culling a compute or task
+	/// shader does: bounding spheres against the frustum, then normal cones
+	/// against the view position.
+	/// \param planes inside where dot(xyz, p) + w >= 0, as BaseCamera::GetFrustumPlanes returns them
+	/// \param visible receives the indices of the meshlets drawn, GetMeshletNum() entries at most
+	/// \return number of meshlets drawn
+	K3D_API uint32	CullMeshlets(MeshletData const& meshlets, const kMath::Vec4f planes[6], kMath::Vec3f const& viewPosition,
+						uint32 * visible, MeshletCullStats * stats = nullptr);
+}
+
+#endif
@@ -0,0 +1,667 @@
+#include "Kaleido3D.h"
+#include "MipGenerator.h"
+#include "VertexCodec.h"
+#include "Dispatch/ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define K3D_MIPGEN_SSE2 1
+#include <emmintrin.h>
+#if defined(__AVX2__)
+#define K3D_MIPGEN_AVX2 1
+#endif
+#if defined(__F16C__)
+#define K3D_MIPGEN_F16C 1
+#endif
+#if K3D_MIPGEN_AVX2 || K3D_MIPGEN_F16C
+#include <immintrin.h>
+#endif
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define K3D_MIPGEN_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace k3d
+{
+	namespace MipGenerator
+	{
+		namespace
+		{
+			const float kPi = 3.14159265358979f;
+			/// rows of a task, levels below it run on the calling thread
+			const uint32 kRowGrain = 16;
+			const uint32 kCoverageBins = 4096;
+			/// linear values below it encode on the linear segment of sRGB
+			const float kSRGBTableMin = 1.0f / 512.0f;
+			/// float bits of kSRGBTableMin >> 19, 4 mantissa bits per bucket
+			const uint32 kSRGBTableFirst = (127 - 9) << 4;
+			const uint32 kSRGBTableSize = 9 << 4;
+
+			float Sinc(float x)
+			{
+				if (fabsf(x) < 1e-6f)
+					return 1.0f;
+				x *= kPi;
+				return sinf(x) / x;
+			}
+
+			float BesselI0(float x)
+			{
+				float sum = 1.0f, term = 1.0f;
+				for (int k = 1; k < 32; k++)
+				{
+					float t = x / (2.0f * k);
+					term *= t * t;
+					sum += term;
+					if (term < sum * 1e-8f)
+						break;
+				}
+				return sum;
+			}
+
+			/// in destination pixels
+			float FilterRadius(EFilter filter)
+			{
+				return filter == EFilter::Box ? 0.5f : 3.0f;
+			}
+
+			float EvaluateFilter(EFilter filter, float x)
+			{
+				x = fabsf(x);
+				switch (filter)
+				{
+				case EFilter::Box:
+					return x < 0.5f ? 1.0f : x == 0.5f ? 0.5f : 0.0f;
+				case EFilter::Kaiser:
+				{
+					if (x >= 3.0f)
+						return 0.0f;
+					float t = x / 3.0f;
+					return Sinc(x) * BesselI0(4.0f * sqrtf(1.0f - t * t)) / BesselI0(4.0f);
+				}
+				case EFilter::Lanczos:
+					return x < 3.0f ? Sinc(x) * Sinc(x / 3.0f) : 0.0f;
+				}
+				return 0.0f;
+			}
+
+			/// weights of one axis, the 'Taps' source pixels of output i start at First[i]
+			struct Kernel
+			{
+				uint32					Taps;
+				std::vector<uint32>		First;
+				std::vector<float>		Weights;
+			};
+
+			void BuildKernel(Kernel & kernel, EFilter filter, uint32 srcSize, uint32 dstSize)
+			{
+				float scale = (float)srcSize / dstSize;
+				float radius = FilterRadius(filter) * scale;
+				std::vector<float> window;
+				std::vector<int32> first(dstSize);
+				std::vector<std::vector<float>> weights(dstSize);
+				uint32 taps = 1;
+				for (uint32 i = 0; i < dstSize; i++)
+				{
+					// pixel k is centered at k + 0.5
+					float center = (i + 0.5f) * scale;
+					int32 begin = (int32)ceilf(center - radius - 0.5f), end = (int32)floorf(center + radius - 0.5f);
+					int32 lo = std::max(begin, 0), hi = std::min(end, (int32)srcSize - 1);
+					// outside the edges the border pixel repeats
+					lo = std::min(lo, (int32)srcSize - 1);
+					hi = std::max(hi, 0);
+					window.assign(hi - lo + 1, 0.0f);
+					float sum = 0.0f;
+					for (int32 k = begin; k <= end; k++)
+					{
+						float w = EvaluateFilter(filter, (k + 0.5f - center) / scale);
+						window[std::min(std::max(k, lo), hi) - lo] += w;
+						sum += w;
+					}
+					int32 a = 0, b = (int32)window.size() - 1;
+					while (a < b && window[a] == 0.0f)
+						a++;
+					while (b > a && window[b] == 0.0f)
+						b--;
+					first[i] = lo + a;
+					weights[i].assign(window.begin() + a, window.begin() + b + 1);
+					for (float & w : weights[i])
+						w /= sum;
+					taps = std::max(taps, (uint32)(b - a + 1));
+				}
+				kernel.Taps = taps;
+				kernel.First.resize(dstSize);
+				kernel.Weights.assign((size_t)dstSize * taps, 0.0f);
+				for (uint32 i = 0; i < dstSize; i++)
+				{
+					// every output reads 'taps' pixels, narrower ones are padded with zeros
+					uint32 start = std::min((uint32)first[i], srcSize - taps);
+					kernel.First[i] = start;
+					std::copy(weights[i].begin(), weights[i].end(), kernel.Weights.begin() + (size_t)i * taps + (first[i] - start));
+				}
+			}
+
+			struct SRGBTables
+			{
+				float	ToLinear[256];
+				/// 255 * sRGB at the start of a bucket and its increase over it
+				float	Base[kSRGBTableSize];
+				float	Slope[kSRGBTableSize];
+
+				SRGBTables()
+				{
+					for (uint32 i = 0; i < 256; i++)
+						ToLinear[i] = SRGBToLinear(i / 255.0f);
+					for (uint32 i = 0; i < kSRGBTableSize; i++)
+					{
+						uint32 bits = (kSRGBTableFirst + i) << 19, next = (kSRGBTableFirst + i + 1) << 19;
+						float start, end;
+						memcpy(&start, &bits, sizeof(start));
+						memcpy(&end, &next, sizeof(end));
+						Base[i] = 255.0f * LinearToSRGB(start);
+						Slope[i] = 255.0f * LinearToSRGB(end) - Base[i];
+					}
+				}
+			};
+
+			SRGBTables const& GetSRGBTables()
+			{
+				static const SRGBTables tables;
+				return tables;
+			}
+
+			/// within 0.01 of 255 * LinearToSRGB
+			inline uint8 EncodeSRGB(SRGBTables const& tables, float linear)
+			{
+				if (!(linear > kSRGBTableMin))
+					return (uint8)(std::max(linear, 0.0f) * (12.92f * 255.0f) + 0.5f);
+				if (linear >= 1.0f)
+					return 255;
+				uint32 bits;
+				memcpy(&bits, &linear, sizeof(bits));
+				uint32 bucket = (bits >> 19) - kSRGBTableFirst;
+				float fraction = (bits & ((1u << 19) - 1)) * (1.0f / (1u << 19));
+				return (uint8)(tables.Base[bucket] + tables.Slope[bucket] * fraction + 0.5f);
+			}
+
+			inline float Saturate(float value)
+			{
+				return std::min(std::max(value, 0.0f), 1.0f);
+			}
+
+			bool IsBGRA(EImageFormat format)
+			{
+				return format == EImageFormat::BGRA8_UNORM || format == EImageFormat::BGRA8_SRGB;
+			}
+
+			bool IsSRGB(EImageFormat format)
+			{
+				return format == EImageFormat::RGBA8_SRGB || format == EImageFormat::BGRA8_SRGB;
+			}
+
+			uint32 GetChannels(EImageFormat format)
+			{
+				return format == EImageFormat::R32_FLOAT ? 1 : 4;
+			}
+
+			/// a row of 'format' to linear float RGBA, or R
+			void DecodeRow(EImageFormat format, const kByte * src, float * dst, uint32 width, bool simd)
+			{
+				switch (format)
+				{
+				case EImageFormat::RGBA8_UNORM:
+				case EImageFormat::RGBA8_SRGB:
+				case EImageFormat::BGRA8_UNORM:
+				case EImageFormat::BGRA8_SRGB:
+				{
+					const float * toLinear = GetSRGBTables().ToLinear;
+					bool srgb = IsSRGB(format);
+					uint32 r = IsBGRA(format) ? 2 : 0;
+					for (uint32 x = 0; x < width; x++, src += 4, dst += 4)
+					{
+						for (uint32 c = 0; c < 3; c++)
+							dst[c] = srgb ? toLinear[src[c ^ r]] : src[c ^ r] * (1.0f / 255.0f);
+						dst[3] = src[3] * (1.0f / 255.0f);
+					}
+					break;
+				}
+				case EImageFormat::RGBA16_FLOAT:
+				{
+					const uint16 * half = (const uint16*)src;
+					uint32 x = 0;
+#if K3D_MIPGEN_F16C
+					if (simd)
+					{
+						for (; x < width; x++)
+							_mm_storeu_ps(dst + x * 4, _mm_cvtph_ps(_mm_loadl_epi64((const __m128i*)(half + x * 4))));
+					}
+#elif K3D_MIPGEN_NEON
+					if (simd)
+					{
+						for (; x < width; x++)
+							vst1q_f32(dst + x * 4, vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(half + x * 4))));
+					}
+#endif
+					for (uint32 i = x * 4; i < width * 4; i++)
+						dst[i] = VertexCodec::HalfToFloat(half[i]);
+					break;
+				}
+				default:
+					memcpy(dst, src, width * sizeof(float));
+					break;
+				}
+				K3D_UNUSED(simd);
+			}
+
+#if K3D_MIPGEN_SSE2
+			typedef __m128 Vec4;
+			inline Vec4 Load4(const float * p) { return _mm_loadu_ps(p); }
+			inline void Store4(float * p, Vec4 v) { _mm_storeu_ps(p, v); }
+			inline Vec4 Splat4(float v) { return _mm_set1_ps(v); }
+			inline Vec4 Zero4() { return _mm_setzero_ps(); }
+			inline Vec4 MulAdd4(Vec4 a, Vec4 b, Vec4 c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+			inline float Sum4(Vec4 v)
+			{
+				v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+				v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 1));
+				return _mm_cvtss_f32(v);
+			}
+#elif K3D_MIPGEN_NEON
+			typedef float32x4_t Vec4;
+			inline Vec4 Load4(const float * p) { return vld1q_f32(p); }
+			inline void Store4(float * p, Vec4 v) { vst1q_f32(p, v); }
+			inline Vec4 Splat4(float v) { return vdupq_n_f32(v); }
+			inline Vec4 Zero4() { return vdupq_n_f32(0.0f); }
+			inline Vec4 MulAdd4(Vec4 a, Vec4 b, Vec4 c) { return vmlaq_f32(c, a, b); }
+			inline float Sum4(Vec4 v) { return vaddvq_f32(v); }
+#endif
+
+#if K3D_MIPGEN_AVX2
+			inline __m256 MulAdd8(__m256 a, __m256 b, __m256 c)
+			{
+#if defined(__FMA__)
+				return _mm256_fmadd_ps(a, b, c);
+#else
+				return _mm256_add_ps(_mm256_mul_ps(a, b), c);
+#endif
+			}
+#endif
+
+			/// one source row to 'kernel.First.size()' pixels
+			void FilterRow(const float * src, float * dst, uint32 channels, Kernel const& kernel, bool simd)
+			{
+				uint32 count = (uint32)kernel.First.size(), taps = kernel.Taps;
+				const float * weights = kernel.Weights.data();
+				uint32 x = 0;
+#if K3D_MIPGEN_SSE2 || K3D_MIPGEN_NEON
+				if (simd && channels == 4)
+				{
+#if K3D_MIPGEN_AVX2
+					// two output pixels per register
+					for (; x + 2 <= count; x += 2)
+					{
+						const float * p0 = src + kernel.First[x] * 4, * p1 = src + kernel.First[x + 1] * 4;
+						const float * w0 = weights + (size_t)x * taps, * w1 = w0 + taps;
+						__m256 acc = _mm256_setzero_ps();
+						for (uint32 t = 0; t < taps; t++)
+						{
+							__m256 v = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(p0 + t * 4)), _mm_loadu_ps(p1 + t * 4), 1);
+							__m256 w = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(w0[t])), _mm_set1_ps(w1[t]), 1);
+							acc = MulAdd8(v, w, acc);
+						}
+						_mm256_storeu_ps(dst + x * 4, acc);
+					}
+#endif
+					// a pixel per register
+					for (; x < count; x++)
+					{
+						const float * p = src + kernel.First[x] * 4, * w = weights + (size_t)x * taps;
+						Vec4 acc = Zero4();
+						for (uint32 t = 0; t < taps; t++)
+							acc = MulAdd4(Load4(p + t * 4), Splat4(w[t]), acc);
+						Store4(dst + x * 4, acc);
+					}
+					return;
+				}
+				if (simd && channels == 1 && taps >= 4)
+				{
+					// dot products of 4 taps
+					for (; x < count; x++)
+					{
+						const float * p = src + kernel.First[x], * w = weights + (size_t)x * taps;
+						Vec4 acc = Zero4();
+						uint32 t = 0;
+						for (; t + 4 <= taps; t += 4)
+							acc = MulAdd4(Load4(p + t), Load4(w + t), acc);
+						float sum = Sum4(acc);
+						for (; t < taps; t++)
+							sum += p[t] * w[t];
+						dst[x] = sum;
+					}
+					return;
+				}
+#endif
+				K3D_UNUSED(simd);
+				for (; x < count; x++)
+				{
+					const float * p = src + kernel.First[x] * channels, * w = weights + (size_t)x * taps;
+					for (uint32 c = 0; c < channels; c++)
+					{
+						float sum = 0.0f;
+						for (uint32 t = 0; t < taps; t++)
+							sum += p[t * channels + c] * w[t];
+						dst[x * channels + c] = sum;
+					}
+				}
+			}
+
+			/// weighted sum of 'taps' rows of 'count' floats, 'stride' apart
+			void FilterColumns(const float * src, size_t stride, const float * weights, uint32 taps, float * dst, size_t count, bool simd)
+			{
+				size_t i = 0;
+#if K3D_MIPGEN_SSE2 || K3D_MIPGEN_NEON
+				if (simd)
+				{
+#if K3D_MIPGEN_AVX2
+					for (; i + 8 <= count; i += 8)
+					{
+						__m256 acc = _mm256_setzero_ps();
+						for (uint32 t = 0; t < taps; t++)
+							acc = MulAdd8(_mm256_loadu_ps(src + t * stride + i), _mm256_set1_ps(weights[t]), acc);
+						_mm256_storeu_ps(dst + i, acc);
+					}
+#endif
+					for (; i + 4 <= count; i += 4)
+					{
+						Vec4 acc = Zero4();
+						for (uint32 t = 0; t < taps; t++)
+							acc = MulAdd4(Load4(src + t * stride + i), Splat4(weights[t]), acc);
+						Store4(dst + i, acc);
+					}
+				}
+#endif
+				K3D_UNUSED(simd);
+				for (; i < count; i++)
+				{
+					float sum = 0.0f;
+					for (uint32 t = 0; t < taps; t++)
+						sum += src[t * stride + i] * weights[t];
+					dst[i] = sum;
+				}
+			}
+
+			/// linear float RGBA, or R, to a row of 'format', the alpha is scaled by 'alphaScale'
+			void EncodeRow(EImageFormat format, const float * src, kByte * dst, uint32 width, float alphaScale, bool simd)
+			{
+				switch (format)
+				{
+				case EImageFormat::RGBA8_UNORM:
+				case EImageFormat::BGRA8_UNORM:
+				{
+					bool bgra = IsBGRA(format);
+					uint32 x = 0;
+#if K3D_MIPGEN_SSE2
+					if (simd)
+					{
+						const __m128 scale = _mm_setr_ps(255.0f, 255.0f, 255.0f, 255.0f * alphaScale);
+						const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(255.0f), half = _mm_set1_ps(0.5f);
+						for (; x + 4 <= width; x += 4)
+						{
+							__m128i q[4];
+							for (uint32 k = 0; k < 4; k++)
+							{
+								__m128 v = _mm_loadu_ps(src + (x + k) * 4);
+								if (bgra)
+									v = _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 0, 1, 2));
+								v = _mm_min_ps(_mm_max_ps(_mm_mul_ps(v, scale), zero), one);
+								q[k] = _mm_cvttps_epi32(_mm_add_ps(v, half));
+							}
+							__m128i packed = _mm_packus_epi16(_mm_packs_epi32(q[0], q[1]), _mm_packs_epi32(q[2], q[3]));
+							_mm_storeu_si128((__m128i*)(dst + x * 4), packed);
+						}
+					}
+#elif K3D_MIPGEN_NEON
+					if (simd)
+					{
+						const float32x4_t scale = { 255.0f, 255.0f, 255.0f, 255.0f * alphaScale };
+						const float32x4_t zero = vdupq_n_f32(0.0f), one = vdupq_n_f32(255.0f), half = vdupq_n_f32(0.5f);
+						for (; x + 4 <= width; x += 4)
+						{
+							uint16x4_t q[4];
+							for (uint32 k = 0; k < 4; k++)
+							{
+								float32x4_t v = vld1q_f32(src + (x + k) * 4);
+								if (bgra)
+									v = vcopyq_laneq_f32(vcopyq_laneq_f32(v, 0, v, 2), 2, v, 0);
+								v = vminq_f32(vmaxq_f32(vmulq_f32(v, scale), zero), one);
+								q[k] = vmovn_u32(vcvtq_u32_f32(vaddq_f32(v, half)));
+							}
+							uint8x16_t packed = vcombine_u8(vmovn_u16(vcombine_u16(q[0], q[1])), vmovn_u16(vcombine_u16(q[2], q[3])));
+							vst1q_u8(dst + x * 4, packed);
+						}
+					}
+#endif
+					K3D_UNUSED(simd);
+					uint32 r = bgra ? 2 : 0;
+					for (; x < width; x++)
+					{
+						const float * p = src + x * 4;
+						for (uint32 c = 0; c < 3; c++)
+							dst[x * 4 + c] = (uint8)(Saturate(p[c ^ r]) * 255.0f + 0.5f);
+						dst[x * 4 + 3] = (uint8)(Saturate(p[3] * alphaScale) * 255.0f + 0.5f);
+					}
+					break;
+				}
+				case EImageFormat::RGBA8_SRGB:
+				case EImageFormat::BGRA8_SRGB:
+				{
+					SRGBTables const& tables = GetSRGBTables();
+					uint32 r = IsBGRA(format) ? 2 : 0;
+					for (uint32 x = 0; x < width; x++)
+					{
+						const float * p = src + x * 4;
+						for (uint32 c = 0; c < 3; c++)
+						{
+							dst[x * 4 + c] = simd ? EncodeSRGB(tables, p[c ^ r])
+								: (uint8)(LinearToSRGB(Saturate(p[c ^ r])) * 255.0f + 0.5f);
+						}
+						dst[x * 4 + 3] = (uint8)(Saturate(p[3] * alphaScale) * 255.0f + 0.5f);
+					}
+					break;
+				}
+				case EImageFormat::RGBA16_FLOAT:
+				{
+					uint16 * half = (uint16*)dst;
+					uint32 x = 0;
+#if K3D_MIPGEN_F16C
+					if (simd && alphaScale == 1.0f)
+					{
+						for (; x < width; x++)
+							_mm_storel_epi64((__m128i*)(half + x * 4), _mm_cvtps_ph(_mm_loadu_ps(src + x * 4), 0));
+					}
+#elif K3D_MIPGEN_NEON
+					if (simd && alphaScale == 1.0f)
+					{
+						for (; x < width; x++)
+							vst1_u16(half + x * 4, vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(src + x * 4))));
+					}
+#endif
+					for (; x < width; x++)
+					{
+						for (uint32 c = 0; c < 3; c++)
+							half[x * 4 + c] = VertexCodec::FloatToHalf(src[x * 4 + c]);
+						float alpha = src[x * 4 + 3];
+						half[x * 4 + 3] = VertexCodec::FloatToHalf(alphaScale == 1.0f ? alpha : std::min(alpha * alphaScale, 1.0f));
+					}
+					break;
+				}
+				default:
+					memcpy(dst, src, width * sizeof(float));
+					break;
+				}
+			}
+
+			/// share of the pixels with alpha * scale at least 'reference'
+			float AlphaCoverage(const float * pixels, size_t count, float reference, float scale)
+			{
+				size_t passed = 0;
+				for (size_t i = 0; i < count; i++)
+					passed += pixels[i * 4 + 3] * scale >= reference;
+				return count ? (float)passed / count : 0.0f;
+			}
+
+			/// the alpha scale giving 'coverage', from a histogram of the alpha values
+			float FindAlphaScale(const float * pixels, size_t count, float reference, float coverage)
+			{
+				std::vector<uint32> histogram(kCoverageBins);
+				for (size_t i = 0; i < count; i++)
+				{
+					float alpha = pixels[i * 4 + 3];
+					if (alpha > 0.0f)
+						histogram[std::min((uint32)(alpha * kCoverageBins), kCoverageBins - 1)]++;
+				}
+				size_t target = (size_t)(coverage * count + 0.5f), passed = 0;
+				if (target == 0)
+					return 1.0f;
+				uint32 bin = kCoverageBins;
+				while (bin > 1 && passed + histogram[bin - 1] <= target)
+					passed += histogram[--bin];
+				// a bin of many equal alphas may overshoot by less than it falls short
+				if (bin > 1 && passed + histogram[bin - 1] - target < target - passed)
+					bin--;
+				// the lower edge of the first bin left out
+				return reference * kCoverageBins / bin;
+			}
+		}
+
+		float SRGBToLinear(float value)
+		{
+			return value <= 0.04045f ? value / 12.92f : powf((value + 0.055f) / 1.055f, 2.4f);
+		}
+
+		float LinearToSRGB(float value)
+		{
+			return value <= 0.0031308f ? value * 12.92f : 1.055f * powf(value, 1.0f / 2.4f) - 0.055f;
+		}
+
+		bool IsSupported(EImageFormat format)
+		{
+			switch (format)
+			{
+			case EImageFormat::RGBA8_UNORM:
+			case EImageFormat::RGBA8_SRGB:
+			case EImageFormat::BGRA8_UNORM:
+			case EImageFormat::BGRA8_SRGB:
+			case EImageFormat::RGBA16_FLOAT:
+			case EImageFormat::R32_FLOAT:
+				return true;
+			default:
+				return false;
+			}
+		}
+
+		std::shared_ptr<ImageData> Generate(ImageData const& source, Options const& options,
+			Dispatch::ThreadPool * workers, Stats * stats)
+		{
+			EImageFormat format = source.GetFormat();
+			if (!IsSupported(format) || source.GetType() == ImageData::TEXTURE_3D || source.GetMipLevs() == 0)
+				return nullptr;
+			auto start = std::chrono::high_resolution_clock::now();
+			uint32 width = source.GetWidth(), height = source.GetHeight(), levels = 1;
+			for (uint32 size = std::max(width, height); size > 1; size >>= 1)
+				levels++;
+			if (options.MaxLevels)
+				levels = std::min(levels, options.MaxLevels);
+			auto image = std::make_shared<ImageData>();
+			if (!image->Create(format, width, height, levels, source.GetLayers(), source.IsCubeMap()))
+				return nullptr;
+			image->SetName(source.GetName());
+
+			Dispatch::ThreadPool & pool = workers ? *workers : Dispatch::ThreadPool::Global();
+			uint32 channels = GetChannels(format);
+			bool simd = !options.Scalar;
+			bool keepCoverage = options.AlphaReference > 0.0f && channels == 4;
+			Stats result = {};
+			std::vector<float> current, filtered, next;
+			Kernel horizontal, vertical;
+			for (uint32 layer = 0; layer < source.GetLayers(); layer++)
+			{
+				const ImageLevel * base = source.GetLevelDesc(0, layer);
+				memcpy(image->GetLevelData(0, layer), base->Data, (size_t)base->Size);
+				current.resize((size_t)width * height * channels);
+				pool.ParallelFor(0, height, kRowGrain, [&](uint32 begin, uint32 end)
+				{
+					for (uint32 y = begin; y < end; y++)
+						DecodeRow(format, base->Data + (size_t)y * base->RowPitch, &current[(size_t)y * width * channels], width, simd);
+				});
+				float coverage = keepCoverage ? AlphaCoverage(current.data(), (size_t)width * height, options.AlphaReference, 1.0f) : 0.0f;
+
+				uint32 srcWidth = width, srcHeight = height;
+				for (uint32 level = 1; level < levels; level++)
+				{
+					uint32 dstWidth = std::max(srcWidth >> 1, 1u), dstHeight = std::max(srcHeight >> 1, 1u);
+					BuildKernel(horizontal, options.Filter, srcWidth, dstWidth);
+					BuildKernel(vertical, options.Filter, srcHeight, dstHeight);
+					size_t srcRow = (size_t)srcWidth * channels, dstRow = (size_t)dstWidth * channels;
+					filtered.resize(dstRow * srcHeight);
+					pool.ParallelFor(0, srcHeight, kRowGrain, [&](uint32 begin, uint32 end)
+					{
+						for (uint32 y = begin; y < end; y++)
+							FilterRow(&current[y * srcRow], &filtered[y * dstRow], channels, horizontal, simd);
+					});
+					next.resize(dstRow * dstHeight);
+					pool.ParallelFor(0, dstHeight, kRowGrain, [&](uint32 begin, uint32 end)
+					{
+						for (uint32 y = begin; y < end; y++)
+						{
+							FilterColumns(&filtered[vertical.First[y] * dstRow], dstRow, &vertical.Weights[(size_t)y * vertical.Taps],
+								vertical.Taps, &next[y * dstRow], dstRow, simd);
+						}
+					});
+
+					float alphaScale = 1.0f;
+					size_t pixels = (size_t)dstWidth * dstHeight;
+					if (coverage > 0.0f)
+					{
+						alphaScale = FindAlphaScale(next.data(), pixels, options.AlphaReference, coverage);
+						float error = fabsf(AlphaCoverage(next.data(), pixels, options.AlphaReference, alphaScale) - coverage);
+						result.MaxCoverageError = std::max(result.MaxCoverageError, error);
+					}
+					kByte * dst = image->GetLevelData(level, layer);
+					uint32 pitch = image->GetLevelDesc(level, layer)->RowPitch;
+					pool.ParallelFor(0, dstHeight, kRowGrain, [&](uint32 begin, uint32 end)
+					{
+						for (uint32 y = begin; y < end; y++)
+							EncodeRow(format, &next[y * dstRow], dst + (size_t)y * pitch, dstWidth, alphaScale, simd);
+					});
+					result.Pixels += pixels;
+					current.swap(next);
+					srcWidth = dstWidth;
+					srcHeight = dstHeight;
+				}
+			}
+			result.Milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+			if (stats)
+				*stats = result;
+			return image;
+		}
+
+		const char * GetKernel()
+		{
+#if K3D_MIPGEN_AVX2
+			return "avx2";
+#elif K3D_MIPGEN_SSE2
+			return "sse2";
+#elif K3D_MIPGEN_NEON
+			return "neon";
+#else
+			return "scalar";
+#endif
+		}
+	}
+}
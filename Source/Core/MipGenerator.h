@@ -0,0 +1,73 @@
+#ifndef __MipGenerator_h__
+#define __MipGenerator_h__
+#pragma once
+
+#include "ImageData.h"
+
+namespace k3d
+{
+	/// Mip chains of 2D images (arrays and cube maps layer by layer). Levels
+	/// are filtered from the one before in linear float, separably and 2:1 (or
+	/// slightly more for odd sizes) with clamped edges. The passes run on
+	/// SSE2, AVX2 or NEON where the build targets them, split into row tiles
+	/// on a thread pool.
+	namespace MipGenerator
+	{
+		enum class EFilter : uint32
+		{
+			/// 2x2 average
+			Box,
+			/// windowed sinc, radius 3, alpha 4
+			Kaiser,
+			/// Lanczos 3
+			Lanczos,
+		};
+
+		struct Options
+		{
+			EFilter	Filter;
+			/// 0 for the whole chain down to 1x1
+			uint32	MaxLevels;
+			/// above 0 the alpha of every level is scaled so that the same share
+			/// of pixels passes an alpha test against it as in level 0
+			float	AlphaReference;
+			/// the scalar reference kernels, for comparison
+			bool	Scalar;
+
+			Options()
+				: Filter(EFilter::Kaiser)
+				, MaxLevels(0)
+				, AlphaReference(0.0f)
+				, Scalar(false)
+			{
+			}
+		};
+
+		struct Stats
+		{
+			/// pixels written below level 0, all layers
+			uint64	Pixels;
+			double	Milliseconds;
+			/// largest difference of alpha test coverage to level 0
+			float	MaxCoverageError;
+		};
+
+		/// RGBA8 and BGRA8 (UNORM or sRGB), RGBA16_FLOAT and R32_FLOAT
+		K3D_API bool	IsSupported(EImageFormat format);
+
+		/// Builds the mip chain of level 0 of every layer of 'source'. sRGB
+		/// formats are filtered in linear space, 8 bit results are clamped.
+		/// \param workers the global pool if null
+		/// \return an image owning its levels, null if the format or type isn't supported
+		K3D_API std::shared_ptr<ImageData>	Generate(ImageData const& source, Options const& options = Options(),
+			Dispatch::ThreadPool * workers = nullptr, Stats * stats = nullptr);
+
+		K3D_API float	SRGBToLinear(float value);
+		K3D_API float	LinearToSRGB(float value);
+
+		/// "avx2", "sse2", "neon" or "scalar"
+		K3D_API const char *	GetKernel();
+	}
+}
+
+#endif
@@ -6,10 +6,19 @@
 #endif
 #include "Utils/StringUtils.h"
 #include <algorithm>
+#include <atomic>
+#include <mutex>
 #include <regex>
+#include <unordered_map>
+#include <vector>
 
 #if K3DPLATFORM_OS_WIN
 #include <process.h>
+#else
+#include <climits>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
 #endif
 
 namespace Os {
@@ -22,7 +31,8 @@ File::File(const char* fileName)
   m_fd(-1)
   ,
 #endif
-  m_EOF(false)
+  m_Direct(false)
+  , m_EOF(false)
   , m_CurOffset(0)
   , m_pFileName(fileName)
 {
@@ -37,7 +47,8 @@ File::File()
   m_fd(-1)
   ,
 #endif
-  m_EOF(false)
+  m_Direct(false)
+  , m_EOF(false)
   , m_CurOffset(0)
   , m_pFileName(NULL)
 {
@@ -73,19 +84,26 @@ File::Open(const char* fileName, IOFlag flag)
                                         NULL,
                                         FALSE };
   DWORD createDisp = (flag & IOWrite) ? CREATE_ALWAYS : OPEN_EXISTING;
+  DWORD attributes = FILE_ATTRIBUTE_NORMAL;
+  if (flag & IODirect)
+    attributes |= FILE_FLAG_NO_BUFFERING;
 
   m_hFile = ::CreateFileW(name_buf, // file to open
                           accessRights,
                           shareMode,
                           &securityAttrs,
                           createDisp,
-                          FILE_ATTRIBUTE_NORMAL,
+                          attributes,
                           NULL);
   if (m_hFile == INVALID_HANDLE_VALUE)
     return false;
 #else
-  m_fd =
-    ::open(fileName, flag == IORead ? O_RDONLY : (O_WRONLY | O_CREAT), S_IRWXU);
+  int oflag = (flag & IOWrite) ? (O_WRONLY | O_CREAT | O_TRUNC) : O_RDONLY;
+#ifdef O_DIRECT
+  if (flag & IODirect)
+    oflag |= O_DIRECT;
+#endif
+  m_fd = ::open(fileName, oflag, S_IRWXU);
   if (m_fd < 0) {
     int err = errno;
     if (err == EACCES) {
@@ -93,7 +111,12 @@ File::Open(const char* fileName, IOFlag flag)
     }
     return false;
   }
+#if defined(F_NOCACHE)
+  if (flag & IODirect)
+    ::fcntl(m_fd, F_NOCACHE, 1);
+#endif
 #endif
+  m_Direct = (flag & IODirect) != 0;
   return true;
 }
 
@@ -114,16 +137,20 @@ File::Open(const WCHAR* fileName, IOFlag flag)
                                         NULL,
                                         FALSE };
   DWORD createDisp = (flag & IOWrite) ? CREATE_ALWAYS : OPEN_EXISTING;
+  DWORD attributes = FILE_ATTRIBUTE_NORMAL;
+  if (flag & IODirect)
+    attributes |= FILE_FLAG_NO_BUFFERING;
 
   m_hFile = ::CreateFileW(fileName, // file to open
                           accessRights,
                           shareMode,
                           &securityAttrs,
                           createDisp,
-                          FILE_ATTRIBUTE_NORMAL,
+                          attributes,
                           NULL);
   if (m_hFile == INVALID_HANDLE_VALUE)
     return false;
+  m_Direct = (flag & IODirect) != 0;
   return true;
 }
 
@@ -196,6 +223,170 @@ File::Write(const void* data, size_t len)
   return written;
 }
 
+size_t
+File::ReadAt(void* ptr, size_t len, uint64 offset)
+{
+  char* data = (char*)ptr;
+  size_t done = 0;
+#if K3DPLATFORM_OS_WIN
+  while (done < len) {
+    // an explicit offset on a synchronous handle still moves its file pointer,
+    // but the transfer itself does not depend on it
+    OVERLAPPED ov = {};
+    ov.Offset = (DWORD)((offset + done) & 0xffffffff);
+    ov.OffsetHigh = (DWORD)((offset + done) >> 32);
+    DWORD toRead = (DWORD)std::min<size_t>(len - done, 1u << 30);
+    DWORD bytesRead = 0;
+    if (!::ReadFile(m_hFile, data + done, toRead, &bytesRead, &ov)) {
+      if (::GetLastError() == ERROR_HANDLE_EOF)
+        break;
+      return done ? done : size_t(-1);
+    }
+    if (bytesRead == 0)
+      break;
+    done += bytesRead;
+  }
+#else
+  while (done < len) {
+    ssize_t ret = ::pread(m_fd, data + done, len - done, (off_t)(offset + done));
+    if (ret < 0) {
+      if (errno == EINTR)
+        continue;
+      return done ? done : size_t(-1);
+    }
+    if (ret == 0)
+      break;
+    done += (size_t)ret;
+  }
+#endif
+  return done;
+}
+
+size_t
+File::WriteAt(const void* ptr, size_t len, uint64 offset)
+{
+  const char* data = (const char*)ptr;
+  size_t done = 0;
+#if K3DPLATFORM_OS_WIN
+  while (done < len) {
+    OVERLAPPED ov = {};
+    ov.Offset = (DWORD)((offset + done) & 0xffffffff);
+    ov.OffsetHigh = (DWORD)((offset + done) >> 32);
+    DWORD toWrite = (DWORD)std::min<size_t>(len - done, 1u << 30);
+    DWORD written = 0;
+    if (!::WriteFile(m_hFile, data + done, toWrite, &written, &ov))
+      return done ? done : size_t(-1);
+    if (written == 0)
+      break;
+    done += written;
+  }
+#else
+  while (done < len) {
+    ssize_t ret =
+      ::pwrite(m_fd, data + done, len - done, (off_t)(offset + done));
+    if (ret < 0) {
+      if (errno == EINTR)
+        continue;
+      return done ? done : size_t(-1);
+    }
+    if (ret == 0)
+      break;
+    done += (size_t)ret;
+  }
+#endif
+  return done;
+}
+
+size_t
+File::ReadV(const IOVec* buffers, uint32 count, uint64 offset)
+{
+#if K3DPLATFORM_OS_LINUX && !K3DPLATFORM_OS_ANDROID
+  std::vector<iovec> iov(count);
+  for (uint32 i = 0; i < count; i++) {
+    iov[i].iov_base = buffers[i].Data;
+    iov[i].iov_len = buffers[i].Size;
+  }
+  size_t done = 0;
+  uint32 first = 0;
+  while (first < count) {
+    int num = (int)std::min<uint32>(count - first, IOV_MAX);
+    ssize_t ret = ::preadv(m_fd, &iov[first], num, (off_t)(offset + done));
+    if (ret < 0) {
+      if (errno == EINTR)
+        continue;
+      return done ? done : size_t(-1);
+    }
+    if (ret == 0)
+      break;
+    done += (size_t)ret;
+    // skip the filled buffers, a short read resumes inside a buffer
+    size_t left = (size_t)ret;
+    while (first < count && left >= iov[first].iov_len) {
+      left -= iov[first].iov_len;
+      first++;
+    }
+    if (first < count) {
+      iov[first].iov_base = (char*)iov[first].iov_base + left;
+      iov[first].iov_len -= left;
+    }
+  }
+  return done;
+#else
+  size_t done = 0;
+  for (uint32 i = 0; i < count; i++) {
+    size_t read = ReadAt(buffers[i].Data, buffers[i].Size, offset + done);
+    if (read == size_t(-1))
+      return done ? done : size_t(-1);
+    done += read;
+    if (read < buffers[i].Size)
+      break;
+  }
+  return done;
+#endif
+}
+
+size_t
+File::CopyFrom(File& source, uint64 sourceOffset, size_t len, uint64 offset)
+{
+  size_t done = 0;
+#if K3DPLATFORM_OS_LINUX && defined(__NR_copy_file_range)
+  while (done < len) {
+    loff_t in = (loff_t)(sourceOffset + done);
+    loff_t out = (loff_t)(offset + done);
+    ssize_t ret = ::syscall(
+      __NR_copy_file_range, source.m_fd, &in, m_fd, &out, len - done, 0u);
+    if (ret < 0) {
+      if (errno == EINTR)
+        continue;
+      // e.g. older kernels, different file systems or direct IO, copy below
+      break;
+    }
+    if (ret == 0)
+      return done;
+    done += (size_t)ret;
+  }
+  if (done == len)
+    return done;
+#endif
+  const size_t blockSize = 1 << 20;
+  std::vector<char> block(std::min(len - done, blockSize));
+  while (done < len) {
+    size_t toRead = std::min(len - done, blockSize);
+    size_t read = source.ReadAt(block.data(), toRead, sourceOffset + done);
+    if (read == size_t(-1))
+      return done ? done : size_t(-1);
+    if (read == 0)
+      break;
+    size_t written = WriteAt(block.data(), read, offset + done);
+    if (written == size_t(-1))
+      return done ? done : size_t(-1);
+    done += written;
+    if (written < read)
+      break;
+  }
+  return done;
+}
+
 bool
 File::Seek(size_t offset)
 {
@@ -232,8 +423,10 @@ File::Close()
     m_hFile = NULL;
   }
 #else
-  if (m_fd)
+  if (m_fd >= 0) {
     ::close(m_fd);
+    m_fd = -1;
+  }
 #endif
 }
 
@@ -243,31 +436,324 @@ File::LastModified() const
 #if K3DPLATFORM_OS_WIN
   FILETIME FileTime = {};
   GetFileTime(m_hFile, nullptr, nullptr, &FileTime);
-  return FileTime.dwLowDateTime;
+  return ((uint64)FileTime.dwHighDateTime << 32) | FileTime.dwLowDateTime;
+#else
+  struct stat st;
+  if (fstat(m_fd, &st) != 0) {
+    return uint64();
+  }
+#if K3DPLATFORM_OS_MAC || K3DPLATFORM_OS_IOS
+  return (uint64)st.st_mtimespec.tv_sec * 1000000000ull +
+         st.st_mtimespec.tv_nsec;
+#else
+  return (uint64)st.st_mtim.tv_sec * 1000000000ull + st.st_mtim.tv_nsec;
+#endif
+#endif
+}
+
+File::NativeHandle
+File::GetNativeHandle() const
+{
+#ifdef K3DPLATFORM_OS_WIN
+  return m_hFile;
 #else
-  return uint64();
+  return m_fd;
 #endif
 }
 
+bool
+File::IsDirect() const
+{
+  return m_Direct;
+}
+
 File*
 File::CreateIOInterface()
 {
   return new File;
 }
+
+size_t
+File::GetDirectAlignment()
+{
+  // covers the logical block size of current disks
+  return 4096;
+}
+
+void*
+File::AllocateAligned(size_t size, size_t alignment)
+{
+#if K3DPLATFORM_OS_WIN
+  return ::_aligned_malloc(size, alignment);
+#else
+  void* ptr = nullptr;
+  if (::posix_memalign(&ptr, alignment, size) != 0)
+    return nullptr;
+  return ptr;
+#endif
+}
+
+void
+File::FreeAligned(void* ptr)
+{
+#if K3DPLATFORM_OS_WIN
+  ::_aligned_free(ptr);
+#else
+  ::free(ptr);
+#endif
+}
 //--------------------------------------------------------------------------------------------
 
-MemMapFile::MemMapFile()
-  :
+struct MemMapping
+{
+  kByte* Data;
+  size_t Size;
+  uint64 ModifyTime;
+  uint64 FileId;
+  bool HugePageAligned;
+  std::atomic<uint64> MinorFaults;
+  std::atomic<uint64> MajorFaults;
+
+  MemMapping()
+    : Data(nullptr)
+    , Size(0)
+    , ModifyTime(0)
+    , FileId(0)
+    , HugePageAligned(false)
+    , MinorFaults(0)
+    , MajorFaults(0)
+  {
+  }
+
+  ~MemMapping()
+  {
+    if (!Data)
+      return;
 #if K3DPLATFORM_OS_WIN
-  m_FileHandle(NULL)
-  , m_FileMappingHandle(NULL)
-  ,
+    ::UnmapViewOfFile(Data);
 #else
-  m_Fd(-1)
-  ,
+    ::munmap(Data, Size);
+#endif
+  }
+};
+
+namespace {
+struct MappingCache
+{
+  std::mutex Lock;
+  std::unordered_map<::kString, std::weak_ptr<MemMapping> > Mappings;
+};
+
+MappingCache&
+GetMappingCache()
+{
+  static MappingCache s_Cache;
+  return s_Cache;
+}
+
+bool
+GetFileStamp(::kString const& path, uint64& size, uint64& mtime, uint64& id)
+{
+#if K3DPLATFORM_OS_WIN
+  WIN32_FILE_ATTRIBUTE_DATA data;
+  if (!::GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &data))
+    return false;
+  size = ((uint64)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+  mtime = ((uint64)data.ftLastWriteTime.dwHighDateTime << 32) |
+          data.ftLastWriteTime.dwLowDateTime;
+  id = 0;
+#else
+  struct stat st;
+  if (::stat(path.c_str(), &st) != 0)
+    return false;
+  size = (uint64)st.st_size;
+  mtime = (uint64)st.st_mtime;
+  id = (uint64)st.st_ino;
+#endif
+  return true;
+}
+
+bool
+IsMappingCurrent(::kString const& path, MemMapping const& mapping)
+{
+  uint64 size = 0, mtime = 0, id = 0;
+  return GetFileStamp(path, size, mtime, id) && size == mapping.Size &&
+         mtime == mapping.ModifyTime && id == mapping.FileId;
+}
+
+MemMapFile::FaultStats
+GetThreadFaults()
+{
+  MemMapFile::FaultStats stats = { 0, 0 };
+#if !K3DPLATFORM_OS_WIN
+  struct rusage usage;
+#ifdef RUSAGE_THREAD
+  int who = RUSAGE_THREAD;
+#else
+  int who = RUSAGE_SELF;
+#endif
+  if (::getrusage(who, &usage) == 0) {
+    stats.MinorFaults = (uint64)usage.ru_minflt;
+    stats.MajorFaults = (uint64)usage.ru_majflt;
+  }
 #endif
-  m_szFile(0)
+  return stats;
+}
+
+/// size of a virtual memory page, queried once
+size_t
+SystemPageSize()
+{
+  static const size_t pageSize = []() {
+#if K3DPLATFORM_OS_WIN
+    SYSTEM_INFO info;
+    ::GetSystemInfo(&info);
+    return (size_t)info.dwPageSize;
+#else
+    return (size_t)::sysconf(_SC_PAGESIZE);
+#endif
+  }();
+  return pageSize;
+}
+
+/// one load a page, faults in the pages of [begin, begin + len)
+void
+TouchPages(const kByte* begin, size_t len)
+{
+  if (len == 0)
+    return;
+  const size_t page = SystemPageSize();
+  const volatile kByte* p =
+    (const volatile kByte*)((uintptr_t)begin & ~(uintptr_t)(page - 1));
+  for (; (const kByte*)p < begin + len; p += page)
+    (void)*p;
+}
+
+#if K3DPLATFORM_OS_LINUX
+const size_t kHugePageSize = 2u << 20;
+
+// reserve an oversized range, then map the file at its first 2MB boundary so
+// the kernel can back it with huge pages (needs THP for read-only files)
+kByte*
+MapHugePageAligned(int fd, size_t size, int flags)
+{
+  size_t reserved = size + kHugePageSize;
+  void* base =
+    ::mmap(NULL, reserved, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (base == MAP_FAILED)
+    return nullptr;
+  uintptr_t begin = (uintptr_t)base;
+  uintptr_t aligned = (begin + kHugePageSize - 1) & ~(uintptr_t)(kHugePageSize - 1);
+  void* data = ::mmap((void*)aligned, size, PROT_READ, flags | MAP_FIXED, fd, 0);
+  if (data == MAP_FAILED) {
+    ::munmap(base, reserved);
+    return nullptr;
+  }
+  size_t page = (size_t)::sysconf(_SC_PAGESIZE);
+  uintptr_t end = aligned + ((size + page - 1) & ~(page - 1));
+  if (aligned > begin)
+    ::munmap(base, aligned - begin);
+  if (begin + reserved > end)
+    ::munmap((void*)end, begin + reserved - end);
+#ifdef MADV_HUGEPAGE
+  ::madvise(data, size, MADV_HUGEPAGE);
+#endif
+  return (kByte*)data;
+}
+#endif
+
+std::shared_ptr<MemMapping>
+CreateMapping(::kString const& path, MemMapFile::Options const& options)
+{
+  auto mapping = std::make_shared<MemMapping>();
+#if K3DPLATFORM_OS_WIN
+  HANDLE file = ::CreateFileW(path.c_str(),
+                              GENERIC_READ,
+                              FILE_SHARE_READ,
+                              NULL,
+                              OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+                              NULL);
+  if (file == INVALID_HANDLE_VALUE)
+    return nullptr;
+  LARGE_INTEGER size;
+  if (!::GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+    ::CloseHandle(file);
+    return nullptr;
+  }
+  HANDLE fileMapping =
+    ::CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (fileMapping == NULL) {
+    ::CloseHandle(file);
+    return nullptr;
+  }
+  // the view keeps the file mapping alive
+  mapping->Data =
+    (kByte*)::MapViewOfFile(fileMapping, FILE_MAP_READ, 0, 0, 0);
+  ::CloseHandle(fileMapping);
+  ::CloseHandle(file);
+  if (mapping->Data == NULL)
+    return nullptr;
+  mapping->Size = (size_t)size.QuadPart;
+  uint64 fileSize = 0;
+  GetFileStamp(path, fileSize, mapping->ModifyTime, mapping->FileId);
+#else
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd == -1)
+    return nullptr;
+  struct stat st;
+  if (::fstat(fd, &st) != 0 || st.st_size == 0) {
+    ::close(fd);
+    return nullptr;
+  }
+  mapping->Size = (size_t)st.st_size;
+  mapping->ModifyTime = (uint64)st.st_mtime;
+  mapping->FileId = (uint64)st.st_ino;
+  int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+  if (options.Populate)
+    flags |= MAP_POPULATE;
+#endif
+#if K3DPLATFORM_OS_LINUX
+  if (options.HugePages && mapping->Size >= kHugePageSize) {
+    mapping->Data = MapHugePageAligned(fd, mapping->Size, flags);
+    mapping->HugePageAligned = mapping->Data != nullptr;
+  }
+#endif
+  if (!mapping->Data) {
+    void* data = ::mmap(NULL, mapping->Size, PROT_READ, flags, fd, 0);
+    if (data != MAP_FAILED)
+      mapping->Data = (kByte*)data;
+  }
+  // the mapping holds its own reference to the file
+  ::close(fd);
+  if (!mapping->Data)
+    return nullptr;
+#endif
+  return mapping;
+}
+}
+
+MemMapFile::FaultScope::FaultScope(MemMapFile& file)
+  : m_Mapping(file.m_Mapping.get())
+  , m_Start(GetThreadFaults())
+{
+}
+
+MemMapFile::FaultScope::~FaultScope()
+{
+  if (!m_Mapping)
+    return;
+  FaultStats end = GetThreadFaults();
+  m_Mapping->MinorFaults += end.MinorFaults - m_Start.MinorFaults;
+  m_Mapping->MajorFaults += end.MajorFaults - m_Start.MajorFaults;
+}
+
+MemMapFile::MemMapFile()
+  : m_TrackFaults(false)
+  , m_szFile(0)
   , m_pData(NULL)
+  , m_pCur(NULL)
 {
 }
 
@@ -285,100 +771,114 @@ MemMapFile::GetSize()
 bool
 MemMapFile::Open(const char* fileName, IOFlag mode)
 {
-  assert(mode == IORead);
+  return Open(fileName, mode, Options());
+}
 
+bool
+MemMapFile::Open(const char* fileName, IOFlag mode, Options const& options)
+{
+  assert(mode == IORead);
 #if K3DPLATFORM_OS_WIN
   wchar_t name_buf[1024];
   ::k3d::StringUtil::CharToWchar(fileName, name_buf, sizeof(name_buf));
-  m_FileHandle =
-    ::CreateFileW(name_buf,
-                  GENERIC_READ,
-                  FILE_SHARE_READ,
-                  NULL,
-                  OPEN_EXISTING,
-                  FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
-                  NULL);
-  if (m_FileHandle == INVALID_HANDLE_VALUE)
-    return false;
-
-  m_szFile = ::GetFileSize(m_FileHandle, NULL);
-  if (m_szFile == INVALID_FILE_SIZE)
-    return false;
-
-  m_FileMappingHandle =
-    ::CreateFileMapping(m_FileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
-  if (m_FileMappingHandle == INVALID_HANDLE_VALUE)
-    return false;
-
-  m_pData =
-    (unsigned char*)MapViewOfFile(m_FileMappingHandle, FILE_MAP_READ, 0, 0, 0);
-  if (m_pData == NULL)
-    return false;
+  return Open(::kString(name_buf), options);
 #else
-  m_Fd = open(fileName, O_RDONLY);
-  if (m_Fd == -1)
-    return false;
-
-  struct stat st;
-  if (fstat(m_Fd, &st) != 0)
-    return false;
-
-  m_szFile = st.st_size;
-  if (st.st_size == 0)
-    return false;
-
-  m_pData =
-    (unsigned char*)mmap(NULL, m_szFile, PROT_READ, MAP_PRIVATE, m_Fd, 0);
-  if (m_pData == MAP_FAILED)
-    return false;
+  return Open(::kString(fileName), options);
 #endif
-  m_pCur = m_pData;
-  return true;
 }
 
 #if K3DPLATFORM_OS_WIN
 bool
 MemMapFile::Open(const WCHAR* fileName, IOFlag flag)
 {
-  m_FileHandle =
-    ::CreateFileW(fileName,
-                  GENERIC_READ,
-                  FILE_SHARE_READ,
-                  NULL,
-                  OPEN_EXISTING,
-                  FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
-                  NULL);
-  if (m_FileHandle == INVALID_HANDLE_VALUE)
-    return false;
-
-  m_szFile = ::GetFileSize(m_FileHandle, NULL);
-  if (m_szFile == INVALID_FILE_SIZE)
-    return false;
+  return Open(fileName, flag, Options());
+}
 
-  m_FileMappingHandle =
-    ::CreateFileMapping(m_FileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
-  if (m_FileMappingHandle == INVALID_HANDLE_VALUE)
-    return false;
+bool
+MemMapFile::Open(const WCHAR* fileName, IOFlag flag, Options const& options)
+{
+  assert(flag == IORead);
+  return Open(::kString(fileName), options);
+}
+#endif
 
-  m_pData =
-    (unsigned char*)MapViewOfFile(m_FileMappingHandle, FILE_MAP_READ, 0, 0, 0);
-  if (m_pData == NULL)
-    return false;
+bool
+MemMapFile::Open(::kString const& path, Options const& options)
+{
+  Close();
+  std::shared_ptr<MemMapping> mapping;
+  if (options.Shared) {
+    MappingCache& cache = GetMappingCache();
+    {
+      std::lock_guard<std::mutex> lock(cache.Lock);
+      auto iter = cache.Mappings.find(path);
+      if (iter != cache.Mappings.end())
+        mapping = iter->second.lock();
+    }
+    if (mapping && !IsMappingCurrent(path, *mapping))
+      mapping.reset();
+    if (mapping) {
+      m_Mapping = mapping;
+      m_pData = mapping->Data;
+      m_szFile = mapping->Size;
+#if defined(MADV_POPULATE_READ)
+      if (options.Populate)
+        ::madvise(m_pData, m_szFile, MADV_POPULATE_READ);
+#else
+      if (options.Populate)
+        Advise(Advice::WillNeed);
+#endif
+    } else {
+      // mapped unlocked, a racing open of the same path may win
+      mapping = CreateMapping(path, options);
+      if (!mapping)
+        return false;
+      std::lock_guard<std::mutex> lock(cache.Lock);
+      auto& slot = cache.Mappings[path];
+      auto existing = slot.lock();
+      if (existing && existing->FileId == mapping->FileId &&
+          existing->ModifyTime == mapping->ModifyTime &&
+          existing->Size == mapping->Size) {
+        mapping = existing;
+      } else {
+        slot = mapping;
+      }
+      for (auto it = cache.Mappings.begin(); it != cache.Mappings.end();) {
+        if (it->second.expired())
+          it = cache.Mappings.erase(it);
+        else
+          ++it;
+      }
+    }
+  } else {
+    mapping = CreateMapping(path, options);
+    if (!mapping)
+      return false;
+  }
+  m_Mapping = mapping;
+  m_pData = mapping->Data;
+  m_szFile = mapping->Size;
+  m_pCur = m_pData;
+  m_TrackFaults = options.TrackFaults;
+  if (options.Hint != Advice::Normal)
+    Advise(options.Hint);
   return true;
 }
-#endif
+
 size_t
 MemMapFile::Read(char* data_ptr, size_t len)
 {
   size_t bytes_to_end = m_szFile - (m_pCur - m_pData);
-  if (len <= bytes_to_end) {
-    memcpy(data_ptr, m_pCur, len);
-    m_pCur += len;
-    return len;
+  size_t count = len <= bytes_to_end ? len : bytes_to_end;
+  if (m_TrackFaults) {
+    // fault the source in first, so faults on 'data_ptr' during the copy
+    // are not accounted to the mapping
+    FaultScope scope(*this);
+    TouchPages(m_pCur, count);
   }
-  memcpy(data_ptr, m_pCur, bytes_to_end);
-  m_pCur += bytes_to_end;
-  return bytes_to_end;
+  memcpy(data_ptr, m_pCur, count);
+  m_pCur += count;
+  return count;
 }
 
 size_t
@@ -420,22 +920,123 @@ MemMapFile::Flush()
 void
 MemMapFile::Close()
 {
+  // unmapped with the last reference
+  m_Mapping.reset();
+  m_pData = nullptr;
+  m_pCur = nullptr;
+  m_szFile = 0;
+}
+
+bool
+MemMapFile::Advise(Advice advice, size_t offset, size_t len)
+{
+  if (!m_pData || offset >= m_szFile)
+    return false;
+  if (len == 0 || offset + len > m_szFile)
+    len = m_szFile - offset;
 #if K3DPLATFORM_OS_WIN
-  if (m_pData) {
-    UnmapViewOfFile(m_pData);
-    m_pData = nullptr;
+  // views have no access pattern hints, only prefetch
+  if (advice == Advice::WillNeed)
+    return Prefetch(offset, len);
+  return true;
+#else
+  int native = MADV_NORMAL;
+  switch (advice) {
+    case Advice::Sequential:
+      native = MADV_SEQUENTIAL;
+      break;
+    case Advice::Random:
+      native = MADV_RANDOM;
+      break;
+    case Advice::WillNeed:
+      native = MADV_WILLNEED;
+      break;
+    case Advice::DontNeed:
+      native = MADV_DONTNEED;
+      break;
+    default:
+      break;
   }
-  if (m_FileMappingHandle) {
-    CloseHandle(m_FileMappingHandle);
-    m_FileMappingHandle = NULL;
+  // madvise wants a page aligned start
+  uintptr_t page = (uintptr_t)::sysconf(_SC_PAGESIZE);
+  uintptr_t begin = (uintptr_t)(m_pData + offset) & ~(page - 1);
+  uintptr_t end = (uintptr_t)(m_pData + offset + len);
+  return ::madvise((void*)begin, end - begin, native) == 0;
+#endif
+}
+
+bool
+MemMapFile::Prefetch(size_t offset, size_t len)
+{
+#if K3DPLATFORM_OS_WIN
+  if (!m_pData || offset >= m_szFile)
+    return false;
+  if (len == 0 || offset + len > m_szFile)
+    len = m_szFile - offset;
+#if _WIN32_WINNT >= 0x0602
+  WIN32_MEMORY_RANGE_ENTRY range = { m_pData + offset, len };
+  return ::PrefetchVirtualMemory(::GetCurrentProcess(), 1, &range, 0) != FALSE;
+#else
+  return false;
+#endif
+#else
+  return Advise(Advice::WillNeed, offset, len);
+#endif
+}
+
+MemMapFile::FaultStats
+MemMapFile::GetFaultStats() const
+{
+  FaultStats stats = { 0, 0 };
+  if (m_Mapping) {
+    stats.MinorFaults = m_Mapping->MinorFaults.load();
+    stats.MajorFaults = m_Mapping->MajorFaults.load();
   }
+  return stats;
+}
+
+size_t
+MemMapFile::GetResidentBytes() const
+{
+#if K3DPLATFORM_OS_WIN
+  // not tracked on windows
+  return 0;
 #else
-  // TODO : need fix
-  munmap(m_pData, m_szFile);
-  close(m_Fd);
+  if (!m_pData)
+    return 0;
+  size_t page = (size_t)::sysconf(_SC_PAGESIZE);
+  size_t numPages = (m_szFile + page - 1) / page;
+#if K3DPLATFORM_OS_LINUX
+  std::vector<unsigned char> residency(numPages);
+#else
+  std::vector<char> residency(numPages);
+#endif
+  if (::mincore(m_pData, m_szFile, residency.data()) != 0)
+    return 0;
+  size_t numResident = 0;
+  for (auto r : residency)
+    numResident += r & 1;
+  return std::min(numResident * page, m_szFile);
 #endif
 }
 
+bool
+MemMapFile::IsHugePageAligned() const
+{
+  return m_Mapping && m_Mapping->HugePageAligned;
+}
+
+uint32
+MemMapFile::GetNumSharedMappings()
+{
+  MappingCache& cache = GetMappingCache();
+  std::lock_guard<std::mutex> lock(cache.Lock);
+  uint32 count = 0;
+  for (auto& entry : cache.Mappings)
+    count += entry.second.expired() ? 0 : 1;
+  return count;
+}
+
 MemMapFile*
 MemMapFile::CreateIOInterface()
 {
@@ -479,7 +1080,8 @@ Exists(const ::k3d::kchar* name)
 #if K3DPLATFORM_OS_WIN
   return TRUE == PathFileExistsW(name);
 #else
-  return false;
+  struct stat st;
+  return stat(name, &st) == 0;
 #endif
 }
 
@@ -493,6 +1095,16 @@ Copy(const ::k3d::kchar* src, const ::k3d::kchar* target)
 #endif
 }
 
+bool
+Rename(const ::k3d::kchar* src, const ::k3d::kchar* target)
+{
+#if K3DPLATFORM_OS_WIN
+  return TRUE == MoveFileExW(src, target, MOVEFILE_REPLACE_EXISTING);
+#else
+  return rename(src, target) == 0;
+#endif
+}
+
 bool
 Remove(const ::k3d::kchar* lpszDir)
 {
@@ -503,6 +1115,9 @@ Remove(const ::k3d::kchar* lpszDir)
   if (PathFileExistsW(lpszDir) != TRUE) {
     return FALSE;
   }
+  if (!(GetFileAttributesW(lpszDir) & FILE_ATTRIBUTE_DIRECTORY)) {
+    return DeleteFileW(lpszDir) != FALSE;
+  }
   WIN32_FIND_DATAW wfd = { 0 };
   WCHAR szFile[MAX_PATH] = { 0 };
   WCHAR szDelDir[MAX_PATH] = { 0 };
@@ -537,6 +1152,10 @@ Remove(const ::k3d::kchar* lpszDir)
   RemoveDirectoryW(szDelDir);
   return true;
 #else
+  struct stat st;
+  if (stat(lpszDir, &st) == 0 && !S_ISDIR(st.st_mode)) {
+    return unlink(lpszDir) == 0;
+  }
   DIR* d = opendir(lpszDir);
   size_t path_len = strlen(lpszDir);
   int r = -1;
@@ -559,7 +1178,7 @@ Remove(const ::k3d::kchar* lpszDir)
         snprintf(buf, len, "%s/%s", lpszDir, p->d_name);
         if (!stat(buf, &statbuf)) {
           if (S_ISDIR(statbuf.st_mode)) {
-            r2 = Remove(buf);
+            r2 = Remove(buf) ? 0 : -1;
           } else {
             r2 = unlink(buf);
           }
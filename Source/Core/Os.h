@@ -6,6 +6,7 @@
 #include <KTL/String.hpp>
 #include <functional>
 #include <map>
+#include <memory>
 
 /**
  * This module provides facilities on OS like:
@@ -15,6 +16,18 @@ namespace Os {
 class K3D_API File : public ::IIODevice
 {
 public:
+#ifdef K3DPLATFORM_OS_WIN
+  typedef HANDLE NativeHandle;
+#else
+  typedef int NativeHandle;
+#endif
+
+  struct IOVec
+  {
+    void* Data;
+    size_t Size;
+  };
+
   File();
   explicit File(const char* fileName);
 
@@ -32,6 +45,17 @@ public:
   size_t Read(char* ptr, size_t len);
   size_t Write(const void* ptr, size_t len);
 
+  /// positional IO, uses no file cursor and is safe to call from several
+  /// threads on one File
+  /// \return bytes transferred, short at the end of the file, size_t(-1) on error
+  size_t ReadAt(void* ptr, size_t len, uint64 offset);
+  size_t WriteAt(const void* ptr, size_t len, uint64 offset);
+  /// scatter read of the consecutive bytes at 'offset' into 'buffers'
+  size_t ReadV(const IOVec* buffers, uint32 count, uint64 offset);
+  /// copies a range of 'source' to 'offset', in the kernel (copy_file_range)
+  /// where possible
+  size_t CopyFrom(File& source, uint64 sourceOffset, size_t len, uint64 offset);
+
   bool Seek(size_t offset);
   bool Skip(size_t offset);
 
@@ -40,30 +64,96 @@ public:
 
   uint64 LastModified() const;
 
+  NativeHandle GetNativeHandle() const;
+  /// opened with IODirect, buffers, offsets and sizes are then multiples of
+  /// GetDirectAlignment()
+  bool IsDirect() const;
+
   static File* CreateIOInterface();
 
+  static size_t GetDirectAlignment();
+  static void* AllocateAligned(size_t size, size_t alignment);
+  static void FreeAligned(void* ptr);
+
 private:
 #ifdef K3DPLATFORM_OS_WIN
   HANDLE m_hFile;
 #else
   int m_fd;
 #endif
+  bool m_Direct;
   bool m_EOF;
   int64 m_CurOffset;
   const char* m_pFileName;
 };
 
+struct MemMapping;
+
 class K3D_API MemMapFile : public ::IIODevice
 {
 public:
+  /// paging hint of a range, see madvise
+  enum class Advice
+  {
+    Normal,
+    Sequential,
+    Random,
+    WillNeed,
+    DontNeed,
+  };
+
+  struct Options
+  {
+    /// prefault the page tables when mapping (MAP_POPULATE)
+    bool Populate;
+    /// align the mapping to 2MB and ask for transparent huge pages
+    bool HugePages;
+    /// reuse the process-wide mapping of the same path
+    bool Shared;
+    /// account page faults Read() takes on the mapping to it, faults on the
+    /// destination buffer are not counted
+    bool TrackFaults;
+    Advice Hint;
+
+    Options()
+      : Populate(false)
+      , HugePages(false)
+      , Shared(true)
+      , TrackFaults(false)
+      , Hint(Advice::Normal)
+    {
+    }
+  };
+
+  struct FaultStats
+  {
+    uint64 MinorFaults;
+    uint64 MajorFaults;
+  };
+
+  /// attributes the page faults of the current thread to a mapping while in scope,
+  /// for direct access through FileData()
+  class K3D_API FaultScope
+  {
+  public:
+    explicit FaultScope(MemMapFile& file);
+    ~FaultScope();
+
+  private:
+    MemMapping* m_Mapping;
+    FaultStats m_Start;
+  };
+
   MemMapFile();
   ~MemMapFile();
 
   int64 GetSize();
   //---------------------------------------------------------
   bool Open(const char* fileName, IOFlag mode);
+  bool Open(const char* fileName, IOFlag mode, Options const& options);
 #if K3DPLATFORM_OS_WIN
   bool Open(const WCHAR* fileName, IOFlag flag);
+  bool Open(const WCHAR* fileName, IOFlag flag, Options const& options);
 #endif
   size_t Read(char* data_ptr, size_t len);
   size_t Write(const void*, size_t);
@@ -94,18 +184,30 @@ public:
   }
   //---------------------------------------------------------
 
+  /// \param len 0 means up to the end of file
+  bool Advise(Advice advice, size_t offset = 0, size_t len = 0);
+  /// asynchronous read-ahead of a range
+  bool Prefetch(size_t offset, size_t len);
+
+  /// faults accounted to the mapping, shared by every MemMapFile on it
+  FaultStats GetFaultStats() const;
+  /// bytes of the mapping in the page cache (mincore)
+  size_t GetResidentBytes() const;
+  bool IsHugePageAligned() const;
+
+  /// number of live mappings in the process-wide cache
+  static uint32 GetNumSharedMappings();
+
   /// General Interface For GetIODevice
   /// \brief CreateIOInterface
   /// \return An IIODevice Pointer
   static MemMapFile* CreateIOInterface();
 
 private:
-#ifdef K3DPLATFORM_OS_WIN
-  HANDLE m_FileHandle;
-  HANDLE m_FileMappingHandle;
-#else
-  int m_Fd;
-#endif
+  bool Open(::kString const& path, Options const& options);
+
+  std::shared_ptr<MemMapping> m_Mapping;
+  bool m_TrackFaults;
   size_t m_szFile;
   kByte* m_pData;
   kByte* m_pCur;
@@ -121,6 +223,9 @@ extern K3D_API void
 Sleep(uint32 ms);
 extern K3D_API bool
 Copy(const ::k3d::kchar* src, const ::k3d::kchar* target);
+/// replaces 'target' if it exists, atomic within one file system
+extern K3D_API bool
+Rename(const ::k3d::kchar* src, const ::k3d::kchar* target);
 extern K3D_API bool
 Remove(const ::k3d::kchar* name);
 typedef void (*PFN_FileProcessRoutine)(const ::k3d::kchar* path, bool isDir);
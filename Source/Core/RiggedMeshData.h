@@ -20,6 +20,9 @@ namespace k3d
 		RiggedMeshData();
 		~RiggedMeshData();
 
+		int						GetVertexNum() const { return m_NumVertices; }
+		Vertex3F3F2F4F4I *		GetRiggedVertexBuffer() const { return m_RiggedVertexBuffer; }
+
 	private:
 
 		bool                    m_IsLoaded;
@@ -0,0 +1,481 @@
+#include "Kaleido3D.h"
+#include "Skinning.h"
+#include "Dispatch/ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define K3D_SKINNING_SSE2 1
+#include <emmintrin.h>
+#if defined(__AVX2__)
+#define K3D_SKINNING_AVX2 1
+#include <immintrin.h>
+#endif
+#endif
+
+namespace k3d
+{
+	namespace Skinning
+	{
+		namespace
+		{
+			/// vertices of a task, a multiple of every kernel width
+			const uint32 kVertexGrain = 1024;
+			const uint32 kPadding = 8;
+			/// floats per bone of a prepared palette, the upper 3 rows of each column
+			const uint32 kMatrixFloats = 12;
+			const uint32 kDualQuatFloats = 8;
+
+			/// \brief unit rotation and dual part (x, y, z, w each) of a rigid
+			/// column major matrix, its scale removed
+			void ToDualQuaternion(const float * m, float * dq)
+			{
+				float r[3][3];
+				for (int c = 0; c < 3; c++)
+				{
+					float length = sqrtf(m[c * 4] * m[c * 4] + m[c * 4 + 1] * m[c * 4 + 1] + m[c * 4 + 2] * m[c * 4 + 2]);
+					float scale = length > 0.0f ? 1.0f / length : 0.0f;
+					for (int row = 0; row < 3; row++)
+						r[row][c] = m[c * 4 + row] * scale;
+				}
+				float x, y, z, w, trace = r[0][0] + r[1][1] + r[2][2];
+				if (trace > 0.0f)
+				{
+					float s = sqrtf(trace + 1.0f) * 2.0f;
+					w = 0.25f * s;
+					x = (r[2][1] - r[1][2]) / s;
+					y = (r[0][2] - r[2][0]) / s;
+					z = (r[1][0] - r[0][1]) / s;
+				}
+				else if (r[0][0] > r[1][1] && r[0][0] > r[2][2])
+				{
+					float s = sqrtf(1.0f + r[0][0] - r[1][1] - r[2][2]) * 2.0f;
+					w = (r[2][1] - r[1][2]) / s;
+					x = 0.25f * s;
+					y = (r[0][1] + r[1][0]) / s;
+					z = (r[0][2] + r[2][0]) / s;
+				}
+				else if (r[1][1] > r[2][2])
+				{
+					float s = sqrtf(1.0f + r[1][1] - r[0][0] - r[2][2]) * 2.0f;
+					w = (r[0][2] - r[2][0]) / s;
+					x = (r[0][1] + r[1][0]) / s;
+					y = 0.25f * s;
+					z = (r[1][2] + r[2][1]) / s;
+				}
+				else
+				{
+					float s = sqrtf(1.0f + r[2][2] - r[0][0] - r[1][1]) * 2.0f;
+					w = (r[1][0] - r[0][1]) / s;
+					x = (r[0][2] + r[2][0]) / s;
+					y = (r[1][2] + r[2][1]) / s;
+					z = 0.25f * s;
+				}
+				float norm = 1.0f / sqrtf(x * x + y * y + z * z + w * w);
+				x *= norm; y *= norm; z *= norm; w *= norm;
+				// dual part 0.5 * (t, 0) * q
+				float tx = m[12], ty = m[13], tz = m[14];
+				dq[0] = x; dq[1] = y; dq[2] = z; dq[3] = w;
+				dq[4] = 0.5f * (w * tx + ty * z - tz * y);
+				dq[5] = 0.5f * (w * ty + tz * x - tx * z);
+				dq[6] = 0.5f * (w * tz + tx * y - ty * x);
+				dq[7] = -0.5f * (tx * x + ty * y + tz * z);
+			}
+
+#if K3D_SKINNING_SSE2
+			/// 4 lanes, gathers by transposing the rows of 4 bones
+			struct Sse
+			{
+				typedef __m128 F;
+				static const uint32 Width = 4;
+				static F Load(const float * p) { return _mm_loadu_ps(p); }
+				static void Store(float * p, F v) { _mm_storeu_ps(p, v); }
+				static F Zero() { return _mm_setzero_ps(); }
+				static F Splat(float v) { return _mm_set1_ps(v); }
+				static F Add(F a, F b) { return _mm_add_ps(a, b); }
+				static F Sub(F a, F b) { return _mm_sub_ps(a, b); }
+				static F Mul(F a, F b) { return _mm_mul_ps(a, b); }
+				static F Div(F a, F b) { return _mm_div_ps(a, b); }
+				static F Sqrt(F a) { return _mm_sqrt_ps(a); }
+				static F Negate(F a) { return _mm_xor_ps(a, _mm_set1_ps(-0.0f)); }
+				/// b where a < 0
+				static F SelectNegative(F a, F b, F c) { F mask = _mm_cmplt_ps(a, _mm_setzero_ps()); return _mm_or_ps(_mm_and_ps(mask, b), _mm_andnot_ps(mask, c)); }
+				static F SelectPositive(F a, F b, F c) { F mask = _mm_cmpgt_ps(a, _mm_setzero_ps()); return _mm_or_ps(_mm_and_ps(mask, b), _mm_andnot_ps(mask, c)); }
+				static bool AnyNonZero(F a) { return _mm_movemask_ps(_mm_cmpneq_ps(a, _mm_setzero_ps())) != 0; }
+
+				/// element i < count of the 'floats' floats of each lane's bone to rows[i], count a multiple of 4
+				static void Gather(const float * palette, uint32 floats, const uint32 * bones, uint32 count, F * rows)
+				{
+					const float * p0 = palette + bones[0] * floats, * p1 = palette + bones[1] * floats;
+					const float * p2 = palette + bones[2] * floats, * p3 = palette + bones[3] * floats;
+					for (uint32 i = 0; i < count; i += 4)
+					{
+						F a = _mm_loadu_ps(p0 + i), b = _mm_loadu_ps(p1 + i), c = _mm_loadu_ps(p2 + i), d = _mm_loadu_ps(p3 + i);
+						_MM_TRANSPOSE4_PS(a, b, c, d);
+						rows[i] = a;
+						rows[i + 1] = b;
+						rows[i + 2] = c;
+						rows[i + 3] = d;
+					}
+				}
+			};
+#endif
+
+#if K3D_SKINNING_AVX2
+			/// 8 lanes, hardware gathers
+			struct Avx
+			{
+				typedef __m256 F;
+				static const uint32 Width = 8;
+				static F Load(const float * p) { return _mm256_loadu_ps(p); }
+				static void Store(float * p, F v) { _mm256_storeu_ps(p, v); }
+				static F Zero() { return _mm256_setzero_ps(); }
+				static F Splat(float v) { return _mm256_set1_ps(v); }
+				static F Add(F a, F b) { return _mm256_add_ps(a, b); }
+				static F Sub(F a, F b) { return _mm256_sub_ps(a, b); }
+				static F Mul(F a, F b) { return _mm256_mul_ps(a, b); }
+				static F Div(F a, F b) { return _mm256_div_ps(a, b); }
+				static F Sqrt(F a) { return _mm256_sqrt_ps(a); }
+				static F Negate(F a) { return _mm256_xor_ps(a, _mm256_set1_ps(-0.0f)); }
+				static F SelectNegative(F a, F b, F c) { return _mm256_blendv_ps(c, b, _mm256_cmp_ps(a, _mm256_setzero_ps(), _CMP_LT_OQ)); }
+				static F SelectPositive(F a, F b, F c) { return _mm256_blendv_ps(c, b, _mm256_cmp_ps(a, _mm256_setzero_ps(), _CMP_GT_OQ)); }
+				static bool AnyNonZero(F a) { return _mm256_movemask_ps(_mm256_cmp_ps(a, _mm256_setzero_ps(), _CMP_NEQ_UQ)) != 0; }
+
+				static void Gather(const float * palette, uint32 floats, const uint32 * bones, uint32 count, F * rows)
+				{
+					__m256i index = _mm256_mullo_epi32(_mm256_loadu_si256((const __m256i *)bones), _mm256_set1_epi32((int)floats));
+					for (uint32 i = 0; i < count; i++)
+						rows[i] = _mm256_i32gather_ps(palette + i, index, 4);
+				}
+			};
+#endif
+		}
+
+		/// \brief the kernels, on vertices [begin, end) of the padded streams.
+		/// SIMD and scalar kernels take the same steps in the same order.
+		struct Kernels
+		{
+			static void LinearScalar(Mesh const& mesh, const float * palette, Output & out, uint32 begin, uint32 end)
+			{
+				for (uint32 v = begin; v < end; v++)
+				{
+					float m[12] = {};
+					for (uint32 k = 0; k < 4; k++)
+					{
+						float w = mesh.m_Weights[k][v];
+						if (w == 0.0f)
+							continue;
+						const float * bone = palette + mesh.m_Bones[k][v] * kMatrixFloats;
+						for (uint32 c = 0; c < 4; c++)
+							for (uint32 r = 0; r < 3; r++)
+								m[c * 3 + r] = m[c * 3 + r] + w * bone[c * 3 + r];
+					}
+					float x = mesh.m_PosX[v], y = mesh.m_PosY[v], z = mesh.m_PosZ[v];
+					out.PosX[v] = m[0] * x + m[3] * y + m[6] * z + m[9];
+					out.PosY[v] = m[1] * x + m[4] * y + m[7] * z + m[10];
+					out.PosZ[v] = m[2] * x + m[5] * y + m[8] * z + m[11];
+					x = mesh.m_NorX[v], y = mesh.m_NorY[v], z = mesh.m_NorZ[v];
+					float nx = m[0] * x + m[3] * y + m[6] * z;
+					float ny = m[1] * x + m[4] * y + m[7] * z;
+					float nz = m[2] * x + m[5] * y + m[8] * z;
+					StoreNormal(out, v, nx, ny, nz);
+				}
+			}
+
+			static void DualQuaternionScalar(Mesh const& mesh, const float * palette, Output & out, uint32 begin, uint32 end)
+			{
+				for (uint32 v = begin; v < end; v++)
+				{
+					// blended in the hemisphere of the first bone
+					const float * first = palette + mesh.m_Bones[0][v] * kDualQuatFloats;
+					float b[8] = {};
+					for (uint32 k = 0; k < 4; k++)
+					{
+						float w = mesh.m_Weights[k][v];
+						if (w == 0.0f)
+							continue;
+						const float * dq = palette + mesh.m_Bones[k][v] * kDualQuatFloats;
+						float dot = dq[0] * first[0] + dq[1] * first[1] + dq[2] * first[2] + dq[3] * first[3];
+						float s = dot < 0.0f ? -w : w;
+						for (uint32 i = 0; i < 8; i++)
+							b[i] = b[i] + s * dq[i];
+					}
+					float length = sqrtf(b[0] * b[0] + b[1] * b[1] + b[2] * b[2] + b[3] * b[3]);
+					for (uint32 i = 0; i < 8; i++)
+						b[i] = b[i] / length;
+					float p[3], n[3];
+					Rotate(b, mesh.m_PosX[v], mesh.m_PosY[v], mesh.m_PosZ[v], p);
+					Rotate(b, mesh.m_NorX[v], mesh.m_NorY[v], mesh.m_NorZ[v], n);
+					// translation 2 * (w e - e_w r + r x e)
+					out.PosX[v] = p[0] + 2.0f * (b[3] * b[4] - b[7] * b[0] + (b[1] * b[6] - b[2] * b[5]));
+					out.PosY[v] = p[1] + 2.0f * (b[3] * b[5] - b[7] * b[1] + (b[2] * b[4] - b[0] * b[6]));
+					out.PosZ[v] = p[2] + 2.0f * (b[3] * b[6] - b[7] * b[2] + (b[0] * b[5] - b[1] * b[4]));
+					StoreNormal(out, v, n[0], n[1], n[2]);
+				}
+			}
+
+			/// p + 2 r x (r x p + w p) for the unit rotation 'q'
+			static void Rotate(const float * q, float x, float y, float z, float * result)
+			{
+				float tx = (q[1] * z - q[2] * y) + q[3] * x;
+				float ty = (q[2] * x - q[0] * z) + q[3] * y;
+				float tz = (q[0] * y - q[1] * x) + q[3] * z;
+				result[0] = x + 2.0f * (q[1] * tz - q[2] * ty);
+				result[1] = y + 2.0f * (q[2] * tx - q[0] * tz);
+				result[2] = z + 2.0f * (q[0] * ty - q[1] * tx);
+			}
+
+			static void StoreNormal(Output & out, uint32 v, float x, float y, float z)
+			{
+				float length = sqrtf(x * x + y * y + z * z);
+				if (length > 0.0f)
+				{
+					x = x / length;
+					y = y / length;
+					z = z / length;
+				}
+				out.NorX[v] = x;
+				out.NorY[v] = y;
+				out.NorZ[v] = z;
+			}
+
+#if K3D_SKINNING_SSE2
+			template <class V>
+			static void StoreNormal(Output & out, uint32 v, typename V::F x, typename V::F y, typename V::F z)
+			{
+				typedef typename V::F F;
+				F length = V::Sqrt(V::Add(V::Add(V::Mul(x, x), V::Mul(y, y)), V::Mul(z, z)));
+				V::Store(&out.NorX[v], V::SelectPositive(length, V::Div(x, length), x));
+				V::Store(&out.NorY[v], V::SelectPositive(length, V::Div(y, length), y));
+				V::Store(&out.NorZ[v], V::SelectPositive(length, V::Div(z, length), z));
+			}
+
+			template <class V>
+			static void Linear(Mesh const& mesh, const float * palette, Output & out, uint32 begin, uint32 end)
+			{
+				typedef typename V::F F;
+				for (uint32 v = begin; v < end; v += V::Width)
+				{
+					F m[12], rows[12];
+					for (uint32 i = 0; i < 12; i++)
+						m[i] = V::Zero();
+					for (uint32 k = 0; k < 4; k++)
+					{
+						F w = V::Load(&mesh.m_Weights[k][v]);
+						// most vertices have fewer than 4 bones
+						if (!V::AnyNonZero(w))
+							continue;
+						V::Gather(palette, kMatrixFloats, &mesh.m_Bones[k][v], kMatrixFloats, rows);
+						for (uint32 i = 0; i < 12; i++)
+							m[i] = V::Add(m[i], V::Mul(w, rows[i]));
+					}
+					F x = V::Load(&mesh.m_PosX[v]), y = V::Load(&mesh.m_PosY[v]), z = V::Load(&mesh.m_PosZ[v]);
+					for (uint32 r = 0; r < 3; r++)
+					{
+						F p = V::Add(V::Add(V::Add(V::Mul(m[r], x), V::Mul(m[3 + r], y)), V::Mul(m[6 + r], z)), m[9 + r]);
+						V::Store(r == 0 ? &out.PosX[v] : r == 1 ? &out.PosY[v] : &out.PosZ[v], p);
+					}
+					x = V::Load(&mesh.m_NorX[v]), y = V::Load(&mesh.m_NorY[v]), z = V::Load(&mesh.m_NorZ[v]);
+					F n[3];
+					for (uint32 r = 0; r < 3; r++)
+						n[r] = V::Add(V::Add(V::Mul(m[r], x), V::Mul(m[3 + r], y)), V::Mul(m[6 + r], z));
+					StoreNormal<V>(out, v, n[0], n[1], n[2]);
+				}
+			}
+
+			template <class V>
+			static void Rotate(typename V::F const * q, typename V::F x, typename V::F y, typename V::F z, typename V::F * result)
+			{
+				typedef typename V::F F;
+				F two = V::Splat(2.0f);
+				F tx = V::Add(V::Sub(V::Mul(q[1], z), V::Mul(q[2], y)), V::Mul(q[3], x));
+				F ty = V::Add(V::Sub(V::Mul(q[2], x), V::Mul(q[0], z)), V::Mul(q[3], y));
+				F tz = V::Add(V::Sub(V::Mul(q[0], y), V::Mul(q[1], x)), V::Mul(q[3], z));
+				result[0] = V::Add(x, V::Mul(two, V::Sub(V::Mul(q[1], tz), V::Mul(q[2], ty))));
+				result[1] = V::Add(y, V::Mul(two, V::Sub(V::Mul(q[2], tx), V::Mul(q[0], tz))));
+				result[2] = V::Add(z, V::Mul(two, V::Sub(V::Mul(q[0], ty), V::Mul(q[1], tx))));
+			}
+
+			template <class V>
+			static void DualQuaternion(Mesh const& mesh, const float * palette, Output & out, uint32 begin, uint32 end)
+			{
+				typedef typename V::F F;
+				for (uint32 v = begin; v < end; v += V::Width)
+				{
+					F b[8], first[8], dq[8];
+					for (uint32 i = 0; i < 8; i++)
+						b[i] = V::Zero();
+					V::Gather(palette, kDualQuatFloats, &mesh.m_Bones[0][v], 4, first);
+					for (uint32 k = 0; k < 4; k++)
+					{
+						F w = V::Load(&mesh.m_Weights[k][v]);
+						if (!V::AnyNonZero(w))
+							continue;
+						V::Gather(palette, kDualQuatFloats, &mesh.m_Bones[k][v], 8, dq);
+						F dot = V::Add(V::Add(V::Add(V::Mul(dq[0], first[0]), V::Mul(dq[1], first[1])), V::Mul(dq[2], first[2])), V::Mul(dq[3], first[3]));
+						F s = V::SelectNegative(dot, V::Negate(w), w);
+						for (uint32 i = 0; i < 8; i++)
+							b[i] = V::Add(b[i], V::Mul(s, dq[i]));
+					}
+					F length = V::Sqrt(V::Add(V::Add(V::Add(V::Mul(b[0], b[0]), V::Mul(b[1], b[1])), V::Mul(b[2], b[2])), V::Mul(b[3], b[3])));
+					for (uint32 i = 0; i < 8; i++)
+						b[i] = V::Div(b[i], length);
+					F p[3], n[3], two = V::Splat(2.0f);
+					Rotate<V>(b, V::Load(&mesh.m_PosX[v]), V::Load(&mesh.m_PosY[v]), V::Load(&mesh.m_PosZ[v]), p);
+					Rotate<V>(b, V::Load(&mesh.m_NorX[v]), V::Load(&mesh.m_NorY[v]), V::Load(&mesh.m_NorZ[v]), n);
+					V::Store(&out.PosX[v], V::Add(p[0], V::Mul(two, V::Add(V::Sub(V::Mul(b[3], b[4]), V::Mul(b[7], b[0])), V::Sub(V::Mul(b[1], b[6]), V::Mul(b[2], b[5]))))));
+					V::Store(&out.PosY[v], V::Add(p[1], V::Mul(two, V::Add(V::Sub(V::Mul(b[3], b[5]), V::Mul(b[7], b[1])), V::Sub(V::Mul(b[2], b[4]), V::Mul(b[0], b[6]))))));
+					V::Store(&out.PosZ[v], V::Add(p[2], V::Mul(two, V::Add(V::Sub(V::Mul(b[3], b[6]), V::Mul(b[7], b[2])), V::Sub(V::Mul(b[0], b[5]), V::Mul(b[1], b[4]))))));
+					StoreNormal<V>(out, v, n[0], n[1], n[2]);
+				}
+			}
+#endif
+		};
+
+		Mesh::Mesh()
+			: m_NumVertices(0)
+			, m_MaxBone(0)
+		{
+		}
+
+		void Mesh::Build(const Vertex3F3F2F4F4I * vertices, uint32 count)
+		{
+			uint32 size = (count + kPadding - 1) / kPadding * kPadding;
+			m_NumVertices = count;
+			m_MaxBone = 0;
+			for (std::vector<float> * stream : { &m_PosX, &m_PosY, &m_PosZ, &m_NorX, &m_NorY, &m_NorZ })
+				stream->assign(size, 0.0f);
+			for (uint32 k = 0; k < 4; k++)
+			{
+				m_Weights[k].assign(size, 0.0f);
+				m_Bones[k].assign(size, 0);
+			}
+			for (uint32 v = 0; v < count; v++)
+			{
+				Vertex3F3F2F4F4I const& vertex = vertices[v];
+				m_PosX[v] = vertex.PosX;
+				m_PosY[v] = vertex.PosY;
+				m_PosZ[v] = vertex.PosZ;
+				m_NorX[v] = vertex.NorX;
+				m_NorY[v] = vertex.NorY;
+				m_NorZ[v] = vertex.NorZ;
+				float sum = 0.0f;
+				for (uint32 k = 0; k < 4; k++)
+					sum += std::max(vertex.BoneWeights[k], 0.0f);
+				for (uint32 k = 0; k < 4; k++)
+				{
+					float w = sum > 0.0f ? std::max(vertex.BoneWeights[k], 0.0f) / sum : 0.0f;
+					// unused slots point at bone 0, the kernels gather them anyway
+					m_Weights[k][v] = w;
+					m_Bones[k][v] = w > 0.0f ? vertex.BoneIDs[k] : 0;
+					m_MaxBone = std::max(m_MaxBone, m_Bones[k][v]);
+				}
+			}
+			// vertices without weight and the padding follow bone 0
+			for (uint32 v = 0; v < size; v++)
+			{
+				if (m_Weights[0][v] + m_Weights[1][v] + m_Weights[2][v] + m_Weights[3][v] == 0.0f)
+					m_Weights[0][v] = 1.0f;
+			}
+		}
+
+		void Mesh::Build(RiggedMeshData const& mesh)
+		{
+			Build(mesh.GetRiggedVertexBuffer(), (uint32)mesh.GetVertexNum());
+		}
+
+		bool Skin(Instance const * instances, uint32 count, Options const& options, Dispatch::ThreadPool * workers, Stats * stats)
+		{
+			auto start = std::chrono::high_resolution_clock::now();
+			bool dualQuaternion = options.Method == EMethod::DualQuaternion;
+			uint32 floats = dualQuaternion ? kDualQuatFloats : kMatrixFloats;
+			// palettes in the layout of the kernels
+			std::vector<std::vector<float>> palettes(count);
+			struct Task
+			{
+				uint32	Instance;
+				uint32	Begin;
+				uint32	End;
+			};
+			std::vector<Task> tasks;
+			uint64 vertices = 0;
+			for (uint32 i = 0; i < count; i++)
+			{
+				Instance const& instance = instances[i];
+				Mesh const& mesh = *instance.Source;
+				if (mesh.GetVertexNum() && mesh.GetMaxBone() >= instance.NumBones)
+					return false;
+				palettes[i].resize((size_t)instance.NumBones * floats);
+				for (uint32 bone = 0; bone < instance.NumBones; bone++)
+				{
+					const float * m = instance.Palette[bone];
+					if (dualQuaternion)
+						ToDualQuaternion(m, &palettes[i][bone * floats]);
+					else
+					{
+						for (uint32 c = 0; c < 4; c++)
+							std::copy(m + c * 4, m + c * 4 + 3, &palettes[i][bone * floats + c * 3]);
+					}
+				}
+				uint32 size = mesh.GetStreamSize();
+				Output & out = *instance.Target;
+				for (std::vector<float> * stream : { &out.PosX, &out.PosY, &out.PosZ, &out.NorX, &out.NorY, &out.NorZ })
+					stream->resize(size);
+				for (uint32 begin = 0; begin < size; begin += kVertexGrain)
+					tasks.push_back({ i, begin, std::min(begin + kVertexGrain, size) });
+				vertices += mesh.GetVertexNum();
+			}
+
+			Dispatch::ThreadPool & pool = workers ? *workers : Dispatch::ThreadPool::Global();
+			pool.ParallelFor(0, (uint32)tasks.size(), 1, [&](uint32 begin, uint32 end)
+			{
+				for (uint32 t = begin; t < end; t++)
+				{
+					Task const& task = tasks[t];
+					Mesh const& mesh = *instances[task.Instance].Source;
+					const float * palette = palettes[task.Instance].data();
+					Output & out = *instances[task.Instance].Target;
+#if K3D_SKINNING_SSE2
+					if (!options.Scalar)
+					{
+#if K3D_SKINNING_AVX2
+						typedef Avx V;
+#else
+						typedef Sse V;
+#endif
+						if (dualQuaternion)
+							Kernels::DualQuaternion<V>(mesh, palette, out, task.Begin, task.End);
+						else
+							Kernels::Linear<V>(mesh, palette, out, task.Begin, task.End);
+						continue;
+					}
+#endif
+					if (dualQuaternion)
+						Kernels::DualQuaternionScalar(mesh, palette, out, task.Begin, task.End);
+					else
+						Kernels::LinearScalar(mesh, palette, out, task.Begin, task.End);
+				}
+			});
+
+			if (stats)
+			{
+				stats->Vertices = vertices;
+				stats->Milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+			}
+			return true;
+		}
+
+		const char * GetKernel()
+		{
+#if K3D_SKINNING_AVX2
+			return "avx2";
+#elif K3D_SKINNING_SSE2
+			return "sse2";
+#else
+			return "scalar";
+#endif
+		}
+	}
+}
@@ -0,0 +1,103 @@
+#ifndef __Skinning_h__
+#define __Skinning_h__
+#pragma once
+
+#include "RiggedMeshData.h"
+#include <vector>
+
+namespace k3d
+{
+	/// CPU skinning of Vertex3F3F2F4F4I meshes by a palette of bone matrices.
+	/// Meshes are kept as structure of arrays so the kernels skin 4 (SSE2) or
+	/// 8 (AVX2) vertices at once; every instance of a batch is split into
+	/// chunks of vertices skinned in parallel on a thread pool.
+	namespace Skinning
+	{
+		enum class EMethod : uint32
+		{
+			/// blended matrices, scales and shears but collapses at twisted joints
+			Linear,
+			/// blended dual quaternions, keeps the volume of twisted joints; the
+			/// palette must be rigid, scale and shear are dropped
+			DualQuaternion,
+		};
+
+		struct Options
+		{
+			EMethod	Method;
+			/// the scalar reference kernels, for comparison
+			bool	Scalar;
+
+			Options()
+				: Method(EMethod::Linear)
+				, Scalar(false)
+			{
+			}
+		};
+
+		struct Stats
+		{
+			/// vertices skinned, all instances
+			uint64	Vertices;
+			double	Milliseconds;
+		};
+
+		/// \brief rest pose positions, normals and influences as structure of
+		/// arrays, padded to a multiple of 8 vertices bound to bone 0
+		class K3D_API Mesh
+		{
+		public:
+			Mesh();
+
+			/// weights are normalized, vertices without weight follow bone 0
+			void			Build(const Vertex3F3F2F4F4I * vertices, uint32 count);
+			void			Build(RiggedMeshData const& mesh);
+
+			uint32			GetVertexNum() const { return m_NumVertices; }
+			/// vertices including the padding
+			uint32			GetStreamSize() const { return (uint32)m_PosX.size(); }
+			/// a palette needs at least GetMaxBone() + 1 matrices
+			uint32			GetMaxBone() const { return m_MaxBone; }
+
+		private:
+			friend struct Kernels;
+
+			uint32				m_NumVertices;
+			uint32				m_MaxBone;
+			std::vector<float>	m_PosX, m_PosY, m_PosZ;
+			std::vector<float>	m_NorX, m_NorY, m_NorZ;
+			std::vector<float>	m_Weights[4];
+			std::vector<uint32>	m_Bones[4];
+		};
+
+		/// \brief skinned positions and unit normals as structure of arrays,
+		/// GetStreamSize() long
+		struct Output
+		{
+			std::vector<float>	PosX, PosY, PosZ;
+			std::vector<float>	NorX, NorY, NorZ;
+		};
+
+		struct Instance
+		{
+			Mesh const *			Source;
+			/// bone to model space, rest pose included; column major with the
+			/// translation in [3], as MakeTranslationMatrix builds them
+			const kMath::Mat4f *	Palette;
+			uint32					NumBones;
+			/// resized to the stream size of Source
+			Output *				Target;
+		};
+
+		/// \brief skins every instance.
+		/// \param workers the global pool if null
+		/// \return false if a palette has fewer bones than its mesh uses
+		K3D_API bool	Skin(Instance const * instances, uint32 count, Options const& options = Options(),
+			Dispatch::ThreadPool * workers = nullptr, Stats * stats = nullptr);
+
+		/// "avx2", "sse2" or "scalar"
+		K3D_API const char *	GetKernel();
+	}
+}
+
+#endif
@@ -0,0 +1,1332 @@
+#include "Kaleido3D.h"
+#include "TextureCompressor.h"
+#include "Dispatch/ThreadPool.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define K3D_BC_SSE2 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define K3D_BC_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace k3d
+{
+	namespace TextureCompressor
+	{
+		namespace
+		{
+			/// block rows of a task
+			const uint32 kRowGrain = 2;
+
+			/// BC7 interpolation weights out of 64
+			const uint32 kWeights2[4] = { 0, 21, 43, 64 };
+			const uint32 kWeights3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+			const uint32 kWeights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+			/// the texels of a 4x4 block by channel, 0 to 255
+			struct Block
+			{
+				float	Texels[4][16];
+			};
+
+			struct Settings
+			{
+				EQuality	Quality;
+				bool		Simd;
+				/// least squares passes
+				uint32		Iterations;
+			};
+
+			template <class T>
+			T Clamp(T value, T low, T high)
+			{
+				return value < low ? low : value > high ? high : value;
+			}
+
+			uint32 CountBits(uint32 mask)
+			{
+				uint32 count = 0;
+				for (; mask; mask &= mask - 1)
+					count++;
+				return count;
+			}
+
+			/// Nearest of 'count' palette entries to every texel over 'Channels'
+			/// channels from 'first'. 'errors' are the squared distances.
+			template <uint32 Channels>
+			void SelectIndices(Block const& block, uint32 first, const float (*palette)[4], uint32 count,
+				bool simd, uint8 indices[16], float errors[16])
+			{
+#if K3D_BC_SSE2
+				if (simd)
+				{
+					// all 16 texels against one entry at a time
+					__m128 texels[Channels][4], best[4];
+					__m128i bestIndex[4];
+					for (uint32 g = 0; g < 4; g++)
+					{
+						for (uint32 c = 0; c < Channels; c++)
+							texels[c][g] = _mm_loadu_ps(&block.Texels[first + c][g * 4]);
+						best[g] = _mm_set1_ps(FLT_MAX);
+						bestIndex[g] = _mm_setzero_si128();
+					}
+					for (uint32 k = 0; k < count; k++)
+					{
+						__m128 entry[Channels];
+						for (uint32 c = 0; c < Channels; c++)
+							entry[c] = _mm_set1_ps(palette[k][c]);
+						__m128i index = _mm_set1_epi32((int)k);
+						for (uint32 g = 0; g < 4; g++)
+						{
+							__m128 d = _mm_sub_ps(texels[0][g], entry[0]);
+							__m128 distance = _mm_mul_ps(d, d);
+							for (uint32 c = 1; c < Channels; c++)
+							{
+								d = _mm_sub_ps(texels[c][g], entry[c]);
+								distance = _mm_add_ps(distance, _mm_mul_ps(d, d));
+							}
+							__m128i closer = _mm_castps_si128(_mm_cmplt_ps(distance, best[g]));
+							best[g] = _mm_min_ps(distance, best[g]);
+							bestIndex[g] = _mm_or_si128(_mm_and_si128(closer, index), _mm_andnot_si128(closer, bestIndex[g]));
+						}
+					}
+					for (uint32 g = 0; g < 4; g++)
+						_mm_storeu_ps(errors + g * 4, best[g]);
+					__m128i packed = _mm_packs_epi32(bestIndex[0], bestIndex[1]);
+					packed = _mm_packus_epi16(packed, _mm_packs_epi32(bestIndex[2], bestIndex[3]));
+					_mm_storeu_si128((__m128i*)indices, packed);
+					return;
+				}
+#elif K3D_BC_NEON
+				if (simd)
+				{
+					float32x4_t texels[Channels][4], best[4];
+					uint32x4_t bestIndex[4];
+					for (uint32 g = 0; g < 4; g++)
+					{
+						for (uint32 c = 0; c < Channels; c++)
+							texels[c][g] = vld1q_f32(&block.Texels[first + c][g * 4]);
+						best[g] = vdupq_n_f32(FLT_MAX);
+						bestIndex[g] = vdupq_n_u32(0);
+					}
+					for (uint32 k = 0; k < count; k++)
+					{
+						float32x4_t entry[Channels];
+						for (uint32 c = 0; c < Channels; c++)
+							entry[c] = vdupq_n_f32(palette[k][c]);
+						uint32x4_t index = vdupq_n_u32(k);
+						for (uint32 g = 0; g < 4; g++)
+						{
+							float32x4_t d = vsubq_f32(texels[0][g], entry[0]);
+							float32x4_t distance = vmulq_f32(d, d);
+							for (uint32 c = 1; c < Channels; c++)
+							{
+								d = vsubq_f32(texels[c][g], entry[c]);
+								distance = vaddq_f32(distance, vmulq_f32(d, d));
+							}
+							uint32x4_t closer = vcltq_f32(distance, best[g]);
+							best[g] = vminq_f32(distance, best[g]);
+							bestIndex[g] = vbslq_u32(closer, index, bestIndex[g]);
+						}
+					}
+					for (uint32 g = 0; g < 4; g++)
+						vst1q_f32(errors + g * 4, best[g]);
+					uint16x8_t low = vcombine_u16(vmovn_u32(bestIndex[0]), vmovn_u32(bestIndex[1]));
+					uint16x8_t high = vcombine_u16(vmovn_u32(bestIndex[2]), vmovn_u32(bestIndex[3]));
+					vst1q_u8(indices, vcombine_u8(vmovn_u16(low), vmovn_u16(high)));
+					return;
+				}
+#endif
+				for (uint32 i = 0; i < 16; i++)
+				{
+					float best = FLT_MAX;
+					uint32 bestIndex = 0;
+					for (uint32 k = 0; k < count; k++)
+					{
+						float d = block.Texels[first][i] - palette[k][0];
+						float distance = d * d;
+						for (uint32 c = 1; c < Channels; c++)
+						{
+							d = block.Texels[first + c][i] - palette[k][c];
+							distance += d * d;
+						}
+						if (distance < best)
+						{
+							best = distance;
+							bestIndex = k;
+						}
+					}
+					errors[i] = best;
+					indices[i] = (uint8)bestIndex;
+				}
+			}
+
+			/// sum of the errors of the texels in 'mask'
+			float SumErrors(const float errors[16], uint32 mask)
+			{
+				float sum = 0.0f;
+				for (uint32 i = 0; i < 16; i++)
+				{
+					if (mask & (1 << i))
+						sum += errors[i];
+				}
+				return sum;
+			}
+
+			/// mean and principal axis of the texels in 'mask', power iterated
+			void PrincipalAxis(Block const& block, uint32 first, uint32 channels, uint32 mask, float mean[4], float axis[4])
+			{
+				float n = (float)std::max(CountBits(mask), 1u);
+				for (uint32 c = 0; c < channels; c++)
+				{
+					mean[c] = 0.0f;
+					for (uint32 i = 0; i < 16; i++)
+					{
+						if (mask & (1 << i))
+							mean[c] += block.Texels[first + c][i];
+					}
+					mean[c] /= n;
+				}
+				float covariance[4][4] = {};
+				for (uint32 i = 0; i < 16; i++)
+				{
+					if (!(mask & (1 << i)))
+						continue;
+					for (uint32 a = 0; a < channels; a++)
+					{
+						for (uint32 b = a; b < channels; b++)
+							covariance[a][b] += (block.Texels[first + a][i] - mean[a]) * (block.Texels[first + b][i] - mean[b]);
+					}
+				}
+				// start from the row of the largest variance, it isn't orthogonal to the axis
+				uint32 largest = 0;
+				for (uint32 a = 0; a < channels; a++)
+				{
+					for (uint32 b = 0; b < a; b++)
+						covariance[a][b] = covariance[b][a];
+					if (covariance[a][a] > covariance[largest][largest])
+						largest = a;
+				}
+				for (uint32 c = 0; c < channels; c++)
+					axis[c] = covariance[largest][c];
+				for (uint32 iteration = 0; iteration < 8; iteration++)
+				{
+					float next[4] = {}, length = 0.0f;
+					for (uint32 a = 0; a < channels; a++)
+					{
+						for (uint32 b = 0; b < channels; b++)
+							next[a] += covariance[a][b] * axis[b];
+						length += next[a] * next[a];
+					}
+					if (length < 1e-12f)
+						break;
+					length = 1.0f / sqrtf(length);
+					for (uint32 c = 0; c < channels; c++)
+						axis[c] = next[c] * length;
+				}
+				float length = 0.0f;
+				for (uint32 c = 0; c < channels; c++)
+					length += axis[c] * axis[c];
+				if (length < 1e-12f)
+				{
+					for (uint32 c = 0; c < channels; c++)
+						axis[c] = 0.0f;
+				}
+				else
+				{
+					length = 1.0f / sqrtf(length);
+					for (uint32 c = 0; c < channels; c++)
+						axis[c] *= length;
+				}
+			}
+
+			/// the texels of 'mask' at the ends of the principal axis
+			void AxisEndpoints(Block const& block, uint32 first, uint32 channels, uint32 mask, float e0[4], float e1[4])
+			{
+				float mean[4], axis[4];
+				PrincipalAxis(block, first, channels, mask, mean, axis);
+				float low = FLT_MAX, high = -FLT_MAX;
+				for (uint32 i = 0; i < 16; i++)
+				{
+					if (!(mask & (1 << i)))
+						continue;
+					float t = 0.0f;
+					for (uint32 c = 0; c < channels; c++)
+						t += (block.Texels[first + c][i] - mean[c]) * axis[c];
+					low = std::min(low, t);
+					high = std::max(high, t);
+				}
+				if (low > high)
+					low = high = 0.0f;
+				for (uint32 c = 0; c < channels; c++)
+				{
+					e0[c] = Clamp(mean[c] + axis[c] * low, 0.0f, 255.0f);
+					e1[c] = Clamp(mean[c] + axis[c] * high, 0.0f, 255.0f);
+				}
+			}
+
+			/// least squares endpoints for the texels in 'mask' at their index
+			/// weights, 0 at e0 and 1 at e1
+			bool SolveEndpoints(Block const& block, uint32 first, uint32 channels, uint32 mask,
+				const uint8 indices[16], const float * weights, float e0[4], float e1[4])
+			{
+				float aa = 0.0f, ab = 0.0f, bb = 0.0f, xa[4] = {}, xb[4] = {};
+				for (uint32 i = 0; i < 16; i++)
+				{
+					if (!(mask & (1 << i)))
+						continue;
+					float w = weights[indices[i]], v = 1.0f - w;
+					aa += v * v;
+					ab += v * w;
+					bb += w * w;
+					for (uint32 c = 0; c < channels; c++)
+					{
+						xa[c] += v * block.Texels[first + c][i];
+						xb[c] += w * block.Texels[first + c][i];
+					}
+				}
+				float determinant = aa * bb - ab * ab;
+				if (fabsf(determinant) < 1e-6f)
+					return false;
+				determinant = 1.0f / determinant;
+				for (uint32 c = 0; c < channels; c++)
+				{
+					e0[c] = Clamp((bb * xa[c] - ab * xb[c]) * determinant, 0.0f, 255.0f);
+					e1[c] = Clamp((aa * xb[c] - ab * xa[c]) * determinant, 0.0f, 255.0f);
+				}
+				return true;
+			}
+
+			struct BlockBits
+			{
+				uint64	Bits[2];
+				uint32	Position;
+
+				BlockBits()
+					: Position(0)
+				{
+					Bits[0] = Bits[1] = 0;
+				}
+
+				explicit BlockBits(const kByte * data)
+					: Position(0)
+				{
+					memcpy(Bits, data, sizeof(Bits));
+				}
+
+				void Put(uint32 value, uint32 count)
+				{
+					uint64 v = value & ((1ull << count) - 1);
+					if (Position < 64)
+					{
+						Bits[0] |= v << Position;
+						if (Position + count > 64)
+							Bits[1] |= v >> (64 - Position);
+					}
+					else
+						Bits[1] |= v << (Position - 64);
+					Position += count;
+				}
+
+				uint32 Get(uint32 count)
+				{
+					uint64 v;
+					if (Position >= 64)
+						v = Bits[1] >> (Position - 64);
+					else
+					{
+						v = Bits[0] >> Position;
+						if (Position + count > 64)
+							v |= Bits[1] << (64 - Position);
+					}
+					Position += count;
+					return (uint32)(v & ((1ull << count) - 1));
+				}
+			};
+
+			//-------------------------------------------------------------------
+			// BC1 colors
+
+			uint16 PackRGB565(const float color[3])
+			{
+				uint32 r = (uint32)(Clamp(color[0], 0.0f, 255.0f) * (31.0f / 255.0f) + 0.5f);
+				uint32 g = (uint32)(Clamp(color[1], 0.0f, 255.0f) * (63.0f / 255.0f) + 0.5f);
+				uint32 b = (uint32)(Clamp(color[2], 0.0f, 255.0f) * (31.0f / 255.0f) + 0.5f);
+				return (uint16)((r << 11) | (g << 5) | b);
+			}
+
+			void UnpackRGB565(uint16 color, uint32 rgb[3])
+			{
+				uint32 r = color >> 11, g = (color >> 5) & 63, b = color & 31;
+				rgb[0] = (r << 3) | (r >> 2);
+				rgb[1] = (g << 2) | (g >> 4);
+				rgb[2] = (b << 3) | (b >> 2);
+			}
+
+			/// the BC1 palette of two colors, 3 entries plus transparent black
+			/// for 'threeColors'
+			void BC1Palette(uint16 color0, uint16 color1, bool threeColors, uint32 palette[4][4])
+			{
+				uint32 c0[3], c1[3];
+				UnpackRGB565(color0, c0);
+				UnpackRGB565(color1, c1);
+				for (uint32 c = 0; c < 3; c++)
+				{
+					palette[0][c] = c0[c];
+					palette[1][c] = c1[c];
+					palette[2][c] = threeColors ? (c0[c] + c1[c]) / 2 : (2 * c0[c] + c1[c]) / 3;
+					palette[3][c] = threeColors ? 0 : (c0[c] + 2 * c1[c]) / 3;
+				}
+				palette[0][3] = palette[1][3] = palette[2][3] = 255;
+				palette[3][3] = threeColors ? 0 : 255;
+			}
+
+			struct ColorFit
+			{
+				uint16	Color0;
+				uint16	Color1;
+				bool	ThreeColors;
+				uint8	Indices[16];
+				float	Error;
+			};
+
+			/// the indices and error of the quantized endpoints of 'fit', texels out
+			/// of 'opaque' take the transparent index
+			void EvaluateColors(Block const& block, uint32 opaque, Settings const& settings, ColorFit & fit)
+			{
+				uint32 palette[4][4];
+				BC1Palette(fit.Color0, fit.Color1, fit.ThreeColors, palette);
+				float entries[4][4], errors[16];
+				for (uint32 k = 0; k < 4; k++)
+				{
+					for (uint32 c = 0; c < 3; c++)
+						entries[k][c] = (float)palette[k][c];
+				}
+				SelectIndices<3>(block, 0, entries, fit.ThreeColors ? 3 : 4, settings.Simd, fit.Indices, errors);
+				fit.Error = SumErrors(errors, opaque);
+				for (uint32 i = 0; i < 16; i++)
+				{
+					if (!(opaque & (1 << i)))
+						fit.Indices[i] = 3;
+				}
+			}
+
+			void SetColors(ColorFit & fit, const float e0[3], const float e1[3])
+			{
+				fit.Color0 = PackRGB565(e0);
+				fit.Color1 = PackRGB565(e1);
+			}
+
+			ColorFit FitColors(Block const& block, uint32 opaque, bool threeColors, Settings const& settings)
+			{
+				static const float kFourWeights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+				static const float kThreeWeights[4] = { 0.0f, 1.0f, 0.5f, 0.0f };
+				ColorFit fit;
+				fit.ThreeColors = threeColors;
+				float e0[4], e1[4];
+				AxisEndpoints(block, 0, 3, opaque, e0, e1);
+				SetColors(fit, e0, e1);
+				EvaluateColors(block, opaque, settings, fit);
+				for (uint32 iteration = 0; iteration < settings.Iterations && fit.Error > 0.0f; iteration++)
+				{
+					ColorFit next = fit;
+					if (!SolveEndpoints(block, 0, 3, opaque, fit.Indices, threeColors ? kThreeWeights : kFourWeights, e0, e1))
+						break;
+					SetColors(next, e0, e1);
+					if (next.Color0 == fit.Color0 && next.Color1 == fit.Color1)
+						break;
+					EvaluateColors(block, opaque, settings, next);
+					if (next.Error >= fit.Error)
+						break;
+					fit = next;
+				}
+				if (settings.Quality == EQuality::High)
+				{
+					// steps of one in each 565 component while the error drops
+					static const uint16 kSteps[3] = { 1 << 11, 1 << 5, 1 };
+					static const uint16 kMasks[3] = { 31 << 11, 63 << 5, 31 };
+					for (uint32 pass = 0; pass < 4 && fit.Error > 0.0f; pass++)
+					{
+						bool improved = false;
+						for (uint32 e = 0; e < 2; e++)
+						{
+							for (uint32 c = 0; c < 3; c++)
+							{
+								for (int32 direction = -1; direction <= 1; direction += 2)
+								{
+									ColorFit next = fit;
+									uint16 & color = e ? next.Color1 : next.Color0;
+									uint32 component = color & kMasks[c];
+									if ((direction < 0 && component == 0) || (direction > 0 && component == kMasks[c]))
+										continue;
+									color = (uint16)(direction < 0 ? color - kSteps[c] : color + kSteps[c]);
+									EvaluateColors(block, opaque, settings, next);
+									if (next.Error < fit.Error)
+									{
+										fit = next;
+										improved = true;
+									}
+								}
+							}
+						}
+						if (!improved)
+							break;
+					}
+				}
+				return fit;
+			}
+
+			/// writes 'fit' in the endpoint order of its mode
+			void WriteColors(ColorFit fit, kByte * dst)
+			{
+				if (!fit.ThreeColors)
+				{
+					if (fit.Color0 < fit.Color1)
+					{
+						std::swap(fit.Color0, fit.Color1);
+						for (uint32 i = 0; i < 16; i++)
+							fit.Indices[i] ^= 1;
+					}
+					// equal endpoints would read as 3 colors, index 0 is the color anyway
+					else if (fit.Color0 == fit.Color1)
+						memset(fit.Indices, 0, sizeof(fit.Indices));
+				}
+				else if (fit.Color0 > fit.Color1)
+				{
+					std::swap(fit.Color0, fit.Color1);
+					for (uint32 i = 0; i < 16; i++)
+					{
+						if (fit.Indices[i] < 2)
+							fit.Indices[i] ^= 1;
+					}
+				}
+				uint32 indices = 0;
+				for (uint32 i = 0; i < 16; i++)
+					indices |= (uint32)fit.Indices[i] << (2 * i);
+				memcpy(dst, &fit.Color0, 2);
+				memcpy(dst + 2, &fit.Color1, 2);
+				memcpy(dst + 4, &indices, 4);
+			}
+
+			/// \param threshold alpha below it is transparent
+			/// \param threeColors false for BC3, which always decodes 4 colors
+			void EncodeColors(Block const& block, uint8 threshold, bool threeColors, Settings const& settings, kByte * dst)
+			{
+				uint32 opaque = 0xFFFF;
+				if (threshold)
+				{
+					for (uint32 i = 0; i < 16; i++)
+					{
+						if (block.Texels[3][i] < threshold)
+							opaque &= ~(1u << i);
+					}
+				}
+				if (!opaque)
+				{
+					// 3 color mode with every index transparent
+					static const kByte kTransparent[8] = { 0, 0, 0, 0, 0xFF, 0xFF, 0xFF, 0xFF };
+					memcpy(dst, kTransparent, sizeof(kTransparent));
+					return;
+				}
+				ColorFit fit;
+				if (opaque == 0xFFFF)
+				{
+					fit = FitColors(block, opaque, false, settings);
+					if (threeColors && settings.Quality == EQuality::High && fit.Error > 0.0f)
+					{
+						ColorFit three = FitColors(block, opaque, true, settings);
+						if (three.Error < fit.Error)
+							fit = three;
+					}
+				}
+				else
+					fit = FitColors(block, opaque, true, settings);
+				WriteColors(fit, dst);
+			}
+
+			void DecodeColors(const kByte * src, bool alwaysFourColors, kByte texels[16][4])
+			{
+				uint16 color0, color1;
+				uint32 indices;
+				memcpy(&color0, src, 2);
+				memcpy(&color1, src + 2, 2);
+				memcpy(&indices, src + 4, 4);
+				uint32 palette[4][4];
+				BC1Palette(color0, color1, !alwaysFourColors && color0 <= color1, palette);
+				for (uint32 i = 0; i < 16; i++)
+				{
+					uint32 index = (indices >> (2 * i)) & 3;
+					for (uint32 c = 0; c < 4; c++)
+						texels[i][c] = (kByte)palette[index][c];
+				}
+			}
+
+			//-------------------------------------------------------------------
+			// BC4 channels, alpha of BC3
+
+			void BC4Palette(uint32 e0, uint32 e1, uint32 palette[8])
+			{
+				palette[0] = e0;
+				palette[1] = e1;
+				if (e0 > e1)
+				{
+					for (uint32 k = 2; k < 8; k++)
+						palette[k] = ((8 - k) * e0 + (k - 1) * e1 + 3) / 7;
+				}
+				else
+				{
+					for (uint32 k = 2; k < 6; k++)
+						palette[k] = ((6 - k) * e0 + (k - 1) * e1 + 2) / 5;
+					palette[6] = 0;
+					palette[7] = 255;
+				}
+			}
+
+			struct ChannelFit
+			{
+				uint8	E0;
+				uint8	E1;
+				uint8	Indices[16];
+				float	Error;
+			};
+
+			void EvaluateChannel(Block const& block, uint32 channel, Settings const& settings, ChannelFit & fit)
+			{
+				uint32 palette[8];
+				BC4Palette(fit.E0, fit.E1, palette);
+				float entries[8][4], errors[16];
+				for (uint32 k = 0; k < 8; k++)
+					entries[k][0] = (float)palette[k];
+				SelectIndices<1>(block, channel, entries, 8, settings.Simd, fit.Indices, errors);
+				fit.Error = SumErrors(errors, 0xFFFF);
+			}
+
+			void EncodeChannel(Block const& block, uint32 channel, Settings const& settings, kByte * dst)
+			{
+				static const float kWeights8[8] = { 0.0f, 1.0f, 1.0f / 7, 2.0f / 7, 3.0f / 7, 4.0f / 7, 5.0f / 7, 6.0f / 7 };
+				const float * texels = block.Texels[channel];
+				float low = *std::min_element(texels, texels + 16), high = *std::max_element(texels, texels + 16);
+				ChannelFit fit;
+				// 8 values between the extremes, or the value with equal endpoints
+				fit.E0 = (uint8)(high + 0.5f);
+				fit.E1 = (uint8)(low + 0.5f);
+				EvaluateChannel(block, channel, settings, fit);
+				if (settings.Quality != EQuality::Fast && fit.Error > 0.0f)
+				{
+					for (uint32 iteration = 0; iteration < settings.Iterations && fit.E0 > fit.E1; iteration++)
+					{
+						float e0, e1;
+						if (!SolveEndpoints(block, channel, 1, 0xFFFF, fit.Indices, kWeights8, &e0, &e1))
+							break;
+						ChannelFit next = fit;
+						next.E0 = (uint8)(e0 + 0.5f);
+						next.E1 = (uint8)(e1 + 0.5f);
+						if (next.E0 <= next.E1 || (next.E0 == fit.E0 && next.E1 == fit.E1))
+							break;
+						EvaluateChannel(block, channel, settings, next);
+						if (next.Error >= fit.Error)
+							break;
+						fit = next;
+					}
+					// 6 values between the texels within, 0 and 255 exact
+					float inner[2] = { 255.0f, 0.0f };
+					for (uint32 i = 0; i < 16; i++)
+					{
+						if (texels[i] > 0.0f && texels[i] < 255.0f)
+						{
+							inner[0] = std::min(inner[0], texels[i]);
+							inner[1] = std::max(inner[1], texels[i]);
+						}
+					}
+					if (inner[0] <= inner[1] && (low == 0.0f || high == 255.0f))
+					{
+						ChannelFit six;
+						six.E0 = (uint8)(inner[0] + 0.5f);
+						six.E1 = (uint8)(inner[1] + 0.5f);
+						EvaluateChannel(block, channel, settings, six);
+						if (six.Error < fit.Error)
+							fit = six;
+					}
+				}
+				if (settings.Quality == EQuality::High && fit.Error > 0.0f)
+				{
+					ChannelFit center = fit;
+					for (int32 d0 = -2; d0 <= 2; d0++)
+					{
+						for (int32 d1 = -2; d1 <= 2; d1++)
+						{
+							int32 e0 = center.E0 + d0, e1 = center.E1 + d1;
+							if ((d0 == 0 && d1 == 0) || e0 < 0 || e0 > 255 || e1 < 0 || e1 > 255 || ((e0 > e1) != (center.E0 > center.E1)))
+								continue;
+							ChannelFit next;
+							next.E0 = (uint8)e0;
+							next.E1 = (uint8)e1;
+							EvaluateChannel(block, channel, settings, next);
+							if (next.Error < fit.Error)
+								fit = next;
+						}
+					}
+				}
+				uint64 indices = 0;
+				for (uint32 i = 0; i < 16; i++)
+					indices |= (uint64)fit.Indices[i] << (3 * i);
+				dst[0] = fit.E0;
+				dst[1] = fit.E1;
+				memcpy(dst + 2, &indices, 6);
+			}
+
+			void DecodeChannel(const kByte * src, uint32 channel, kByte texels[16][4])
+			{
+				uint32 palette[8];
+				BC4Palette(src[0], src[1], palette);
+				uint64 indices = 0;
+				memcpy(&indices, src + 2, 6);
+				for (uint32 i = 0; i < 16; i++)
+					texels[i][channel] = (kByte)palette[(indices >> (3 * i)) & 7];
+			}
+
+			//-------------------------------------------------------------------
+			// BC7 modes 6 (RGBA, 7 bits and p-bits, 16 indices) and 5 (RGB 7 bits
+			// and alpha 8 bits, 4 indices each, one channel rotated into alpha)
+
+			uint32 Interpolate(uint32 e0, uint32 e1, uint32 weight)
+			{
+				return ((64 - weight) * e0 + weight * e1 + 32) >> 6;
+			}
+
+			struct Mode6Fit
+			{
+				/// 7 bits
+				uint8	E[2][4];
+				uint8	P[2];
+				uint8	Indices[16];
+				float	Error;
+			};
+
+			void EvaluateMode6(Block const& block, Settings const& settings, Mode6Fit & fit)
+			{
+				float palette[16][4], errors[16];
+				for (uint32 c = 0; c < 4; c++)
+				{
+					uint32 e0 = (fit.E[0][c] << 1) | fit.P[0], e1 = (fit.E[1][c] << 1) | fit.P[1];
+					for (uint32 k = 0; k < 16; k++)
+						palette[k][c] = (float)Interpolate(e0, e1, kWeights4[k]);
+				}
+				SelectIndices<4>(block, 0, palette, 16, settings.Simd, fit.Indices, errors);
+				fit.Error = SumErrors(errors, 0xFFFF);
+			}
+
+			/// quantizes 'e0', 'e1' with the best p-bits, the nearest ones for Fast
+			void SetMode6(Block const& block, const float e0[4], const float e1[4], Settings const& settings, Mode6Fit & fit)
+			{
+				const float * endpoints[2] = { e0, e1 };
+				if (settings.Quality == EQuality::Fast)
+				{
+					for (uint32 e = 0; e < 2; e++)
+					{
+						float best = FLT_MAX;
+						for (uint32 p = 0; p < 2; p++)
+						{
+							float error = 0.0f;
+							uint8 q[4];
+							for (uint32 c = 0; c < 4; c++)
+							{
+								q[c] = (uint8)Clamp((int32)floorf((endpoints[e][c] - p) * 0.5f + 0.5f), 0, 127);
+								float d = endpoints[e][c] - (float)((q[c] << 1) | p);
+								error += d * d;
+							}
+							if (error < best)
+							{
+								best = error;
+								memcpy(fit.E[e], q, 4);
+								fit.P[e] = (uint8)p;
+							}
+						}
+					}
+					EvaluateMode6(block, settings, fit);
+					return;
+				}
+				fit.Error = FLT_MAX;
+				for (uint32 bits = 0; bits < 4; bits++)
+				{
+					Mode6Fit next;
+					for (uint32 e = 0; e < 2; e++)
+					{
+						next.P[e] = (uint8)((bits >> e) & 1);
+						for (uint32 c = 0; c < 4; c++)
+							next.E[e][c] = (uint8)Clamp((int32)floorf((endpoints[e][c] - next.P[e]) * 0.5f + 0.5f), 0, 127);
+					}
+					EvaluateMode6(block, settings, next);
+					if (next.Error < fit.Error)
+						fit = next;
+				}
+			}
+
+			Mode6Fit FitMode6(Block const& block, Settings const& settings)
+			{
+				static const float kWeights[16] = { 0.0f, 4.0f / 64, 9.0f / 64, 13.0f / 64, 17.0f / 64, 21.0f / 64, 26.0f / 64,
+					30.0f / 64, 34.0f / 64, 38.0f / 64, 43.0f / 64, 47.0f / 64, 51.0f / 64, 55.0f / 64, 60.0f / 64, 1.0f };
+				float e0[4], e1[4];
+				AxisEndpoints(block, 0, 4, 0xFFFF, e0, e1);
+				Mode6Fit fit;
+				SetMode6(block, e0, e1, settings, fit);
+				for (uint32 iteration = 0; iteration < settings.Iterations && fit.Error > 0.0f; iteration++)
+				{
+					if (!SolveEndpoints(block, 0, 4, 0xFFFF, fit.Indices, kWeights, e0, e1))
+						break;
+					Mode6Fit next;
+					SetMode6(block, e0, e1, settings, next);
+					if (next.Error >= fit.Error)
+						break;
+					fit = next;
+				}
+				return fit;
+			}
+
+			void WriteMode6(Mode6Fit fit, kByte * dst)
+			{
+				// the first index has an implicit 0 high bit
+				if (fit.Indices[0] & 8)
+				{
+					std::swap(fit.E[0], fit.E[1]);
+					std::swap(fit.P[0], fit.P[1]);
+					for (uint32 i = 0; i < 16; i++)
+						fit.Indices[i] = (uint8)(15 - fit.Indices[i]);
+				}
+				BlockBits bits;
+				bits.Put(1 << 6, 7);
+				for (uint32 c = 0; c < 4; c++)
+				{
+					bits.Put(fit.E[0][c], 7);
+					bits.Put(fit.E[1][c], 7);
+				}
+				bits.Put(fit.P[0], 1);
+				bits.Put(fit.P[1], 1);
+				bits.Put(fit.Indices[0], 3);
+				for (uint32 i = 1; i < 16; i++)
+					bits.Put(fit.Indices[i], 4);
+				memcpy(dst, bits.Bits, 16);
+			}
+
+			struct Mode5Fit
+			{
+				uint8	Rotation;
+				/// 7 bits
+				uint8	Color[2][3];
+				uint8	Alpha[2];
+				uint8	ColorIndices[16];
+				uint8	AlphaIndices[16];
+				float	ColorError;
+				float	AlphaError;
+			};
+
+			uint32 Expand7(uint32 value)
+			{
+				return (value << 1) | (value >> 6);
+			}
+
+			void EvaluateMode5Color(Block const& block, Settings const& settings, Mode5Fit & fit)
+			{
+				float palette[4][4], errors[16];
+				for (uint32 c = 0; c < 3; c++)
+				{
+					for (uint32 k = 0; k < 4; k++)
+						palette[k][c] = (float)Interpolate(Expand7(fit.Color[0][c]), Expand7(fit.Color[1][c]), kWeights2[k]);
+				}
+				SelectIndices<3>(block, 0, palette, 4, settings.Simd, fit.ColorIndices, errors);
+				fit.ColorError = SumErrors(errors, 0xFFFF);
+			}
+
+			void EvaluateMode5Alpha(Block const& block, Settings const& settings, Mode5Fit & fit)
+			{
+				float palette[4][4], errors[16];
+				for (uint32 k = 0; k < 4; k++)
+					palette[k][0] = (float)Interpolate(fit.Alpha[0], fit.Alpha[1], kWeights2[k]);
+				SelectIndices<1>(block, 3, palette, 4, settings.Simd, fit.AlphaIndices, errors);
+				fit.AlphaError = SumErrors(errors, 0xFFFF);
+			}
+
+			/// 'block' with alpha already swapped with channel Rotation - 1
+			void FitMode5(Block const& block, Settings const& settings, Mode5Fit & fit)
+			{
+				static const float kWeights[4] = { 0.0f, 21.0f / 64, 43.0f / 64, 1.0f };
+				float e0[4], e1[4];
+				AxisEndpoints(block, 0, 3, 0xFFFF, e0, e1);
+				for (uint32 c = 0; c < 3; c++)
+				{
+					fit.Color[0][c] = (uint8)(e0[c] * (127.0f / 255.0f) + 0.5f);
+					fit.Color[1][c] = (uint8)(e1[c] * (127.0f / 255.0f) + 0.5f);
+				}
+				EvaluateMode5Color(block, settings, fit);
+				for (uint32 iteration = 0; iteration < settings.Iterations && fit.ColorError > 0.0f; iteration++)
+				{
+					if (!SolveEndpoints(block, 0, 3, 0xFFFF, fit.ColorIndices, kWeights, e0, e1))
+						break;
+					Mode5Fit next = fit;
+					for (uint32 c = 0; c < 3; c++)
+					{
+						next.Color[0][c] = (uint8)(e0[c] * (127.0f / 255.0f) + 0.5f);
+						next.Color[1][c] = (uint8)(e1[c] * (127.0f / 255.0f) + 0.5f);
+					}
+					EvaluateMode5Color(block, settings, next);
+					if (next.ColorError >= fit.ColorError)
+						break;
+					fit = next;
+				}
+
+				const float * alpha = block.Texels[3];
+				fit.Alpha[0] = (uint8)(*std::min_element(alpha, alpha + 16) + 0.5f);
+				fit.Alpha[1] = (uint8)(*std::max_element(alpha, alpha + 16) + 0.5f);
+				EvaluateMode5Alpha(block, settings, fit);
+				for (uint32 iteration = 0; iteration < settings.Iterations && fit.AlphaError > 0.0f; iteration++)
+				{
+					if (!SolveEndpoints(block, 3, 1, 0xFFFF, fit.AlphaIndices, kWeights, e0, e1))
+						break;
+					Mode5Fit next = fit;
+					next.Alpha[0] = (uint8)(e0[0] + 0.5f);
+					next.Alpha[1] = (uint8)(e1[0] + 0.5f);
+					EvaluateMode5Alpha(block, settings, next);
+					if (next.AlphaError >= fit.AlphaError)
+						break;
+					fit = next;
+				}
+			}
+
+			void WriteMode5(Mode5Fit fit, kByte * dst)
+			{
+				if (fit.ColorIndices[0] & 2)
+				{
+					std::swap(fit.Color[0], fit.Color[1]);
+					for (uint32 i = 0; i < 16; i++)
+						fit.ColorIndices[i] = (uint8)(3 - fit.ColorIndices[i]);
+				}
+				if (fit.AlphaIndices[0] & 2)
+				{
+					std::swap(fit.Alpha[0], fit.Alpha[1]);
+					for (uint32 i = 0; i < 16; i++)
+						fit.AlphaIndices[i] = (uint8)(3 - fit.AlphaIndices[i]);
+				}
+				BlockBits bits;
+				bits.Put(1 << 5, 6);
+				bits.Put(fit.Rotation, 2);
+				for (uint32 c = 0; c < 3; c++)
+				{
+					bits.Put(fit.Color[0][c], 7);
+					bits.Put(fit.Color[1][c], 7);
+				}
+				bits.Put(fit.Alpha[0], 8);
+				bits.Put(fit.Alpha[1], 8);
+				bits.Put(fit.ColorIndices[0], 1);
+				for (uint32 i = 1; i < 16; i++)
+					bits.Put(fit.ColorIndices[i], 2);
+				bits.Put(fit.AlphaIndices[0], 1);
+				for (uint32 i = 1; i < 16; i++)
+					bits.Put(fit.AlphaIndices[i], 2);
+				memcpy(dst, bits.Bits, 16);
+			}
+
+			void EncodeBC7(Block const& block, Settings const& settings, kByte * dst)
+			{
+				Mode6Fit mode6 = FitMode6(block, settings);
+				if (settings.Quality == EQuality::Fast || mode6.Error == 0.0f)
+				{
+					WriteMode6(mode6, dst);
+					return;
+				}
+				bool opaque = true;
+				for (uint32 i = 0; i < 16; i++)
+					opaque = opaque && block.Texels[3][i] == 255.0f;
+				// Normal separates the alpha of blocks which have one, High tries
+				// every channel on its own
+				uint32 rotations = settings.Quality == EQuality::High ? 4 : opaque ? 0 : 1;
+				Mode5Fit best;
+				best.ColorError = best.AlphaError = FLT_MAX;
+				for (uint32 rotation = 0; rotation < rotations; rotation++)
+				{
+					Block rotated = block;
+					if (rotation)
+					{
+						memcpy(rotated.Texels[3], block.Texels[rotation - 1], sizeof(rotated.Texels[3]));
+						memcpy(rotated.Texels[rotation - 1], block.Texels[3], sizeof(rotated.Texels[3]));
+					}
+					Mode5Fit fit;
+					fit.Rotation = (uint8)rotation;
+					FitMode5(rotated, settings, fit);
+					if (fit.ColorError + fit.AlphaError < best.ColorError + best.AlphaError)
+						best = fit;
+				}
+				if (rotations && best.ColorError + best.AlphaError < mode6.Error)
+					WriteMode5(best, dst);
+				else
+					WriteMode6(mode6, dst);
+			}
+
+			/// modes 4 to 6, the others decode to 0
+			void DecodeBC7(const kByte * src, kByte texels[16][4])
+			{
+				BlockBits bits(src);
+				uint32 mode = 0;
+				while (mode < 8 && !bits.Get(1))
+					mode++;
+				if (mode < 4 || mode > 6)
+				{
+					memset(texels, 0, 64);
+					return;
+				}
+				uint32 e[2][4], rotation = 0, colorBits = 2, alphaBits = 2;
+				uint8 colorIndices[16], alphaIndices[16];
+				if (mode == 6)
+				{
+					for (uint32 c = 0; c < 4; c++)
+					{
+						e[0][c] = bits.Get(7) << 1;
+						e[1][c] = bits.Get(7) << 1;
+					}
+					uint32 p0 = bits.Get(1), p1 = bits.Get(1);
+					for (uint32 c = 0; c < 4; c++)
+					{
+						e[0][c] |= p0;
+						e[1][c] |= p1;
+					}
+					colorBits = alphaBits = 4;
+					for (uint32 i = 0; i < 16; i++)
+						colorIndices[i] = alphaIndices[i] = (uint8)bits.Get(i ? 4 : 3);
+				}
+				else
+				{
+					rotation = bits.Get(2);
+					uint32 swapped = mode == 4 ? bits.Get(1) : 0;
+					uint32 size = mode == 4 ? 5 : 7, alphaSize = mode == 4 ? 6 : 8;
+					for (uint32 c = 0; c < 3; c++)
+					{
+						for (uint32 n = 0; n < 2; n++)
+						{
+							uint32 value = bits.Get(size);
+							e[n][c] = (value << (8 - size)) | (value >> (2 * size - 8));
+						}
+					}
+					for (uint32 n = 0; n < 2; n++)
+					{
+						uint32 value = bits.Get(alphaSize);
+						e[n][3] = alphaSize == 8 ? value : (value << 2) | (value >> 4);
+					}
+					// mode 4 has 2 and 3 bit index sets, the second one for color if swapped
+					uint8 first[16], second[16];
+					uint32 secondBits = mode == 4 ? 3 : 2;
+					for (uint32 i = 0; i < 16; i++)
+						first[i] = (uint8)bits.Get(i ? 2 : 1);
+					for (uint32 i = 0; i < 16; i++)
+						second[i] = (uint8)bits.Get(i ? secondBits : secondBits - 1);
+					colorBits = swapped ? secondBits : 2;
+					alphaBits = swapped ? 2 : secondBits;
+					memcpy(colorIndices, swapped ? second : first, 16);
+					memcpy(alphaIndices, swapped ? first : second, 16);
+				}
+				const uint32 * colorWeights = colorBits == 2 ? kWeights2 : colorBits == 3 ? kWeights3 : kWeights4;
+				const uint32 * alphaWeights = alphaBits == 2 ? kWeights2 : alphaBits == 3 ? kWeights3 : kWeights4;
+				for (uint32 i = 0; i < 16; i++)
+				{
+					for (uint32 c = 0; c < 3; c++)
+						texels[i][c] = (kByte)Interpolate(e[0][c], e[1][c], colorWeights[colorIndices[i]]);
+					texels[i][3] = (kByte)Interpolate(e[0][3], e[1][3], alphaWeights[alphaIndices[i]]);
+					if (rotation)
+						std::swap(texels[i][3], texels[i][rotation - 1]);
+				}
+			}
+
+			//-------------------------------------------------------------------
+
+			/// texels past the edge repeat the last row and column
+			void LoadBlock(ImageLevel const& level, EImageFormat format, uint32 bx, uint32 by, Block & block)
+			{
+				uint32 size = ImageData::GetFormatElementSize(format);
+				bool bgra = format == EImageFormat::BGRA8_UNORM || format == EImageFormat::BGRA8_SRGB;
+				for (uint32 y = 0; y < 4; y++)
+				{
+					const kByte * row = level.Data + (size_t)std::min(by * 4 + y, level.Height - 1) * level.RowPitch;
+					for (uint32 x = 0; x < 4; x++)
+					{
+						const kByte * texel = row + std::min(bx * 4 + x, level.Width - 1) * size;
+						uint32 i = y * 4 + x;
+						block.Texels[0][i] = texel[bgra ? 2 : 0];
+						block.Texels[1][i] = size > 1 ? texel[1] : 0.0f;
+						block.Texels[2][i] = size > 2 ? texel[bgra ? 0 : 2] : 0.0f;
+						block.Texels[3][i] = size > 2 ? texel[3] : 255.0f;
+					}
+				}
+			}
+
+			void EncodeBlock(EImageFormat format, Block const& block, uint8 threshold, Settings const& settings, kByte * dst)
+			{
+				switch (format)
+				{
+				case EImageFormat::BC1_UNORM:
+				case EImageFormat::BC1_SRGB:
+					EncodeColors(block, threshold, true, settings, dst);
+					break;
+				case EImageFormat::BC3_UNORM:
+				case EImageFormat::BC3_SRGB:
+					EncodeChannel(block, 3, settings, dst);
+					EncodeColors(block, 0, false, settings, dst + 8);
+					break;
+				case EImageFormat::BC4_UNORM:
+					EncodeChannel(block, 0, settings, dst);
+					break;
+				case EImageFormat::BC5_UNORM:
+					EncodeChannel(block, 0, settings, dst);
+					EncodeChannel(block, 1, settings, dst + 8);
+					break;
+				default:
+					EncodeBC7(block, settings, dst);
+					break;
+				}
+			}
+
+			/// RGBA of a block, channels the format doesn't keep are 0 and alpha 255
+			void DecodeBlock(EImageFormat format, const kByte * src, kByte texels[16][4])
+			{
+				switch (format)
+				{
+				case EImageFormat::BC1_UNORM:
+				case EImageFormat::BC1_SRGB:
+					DecodeColors(src, false, texels);
+					break;
+				case EImageFormat::BC3_UNORM:
+				case EImageFormat::BC3_SRGB:
+					DecodeColors(src + 8, true, texels);
+					DecodeChannel(src, 3, texels);
+					break;
+				case EImageFormat::BC4_UNORM:
+				case EImageFormat::BC5_UNORM:
+					for (uint32 i = 0; i < 16; i++)
+					{
+						texels[i][0] = texels[i][1] = texels[i][2] = 0;
+						texels[i][3] = 255;
+					}
+					DecodeChannel(src, 0, texels);
+					if (format == EImageFormat::BC5_UNORM)
+						DecodeChannel(src + 8, 1, texels);
+					break;
+				default:
+					DecodeBC7(src, texels);
+					break;
+				}
+			}
+
+			/// channels the format keeps, BC1 alpha only with a threshold
+			uint32 GetChannelMask(EImageFormat format, uint8 threshold)
+			{
+				switch (format)
+				{
+				case EImageFormat::BC1_UNORM:
+				case EImageFormat::BC1_SRGB:
+					return threshold ? 15 : 7;
+				case EImageFormat::BC4_UNORM:
+					return 1;
+				case EImageFormat::BC5_UNORM:
+					return 3;
+				default:
+					return 15;
+				}
+			}
+
+			struct BlockRow
+			{
+				uint32	Layer;
+				uint32	Level;
+				uint32	Row;
+			};
+
+			std::vector<BlockRow> GetBlockRows(ImageData const& image)
+			{
+				std::vector<BlockRow> rows;
+				for (uint32 layer = 0; layer < image.GetLayers(); layer++)
+				{
+					for (uint32 level = 0; level < image.GetMipLevs(); level++)
+					{
+						uint32 height = (image.GetLevelDesc(level, layer)->Height + 3) / 4;
+						for (uint32 row = 0; row < height; row++)
+							rows.push_back({ layer, level, row });
+					}
+				}
+				return rows;
+			}
+		}
+
+		bool IsSupported(EImageFormat format)
+		{
+			switch (format)
+			{
+			case EImageFormat::BC1_UNORM:
+			case EImageFormat::BC1_SRGB:
+			case EImageFormat::BC3_UNORM:
+			case EImageFormat::BC3_SRGB:
+			case EImageFormat::BC4_UNORM:
+			case EImageFormat::BC5_UNORM:
+			case EImageFormat::BC7_UNORM:
+			case EImageFormat::BC7_SRGB:
+				return true;
+			default:
+				return false;
+			}
+		}
+
+		bool IsSupportedSource(EImageFormat format)
+		{
+			switch (format)
+			{
+			case EImageFormat::R8_UNORM:
+			case EImageFormat::RG8_UNORM:
+			case EImageFormat::RGBA8_UNORM:
+			case EImageFormat::RGBA8_SRGB:
+			case EImageFormat::BGRA8_UNORM:
+			case EImageFormat::BGRA8_SRGB:
+				return true;
+			default:
+				return false;
+			}
+		}
+
+		std::shared_ptr<ImageData> Compress(ImageData const& source, EImageFormat format,
+			Options const& options, Dispatch::ThreadPool * workers, Stats * stats)
+		{
+			EImageFormat sourceFormat = source.GetFormat();
+			if (!IsSupported(format) || !IsSupportedSource(sourceFormat) || source.GetType() == ImageData::TEXTURE_3D
+				|| source.GetMipLevs() == 0)
+				return nullptr;
+			auto start = std::chrono::high_resolution_clock::now();
+			auto image = std::make_shared<ImageData>();
+			if (!image->Create(format, source.GetWidth(), source.GetHeight(), source.GetMipLevs(), source.GetLayers(), source.IsCubeMap()))
+				return nullptr;
+			image->SetName(source.GetName());
+
+			Settings settings;
+			settings.Quality = options.Quality;
+			settings.Simd = !options.Scalar;
+			settings.Iterations = options.Quality == EQuality::Fast ? 0 : options.Quality == EQuality::Normal ? 2 : 6;
+			uint8 threshold = format == EImageFormat::BC1_UNORM || format == EImageFormat::BC1_SRGB ? options.AlphaThreshold : 0;
+			uint32 blockSize = ImageData::GetFormatElementSize(format), channels = GetChannelMask(format, threshold);
+			std::vector<BlockRow> rows = GetBlockRows(*image);
+			// squared errors of each row, summed in order afterwards
+			std::vector<uint64> errors(stats ? rows.size() : 0);
+			Dispatch::ThreadPool & pool = workers ? *workers : Dispatch::ThreadPool::Global();
+			pool.ParallelFor(0, (uint32)rows.size(), kRowGrain, [&](uint32 begin, uint32 end)
+			{
+				Block block;
+				kByte texels[16][4];
+				for (uint32 r = begin; r < end; r++)
+				{
+					BlockRow const& row = rows[r];
+					ImageLevel const& level = *source.GetLevelDesc(row.Level, row.Layer);
+					ImageLevel const& target = *image->GetLevelDesc(row.Level, row.Layer);
+					kByte * dst = const_cast<kByte*>(target.Data) + (size_t)row.Row * target.RowPitch;
+					uint32 columns = (level.Width + 3) / 4;
+					uint64 error = 0;
+					for (uint32 bx = 0; bx < columns; bx++, dst += blockSize)
+					{
+						LoadBlock(level, sourceFormat, bx, row.Row, block);
+						EncodeBlock(format, block, threshold, settings, dst);
+						if (!stats)
+							continue;
+						DecodeBlock(format, dst, texels);
+						uint32 width = std::min(level.Width - bx * 4, 4u), height = std::min(level.Height - row.Row * 4, 4u);
+						for (uint32 y = 0; y < height; y++)
+						{
+							for (uint32 x = 0; x < width; x++)
+							{
+								for (uint32 c = 0; c < 4; c++)
+								{
+									if (!(channels & (1 << c)))
+										continue;
+									int32 d = (int32)texels[y * 4 + x][c] - (int32)block.Texels[c][y * 4 + x];
+									error += (uint64)(d * d);
+								}
+							}
+						}
+					}
+					if (stats)
+						errors[r] = error;
+				}
+			});
+
+			if (stats)
+			{
+				Stats result = {};
+				uint64 samples = 0, error = 0;
+				for (uint32 layer = 0; layer < image->GetLayers(); layer++)
+				{
+					for (uint32 level = 0; level < image->GetMipLevs(); level++)
+					{
+						ImageLevel const& desc = *image->GetLevelDesc(level, layer);
+						result.Blocks += (uint64)((desc.Width + 3) / 4) * desc.Rows;
+						samples += (uint64)desc.Width * desc.Height * CountBits(channels);
+					}
+				}
+				for (uint64 e : errors)
+					error += e;
+				double mse = samples ? (double)error / samples : 0.0;
+				result.PSNR = mse > 0.0 ? 10.0 * log10(255.0 * 255.0 / mse) : std::numeric_limits<double>::infinity();
+				result.Milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+				*stats = result;
+			}
+			return image;
+		}
+
+		std::shared_ptr<ImageData> Decompress(ImageData const& source, Dispatch::ThreadPool * workers)
+		{
+			EImageFormat format = source.GetFormat();
+			if (!IsSupported(format) || source.GetType() == ImageData::TEXTURE_3D)
+				return nullptr;
+			bool srgb = format == EImageFormat::BC1_SRGB || format == EImageFormat::BC3_SRGB || format == EImageFormat::BC7_SRGB;
+			auto image = std::make_shared<ImageData>();
+			if (!image->Create(srgb ? EImageFormat::RGBA8_SRGB : EImageFormat::RGBA8_UNORM, source.GetWidth(), source.GetHeight(),
+				source.GetMipLevs(), source.GetLayers(), source.IsCubeMap()))
+				return nullptr;
+			image->SetName(source.GetName());
+			uint32 blockSize = ImageData::GetFormatElementSize(format);
+			std::vector<BlockRow> rows = GetBlockRows(source);
+			Dispatch::ThreadPool & pool = workers ? *workers : Dispatch::ThreadPool::Global();
+			pool.ParallelFor(0, (uint32)rows.size(), kRowGrain, [&](uint32 begin, uint32 end)
+			{
+				kByte texels[16][4];
+				for (uint32 r = begin; r < end; r++)
+				{
+					BlockRow const& row = rows[r];
+					ImageLevel const& level = *source.GetLevelDesc(row.Level, row.Layer);
+					ImageLevel const& target = *image->GetLevelDesc(row.Level, row.Layer);
+					kByte * dst = const_cast<kByte*>(target.Data);
+					const kByte * src = level.Data + (size_t)row.Row * level.RowPitch;
+					uint32 height = std::min(level.Height - row.Row * 4, 4u);
+					for (uint32 bx = 0; bx < (level.Width + 3) / 4; bx++, src += blockSize)
+					{
+						DecodeBlock(format, src, texels);
+						uint32 width = std::min(level.Width - bx * 4, 4u);
+						for (uint32 y = 0; y < height; y++)
+							memcpy(dst + (size_t)(row.Row * 4 + y) * target.RowPitch + bx * 16, texels[y * 4], width * 4);
+					}
+				}
+			});
+			return image;
+		}
+
+		const char * GetKernel()
+		{
+#if K3D_BC_SSE2
+			return "sse2";
+#elif K3D_BC_NEON
+			return "neon";
+#else
+			return "scalar";
+#endif
+		}
+	}
+}
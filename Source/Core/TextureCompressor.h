@@ -0,0 +1,73 @@
+#ifndef __TextureCompressor_h__
+#define __TextureCompressor_h__
+#pragma once
+
+#include "ImageData.h"
+
+namespace k3d
+{
+	/// BC1, BC3, BC4, BC5 and BC7 block compression of 8 bit images for offline
+	/// bundle building. Endpoints start on the principal axis of a block and are
+	/// refined by least squares, the index search of every candidate runs on
+	/// SSE2 or NEON. Block rows of all levels and layers are split across a
+	/// thread pool.
+	namespace TextureCompressor
+	{
+		enum class EQuality : uint32
+		{
+			/// endpoints from the principal axis only, BC7 mode 6 only
+			Fast,
+			/// least squares refinement, BC4 6 value blocks, BC7 mode 5 for blocks with alpha
+			Normal,
+			/// more refinement, endpoint search, BC1 3 color blocks, BC7 mode 5 rotations
+			High,
+		};
+
+		struct Options
+		{
+			EQuality	Quality;
+			/// BC1 only: texels with alpha below it become transparent, 0 keeps
+			/// every block opaque
+			uint8		AlphaThreshold;
+			/// the scalar reference kernels, for comparison
+			bool		Scalar;
+
+			Options()
+				: Quality(EQuality::Normal)
+				, AlphaThreshold(0)
+				, Scalar(false)
+			{
+			}
+		};
+
+		struct Stats
+		{
+			uint64	Blocks;
+			double	Milliseconds;
+			/// peak signal to noise ratio over the channels the format keeps, in
+			/// dB, infinite if the blocks are exact
+			double	PSNR;
+		};
+
+		/// BC1, BC3, BC7 (UNORM or SRGB), BC4_UNORM and BC5_UNORM
+		K3D_API bool	IsSupported(EImageFormat format);
+		/// R8, RG8, RGBA8 and BGRA8 (UNORM or sRGB)
+		K3D_API bool	IsSupportedSource(EImageFormat format);
+
+		/// Compresses every level and layer of 'source', BC4 keeps the red and
+		/// BC5 the red and green channels. The bytes of sRGB images are encoded
+		/// as they are, so 'format' should be the SRGB variant for them.
+		/// \param workers the global pool if null
+		/// \return an image owning its levels, null if either format isn't supported
+		K3D_API std::shared_ptr<ImageData>	Compress(ImageData const& source, EImageFormat format,
+			Options const& options = Options(), Dispatch::ThreadPool * workers = nullptr, Stats * stats = nullptr);
+		/// \brief RGBA8 (or RGBA8_SRGB) image of a compressed one, for previews and error
+		/// measurement. BC7 blocks are decoded for modes 4 to 6, the others come out black.
+		K3D_API std::shared_ptr<ImageData>	Decompress(ImageData const& source, Dispatch::ThreadPool * workers = nullptr);
+
+		/// "sse2", "neon" or "scalar"
+		K3D_API const char *	GetKernel();
+	}
+}
+
+#endif
@@ -0,0 +1,187 @@
+#include "Common.h"
+#include <Core/Animation.h>
+#include <Core/Dispatch/ThreadPool.h>
+#include <cmath>
+#include <iostream>
+#include <random>
+
+#if K3DPLATFORM_OS_WIN
+#pragma comment(linker,"/subsystem:console")
+#endif
+
+using namespace std;
+using namespace k3d;
+
+Animation::Transform MakeTransform(float x, float y, float z, float degrees, float tx, float ty, float tz)
+{
+	float length = sqrtf(x * x + y * y + z * z), half = degrees * 3.14159265f / 360.0f, s = sinf(half) / length;
+	return { { x * s, y * s, z * s, cosf(half) }, { tx, ty, tz } };
+}
+
+/// a walking chain: the first bone translates, every bone swings at its own
+/// phase, the last 'still' bones do not move at all
+vector<Animation::Transform> MakeFrames(uint32 numFrames, uint32 numBones, uint32 still, float phase)
+{
+	vector<Animation::Transform> frames;
+	for (uint32 f = 0; f < numFrames; f++)
+	{
+		float t = f / 30.0f + phase;
+		for (uint32 b = 0; b < numBones; b++)
+		{
+			if (b >= numBones - still)
+				frames.push_back(MakeTransform(0, 0, 1, 10.0f, 0.0f, 0.3f, 0.0f));
+			else if (b == 0)
+				frames.push_back(MakeTransform(0, 1, 0, 20.0f * sinf(t), 0.5f * t, 1.0f + 0.05f * sinf(6.0f * t), 0.0f));
+			else
+				frames.push_back(MakeTransform(1, 0.2f * b, 0.5f, 60.0f * sinf(2.0f * t + b), 0.0f, 0.3f, 0.01f * sinf(t)));
+		}
+	}
+	return frames;
+}
+
+vector<int32> MakeParents(uint32 numBones)
+{
+	vector<int32> parents;
+	for (uint32 b = 0; b < numBones; b++)
+		parents.push_back((int32)b - 1);
+	return parents;
+}
+
+float MaxDifference(Animation::Pose const& a, Animation::Pose const& b)
+{
+	float difference = 0.0f;
+	for (uint32 bone = 0; bone < a.GetNumBones(); bone++)
+	{
+		Animation::Transform ta = a.GetTransform(bone), tb = b.GetTransform(bone);
+		for (uint32 i = 0; i < 4; i++)
+			difference = max(difference, fabsf(ta.Rotation[i] - tb.Rotation[i]));
+		for (uint32 i = 0; i < 3; i++)
+			difference = max(difference, fabsf(ta.Translation[i] - tb.Translation[i]));
+	}
+	return difference;
+}
+
+void TestErrorBound()
+{
+	const uint32 numFrames = 90, numBones = 12;
+	auto frames = MakeFrames(numFrames, numBones, 3, 0.0f);
+	Animation::Clip::Options options;
+	Animation::Clip clip;
+	Animation::Clip::Stats stats;
+	K3D_ASSERT(clip.Build(frames.data(), numFrames, numBones, 30.0f, options, &stats));
+	K3D_ASSERT(clip.GetNumBones() == numBones && fabsf(clip.GetDuration() - 89.0f / 30.0f) < 1e-5f);
+	K3D_ASSERT(stats.MaxError <= options.MaxError && stats.Keys < stats.RawKeys && stats.Bytes == clip.GetSize());
+	// each still bone keeps a single rotation and translation key
+	K3D_ASSERT(stats.Keys <= stats.RawKeys - 3 * 2 * (numFrames - 1));
+
+	// every source frame, also in model space where errors add up along the chain
+	auto parents = MakeParents(numBones);
+	vector<kMath::Mat4f> model(numBones), reference(numBones);
+	Animation::Pose pose, source;
+	source.Resize(numBones);
+	float modelError = 0.0f;
+	for (uint32 f = 0; f < numFrames; f++)
+	{
+		clip.Sample(f / 30.0f, pose);
+		for (uint32 b = 0; b < numBones; b++)
+			source.SetTransform(b, frames[f * numBones + b]);
+		Animation::LocalToModel(pose, parents.data(), model.data());
+		Animation::LocalToModel(source, parents.data(), reference.data());
+		for (uint32 b = 0; b < numBones; b++)
+		{
+			for (uint32 c = 0; c < 3; c++)
+				modelError = max(modelError, fabsf(model[b][3][c] - reference[b][3][c]));
+		}
+	}
+	cout << numBones << " bones x " << numFrames << " frames: " << stats.Keys << " of " << stats.RawKeys << " keys, "
+		<< stats.RawBytes << " -> " << stats.Bytes << " bytes, local error " << stats.MaxError
+		<< ", model space joint error " << modelError << ", built in " << stats.Milliseconds << " ms" << endl;
+	K3D_ASSERT(modelError < options.MaxError * numBones * 2);
+
+	// without reduction every frame is kept, quantized
+	options.ReduceKeys = false;
+	Animation::Clip full;
+	Animation::Clip::Stats fullStats;
+	K3D_ASSERT(full.Build(frames.data(), numFrames, numBones, 30.0f, options, &fullStats));
+	K3D_ASSERT(fullStats.Keys == fullStats.RawKeys && fullStats.MaxError < 1e-4f);
+
+	K3D_ASSERT(!clip.Build(frames.data(), 0, numBones, 30.0f));
+	K3D_ASSERT(!clip.Build(frames.data(), numFrames, 0, 30.0f));
+}
+
+void TestAgainstScalar()
+{
+	// 13 bones, the last group of 4 is padded
+	const uint32 numFrames = 60, numBones = 13;
+	auto frames = MakeFrames(numFrames, numBones, 2, 0.3f);
+	Animation::Clip clip;
+	K3D_ASSERT(clip.Build(frames.data(), numFrames, numBones, 30.0f));
+	Animation::Pose scalar, simd;
+	for (float time = -0.5f; time < 2.5f; time += 0.0371f)
+	{
+		clip.Sample(time, scalar, true);
+		clip.Sample(time, simd);
+		K3D_ASSERT(scalar.GetNumBones() == numBones && MaxDifference(scalar, simd) < 1e-6f);
+		Animation::Transform4 const& padded = simd.GetData()[3];
+		K3D_ASSERT(padded.RotW[1] == 1.0f && padded.RotX[3] == 0.0f && padded.PosY[2] == 0.0f);
+	}
+
+	// the ends of a blend are its poses
+	Animation::Pose other, blended, reference;
+	clip.Sample(0.2f, scalar);
+	clip.Sample(1.4f, other);
+	Animation::Blend(scalar, other, 0.0f, blended);
+	K3D_ASSERT(MaxDifference(blended, scalar) < 1e-6f);
+	Animation::Blend(scalar, other, 1.0f, blended);
+	K3D_ASSERT(MaxDifference(blended, other) < 1e-6f);
+	Animation::Blend(scalar, other, 0.35f, blended);
+	Animation::Blend(scalar, other, 0.35f, reference, true);
+	K3D_ASSERT(MaxDifference(blended, reference) < 1e-6f);
+}
+
+void TestThroughput(uint32 numCharacters)
+{
+	const uint32 numFrames = 300, numBones = 64;
+	vector<Animation::Clip> clips(4);
+	uint64 rawBytes = 0, bytes = 0;
+	for (uint32 c = 0; c < clips.size(); c++)
+	{
+		auto frames = MakeFrames(numFrames, numBones, 8, c * 0.7f);
+		Animation::Clip::Stats stats;
+		K3D_ASSERT(clips[c].Build(frames.data(), numFrames, numBones, 30.0f, Animation::Clip::Options(), &stats));
+		rawBytes += stats.RawBytes;
+		bytes += stats.Bytes;
+	}
+	cout << numBones << " bones x " << numFrames << " frames: " << rawBytes / clips.size() << " -> "
+		<< bytes / clips.size() << " bytes per clip (" << (double)rawBytes / bytes << ":1)" << endl;
+
+	vector<Animation::Pose> poses(numCharacters), parallelPoses(numCharacters);
+	vector<Animation::Job> jobs, parallelJobs;
+	for (uint32 i = 0; i < numCharacters; i++)
+	{
+		Animation::Job job = { &clips[i % 4], i * 0.013f, &clips[(i + 1) % 4], i * 0.029f, (i % 3) * 0.4f, &poses[i] };
+		jobs.push_back(job);
+		job.Target = &parallelPoses[i];
+		parallelJobs.push_back(job);
+	}
+	Dispatch::ThreadPool one(1), workers(4);
+	Animation::EvaluateStats scalar, simd, parallel;
+	Animation::Evaluate(jobs.data(), numCharacters, true, &one, &scalar);
+	Animation::Evaluate(jobs.data(), numCharacters, false, &one, &simd);
+	Animation::Evaluate(parallelJobs.data(), numCharacters, false, &workers, &parallel);
+	for (uint32 i = 0; i < numCharacters; i++)
+		K3D_ASSERT(MaxDifference(poses[i], parallelPoses[i]) == 0.0f);
+	K3D_ASSERT(simd.Jobs == numCharacters && simd.Samples > numCharacters);
+	cout << numCharacters << " characters, " << simd.Samples << " clips sampled: scalar "
+		<< scalar.Samples * numBones / scalar.Milliseconds / 1000.0 << " MBones/s, " << Animation::GetKernel() << " "
+		<< simd.Samples * numBones / simd.Milliseconds / 1000.0 << " MBones/s per core ("
+		<< simd.Milliseconds << " ms), 4 threads " << parallel.Samples * numBones / parallel.Milliseconds / 1000.0 << " MBones/s" << endl;
+}
+
+int main(int argc, char**argv)
+{
+	TestErrorBound();
+	TestAgainstScalar();
+	TestThroughput(argc > 1 ? (uint32)atoi(argv[1]) : 2000);
+	return 0;
+}
@@ -0,0 +1,169 @@
+#include "Common.h"
+#include <Core/AssetCache.h>
+#include <Core/Bundle.h>
+#include <Core/MeshData.h>
+#include <chrono>
+#include <iostream>
+
+#if K3DPLATFORM_OS_WIN
+#pragma comment(linker,"/subsystem:console")
+#endif
+
+using namespace std;
+using namespace k3d;
+
+static const uint32 kNumSources = 48;
+/// the first sources are also exported under a second name
+static const uint32 kNumCopies = 8;
+static const uint32 kGridSide = 128;
+
+kString SourcePath(uint32 i)
+{
+	string path = "./TestAssetCacheSources/scan_" + to_string(i) + ".bin";
+	return kString(path.begin(), path.end());
+}
+
+/// a scanned height field, one float per grid vertex
+void WriteSource(uint32 i, float amplitude)
+{
+	vector<float> heights(kGridSide * kGridSide);
+	for (uint32 v = 0; v < heights.size(); v++)
+		heights[v] = sinf((v % kGridSide) * 0.05f + i) * cosf((v / kGridSide) * 0.05f) * amplitude;
+	Os::File file;
+	K3D_ASSERT(file.Open(SourcePath(i).c_str(), IOWrite));
+	K3D_ASSERT(file.Write(heights.data(), heights.size() * sizeof(float)) == heights.size() * sizeof(float));
+	file.Close();
+}
+
+/// the processing step of the build: source file to serialized mesh
+void ProcessSource(Archive & archive, kString const& path, string const& name)
+{
+	Os::File file;
+	K3D_ASSERT(file.Open(path.c_str(), IORead));
+	vector<float> heights(kGridSide * kGridSide);
+	K3D_ASSERT(file.Read((char*)heights.data(), heights.size() * sizeof(float)) == heights.size() * sizeof(float));
+	vector<float> positions;
+	for (uint32 v = 0; v < heights.size(); v++)
+	{
+		positions.push_back((float)(v % kGridSide));
+		positions.push_back(heights[v]);
+		positions.push_back((float)(v / kGridSide));
+	}
+	vector<uint32> indices;
+	for (uint32 y = 0; y + 1 < kGridSide; y++)
+	{
+		for (uint32 x = 0; x + 1 < kGridSide; x++)
+		{
+			uint32 v = y * kGridSide + x;
+			uint32 quad[] = { v, v + 1, v + kGridSide, v + 1, v + kGridSide + 1, v + kGridSide };
+			indices.insert(indices.end(), quad, quad + 6);
+		}
+	}
+	MeshData mesh;
+	mesh.SetMeshName(name.c_str());
+	mesh.SetVertexFormat(VtxFormat::POS3_F32);
+	mesh.SetVertexNum((int)heights.size());
+	mesh.SetVertexBuffer(positions.data());
+	mesh.SetIndexBuffer(indices);
+	archive << EMeshVersion::VERSION_1_1;
+	archive << mesh;
+}
+
+AssetBundleWriter::Stats BuildScene(const kchar * bundlePath, AssetCache * cache, double & ms)
+{
+	auto start = chrono::high_resolution_clock::now();
+	AssetBundleWriter writer;
+	K3D_ASSERT(writer.Open(bundlePath));
+	writer.SetCompression(EChunkCompression::ELZ, LZ::High);
+	writer.SetCache(cache);
+	for (uint32 i = 0; i < kNumSources + kNumCopies; i++)
+	{
+		uint32 source = i % kNumSources;
+		kString path = SourcePath(source);
+		// the copies are the same mesh under another name
+		string name = (i < kNumSources ? "mesh/" : "copy/") + to_string(source);
+		string meshName = "scan_" + to_string(source);
+		AssetCacheKey key = cache ? cache->HashFile(path.c_str()) : AssetCacheKey{ 0, 0 };
+		writer.AddChunkCached(name.c_str(), EAssetType::EMesh, key,
+			[path, meshName](Archive & archive) { ProcessSource(archive, path, meshName); });
+	}
+	K3D_ASSERT(writer.Finish());
+	ms = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+	return writer.GetStats();
+}
+
+bool SameChunks(const kchar * pathA, const kchar * pathB)
+{
+	AssetBundleReader a, b;
+	if (!a.Open(pathA) || !b.Open(pathB) || a.GetNumChunks() != b.GetNumChunks())
+		return false;
+	for (uint32 i = 0; i < a.GetNumChunks(); i++)
+	{
+		auto chunk = a.GetChunk(i);
+		auto other = b.Find(chunk.Name, chunk.NameLength);
+		if (!other.IsValid() || other.Size != chunk.Size || other.RawSize != chunk.RawSize
+			|| memcmp(other.Data, chunk.Data, (size_t)chunk.Size) != 0)
+			return false;
+	}
+	return true;
+}
+
+void TestAssetCache()
+{
+	Os::Remove(KT("./TestAssetCache"));
+	Os::MakeDir(KT("./TestAssetCacheSources"));
+	for (uint32 i = 0; i < kNumSources; i++)
+		WriteSource(i, 4.0f);
+
+	double full = 0, cold = 0, incremental = 0, reference = 0;
+	auto stats = BuildScene(KT("./TestAssetCacheFull.bundle"), nullptr, full);
+	// the copies share the data of their source mesh
+	K3D_ASSERT(stats.NumDeduplicated == kNumCopies && stats.NumCacheHits == 0);
+	{
+		AssetBundleReader reader;
+		K3D_ASSERT(reader.Open(KT("./TestAssetCacheFull.bundle")));
+		for (uint32 i = 0; i < kNumCopies; i++)
+		{
+			auto mesh = reader.Find(("mesh/" + to_string(i)).c_str());
+			auto copy = reader.Find(("copy/" + to_string(i)).c_str());
+			K3D_ASSERT(mesh.IsValid() && mesh.Data == copy.Data && mesh.Size == copy.Size);
+		}
+	}
+
+	AssetCache cache;
+	K3D_ASSERT(cache.Open(KT("./TestAssetCache")));
+	stats = BuildScene(KT("./TestAssetCacheCold.bundle"), &cache, cold);
+	K3D_ASSERT(stats.NumCacheHits == 0 && cache.GetStats().FilesHashed == kNumSources);
+	K3D_ASSERT(SameChunks(KT("./TestAssetCacheFull.bundle"), KT("./TestAssetCacheCold.bundle")));
+	cache.Close();
+
+	// a new build after one source changed, the stamps are read back from the cache directory
+	const uint32 kChanged = kNumSources - 1;
+	WriteSource(kChanged, 8.0f);
+	K3D_ASSERT(cache.Open(KT("./TestAssetCache")));
+	stats = BuildScene(KT("./TestAssetCacheIncremental.bundle"), &cache, incremental);
+	auto cacheStats = cache.GetStats();
+	K3D_ASSERT(cacheStats.FilesHashed == 1 && cacheStats.FilesUnchanged == kNumSources + kNumCopies - 1);
+	K3D_ASSERT(stats.NumCacheHits == kNumSources + kNumCopies - 1 && stats.NumDeduplicated == kNumCopies);
+	cache.Close();
+
+	BuildScene(KT("./TestAssetCacheReference.bundle"), nullptr, reference);
+	K3D_ASSERT(SameChunks(KT("./TestAssetCacheReference.bundle"), KT("./TestAssetCacheIncremental.bundle")));
+	K3D_ASSERT(!SameChunks(KT("./TestAssetCacheFull.bundle"), KT("./TestAssetCacheIncremental.bundle")));
+
+	cout << kNumSources << " sources, " << kNumCopies << " copies, " << stats.BytesWritten / 1024 << " KB: full build "
+		<< full << " ms, cold cache " << cold << " ms, rebuild after one change " << incremental << " ms" << endl;
+
+	Os::Remove(KT("./TestAssetCacheFull.bundle"));
+	Os::Remove(KT("./TestAssetCacheCold.bundle"));
+	Os::Remove(KT("./TestAssetCacheIncremental.bundle"));
+	Os::Remove(KT("./TestAssetCacheReference.bundle"));
+	Os::Remove(KT("./TestAssetCacheSources"));
+	Os::Remove(KT("./TestAssetCache"));
+}
+
+int main(int argc, char**argv)
+{
+	TestAssetCache();
+	return 0;
+}
@@ -0,0 +1,161 @@
+#include "Common.h"
+#include <Core/AsyncIO.h>
+#include <Core/AssetStreamer.h>
+#include <Core/Dispatch/ThreadPool.h>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+
+#if K3DPLATFORM_OS_WIN
+#pragma comment(linker,"/subsystem:console")
+#endif
+
+using namespace std;
+using namespace k3d;
+
+static const uint32 kNumFiles = 256;
+static const uint32 kFileSize = 256 * 1024;
+
+kString TestFileName(uint32 i)
+{
+	char name[64];
+	sprintf(name, "./TestStream_%d.bin", i);
+	string str(name);
+	return kString(str.begin(), str.end());
+}
+
+void CreateTestFiles()
+{
+	vector<uint32> data(kFileSize / sizeof(uint32));
+	for (uint32 i = 0; i < kNumFiles; i++)
+	{
+		for (auto & word : data)
+			word = i;
+		Os::File file;
+		K3D_ASSERT(file.Open(TestFileName(i).c_str(), IOWrite));
+		file.Write(data.data(), kFileSize);
+		file.Close();
+	}
+}
+
+void TestAssetStreamer()
+{
+	Os::AsyncIO io;
+	io.Init();
+	Dispatch::ThreadPool workers;
+	AssetStreamer::Desc desc;
+	desc.BytesInFlightBudget = 16 * kFileSize;
+	AssetStreamer streamer(&io, &workers, desc);
+
+	atomic<uint32> numDecoded(0);
+	atomic<uint32> numFinished(0);
+	atomic<uint32> numWrong(0);
+	auto start = chrono::high_resolution_clock::now();
+
+	vector<StreamTicket> tickets;
+	for (uint32 round = 0; round < 2; round++)
+	{
+		for (uint32 i = 0; i < kNumFiles; i++)
+		{
+			StreamRequest request;
+			request.Priority = (EStreamPriority)(i % (uint32)EStreamPriority::Count);
+			request.Decode = [&numDecoded](StreamBytes const& bytes) -> StreamObject
+			{
+				numDecoded++;
+				return make_shared<uint32>(*(const uint32*)bytes->data());
+			};
+			request.OnComplete = [&numFinished, &numWrong, i](StreamResult const& result)
+			{
+				if (result.Status != EStreamStatus::Finished || *(uint32*)result.Object.get() != i)
+					numWrong++;
+				numFinished++;
+			};
+			// the second round is deduplicated against the first while in flight
+			request.DeliverOnDispatch = round == 1;
+			tickets.push_back(streamer.Load(TestFileName(i).c_str(), request));
+		}
+	}
+	// cancel every fourth request of the first round
+	uint32 numCancelled = 0;
+	for (uint32 i = 0; i < kNumFiles; i += 4)
+	{
+		if (streamer.Cancel(tickets[i]))
+			numCancelled++;
+	}
+	streamer.WaitIdle();
+	uint32 numDispatched = streamer.DispatchCompletions();
+	double sec = chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+
+	auto stats = streamer.GetStats();
+	cout << "streamed " << stats.NumFinished << " loads, " << stats.BytesRead / sec / (1024.0 * 1024.0)
+		<< " MB/s, " << stats.NumDeduplicated << " deduplicated, " << numCancelled << " cancelled, peak "
+		<< stats.PeakBytesInFlight / 1024 << " KB in flight, " << numDispatched << " dispatched" << endl;
+
+	K3D_ASSERT(numWrong == 0);
+	K3D_ASSERT(numFinished + numCancelled == 2 * kNumFiles);
+	K3D_ASSERT(numDecoded <= kNumFiles);
+	K3D_ASSERT(stats.PeakBytesInFlight <= desc.BytesInFlightBudget);
+	K3D_ASSERT(streamer.GetBytesInFlight() == 0);
+
+	StreamRequest missing;
+	atomic<bool> failed(false);
+	missing.OnComplete = [&failed](StreamResult const& result) { failed = result.Status == EStreamStatus::Failed; };
+	streamer.Load(KT("./TestStream_missing.bin"), missing);
+	streamer.WaitIdle();
+	K3D_ASSERT(failed);
+}
+
+/// every waiter cancels after the read, the decode and post process stages are skipped
+void TestCancelBeforeDecode()
+{
+	Os::AsyncIO io;
+	io.Init();
+	// one worker, the blocker keeps the decode task queued
+	Dispatch::ThreadPool workers(1);
+	AssetStreamer streamer(&io, &workers);
+
+	atomic<bool> release(false);
+	atomic<uint32> numStages(0);
+	atomic<uint32> numCompleted(0);
+	StreamRequest request;
+	request.Decode = [&numStages](StreamBytes const& bytes) -> StreamObject
+	{
+		numStages++;
+		return make_shared<uint32>(*(const uint32*)bytes->data());
+	};
+	request.PostProcess = [&numStages](StreamObject & object)
+	{
+		numStages++;
+		(*(uint32*)object.get())++;
+	};
+	request.OnComplete = [&numCompleted](StreamResult const&) { numCompleted++; };
+	StreamTicket ticket = streamer.Load(TestFileName(0).c_str(), request);
+	// queued behind the pump, which issues the read
+	workers.Submit([&release]() { while (!release) this_thread::yield(); });
+	while (streamer.GetStats().BytesRead < kFileSize)
+		this_thread::yield();
+	K3D_ASSERT(streamer.Cancel(ticket));
+	release = true;
+	streamer.WaitIdle();
+	workers.WaitIdle();
+
+	auto stats = streamer.GetStats();
+	K3D_ASSERT(numStages == 0 && numCompleted == 0);
+	K3D_ASSERT(stats.NumCancelled == 1 && stats.NumFinished == 0 && stats.NumFailed == 0);
+	K3D_ASSERT(streamer.GetNumPending() == 0 && streamer.GetBytesInFlight() == 0);
+
+	// the path loads again afterwards
+	streamer.Load(TestFileName(0).c_str(), request);
+	streamer.WaitIdle();
+	K3D_ASSERT(numStages == 2 && numCompleted == 1 && streamer.GetStats().NumFinished == 1);
+}
+
+int main(int argc, char**argv)
+{
+	CreateTestFiles();
+	TestAssetStreamer();
+	TestCancelBeforeDecode();
+	for (uint32 i = 0; i < kNumFiles; i++)
+		Os::Remove(TestFileName(i).c_str());
+	return 0;
+}
@@ -0,0 +1,176 @@
+#include "Common.h"
+#include <Core/AsyncIO.h>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#if K3DPLATFORM_OS_WIN
+#pragma comment(linker,"/subsystem:console")
+#endif
+
+using namespace std;
+using namespace k3d;
+
+static const char*	kTestFile = "./TestAsyncIO.bundle";
+static const uint64	kReadSize = 64 * 1024;
+static const uint32	kNumReads = 8192;
+static const uint32	kNumSlots = 64;
+
+/// every uint64 of the file holds its own offset
+void CreateTestFile(uint64 fileSize)
+{
+	Os::File file;
+	K3D_ASSERT(file.Open(kTestFile, IOWrite));
+	vector<uint64> block(1 << 17);
+	for (uint64 offset = 0; offset < fileSize; offset += block.size() * sizeof(uint64))
+	{
+		for (uint64 i = 0; i < block.size(); i++)
+			block[i] = offset + i * sizeof(uint64);
+		file.Write(block.data(), block.size() * sizeof(uint64));
+	}
+	file.Close();
+}
+
+vector<uint64> RandomOffsets(uint64 fileSize)
+{
+	mt19937_64 rng(0x4b3d);
+	uniform_int_distribution<uint64> dist(0, (fileSize - kReadSize) / 4096);
+	vector<uint64> offsets(kNumReads);
+	for (auto & offset : offsets)
+		offset = dist(rng) * 4096;
+	return offsets;
+}
+
+void Report(const char* name, chrono::high_resolution_clock::time_point start)
+{
+	double sec = chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+	cout << name << ": " << kNumReads / sec << " IOPS, "
+		<< (kNumReads * kReadSize) / sec / (1024.0 * 1024.0) << " MB/s" << endl;
+}
+
+void TestBlockingRead(vector<uint64> const& offsets)
+{
+	Os::File file;
+	K3D_ASSERT(file.Open(kTestFile, IORead));
+	vector<char> buffer(kReadSize);
+	auto start = chrono::high_resolution_clock::now();
+	for (auto offset : offsets)
+	{
+		file.Seek(offset);
+		K3D_ASSERT(file.Read(buffer.data(), kReadSize) == kReadSize);
+		K3D_ASSERT(*(uint64*)buffer.data() == offset);
+	}
+	Report("blocking read", start);
+	file.Close();
+}
+
+void TestAsyncRead(vector<uint64> const& offsets, bool forceThreadPool, bool fixedBuffers)
+{
+	Os::AsyncIO io;
+	Os::AsyncIO::Desc desc;
+	desc.QueueDepth = kNumSlots;
+	desc.ForceThreadPool = forceThreadPool;
+	K3D_ASSERT(io.Init(desc));
+
+	vector<char> slab(kNumSlots * kReadSize);
+	Os::AsyncIOBuffer buffer = { slab.data(), slab.size() };
+	if (fixedBuffers)
+		io.RegisterBuffers(&buffer, 1);
+
+	Os::File file;
+	K3D_ASSERT(file.Open(kTestFile, IORead));
+	auto start = chrono::high_resolution_clock::now();
+
+	// userData: slot index in the low bits, read index above
+	uint32 next = 0;
+	for (; next < kNumSlots; next++)
+	{
+		io.QueueRead(file.GetNativeHandle(), slab.data() + next * kReadSize, kReadSize,
+			offsets[next], ((uint64)next << 32) | next, nullptr, fixedBuffers ? 0 : -1);
+	}
+	io.Submit();
+	Os::AsyncIOResult results[kNumSlots];
+	uint32 numDone = 0;
+	while (numDone < kNumReads)
+	{
+		uint32 count = io.WaitCompletions(results, 1, kNumSlots);
+		for (uint32 i = 0; i < count; i++)
+		{
+			uint32 slot = (uint32)(results[i].UserData & 0xffffffff);
+			uint32 readId = (uint32)(results[i].UserData >> 32);
+			K3D_ASSERT(results[i].Result == (int64)kReadSize);
+			K3D_ASSERT(*(uint64*)(slab.data() + slot * kReadSize) == offsets[readId]);
+			numDone++;
+			if (next < kNumReads)
+			{
+				io.QueueRead(file.GetNativeHandle(), slab.data() + slot * kReadSize, kReadSize,
+					offsets[next], ((uint64)next << 32) | slot, nullptr, fixedBuffers ? 0 : -1);
+				next++;
+			}
+		}
+		io.Submit();
+	}
+
+	String name;
+	name.AppendSprintf("async read (%s%s)", Os::AsyncIO::BackendName(io.GetBackend()),
+		fixedBuffers ? ", fixed buffers" : "");
+	Report(name.CStr(), start);
+
+	// callbacks
+	std::atomic<uint32> numCallbacks(0);
+	for (uint32 i = 0; i < kNumSlots; i++)
+	{
+		io.QueueRead(file.GetNativeHandle(), slab.data() + i * kReadSize, kReadSize, offsets[i], i,
+			[&numCallbacks](Os::AsyncIOResult const& result) {
+			K3D_ASSERT(result.Result == (int64)kReadSize);
+			numCallbacks++;
+		});
+	}
+	io.Drain();
+	K3D_ASSERT(numCallbacks == kNumSlots);
+	K3D_ASSERT(io.GetNumInFlight() == 0);
+
+	io.Shutdown();
+	file.Close();
+}
+
+/// reads over the end of file return the bytes up to it on every backend
+void TestShortRead(uint64 fileSize, bool forceThreadPool)
+{
+	Os::AsyncIO io;
+	Os::AsyncIO::Desc desc;
+	desc.ForceThreadPool = forceThreadPool;
+	K3D_ASSERT(io.Init(desc));
+	Os::File file;
+	K3D_ASSERT(file.Open(kTestFile, IORead));
+	vector<char> buffer(2 * kReadSize);
+	const uint64 tail = 1000;
+	io.QueueRead(file.GetNativeHandle(), buffer.data(), kReadSize, fileSize - tail, 0);
+	io.QueueRead(file.GetNativeHandle(), buffer.data() + kReadSize, kReadSize, fileSize + 8, 1);
+	Os::AsyncIOResult results[2];
+	uint32 count = 0;
+	while (count < 2)
+		count += io.WaitCompletions(results + count, 2 - count, 2 - count);
+	for (uint32 i = 0; i < 2; i++)
+		K3D_ASSERT(results[i].Result == (results[i].UserData == 0 ? (int64)tail : 0));
+	K3D_ASSERT(*(uint64*)(buffer.data() + tail - sizeof(uint64)) == fileSize - sizeof(uint64));
+	io.Shutdown();
+	file.Close();
+}
+
+int main(int argc, char**argv)
+{
+	uint64 fileSize = (argc > 1 ? atoi(argv[1]) : 256) * 1024ull * 1024ull;
+	CreateTestFile(fileSize);
+	auto offsets = RandomOffsets(fileSize);
+	TestBlockingRead(offsets);
+	TestAsyncRead(offsets, true, false);
+	TestAsyncRead(offsets, false, false);
+	TestAsyncRead(offsets, false, true);
+	TestShortRead(fileSize, true);
+	TestShortRead(fileSize, false);
+	Os::Remove(KT("./TestAsyncIO.bundle"));
+	return 0;
+}
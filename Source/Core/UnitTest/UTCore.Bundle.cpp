@@ -1,15 +1,114 @@
 #include "Common.h"
+#include <Core/Bundle.h>
 #include <Core/MeshData.h>
 #include <Core/CameraData.h>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
 
 #if K3DPLATFORM_OS_WIN
 #pragma comment(linker,"/subsystem:console")
 #endif
 
-using namespace k3d;
 using namespace std;
+using namespace k3d;
+
+static const uint32 kNumChunks = 16 * 1024;
+
+string ChunkName(uint32 i)
+{
+	return "mesh/chunk_" + to_string(i) + ".mesh";
+}
+
+/// every 4th chunk is larger than the alignment
+uint64 ChunkSize(uint32 i)
+{
+	return (i % 4 == 3) ? 80 * 1024 + i : 100 + (i * 37) % 6000;
+}
+
+void FillChunk(vector<kByte> & data, uint32 i)
+{
+	data.resize((size_t)ChunkSize(i));
+	for (size_t b = 0; b < data.size(); b++)
+		data[b] = (kByte)(i + b);
+}
+
+void WriteBundles()
+{
+	vector<kByte> data;
+	AssetBundleWriter writer;
+	K3D_ASSERT(writer.Open(KT("./TestBundleV2.bundle")));
+	for (uint32 i = 0; i < kNumChunks; i++)
+	{
+		FillChunk(data, i);
+		writer.AddChunk(ChunkName(i).c_str(), EAssetType::EMesh, data.data(), data.size());
+	}
+	K3D_ASSERT(writer.Finish());
+
+	// the same chunks in the v1 layout
+	Os::File file;
+	K3D_ASSERT(file.Open(KT("./TestBundleV1.bundle"), IOWrite));
+	Archive arch;
+	arch.SetIODevice(&file);
+	arch << EAssetVersion::E20161210u;
+	arch << (uint64)(kNumChunks * sizeof(AssetChunk));
+	for (uint32 i = 0; i < kNumChunks; i++)
+	{
+		AssetChunk chunk;
+		memset(&chunk, 0, sizeof(chunk));
+		chunk.Type = EAssetType::EMesh;
+		chunk.Size = ChunkSize(i);
+		strncpy(chunk.Name, ChunkName(i).c_str(), sizeof(chunk.Name));
+		arch << chunk;
+	}
+	for (uint32 i = 0; i < kNumChunks; i++)
+	{
+		FillChunk(data, i);
+		arch << EAssetType::EMesh;
+		arch.ArrayIn((const char*)data.data(), data.size());
+		arch << EAssetType::EChunkEnd;
+	}
+	file.Close();
+}
+
+/// what a v1 reader does: read the table, sum the sizes up to the chunk, read it
+uint64 FirstAssetV1(string const& name, vector<kByte> & data)
+{
+	Os::File file;
+	K3D_ASSERT(file.Open(KT("./TestBundleV1.bundle"), IORead));
+	uint64 tableSize = 0;
+	file.ReadAt(&tableSize, sizeof(tableSize), sizeof(EAssetVersion));
+	vector<AssetChunk> table((size_t)(tableSize / sizeof(AssetChunk)));
+	file.ReadAt(table.data(), (size_t)tableSize, sizeof(EAssetVersion) + sizeof(uint64));
+	uint64 offset = sizeof(EAssetVersion) + sizeof(uint64) + tableSize;
+	for (auto & chunk : table)
+	{
+		if (name == chunk.Name)
+		{
+			data.resize((size_t)chunk.Size);
+			file.ReadAt(data.data(), data.size(), offset + sizeof(EAssetType));
+			return data.size();
+		}
+		offset += sizeof(EAssetType) + chunk.Size + sizeof(EAssetType);
+	}
+	return 0;
+}
 
-void TestBundle()
+uint64 FirstAssetV2(string const& name)
+{
+	AssetBundleReader reader;
+	K3D_ASSERT(reader.Open(KT("./TestBundleV2.bundle")));
+	auto view = reader.Find(name.c_str());
+	K3D_ASSERT(view.IsValid());
+	uint64 sum = 0;
+	for (uint64 b = 0; b < view.Size; b += 64)
+		sum += view.Data[b];
+	return sum;
+}
+
+/// the checked-in v1 bundle still reads through the chunk table
+void TestBundleV1()
 {
 		Os::File file("../../Data/Test/test.bundle");
 		file.Open(IORead);
@@ -55,8 +154,193 @@ void TestBundle()
 		file.Close();
 }
 
+void TestBundleV2()
+{
+	WriteBundles();
+
+	AssetBundleReader reader;
+	K3D_ASSERT(reader.Open(KT("./TestBundleV2.bundle")));
+	K3D_ASSERT(reader.GetNumChunks() == kNumChunks);
+	const uint64 alignment = reader.GetChunkAlignment();
+	vector<kByte> data;
+	for (uint32 i = 0; i < kNumChunks; i++)
+	{
+		auto view = reader.Find(ChunkName(i).c_str());
+		K3D_ASSERT(view.IsValid() && view.Type == EAssetType::EMesh);
+		FillChunk(data, i);
+		K3D_ASSERT(view.Size == data.size() && memcmp(view.Data, data.data(), data.size()) == 0);
+		uint64 offset = view.Data - reader.GetFile()->FileData();
+		K3D_ASSERT(offset % kAssetChunkMinAlignment == 0);
+		// large chunks start on a boundary, small ones never straddle one
+		if (view.Size >= alignment)
+		{
+			K3D_ASSERT(offset % alignment == 0);
+		}
+		else
+		{
+			K3D_ASSERT(offset / alignment == (offset + view.Size - 1) / alignment);
+		}
+		auto byIndex = reader.GetChunk(i);
+		K3D_ASSERT(byIndex.Data == view.Data && string(byIndex.Name, byIndex.NameLength) == ChunkName(i));
+	}
+	K3D_ASSERT(!reader.Find("mesh/missing.mesh").IsValid());
+
+	mt19937 rng(7);
+	vector<string> names;
+	for (uint32 i = 0; i < 1024; i++)
+		names.push_back(ChunkName(rng() % kNumChunks));
+	const uint32 kNumLookups = 1000000;
+	uint64 found = 0;
+	auto start = chrono::high_resolution_clock::now();
+	for (uint32 i = 0; i < kNumLookups; i++)
+		found += reader.Find(names[i % names.size()].c_str()).Size;
+	double lookup = chrono::duration<double, nano>(chrono::high_resolution_clock::now() - start).count() / kNumLookups;
+	K3D_ASSERT(found > 0);
+	reader.Close();
+
+	// median of a few runs, the last chunk is the worst case for v1
+	const uint32 kNumRuns = 9;
+	string last = ChunkName(kNumChunks - 1);
+	vector<double> v1, v2;
+	for (uint32 r = 0; r < kNumRuns; r++)
+	{
+		start = chrono::high_resolution_clock::now();
+		K3D_ASSERT(FirstAssetV1(last, data) == ChunkSize(kNumChunks - 1));
+		v1.push_back(chrono::duration<double, micro>(chrono::high_resolution_clock::now() - start).count());
+		start = chrono::high_resolution_clock::now();
+		FirstAssetV2(last);
+		v2.push_back(chrono::duration<double, micro>(chrono::high_resolution_clock::now() - start).count());
+	}
+	sort(v1.begin(), v1.end());
+	sort(v2.begin(), v2.end());
+	cout << kNumChunks << " chunks, time to first asset: v1 table walk " << v1[kNumRuns / 2]
+		<< " us, v2 indexed " << v2[kNumRuns / 2] << " us; " << lookup << " ns per lookup" << endl;
+
+	Os::Remove(KT("./TestBundleV1.bundle"));
+	Os::Remove(KT("./TestBundleV2.bundle"));
+}
+
+static const uint32 kNumMeshes = 32;
+static const uint32 kNumMeshVertices = 128 * 1024;
+
+shared_ptr<MeshData> CreateMesh(uint32 i)
+{
+	auto mesh = make_shared<MeshData>();
+	mesh->SetMeshName(("mesh_" + to_string(i)).c_str());
+	mesh->SetVertexFormat(VtxFormat::POS3_F32);
+	mesh->SetVertexNum(kNumMeshVertices);
+	vector<float> positions(kNumMeshVertices * 3);
+	for (size_t v = 0; v < positions.size(); v++)
+		positions[v] = (float)(i * v);
+	mesh->SetVertexBuffer(positions.data());
+	vector<uint32> indices(kNumMeshVertices);
+	for (uint32 v = 0; v < kNumMeshVertices; v++)
+		indices[v] = (v * 7 + i) % kNumMeshVertices;
+	mesh->SetIndexBuffer(indices);
+	return mesh;
+}
+
+void WriteMesh(Archive & archive, MeshData const& mesh)
+{
+	archive << EMeshVersion::VERSION_1_1;
+	archive << mesh;
+}
+
+/// the former export path: one cache file per mesh, read back and copied into the bundle
+void ExportThroughCacheFiles(vector<shared_ptr<MeshData>> const& meshes)
+{
+	Os::MakeDir(KT("./TestExportCache"));
+	AssetBundleWriter writer;
+	K3D_ASSERT(writer.Open(KT("./TestExportCache.bundle")));
+	for (auto & mesh : meshes)
+	{
+		string name = string("./TestExportCache/") + mesh->Name();
+		kString path(name.begin(), name.end());
+		Os::File file;
+		K3D_ASSERT(file.Open(path.c_str(), IOWrite));
+		Archive archive;
+		archive.SetIODevice(&file);
+		WriteMesh(archive, *mesh);
+		file.Close();
+	}
+	for (auto & mesh : meshes)
+	{
+		string name = string("./TestExportCache/") + mesh->Name();
+		kString path(name.begin(), name.end());
+		Os::File file;
+		K3D_ASSERT(file.Open(path.c_str(), IORead));
+		vector<char> data((size_t)file.GetSize());
+		file.Read(data.data(), data.size());
+		writer.AddChunk(mesh->Name(), EAssetType::EMesh, data.data(), data.size());
+		file.Close();
+		Os::Remove(path.c_str());
+	}
+	K3D_ASSERT(writer.Finish());
+	Os::Remove(KT("./TestExportCache"));
+}
+
+bool SameChunks(const kchar * pathA, const kchar * pathB)
+{
+	AssetBundleReader a, b;
+	if (!a.Open(pathA) || !b.Open(pathB) || a.GetNumChunks() != b.GetNumChunks())
+		return false;
+	for (uint32 i = 0; i < a.GetNumChunks(); i++)
+	{
+		auto chunk = a.GetChunk(i);
+		auto other = b.Find(chunk.Name, chunk.NameLength);
+		if (!other.IsValid() || other.Size != chunk.Size || memcmp(other.Data, chunk.Data, (size_t)chunk.Size) != 0)
+			return false;
+	}
+	return true;
+}
+
+void TestBundleExport()
+{
+	vector<shared_ptr<MeshData>> meshes;
+	for (uint32 i = 0; i < kNumMeshes; i++)
+		meshes.push_back(CreateMesh(i));
+
+	auto start = chrono::high_resolution_clock::now();
+	ExportThroughCacheFiles(meshes);
+	double cached = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+
+	start = chrono::high_resolution_clock::now();
+	AssetBundle * bundle = AssetBundle::CreateBundle(KT("TestExport.bundle"), KT("./"));
+	bundle->Prepare();
+	for (auto & mesh : meshes)
+		bundle->Serialize(mesh);
+	bundle->MergeAndBundle(true);
+	delete bundle;
+	double streamed = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+
+	// a budget of a few meshes, the rest goes through spill files
+	start = chrono::high_resolution_clock::now();
+	AssetBundleWriter writer(kAssetBundleAlignment, 8 << 20);
+	K3D_ASSERT(writer.Open(KT("./TestExportSpill.bundle")));
+	for (auto & mesh : meshes)
+	{
+		auto source = mesh;
+		writer.AddChunkAsync(mesh->Name(), EAssetType::EMesh, [source](Archive & archive) { WriteMesh(archive, *source); });
+	}
+	K3D_ASSERT(writer.Finish());
+	double spilled = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+	auto stats = writer.GetStats();
+	K3D_ASSERT(stats.NumSpilled > 0 && stats.NumSpilled < kNumMeshes);
+
+	K3D_ASSERT(SameChunks(KT("./TestExportCache.bundle"), KT("./TestExport.bundle")));
+	K3D_ASSERT(SameChunks(KT("./TestExportCache.bundle"), KT("./TestExportSpill.bundle")));
+	cout << "export of " << kNumMeshes << " meshes, " << stats.BytesWritten / (1024 * 1024) << " MB: cache files "
+		<< cached << " ms, streamed " << streamed << " ms, " << stats.NumSpilled << " spilled " << spilled << " ms" << endl;
+
+	Os::Remove(KT("./TestExportCache.bundle"));
+	Os::Remove(KT("./TestExport.bundle"));
+	Os::Remove(KT("./TestExportSpill.bundle"));
+}
+
 int main(int argc, char**argv)
 {
-	TestBundle();
+	TestBundleV1();
+	TestBundleV2();
+	TestBundleExport();
 	return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,218 @@
+#include "Common.h"
+#include <Core/Bundle.h>
+#include <Core/MeshData.h>
+#include <Core/Utils/LZ.h>
+#include <Core/Dispatch/ThreadPool.h>
+#include <chrono>
+#include <iostream>
+#include <random>
+
+#if K3DPLATFORM_OS_WIN
+#pragma comment(linker,"/subsystem:console")
+#endif
+
+using namespace std;
+using namespace k3d;
+
+static const uint32 kNumChunksPerType = 8;
+
+void TestCodec()
+{
+	mt19937 rng(11);
+	for (size_t size : { 0, 1, 12, 13, 100, 4096, 70000, 300000 })
+	{
+		vector<vector<kByte>> inputs(3, vector<kByte>(size));
+		for (size_t i = 0; i < size; i++)
+		{
+			inputs[0][i] = (kByte)rng();
+			inputs[1][i] = (kByte)((i / 5) % 17);
+			inputs[2][i] = 'a';
+		}
+		for (auto & input : inputs)
+		{
+			for (auto level : { LZ::Fast, LZ::High })
+			{
+				vector<kByte> packed(LZ::CompressBound(size));
+				size_t packedSize = LZ::Compress(input.data(), size, packed.data(), packed.size(), level);
+				K3D_ASSERT(packedSize > 0);
+				vector<kByte> output(size);
+				K3D_ASSERT(LZ::Decompress(packed.data(), packedSize, output.data(), size) == size);
+				K3D_ASSERT(output == input);
+				// corrupted or truncated streams fail without writing past the output
+				for (uint32 i = 0; i < 64; i++)
+				{
+					auto corrupted = packed;
+					corrupted[rng() % packedSize] ^= (kByte)(1 + rng() % 255);
+					LZ::Decompress(corrupted.data(), packedSize, output.data(), size);
+					LZ::Decompress(packed.data(), rng() % packedSize, output.data(), size);
+				}
+			}
+		}
+	}
+}
+
+void WriteMeshChunk(Archive & archive, uint32 index)
+{
+	// a height field, like most scanned or sculpted meshes
+	const uint32 kSide = 256;
+	MeshData mesh;
+	mesh.SetMeshName(("mesh_" + to_string(index)).c_str());
+	mesh.SetVertexFormat(VtxFormat::POS3_F32);
+	mesh.SetVertexNum(kSide * kSide);
+	vector<float> positions;
+	for (uint32 y = 0; y < kSide; y++)
+	{
+		for (uint32 x = 0; x < kSide; x++)
+		{
+			positions.push_back((float)x);
+			positions.push_back(sinf(x * 0.05f + index) * cosf(y * 0.05f) * 4.0f);
+			positions.push_back((float)y);
+		}
+	}
+	mesh.SetVertexBuffer(positions.data());
+	vector<uint32> indices;
+	for (uint32 y = 0; y + 1 < kSide; y++)
+	{
+		for (uint32 x = 0; x + 1 < kSide; x++)
+		{
+			uint32 v = y * kSide + x;
+			uint32 quad[] = { v, v + 1, v + kSide, v + 1, v + kSide + 1, v + kSide };
+			indices.insert(indices.end(), quad, quad + 6);
+		}
+	}
+	mesh.SetIndexBuffer(indices);
+	archive << EMeshVersion::VERSION_1_1;
+	archive << mesh;
+}
+
+void WriteShaderChunk(Archive & archive, uint32 index)
+{
+	mt19937 rng(index);
+	string source = "#version 450\nlayout(set = 0, binding = 0) uniform Camera { mat4 view; mat4 proj; } camera;\n";
+	while (source.size() < (1 << 20))
+	{
+		uint32 n = rng() % 64;
+		source += "vec4 shade" + to_string(n) + "(vec3 normal, vec3 lightDir, vec4 albedo)\n{\n"
+			"\tfloat ndotl = max(dot(normalize(normal), lightDir), 0.0);\n"
+			"\treturn vec4(albedo.rgb * ndotl * " + to_string(rng() % 100) + ".0, albedo.a);\n}\n";
+	}
+	archive.ArrayIn(source.data(), source.size());
+}
+
+void WriteImageChunk(Archive & archive, uint32 index)
+{
+	// RGBA8 gradient with sensor-like noise in the low bits
+	mt19937 rng(index);
+	const uint32 kSide = 512;
+	vector<kByte> pixels(kSide * kSide * 4);
+	for (uint32 y = 0; y < kSide; y++)
+	{
+		for (uint32 x = 0; x < kSide; x++)
+		{
+			kByte * p = &pixels[(y * kSide + x) * 4];
+			p[0] = (kByte)((x / 2 + index) & 0xfc);
+			p[1] = (kByte)(((y / 2) & 0xfc) | (rng() & 1));
+			p[2] = (kByte)((x + y) / 4);
+			p[3] = 255;
+		}
+	}
+	archive.ArrayIn(pixels.data(), pixels.size());
+}
+
+struct AssetKind
+{
+	const char *	Name;
+	EAssetType		Type;
+	void			(*Write)(Archive &, uint32);
+};
+
+void TestCompressedBundle()
+{
+	AssetKind kinds[] = {
+		{ "mesh", EAssetType::EMesh, WriteMeshChunk },
+		{ "shader", EAssetType::EShaderSource, WriteShaderChunk },
+		{ "image", EAssetType::EImage, WriteImageChunk },
+	};
+	const kchar * paths[] = { KT("./TestCompressionRaw.bundle"), KT("./TestCompressionFast.bundle"),
+		KT("./TestCompressionHigh.bundle"), KT("./TestCompressionSpilled.bundle") };
+	// the last one is fast with a budget too small to keep any chunk in memory
+	for (uint32 mode = 0; mode < 4; mode++)
+	{
+		AssetBundleWriter writer(kAssetBundleAlignment, mode == 3 ? 4096 : 256ull << 20);
+		K3D_ASSERT(writer.Open(paths[mode]));
+		if (mode > 0)
+			writer.SetCompression(EChunkCompression::ELZ, mode == 2 ? LZ::High : LZ::Fast);
+		for (auto & kind : kinds)
+		{
+			for (uint32 i = 0; i < kNumChunksPerType; i++)
+			{
+				auto write = kind.Write;
+				string name = string(kind.Name) + "/" + to_string(i);
+				writer.AddChunkAsync(name.c_str(), kind.Type, [write, i](Archive & archive) { write(archive, i); });
+			}
+		}
+		K3D_ASSERT(writer.Finish());
+		if (mode > 0)
+			K3D_ASSERT(writer.GetStats().NumCompressed > 0);
+		if (mode == 3)
+			K3D_ASSERT(writer.GetStats().NumSpilled == kNumChunksPerType * 3);
+	}
+	{
+		// compressed chunks over the budget stay spilled, the bundle doesn't change
+		Os::MemMapFile fast, spilled;
+		K3D_ASSERT(fast.Open(paths[1], IORead) && spilled.Open(paths[3], IORead));
+		K3D_ASSERT(fast.GetSize() == spilled.GetSize() && memcmp(fast.FileData(), spilled.FileData(), fast.GetSize()) == 0);
+	}
+
+	Dispatch::ThreadPool workers;
+	AssetBundleReader raw, fast, high;
+	K3D_ASSERT(raw.Open(paths[0]) && fast.Open(paths[1]) && high.Open(paths[2]));
+	for (auto & kind : kinds)
+	{
+		uint64 rawBytes = 0, fastBytes = 0, highBytes = 0;
+		double serialSec = 0, parallelSec = 0;
+		for (uint32 i = 0; i < kNumChunksPerType; i++)
+		{
+			string name = string(kind.Name) + "/" + to_string(i);
+			auto expected = raw.Find(name.c_str());
+			K3D_ASSERT(expected.IsValid() && expected.Compression == EChunkCompression::ENone);
+			rawBytes += expected.Size;
+			for (auto reader : { &fast, &high })
+			{
+				auto view = reader->Find(name.c_str());
+				K3D_ASSERT(view.IsValid() && view.RawSize == expected.Size && view.Type == kind.Type);
+				(reader == &fast ? fastBytes : highBytes) += view.Size;
+				vector<kByte> decoded((size_t)view.RawSize);
+				auto start = chrono::high_resolution_clock::now();
+				K3D_ASSERT(AssetBundleReader::Decode(view, decoded.data()));
+				auto mid = chrono::high_resolution_clock::now();
+				K3D_ASSERT(memcmp(decoded.data(), expected.Data, decoded.size()) == 0);
+				memset(decoded.data(), 0, decoded.size());
+				auto parallelStart = chrono::high_resolution_clock::now();
+				K3D_ASSERT(AssetBundleReader::Decode(view, decoded.data(), &workers));
+				auto end = chrono::high_resolution_clock::now();
+				K3D_ASSERT(memcmp(decoded.data(), expected.Data, decoded.size()) == 0);
+				if (reader == &fast)
+				{
+					serialSec += chrono::duration<double>(mid - start).count();
+					parallelSec += chrono::duration<double>(end - parallelStart).count();
+				}
+			}
+		}
+		cout << kind.Name << ": ratio fast " << (double)rawBytes / fastBytes << ", high " << (double)rawBytes / highBytes
+			<< "; decode " << rawBytes / serialSec / 1e9 << " GB/s, " << rawBytes / parallelSec / 1e9 << " GB/s on "
+			<< workers.GetNumThreads() << " workers" << endl;
+	}
+	raw.Close();
+	fast.Close();
+	high.Close();
+	for (auto path : paths)
+		Os::Remove(path);
+}
+
+int main(int argc, char**argv)
+{
+	TestCodec();
+	TestCompressedBundle();
+	return 0;
+}
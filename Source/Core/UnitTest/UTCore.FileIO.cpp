@@ -0,0 +1,145 @@
+#include "Common.h"
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if K3DPLATFORM_OS_WIN
+#pragma comment(linker,"/subsystem:console")
+#endif
+
+using namespace std;
+using namespace k3d;
+
+static const uint64 kFileSize = 64ull << 20;
+static const uint32 kChunkSize = 256 * 1024;
+static const uint32 kNumChunks = (uint32)(kFileSize / kChunkSize);
+
+/// every 8 bytes of the file hold their own offset
+bool CheckChunk(const uint64 * data, uint64 offset, size_t size)
+{
+	for (size_t i = 0; i < size / sizeof(uint64); i++)
+	{
+		if (data[i] != offset + i * sizeof(uint64))
+			return false;
+	}
+	return true;
+}
+
+void CreateTestFile()
+{
+	Os::File file;
+	K3D_ASSERT(file.Open(KT("./TestFileIO.bin"), IOWrite));
+	vector<uint64> chunk(kChunkSize / sizeof(uint64));
+	// written back to front through WriteAt
+	for (uint32 c = kNumChunks; c-- > 0;)
+	{
+		uint64 offset = (uint64)c * kChunkSize;
+		for (size_t i = 0; i < chunk.size(); i++)
+			chunk[i] = offset + i * sizeof(uint64);
+		K3D_ASSERT(file.WriteAt(chunk.data(), kChunkSize, offset) == kChunkSize);
+	}
+	file.Close();
+}
+
+/// each thread reads every numThreads-th chunk of the shared handle
+double ParallelRead(Os::File & file, uint32 numThreads, bool positional)
+{
+	mutex seekLock;
+	vector<thread> threads;
+	auto start = chrono::high_resolution_clock::now();
+	for (uint32 t = 0; t < numThreads; t++)
+	{
+		threads.emplace_back([&file, &seekLock, t, numThreads, positional]()
+		{
+			vector<uint64> chunk(kChunkSize / sizeof(uint64));
+			for (uint32 c = t; c < kNumChunks; c += numThreads)
+			{
+				uint64 offset = (uint64)c * kChunkSize;
+				if (positional)
+				{
+					K3D_ASSERT(file.ReadAt(chunk.data(), kChunkSize, offset) == kChunkSize);
+				}
+				else
+				{
+					lock_guard<mutex> lock(seekLock);
+					file.Seek((size_t)offset);
+					K3D_ASSERT(file.Read((char*)chunk.data(), kChunkSize) == kChunkSize);
+				}
+				K3D_ASSERT(CheckChunk(chunk.data(), offset, kChunkSize));
+			}
+		});
+	}
+	for (auto & th : threads)
+		th.join();
+	double sec = chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+	return kFileSize / sec / (1024.0 * 1024.0);
+}
+
+void TestReadV(Os::File & file)
+{
+	// three buffers of odd sizes, the second one starts mid-word
+	vector<char> a(1000), b(4096 + 12), c(333);
+	Os::File::IOVec buffers[] = { { a.data(), a.size() }, { b.data(), b.size() }, { c.data(), c.size() } };
+	uint64 offset = 8 * 1000;
+	size_t total = a.size() + b.size() + c.size();
+	K3D_ASSERT(file.ReadV(buffers, 3, offset) == total);
+	vector<char> expected(total);
+	K3D_ASSERT(file.ReadAt(expected.data(), total, offset) == total);
+	K3D_ASSERT(memcmp(expected.data(), a.data(), a.size()) == 0);
+	K3D_ASSERT(memcmp(expected.data() + a.size(), b.data(), b.size()) == 0);
+	K3D_ASSERT(memcmp(expected.data() + a.size() + b.size(), c.data(), c.size()) == 0);
+	// short at the end of the file
+	K3D_ASSERT(file.ReadV(buffers, 3, kFileSize - 1500) == 1500);
+}
+
+void TestDirectRead()
+{
+	Os::File file;
+	if (!file.Open(KT("./TestFileIO.bin"), (IOFlag)(IORead | IODirect)))
+	{
+		// e.g. tmpfs has no O_DIRECT
+		cout << "direct IO not supported here, skipped" << endl;
+		return;
+	}
+	K3D_ASSERT(file.IsDirect());
+	const size_t alignment = Os::File::GetDirectAlignment();
+	const size_t blockSize = 4 << 20;
+	uint64 * block = (uint64*)Os::File::AllocateAligned(blockSize, alignment);
+	K3D_ASSERT(block != nullptr);
+	auto start = chrono::high_resolution_clock::now();
+	for (uint64 offset = 0; offset < kFileSize; offset += blockSize)
+	{
+		K3D_ASSERT(file.ReadAt(block, blockSize, offset) == blockSize);
+		K3D_ASSERT(CheckChunk(block, offset, blockSize));
+	}
+	double sec = chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+	cout << "direct sequential read: " << kFileSize / sec / (1024.0 * 1024.0) << " MB/s" << endl;
+	Os::File::FreeAligned(block);
+	file.Close();
+}
+
+void TestFileIO()
+{
+	CreateTestFile();
+	Os::File file;
+	K3D_ASSERT(file.Open(KT("./TestFileIO.bin"), IORead));
+	TestReadV(file);
+	for (uint32 numThreads = 1; numThreads <= 8; numThreads *= 2)
+	{
+		double locked = ParallelRead(file, numThreads, false);
+		double positional = ParallelRead(file, numThreads, true);
+		cout << numThreads << " threads on one handle: seek+read " << locked << " MB/s, ReadAt "
+			<< positional << " MB/s" << endl;
+	}
+	file.Close();
+	TestDirectRead();
+	Os::Remove(KT("./TestFileIO.bin"));
+}
+
+int main(int argc, char**argv)
+{
+	TestFileIO();
+	return 0;
+}
@@ -0,0 +1,257 @@
+#include "Common.h"
+#include <Core/AssetManager.h>
+#include <Core/AssetReloader.h>
+#include <Core/Bundle.h>
+#include <Core/FileWatcher.h>
+#include <Core/MeshData.h>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+#if K3DPLATFORM_OS_WIN
+#pragma comment(linker,"/subsystem:console")
+#endif
+
+using namespace std;
+using namespace k3d;
+
+static const uint32 kNumMeshes = 64;
+static const uint32 kChangedMesh = 17;
+
+kString ToKString(string const& str)
+{
+	return kString(str.begin(), str.end());
+}
+
+void WriteFile(string const& path, string const& content)
+{
+	Os::File file;
+	K3D_ASSERT(file.Open(ToKString(path).c_str(), IOWrite));
+	file.Write(content.data(), content.size());
+	file.Close();
+}
+
+/// waits until 'done' holds or two seconds have passed
+template <typename Pred>
+bool WaitFor(Pred done)
+{
+	for (uint32 i = 0; i < 200; i++)
+	{
+		if (done())
+			return true;
+		this_thread::sleep_for(chrono::milliseconds(10));
+	}
+	return done();
+}
+
+struct EventLog
+{
+	mutex						Lock;
+	vector<Os::FileWatcher::Event>	Events;
+
+	void Append(vector<Os::FileWatcher::Event> const& events)
+	{
+		lock_guard<mutex> lock(Lock);
+		Events.insert(Events.end(), events.begin(), events.end());
+	}
+
+	/// merged actions of every event of 'path', 0 if there was none
+	uint32 Find(string const& path, uint32 & count)
+	{
+		lock_guard<mutex> lock(Lock);
+		uint32 actions = 0;
+		count = 0;
+		for (auto & event : Events)
+		{
+			if (event.Path == ToKString(path))
+			{
+				actions |= event.Actions;
+				count++;
+			}
+		}
+		return actions;
+	}
+};
+
+void TestFileWatcher()
+{
+	Os::Remove(KT("./TestWatch"));
+	Os::MakeDir(KT("./TestWatch"));
+	EventLog log;
+	Os::FileWatcher watcher;
+	K3D_ASSERT(watcher.Watch(KT("./TestWatch")));
+	K3D_ASSERT(watcher.Start([&log](vector<Os::FileWatcher::Event> const& events) { log.Append(events); }, 50));
+
+	// an editor saving in several writes
+	{
+		Os::File file;
+		K3D_ASSERT(file.Open(KT("./TestWatch/a.txt"), IOWrite));
+		for (uint32 i = 0; i < 8; i++)
+		{
+			file.Write("line\n", 5);
+			this_thread::sleep_for(chrono::milliseconds(2));
+		}
+		file.Close();
+	}
+	uint32 count = 0;
+	K3D_ASSERT(WaitFor([&]() { return log.Find("./TestWatch/a.txt", count) != 0; }));
+	this_thread::sleep_for(chrono::milliseconds(100));
+	uint32 actions = log.Find("./TestWatch/a.txt", count);
+	K3D_ASSERT(count == 1 && (actions & Os::FileWatcher::Added) && (actions & Os::FileWatcher::Modified));
+
+	// a file in a directory created after Watch()
+	Os::MakeDir(KT("./TestWatch/sub"));
+	WriteFile("./TestWatch/sub/b.txt", "b");
+	K3D_ASSERT(WaitFor([&]() { return log.Find("./TestWatch/sub/b.txt", count) != 0; }));
+	K3D_ASSERT(watcher.GetNumWatches() == 2);
+
+	Os::Remove(KT("./TestWatch/a.txt"));
+	K3D_ASSERT(WaitFor([&]() { return (log.Find("./TestWatch/a.txt", count) & Os::FileWatcher::Removed) != 0; }));
+
+	K3D_ASSERT(watcher.Unwatch(KT("./TestWatch")) && watcher.GetNumWatches() == 0);
+	watcher.Stop();
+	K3D_ASSERT(!watcher.IsRunning());
+	Os::Remove(KT("./TestWatch"));
+}
+
+/// a watcher thread stuck in its callback makes the kernel drop events, which
+/// is reported once for the watched root
+void TestOverflow()
+{
+	Os::Remove(KT("./TestOverflow"));
+	Os::MakeDir(KT("./TestOverflow"));
+	Os::MakeDir(KT("./TestOverflow/sub"));
+	EventLog log;
+	atomic<bool> blocked(false), release(false);
+	Os::FileWatcher watcher;
+	K3D_ASSERT(watcher.Watch(KT("./TestOverflow")));
+	K3D_ASSERT(watcher.Start([&](vector<Os::FileWatcher::Event> const& events)
+	{
+		blocked = true;
+		while (!release)
+			this_thread::sleep_for(chrono::milliseconds(1));
+		log.Append(events);
+	}, 10));
+	WriteFile("./TestOverflow/first.txt", "first");
+	K3D_ASSERT(WaitFor([&]() { return blocked.load(); }));
+	// two events a rewrite, more than the 16384 inotify queues by default
+	for (uint32 i = 0; i < 10000; i++)
+		WriteFile("./TestOverflow/sub/flood.txt", to_string(i));
+	release = true;
+	uint32 count = 0;
+	K3D_ASSERT(WaitFor([&]() { return (log.Find("./TestOverflow", count) & Os::FileWatcher::Overflow) != 0; }));
+	K3D_ASSERT(count == 1 && log.Find("./TestOverflow/sub", count) == 0);
+
+	uint32 found = 0;
+	K3D_ASSERT(Os::FileWatcher::Scan(KT("./TestOverflow"), [&found](kString const& path, uint64 size, uint64)
+	{
+		found += path == ToKString("./TestOverflow/sub/flood.txt") && size == 4;
+	}));
+	K3D_ASSERT(found == 1);
+	watcher.Stop();
+	Os::Remove(KT("./TestOverflow"));
+}
+
+void WriteMeshBundle(const kchar * path, float changedScale)
+{
+	AssetBundleWriter writer;
+	K3D_ASSERT(writer.Open(path));
+	writer.SetCompression(EChunkCompression::ELZ, LZ::Fast);
+	for (uint32 m = 0; m < kNumMeshes; m++)
+	{
+		float scale = m == kChangedMesh ? changedScale : 1.0f;
+		string name = "reload_" + to_string(m);
+		writer.AddChunk(name.c_str(), EAssetType::EMesh, [m, scale, name](Archive & archive)
+		{
+			vector<float> positions;
+			for (uint32 v = 0; v < 1024; v++)
+			{
+				positions.push_back(v * scale);
+				positions.push_back((float)m);
+				positions.push_back(sinf(v * 0.1f) * scale);
+			}
+			vector<uint32> indices;
+			for (uint32 i = 0; i + 2 < 1024; i++)
+			{
+				indices.push_back(i);
+				indices.push_back(i + 1);
+				indices.push_back(i + 2);
+			}
+			MeshData mesh;
+			mesh.SetMeshName(name.c_str());
+			mesh.SetVertexFormat(VtxFormat::POS3_F32);
+			mesh.SetVertexNum(1024);
+			mesh.SetVertexBuffer(positions.data());
+			mesh.SetIndexBuffer(indices);
+			archive << EMeshVersion::VERSION_1_1;
+			archive << mesh;
+		});
+	}
+	K3D_ASSERT(writer.Finish());
+}
+
+void TestHotReload()
+{
+	Os::Remove(KT("./TestReload"));
+	Os::MakeDir(KT("./TestReload"));
+	WriteMeshBundle(KT("./TestReload/scene.bundle"), 1.0f);
+	WriteFile("./TestReload/lit.glsl", "void main() {}");
+
+	AssetManager & manager = AssetManager::Get();
+	K3D_ASSERT(manager.LoadMeshBundle(KT("./TestReload/scene.bundle")) == kNumMeshes);
+	vector<SpMesh> before;
+	for (uint32 m = 0; m < kNumMeshes; m++)
+		before.push_back(manager.FindMesh(("reload_" + to_string(m)).c_str()));
+
+	K3D_ASSERT(manager.EnableHotReload(KT("./TestReload")));
+	// the app side of a shader reload, the source is compiled on a worker
+	string shader;
+	manager.GetReloader()->RegisterImporter(KT(".glsl"), [&shader](kString const& path) -> AssetReloader::CommitFunc
+	{
+		Os::File file;
+		if (!file.Open(path.c_str(), IORead))
+			return AssetReloader::CommitFunc();
+		string source((size_t)file.GetSize(), '\0');
+		file.Read(&source[0], source.size());
+		return [&shader, source]() { shader = source; };
+	});
+
+	// the main loop, meshes only change between frames
+	WriteMeshBundle(KT("./TestReload/scene.bundle"), 2.0f);
+	K3D_ASSERT(WaitFor([&]() { manager.UpdateHotReload(); return manager.GetReloader()->GetStats().NumCommits == 1; }));
+	for (uint32 m = 0; m < kNumMeshes; m++)
+	{
+		auto mesh = manager.FindMesh(("reload_" + to_string(m)).c_str());
+		K3D_ASSERT(mesh && (mesh == before[m]) == (m != kChangedMesh));
+	}
+	K3D_ASSERT(manager.FindMesh("reload_17")->GetVertexBuffer()[3] == 2.0f);
+
+	// rewriting the same content commits nothing, a slow rewrite may also be
+	// caught half written, which commits nothing as well
+	WriteMeshBundle(KT("./TestReload/scene.bundle"), 2.0f);
+	K3D_ASSERT(WaitFor([&]() { return manager.GetReloader()->GetStats().NumEmptyImports > 0; }));
+	this_thread::sleep_for(chrono::milliseconds(200));
+	K3D_ASSERT(WaitFor([&]() { return manager.GetReloader()->GetNumPending() == 0; }));
+	manager.UpdateHotReload();
+	K3D_ASSERT(manager.GetReloader()->GetStats().NumCommits == 1);
+
+	WriteFile("./TestReload/lit.glsl", "#version 450");
+	K3D_ASSERT(WaitFor([&]() { manager.UpdateHotReload(); return shader == "#version 450"; }));
+
+	auto stats = manager.GetReloader()->GetStats();
+	K3D_ASSERT(manager.GetReloader()->GetNumPending() == 0 && stats.NumCommits == 2);
+	cout << kNumMeshes << " meshes, " << stats.NumImports << " imports, " << stats.NumCommits
+		<< " commits, change to commit latency " << stats.LastLatencyMs << " ms (max " << stats.MaxLatencyMs << " ms)" << endl;
+
+	manager.GetReloader()->Stop();
+	Os::Remove(KT("./TestReload"));
+}
+
+int main(int argc, char**argv)
+{
+	TestFileWatcher();
+	TestOverflow();
+	TestHotReload();
+	return 0;
+}
@@ -0,0 +1,222 @@
+#include "Common.h"
+#include <Math/IK.hpp>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+
+#if K3DPLATFORM_OS_WIN
+#pragma comment(linker,"/subsystem:console")
+#endif
+
+using namespace std;
+using namespace k3d;
+
+/// a bent chain along y, 'bones' bones of length 1
+vector<kMath::Joint> MakeChain(uint32 bones, float maxBend)
+{
+	vector<kMath::Joint> joints;
+	for (uint32 j = 0; j <= bones; j++)
+		joints.push_back(kMath::Joint(kMath::Vec3f(0.1f * sinf((float)j), (float)j, 0.0f), maxBend));
+	kMath::Vec3f p(0.0f, 0.0f, 0.0f);
+	for (uint32 j = 1; j <= bones; j++)
+	{
+		p = p + kMath::Normalize(joints[j].Position - joints[j - 1].Position);
+		joints[j].Position = p;
+	}
+	return joints;
+}
+
+float Distance(kMath::Vec3f const& a, kMath::Vec3f const& b)
+{
+	return kMath::Length(a - b);
+}
+
+/// largest bend of a bone against the one before it, in radians
+float MaxBend(vector<kMath::Joint> const& joints)
+{
+	float bend = 0.0f;
+	for (uint32 j = 1; j + 1 < joints.size(); j++)
+	{
+		kMath::Vec3f u = kMath::Normalize(joints[j].Position - joints[j - 1].Position);
+		kMath::Vec3f d = kMath::Normalize(joints[j + 1].Position - joints[j].Position);
+		bend = max(bend, acosf(min(1.0f, kMath::DotProduct(u, d))));
+	}
+	return bend;
+}
+
+/// every bone of length 1, the root where it was
+bool KeepsBones(vector<kMath::Joint> const& joints)
+{
+	bool keeps = Distance(joints[0].Position, kMath::Vec3f(0.0f, 0.0f, 0.0f)) < 1e-5f;
+	for (uint32 j = 1; j < joints.size(); j++)
+		keeps = keeps && fabsf(Distance(joints[j].Position, joints[j - 1].Position) - 1.0f) < 1e-3f;
+	return keeps;
+}
+
+kMath::Vec3f RandomTarget(mt19937 & random, float radius)
+{
+	uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	kMath::Vec3f v;
+	do
+	{
+		v = kMath::Vec3f(unit(random), unit(random), unit(random));
+	} while (kMath::DotProduct(v, v) > 1.0f || kMath::DotProduct(v, v) < 0.04f);
+	return v * radius;
+}
+
+void TestConvergence()
+{
+	kMath::CCDIKSolver ccd;
+	kMath::FABRIKSolver fabrik;
+	kMath::IKSolver * solvers[2] = { &ccd, &fabrik };
+	const char * names[2] = { "CCD", "FABRIK" };
+	for (uint32 s = 0; s < 2; s++)
+	{
+		solvers[s]->SetMaxIterations(64);
+		mt19937 random(1);
+		uint32 reached = 0, iterations = 0;
+		for (uint32 i = 0; i < 200; i++)
+		{
+			auto joints = MakeChain(4, 3.2f);
+			kMath::Vec3f target = RandomTarget(random, 3.5f);
+			auto result = solvers[s]->Solve(joints.data(), (uint32)joints.size(), target);
+			K3D_ASSERT(KeepsBones(joints));
+			K3D_ASSERT(fabsf(result.Distance - Distance(joints.back().Position, target)) < 1e-4f);
+			reached += result.Distance <= solvers[s]->GetTolerance();
+			iterations += result.Iterations;
+		}
+		cout << names[s] << ": " << reached << " of 200 reachable targets within " << solvers[s]->GetTolerance()
+			<< ", " << iterations / 200.0f << " iterations on average" << endl;
+		K3D_ASSERT(reached >= 190);
+
+		// out of reach the chain straightens towards the target and stops early
+		auto joints = MakeChain(4, 3.2f);
+		kMath::Vec3f target(6.0f, 3.0f, 0.0f);
+		auto result = solvers[s]->Solve(joints.data(), (uint32)joints.size(), target);
+		K3D_ASSERT(KeepsBones(joints) && result.Iterations < 64);
+		K3D_ASSERT(fabsf(result.Distance - (kMath::Length(target) - 4.0f)) < 1e-2f);
+
+		// a target already reached is not iterated
+		joints = MakeChain(4, 3.2f);
+		result = solvers[s]->Solve(joints.data(), (uint32)joints.size(), joints.back().Position);
+		K3D_ASSERT(result.Iterations == 0 && result.Distance == 0.0f);
+	}
+}
+
+void TestLimits()
+{
+	kMath::CCDIKSolver ccd;
+	kMath::FABRIKSolver fabrik;
+	kMath::IKSolver * solvers[2] = { &ccd, &fabrik };
+	const float limit = 0.5f;
+	for (uint32 s = 0; s < 2; s++)
+	{
+		// CCD creeps along the limits
+		solvers[s]->SetMaxIterations(256);
+		mt19937 random(2);
+		for (uint32 i = 0; i < 200; i++)
+		{
+			auto joints = MakeChain(5, limit);
+			solvers[s]->Solve(joints.data(), (uint32)joints.size(), RandomTarget(random, 4.5f));
+			K3D_ASSERT(KeepsBones(joints) && MaxBend(joints) < limit + 1e-3f);
+		}
+		// a target within the limits is still reached
+		auto joints = MakeChain(5, limit);
+		kMath::Vec3f target(1.5f, 4.0f, 0.5f);
+		auto result = solvers[s]->Solve(joints.data(), (uint32)joints.size(), target);
+		K3D_ASSERT(result.Distance <= solvers[s]->GetTolerance() && MaxBend(joints) < limit + 1e-3f);
+	}
+}
+
+void TestBatch()
+{
+	// 11 chains, the last group is padded
+	const uint32 numChains = 11;
+	kMath::CCDIKSolver ccd;
+	kMath::FABRIKSolver fabrik;
+	kMath::IKSolver * solvers[2] = { &ccd, &fabrik };
+	for (uint32 s = 0; s < 2; s++)
+	{
+		mt19937 random(3);
+		kMath::IKBatch simd, scalar;
+		simd.Resize(numChains, 4);
+		scalar.Resize(numChains, 4);
+		vector<vector<kMath::Joint>> chains;
+		vector<kMath::IKSolver::Result> results;
+		for (uint32 c = 0; c < numChains; c++)
+		{
+			auto joints = MakeChain(3, c % 2 ? 0.7f : 3.2f);
+			kMath::Vec3f target = RandomTarget(random, c == 5 ? 5.0f : 2.9f);
+			simd.SetChain(c, joints.data(), target);
+			scalar.SetChain(c, joints.data(), target);
+			results.push_back(solvers[s]->Solve(joints.data(), 4, target));
+			chains.push_back(joints);
+		}
+		solvers[s]->Solve(simd);
+		solvers[s]->Solve(scalar, true);
+		for (uint32 c = 0; c < numChains; c++)
+		{
+			kMath::Joint a[4], b[4];
+			simd.GetChain(c, a);
+			scalar.GetChain(c, b);
+			for (uint32 j = 0; j < 4; j++)
+			{
+				K3D_ASSERT(Distance(a[j].Position, chains[c][j].Position) < 1e-4f);
+				K3D_ASSERT(Distance(b[j].Position, chains[c][j].Position) == 0.0f);
+			}
+			K3D_ASSERT(simd.GetIterations(c) == results[c].Iterations && scalar.GetIterations(c) == results[c].Iterations);
+			K3D_ASSERT(fabsf(simd.GetDistance(c) - results[c].Distance) < 1e-4f);
+		}
+	}
+}
+
+void TestThroughput(uint32 numChains)
+{
+	// legs of a crowd: hip, knee, ankle and toe
+	mt19937 random(4);
+	kMath::IKBatch batch;
+	batch.Resize(numChains, 4);
+	vector<vector<kMath::Joint>> chains;
+	vector<kMath::Vec3f> targets;
+	for (uint32 c = 0; c < numChains; c++)
+	{
+		chains.push_back(MakeChain(3, 1.2f));
+		targets.push_back(RandomTarget(random, 2.9f));
+	}
+	kMath::CCDIKSolver ccd;
+	kMath::FABRIKSolver fabrik;
+	kMath::IKSolver * solvers[2] = { &ccd, &fabrik };
+	const char * names[2] = { "CCD", "FABRIK" };
+	for (uint32 s = 0; s < 2; s++)
+	{
+		double milliseconds[2];
+		uint64 iterations = 0;
+		uint32 reached = 0;
+		for (uint32 scalar = 0; scalar < 2; scalar++)
+		{
+			for (uint32 c = 0; c < numChains; c++)
+				batch.SetChain(c, chains[c].data(), targets[c]);
+			auto start = chrono::high_resolution_clock::now();
+			solvers[s]->Solve(batch, scalar == 1);
+			milliseconds[scalar] = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+		}
+		for (uint32 c = 0; c < numChains; c++)
+		{
+			iterations += batch.GetIterations(c);
+			reached += batch.GetDistance(c) <= solvers[s]->GetTolerance();
+		}
+		cout << numChains << " legs " << names[s] << ": " << reached << " reached, " << (double)iterations / numChains
+			<< " iterations on average; scalar " << numChains / milliseconds[1] / 1000.0 << " MChains/s, batched "
+			<< numChains / milliseconds[0] / 1000.0 << " MChains/s (" << milliseconds[0] << " ms)" << endl;
+	}
+}
+
+int main(int argc, char**argv)
+{
+	TestConvergence();
+	TestLimits();
+	TestBatch();
+	TestThroughput(argc > 1 ? (uint32)atoi(argv[1]) : 20000);
+	return 0;
+}
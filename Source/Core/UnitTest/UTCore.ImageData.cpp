@@ -0,0 +1,335 @@
+#include "Common.h"
+#include <Core/Bundle.h>
+#include <Core/ImageData.h>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+
+#if K3DPLATFORM_OS_WIN
+#pragma comment(linker,"/subsystem:console")
+#endif
+
+using namespace std;
+using namespace k3d;
+
+static const uint32 DDPF_ALPHAPIXELS = 0x1;
+static const uint32 DDPF_FOURCC = 0x4;
+static const uint32 DDPF_RGB = 0x40;
+
+struct Layout
+{
+	uint32	Width, Height, Depth, MipLevels, Layers;
+	uint32	ElementSize;
+	bool	Compressed;
+};
+
+uint64 LevelBytes(Layout const& layout, uint32 level)
+{
+	uint32 w = max(layout.Width >> level, 1u), h = max(layout.Height >> level, 1u), d = max(layout.Depth >> level, 1u);
+	if (layout.Compressed)
+	{
+		w = (w + 3) / 4;
+		h = (h + 3) / 4;
+	}
+	return (uint64)w * h * d * layout.ElementSize;
+}
+
+/// every byte of a level tells its layer and level
+kByte LevelByte(uint32 level, uint32 layer)
+{
+	return (kByte)(layer * 16 + level + 1);
+}
+
+void Append(vector<kByte> & file, const void * data, size_t size)
+{
+	file.insert(file.end(), (const kByte*)data, (const kByte*)data + size);
+}
+
+uint32 FourCC(const char * code)
+{
+	return (uint32)(uint8)code[0] | ((uint32)(uint8)code[1] << 8) | ((uint32)(uint8)code[2] << 16) | ((uint32)(uint8)code[3] << 24);
+}
+
+/// a DDS file, 'dxgiFormat' 0 writes the legacy pixel format 'pf' (flags, fourcc, bits, masks)
+vector<kByte> MakeDDS(Layout const& layout, const uint32 pf[7], uint32 caps2, uint32 dxgiFormat = 0, uint32 dimension = 3, bool cube = false)
+{
+	uint32 header[31] = {};
+	header[0] = 124;
+	header[1] = 0x1 | 0x2 | 0x4 | 0x1000 | (layout.MipLevels > 1 ? 0x20000 : 0) | (layout.Depth > 1 ? 0x800000 : 0);
+	header[2] = layout.Height;
+	header[3] = layout.Width;
+	header[5] = layout.Depth;
+	header[6] = layout.MipLevels;
+	header[18] = 32;
+	if (dxgiFormat)
+	{
+		header[19] = DDPF_FOURCC;
+		header[20] = FourCC("DX10");
+	}
+	else
+	{
+		for (uint32 k = 0; k < 7; k++)
+			header[19 + k] = pf[k];
+	}
+	header[26] = 0x1000 | (layout.MipLevels > 1 ? 0x400008 : 0);
+	header[27] = caps2;
+
+	vector<kByte> file;
+	Append(file, "DDS ", 4);
+	Append(file, header, sizeof(header));
+	if (dxgiFormat)
+	{
+		uint32 faces = cube ? 6 : 1;
+		uint32 dx10[5] = { dxgiFormat, dimension, cube ? 0x4u : 0u, layout.Layers / faces, 0 };
+		Append(file, dx10, sizeof(dx10));
+	}
+	for (uint32 layer = 0; layer < layout.Layers; layer++)
+	{
+		for (uint32 level = 0; level < layout.MipLevels; level++)
+			file.resize(file.size() + (size_t)LevelBytes(layout, level), LevelByte(level, layer));
+	}
+	return file;
+}
+
+/// a KTX2 file, the mip tail is stored first as the specification recommends
+vector<kByte> MakeKTX2(Layout const& layout, uint32 vkFormat, uint32 faces, uint32 supercompression = 0)
+{
+	uint32 header[16] = {};
+	header[3] = vkFormat;
+	header[4] = 1;
+	header[5] = layout.Width;
+	header[6] = layout.Height;
+	header[7] = layout.Depth > 1 ? layout.Depth : 0;
+	header[8] = layout.Layers / faces > 1 ? layout.Layers / faces : 0;
+	header[9] = faces;
+	header[10] = layout.MipLevels;
+	header[11] = supercompression;
+	static const kByte identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+	memcpy(header, identifier, sizeof(identifier));
+
+	vector<kByte> file;
+	Append(file, header, sizeof(header));
+	// sgd offset and length
+	file.resize(file.size() + 16, 0);
+	vector<uint64> index(layout.MipLevels * 3);
+	size_t indexPos = file.size();
+	file.resize(file.size() + index.size() * sizeof(uint64));
+	for (uint32 level = layout.MipLevels; level-- > 0;)
+	{
+		// levels are aligned to the texel block size
+		while (file.size() % 16)
+			file.push_back(0);
+		uint64 bytes = LevelBytes(layout, level);
+		index[level * 3] = file.size();
+		index[level * 3 + 1] = index[level * 3 + 2] = bytes * layout.Layers;
+		for (uint32 layer = 0; layer < layout.Layers; layer++)
+			file.resize(file.size() + (size_t)bytes, LevelByte(level, layer));
+	}
+	memcpy(file.data() + indexPos, index.data(), index.size() * sizeof(uint64));
+	return file;
+}
+
+void WriteFile(const char * path, vector<kByte> const& file)
+{
+	ofstream out(path, ios::binary | ios::trunc);
+	out.write((const char*)file.data(), file.size());
+}
+
+/// checks the dimensions of 'image' and that every level points at its bytes inside [begin, end)
+void CheckImage(ImageData const& image, Layout const& layout, EImageFormat format, ImageData::Type type,
+	const kByte * begin, const kByte * end)
+{
+	K3D_ASSERT(image.GetFormat() == format && image.GetType() == type);
+	K3D_ASSERT(image.IsCompressed() == layout.Compressed && image.IsCubeMap() == (type == ImageData::TEXTURE_CUBE));
+	K3D_ASSERT(image.GetWidth() == layout.Width && image.GetHeight() == layout.Height && image.GetDepth() == layout.Depth);
+	K3D_ASSERT(image.GetMipLevs() == layout.MipLevels && image.GetLayers() == layout.Layers);
+	for (uint32 layer = 0; layer < layout.Layers; layer++)
+	{
+		for (uint32 level = 0; level < layout.MipLevels; level++)
+		{
+			const ImageLevel * desc = image.GetLevelDesc(level, layer);
+			K3D_ASSERT(desc && desc->Data == image.GetLevel(level, layer));
+			K3D_ASSERT(desc->Size == LevelBytes(layout, level) && desc->Size == (uint64)desc->RowPitch * desc->Rows * desc->Depth);
+			K3D_ASSERT(desc->Width == max(layout.Width >> level, 1u) && desc->Height == max(layout.Height >> level, 1u));
+			K3D_ASSERT(desc->Data >= begin && desc->Data + desc->Size <= end);
+			K3D_ASSERT(desc->Data[0] == LevelByte(level, layer) && desc->Data[desc->Size - 1] == LevelByte(level, layer));
+		}
+		K3D_ASSERT(image.GetImageSize(0) == LevelBytes(layout, 0));
+	}
+	K3D_ASSERT(!image.GetLevelDesc(layout.MipLevels, 0) && !image.GetLevelDesc(0, layout.Layers));
+}
+
+/// loads 'file' from disk and checks the image is a view into the mapping
+void CheckFile(const char * path, vector<kByte> const& file, Layout const& layout, EImageFormat format, ImageData::Type type)
+{
+	WriteFile(path, file);
+	auto image = ImageData::CreateFromFile(path);
+	K3D_ASSERT(image && image->IsView() && image->GetName() == path);
+	const kByte * mapped = nullptr;
+	for (uint32 layer = 0; layer < layout.Layers; layer++)
+	{
+		for (uint32 level = 0; level < layout.MipLevels; level++)
+		{
+			const kByte * data = image->GetLevelDesc(level, layer)->Data;
+			mapped = mapped ? min(mapped, data) : data;
+		}
+	}
+	// no level is copied, all of them lie within a file size from the lowest one
+	CheckImage(*image, layout, format, type, mapped, mapped + file.size());
+	image.reset();
+
+	// Load parses memory the caller owns, the image borrows it
+	vector<kByte> memory(file);
+	ImageData loaded;
+	K3D_ASSERT(loaded.Load(memory.data(), (uint32)memory.size()) && loaded.IsView());
+	CheckImage(loaded, layout, format, type, memory.data(), memory.data() + memory.size());
+	Os::Remove(path);
+}
+
+void TestDDS()
+{
+	// DXT1 with mips down to 1x1, odd sizes round up to whole blocks
+	Layout bc1 = { 250, 130, 1, 8, 1, 8, true };
+	uint32 dxt1[7] = { DDPF_FOURCC, FourCC("DXT1"), 0, 0, 0, 0, 0 };
+	CheckFile("./TestImageBC1.dds", MakeDDS(bc1, dxt1, 0), bc1, EImageFormat::BC1_UNORM, ImageData::TEXTURE_2D);
+
+	// a legacy cube map stores each face with its mips
+	Layout cube = { 64, 64, 1, 7, 6, 4, false };
+	uint32 rgba8[7] = { DDPF_RGB | DDPF_ALPHAPIXELS, 0, 32, 0xff, 0xff00, 0xff0000, 0xff000000 };
+	CheckFile("./TestImageCube.dds", MakeDDS(cube, rgba8, 0x200 | 0xFC00), cube, EImageFormat::RGBA8_UNORM, ImageData::TEXTURE_CUBE);
+
+	Layout volume = { 32, 16, 8, 6, 1, 4, false };
+	uint32 bgra8[7] = { DDPF_RGB | DDPF_ALPHAPIXELS, 0, 32, 0xff0000, 0xff00, 0xff, 0xff000000 };
+	CheckFile("./TestImageVolume.dds", MakeDDS(volume, bgra8, 0x200000), volume, EImageFormat::BGRA8_UNORM, ImageData::TEXTURE_3D);
+
+	// DX10 header: an array of two BC7 cube maps, a BC6H array and a float volume
+	Layout cubeArray = { 128, 128, 1, 8, 12, 16, true };
+	CheckFile("./TestImageBC7.dds", MakeDDS(cubeArray, nullptr, 0, 99, 3, true), cubeArray, EImageFormat::BC7_SRGB, ImageData::TEXTURE_CUBE);
+	Layout array = { 96, 40, 1, 3, 5, 16, true };
+	CheckFile("./TestImageBC6.dds", MakeDDS(array, nullptr, 0, 95), array, EImageFormat::BC6H_UFLOAT, ImageData::TEXTURE_2D);
+	Layout floatVolume = { 16, 16, 16, 5, 1, 16, false };
+	CheckFile("./TestImageRGBA32.dds", MakeDDS(floatVolume, nullptr, 0, 2, 4), floatVolume, EImageFormat::RGBA32_FLOAT, ImageData::TEXTURE_3D);
+
+	ImageData image;
+	// truncated in the last level
+	auto file = MakeDDS(bc1, dxt1, 0);
+	K3D_ASSERT(!image.Load(file.data(), (uint32)file.size() - 1) && image.GetMipLevs() == 0 && !image.GetData());
+	K3D_ASSERT(image.Load(file.data(), (uint32)file.size()));
+	// a partial cube map, an unknown format, more mips than the size allows
+	file = MakeDDS(cube, rgba8, 0x200 | 0x400);
+	K3D_ASSERT(!image.Load(file.data(), (uint32)file.size()) && image.GetMipLevs() == 0);
+	uint32 unknown[7] = { DDPF_FOURCC, FourCC("ETC1"), 0, 0, 0, 0, 0 };
+	file = MakeDDS(bc1, unknown, 0);
+	K3D_ASSERT(!image.Load(file.data(), (uint32)file.size()));
+	file = MakeDDS(array, nullptr, 0, 1);
+	K3D_ASSERT(!image.Load(file.data(), (uint32)file.size()));
+	Layout tooManyMips = { 4, 4, 1, 4, 1, 8, true };
+	file = MakeDDS(tooManyMips, dxt1, 0);
+	K3D_ASSERT(!image.Load(file.data(), (uint32)file.size()));
+	K3D_ASSERT(!image.Load(file.data(), 64) && !image.Load(nullptr, 0));
+	K3D_ASSERT(!ImageData::CreateFromFile("./TestImageMissing.dds"));
+}
+
+void TestKTX2()
+{
+	// VK_FORMAT_BC3_UNORM_BLOCK array of three layers
+	Layout bc3 = { 128, 64, 1, 8, 3, 16, true };
+	CheckFile("./TestImageBC3.ktx2", MakeKTX2(bc3, 137, 1), bc3, EImageFormat::BC3_UNORM, ImageData::TEXTURE_2D);
+
+	// VK_FORMAT_R16G16B16A16_SFLOAT cube map
+	Layout cube = { 32, 32, 1, 6, 6, 8, false };
+	CheckFile("./TestImageCube.ktx2", MakeKTX2(cube, 97, 6), cube, EImageFormat::RGBA16_FLOAT, ImageData::TEXTURE_CUBE);
+
+	// VK_FORMAT_R8_UNORM volume, and a BC5 cube array
+	Layout volume = { 20, 12, 6, 5, 1, 1, false };
+	CheckFile("./TestImageVolume.ktx2", MakeKTX2(volume, 9, 1), volume, EImageFormat::R8_UNORM, ImageData::TEXTURE_3D);
+	Layout cubeArray = { 16, 16, 1, 5, 18, 16, true };
+	CheckFile("./TestImageBC5.ktx2", MakeKTX2(cubeArray, 141, 6), cubeArray, EImageFormat::BC5_UNORM, ImageData::TEXTURE_CUBE);
+
+	ImageData image;
+	auto file = MakeKTX2(bc3, 137, 1);
+	K3D_ASSERT(!image.Load(file.data(), (uint32)file.size() - 1));
+	// zstd supercompression, a format without a mapping (ETC2)
+	file = MakeKTX2(bc3, 137, 1, 2);
+	K3D_ASSERT(!image.Load(file.data(), (uint32)file.size()));
+	file = MakeKTX2(bc3, 147, 1);
+	K3D_ASSERT(!image.Load(file.data(), (uint32)file.size()));
+	// a level index entry beyond the end of the file
+	file = MakeKTX2(bc3, 137, 1);
+	uint64 offset = file.size();
+	memcpy(file.data() + 80, &offset, sizeof(offset));
+	K3D_ASSERT(!image.Load(file.data(), (uint32)file.size()));
+}
+
+void TestImageChunk()
+{
+	Layout layout = { 256, 256, 1, 9, 1, 16, true };
+	auto file = MakeKTX2(layout, 145, 1);
+	AssetBundleWriter writer;
+	K3D_ASSERT(writer.Open(KT("./TestImage.bundle")));
+	writer.AddChunk("raw.ktx2", EAssetType::EImage, [&file](Archive & archive) { archive.ArrayIn(file.data(), (uint32)file.size()); });
+	writer.SetCompression(EChunkCompression::ELZ);
+	writer.AddChunk("lz.ktx2", EAssetType::EImage, [&file](Archive & archive) { archive.ArrayIn(file.data(), (uint32)file.size()); });
+	K3D_ASSERT(writer.Finish());
+
+	AssetBundleReader reader;
+	K3D_ASSERT(reader.Open(KT("./TestImage.bundle")));
+	auto raw = reader.Find("raw.ktx2");
+	K3D_ASSERT(raw.IsValid() && raw.Compression == EChunkCompression::ENone);
+	auto image = ImageData::CreateFromChunk(raw, reader.GetFile());
+	K3D_ASSERT(image && image->IsView() && image->GetName() == "raw.ktx2");
+	// the levels point into the mapped bundle
+	CheckImage(*image, layout, EImageFormat::BC7_UNORM, ImageData::TEXTURE_2D, raw.Data, raw.Data + raw.Size);
+
+	auto lz = reader.Find("lz.ktx2");
+	K3D_ASSERT(lz.Compression == EChunkCompression::ELZ);
+	auto decoded = ImageData::CreateFromChunk(lz, reader.GetFile());
+	K3D_ASSERT(decoded && decoded->IsView() && decoded->GetMipLevs() == layout.MipLevels);
+	for (uint32 level = 0; level < layout.MipLevels; level++)
+	{
+		K3D_ASSERT(memcmp(decoded->GetLevel(level, 0), image->GetLevel(level, 0), (size_t)LevelBytes(layout, level)) == 0);
+	}
+
+	AssetChunkView mesh = raw;
+	mesh.Type = EAssetType::EMesh;
+	K3D_ASSERT(!ImageData::CreateFromChunk(mesh, reader.GetFile()));
+	reader.Close();
+	// the images keep the mapping alive
+	K3D_ASSERT(image->GetLevel(0, 0) && *(const kByte*)image->GetLevel(0, 0) == LevelByte(0, 0));
+	image.reset();
+	Os::Remove(KT("./TestImage.bundle"));
+}
+
+/// a 4096^2 BC7 texture with mips, opened as a view against read into a heap buffer
+void TestLoadTime()
+{
+	Layout layout = { 4096, 4096, 1, 13, 1, 16, true };
+	WriteFile("./TestImageLarge.dds", MakeDDS(layout, nullptr, 0, 98));
+	auto start = chrono::high_resolution_clock::now();
+	auto image = ImageData::CreateFromFile("./TestImageLarge.dds");
+	double viewMs = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+	K3D_ASSERT(image && image->GetMipLevs() == 13);
+
+	start = chrono::high_resolution_clock::now();
+	ifstream in("./TestImageLarge.dds", ios::binary | ios::ate);
+	vector<kByte> heap((size_t)in.tellg());
+	in.seekg(0);
+	in.read((char*)heap.data(), heap.size());
+	ImageData copy;
+	K3D_ASSERT(copy.Load(heap.data(), (uint32)heap.size()));
+	double copyMs = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+	K3D_ASSERT(memcmp(image->GetLevel(12, 0), copy.GetLevel(12, 0), 16) == 0);
+
+	cout << (heap.size() >> 20) << " MB BC7: view " << viewMs << " ms, read into heap " << copyMs << " ms" << endl;
+	image.reset();
+	Os::Remove(KT("./TestImageLarge.dds"));
+}
+
+int main(int argc, char**argv)
+{
+	TestDDS();
+	TestKTX2();
+	TestImageChunk();
+	TestLoadTime();
+	return 0;
+}
@@ -0,0 +1,208 @@
+// before anything instantiates the generic Vec4f and Mat4f
+#include <Math/kVec4Mat4_SIMD.hpp>
+#include "Common.h"
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+
+#if K3DPLATFORM_OS_WIN
+#pragma comment(linker,"/subsystem:console")
+#endif
+
+using namespace std;
+using namespace k3d;
+
+typedef kMath::tVectorN<double, 4> Vec4d;
+typedef kMath::tMatrixNxN<double, 4> Mat4d;
+
+Vec4d ToDouble(kMath::Vec4f const& v)
+{
+	return Vec4d(v[0], v[1], v[2], v[3]);
+}
+
+Mat4d ToDouble(kMath::Mat4f const& m)
+{
+	Mat4d d;
+	for (int c = 0; c < 4; c++)
+		d[c] = ToDouble(m[c]);
+	return d;
+}
+
+double Error(kMath::Vec4f const& v, Vec4d const& d)
+{
+	double e = 0.0;
+	for (int i = 0; i < 4; i++)
+		e = max(e, fabs(v[i] - d[i]));
+	return e;
+}
+
+double Error(kMath::Mat4f const& m, Mat4d const& d)
+{
+	double e = 0.0;
+	for (int c = 0; c < 4; c++)
+		e = max(e, Error(m[c], d[c]));
+	return e;
+}
+
+kMath::Vec4f RandomVector(mt19937 & random)
+{
+	uniform_real_distribution<float> unit(-2.0f, 2.0f);
+	return kMath::Vec4f(unit(random), unit(random), unit(random), unit(random));
+}
+
+kMath::Mat4f RandomMatrix(mt19937 & random)
+{
+	kMath::Mat4f m;
+	for (int c = 0; c < 4; c++)
+		m[c] = RandomVector(random);
+	return m;
+}
+
+/// well conditioned: the diagonal outweighs the rest of its row and column
+kMath::Mat4f RandomInvertible(mt19937 & random)
+{
+	kMath::Mat4f m = RandomMatrix(random);
+	for (int i = 0; i < 4; i++)
+		m[i][i] += m[i][i] < 0.0f ? -8.0f : 8.0f;
+	return m;
+}
+
+kMath::Vec4f RandomQuaternion(mt19937 & random)
+{
+	kMath::Vec4f q = RandomVector(random);
+	return q / sqrtf(kMath::DotProduct(q, q));
+}
+
+void TestVector(mt19937 & random)
+{
+	kMath::Vec4f v(kMath::Vec3f(1.0f, 2.0f, 3.0f), 4.0f);
+	K3D_ASSERT(v[0] == 1.0f && v[1] == 2.0f && v[2] == 3.0f && v[3] == 4.0f);
+	double error = 0.0;
+	for (uint32 i = 0; i < 10000; i++)
+	{
+		kMath::Vec4f a = RandomVector(random), b = RandomVector(random);
+		Vec4d da = ToDouble(a), db = ToDouble(b);
+		float s = a[0];
+		double dot = da[0] * db[0] + da[1] * db[1] + da[2] * db[2] + da[3] * db[3];
+		error = max(error, fabs(kMath::DotProduct(a, b) - dot));
+		error = max(error, Error(a + b, da + db));
+		error = max(error, Error(a - b, da - db));
+		error = max(error, Error(a * b, da * db));
+		error = max(error, Error(a + s, da + (double)s));
+		error = max(error, Error(a - s, da - (double)s));
+		error = max(error, Error(a * s, da * (double)s));
+		error = max(error, Error(a / 3.0f, da / 3.0));
+		double length = sqrt(kMath::DotProduct(da, da));
+		error = max(error, Error(kMath::Normalize(a), da / length));
+	}
+	cout << "Vec4f on " << kMath::GetSIMDBackend() << ": max error " << error << endl;
+	K3D_ASSERT(error < 1e-5);
+}
+
+void TestMatrix(mt19937 & random)
+{
+	double error[4] = {};
+	for (uint32 i = 0; i < 10000; i++)
+	{
+		kMath::Mat4f a = RandomMatrix(random), b = RandomMatrix(random);
+		kMath::Vec4f v = RandomVector(random);
+		Mat4d da = ToDouble(a), db = ToDouble(b);
+		Vec4d dv = ToDouble(v);
+		K3D_ASSERT(Error(Transpose(a), Transpose(da)) == 0.0);
+		error[1] = max(error[1], max(Error(a + b, da + db), Error(a - b, da - db)));
+		error[0] = max(error[0], Error(a * b, da * db));
+		error[1] = max(error[1], Error(a * v, da * dv));
+		error[1] = max(error[1], Error(kMath::Transform(a, v), kMath::Transform(da, dv)));
+
+		kMath::Mat4f m = RandomInvertible(random);
+		Mat4d dm = ToDouble(m);
+		kMath::Mat4f inverse = m.Inverse();
+		error[2] = max(error[2], Error(inverse, dm.Inverse()));
+		error[3] = max(error[3], Error(m * inverse, kMath::MakeIdentityMatrix<double>()));
+	}
+	// a rigid transform of rotation and translation
+	kMath::Mat4f rigid = kMath::QuaternionToMatrix(kMath::Vec4f(0.0f, 0.6f, 0.0f, 0.8f));
+	rigid[3] = kMath::Vec4f(1.0f, 2.0f, 3.0f, 1.0f);
+	kMath::Vec4f p = kMath::Transform(rigid.Inverse(), kMath::Transform(rigid, kMath::Vec4f(4.0f, 5.0f, 6.0f, 1.0f)));
+	error[3] = max(error[3], Error(p, Vec4d(4.0, 5.0, 6.0, 1.0)));
+
+	cout << "Mat4f on " << kMath::GetSIMDBackend() << ": max error of products " << error[0] << ", transforms " << error[1]
+		<< ", inverses " << error[2] << ", m * m^-1 - I " << error[3] << endl;
+	K3D_ASSERT(error[0] < 1e-5 && error[1] < 1e-5);
+	K3D_ASSERT(error[2] < 1e-5 && error[3] < 1e-5);
+}
+
+void TestQuaternion(mt19937 & random)
+{
+	double error = 0.0;
+	for (uint32 i = 0; i < 10000; i++)
+	{
+		kMath::Vec4f a = RandomQuaternion(random), b = RandomQuaternion(random);
+		kMath::Vec4f v = RandomVector(random);
+		Vec4d da = ToDouble(a), db = ToDouble(b), dv = ToDouble(v);
+		K3D_ASSERT(Error(kMath::QuaternionConjugate(a), kMath::QuaternionConjugate(da)) == 0.0);
+		error = max(error, Error(kMath::QuaternionMultiply(a, b), kMath::QuaternionMultiply(da, db)));
+		error = max(error, Error(kMath::QuaternionRotate(a, v), kMath::QuaternionRotate(da, dv)));
+		error = max(error, Error(kMath::QuaternionToMatrix(a), kMath::QuaternionToMatrix(da)));
+		// the matrix rotates as the quaternion does
+		error = max(error, Error(kMath::Transform(kMath::QuaternionToMatrix(a), v), kMath::QuaternionRotate(da, dv)));
+	}
+	cout << "Quaternions on " << kMath::GetSIMDBackend() << ": max error " << error << endl;
+	K3D_ASSERT(error < 1e-5);
+}
+
+template <class Op>
+double Milliseconds(Op op)
+{
+	auto start = chrono::high_resolution_clock::now();
+	op();
+	return chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+}
+
+void Benchmark(uint32 count)
+{
+	// the generic tMatrixNxN<double, 4> is the scalar path
+	mt19937 random(4);
+	vector<kMath::Mat4f> matrices, results(count);
+	vector<Mat4d> dmatrices, dresults(count);
+	vector<kMath::Vec4f> vectors, vresults(count);
+	vector<Vec4d> dvectors, dvresults(count);
+	for (uint32 i = 0; i < count; i++)
+	{
+		matrices.push_back(RandomInvertible(random));
+		dmatrices.push_back(ToDouble(matrices.back()));
+		vectors.push_back(RandomQuaternion(random));
+		dvectors.push_back(ToDouble(vectors.back()));
+	}
+	const char * names[4] = { "multiply", "inverse", "transform", "quaternion multiply" };
+	double simd[4], scalar[4];
+	simd[0] = Milliseconds([&] { for (uint32 i = 1; i < count; i++) results[i] = matrices[i - 1] * matrices[i]; });
+	scalar[0] = Milliseconds([&] { for (uint32 i = 1; i < count; i++) dresults[i] = dmatrices[i - 1] * dmatrices[i]; });
+	simd[1] = Milliseconds([&] { for (uint32 i = 0; i < count; i++) results[i] = matrices[i].Inverse(); });
+	scalar[1] = Milliseconds([&] { for (uint32 i = 0; i < count; i++) dresults[i] = dmatrices[i].Inverse(); });
+	simd[2] = Milliseconds([&] { for (uint32 i = 0; i < count; i++) vresults[i] = kMath::Transform(matrices[i], vectors[i]); });
+	scalar[2] = Milliseconds([&] { for (uint32 i = 0; i < count; i++) dvresults[i] = kMath::Transform(dmatrices[i], dvectors[i]); });
+	simd[3] = Milliseconds([&] { for (uint32 i = 1; i < count; i++) vresults[i] = kMath::QuaternionMultiply(vectors[i - 1], vectors[i]); });
+	scalar[3] = Milliseconds([&] { for (uint32 i = 1; i < count; i++) dvresults[i] = kMath::QuaternionMultiply(dvectors[i - 1], dvectors[i]); });
+	for (uint32 op = 0; op < 4; op++)
+	{
+		cout << count << " " << names[op] << ": scalar " << count / scalar[op] / 1000.0 << " M/s, "
+			<< kMath::GetSIMDBackend() << " " << count / simd[op] / 1000.0 << " M/s" << endl;
+	}
+	// keeps the loops
+	double check = 0.0;
+	for (uint32 i = 1; i < count; i++)
+		check += Error(results[i], dresults[i]) + Error(vresults[i], dvresults[i]);
+	K3D_ASSERT(check < count * 1e-4);
+}
+
+int main(int argc, char**argv)
+{
+	mt19937 random(1);
+	TestVector(random);
+	TestMatrix(random);
+	TestQuaternion(random);
+	Benchmark(argc > 1 ? (uint32)atoi(argv[1]) : 200000);
+	return 0;
+}
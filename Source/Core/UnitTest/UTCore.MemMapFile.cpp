@@ -0,0 +1,98 @@
+#include "Common.h"
+#include <iostream>
+#include <vector>
+
+#if K3DPLATFORM_OS_WIN
+#pragma comment(linker,"/subsystem:console")
+#endif
+
+using namespace std;
+using namespace k3d;
+
+static const char* kTestFile = "./TestMemMap.bin";
+
+void TestMemMapFile()
+{
+	const uint64 fileSize = 32ull << 20;
+	{
+		Os::File file;
+		K3D_ASSERT(file.Open(kTestFile, IOWrite));
+		vector<uint64> block(1 << 16);
+		for (uint64 offset = 0; offset < fileSize; offset += block.size() * sizeof(uint64))
+		{
+			for (uint64 i = 0; i < block.size(); i++)
+				block[i] = offset + i * sizeof(uint64);
+			file.Write(block.data(), block.size() * sizeof(uint64));
+		}
+		file.Close();
+	}
+
+	Os::MemMapFile::Options options;
+	options.HugePages = true;
+	options.TrackFaults = true;
+	options.Hint = Os::MemMapFile::Advice::Sequential;
+	Os::MemMapFile first;
+	K3D_ASSERT(first.Open(kTestFile, IORead, options));
+	Os::MemMapFile second;
+	K3D_ASSERT(second.Open(kTestFile, IORead));
+	// one mapping for both, with independent cursors
+	K3D_ASSERT(first.FileData() == second.FileData());
+	K3D_ASSERT(Os::MemMapFile::GetNumSharedMappings() == 1);
+	second.Seek(4096);
+
+	vector<char> buffer(1 << 20);
+	uint64 sum = 0;
+	while (!first.IsEOF())
+	{
+		size_t read = first.Read(buffer.data(), buffer.size());
+		sum += *(uint64*)buffer.data();
+		K3D_ASSERT(read == buffer.size());
+	}
+	uint64 value = 0;
+	second.Read((char*)&value, sizeof(value));
+	K3D_ASSERT(value == 4096);
+
+	auto faults = first.GetFaultStats();
+	cout << "sequential read: " << faults.MinorFaults << " minor, " << faults.MajorFaults
+		<< " major faults, " << first.GetResidentBytes() / 1024 << " KB resident, huge page aligned: "
+		<< first.IsHugePageAligned() << endl;
+
+	Os::MemMapFile random;
+	Os::MemMapFile::Options unshared;
+	unshared.Shared = false;
+	unshared.Hint = Os::MemMapFile::Advice::Random;
+	K3D_ASSERT(random.Open(kTestFile, IORead, unshared));
+	K3D_ASSERT(random.FileData() != first.FileData());
+	K3D_ASSERT(random.Prefetch(8 << 20, 1 << 20));
+	{
+		Os::MemMapFile::FaultScope scope(random);
+		for (uint64 offset = 0; offset < fileSize; offset += 64 * 1024)
+			K3D_ASSERT(*(uint64*)(random.FileData() + offset) == offset);
+	}
+	faults = random.GetFaultStats();
+	cout << "strided access: " << faults.MinorFaults << " minor, " << faults.MajorFaults << " major faults" << endl;
+
+	// faults on the destination of Read() are not the mapping's
+	Os::MemMapFile populated;
+	unshared.Populate = true;
+	unshared.TrackFaults = true;
+	K3D_ASSERT(populated.Open(kTestFile, IORead, unshared));
+	unique_ptr<char[]> untouched(new char[8 << 20]);
+	K3D_ASSERT(populated.Read(untouched.get(), 8 << 20) == (8 << 20));
+	faults = populated.GetFaultStats();
+	cout << "populated read: " << faults.MinorFaults << " minor, " << faults.MajorFaults << " major faults" << endl;
+	K3D_ASSERT(faults.MinorFaults + faults.MajorFaults < 16);
+
+	first.Close();
+	second.Close();
+	random.Close();
+	populated.Close();
+	K3D_ASSERT(Os::MemMapFile::GetNumSharedMappings() == 0);
+	Os::Remove(KT("./TestMemMap.bin"));
+}
+
+int main(int argc, char**argv)
+{
+	TestMemMapFile();
+	return 0;
+}
@@ -0,0 +1,153 @@
+#include "Common.h"
+#include <Core/MeshData.h>
+#include <Core/MeshOptimizer.h>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <iostream>
+#include <random>
+
+#if K3DPLATFORM_OS_WIN
+#pragma comment(linker,"/subsystem:console")
+#endif
+
+using namespace std;
+using namespace k3d;
+
+/// more vertices than 16 bit indices can address
+static const uint32 kGridSide = 300;
+
+/// a grid bent into a closed tube, the triangles shuffled like a bad export
+shared_ptr<MeshData> MakeTube(uint32 seed)
+{
+	vector<Vertex3F3F> vertices;
+	for (uint32 y = 0; y < kGridSide; y++)
+	{
+		for (uint32 x = 0; x < kGridSide; x++)
+		{
+			float angle = x * 6.2831853f / kGridSide;
+			vertices.push_back({ cosf(angle), (float)y / kGridSide, sinf(angle), cosf(angle), 0.0f, sinf(angle) });
+		}
+	}
+	vector<array<uint32, 3>> triangles;
+	for (uint32 y = 0; y + 1 < kGridSide; y++)
+	{
+		for (uint32 x = 0; x < kGridSide; x++)
+		{
+			uint32 v = y * kGridSide + x, right = y * kGridSide + (x + 1) % kGridSide;
+			triangles.push_back({ v, right, v + kGridSide });
+			triangles.push_back({ right, right + kGridSide, v + kGridSide });
+		}
+	}
+	shuffle(triangles.begin(), triangles.end(), mt19937(seed));
+	vector<uint32> indices;
+	for (auto & t : triangles)
+		indices.insert(indices.end(), t.begin(), t.end());
+	auto mesh = make_shared<MeshData>();
+	mesh->SetMeshName("tube");
+	mesh->SetVertexFormat(VtxFormat::POS3_F32_NOR3_F32);
+	mesh->SetVertexNum((int)vertices.size());
+	mesh->SetVertexBuffer(vertices.data());
+	mesh->SetIndexBuffer(indices);
+	return mesh;
+}
+
+/// the triangles by their vertex data, in a canonical order
+vector<array<float, 9>> Triangles(MeshData const& mesh)
+{
+	auto vertices = (const Vertex3F3F*)mesh.GetVertexBuffer();
+	const uint32 * indices = mesh.GetIndexBuffer();
+	vector<array<float, 9>> triangles;
+	for (int t = 0; t < mesh.GetIndexNum() / 3; t++)
+	{
+		// rotated so the smallest index comes first, the winding stays
+		uint32 first = 0;
+		for (uint32 k = 1; k < 3; k++)
+		{
+			auto const& a = vertices[indices[t * 3 + k]];
+			auto const& b = vertices[indices[t * 3 + first]];
+			if (tie(a.PosX, a.PosY, a.PosZ) < tie(b.PosX, b.PosY, b.PosZ))
+				first = k;
+		}
+		array<float, 9> triangle;
+		for (uint32 k = 0; k < 3; k++)
+		{
+			auto const& v = vertices[indices[t * 3 + (first + k) % 3]];
+			triangle[k * 3] = v.PosX;
+			triangle[k * 3 + 1] = v.PosY;
+			triangle[k * 3 + 2] = v.PosZ;
+		}
+		triangles.push_back(triangle);
+	}
+	sort(triangles.begin(), triangles.end());
+	return triangles;
+}
+
+void TestMeshOptimizer()
+{
+	auto reference = Triangles(*MakeTube(1));
+	const char * methods[] = { "forsyth", "tipsify" };
+	for (uint32 method = 0; method < 2; method++)
+	{
+		MeshOptimizer::Options options;
+		options.Method = (MeshOptimizer::ECacheMethod)method;
+
+		// cache order only
+		auto mesh = MakeTube(1);
+		options.OverdrawThreshold = 0.0f;
+		MeshOptimizer::Result cacheOnly;
+		auto start = chrono::high_resolution_clock::now();
+		K3D_ASSERT(MeshOptimizer::Optimize(*mesh, options, &cacheOnly));
+		double ms = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+		K3D_ASSERT(Triangles(*mesh) == reference);
+		K3D_ASSERT(cacheOnly.Before.ACMR > 2.5f && cacheOnly.After.ACMR < 0.8f);
+		K3D_ASSERT(cacheOnly.After.NumVertices == kGridSide * kGridSide && cacheOnly.After.ATVR < 1.5f);
+		// vertices are fetched in the order of their first use
+		const uint32 * indices = mesh->GetIndexBuffer();
+		uint32 next = 0;
+		for (int i = 0; i < mesh->GetIndexNum(); i++)
+		{
+			K3D_ASSERT(indices[i] <= next);
+			next = max(next, indices[i] + 1);
+		}
+
+		// with the overdraw pass, the cache order may only get a little worse
+		mesh = MakeTube(1);
+		options.OverdrawThreshold = 1.05f;
+		MeshOptimizer::Result overdraw;
+		K3D_ASSERT(MeshOptimizer::Optimize(*mesh, options, &overdraw));
+		K3D_ASSERT(Triangles(*mesh) == reference);
+		K3D_ASSERT(overdraw.After.ACMR < cacheOnly.After.ACMR * 1.15f);
+
+		cout << methods[method] << ": " << cacheOnly.Before.NumTriangles << " triangles, ACMR " << cacheOnly.Before.ACMR
+			<< " -> " << cacheOnly.After.ACMR << " (" << overdraw.After.ACMR << " with overdraw order), ATVR "
+			<< cacheOnly.Before.ATVR << " -> " << cacheOnly.After.ATVR << ", " << ms << " ms" << endl;
+	}
+
+	// the raw functions, an index list without a mesh
+	vector<uint32> quad = { 0, 1, 2, 2, 1, 3 }, optimized(6);
+	MeshOptimizer::OptimizeVertexCache(optimized.data(), quad.data(), quad.size(), 4);
+	auto stats = MeshOptimizer::AnalyzeVertexCache(optimized.data(), optimized.size(), 4);
+	K3D_ASSERT(stats.NumMisses == 4 && stats.NumVertices == 4 && stats.ATVR == 1.0f);
+
+	// points aren't reordered
+	MeshData points;
+	points.SetPrimType(PrimType::POINTS);
+	K3D_ASSERT(!MeshOptimizer::Optimize(points));
+
+	// nor are separated components, the indices stay as they were
+	MeshData separated;
+	vector<uint32> triangles = quad;
+	separated.SetPrimType(PrimType::TRIANGLES);
+	separated.SetVertexFormat(VtxFormat::PER_INSTANCE);
+	separated.SetVertexNum(4);
+	separated.SetIndexBuffer(triangles);
+	K3D_ASSERT(!MeshOptimizer::Optimize(separated));
+	K3D_ASSERT(vector<uint32>(separated.GetIndexBuffer(), separated.GetIndexBuffer() + 6) == quad);
+}
+
+int main(int argc, char**argv)
+{
+	TestMeshOptimizer();
+	return 0;
+}
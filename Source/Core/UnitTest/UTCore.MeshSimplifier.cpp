@@ -0,0 +1,355 @@
+#include "Common.h"
+#include <Core/Bundle.h>
+#include <Core/MeshData.h>
+#include <Core/MeshSimplifier.h>
+#include <Core/Dispatch/ThreadPool.h>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <set>
+#include <unordered_map>
+
+#if K3DPLATFORM_OS_WIN
+#pragma comment(linker,"/subsystem:console")
+#endif
+
+using namespace std;
+using namespace k3d;
+
+static const float kRadius = 25.0f;
+static const float kCenter[3] = { 3.0f, -12.0f, 0.0f };
+
+inline float Bump(float theta, float phi)
+{
+	return kRadius + 0.5f * sinf(phi * 7.0f) * sinf(theta * 5.0f);
+}
+
+/// a bumpy ellipsoid with a uv seam at phi 0 and locked poles
+shared_ptr<MeshData> MakeSphere(uint32 rings, uint32 segments, const char * name = "sphere")
+{
+	vector<Vertex3F3F2F> vertices;
+	for (uint32 j = 0; j <= rings; j++)
+	{
+		float theta = j * 3.1415926f / rings;
+		for (uint32 i = 0; i <= segments; i++)
+		{
+			// the seam columns share their positions exactly
+			float phi = (i % segments) * 6.2831853f / segments;
+			float nx = sinf(theta) * cosf(phi), ny = cosf(theta), nz = sinf(theta) * sinf(phi);
+			if (j == 0 || j == rings)
+			{
+				nx = nz = 0.0f;
+				ny = j ? -1.0f : 1.0f;
+			}
+			float r = Bump(theta, phi);
+			vertices.push_back({ kCenter[0] + nx * r, kCenter[1] + ny * r * 0.5f, kCenter[2] + nz * r,
+				nx, ny, nz, (float)i / segments, (float)j / rings });
+		}
+	}
+	vector<uint32> indices;
+	for (uint32 j = 0; j < rings; j++)
+	{
+		for (uint32 i = 0; i < segments; i++)
+		{
+			uint32 v00 = j * (segments + 1) + i, v10 = v00 + 1;
+			uint32 v01 = v00 + segments + 1, v11 = v01 + 1;
+			if (j != 0)
+				indices.insert(indices.end(), { v00, v10, v01 });
+			if (j != rings - 1)
+				indices.insert(indices.end(), { v10, v11, v01 });
+		}
+	}
+	auto mesh = make_shared<MeshData>();
+	mesh->SetMeshName(name);
+	mesh->SetVertexFormat(VtxFormat::POS3_F32_NOR3_F32_UV2_F32);
+	mesh->SetVertexNum((int)vertices.size());
+	mesh->SetVertexBuffer(vertices.data());
+	mesh->SetIndexBuffer(indices);
+	return mesh;
+}
+
+static const uint32 kPatchSide = 200;
+
+/// an open height field
+shared_ptr<MeshData> MakePatch()
+{
+	vector<Vertex3F2F> vertices;
+	for (uint32 z = 0; z <= kPatchSide; z++)
+	{
+		for (uint32 x = 0; x <= kPatchSide; x++)
+		{
+			float height = 2.0f * sinf(x * 0.05f) * cosf(z * 0.03f);
+			vertices.push_back({ (float)x, height, (float)z, (float)x / kPatchSide, (float)z / kPatchSide });
+		}
+	}
+	vector<uint32> indices;
+	for (uint32 z = 0; z < kPatchSide; z++)
+	{
+		for (uint32 x = 0; x < kPatchSide; x++)
+		{
+			uint32 v00 = z * (kPatchSide + 1) + x, v10 = v00 + 1;
+			uint32 v01 = v00 + kPatchSide + 1, v11 = v01 + 1;
+			indices.insert(indices.end(), { v00, v01, v10, v10, v01, v11 });
+		}
+	}
+	auto mesh = make_shared<MeshData>();
+	mesh->SetMeshName("patch");
+	mesh->SetVertexFormat(VtxFormat::POS3_F32_UV2_F32);
+	mesh->SetVertexNum((int)vertices.size());
+	mesh->SetVertexBuffer(vertices.data());
+	mesh->SetIndexBuffer(indices);
+	return mesh;
+}
+
+const float * Position(MeshData const& mesh, uint32 v)
+{
+	return (const float*)((const kByte*)mesh.GetVertexBuffer() + (size_t)v * MeshData::GetVertexStride(mesh.GetVertexFormat()));
+}
+
+/// the edges without a twin once vertices at the same position are welded
+vector<pair<uint32, uint32>> OpenEdges(MeshData const& mesh, vector<uint32> const& indices)
+{
+	unordered_map<string, uint32> welded;
+	vector<uint32> weld(mesh.GetVertexNum());
+	for (uint32 v = 0; v < (uint32)mesh.GetVertexNum(); v++)
+		weld[v] = welded.emplace(string((const char*)Position(mesh, v), sizeof(float) * 3), v).first->second;
+	set<pair<uint32, uint32>> edges;
+	for (size_t i = 0; i < indices.size(); i += 3)
+	{
+		for (uint32 k = 0; k < 3; k++)
+			edges.insert({ weld[indices[i + k]], weld[indices[i + (k + 1) % 3]] });
+	}
+	vector<pair<uint32, uint32>> open;
+	for (auto const& edge : edges)
+	{
+		if (!edges.count({ edge.second, edge.first }))
+			open.push_back(edge);
+	}
+	return open;
+}
+
+/// distance of the triangle centers to the analytic surface
+float MaxDeviation(MeshData const& mesh, vector<uint32> const& indices)
+{
+	float deviation = 0.0f;
+	for (size_t i = 0; i < indices.size(); i += 3)
+	{
+		float d[3] = {};
+		for (uint32 k = 0; k < 3; k++)
+		{
+			const float * p = Position(mesh, indices[i + k]);
+			for (uint32 c = 0; c < 3; c++)
+				d[c] += (p[c] - kCenter[c]) / 3.0f;
+		}
+		d[1] *= 2.0f;
+		float r = sqrtf(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+		float theta = acosf(max(-1.0f, min(1.0f, d[1] / r))), phi = atan2f(d[2], d[0]);
+		deviation = max(deviation, fabsf(r - Bump(theta, phi < 0.0f ? phi + 6.2831853f : phi)));
+	}
+	return deviation;
+}
+
+void TestSimplifySphere(MeshData const& mesh)
+{
+	vector<uint32> indices(mesh.GetIndexBuffer(), mesh.GetIndexBuffer() + mesh.GetIndexNum());
+	K3D_ASSERT(OpenEdges(mesh, indices).empty());
+	for (float ratio : { 0.25f, 0.05f, 0.01f })
+	{
+		MeshSimplifier::Options options;
+		options.TargetTriangles = (uint32)(indices.size() / 3 * ratio);
+		options.TargetError = 1.0f;
+		MeshSimplifier::Result result;
+		vector<uint32> simplified(indices.size());
+		auto start = chrono::high_resolution_clock::now();
+		size_t numIndices = MeshSimplifier::Simplify(simplified.data(), indices.data(), indices.size(), mesh, options, &result);
+		double ms = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+		simplified.resize(numIndices);
+		K3D_ASSERT(numIndices % 3 == 0 && result.NumTriangles * 3 == numIndices);
+		K3D_ASSERT(result.NumTriangles <= options.TargetTriangles);
+		// both sides of the seam moved together
+		K3D_ASSERT(OpenEdges(mesh, simplified).empty());
+		float deviation = MaxDeviation(mesh, simplified);
+		K3D_ASSERT(deviation < kRadius * 0.03f);
+		cout << "sphere " << indices.size() / 3 << " -> " << result.NumTriangles << " triangles in " << ms
+			<< " ms, error " << result.Error << ", surface deviation " << deviation << endl;
+	}
+
+	// the error limit stops it first
+	MeshSimplifier::Options options;
+	options.TargetError = 1e-3f;
+	MeshSimplifier::Result result;
+	vector<uint32> simplified(indices.size());
+	size_t numIndices = MeshSimplifier::Simplify(simplified.data(), indices.data(), indices.size(), mesh, options, &result);
+	float extent = kRadius * 2.0f + 1.0f;
+	K3D_ASSERT(numIndices < indices.size() && numIndices > 0 && result.Error <= options.TargetError * extent);
+
+	// locked seams keep every seam vertex
+	options.TargetError = 1.0f;
+	options.TargetTriangles = (uint32)indices.size() / 30;
+	options.LockSeams = true;
+	numIndices = MeshSimplifier::Simplify(simplified.data(), indices.data(), indices.size(), mesh, options, &result);
+	simplified.resize(numIndices);
+	set<uint32> used(simplified.begin(), simplified.end());
+	uint32 segments = 0;
+	while (Position(mesh, segments + 1)[0] == Position(mesh, 0)[0] && Position(mesh, segments + 1)[2] == Position(mesh, 0)[2])
+		segments++;
+	uint32 stride = 0;
+	for (uint32 v = 1; v < (uint32)mesh.GetVertexNum() && !stride; v++)
+	{
+		// the first vertex past the pole is the start of the next ring
+		if (Position(mesh, v)[1] != Position(mesh, 0)[1])
+			stride = v;
+	}
+	for (uint32 v = stride; v + stride < (uint32)mesh.GetVertexNum(); v += stride)
+	{
+		K3D_ASSERT(used.count(v) && used.count(v + stride - 1));
+	}
+	K3D_ASSERT(OpenEdges(mesh, simplified).empty());
+}
+
+void TestSimplifyBorder(MeshData const& mesh)
+{
+	vector<uint32> indices(mesh.GetIndexBuffer(), mesh.GetIndexBuffer() + mesh.GetIndexNum());
+	auto onBorder = [&mesh](uint32 v)
+	{
+		const float * p = Position(mesh, v);
+		return p[0] == 0.0f || p[0] == (float)kPatchSide || p[2] == 0.0f || p[2] == (float)kPatchSide;
+	};
+	MeshSimplifier::Options options;
+	options.TargetTriangles = (uint32)indices.size() / 3 / 10;
+	options.TargetError = 1.0f;
+	vector<uint32> simplified(indices.size());
+	MeshSimplifier::Result result;
+	simplified.resize(MeshSimplifier::Simplify(simplified.data(), indices.data(), indices.size(), mesh, options, &result));
+	K3D_ASSERT(result.NumTriangles <= options.TargetTriangles);
+	// the border only lost vertices along its straight lines
+	float length = 0.0f;
+	for (auto const& edge : OpenEdges(mesh, simplified))
+	{
+		const float * a = Position(mesh, edge.first), * b = Position(mesh, edge.second);
+		K3D_ASSERT(onBorder(edge.first) && onBorder(edge.second) && (a[0] == b[0] || a[2] == b[2]));
+		length += sqrtf((a[0] - b[0]) * (a[0] - b[0]) + (a[2] - b[2]) * (a[2] - b[2]));
+	}
+	K3D_ASSERT(fabsf(length - 4.0f * kPatchSide) < 1e-3f);
+	uint32 bordersKept = 0;
+	for (uint32 v : set<uint32>(simplified.begin(), simplified.end()))
+		bordersKept += onBorder(v) ? 1 : 0;
+	cout << "patch " << indices.size() / 3 << " -> " << result.NumTriangles << " triangles, error " << result.Error
+		<< ", " << bordersKept << " of " << 4 * kPatchSide << " border vertices" << endl;
+
+	options.LockBorder = true;
+	simplified.resize(indices.size());
+	simplified.resize(MeshSimplifier::Simplify(simplified.data(), indices.data(), indices.size(), mesh, options, &result));
+	set<uint32> used(simplified.begin(), simplified.end());
+	for (uint32 v = 0; v < (uint32)mesh.GetVertexNum(); v++)
+	{
+		K3D_ASSERT(!onBorder(v) || used.count(v));
+	}
+}
+
+void TestLodChain(MeshData const& mesh, MeshLodData & lods)
+{
+	auto start = chrono::high_resolution_clock::now();
+	K3D_ASSERT(lods.Build(mesh));
+	double ms = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+	K3D_ASSERT(lods.GetLodNum() > 4 && lods.GetVertexNum() == (uint32)mesh.GetVertexNum());
+	K3D_ASSERT(lods.GetLods()[0].IndexCount == (uint32)mesh.GetIndexNum() && lods.GetLods()[0].Error == 0.0f);
+	float projection = MeshLodData::ProjectionScale(60.0f, 1080.0f);
+	for (uint32 l = 0; l < lods.GetLodNum(); l++)
+	{
+		MeshLod const& lod = lods.GetLods()[l];
+		if (l)
+		{
+			MeshLod const& finer = lods.GetLods()[l - 1];
+			K3D_ASSERT(lod.IndexCount < finer.IndexCount && lod.Error >= finer.Error);
+		}
+		for (uint32 i = 0; i < lod.IndexCount; i++)
+		{
+			K3D_ASSERT(lods.GetIndices()[lod.IndexOffset + i] < lods.GetVertexNum());
+		}
+		// where it projects to a pixel
+		float distance = lod.Error * projection;
+		cout << "lod " << l << ": " << lod.IndexCount / 3 << " triangles, error " << lod.Error
+			<< ", 1 pixel at " << distance << endl;
+		if (l)
+		{
+			K3D_ASSERT(fabsf(lods.GetScreenError(l, distance, projection) - 1.0f) < 1e-4f);
+			K3D_ASSERT(lods.SelectLod(distance * 1.01f, projection) >= l && lods.SelectLod(distance * 0.99f, projection) < l);
+		}
+	}
+	K3D_ASSERT(lods.SelectLod(0.0f, projection) == 0);
+	cout << lods.GetLodNum() << " lods in " << ms << " ms" << endl;
+}
+
+void TestParallelLods()
+{
+	vector<shared_ptr<MeshData>> meshes;
+	for (uint32 m = 0; m < 8; m++)
+		meshes.push_back(MakeSphere(96 + m * 16, 192 + m * 32, "rock"));
+	meshes.push_back(MakePatch());
+	// points have no LODs
+	meshes.push_back(make_shared<MeshData>());
+	meshes.back()->SetPrimType(PrimType::POINTS);
+
+	vector<SpMeshLods> serial(meshes.size()), parallel(meshes.size());
+	Dispatch::ThreadPool one(1), workers(4);
+	auto start = chrono::high_resolution_clock::now();
+	BuildMeshLods(meshes.data(), serial.data(), (uint32)meshes.size(), MeshLodData::BuildOptions(), &one);
+	double serialMs = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+	start = chrono::high_resolution_clock::now();
+	BuildMeshLods(meshes.data(), parallel.data(), (uint32)meshes.size(), MeshLodData::BuildOptions(), &workers);
+	double parallelMs = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+	K3D_ASSERT(!serial.back() && !parallel.back());
+	for (size_t m = 0; m + 1 < meshes.size(); m++)
+	{
+		K3D_ASSERT(serial[m] && parallel[m] && serial[m]->GetLodNum() == parallel[m]->GetLodNum());
+		uint32 numIndices = serial[m]->GetLods()[serial[m]->GetLodNum() - 1].IndexOffset + serial[m]->GetLods()[serial[m]->GetLodNum() - 1].IndexCount;
+		K3D_ASSERT(memcmp(serial[m]->GetIndices(), parallel[m]->GetIndices(), numIndices * sizeof(uint32)) == 0);
+	}
+	cout << meshes.size() - 1 << " meshes: " << serialMs << " ms on 1 thread, " << parallelMs << " ms on 4" << endl;
+}
+
+void TestLodBundle(MeshData const& mesh, MeshLodData const& lods)
+{
+	{
+		AssetBundleWriter writer;
+		K3D_ASSERT(writer.Open(KT("./TestMeshLods.bundle")));
+		writer.SetCompression(EChunkCompression::ELZ);
+		writer.AddChunk(MeshLodData::ChunkName(mesh.Name()).c_str(), EAssetType::EMeshLods, [&lods](Archive & archive)
+		{
+			archive << EMeshLodVersion::VERSION_1_0;
+			archive << lods;
+		});
+		K3D_ASSERT(writer.Finish());
+	}
+	AssetBundleReader reader;
+	K3D_ASSERT(reader.Open(KT("./TestMeshLods.bundle")));
+	auto chunk = reader.Find(MeshLodData::ChunkName("sphere").c_str());
+	auto loaded = MeshLodData::CreateFromChunk(chunk);
+	K3D_ASSERT(loaded && strcmp(loaded->Name(), "sphere") == 0 && loaded->GetLodNum() == lods.GetLodNum());
+	K3D_ASSERT(memcmp(loaded->GetLods(), lods.GetLods(), lods.GetLodNum() * sizeof(MeshLod)) == 0);
+	MeshLod const& last = lods.GetLods()[lods.GetLodNum() - 1];
+	K3D_ASSERT(memcmp(loaded->GetIndices(), lods.GetIndices(), (last.IndexOffset + last.IndexCount) * sizeof(uint32)) == 0);
+
+	vector<kByte> raw((size_t)chunk.RawSize);
+	K3D_ASSERT(AssetBundleReader::Decode(chunk, raw.data()));
+	MeshLodData broken;
+	K3D_ASSERT(!broken.Load(raw.data(), raw.size() - 1));
+	// an index past the vertices
+	memset(&raw[raw.size() - 4], 0xff, 4);
+	K3D_ASSERT(!broken.Load(raw.data(), raw.size()) && broken.GetLodNum() == 0);
+	reader.Close();
+	Os::Remove(KT("./TestMeshLods.bundle"));
+}
+
+int main(int argc, char**argv)
+{
+	auto sphere = MakeSphere(384, 768);
+	TestSimplifySphere(*sphere);
+	TestSimplifyBorder(*MakePatch());
+	MeshLodData lods;
+	TestLodChain(*sphere, lods);
+	TestParallelLods();
+	TestLodBundle(*sphere, lods);
+	return 0;
+}
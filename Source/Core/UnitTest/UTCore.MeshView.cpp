@@ -0,0 +1,190 @@
+#include "Common.h"
+#include <Core/Bundle.h>
+#include <Core/MeshData.h>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+
+#if K3DPLATFORM_OS_WIN
+#pragma comment(linker,"/subsystem:console")
+#endif
+
+using namespace std;
+using namespace k3d;
+
+static const uint32 kVerticesPerMesh = 128 * 1024;
+
+string MeshName(uint32 i)
+{
+	return "mesh_" + to_string(i);
+}
+
+void WriteMesh(Archive & archive, uint32 m)
+{
+	vector<float> vertices(kVerticesPerMesh * 8);
+	for (uint32 v = 0; v < vertices.size(); v++)
+		vertices[v] = (float)(v % 8) + m;
+	vector<uint32> indices(kVerticesPerMesh);
+	for (uint32 i = 0; i < indices.size(); i++)
+		indices[i] = (i * 7 + m) % kVerticesPerMesh;
+	MeshData mesh;
+	mesh.SetMeshName(MeshName(m).c_str());
+	mesh.SetVertexFormat(VtxFormat::POS3_F32_NOR3_F32_UV2_F32);
+	mesh.SetVertexNum(kVerticesPerMesh);
+	mesh.SetVertexBuffer(vertices.data());
+	mesh.SetIndexBuffer(indices);
+	archive << EMeshVersion::VERSION_1_1;
+	archive << mesh;
+}
+
+/// anonymous resident memory in KB, the mapped bundle is not part of it
+uint64 AnonResidentKB()
+{
+	ifstream status("/proc/self/status");
+	string line;
+	while (getline(status, line))
+	{
+		if (line.compare(0, 8, "RssAnon:") == 0)
+			return stoull(line.substr(8));
+	}
+	return 0;
+}
+
+/// what an upload to staging memory reads
+uint64 Checksum(MeshData const& mesh)
+{
+	uint64 sum = 0;
+	const uint32 * indices = mesh.GetIndexBuffer();
+	for (int i = 0; i < mesh.GetIndexNum(); i++)
+		sum += indices[i];
+	const float * vertices = mesh.GetVertexBuffer();
+	uint32 numFloats = MeshData::GetVertexByteWidth(mesh.GetVertexFormat(), mesh.GetVertexNum()) / sizeof(float);
+	for (uint32 v = 0; v < numFloats; v += 8)
+		sum += (uint64)vertices[v];
+	return sum;
+}
+
+/// the former load path: decode, then deserialize into owned arrays
+SpMesh LoadCopy(AssetChunkView const& chunk)
+{
+	vector<kByte> raw((size_t)chunk.RawSize);
+	K3D_ASSERT(AssetBundleReader::Decode(chunk, raw.data()));
+	struct Device : public IIODevice
+	{
+		const kByte * Data; size_t Size; size_t Pos;
+		bool	Open(const kchar *, IOFlag) override { return false; }
+		bool	IsEOF() override { return Pos >= Size; }
+		size_t	Read(char * data, size_t len) override { len = min(len, Size - Pos); memcpy(data, Data + Pos, len); Pos += len; return len; }
+		size_t	Write(const void *, size_t) override { return 0; }
+		bool	Seek(size_t offset) override { Pos = offset; return true; }
+		bool	Skip(size_t offset) override { Pos += offset; return true; }
+		void	Flush() override {}
+		void	Close() override {}
+	} device;
+	device.Data = raw.data();
+	device.Size = raw.size();
+	device.Pos = sizeof(EMeshVersion) + 64;
+	Archive archive;
+	archive.SetIODevice(&device);
+	auto mesh = make_shared<MeshData>();
+	archive >> *mesh;
+	return mesh;
+}
+
+void TestMeshView(uint32 numMeshes)
+{
+	{
+		AssetBundleWriter writer;
+		K3D_ASSERT(writer.Open(KT("./TestMeshView.bundle")));
+		for (uint32 m = 0; m < numMeshes; m++)
+			writer.AddChunkAsync(MeshName(m).c_str(), EAssetType::EMesh, [m](Archive & archive) { WriteMesh(archive, m); });
+		K3D_ASSERT(writer.Finish());
+		// a compressed mesh is a view into its decoded chunk
+		K3D_ASSERT(writer.Open(KT("./TestMeshViewLZ.bundle")));
+		writer.SetCompression(EChunkCompression::ELZ);
+		writer.AddChunk(MeshName(0).c_str(), EAssetType::EMesh, [](Archive & archive) { WriteMesh(archive, 0); });
+		K3D_ASSERT(writer.Finish());
+	}
+	uint64 bundleMB = numMeshes * (uint64)MeshData::GetVertexByteWidth(VtxFormat::POS3_F32_NOR3_F32_UV2_F32, kVerticesPerMesh) >> 20;
+
+	vector<SpMesh> views;
+	uint64 viewSum = 0;
+	uint64 anonBefore = AnonResidentKB();
+	auto start = chrono::high_resolution_clock::now();
+	{
+		AssetBundleReader reader;
+		K3D_ASSERT(reader.Open(KT("./TestMeshView.bundle")));
+		for (uint32 m = 0; m < numMeshes; m++)
+		{
+			auto mesh = MeshData::CreateFromChunk(reader.Find(MeshName(m).c_str()), reader.GetFile());
+			K3D_ASSERT(mesh && mesh->IsView() && mesh->GetVertexNum() == (int)kVerticesPerMesh);
+			viewSum += Checksum(*mesh);
+			views.push_back(mesh);
+		}
+		// the meshes keep the mapping alive
+	}
+	double viewMs = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+	uint64 viewAnonKB = AnonResidentKB() - anonBefore;
+	K3D_ASSERT(strcmp(views.back()->Name(), MeshName(numMeshes - 1).c_str()) == 0);
+	views.clear();
+
+	vector<SpMesh> copies;
+	uint64 copySum = 0;
+	anonBefore = AnonResidentKB();
+	start = chrono::high_resolution_clock::now();
+	{
+		AssetBundleReader reader;
+		K3D_ASSERT(reader.Open(KT("./TestMeshView.bundle")));
+		for (uint32 m = 0; m < numMeshes; m++)
+		{
+			auto mesh = LoadCopy(reader.Find(MeshName(m).c_str()));
+			K3D_ASSERT(!mesh->IsView());
+			copySum += Checksum(*mesh);
+			copies.push_back(mesh);
+		}
+	}
+	double copyMs = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+	uint64 copyAnonKB = AnonResidentKB() - anonBefore;
+	copies.clear();
+	K3D_ASSERT(viewSum == copySum);
+
+	{
+		AssetBundleReader reader;
+		K3D_ASSERT(reader.Open(KT("./TestMeshViewLZ.bundle")));
+		auto chunk = reader.Find(MeshName(0).c_str());
+		K3D_ASSERT(chunk.Compression == EChunkCompression::ELZ);
+		auto mesh = MeshData::CreateFromChunk(chunk, reader.GetFile());
+		K3D_ASSERT(mesh && mesh->IsView() && Checksum(*mesh) == Checksum(*LoadCopy(chunk)));
+		// new buffers replace the view's, the other buffer is copied out
+		vector<uint32> indices = { 0, 1, 2 };
+		float first = mesh->GetVertexBuffer()[0];
+		mesh->SetIndexBuffer(indices);
+		K3D_ASSERT(!mesh->IsView() && mesh->GetIndexNum() == 3 && mesh->GetVertexBuffer()[0] == first);
+		auto vertexView = MeshData::CreateFromChunk(chunk, reader.GetFile());
+		uint32 index = vertexView->GetIndexBuffer()[1];
+		vector<float> vertices(kVerticesPerMesh * 8, 5.0f);
+		vertexView->SetVertexBuffer(vertices.data());
+		K3D_ASSERT(!vertexView->IsView() && vertexView->GetIndexBuffer()[1] == index && vertexView->GetVertexBuffer()[7] == 5.0f);
+		vertexView->SetIndexBuffer(indices);
+		vertexView->SetVertexBuffer(vertices.data());
+		// a truncated chunk is rejected
+		vector<kByte> raw((size_t)chunk.RawSize);
+		K3D_ASSERT(AssetBundleReader::Decode(chunk, raw.data()));
+		MeshData truncated;
+		K3D_ASSERT(!truncated.LoadView(raw.data(), raw.size() / 2, nullptr));
+		K3D_ASSERT(truncated.GetVertexNum() == 0);
+	}
+
+	cout << numMeshes << " meshes, " << bundleMB << " MB: views " << viewMs << " ms, +" << viewAnonKB / 1024
+		<< " MB anonymous; copies " << copyMs << " ms, +" << copyAnonKB / 1024 << " MB anonymous" << endl;
+
+	Os::Remove(KT("./TestMeshView.bundle"));
+	Os::Remove(KT("./TestMeshViewLZ.bundle"));
+}
+
+int main(int argc, char**argv)
+{
+	// 4 MB meshes, pass 256 for a 1 GB set
+	TestMeshView(argc > 1 ? (uint32)atoi(argv[1]) : 32);
+	return 0;
+}
@@ -0,0 +1,309 @@
+#include "Common.h"
+#include <Core/Bundle.h>
+#include <Core/MeshData.h>
+#include <Core/MeshOptimizer.h>
+#include <Core/Meshlet.h>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <iostream>
+
+#if K3DPLATFORM_OS_WIN
+#pragma comment(linker,"/subsystem:console")
+#endif
+
+using namespace std;
+using namespace k3d;
+
+static const uint32 kFieldSide = 16;
+static const float kFieldSpacing = 4.0f;
+static const uint32 kSegments = 48;
+
+/// a field of spheres in one mesh, like scattered rocks merged for drawing
+shared_ptr<MeshData> MakeSphereField()
+{
+	vector<Vertex3F3F> vertices;
+	vector<uint32> indices;
+	for (uint32 s = 0; s < kFieldSide * kFieldSide; s++)
+	{
+		float cx = (s % kFieldSide) * kFieldSpacing, cz = (s / kFieldSide) * kFieldSpacing;
+		uint32 base = (uint32)vertices.size();
+		for (uint32 j = 0; j <= kSegments / 2; j++)
+		{
+			float theta = j * 3.1415926f / (kSegments / 2);
+			for (uint32 i = 0; i <= kSegments; i++)
+			{
+				float phi = i * 6.2831853f / kSegments;
+				float nx = sinf(theta) * cosf(phi), ny = cosf(theta), nz = sinf(theta) * sinf(phi);
+				vertices.push_back({ cx + nx, 1.0f + ny, cz + nz, nx, ny, nz });
+			}
+		}
+		for (uint32 j = 0; j < kSegments / 2; j++)
+		{
+			for (uint32 i = 0; i < kSegments; i++)
+			{
+				uint32 v00 = base + j * (kSegments + 1) + i, v10 = v00 + 1;
+				uint32 v01 = v00 + kSegments + 1, v11 = v01 + 1;
+				indices.insert(indices.end(), { v00, v10, v01, v10, v11, v01 });
+			}
+		}
+	}
+	auto mesh = make_shared<MeshData>();
+	mesh->SetMeshName("rocks");
+	mesh->SetVertexFormat(VtxFormat::POS3_F32_NOR3_F32);
+	mesh->SetVertexNum((int)vertices.size());
+	mesh->SetVertexBuffer(vertices.data());
+	mesh->SetIndexBuffer(indices);
+	return mesh;
+}
+
+typedef array<float, 3> Float3;
+
+Float3 Position(MeshData const& mesh, uint32 v)
+{
+	auto vertex = ((const Vertex3F3F*)mesh.GetVertexBuffer())[v];
+	return { vertex.PosX, vertex.PosY, vertex.PosZ };
+}
+
+/// frustum planes the way BaseCamera::CalcFrustumPlanes builds them
+struct TestView
+{
+	kMath::Vec3f	Position;
+	kMath::Vec4f	Planes[6];
+	const char *	Name;
+
+	TestView(const char * name, kMath::Vec3f position, kMath::Vec3f target, float fov = 60.0f, float zfar = 200.0f)
+		: Position(position), Name(name)
+	{
+		float znear = 0.1f, aspect = 16.0f / 9.0f;
+		kMath::Vec3f look = kMath::Normalize(target - position);
+		kMath::Vec3f right = kMath::Normalize(kMath::CrossProduct(look, kMath::Vec3f(0.0f, 1.0f, 0.0f)));
+		kMath::Vec3f up = kMath::CrossProduct(right, look);
+		kMath::Vec3f cN = position + look * znear, cF = position + look * zfar;
+		float hHnear = ::tan(kMath::ToRadian(fov / 2.0f)) * znear, hWnear = hHnear * aspect;
+		float hHfar = ::tan(kMath::ToRadian(fov / 2.0f)) * zfar, hWfar = hHfar * aspect;
+		kMath::Vec3f farPts[4] = {
+			cF + up * hHfar - right * hWfar, cF - up * hHfar - right * hWfar,
+			cF - up * hHfar + right * hWfar, cF + up * hHfar + right * hWfar
+		};
+		kMath::Vec3f nearPts[4] = {
+			cN + up * hHnear - right * hWnear, cN - up * hHnear - right * hWnear,
+			cN - up * hHnear + right * hWnear, cN + up * hHnear + right * hWnear
+		};
+		kMath::Plane planes[6] = {
+			kMath::Plane::ConstructFromPoints(nearPts[3], nearPts[0], farPts[0]),
+			kMath::Plane::ConstructFromPoints(nearPts[1], nearPts[2], farPts[2]),
+			kMath::Plane::ConstructFromPoints(nearPts[0], nearPts[1], farPts[1]),
+			kMath::Plane::ConstructFromPoints(nearPts[2], nearPts[3], farPts[2]),
+			kMath::Plane::ConstructFromPoints(nearPts[0], nearPts[3], nearPts[2]),
+			kMath::Plane::ConstructFromPoints(farPts[3], farPts[0], farPts[1])
+		};
+		for (uint32 i = 0; i < 6; i++)
+		{
+			Planes[i] = planes[i].ToVec4();
+			// the center of the frustum is inside
+			K3D_ASSERT(planes[i].GetDistance(position + look * (zfar * 0.5f)) > 0.0f);
+		}
+	}
+};
+
+/// the triangles of the meshlets as mesh indices, in a canonical order
+vector<array<uint32, 3>> MeshletTriangles(MeshletData const& meshlets)
+{
+	vector<array<uint32, 3>> triangles;
+	for (uint32 m = 0; m < meshlets.GetMeshletNum(); m++)
+	{
+		Meshlet const& meshlet = meshlets.GetMeshlets()[m];
+		const uint32 * vertices = meshlets.GetVertices() + meshlet.VertexOffset;
+		const uint8 * local = meshlets.GetTriangles() + meshlet.TriangleOffset;
+		for (uint32 t = 0; t < meshlet.TriangleCount; t++)
+			triangles.push_back({ vertices[local[t * 3]], vertices[local[t * 3 + 1]], vertices[local[t * 3 + 2]] });
+	}
+	sort(triangles.begin(), triangles.end());
+	return triangles;
+}
+
+/// culled meshlets may hide no triangle the viewer sees
+void CheckConservative(MeshData const& mesh, MeshletData const& meshlets, TestView const& view,
+	vector<uint32> const& visible, uint32 & numFacingAway)
+{
+	vector<bool> drawn(meshlets.GetMeshletNum(), false);
+	for (uint32 m : visible)
+		drawn[m] = true;
+	numFacingAway = 0;
+	Float3 eye = { view.Position[0], view.Position[1], view.Position[2] };
+	for (uint32 m = 0; m < meshlets.GetMeshletNum(); m++)
+	{
+		Meshlet const& meshlet = meshlets.GetMeshlets()[m];
+		MeshletBounds const& bounds = meshlets.GetBounds()[m];
+		const uint32 * vertices = meshlets.GetVertices() + meshlet.VertexOffset;
+		const uint8 * local = meshlets.GetTriangles() + meshlet.TriangleOffset;
+		bool outside = false;
+		for (uint32 i = 0; i < 6; i++)
+		{
+			auto const& p = view.Planes[i];
+			outside |= p[0] * bounds.Center[0] + p[1] * bounds.Center[1] + p[2] * bounds.Center[2] + p[3] < -bounds.Radius;
+		}
+		for (uint32 t = 0; t < meshlet.TriangleCount; t++)
+		{
+			Float3 p[3];
+			for (uint32 k = 0; k < 3; k++)
+				p[k] = Position(mesh, vertices[local[t * 3 + k]]);
+			float e1[3], e2[3], n[3], toTriangle[3];
+			for (uint32 k = 0; k < 3; k++)
+			{
+				e1[k] = p[1][k] - p[0][k];
+				e2[k] = p[2][k] - p[0][k];
+				toTriangle[k] = p[0][k] - eye[k];
+			}
+			n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+			n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+			n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+			float area = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+			float facing = n[0] * toTriangle[0] + n[1] * toTriangle[1] + n[2] * toTriangle[2];
+			bool facesAway = area == 0.0f || facing >= 0.0f;
+			if (!outside && facesAway)
+				numFacingAway++;
+			// only frustum culling may drop triangles which face the viewer
+			if (!drawn[m] && !outside)
+			{
+				K3D_ASSERT(facesAway || facing > -1e-4f * area);
+			}
+		}
+	}
+}
+
+void TestMeshletBuild(MeshData & mesh, MeshletData & meshlets)
+{
+	vector<array<uint32, 3>> reference;
+	const uint32 * indices = mesh.GetIndexBuffer();
+	for (int i = 0; i < mesh.GetIndexNum(); i += 3)
+		reference.push_back({ indices[i], indices[i + 1], indices[i + 2] });
+	sort(reference.begin(), reference.end());
+
+	auto start = chrono::high_resolution_clock::now();
+	K3D_ASSERT(meshlets.Build(mesh));
+	double ms = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+	K3D_ASSERT(strcmp(meshlets.Name(), "rocks") == 0);
+	K3D_ASSERT(MeshletTriangles(meshlets) == reference);
+
+	uint32 numCones = 0, totalVertices = 0;
+	for (uint32 m = 0; m < meshlets.GetMeshletNum(); m++)
+	{
+		Meshlet const& meshlet = meshlets.GetMeshlets()[m];
+		MeshletBounds const& bounds = meshlets.GetBounds()[m];
+		K3D_ASSERT(meshlet.VertexCount <= MeshletData::kMaxVertices && meshlet.TriangleCount <= MeshletData::kMaxTriangles);
+		totalVertices += meshlet.VertexCount;
+		numCones += bounds.ConeCutoff <= 1.0f;
+		for (uint32 v = 0; v < meshlet.VertexCount; v++)
+		{
+			Float3 p = Position(mesh, meshlets.GetVertices()[meshlet.VertexOffset + v]);
+			float d[3] = { p[0] - bounds.Center[0], p[1] - bounds.Center[1], p[2] - bounds.Center[2] };
+			K3D_ASSERT(sqrtf(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]) <= bounds.Radius * 1.0001f);
+		}
+	}
+	cout << meshlets.GetTriangleNum() << " triangles in " << meshlets.GetMeshletNum() << " meshlets, "
+		<< (float)meshlets.GetTriangleNum() / meshlets.GetMeshletNum() << " triangles and "
+		<< (float)totalVertices / meshlets.GetMeshletNum() << " vertices each, "
+		<< numCones * 100 / meshlets.GetMeshletNum() << "% with a normal cone, built in " << ms << " ms" << endl;
+}
+
+void TestMeshletCulling(MeshData const& mesh, MeshletData const& meshlets)
+{
+	float center = (kFieldSide - 1) * kFieldSpacing * 0.5f;
+	TestView views[] = {
+		// the whole field in view, only cones cull
+		TestView("overview", kMath::Vec3f(center, 40.0f, -60.0f), kMath::Vec3f(center, 0.0f, center)),
+		// walking through it
+		TestView("ground", kMath::Vec3f(-2.0f, 1.5f, -2.0f), kMath::Vec3f(center, 1.0f, center)),
+		// in the middle, most of it is behind
+		TestView("close", kMath::Vec3f(center, 1.5f, center - 1.0f), kMath::Vec3f(center, 1.0f, 100.0f), 45.0f),
+	};
+	for (auto const& view : views)
+	{
+		vector<uint32> visible(meshlets.GetMeshletNum());
+		MeshletCullStats stats;
+		auto start = chrono::high_resolution_clock::now();
+		visible.resize(CullMeshlets(meshlets, view.Planes, view.Position, visible.data(), &stats));
+		double us = chrono::duration<double, micro>(chrono::high_resolution_clock::now() - start).count();
+		K3D_ASSERT(stats.NumMeshlets == meshlets.GetMeshletNum() && stats.NumTriangles == meshlets.GetTriangleNum());
+		K3D_ASSERT(visible.size() + stats.NumFrustumCulled + stats.NumBackfaceCulled == stats.NumMeshlets);
+		uint32 numFacingAway = 0;
+		CheckConservative(mesh, meshlets, view, visible, numFacingAway);
+
+		uint32 frustumTriangles = 0;
+		for (uint32 m = 0; m < meshlets.GetMeshletNum(); m++)
+		{
+			// only the frustum check, for the share the cones get
+			auto const& b = meshlets.GetBounds()[m];
+			bool outside = false;
+			for (auto const& p : view.Planes)
+				outside |= p[0] * b.Center[0] + p[1] * b.Center[1] + p[2] * b.Center[2] + p[3] < -b.Radius;
+			frustumTriangles += outside ? meshlets.GetMeshlets()[m].TriangleCount : 0;
+		}
+		uint32 coneTriangles = stats.NumTrianglesCulled - frustumTriangles;
+		K3D_ASSERT(coneTriangles <= numFacingAway);
+		// a quarter of what faces away is culled as whole meshlets at least
+		K3D_ASSERT(coneTriangles * 4 >= numFacingAway);
+		cout << view.Name << ": " << stats.NumTrianglesCulled * 100.0f / stats.NumTriangles << "% of triangles culled, "
+			<< stats.NumFrustumCulled << " meshlets by the frustum, " << stats.NumBackfaceCulled << " by cones ("
+			<< coneTriangles << " of " << numFacingAway << " triangles facing away), " << us << " us" << endl;
+	}
+}
+
+void TestMeshletBundle(MeshData const& mesh, MeshletData const& meshlets)
+{
+	{
+		AssetBundleWriter writer;
+		K3D_ASSERT(writer.Open(KT("./TestMeshlet.bundle")));
+		writer.SetCompression(EChunkCompression::ELZ);
+		writer.AddChunk(mesh.Name(), EAssetType::EMesh, [&mesh](Archive & archive)
+		{
+			archive << EMeshVersion::VERSION_1_1;
+			archive << mesh;
+		});
+		writer.AddChunk(MeshletData::ChunkName(mesh.Name()).c_str(), EAssetType::EMeshlets, [&meshlets](Archive & archive)
+		{
+			archive << EMeshletVersion::VERSION_1_0;
+			archive << meshlets;
+		});
+		K3D_ASSERT(writer.Finish());
+	}
+	AssetBundleReader reader;
+	K3D_ASSERT(reader.Open(KT("./TestMeshlet.bundle")));
+	auto chunk = reader.Find(MeshletData::ChunkName("rocks").c_str());
+	auto loaded = MeshletData::CreateFromChunk(chunk);
+	K3D_ASSERT(loaded && strcmp(loaded->Name(), "rocks") == 0 && loaded->GetMeshletNum() == meshlets.GetMeshletNum());
+	K3D_ASSERT(memcmp(loaded->GetMeshlets(), meshlets.GetMeshlets(), meshlets.GetMeshletNum() * sizeof(Meshlet)) == 0);
+	K3D_ASSERT(memcmp(loaded->GetBounds(), meshlets.GetBounds(), meshlets.GetMeshletNum() * sizeof(MeshletBounds)) == 0);
+	K3D_ASSERT(MeshletTriangles(*loaded) == MeshletTriangles(meshlets));
+	// the mesh chunk is no meshlet list
+	K3D_ASSERT(!MeshletData::CreateFromChunk(reader.Find("rocks")));
+
+	vector<kByte> raw((size_t)chunk.RawSize);
+	K3D_ASSERT(AssetBundleReader::Decode(chunk, raw.data()));
+	MeshletData broken;
+	K3D_ASSERT(!broken.Load(raw.data(), raw.size() - 1));
+	// a local index past the vertices of its meshlet
+	raw.back() = 0xff;
+	K3D_ASSERT(!broken.Load(raw.data(), raw.size()) && broken.GetMeshletNum() == 0);
+	reader.Close();
+	Os::Remove(KT("./TestMeshlet.bundle"));
+}
+
+int main(int argc, char**argv)
+{
+	auto mesh = MakeSphereField();
+	// meshlets follow the triangle order, a cache optimized one keeps them compact
+	K3D_ASSERT(MeshOptimizer::Optimize(*mesh));
+	MeshletData meshlets;
+	TestMeshletBuild(*mesh, meshlets);
+	TestMeshletCulling(*mesh, meshlets);
+	TestMeshletBundle(*mesh, meshlets);
+
+	// points have no meshlets
+	MeshData points;
+	points.SetPrimType(PrimType::POINTS);
+	K3D_ASSERT(!meshlets.Build(points));
+	return 0;
+}
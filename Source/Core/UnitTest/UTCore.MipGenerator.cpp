@@ -0,0 +1,291 @@
+#include "Common.h"
+#include <Core/ImageData.h>
+#include <Core/MipGenerator.h>
+#include <Core/VertexCodec.h>
+#include <Core/Dispatch/ThreadPool.h>
+#include <cmath>
+#include <iostream>
+#include <random>
+
+#if K3DPLATFORM_OS_WIN
+#pragma comment(linker,"/subsystem:console")
+#endif
+
+using namespace std;
+using namespace k3d;
+
+static const MipGenerator::EFilter kFilters[] = { MipGenerator::EFilter::Box, MipGenerator::EFilter::Kaiser, MipGenerator::EFilter::Lanczos };
+static const char * kFilterNames[] = { "box", "kaiser", "lanczos" };
+
+/// level 0 of 'layers' layers filled by 'fill(layer, x, y, pixel)'
+template <class Fill>
+shared_ptr<ImageData> MakeImage(EImageFormat format, uint32 width, uint32 height, uint32 layers, Fill fill)
+{
+	auto image = make_shared<ImageData>();
+	K3D_ASSERT(image->Create(format, width, height, 1, layers, layers == 6));
+	for (uint32 layer = 0; layer < layers; layer++)
+	{
+		kByte * data = image->GetLevelData(0, layer);
+		uint32 pitch = image->GetLevelDesc(0, layer)->RowPitch, size = ImageData::GetFormatElementSize(format);
+		for (uint32 y = 0; y < height; y++)
+		{
+			for (uint32 x = 0; x < width; x++)
+				fill(layer, x, y, data + y * pitch + x * size);
+		}
+	}
+	return image;
+}
+
+/// largest difference of the levels of two images of the same layout, in units of the format
+double MaxDifference(ImageData const& a, ImageData const& b)
+{
+	K3D_ASSERT(a.GetFormat() == b.GetFormat() && a.GetMipLevs() == b.GetMipLevs() && a.GetLayers() == b.GetLayers());
+	double difference = 0.0;
+	for (uint32 layer = 0; layer < a.GetLayers(); layer++)
+	{
+		for (uint32 level = 0; level < a.GetMipLevs(); level++)
+		{
+			const ImageLevel * la = a.GetLevelDesc(level, layer), * lb = b.GetLevelDesc(level, layer);
+			K3D_ASSERT(la->Size == lb->Size);
+			switch (a.GetFormat())
+			{
+			case EImageFormat::RGBA16_FLOAT:
+				for (uint64 i = 0; i < la->Size / 2; i++)
+				{
+					difference = max(difference, (double)fabsf(VertexCodec::HalfToFloat(((const uint16*)la->Data)[i])
+						- VertexCodec::HalfToFloat(((const uint16*)lb->Data)[i])));
+				}
+				break;
+			case EImageFormat::R32_FLOAT:
+				for (uint64 i = 0; i < la->Size / 4; i++)
+					difference = max(difference, (double)fabsf(((const float*)la->Data)[i] - ((const float*)lb->Data)[i]));
+				break;
+			default:
+				for (uint64 i = 0; i < la->Size; i++)
+					difference = max(difference, (double)abs((int)la->Data[i] - (int)lb->Data[i]));
+				break;
+			}
+		}
+	}
+	return difference;
+}
+
+void TestBoxAndSRGB()
+{
+	// the box filter averages 2x2 blocks
+	mt19937 random(7);
+	auto noise = MakeImage(EImageFormat::RGBA8_UNORM, 64, 32, 1, [&random](uint32, uint32, uint32, kByte * pixel)
+	{
+		for (uint32 c = 0; c < 4; c++)
+			pixel[c] = (kByte)(random() & 255);
+	});
+	MipGenerator::Options options;
+	options.Filter = MipGenerator::EFilter::Box;
+	auto mips = MipGenerator::Generate(*noise, options);
+	K3D_ASSERT(mips && mips->GetMipLevs() == 7 && !mips->IsView());
+	K3D_ASSERT(mips->GetLevelDesc(6, 0)->Width == 1 && mips->GetLevelDesc(6, 0)->Height == 1);
+	K3D_ASSERT(memcmp(mips->GetLevel(0, 0), noise->GetLevel(0, 0), 64 * 32 * 4) == 0);
+	const kByte * base = (const kByte*)noise->GetLevel(0, 0), * level1 = (const kByte*)mips->GetLevel(1, 0);
+	for (uint32 y = 0; y < 16; y++)
+	{
+		for (uint32 x = 0; x < 32; x++)
+		{
+			for (uint32 c = 0; c < 4; c++)
+			{
+				uint32 sum = base[((2 * y) * 64 + 2 * x) * 4 + c] + base[((2 * y) * 64 + 2 * x + 1) * 4 + c]
+					+ base[((2 * y + 1) * 64 + 2 * x) * 4 + c] + base[((2 * y + 1) * 64 + 2 * x + 1) * 4 + c];
+				K3D_ASSERT(abs((int)level1[(y * 32 + x) * 4 + c] - (int)((sum + 2) / 4)) <= 1);
+			}
+		}
+	}
+
+	// black and white stripes average to the middle of linear light, not of sRGB
+	for (EImageFormat format : { EImageFormat::RGBA8_SRGB, EImageFormat::BGRA8_SRGB, EImageFormat::RGBA8_UNORM })
+	{
+		auto stripes = MakeImage(format, 32, 32, 1, [](uint32, uint32 x, uint32, kByte * pixel)
+		{
+			pixel[0] = pixel[1] = pixel[2] = (x & 1) ? 255 : 0;
+			pixel[3] = 255;
+		});
+		for (auto filter : kFilters)
+		{
+			options.Filter = filter;
+			mips = MipGenerator::Generate(*stripes, options);
+			uint32 expected = format == EImageFormat::RGBA8_UNORM ? 128 : (uint32)(MipGenerator::LinearToSRGB(0.5f) * 255.0f + 0.5f);
+			const kByte * pixel = (const kByte*)mips->GetLevel(1, 0) + (8 * 16 + 8) * 4;
+			K3D_ASSERT(abs((int)pixel[0] - (int)expected) <= 1 && pixel[0] == pixel[2] && pixel[3] == 255);
+		}
+	}
+	K3D_ASSERT(fabsf(MipGenerator::SRGBToLinear(MipGenerator::LinearToSRGB(0.3f)) - 0.3f) < 1e-5f);
+}
+
+void TestFilters()
+{
+	// constants stay constant, ramps stay ramps away from the edges
+	for (auto filter : kFilters)
+	{
+		MipGenerator::Options options;
+		options.Filter = filter;
+		for (uint32 size : { 37u, 64u, 5u })
+		{
+			auto flat = MakeImage(EImageFormat::R32_FLOAT, size, size / 2 + 3, 1, [](uint32, uint32, uint32, kByte * pixel)
+			{
+				*(float*)pixel = 0.75f;
+			});
+			auto mips = MipGenerator::Generate(*flat, options);
+			K3D_ASSERT(mips && mips->GetLevelDesc(mips->GetMipLevs() - 1, 0)->Width == 1);
+			for (uint32 level = 0; level < mips->GetMipLevs(); level++)
+			{
+				const ImageLevel * desc = mips->GetLevelDesc(level, 0);
+				for (uint32 i = 0; i < desc->Width * desc->Height; i++)
+					K3D_ASSERT(fabsf(((const float*)desc->Data)[i] - 0.75f) < 1e-5f);
+			}
+		}
+		auto ramp = MakeImage(EImageFormat::R32_FLOAT, 256, 8, 1, [](uint32, uint32 x, uint32, kByte * pixel)
+		{
+			*(float*)pixel = (float)x;
+		});
+		auto mips = MipGenerator::Generate(*ramp, options);
+		const float * level1 = (const float*)mips->GetLevel(1, 0);
+		for (uint32 x = 4; x < 124; x++)
+			K3D_ASSERT(fabsf(level1[x] - (2.0f * x + 0.5f)) < 1e-3f);
+	}
+}
+
+/// the SIMD kernels against the scalar reference
+void TestAgainstScalar()
+{
+	mt19937 random(11);
+	uniform_real_distribution<float> hdr(0.0f, 16.0f);
+	for (EImageFormat format : { EImageFormat::RGBA8_UNORM, EImageFormat::BGRA8_SRGB, EImageFormat::RGBA16_FLOAT, EImageFormat::R32_FLOAT })
+	{
+		auto image = MakeImage(format, 133, 71, 3, [&](uint32, uint32, uint32, kByte * pixel)
+		{
+			if (format == EImageFormat::RGBA16_FLOAT)
+			{
+				for (uint32 c = 0; c < 4; c++)
+					((uint16*)pixel)[c] = VertexCodec::FloatToHalf(c == 3 ? hdr(random) / 16.0f : hdr(random));
+			}
+			else if (format == EImageFormat::R32_FLOAT)
+				*(float*)pixel = hdr(random);
+			else
+			{
+				for (uint32 c = 0; c < 4; c++)
+					pixel[c] = (kByte)(random() & 255);
+			}
+		});
+		K3D_ASSERT(!image->IsCubeMap() && image->GetLayers() == 3);
+		for (uint32 f = 0; f < 3; f++)
+		{
+			MipGenerator::Options options;
+			options.Filter = kFilters[f];
+			auto simd = MipGenerator::Generate(*image, options);
+			options.Scalar = true;
+			auto scalar = MipGenerator::Generate(*image, options);
+			K3D_ASSERT(simd && scalar && simd->GetMipLevs() == 8 && simd->GetLayers() == 3);
+			double difference = MaxDifference(*simd, *scalar);
+			if (format == EImageFormat::RGBA16_FLOAT || format == EImageFormat::R32_FLOAT)
+			{
+				K3D_ASSERT(difference < 0.02);
+			}
+			else
+			{
+				K3D_ASSERT(difference <= 1.0);
+			}
+		}
+	}
+
+	// cube maps keep their faces apart
+	auto cube = MakeImage(EImageFormat::RGBA8_UNORM, 16, 16, 6, [](uint32 layer, uint32, uint32, kByte * pixel)
+	{
+		pixel[0] = pixel[1] = pixel[2] = pixel[3] = (kByte)(layer * 40);
+	});
+	auto mips = MipGenerator::Generate(*cube);
+	K3D_ASSERT(mips->IsCubeMap() && mips->GetMipLevs() == 5);
+	for (uint32 layer = 0; layer < 6; layer++)
+		K3D_ASSERT(((const kByte*)mips->GetLevel(4, layer))[0] == layer * 40);
+
+	ImageData bc;
+	K3D_ASSERT(bc.Create(EImageFormat::BC1_UNORM, 16, 16, 1));
+	K3D_ASSERT(!MipGenerator::Generate(bc) && !MipGenerator::IsSupported(EImageFormat::BC1_UNORM));
+}
+
+/// alpha tested foliage: thin strokes which the filters blur below the reference,
+/// thickening from left to right
+void TestAlphaCoverage()
+{
+	auto leaves = MakeImage(EImageFormat::RGBA8_SRGB, 256, 256, 1, [](uint32, uint32 x, uint32 y, kByte * pixel)
+	{
+		pixel[0] = 40;
+		pixel[1] = 160;
+		pixel[2] = 30;
+		pixel[3] = (x * 7 + y * 3) % 23 < x / 32 ? 255 : 0;
+	});
+	for (uint32 f = 0; f < 3; f++)
+	{
+		MipGenerator::Options options;
+		options.Filter = kFilters[f];
+		options.MaxLevels = 6;
+		options.AlphaReference = 0.5f;
+		MipGenerator::Stats kept;
+		auto mips = MipGenerator::Generate(*leaves, options, nullptr, &kept);
+		K3D_ASSERT(mips && mips->GetMipLevs() == 6);
+		// the same without scaling, measured on the levels
+		options.AlphaReference = 0.0f;
+		auto plain = MipGenerator::Generate(*leaves, options);
+		double base = 0.0, plainError = 0.0, keptError = 0.0;
+		for (uint32 level = 0; level < 6; level++)
+		{
+			const ImageLevel * a = plain->GetLevelDesc(level, 0), * b = mips->GetLevelDesc(level, 0);
+			uint32 pixels = a->Width * a->Height, plainPassed = 0, keptPassed = 0;
+			for (uint32 i = 0; i < pixels; i++)
+			{
+				plainPassed += a->Data[i * 4 + 3] > 127;
+				keptPassed += b->Data[i * 4 + 3] > 127;
+			}
+			if (level == 0)
+				base = (double)plainPassed / pixels;
+			plainError = max(plainError, fabs((double)plainPassed / pixels - base));
+			keptError = max(keptError, fabs((double)keptPassed / pixels - base));
+		}
+		K3D_ASSERT(kept.MaxCoverageError < 0.04f && keptError < 0.04 && keptError < plainError);
+		cout << kFilterNames[f] << " alpha coverage " << base << ": off by " << plainError << ", " << keptError << " when kept" << endl;
+	}
+}
+
+void TestThroughput(uint32 size)
+{
+	mt19937 random(3);
+	auto image = MakeImage(EImageFormat::RGBA8_SRGB, size, size, 1, [&random](uint32, uint32, uint32, kByte * pixel)
+	{
+		uint32 bits = random();
+		memcpy(pixel, &bits, 4);
+	});
+	Dispatch::ThreadPool one(1), workers(4);
+	double megapixels = (double)size * size / 1e6;
+	for (uint32 f = 0; f < 3; f++)
+	{
+		MipGenerator::Options options;
+		options.Filter = kFilters[f];
+		options.Scalar = true;
+		MipGenerator::Stats scalar, simd, parallel;
+		auto reference = MipGenerator::Generate(*image, options, &one, &scalar);
+		options.Scalar = false;
+		auto mips = MipGenerator::Generate(*image, options, &one, &simd);
+		MipGenerator::Generate(*image, options, &workers, &parallel);
+		K3D_ASSERT(MaxDifference(*reference, *mips) <= 1.0 && simd.Pixels == scalar.Pixels);
+		cout << size << "^2 sRGB " << kFilterNames[f] << ": scalar " << megapixels / scalar.Milliseconds * 1000.0
+			<< " MPix/s, " << MipGenerator::GetKernel() << " " << megapixels / simd.Milliseconds * 1000.0
+			<< " MPix/s, 4 threads " << megapixels / parallel.Milliseconds * 1000.0 << " MPix/s" << endl;
+	}
+}
+
+int main(int argc, char**argv)
+{
+	TestBoxAndSRGB();
+	TestFilters();
+	TestAgainstScalar();
+	TestAlphaCoverage();
+	TestThroughput(argc > 1 ? (uint32)atoi(argv[1]) : 2048);
+	return 0;
+}
@@ -0,0 +1,217 @@
+#include "Common.h"
+#include <Core/Skinning.h>
+#include <Core/Dispatch/ThreadPool.h>
+#include <cmath>
+#include <iostream>
+#include <random>
+
+#if K3DPLATFORM_OS_WIN
+#pragma comment(linker,"/subsystem:console")
+#endif
+
+using namespace std;
+using namespace k3d;
+
+/// a cylinder along y bound to a chain of 'bones' bones, each vertex to up to 4 of them
+vector<Vertex3F3F2F4F4I> MakeLimb(uint32 rings, uint32 segments, uint32 bones, mt19937 & random)
+{
+	vector<Vertex3F3F2F4F4I> vertices;
+	uniform_real_distribution<float> jitter(0.0f, 0.2f);
+	for (uint32 r = 0; r < rings; r++)
+	{
+		float y = (float)r / (rings - 1) * bones;
+		for (uint32 s = 0; s < segments; s++)
+		{
+			float a = 6.2831853f * s / segments;
+			Vertex3F3F2F4F4I v = {};
+			v.PosX = cosf(a);
+			v.PosY = y;
+			v.PosZ = sinf(a);
+			v.NorX = cosf(a);
+			v.NorZ = sinf(a);
+			uint32 bone = min((uint32)y, bones - 1);
+			float t = y - bone;
+			v.BoneIDs[0] = bone;
+			v.BoneIDs[1] = min(bone + 1, bones - 1);
+			v.BoneIDs[2] = bone > 0 ? bone - 1 : 0;
+			v.BoneIDs[3] = min(bone + 2, bones - 1);
+			v.BoneWeights[0] = 1.0f - t;
+			v.BoneWeights[1] = t;
+			// some vertices with 3 and 4 influences, unnormalized
+			v.BoneWeights[2] = s % 3 == 0 ? jitter(random) : 0.0f;
+			v.BoneWeights[3] = s % 5 == 0 ? jitter(random) : 0.0f;
+			vertices.push_back(v);
+		}
+	}
+	return vertices;
+}
+
+/// rigid bones bending and twisting along the chain
+vector<kMath::Mat4f> MakePose(uint32 bones, float bend, float twist)
+{
+	vector<kMath::Mat4f> palette;
+	kMath::Mat4f parent = kMath::MakeIdentityMatrix<float>();
+	for (uint32 b = 0; b < bones; b++)
+	{
+		// bone b starts at y = b in the rest pose
+		kMath::Mat4f local = kMath::MakeTranslationMatrix(0.0f, b > 0 ? 1.0f : 0.0f, 0.0f);
+		local = local * kMath::MakeRotationMatrix(kMath::Vec3f(0, 0, 1), bend) * kMath::MakeRotationMatrix(kMath::Vec3f(0, 1, 0), twist);
+		parent = parent * local;
+		palette.push_back(parent * kMath::MakeTranslationMatrix(0.0f, -(float)b, 0.0f));
+	}
+	return palette;
+}
+
+float MaxDifference(Skinning::Output const& a, Skinning::Output const& b, uint32 count)
+{
+	float difference = 0.0f;
+	for (uint32 v = 0; v < count; v++)
+	{
+		difference = max(difference, fabsf(a.PosX[v] - b.PosX[v]));
+		difference = max(difference, fabsf(a.PosY[v] - b.PosY[v]));
+		difference = max(difference, fabsf(a.PosZ[v] - b.PosZ[v]));
+		difference = max(difference, fabsf(a.NorX[v] - b.NorX[v]));
+		difference = max(difference, fabsf(a.NorY[v] - b.NorY[v]));
+		difference = max(difference, fabsf(a.NorZ[v] - b.NorZ[v]));
+	}
+	return difference;
+}
+
+void TestRestPose()
+{
+	mt19937 random(1);
+	auto vertices = MakeLimb(9, 13, 4, random);
+	Skinning::Mesh mesh;
+	mesh.Build(vertices.data(), (uint32)vertices.size());
+	K3D_ASSERT(mesh.GetVertexNum() == vertices.size() && mesh.GetStreamSize() % 8 == 0 && mesh.GetMaxBone() == 3);
+	vector<kMath::Mat4f> identity(4, kMath::MakeIdentityMatrix<float>());
+	for (auto method : { Skinning::EMethod::Linear, Skinning::EMethod::DualQuaternion })
+	{
+		for (bool scalar : { true, false })
+		{
+			Skinning::Options options;
+			options.Method = method;
+			options.Scalar = scalar;
+			Skinning::Output out;
+			Skinning::Instance instance = { &mesh, identity.data(), 4, &out };
+			K3D_ASSERT(Skinning::Skin(&instance, 1, options));
+			for (uint32 v = 0; v < vertices.size(); v++)
+			{
+				K3D_ASSERT(fabsf(out.PosX[v] - vertices[v].PosX) < 1e-5f && fabsf(out.PosY[v] - vertices[v].PosY) < 1e-5f);
+				K3D_ASSERT(fabsf(out.PosZ[v] - vertices[v].PosZ) < 1e-5f && fabsf(out.NorX[v] - vertices[v].NorX) < 1e-5f);
+			}
+			// a palette must cover every bone of the mesh
+			instance.NumBones = 3;
+			K3D_ASSERT(!Skinning::Skin(&instance, 1, options));
+		}
+	}
+}
+
+void TestAgainstScalar()
+{
+	mt19937 random(2);
+	const uint32 bones = 6;
+	auto vertices = MakeLimb(31, 17, bones, random);
+	Skinning::Mesh mesh;
+	mesh.Build(vertices.data(), (uint32)vertices.size());
+	auto palette = MakePose(bones, 25.0f, 40.0f);
+	Dispatch::ThreadPool workers(4);
+	for (auto method : { Skinning::EMethod::Linear, Skinning::EMethod::DualQuaternion })
+	{
+		Skinning::Options options;
+		options.Method = method;
+		options.Scalar = true;
+		Skinning::Output reference, simd, parallel;
+		Skinning::Instance instance = { &mesh, palette.data(), bones, &reference };
+		K3D_ASSERT(Skinning::Skin(&instance, 1, options));
+		options.Scalar = false;
+		instance.Target = &simd;
+		K3D_ASSERT(Skinning::Skin(&instance, 1, options));
+		instance.Target = &parallel;
+		K3D_ASSERT(Skinning::Skin(&instance, 1, options, &workers));
+		K3D_ASSERT(MaxDifference(reference, simd, mesh.GetVertexNum()) < 1e-5f);
+		K3D_ASSERT(MaxDifference(simd, parallel, mesh.GetVertexNum()) == 0.0f);
+
+		// single bone vertices move with their bone under both methods
+		for (uint32 v = 0; v < vertices.size(); v++)
+		{
+			Vertex3F3F2F4F4I const& vertex = vertices[v];
+			if (vertex.BoneWeights[1] != 0.0f || vertex.BoneWeights[2] != 0.0f || vertex.BoneWeights[3] != 0.0f)
+				continue;
+			kMath::Mat4f const& m = palette[vertex.BoneIDs[0]];
+			kMath::Vec4f p = m[0] * vertex.PosX + m[1] * vertex.PosY + m[2] * vertex.PosZ + m[3];
+			K3D_ASSERT(fabsf(p[0] - reference.PosX[v]) < 1e-4f && fabsf(p[1] - reference.PosY[v]) < 1e-4f && fabsf(p[2] - reference.PosZ[v]) < 1e-4f);
+		}
+	}
+}
+
+void TestTwist()
+{
+	// two bones, the second twisted by 170 degrees about the limb
+	mt19937 random(3);
+	auto vertices = MakeLimb(5, 16, 2, random);
+	for (auto & v : vertices)
+		v.BoneWeights[2] = v.BoneWeights[3] = 0.0f;
+	Skinning::Mesh mesh;
+	mesh.Build(vertices.data(), (uint32)vertices.size());
+	vector<kMath::Mat4f> palette = { kMath::MakeIdentityMatrix<float>(), kMath::MakeRotationMatrix(kMath::Vec3f(0, 1, 0), 170.0f) };
+	float radius[2];
+	for (int m = 0; m < 2; m++)
+	{
+		Skinning::Options options;
+		options.Method = m == 0 ? Skinning::EMethod::Linear : Skinning::EMethod::DualQuaternion;
+		Skinning::Output out;
+		Skinning::Instance instance = { &mesh, palette.data(), 2, &out };
+		K3D_ASSERT(Skinning::Skin(&instance, 1, options));
+		// the second ring, half way between the bones
+		radius[m] = 1.0f;
+		for (uint32 v = 16; v < 32; v++)
+			radius[m] = min(radius[m], sqrtf(out.PosX[v] * out.PosX[v] + out.PosZ[v] * out.PosZ[v]));
+	}
+	// linear blending collapses the joint, dual quaternions keep its volume
+	cout << "170 degree twist, joint radius: linear " << radius[0] << ", dual quaternion " << radius[1] << endl;
+	K3D_ASSERT(radius[0] < 0.1f && radius[1] > 0.999f);
+}
+
+void TestThroughput(uint32 numInstances)
+{
+	mt19937 random(4);
+	const uint32 bones = 32;
+	auto vertices = MakeLimb(250, 40, bones, random);
+	Skinning::Mesh mesh;
+	mesh.Build(vertices.data(), (uint32)vertices.size());
+	vector<vector<kMath::Mat4f>> palettes;
+	vector<Skinning::Output> outputs(numInstances);
+	vector<Skinning::Instance> instances;
+	for (uint32 i = 0; i < numInstances; i++)
+		palettes.push_back(MakePose(bones, 3.0f + i * 0.1f, 5.0f));
+	for (uint32 i = 0; i < numInstances; i++)
+		instances.push_back({ &mesh, palettes[i].data(), bones, &outputs[i] });
+	Dispatch::ThreadPool one(1), workers(4);
+	for (auto method : { Skinning::EMethod::Linear, Skinning::EMethod::DualQuaternion })
+	{
+		Skinning::Options options;
+		options.Method = method;
+		options.Scalar = true;
+		Skinning::Stats scalar, simd, parallel;
+		K3D_ASSERT(Skinning::Skin(instances.data(), numInstances, options, &one, &scalar));
+		options.Scalar = false;
+		K3D_ASSERT(Skinning::Skin(instances.data(), numInstances, options, &one, &simd));
+		K3D_ASSERT(Skinning::Skin(instances.data(), numInstances, options, &workers, &parallel));
+		K3D_ASSERT(simd.Vertices == (uint64)vertices.size() * numInstances);
+		cout << numInstances << " x " << vertices.size() << " vertices "
+			<< (method == Skinning::EMethod::Linear ? "linear" : "dual quaternion") << ": scalar "
+			<< scalar.Vertices / scalar.Milliseconds / 1000.0 << " MVerts/s, " << Skinning::GetKernel() << " "
+			<< simd.Vertices / simd.Milliseconds / 1000.0 << " MVerts/s per core, 4 threads "
+			<< parallel.Vertices / parallel.Milliseconds / 1000.0 << " MVerts/s" << endl;
+	}
+}
+
+int main(int argc, char**argv)
+{
+	TestRestPose();
+	TestAgainstScalar();
+	TestTwist();
+	TestThroughput(argc > 1 ? (uint32)atoi(argv[1]) : 64);
+	return 0;
+}
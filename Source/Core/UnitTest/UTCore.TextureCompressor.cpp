@@ -0,0 +1,285 @@
+#include "Common.h"
+#include <Core/ImageData.h>
+#include <Core/MipGenerator.h>
+#include <Core/TextureCompressor.h>
+#include <Core/Dispatch/ThreadPool.h>
+#include <cmath>
+#include <iostream>
+#include <random>
+
+#if K3DPLATFORM_OS_WIN
+#pragma comment(linker,"/subsystem:console")
+#endif
+
+using namespace std;
+using namespace k3d;
+
+typedef TextureCompressor::EQuality EQuality;
+static const EQuality kQualities[] = { EQuality::Fast, EQuality::Normal, EQuality::High };
+static const char * kQualityNames[] = { "fast", "normal", "high" };
+
+/// smooth gradients with hard edged discs, some noise and a radial alpha
+shared_ptr<ImageData> MakeTestImage(EImageFormat format, uint32 width, uint32 height, uint32 seed)
+{
+	mt19937 random(seed);
+	uniform_int_distribution<int> noise(-6, 6);
+	auto image = make_shared<ImageData>();
+	K3D_ASSERT(image->Create(format, width, height, 1));
+	kByte * data = image->GetLevelData(0, 0);
+	for (uint32 y = 0; y < height; y++)
+	{
+		for (uint32 x = 0; x < width; x++)
+		{
+			float u = (float)x / width, v = (float)y / height;
+			float r = 128.0f + 100.0f * sinf(6.0f * u + 2.0f * v), g = 40.0f + 180.0f * v * v, b = 200.0f * u * (1.0f - v);
+			float dx = u - 0.3f, dy = v - 0.6f;
+			if (dx * dx + dy * dy < 0.04f)
+			{
+				r = 230.0f;
+				g = 40.0f;
+				b = 60.0f;
+			}
+			if (fabsf(u - 0.75f) < 0.1f && fabsf(v - 0.25f) < 0.15f)
+				r = g = b = 20.0f;
+			float a = 255.0f * max(0.0f, 1.0f - 1.6f * sqrtf((u - 0.5f) * (u - 0.5f) + (v - 0.5f) * (v - 0.5f)));
+			kByte * texel = data + ((size_t)y * width + x) * 4;
+			texel[0] = (kByte)min(max((int)r + noise(random), 0), 255);
+			texel[1] = (kByte)min(max((int)g + noise(random), 0), 255);
+			texel[2] = (kByte)min(max((int)b + noise(random), 0), 255);
+			texel[3] = (kByte)a;
+		}
+	}
+	return image;
+}
+
+/// PSNR of level 0 of two RGBA8 images over the channels of 'mask'
+double ComputePSNR(ImageData const& a, ImageData const& b, uint32 mask)
+{
+	const ImageLevel * la = a.GetLevelDesc(0, 0), * lb = b.GetLevelDesc(0, 0);
+	double error = 0.0, samples = 0.0;
+	for (uint64 i = 0; i < la->Size; i++)
+	{
+		if (!(mask & (1 << (i & 3))))
+			continue;
+		double d = (double)la->Data[i] - (double)lb->Data[i];
+		error += d * d;
+		samples++;
+	}
+	return error > 0.0 ? 10.0 * log10(255.0 * 255.0 * samples / error) : INFINITY;
+}
+
+void TestSolidBlocks()
+{
+	mt19937 random(5);
+	auto image = make_shared<ImageData>();
+	K3D_ASSERT(image->Create(EImageFormat::RGBA8_UNORM, 64, 64, 1));
+	kByte * data = image->GetLevelData(0, 0);
+	// every block one random color, the first row of blocks exact in 565
+	for (uint32 by = 0; by < 16; by++)
+	{
+		for (uint32 bx = 0; bx < 16; bx++)
+		{
+			uint32 color = random();
+			kByte rgba[4] = { (kByte)color, (kByte)(color >> 8), (kByte)(color >> 16), (kByte)(color >> 24) };
+			if (by == 0)
+			{
+				rgba[0] = (kByte)((rgba[0] & 0xF8) | (rgba[0] >> 5));
+				rgba[1] = (kByte)((rgba[1] & 0xFC) | (rgba[1] >> 6));
+				rgba[2] = (kByte)((rgba[2] & 0xF8) | (rgba[2] >> 5));
+			}
+			for (uint32 y = 0; y < 4; y++)
+			{
+				for (uint32 x = 0; x < 4; x++)
+					memcpy(data + ((by * 4 + y) * 64 + bx * 4 + x) * 4, rgba, 4);
+			}
+		}
+	}
+	for (uint32 q = 0; q < 3; q++)
+	{
+		TextureCompressor::Options options;
+		options.Quality = kQualities[q];
+		auto bc1 = TextureCompressor::Decompress(*TextureCompressor::Compress(*image, EImageFormat::BC1_UNORM, options));
+		auto bc4 = TextureCompressor::Decompress(*TextureCompressor::Compress(*image, EImageFormat::BC4_UNORM, options));
+		auto bc7 = TextureCompressor::Decompress(*TextureCompressor::Compress(*image, EImageFormat::BC7_UNORM, options));
+		const kByte * texels = (const kByte*)image->GetLevel(0, 0);
+		for (uint32 i = 0; i < 64 * 64; i++)
+		{
+			const kByte * source = texels + i * 4, * one = (const kByte*)bc1->GetLevel(0, 0) + i * 4;
+			const kByte * four = (const kByte*)bc4->GetLevel(0, 0) + i * 4, * seven = (const kByte*)bc7->GetLevel(0, 0) + i * 4;
+			if (i < 4 * 64)
+			{
+				K3D_ASSERT(memcmp(one, source, 3) == 0 && one[3] == 255);
+			}
+			K3D_ASSERT(four[0] == source[0] && four[1] == 0 && four[3] == 255);
+			for (uint32 c = 0; c < 4; c++)
+				K3D_ASSERT(abs((int)seven[c] - (int)source[c]) <= 1);
+		}
+	}
+}
+
+void TestQuality()
+{
+	auto image = MakeTestImage(EImageFormat::RGBA8_UNORM, 256, 256, 1);
+	struct Target
+	{
+		EImageFormat	Format;
+		const char *	Name;
+		uint32			Channels;
+		double			MinPSNR;
+	};
+	const Target targets[] =
+	{
+		{ EImageFormat::BC1_UNORM, "BC1", 7, 32.0 },
+		{ EImageFormat::BC3_UNORM, "BC3", 15, 33.0 },
+		{ EImageFormat::BC4_UNORM, "BC4", 1, 38.0 },
+		{ EImageFormat::BC5_UNORM, "BC5", 3, 38.0 },
+		{ EImageFormat::BC7_UNORM, "BC7", 15, 38.0 },
+	};
+	for (auto const& target : targets)
+	{
+		double previous = 0.0;
+		for (uint32 q = 0; q < 3; q++)
+		{
+			TextureCompressor::Options options;
+			options.Quality = kQualities[q];
+			TextureCompressor::Stats stats;
+			auto compressed = TextureCompressor::Compress(*image, target.Format, options, nullptr, &stats);
+			K3D_ASSERT(compressed && compressed->GetFormat() == target.Format && stats.Blocks == 64 * 64);
+			K3D_ASSERT(compressed->GetLevelDesc(0, 0)->Size == 64 * 64 * ImageData::GetFormatElementSize(target.Format));
+			auto decoded = TextureCompressor::Decompress(*compressed);
+			K3D_ASSERT(decoded->GetFormat() == EImageFormat::RGBA8_UNORM);
+			K3D_ASSERT(fabs(ComputePSNR(*image, *decoded, target.Channels) - stats.PSNR) < 0.01);
+			cout << target.Name << " " << kQualityNames[q] << ": " << stats.PSNR << " dB" << endl;
+			K3D_ASSERT(stats.PSNR > target.MinPSNR && stats.PSNR > previous - 0.05);
+			previous = stats.PSNR;
+		}
+	}
+
+	// alpha of BC1 is punched through below the threshold
+	TextureCompressor::Options options;
+	options.AlphaThreshold = 128;
+	auto bc1 = TextureCompressor::Decompress(*TextureCompressor::Compress(*image, EImageFormat::BC1_UNORM, options));
+	const kByte * source = (const kByte*)image->GetLevel(0, 0), * decoded = (const kByte*)bc1->GetLevel(0, 0);
+	uint32 transparent = 0;
+	for (uint32 i = 0; i < 256 * 256; i++)
+	{
+		K3D_ASSERT(decoded[i * 4 + 3] == (source[i * 4 + 3] < 128 ? 0 : 255));
+		transparent += source[i * 4 + 3] < 128;
+	}
+	K3D_ASSERT(transparent > 1000);
+
+	K3D_ASSERT(!TextureCompressor::Compress(*image, EImageFormat::BC6H_UFLOAT));
+	K3D_ASSERT(!TextureCompressor::Compress(*TextureCompressor::Compress(*image, EImageFormat::BC1_UNORM), EImageFormat::BC7_UNORM));
+	ImageData hdr;
+	K3D_ASSERT(hdr.Create(EImageFormat::RGBA16_FLOAT, 8, 8, 1));
+	K3D_ASSERT(!TextureCompressor::Compress(hdr, EImageFormat::BC7_UNORM));
+}
+
+/// mip chains of odd sizes, cube maps and BGRA sources through DDS and KTX2
+void TestContainers()
+{
+	auto image = MakeTestImage(EImageFormat::RGBA8_SRGB, 37, 21, 2);
+	auto mips = MipGenerator::Generate(*image);
+	K3D_ASSERT(mips && mips->GetMipLevs() == 6);
+	for (EImageFormat format : { EImageFormat::BC7_SRGB, EImageFormat::BC1_SRGB, EImageFormat::BC3_SRGB, EImageFormat::BC5_UNORM })
+	{
+		TextureCompressor::Stats stats;
+		auto compressed = TextureCompressor::Compress(*mips, format, TextureCompressor::Options(), nullptr, &stats);
+		K3D_ASSERT(compressed && compressed->GetMipLevs() == 6 && compressed->IsCompressed());
+		// 10x6 + 5x3 + 3x2 + 1 + 1 + 1 blocks
+		K3D_ASSERT(stats.Blocks == 60 + 15 + 6 + 1 + 1 + 1);
+		auto decoded = TextureCompressor::Decompress(*compressed);
+		K3D_ASSERT(decoded->GetMipLevs() == 6 && decoded->GetLevelDesc(5, 0)->Width == 1);
+		K3D_ASSERT(decoded->GetFormat() == (format == EImageFormat::BC5_UNORM ? EImageFormat::RGBA8_UNORM : EImageFormat::RGBA8_SRGB));
+		for (uint32 container = 0; container < 2; container++)
+		{
+			vector<kByte> file;
+			K3D_ASSERT(container ? compressed->WriteKTX2(file) : compressed->WriteDDS(file));
+			ImageData loaded;
+			K3D_ASSERT(loaded.Load(file.data(), (uint32)file.size()));
+			K3D_ASSERT(loaded.GetFormat() == format && loaded.GetWidth() == 37 && loaded.GetHeight() == 21);
+			K3D_ASSERT(loaded.GetMipLevs() == 6 && loaded.GetLayers() == 1 && !loaded.IsCubeMap());
+			for (uint32 level = 0; level < 6; level++)
+			{
+				const ImageLevel * a = loaded.GetLevelDesc(level, 0), * b = compressed->GetLevelDesc(level, 0);
+				K3D_ASSERT(a->Size == b->Size && memcmp(a->Data, b->Data, (size_t)a->Size) == 0);
+			}
+		}
+	}
+
+	// cube faces of a BGRA source
+	auto cube = make_shared<ImageData>();
+	K3D_ASSERT(cube->Create(EImageFormat::BGRA8_UNORM, 16, 16, 1, 6, true));
+	for (uint32 face = 0; face < 6; face++)
+	{
+		kByte * data = cube->GetLevelData(0, face);
+		for (uint32 i = 0; i < 16 * 16; i++)
+		{
+			data[i * 4 + 0] = (kByte)(face * 40);
+			data[i * 4 + 1] = (kByte)(i % 16 * 16);
+			data[i * 4 + 2] = 200;
+			data[i * 4 + 3] = 255;
+		}
+	}
+	auto compressed = TextureCompressor::Compress(*cube, EImageFormat::BC1_UNORM);
+	K3D_ASSERT(compressed->IsCubeMap() && compressed->GetLayers() == 6);
+	auto decoded = TextureCompressor::Decompress(*compressed);
+	for (uint32 face = 0; face < 6; face++)
+	{
+		// red comes from the third byte of BGRA
+		const kByte * texel = (const kByte*)decoded->GetLevel(0, face);
+		K3D_ASSERT(abs((int)texel[0] - 200) <= 4 && abs((int)texel[2] - (int)(face * 40)) <= 4);
+	}
+	for (uint32 container = 0; container < 2; container++)
+	{
+		vector<kByte> file;
+		K3D_ASSERT(container ? compressed->WriteKTX2(file) : compressed->WriteDDS(file));
+		ImageData loaded;
+		K3D_ASSERT(loaded.Load(file.data(), (uint32)file.size()) && loaded.IsCubeMap() && loaded.GetLayers() == 6);
+		for (uint32 face = 0; face < 6; face++)
+			K3D_ASSERT(memcmp(loaded.GetLevel(0, face), compressed->GetLevel(0, face), 16 * 8) == 0);
+	}
+
+	// uncompressed images have containers too
+	vector<kByte> file;
+	K3D_ASSERT(mips->WriteKTX2(file) && mips->WriteDDS(file));
+	ImageData loaded;
+	K3D_ASSERT(loaded.Load(file.data(), (uint32)file.size()) && loaded.GetFormat() == EImageFormat::RGBA8_SRGB);
+	K3D_ASSERT(memcmp(loaded.GetLevel(3, 0), mips->GetLevel(3, 0), (size_t)mips->GetLevelDesc(3, 0)->Size) == 0);
+}
+
+void TestThroughput(uint32 size)
+{
+	auto image = MakeTestImage(EImageFormat::RGBA8_UNORM, size, size, 3);
+	Dispatch::ThreadPool one(1), workers(4);
+	double megapixels = (double)size * size / 1e6;
+	for (EImageFormat format : { EImageFormat::BC1_UNORM, EImageFormat::BC3_UNORM, EImageFormat::BC5_UNORM, EImageFormat::BC7_UNORM })
+	{
+		for (uint32 q = 0; q < 3; q++)
+		{
+			TextureCompressor::Options options;
+			options.Quality = kQualities[q];
+			options.Scalar = true;
+			TextureCompressor::Stats scalar, simd, parallel;
+			TextureCompressor::Compress(*image, format, options, &one, &scalar);
+			options.Scalar = false;
+			TextureCompressor::Compress(*image, format, options, &one, &simd);
+			TextureCompressor::Compress(*image, format, options, &workers, &parallel);
+			// the kernels may break ties differently
+			K3D_ASSERT(fabs(scalar.PSNR - simd.PSNR) < 0.05 && simd.PSNR == parallel.PSNR);
+			cout << "BC" << (format == EImageFormat::BC1_UNORM ? 1 : format == EImageFormat::BC3_UNORM ? 3 : format == EImageFormat::BC5_UNORM ? 5 : 7)
+				<< " " << kQualityNames[q] << " " << size << "^2: " << simd.PSNR << " dB, scalar " << megapixels / scalar.Milliseconds * 1000.0
+				<< " MPix/s, " << TextureCompressor::GetKernel() << " " << megapixels / simd.Milliseconds * 1000.0
+				<< " MPix/s, 4 threads " << megapixels / parallel.Milliseconds * 1000.0 << " MPix/s" << endl;
+		}
+	}
+}
+
+int main(int argc, char**argv)
+{
+	TestSolidBlocks();
+	TestQuality();
+	TestContainers();
+	TestThroughput(argc > 1 ? (uint32)atoi(argv[1]) : 1024);
+	return 0;
+}
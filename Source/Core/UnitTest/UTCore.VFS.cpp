@@ -0,0 +1,152 @@
+#include "Common.h"
+#include <Core/AssetManager.h>
+#include <Core/Bundle.h>
+#include <Core/VirtualFileSystem.h>
+#include <chrono>
+#include <iostream>
+
+#if K3DPLATFORM_OS_WIN
+#pragma comment(linker,"/subsystem:console")
+#endif
+
+using namespace std;
+using namespace k3d;
+
+static const uint32 kNumRoots = 8;
+static const uint32 kNumFiles = 64;
+
+kString ToKString(string const& str)
+{
+	return kString(str.begin(), str.end());
+}
+
+void WriteFile(string const& path, string const& content)
+{
+	Os::File file;
+	K3D_ASSERT(file.Open(ToKString(path).c_str(), IOWrite));
+	file.Write(content.data(), content.size());
+	file.Close();
+}
+
+/// bundle v1 with one chunk per name, the chunk data is the name
+void WriteBundle(string const& path, vector<string> const& names)
+{
+	Os::File file;
+	K3D_ASSERT(file.Open(ToKString(path).c_str(), IOWrite));
+	Archive arch;
+	arch.SetIODevice(&file);
+	arch << EAssetVersion::E20161210u;
+	arch << (uint64)(names.size() * sizeof(AssetChunk));
+	for (auto & name : names)
+	{
+		AssetChunk chunk;
+		memset(&chunk, 0, sizeof(chunk));
+		chunk.Type = EAssetType::EShaderSource;
+		chunk.Size = name.size();
+		strncpy(chunk.Name, name.c_str(), sizeof(chunk.Name));
+		arch << chunk;
+	}
+	for (auto & name : names)
+	{
+		arch << EAssetType::EShaderSource;
+		arch.ArrayIn(name.data(), name.size());
+		arch << EAssetType::EChunkEnd;
+	}
+	file.Close();
+}
+
+string ReadAll(IAsset * asset)
+{
+	K3D_ASSERT(asset != nullptr);
+	string content((size_t)asset->GetLength(), '\0');
+	asset->Read(&content[0], content.size());
+	delete asset;
+	return content;
+}
+
+void TestVFS()
+{
+	VirtualFileSystem vfs;
+	for (uint32 r = 0; r < kNumRoots; r++)
+	{
+		string root = "./TestVFS_" + to_string(r);
+		Os::MakeDir(ToKString(root).c_str());
+		vfs.Mount(KT(""), make_shared<DirectoryMount>(ToKString(root)));
+	}
+	// files live in the last root only, so uncached lookups probe every root
+	string lastRoot = "./TestVFS_" + to_string(kNumRoots - 1) + "/";
+	for (uint32 i = 0; i < kNumFiles; i++)
+		WriteFile(lastRoot + "file" + to_string(i) + ".txt", "disk" + to_string(i));
+	WriteBundle("./TestVFS.bundle", { "shaders/a.glsl", "shaders/b.glsl" });
+
+	auto bundle = make_shared<BundleMount>(KT("./TestVFS.bundle"));
+	K3D_ASSERT(bundle->IsValid() && bundle->GetNumChunks() == 2);
+	vfs.Mount(KT("asset"), bundle);
+	K3D_ASSERT(ReadAll(vfs.Open(KT("asset://shaders/b.glsl"))) == "shaders/b.glsl");
+	K3D_ASSERT(ReadAll(vfs.Open(KT("file3.txt"))) == "disk3");
+
+	AssetBundleWriter writer;
+	K3D_ASSERT(writer.Open(KT("./TestVFS2.bundle")));
+	writer.AddChunk("shaders/c.glsl", EAssetType::EShaderSource, "indexed", 7);
+	K3D_ASSERT(writer.Finish());
+	auto indexed = make_shared<BundleMount>(KT("./TestVFS2.bundle"));
+	K3D_ASSERT(indexed->IsValid() && indexed->GetNumChunks() == 1);
+	vfs.Mount(KT("pak"), indexed);
+	K3D_ASSERT(ReadAll(vfs.Open(KT("pak://shaders/c.glsl"))) == "indexed");
+
+	// the overlay shadows the disk
+	auto overlay = make_shared<MemoryMount>();
+	vfs.Mount(KT(""), overlay, 1);
+	string patched = "patched";
+	overlay->Add(KT("file3.txt"), make_shared<vector<kByte>>(patched.begin(), patched.end()));
+	K3D_ASSERT(ReadAll(vfs.Open(KT(".//file3.txt"))) == "patched");
+	overlay->Remove(KT("file3.txt"));
+	K3D_ASSERT(ReadAll(vfs.Open(KT("file3.txt"))) == "disk3");
+
+	K3D_ASSERT(!vfs.Exists(KT("missing.txt")));
+	auto before = vfs.GetStats();
+	K3D_ASSERT(!vfs.Exists(KT("missing.txt")));
+	auto after = vfs.GetStats();
+	K3D_ASSERT(after.NumNegativeHits == before.NumNegativeHits + 1);
+	K3D_ASSERT(after.NumMountProbes == before.NumMountProbes);
+
+	const uint32 kNumLookups = 1024 * 100;
+	vector<kString> paths;
+	for (uint32 i = 0; i < kNumFiles; i++)
+		paths.push_back(ToKString("file" + to_string(i) + ".txt"));
+	for (uint32 i = 0; i < kNumFiles; i++)
+		paths.push_back(ToKString("missing" + to_string(i) + ".txt"));
+
+	auto start = chrono::high_resolution_clock::now();
+	const uint32 numUncached = 2000;
+	for (uint32 i = 0; i < numUncached; i++)
+	{
+		vfs.InvalidateCache();
+		vfs.Exists(paths[i % paths.size()].c_str());
+	}
+	double uncached = chrono::duration<double, micro>(chrono::high_resolution_clock::now() - start).count() / numUncached;
+
+	start = chrono::high_resolution_clock::now();
+	uint32 numFound = 0;
+	for (uint32 i = 0; i < kNumLookups; i++)
+		numFound += vfs.Exists(paths[i % paths.size()].c_str()) ? 1 : 0;
+	double cached = chrono::duration<double, micro>(chrono::high_resolution_clock::now() - start).count() / kNumLookups;
+	K3D_ASSERT(numFound == kNumLookups / 2);
+
+	cout << "resolve across " << kNumRoots << " roots: uncached " << uncached << " us, cached "
+		<< cached << " us per lookup" << endl;
+
+	vfs.UnmountAll();
+	for (uint32 i = 0; i < kNumFiles; i++)
+		Os::Remove(ToKString(lastRoot + "file" + to_string(i) + ".txt").c_str());
+	for (uint32 r = 0; r < kNumRoots; r++)
+		Os::Remove(ToKString("./TestVFS_" + to_string(r)).c_str());
+	Os::Remove(KT("./TestVFS.bundle"));
+	Os::Remove(KT("./TestVFS2.bundle"));
+}
+
+int main(int argc, char**argv)
+{
+	TestVFS();
+	return 0;
+}
@@ -0,0 +1,307 @@
+#include "Common.h"
+#include <Core/Bundle.h>
+#include <Core/MeshData.h>
+#include <Core/MeshOptimizer.h>
+#include <Core/Meshlet.h>
+#include <Core/VertexCodec.h>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+
+#if K3DPLATFORM_OS_WIN
+#pragma comment(linker,"/subsystem:console")
+#endif
+
+using namespace std;
+using namespace k3d;
+
+static const uint32 kRings = 255;
+static const uint32 kSegments = 511;
+
+/// a bumpy sphere with every float attribute, repacked into 'format'
+shared_ptr<MeshData> MakeMesh(VtxFormat format)
+{
+	vector<Vertex3F3F2F> full;
+	for (uint32 j = 0; j <= kRings; j++)
+	{
+		float theta = j * 3.1415926f / kRings;
+		for (uint32 i = 0; i <= kSegments; i++)
+		{
+			float phi = i * 6.2831853f / kSegments;
+			float nx = sinf(theta) * cosf(phi), ny = cosf(theta), nz = sinf(theta) * sinf(phi);
+			float r = 25.0f + 0.5f * sinf(phi * 7.0f) * sinf(theta * 5.0f);
+			full.push_back({ 3.0f + nx * r, -12.0f + ny * r * 0.5f, nz * r, nx, ny, nz, i * 4.0f / kSegments, j * 2.0f / kRings });
+		}
+	}
+	vector<uint32> indices;
+	for (uint32 j = 0; j < kRings; j++)
+	{
+		for (uint32 i = 0; i < kSegments; i++)
+		{
+			uint32 v00 = j * (kSegments + 1) + i, v10 = v00 + 1;
+			uint32 v01 = v00 + kSegments + 1, v11 = v01 + 1;
+			indices.insert(indices.end(), { v00, v10, v01, v10, v11, v01 });
+		}
+	}
+	vector<float> vertices;
+	for (auto const& v : full)
+	{
+		vertices.insert(vertices.end(), { v.PosX, v.PosY, v.PosZ });
+		if (format == VtxFormat::POS3_F32_NOR3_F32 || format == VtxFormat::POS3_F32_NOR3_F32_UV2_F32)
+			vertices.insert(vertices.end(), { v.NorX, v.NorY, v.NorZ });
+		if (format == VtxFormat::POS3_F32_UV2_F32 || format == VtxFormat::POS3_F32_NOR3_F32_UV2_F32)
+			vertices.insert(vertices.end(), { v.U, v.V });
+	}
+	auto mesh = make_shared<MeshData>();
+	mesh->SetMeshName(MeshData::VtxFormatToString(format).c_str());
+	mesh->SetVertexFormat(format);
+	mesh->SetVertexNum((int)full.size());
+	mesh->SetVertexBuffer(vertices.data());
+	mesh->SetIndexBuffer(indices);
+	return mesh;
+}
+
+/// the decoded vertex from the public per attribute codecs
+void ReferenceDecode(MeshData const& mesh, uint32 v, float * dst)
+{
+	VtxFormat format = mesh.GetVertexFormat();
+	const kByte * src = (const kByte*)mesh.GetVertexBuffer() + (size_t)v * MeshData::GetVertexStride(format);
+	kMath::AABB box = mesh.GetBoundingBox();
+	kMath::Vec3f lo = box.GetMinCorner(), hi = box.GetMaxCorner();
+	uint16 q[3];
+	memcpy(q, src, sizeof(q));
+	for (uint32 k = 0; k < 3; k++)
+		*dst++ = q[k] * ((hi[k] - lo[k]) / 65535.0f) + lo[k];
+	if (format == VtxFormat::POS3_U16_NOR_OCT8 || format == VtxFormat::POS3_U16_NOR_OCT8_UV2_F16)
+	{
+		VertexCodec::DecodeOctahedral((const int8*)src + 6, dst);
+		dst += 3;
+	}
+	if (format == VtxFormat::POS3_U16_UV2_F16 || format == VtxFormat::POS3_U16_NOR_OCT8_UV2_F16)
+	{
+		uint16 uv[2];
+		memcpy(uv, src + 8, sizeof(uv));
+		dst[0] = VertexCodec::HalfToFloat(uv[0]);
+		dst[1] = VertexCodec::HalfToFloat(uv[1]);
+	}
+}
+
+void TestHalf()
+{
+	for (uint32 h = 0; h < 0x10000; h++)
+	{
+		float value = VertexCodec::HalfToFloat((uint16)h);
+		if ((h & 0x7c00) == 0x7c00 && (h & 0x3ff))
+		{
+			K3D_ASSERT(value != value);
+		}
+		else
+		{
+			K3D_ASSERT(VertexCodec::FloatToHalf(value) == h);
+		}
+	}
+	K3D_ASSERT(VertexCodec::HalfToFloat(0x0001) == ldexpf(1.0f, -24));
+	K3D_ASSERT(VertexCodec::FloatToHalf(65504.0f) == 0x7bff);
+	K3D_ASSERT(VertexCodec::FloatToHalf(65520.0f) == 0x7c00);
+	K3D_ASSERT(VertexCodec::FloatToHalf(-1e30f) == 0xfc00);
+	K3D_ASSERT(VertexCodec::FloatToHalf(1e-9f) == 0);
+	K3D_ASSERT(VertexCodec::FloatToHalf(-0.0f) == 0x8000);
+	// ties round to even
+	K3D_ASSERT(VertexCodec::FloatToHalf(1.0f + ldexpf(1.0f, -11)) == 0x3c00);
+	K3D_ASSERT(VertexCodec::FloatToHalf(1.0f + 3 * ldexpf(1.0f, -11)) == 0x3c02);
+	K3D_ASSERT((VertexCodec::FloatToHalf(NAN) & 0x7fff) > 0x7c00);
+}
+
+void TestOctahedral()
+{
+	mt19937 random(39);
+	normal_distribution<float> gauss;
+	const uint32 count = 100003;
+	vector<float> vectors(count * 3), decoded(count * 3);
+	vector<int8> oct(count * 2);
+	float maxError = 0.0f;
+	for (uint32 i = 0; i < count; i++)
+	{
+		float * n = &vectors[i * 3];
+		n[0] = gauss(random); n[1] = gauss(random); n[2] = gauss(random);
+		// the axes and octant borders are the corner cases
+		if (i < 6)
+		{
+			n[0] = n[1] = n[2] = 0.0f;
+			n[i / 2] = i & 1 ? -1.0f : 1.0f;
+		}
+		float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		n[0] /= length; n[1] /= length; n[2] /= length;
+		VertexCodec::EncodeOctahedral(n, &oct[i * 2]);
+		float d[3];
+		VertexCodec::DecodeOctahedral(&oct[i * 2], d);
+		float match = min(n[0] * d[0] + n[1] * d[1] + n[2] * d[2], 1.0f);
+		maxError = max(maxError, acosf(match) * 57.2957795f);
+	}
+	K3D_ASSERT(maxError < 1.0f);
+
+	// the stream decoder agrees with the scalar one
+	VertexCodec::DecodeOctahedral(decoded.data(), sizeof(float) * 3, oct.data(), 2, count);
+	for (uint32 i = 0; i < count; i++)
+	{
+		float d[3];
+		VertexCodec::DecodeOctahedral(&oct[i * 2], d);
+		K3D_ASSERT(fabsf(d[0] - decoded[i * 3]) < 1e-6f && fabsf(d[1] - decoded[i * 3 + 1]) < 1e-6f
+			&& fabsf(d[2] - decoded[i * 3 + 2]) < 1e-6f);
+	}
+	cout << "octahedral snorm8: max error " << maxError << " deg over " << count << " vectors" << endl;
+}
+
+void TestWeights()
+{
+	mt19937 random(4);
+	uniform_real_distribution<float> uniform(0.0f, 1.0f);
+	const uint32 count = 10000;
+	vector<uint8> packed(count * 4);
+	float maxError = 0.0f;
+	for (uint32 i = 0; i < count; i++)
+	{
+		float w[4] = { uniform(random), uniform(random), uniform(random), uniform(random) };
+		// single influences and zeros are the common ones
+		if (i % 3 == 0)
+			w[1] = w[2] = w[3] = 0.0f;
+		float sum = w[0] + w[1] + w[2] + w[3];
+		uint8 * p = &packed[i * 4];
+		VertexCodec::EncodeWeights(w, p);
+		K3D_ASSERT(p[0] + p[1] + p[2] + p[3] == 255);
+		for (uint32 k = 0; k < 4; k++)
+			maxError = max(maxError, fabsf(p[k] / 255.0f - w[k] / sum));
+	}
+	K3D_ASSERT(maxError <= 1.5f / 255.0f);
+	vector<float> decoded(count * 4);
+	VertexCodec::DecodeWeights(decoded.data(), packed.data(), 4, count);
+	for (uint32 i = 0; i < count * 4; i++)
+	{
+		K3D_ASSERT(fabsf(decoded[i] - packed[i] / 255.0f) < 1e-7f);
+	}
+	float none[4] = {};
+	uint8 p[4];
+	VertexCodec::EncodeWeights(none, p);
+	K3D_ASSERT(p[0] == 0 && p[1] == 0 && p[2] == 0 && p[3] == 0);
+}
+
+void TestQuantize(VtxFormat format)
+{
+	auto mesh = MakeMesh(format);
+	uint32 count = (uint32)mesh->GetVertexNum();
+	uint32 floats = MeshData::GetVertexStride(format) / sizeof(float);
+
+	VertexCodec::Stats stats;
+	K3D_ASSERT(VertexCodec::Quantize(*mesh, &stats));
+	VtxFormat packed = VertexCodec::GetQuantizedFormat(format);
+	K3D_ASSERT(mesh->GetVertexFormat() == packed && MeshData::IsQuantized(packed) && !MeshData::IsQuantized(format));
+	K3D_ASSERT(VertexCodec::GetFloatFormat(packed) == format);
+	K3D_ASSERT(stats.FloatBytes == MeshData::GetVertexByteWidth(format, count));
+	K3D_ASSERT(stats.QuantizedBytes == MeshData::GetVertexByteWidth(packed, count));
+	// already quantized
+	K3D_ASSERT(!VertexCodec::Quantize(*mesh));
+
+	kMath::AABB box = mesh->GetBoundingBox();
+	kMath::Vec3f extent = box.GetMaxCorner() - box.GetMinCorner();
+	float positionBound = max(max(extent[0], extent[1]), extent[2]) / 131070.0f + 1e-5f;
+	K3D_ASSERT(stats.MaxPositionError <= positionBound);
+	K3D_ASSERT(stats.MaxNormalError < 1.0f);
+	// the uvs are below 4, where halfs are 2^-9 apart
+	K3D_ASSERT(stats.MaxUVError <= 1.0f / 1024.0f);
+
+	vector<float> decoded(count * floats);
+	K3D_ASSERT(VertexCodec::Decode(*mesh, decoded.data()));
+	for (uint32 v = 0; v < count; v++)
+	{
+		float reference[8];
+		ReferenceDecode(*mesh, v, reference);
+		for (uint32 k = 0; k < floats; k++)
+		{
+			K3D_ASSERT(fabsf(reference[k] - decoded[v * floats + k]) <= 1e-5f * max(1.0f, fabsf(reference[k])));
+		}
+	}
+
+	const uint32 rounds = 20;
+	auto start = chrono::high_resolution_clock::now();
+	for (uint32 r = 0; r < rounds; r++)
+		VertexCodec::Decode(*mesh, decoded.data());
+	double simd = chrono::duration<double>(chrono::high_resolution_clock::now() - start).count() / rounds;
+	start = chrono::high_resolution_clock::now();
+	for (uint32 r = 0; r < rounds; r++)
+	{
+		for (uint32 v = 0; v < count; v++)
+			ReferenceDecode(*mesh, v, &decoded[v * floats]);
+	}
+	double scalar = chrono::duration<double>(chrono::high_resolution_clock::now() - start).count() / rounds;
+	cout << MeshData::VtxFormatToString(format) << " -> " << MeshData::VtxFormatToString(packed) << ": "
+		<< stats.FloatBytes << " -> " << stats.QuantizedBytes << " bytes ("
+		<< 100.0 * stats.QuantizedBytes / stats.FloatBytes << "%), error " << stats.MaxPositionError
+		<< " (bound " << positionBound << "), " << stats.MaxNormalError << " deg, uv " << stats.MaxUVError
+		<< ", decode " << VertexCodec::GetDecodeKernel() << " " << stats.FloatBytes / simd / 1e6
+		<< " MB/s, per vertex " << stats.FloatBytes / scalar / 1e6 << " MB/s" << endl;
+
+	// the packed positions are no floats
+	K3D_ASSERT(MeshOptimizer::Optimize(*mesh));
+	MeshletData meshlets;
+	K3D_ASSERT(!meshlets.Build(*mesh));
+
+	vector<float> before(count * floats);
+	K3D_ASSERT(VertexCodec::Decode(*mesh, before.data()));
+	K3D_ASSERT(VertexCodec::Dequantize(*mesh));
+	K3D_ASSERT(mesh->GetVertexFormat() == format && (uint32)mesh->GetVertexNum() == count);
+	K3D_ASSERT(memcmp(mesh->GetVertexBuffer(), before.data(), before.size() * sizeof(float)) == 0);
+	K3D_ASSERT(!VertexCodec::Dequantize(*mesh) && !VertexCodec::Decode(*mesh, before.data()));
+}
+
+void TestQuantizedBundle()
+{
+	auto mesh = MakeMesh(VtxFormat::POS3_F32_NOR3_F32_UV2_F32);
+	K3D_ASSERT(VertexCodec::Quantize(*mesh));
+	{
+		AssetBundleWriter writer;
+		K3D_ASSERT(writer.Open(KT("./TestVertexCodec.bundle")));
+		writer.AddChunk(mesh->Name(), EAssetType::EMesh, [&mesh](Archive & archive)
+		{
+			archive << EMeshVersion::VERSION_1_1;
+			archive << *mesh;
+		});
+		K3D_ASSERT(writer.Finish());
+	}
+	AssetBundleReader reader;
+	K3D_ASSERT(reader.Open(KT("./TestVertexCodec.bundle")));
+	auto loaded = MeshData::CreateFromChunk(reader.Find(mesh->Name()), reader.GetFile());
+	K3D_ASSERT(loaded && loaded->GetVertexFormat() == VtxFormat::POS3_U16_NOR_OCT8_UV2_F16);
+	K3D_ASSERT(loaded->GetVertexNum() == mesh->GetVertexNum() && loaded->GetIndexNum() == mesh->GetIndexNum());
+	size_t bytes = MeshData::GetVertexByteWidth(loaded->GetVertexFormat(), loaded->GetVertexNum());
+	K3D_ASSERT(memcmp(loaded->GetVertexBuffer(), mesh->GetVertexBuffer(), bytes) == 0);
+	kMath::Vec3f lo = loaded->GetBoundingBox().GetMinCorner(), expectedLo = mesh->GetBoundingBox().GetMinCorner();
+	K3D_ASSERT(lo[0] == expectedLo[0] && lo[1] == expectedLo[1] && lo[2] == expectedLo[2]);
+
+	// dequantizing a view leaves the mapping alone
+	vector<float> expected(MeshData::GetVertexByteWidth(VtxFormat::POS3_F32_NOR3_F32_UV2_F32, loaded->GetVertexNum()) / sizeof(float));
+	K3D_ASSERT(VertexCodec::Decode(*loaded, expected.data()));
+	K3D_ASSERT(VertexCodec::Dequantize(*loaded));
+	K3D_ASSERT(memcmp(loaded->GetVertexBuffer(), expected.data(), expected.size() * sizeof(float)) == 0);
+	loaded.reset();
+	reader.Close();
+	Os::Remove(KT("./TestVertexCodec.bundle"));
+}
+
+int main(int argc, char**argv)
+{
+	TestHalf();
+	TestOctahedral();
+	TestWeights();
+	TestQuantize(VtxFormat::POS3_F32);
+	TestQuantize(VtxFormat::POS3_F32_UV2_F32);
+	TestQuantize(VtxFormat::POS3_F32_NOR3_F32);
+	TestQuantize(VtxFormat::POS3_F32_NOR3_F32_UV2_F32);
+	TestQuantizedBundle();
+
+	// the float formats only
+	MeshData points;
+	K3D_ASSERT(!VertexCodec::Quantize(points));
+	K3D_ASSERT(VertexCodec::GetQuantizedFormat(VtxFormat::POS4_F32) == VtxFormat::PER_INSTANCE);
+	return 0;
+}
@@ -1,4 +1,11 @@
 #include "Common.h"
+#include <Core/AssetCache.h>
+#include <Core/Dispatch/ThreadPool.h>
+#include <Renderer/DistanceField.h>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
 
 #if K3DPLATFORM_OS_WIN
 #pragma comment(linker,"/subsystem:console")
@@ -17,8 +24,350 @@ void TestFontManager()
 	quads.Count();
 }
 
+bool Overlaps(GlyphAtlas::Glyph const& a, GlyphAtlas::Glyph const& b)
+{
+	// glyphs own a one texel gutter on the right and bottom
+	return a.Page == b.Page && a.U < b.U + b.W + 1 && b.U < a.U + a.W + 1
+		&& a.V < b.V + b.H + 1 && b.V < a.V + a.H + 1;
+}
+
+void TestGlyphAtlas()
+{
+	const int size = 64;
+	GlyphAtlas atlas(size, 2);
+	mt19937 rng(7);
+	vector<uint8> coverage(32 * 32);
+	vector<GlyphKey> keys;
+	vector<GlyphAtlas::Glyph> glyphs;
+	// fill both pages
+	for (uint32 cp = 0; ; cp++)
+	{
+		GlyphKey key = { 1, 16, cp };
+		GlyphAtlas::Glyph glyph = { 0, 0, 3 + (int)(rng() % 12), 3 + (int)(rng() % 12), 8, -1, 0, 0 };
+		for (int i = 0; i < glyph.W * glyph.H; i++)
+			coverage[i] = (uint8)(cp * 31 + i);
+		K3D_ASSERT(!atlas.Find(key));
+		auto inserted = atlas.Insert(key, glyph, coverage.data(), glyph.W);
+		if (!inserted)
+			break;
+		K3D_ASSERT(inserted->Page >= 0 && inserted->U + inserted->W < size && inserted->V + inserted->H < size);
+		keys.push_back(key);
+		glyphs.push_back(*inserted);
+	}
+	auto stats = atlas.GetStats();
+	K3D_ASSERT(atlas.GetNumPages() == 2 && stats.PageAllocations == 2 && stats.Evictions == 0);
+	for (size_t i = 0; i < glyphs.size(); i++)
+	{
+		for (size_t j = i + 1; j < glyphs.size(); j++)
+		{
+			K3D_ASSERT(!Overlaps(glyphs[i], glyphs[j]));
+		}
+		const uint8* page = atlas.GetPageData(glyphs[i].Page);
+		for (int y = 0; y < glyphs[i].H; y++)
+			for (int x = 0; x < glyphs[i].W; x++)
+			{
+				K3D_ASSERT(page[(glyphs[i].V + y) * size + glyphs[i].U + x] == (uint8)(keys[i].CodePoint * 31 + y * glyphs[i].W + x));
+			}
+	}
+
+	// blank glyphs take no space
+	GlyphKey space = { 2, 16, ' ' };
+	GlyphAtlas::Glyph blank = { 0, 0, 0, 0, 4, -1, 0, 0 };
+	K3D_ASSERT(atlas.Insert(space, blank, nullptr, 0)->Page == -1);
+
+	// the page of the glyphs drawn this frame stays, the other one goes
+	atlas.BeginFrame();
+	for (size_t i = 0; i < keys.size(); i++)
+	{
+		if (glyphs[i].Page == 1)
+		{
+			K3D_ASSERT(atlas.Find(keys[i]));
+		}
+	}
+	for (int page = 0; page < 2; page++)
+		atlas.ClearDirty(page);
+	GlyphKey big = { 2, 32, 'A' };
+	GlyphAtlas::Glyph glyph = { 0, 0, 20, 20, 24, -1, 0, 0 };
+	auto inserted = atlas.Insert(big, glyph, coverage.data(), 20);
+	K3D_ASSERT(inserted && inserted->Page == 0 && atlas.GetStats().Evictions == 1);
+	for (size_t i = 0; i < keys.size(); i++)
+	{
+		K3D_ASSERT((atlas.Find(keys[i]) != nullptr) == (glyphs[i].Page == 1));
+	}
+	K3D_ASSERT(atlas.Find(space));
+	GlyphAtlas::Rect dirty;
+	K3D_ASSERT(atlas.GetDirtyRect(0, dirty) && !atlas.GetDirtyRect(1, dirty));
+
+	// only the new glyph is uploaded after that
+	atlas.ClearDirty(0);
+	GlyphKey small = { 2, 32, 'B' };
+	glyph.W = glyph.H = 5;
+	inserted = atlas.Insert(small, glyph, coverage.data(), 5);
+	K3D_ASSERT(inserted && inserted->Page == 0 && atlas.GetDirtyRect(0, dirty));
+	K3D_ASSERT(dirty.X == inserted->U && dirty.Y == inserted->V && dirty.W == 6 && dirty.H == 6);
+
+	// nothing is evicted while both pages are in use
+	for (size_t i = 0; i < keys.size(); i++)
+		atlas.Find(keys[i]);
+	glyph.W = glyph.H = 60;
+	GlyphKey huge = { 3, 64, 'C' };
+	K3D_ASSERT(!atlas.Insert(huge, glyph, coverage.data(), 60) && atlas.GetStats().Evictions == 1);
+	glyph.W = 64;
+	atlas.BeginFrame();
+	K3D_ASSERT(!atlas.Insert(huge, glyph, coverage.data(), 64));
+}
+
+/// a frame of 'numStrings' labels, mostly the same text with changing numbers
+void TestTextFrames(int numStrings)
+{
+	FontManager fm;
+	if (!fm.LoadLib("../../Data/Test/calibri.ttf"))
+	{
+		cout << "calibri.ttf not found, skipping the text frames" << endl;
+		return;
+	}
+	fm.ChangeFontSize(24);
+	const char* words[] = { "Health", "Ammo", "Score", "Player", "Frame", "Distance", "Objective", "Speed" };
+	mt19937 rng(1);
+	vector<k3d::String> strings;
+	uint64 chars = 0;
+	for (int i = 0; i < numStrings; i++)
+	{
+		char text[64];
+		snprintf(text, sizeof(text), "%s %s: %u", words[rng() % 8], words[rng() % 8], (uint32)(rng() % 100000));
+		strings.push_back(text);
+		chars += strings.back().Length();
+	}
+
+	TextQuads quads;
+	for (int frame = 0; frame < 8; frame++)
+	{
+		fm.BeginFrame();
+		fm.GetAtlas().ResetStats();
+		auto start = chrono::high_resolution_clock::now();
+		uint64 numQuads = 0;
+		for (auto const& text : strings)
+		{
+			fm.AcquireText(text, quads);
+			numQuads += quads.Count();
+		}
+		double ms = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+		auto const& stats = fm.GetAtlas().GetStats();
+		K3D_ASSERT(numQuads == chars && stats.Hits + stats.Misses == chars);
+		if (frame > 0)
+		{
+			K3D_ASSERT(stats.Misses == 0 && stats.PageAllocations == 0 && stats.Evictions == 0);
+		}
+		if (frame < 2 || frame == 7)
+		{
+			cout << "frame " << frame << ": " << numStrings << " strings, " << chars << " glyphs, "
+				<< stats.Misses << " rasterized (" << chars << " uncached), " << stats.PageAllocations
+				<< " page allocations (" << chars << " uncached), " << ms << " ms" << endl;
+		}
+	}
+}
+
+/// debug HUD: static labels and a few values changing every frame
+void MakeHUD(int frame, int numLines, vector<k3d::String>& lines)
+{
+	const char* labels[] = { "Draw calls", "Triangles", "GPU time", "CPU time", "Visible meshes", "Streaming", "Memory", "Camera" };
+	lines.clear();
+	for (int i = 0; i < numLines; i++)
+	{
+		char text[96];
+		if (i % 5 == 0)
+			snprintf(text, sizeof(text), "%s: %d.%02d ms", labels[i % 8], (frame * 7 + i) % 40, (frame * 13 + i) % 100);
+		else if (i % 25 == 1)
+			snprintf(text, sizeof(text), "%s #%d\n  position 12.5, -3.25, 100\n  state idle", labels[i % 8], i);
+		else
+			snprintf(text, sizeof(text), "%s #%d: %d", labels[i % 8], i, i * 37);
+		lines.push_back(text);
+	}
+}
+
+void TestTextBatcher(int numLines)
+{
+	FontManager cachedFonts, fonts;
+	if (!cachedFonts.LoadLib("../../Data/Test/calibri.ttf") || !fonts.LoadLib("../../Data/Test/calibri.ttf"))
+		return;
+	cachedFonts.ChangeFontSize(16);
+	fonts.ChangeFontSize(16);
+	TextBatcher::Options uncached;
+	uncached.CacheLayouts = false;
+	TextBatcher cached(cachedFonts), batcher(fonts, uncached);
+
+	// line breaks restart at the left end one line lower, both atlases get the glyphs in the same order
+	cached.Begin();
+	cached.AddText("AA\nA", 10, 20);
+	batcher.Begin();
+	batcher.AddText("AA\nA", 10, 20);
+	batcher.End();
+	K3D_ASSERT(batcher.GetNumInstances() == 3 && batcher.GetBatches().size() == 1);
+	vector<TextBatcher::Instance> lineBreak(3);
+	batcher.WriteInstances(lineBreak.data());
+	K3D_ASSERT(lineBreak[2].Rect[0] == lineBreak[0].Rect[0] && lineBreak[1].Rect[0] > lineBreak[0].Rect[0]);
+	K3D_ASSERT(lineBreak[2].Rect[1] == lineBreak[0].Rect[1] + fonts.GetLineHeight());
+
+	vector<k3d::String> lines;
+	vector<TextBatcher::Instance> a, b;
+	double cachedMs = 0, uncachedMs = 0;
+	uint64 glyphs = 0;
+	const int frames = 16;
+	for (int frame = 0; frame < frames; frame++)
+	{
+		MakeHUD(frame, numLines, lines);
+		cached.Begin();
+		batcher.Begin();
+		for (int i = 0; i < numLines; i++)
+		{
+			cached.AddText(lines[i], 8.0f, 16.0f + i * 18, 0xffff00ff);
+			batcher.AddText(lines[i], 8.0f, 16.0f + i * 18, 0xffff00ff);
+		}
+		cached.End();
+		batcher.End();
+		auto const& stats = cached.GetStats();
+		// the frame is drawn from the same instances, in one draw per page
+		K3D_ASSERT(stats.Instances == batcher.GetStats().Instances && stats.Batches == 1);
+		a.resize(stats.Instances);
+		b.resize(stats.Instances);
+		cached.WriteInstances(a.data());
+		batcher.WriteInstances(b.data());
+		K3D_ASSERT(memcmp(a.data(), b.data(), a.size() * sizeof(TextBatcher::Instance)) == 0);
+		if (frame > 0)
+		{
+			K3D_ASSERT(stats.LayoutMisses < stats.Strings / 4);
+		}
+		if (frame >= frames / 2)
+		{
+			cachedMs += stats.Milliseconds;
+			uncachedMs += batcher.GetStats().Milliseconds;
+			glyphs += stats.Instances;
+		}
+		if (frame == frames - 1)
+		{
+			cout << "HUD: " << numLines << " strings, " << stats.Instances << " glyphs, " << stats.Batches
+				<< " draws (" << stats.Instances << " with a texture per glyph), " << stats.LayoutHits
+				<< " cached layouts" << endl;
+		}
+	}
+	cout << "layout " << cachedMs / (frames / 2) << " ms per frame cached, " << uncachedMs / (frames / 2)
+		<< " ms uncached, " << glyphs / (frames / 2) << " glyphs" << endl;
+}
+
+/// mean absolute difference of the reference sampler and the rasterized coverage
+double FieldError(DistanceFieldFont const& field, const char* text, int pixelSize)
+{
+	FontManager fonts;
+	fonts.LoadLib("../../Data/Test/calibri.ttf");
+	fonts.ChangeFontSize(pixelSize);
+	double error = 0;
+	uint64 pixels = 0;
+	for (const char* c = text; *c; c++)
+	{
+		GlyphAtlas::Glyph const* raster = fonts.AcquireGlyph((uint8)*c);
+		DistanceFieldFont::Glyph const* glyph = field.Find((uint8)*c);
+		K3D_ASSERT(raster && glyph);
+		const uint8* page = fonts.GetAtlas().GetPageData(raster->Page);
+		int pitch = fonts.GetAtlas().GetPageSize();
+		for (int j = 0; j < raster->H; j++)
+			for (int i = 0; i < raster->W; i++)
+			{
+				float coverage = page[(raster->V + j) * pitch + raster->U + i] / 255.0f;
+				float sampled = field.SampleCoverage(*glyph, raster->X + i + 0.5f, raster->Y - j - 0.5f, (float)pixelSize);
+				error += fabs(coverage - sampled);
+				pixels++;
+			}
+	}
+	return error / pixels;
+}
+
+void TestDistanceField(const char* cjkFont)
+{
+	vector<uint32> latin;
+	for (uint32 cp = 0x20; cp < 0x7f; cp++)
+		latin.push_back(cp);
+	for (uint32 cp = 0xa0; cp < 0x180; cp++)
+		latin.push_back(cp);
+	const char* sample = "AaBbgQR@&%8ikMW";
+
+	Os::Remove(KT("./TestDistanceFieldCache"));
+	AssetCache cache;
+	K3D_ASSERT(cache.Open(KT("./TestDistanceFieldCache")));
+	Dispatch::ThreadPool one(1), workers(4);
+	for (auto mode : { DistanceFieldFont::EMode::SDF, DistanceFieldFont::EMode::MSDF })
+	{
+		DistanceFieldFont::Options options;
+		options.Mode = mode;
+		DistanceFieldFont serial, parallel, cached;
+		if (!serial.Load("../../Data/Test/calibri.ttf", options))
+			return;
+		K3D_ASSERT(parallel.Load("../../Data/Test/calibri.ttf", options) && cached.Load("../../Data/Test/calibri.ttf", options));
+		DistanceFieldFont::Stats stats, parallelStats, cachedStats;
+		K3D_ASSERT(serial.Generate(latin.data(), (uint32)latin.size(), nullptr, &one, &stats));
+		K3D_ASSERT(parallel.Generate(latin.data(), (uint32)latin.size(), &cache, &workers, &parallelStats));
+		K3D_ASSERT(!parallelStats.FromCache && parallelStats.Generated == stats.Glyphs);
+		K3D_ASSERT(cached.Generate(latin.data(), (uint32)latin.size(), &cache, &workers, &cachedStats));
+		K3D_ASSERT(cachedStats.FromCache && cachedStats.Generated == 0 && cachedStats.Glyphs == stats.Glyphs);
+		// the same fields from any number of threads and from the cache
+		for (uint32 cp : latin)
+		{
+			DistanceFieldFont::Glyph const* a = serial.Find(cp);
+			if (!a)
+				continue;
+			for (DistanceFieldFont const* other : { &parallel, &cached })
+			{
+				DistanceFieldFont::Glyph const* b = other->Find(cp);
+				K3D_ASSERT(b && memcmp(a, b, sizeof(*a)) == 0);
+				K3D_ASSERT(memcmp(serial.GetField(*a), other->GetField(*b), a->W * a->H * serial.GetChannels()) == 0);
+			}
+		}
+
+		// one atlas entry serves every size
+		GlyphAtlas atlas(256, 1, serial.GetChannels());
+		GlyphAtlas::Glyph const* entry = serial.Acquire('A', atlas);
+		K3D_ASSERT(entry && entry->Page == 0 && entry->W == (int)serial.Find('A')->W);
+		K3D_ASSERT(serial.Acquire('A', atlas) == entry && atlas.GetStats().Hits == 1);
+		K3D_ASSERT(memcmp(atlas.GetPageData(0) + (entry->V * 256 + entry->U) * serial.GetChannels(),
+			serial.GetField(*serial.Find('A')), entry->W * serial.GetChannels()) == 0);
+
+		const char* name = mode == DistanceFieldFont::EMode::SDF ? "SDF" : "MSDF";
+		cout << name << ": " << stats.Glyphs << " latin glyphs in " << stats.Milliseconds << " ms on 1 thread, "
+			<< parallelStats.Milliseconds << " ms on 4, " << cachedStats.Milliseconds << " ms from the cache" << endl;
+		for (int size : { 16, 32, 64 })
+		{
+			double error = FieldError(serial, sample, size);
+			cout << name << " " << size << " px: mean coverage error " << error << endl;
+			// small sizes lose the thin strokes to the bilinear filter
+			K3D_ASSERT(error < (size == 16 ? 0.04 : 0.015));
+		}
+	}
+
+	if (!cjkFont)
+	{
+		cout << "CJK timing skipped, pass a CJK font as the second argument" << endl;
+		return;
+	}
+	vector<uint32> cjk;
+	for (uint32 cp = 0x3040; cp < 0x3100; cp++)
+		cjk.push_back(cp);
+	for (uint32 cp = 0x4e00; cp < 0x4e00 + 3000; cp++)
+		cjk.push_back(cp);
+	DistanceFieldFont font;
+	DistanceFieldFont::Stats stats;
+	if (!font.Load(cjkFont) || !font.Generate(cjk.data(), (uint32)cjk.size(), nullptr, &workers, &stats))
+	{
+		cout << "can't open " << cjkFont << endl;
+		return;
+	}
+	cout << "MSDF: " << stats.Glyphs << " CJK glyphs in " << stats.Milliseconds << " ms on 4 threads" << endl;
+}
+
 int main(int argc, char**argv)
 {
 	TestFontManager();
+	TestGlyphAtlas();
+	TestTextFrames(argc > 1 ? atoi(argv[1]) : 1000);
+	TestTextBatcher(200);
+	TestDistanceField(argc > 2 ? argv[2] : nullptr);
 	return 0;
-}
\ No newline at end of file
+}
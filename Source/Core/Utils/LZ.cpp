@@ -0,0 +1,334 @@
+#include "Kaleido3D.h"
+#include "LZ.h"
+#include <string.h>
+#include <vector>
+
+namespace LZ
+{
+	typedef unsigned char	u8;
+	typedef unsigned short	u16;
+	typedef unsigned int	u32;
+
+	static const size_t kMinMatch = 4;
+	/// the last bytes are always literals, the last match starts before kMatchFindLimit
+	static const size_t kLastLiterals = 5;
+	static const size_t kMatchFindLimit = 12;
+	static const size_t kMaxDistance = 65535;
+	static const u32 kFastHashLog = 14;
+	static const u32 kHighHashLog = 15;
+	static const u32 kSkipTrigger = 6;
+	static const u32 kHighMaxAttempts = 256;
+
+	static inline u32 Read32(const u8* p)
+	{
+		u32 v;
+		memcpy(&v, p, sizeof(v));
+		return v;
+	}
+
+	static inline u32 Hash(const u8* p, u32 hashLog)
+	{
+		return (Read32(p) * 2654435761u) >> (32 - hashLog);
+	}
+
+	static inline size_t MatchLength(const u8* ip, const u8* ref, const u8* limit)
+	{
+		const u8* start = ip;
+		while (ip < limit && *ip == *ref)
+		{
+			ip++;
+			ref++;
+		}
+		return ip - start;
+	}
+
+	static inline u8* WriteLength(u8* op, size_t len)
+	{
+		for (; len >= 255; len -= 255)
+			*op++ = 255;
+		*op++ = (u8)len;
+		return op;
+	}
+
+	/// \return the end of the sequence, nullptr if it doesn't fit
+	static u8* EmitSequence(u8* op, u8* oend, const u8* literals, size_t litLen, size_t offset, size_t matchLen)
+	{
+		// token, length bytes, literals, offset, plus the final literals which must still fit
+		if ((size_t)(oend - op) < 1 + litLen / 255 + 1 + litLen + 2 + matchLen / 255 + 1 + kLastLiterals + 1)
+			return nullptr;
+		u8* token = op++;
+		if (litLen >= 15)
+		{
+			*token = 15 << 4;
+			op = WriteLength(op, litLen - 15);
+		}
+		else
+		{
+			*token = (u8)(litLen << 4);
+		}
+		memcpy(op, literals, litLen);
+		op += litLen;
+		*op++ = (u8)(offset & 0xff);
+		*op++ = (u8)(offset >> 8);
+		matchLen -= kMinMatch;
+		if (matchLen >= 15)
+		{
+			*token |= 15;
+			op = WriteLength(op, matchLen - 15);
+		}
+		else
+		{
+			*token |= (u8)matchLen;
+		}
+		return op;
+	}
+
+	static size_t EmitLastLiterals(u8* op, u8* oend, u8* dst, const u8* literals, size_t litLen)
+	{
+		if ((size_t)(oend - op) < 1 + litLen / 255 + 1 + litLen)
+			return 0;
+		if (litLen >= 15)
+		{
+			*op++ = 15 << 4;
+			op = WriteLength(op, litLen - 15);
+		}
+		else
+		{
+			*op++ = (u8)(litLen << 4);
+		}
+		if (litLen)
+			memcpy(op, literals, litLen);
+		op += litLen;
+		return op - dst;
+	}
+
+	static size_t CompressFast(const u8* src, size_t srcSize, u8* dst, size_t dstCapacity)
+	{
+		const u8* ip = src;
+		const u8* anchor = src;
+		const u8* iend = src + srcSize;
+		u8* op = dst;
+		u8* oend = dst + dstCapacity;
+		if (srcSize < kMatchFindLimit + 1)
+			return EmitLastLiterals(op, oend, dst, anchor, srcSize);
+
+		const u8* mflimit = iend - kMatchFindLimit;
+		const u8* matchlimit = iend - kLastLiterals;
+		std::vector<u32> table(1u << kFastHashLog, 0);
+		table[Hash(ip, kFastHashLog)] = 0;
+		ip++;
+
+		for (;;)
+		{
+			const u8* ref = nullptr;
+			u32 step = 1;
+			u32 attempts = 1u << kSkipTrigger;
+			for (;;)
+			{
+				if (ip > mflimit)
+					return EmitLastLiterals(op, oend, dst, anchor, iend - anchor);
+				u32 h = Hash(ip, kFastHashLog);
+				ref = src + table[h];
+				table[h] = (u32)(ip - src);
+				if ((size_t)(ip - ref) <= kMaxDistance && Read32(ref) == Read32(ip))
+					break;
+				// search faster through data that doesn't match
+				ip += step;
+				step = attempts++ >> kSkipTrigger;
+			}
+			while (ip > anchor && ref > src && ip[-1] == ref[-1])
+			{
+				ip--;
+				ref--;
+			}
+			size_t matchLen = kMinMatch + MatchLength(ip + kMinMatch, ref + kMinMatch, matchlimit);
+			op = EmitSequence(op, oend, anchor, ip - anchor, ip - ref, matchLen);
+			if (!op)
+				return 0;
+			ip += matchLen;
+			anchor = ip;
+			if (ip > mflimit)
+				return EmitLastLiterals(op, oend, dst, anchor, iend - anchor);
+			table[Hash(ip - 2, kFastHashLog)] = (u32)(ip - 2 - src);
+		}
+	}
+
+	/// hash chains over the 64KB window
+	class MatchFinder
+	{
+	public:
+		explicit MatchFinder(const u8* base)
+			: m_Base(base), m_Head(1u << kHighHashLog, -1), m_Chain(kMaxDistance + 1, 0), m_NextToUpdate(0)
+		{}
+
+		/// \return length of the longest match of 'ip', 0 if none
+		size_t Find(const u8* ip, const u8* matchlimit, const u8** ref)
+		{
+			Insert(ip);
+			size_t best = 0;
+			int pos = m_Head[Hash(ip, kHighHashLog)];
+			u32 attempts = kHighMaxAttempts;
+			while (pos >= 0 && attempts-- > 0)
+			{
+				const u8* candidate = m_Base + pos;
+				size_t distance = ip - candidate;
+				if (distance == 0 || distance > kMaxDistance)
+					break;
+				if (candidate[best] == ip[best] && Read32(candidate) == Read32(ip))
+				{
+					size_t len = kMinMatch + MatchLength(ip + kMinMatch, candidate + kMinMatch, matchlimit);
+					if (len > best)
+					{
+						best = len;
+						*ref = candidate;
+					}
+				}
+				u16 delta = m_Chain[pos & kMaxDistance];
+				if (delta == 0)
+					break;
+				pos -= delta;
+			}
+			return best;
+		}
+
+	private:
+		void Insert(const u8* ip)
+		{
+			int target = (int)(ip - m_Base);
+			for (; m_NextToUpdate < target; m_NextToUpdate++)
+			{
+				u32 h = Hash(m_Base + m_NextToUpdate, kHighHashLog);
+				int prev = m_Head[h];
+				size_t delta = prev < 0 ? 0 : m_NextToUpdate - prev;
+				m_Chain[m_NextToUpdate & kMaxDistance] = (u16)(delta > kMaxDistance ? 0 : delta);
+				m_Head[h] = m_NextToUpdate;
+			}
+		}
+
+		const u8*			m_Base;
+		std::vector<int>	m_Head;
+		std::vector<u16>	m_Chain;
+		int					m_NextToUpdate;
+	};
+
+	static size_t CompressHigh(const u8* src, size_t srcSize, u8* dst, size_t dstCapacity)
+	{
+		const u8* ip = src;
+		const u8* anchor = src;
+		const u8* iend = src + srcSize;
+		u8* op = dst;
+		u8* oend = dst + dstCapacity;
+		if (srcSize < kMatchFindLimit + 1)
+			return EmitLastLiterals(op, oend, dst, anchor, srcSize);
+
+		const u8* mflimit = iend - kMatchFindLimit;
+		const u8* matchlimit = iend - kLastLiterals;
+		MatchFinder finder(src);
+		ip++;
+		while (ip <= mflimit)
+		{
+			const u8* ref = nullptr;
+			size_t len = finder.Find(ip, matchlimit, &ref);
+			if (len < kMinMatch)
+			{
+				ip++;
+				continue;
+			}
+			// lazy matching, prefer a longer match starting one byte later
+			while (ip + 1 <= mflimit)
+			{
+				const u8* nextRef = nullptr;
+				size_t nextLen = finder.Find(ip + 1, matchlimit, &nextRef);
+				if (nextLen <= len)
+					break;
+				ip++;
+				len = nextLen;
+				ref = nextRef;
+			}
+			op = EmitSequence(op, oend, anchor, ip - anchor, ip - ref, len);
+			if (!op)
+				return 0;
+			ip += len;
+			anchor = ip;
+		}
+		return EmitLastLiterals(op, oend, dst, anchor, iend - anchor);
+	}
+
+	size_t CompressBound(size_t size)
+	{
+		return size + size / 255 + 16;
+	}
+
+	size_t Compress(const void* src, size_t srcSize, void* dst, size_t dstCapacity, Level level)
+	{
+		if (level == High)
+			return CompressHigh((const u8*)src, srcSize, (u8*)dst, dstCapacity);
+		return CompressFast((const u8*)src, srcSize, (u8*)dst, dstCapacity);
+	}
+
+	static inline bool ReadLength(const u8*& ip, const u8* iend, size_t& len)
+	{
+		u8 b;
+		do
+		{
+			if (ip >= iend)
+				return false;
+			b = *ip++;
+			len += b;
+		} while (b == 255);
+		return true;
+	}
+
+	size_t Decompress(const void* source, size_t srcSize, void* dest, size_t dstSize)
+	{
+		const u8* ip = (const u8*)source;
+		const u8* iend = ip + srcSize;
+		u8* dst = (u8*)dest;
+		u8* op = dst;
+		u8* oend = dst + dstSize;
+		for (;;)
+		{
+			if (ip >= iend)
+				return 0;
+			u8 token = *ip++;
+			size_t litLen = token >> 4;
+			if (litLen == 15 && !ReadLength(ip, iend, litLen))
+				return 0;
+			if (litLen > (size_t)(iend - ip) || litLen > (size_t)(oend - op))
+				return 0;
+			memcpy(op, ip, litLen);
+			op += litLen;
+			ip += litLen;
+			// the last sequence has no match
+			if (ip == iend)
+				break;
+
+			if (iend - ip < 2)
+				return 0;
+			size_t offset = ip[0] | (ip[1] << 8);
+			ip += 2;
+			if (offset == 0 || offset > (size_t)(op - dst))
+				return 0;
+			size_t matchLen = token & 15;
+			if (matchLen == 15 && !ReadLength(ip, iend, matchLen))
+				return 0;
+			matchLen += kMinMatch;
+			if (matchLen > (size_t)(oend - op))
+				return 0;
+			const u8* match = op - offset;
+			if (offset >= 8 && (size_t)(oend - op) >= matchLen + 8)
+			{
+				// 8 byte steps never read bytes they have not written yet
+				for (size_t i = 0; i < matchLen; i += 8)
+					memcpy(op + i, match + i, 8);
+			}
+			else
+			{
+				for (size_t i = 0; i < matchLen; i++)
+					op[i] = match[i];
+			}
+			op += matchLen;
+		}
+		return op == oend ? dstSize : 0;
+	}
+}
@@ -0,0 +1,31 @@
+#ifndef __LZ_H__
+#define __LZ_H__
+#include <stddef.h>
+
+/**
+ * Byte-oriented LZ77 codec, the stream is the LZ4 block format:
+ * sequences of (token, literals, 16 bit offset, match length) with a 64KB window.
+ * Decoding is bounds checked, a corrupted stream fails instead of overrunning.
+ */
+namespace LZ
+{
+	enum Level
+	{
+		/// single hash probe, skips ahead faster on incompressible data
+		Fast = 0,
+		/// hash chains with lazy matching, for offline builds
+		High = 1,
+	};
+
+	/// worst case compressed size of 'size' bytes
+	size_t K3D_API CompressBound(size_t size);
+
+	/// \return compressed size, 0 if 'dst' is too small
+	size_t K3D_API Compress(const void* src, size_t srcSize, void* dst, size_t dstCapacity, Level level = Fast);
+
+	/// \param dstSize exact decompressed size
+	/// \return dstSize, 0 if the stream is corrupted or does not decode to dstSize bytes
+	size_t K3D_API Decompress(const void* src, size_t srcSize, void* dst, size_t dstSize);
+}
+
+#endif
@@ -0,0 +1,683 @@
+#include "Kaleido3D.h"
+#include "VertexCodec.h"
+#include "MeshData.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define K3D_VERTEXCODEC_SSE2 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define K3D_VERTEXCODEC_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace k3d
+{
+	namespace VertexCodec
+	{
+		namespace
+		{
+			const float kSnorm8 = 1.0f / 127.0f;
+
+			inline float AsFloat(uint32 bits)
+			{
+				float value;
+				memcpy(&value, &bits, sizeof(value));
+				return value;
+			}
+
+			inline uint32 AsUint(float value)
+			{
+				uint32 bits;
+				memcpy(&bits, &value, sizeof(bits));
+				return bits;
+			}
+
+			inline float Dot(const float * a, const float * b)
+			{
+				return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+			}
+
+			/// the snorm8 pair decoded, before normalization
+			inline void Unfold(float x, float y, float * v)
+			{
+				x = std::max(x * kSnorm8, -1.0f);
+				y = std::max(y * kSnorm8, -1.0f);
+				float z = 1.0f - fabsf(x) - fabsf(y);
+				float t = std::max(-z, 0.0f);
+				v[0] = x - copysignf(t, x);
+				v[1] = y - copysignf(t, y);
+				v[2] = z;
+			}
+
+			inline void Normalize(float * v)
+			{
+				float length = sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+				v[0] /= length; v[1] /= length; v[2] /= length;
+			}
+
+			/// dequantization of the positions, min + q * scale
+			struct PositionScale
+			{
+				float Min[3];
+				float Scale[3];
+
+				explicit PositionScale(MeshData const& mesh)
+				{
+					kMath::AABB box = mesh.GetBoundingBox();
+					kMath::Vec3f lo = box.GetMinCorner(), hi = box.GetMaxCorner();
+					for (uint32 k = 0; k < 3; k++)
+					{
+						Min[k] = lo[k];
+						Scale[k] = std::max(hi[k] - lo[k], 0.0f) / 65535.0f;
+					}
+				}
+			};
+
+			/// attributes of the float and quantized layouts of a format
+			struct Layout
+			{
+				VtxFormat	Float;
+				VtxFormat	Quantized;
+				bool		HasNormal;
+				bool		HasUV;
+				/// offsets in floats
+				uint32		FloatNormal;
+				uint32		FloatUV;
+			};
+
+			const Layout kLayouts[] = {
+				{ VtxFormat::POS3_F32, VtxFormat::POS3_U16, false, false, 0, 0 },
+				{ VtxFormat::POS3_F32_UV2_F32, VtxFormat::POS3_U16_UV2_F16, false, true, 0, 3 },
+				{ VtxFormat::POS3_F32_NOR3_F32, VtxFormat::POS3_U16_NOR_OCT8, true, false, 3, 0 },
+				{ VtxFormat::POS3_F32_NOR3_F32_UV2_F32, VtxFormat::POS3_U16_NOR_OCT8_UV2_F16, true, true, 3, 6 },
+			};
+
+			const Layout * FindLayout(VtxFormat format)
+			{
+				for (auto const& layout : kLayouts)
+				{
+					if (layout.Float == format || layout.Quantized == format)
+						return &layout;
+				}
+				return nullptr;
+			}
+
+			/// one vertex of any quantized format, the position is first, a normal
+			/// follows in its 4th 16 bit component, uvs at byte 8
+			inline void DecodeVertex(const kByte * src, float * dst, Layout const& layout, PositionScale const& position)
+			{
+				uint16 q[3];
+				memcpy(q, src, sizeof(q));
+				for (uint32 k = 0; k < 3; k++)
+					dst[k] = q[k] * position.Scale[k] + position.Min[k];
+				if (layout.HasNormal)
+				{
+					float * n = dst + layout.FloatNormal;
+					Unfold((float)(int8)src[6], (float)(int8)src[7], n);
+					Normalize(n);
+				}
+				if (layout.HasUV)
+				{
+					uint16 uv[2];
+					memcpy(uv, src + 8, sizeof(uv));
+					dst[layout.FloatUV] = HalfToFloat(uv[0]);
+					dst[layout.FloatUV + 1] = HalfToFloat(uv[1]);
+				}
+			}
+
+#if K3D_VERTEXCODEC_SSE2
+			/// 4 halfs in the low 16 bits of each lane, denormals, infinities and NaNs included
+			inline __m128 HalfToFloat4(__m128i h)
+			{
+				const __m128i noSign = _mm_set1_epi32(0x7fff);
+				const __m128 magic = _mm_castsi128_ps(_mm_set1_epi32((254 - 15) << 23));
+				const __m128i lastFinite = _mm_set1_epi32(0x7bff);
+				const __m128i infNaN = _mm_set1_epi32(255 << 23);
+				__m128i bits = _mm_and_si128(h, noSign);
+				__m128i sign = _mm_slli_epi32(_mm_xor_si128(h, bits), 16);
+				__m128 scaled = _mm_mul_ps(_mm_castsi128_ps(_mm_slli_epi32(bits, 13)), magic);
+				__m128i wasInfNaN = _mm_and_si128(_mm_cmpgt_epi32(bits, lastFinite), infNaN);
+				return _mm_or_ps(scaled, _mm_castsi128_ps(_mm_or_si128(sign, wasInfNaN)));
+			}
+
+			inline __m128 Normalize4(__m128 & x, __m128 & y, __m128 & z)
+			{
+				__m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)));
+				x = _mm_div_ps(x, length);
+				y = _mm_div_ps(y, length);
+				z = _mm_div_ps(z, length);
+				return length;
+			}
+
+			/// 'nn' holds the snorm8 pairs in the low 16 bits of each lane
+			inline void DecodeOctahedral4(__m128i nn, __m128 & x, __m128 & y, __m128 & z)
+			{
+				const __m128 minusOne = _mm_set1_ps(-1.0f);
+				const __m128 signMask = _mm_set1_ps(-0.0f);
+				x = _mm_max_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(nn, 24), 24)), _mm_set1_ps(kSnorm8)), minusOne);
+				y = _mm_max_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(nn, 16), 24)), _mm_set1_ps(kSnorm8)), minusOne);
+				z = _mm_sub_ps(_mm_sub_ps(_mm_set1_ps(1.0f), _mm_andnot_ps(signMask, x)), _mm_andnot_ps(signMask, y));
+				__m128 t = _mm_max_ps(_mm_sub_ps(_mm_setzero_ps(), z), _mm_setzero_ps());
+				x = _mm_sub_ps(x, _mm_or_ps(t, _mm_and_ps(x, signMask)));
+				y = _mm_sub_ps(y, _mm_or_ps(t, _mm_and_ps(y, signMask)));
+				Normalize4(x, y, z);
+			}
+
+			inline int32 Load32(const kByte * src)
+			{
+				int32 value;
+				memcpy(&value, src, sizeof(value));
+				return value;
+			}
+
+			/// 4 vertices of 'stride' bytes to 4 consecutive float vertices
+			template <bool HasNormal, bool HasUV>
+			void DecodeBlock(const kByte * src, size_t stride, float * dst,
+				__m128 const* scale, __m128 const* offset)
+			{
+				const __m128i zero = _mm_setzero_si128();
+				__m128 r0 = _mm_castsi128_ps(_mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)src), zero));
+				__m128 r1 = _mm_castsi128_ps(_mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)(src + stride)), zero));
+				__m128 r2 = _mm_castsi128_ps(_mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)(src + stride * 2)), zero));
+				__m128 r3 = _mm_castsi128_ps(_mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)(src + stride * 3)), zero));
+				// the lanes are moved as bits, they hold integers
+				_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+				__m128 px = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_castps_si128(r0)), scale[0]), offset[0]);
+				__m128 py = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_castps_si128(r1)), scale[1]), offset[1]);
+				__m128 pz = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_castps_si128(r2)), scale[2]), offset[2]);
+				__m128 nx = _mm_setzero_ps(), ny = _mm_setzero_ps(), nz = _mm_setzero_ps();
+				__m128 u = _mm_setzero_ps(), v = _mm_setzero_ps();
+				if (HasNormal)
+					DecodeOctahedral4(_mm_castps_si128(r3), nx, ny, nz);
+				if (HasUV)
+				{
+					__m128i uv = _mm_set_epi32(Load32(src + stride * 3 + 8), Load32(src + stride * 2 + 8),
+						Load32(src + stride + 8), Load32(src + 8));
+					u = HalfToFloat4(_mm_and_si128(uv, _mm_set1_epi32(0xffff)));
+					v = HalfToFloat4(_mm_srli_epi32(uv, 16));
+				}
+
+				if (HasNormal && HasUV)
+				{
+					// Vertex3F3F2F, two registers each
+					_MM_TRANSPOSE4_PS(px, py, pz, nx);
+					_MM_TRANSPOSE4_PS(ny, nz, u, v);
+					_mm_storeu_ps(dst, px); _mm_storeu_ps(dst + 4, ny);
+					_mm_storeu_ps(dst + 8, py); _mm_storeu_ps(dst + 12, nz);
+					_mm_storeu_ps(dst + 16, pz); _mm_storeu_ps(dst + 20, u);
+					_mm_storeu_ps(dst + 24, nx); _mm_storeu_ps(dst + 28, v);
+				}
+				else if (HasNormal)
+				{
+					// Vertex3F3F
+					__m128 z0 = _mm_setzero_ps(), z1 = _mm_setzero_ps();
+					_MM_TRANSPOSE4_PS(px, py, pz, nx);
+					_MM_TRANSPOSE4_PS(ny, nz, z0, z1);
+					_mm_storeu_ps(dst, px); _mm_storel_pi((__m64*)(dst + 4), ny);
+					_mm_storeu_ps(dst + 6, py); _mm_storel_pi((__m64*)(dst + 10), nz);
+					_mm_storeu_ps(dst + 12, pz); _mm_storel_pi((__m64*)(dst + 16), z0);
+					_mm_storeu_ps(dst + 18, nx); _mm_storel_pi((__m64*)(dst + 22), z1);
+				}
+				else if (HasUV)
+				{
+					// Vertex3F2F
+					_MM_TRANSPOSE4_PS(px, py, pz, u);
+					float vs[4];
+					_mm_storeu_ps(vs, v);
+					_mm_storeu_ps(dst, px); dst[4] = vs[0];
+					_mm_storeu_ps(dst + 5, py); dst[9] = vs[1];
+					_mm_storeu_ps(dst + 10, pz); dst[14] = vs[2];
+					_mm_storeu_ps(dst + 15, u); dst[19] = vs[3];
+				}
+				else
+				{
+					// Vertex3F, 4 of them fill 3 registers
+					__m128 xy01 = _mm_unpacklo_ps(px, py), xy23 = _mm_unpackhi_ps(px, py);
+					__m128 zx = _mm_shuffle_ps(pz, px, _MM_SHUFFLE(1, 1, 0, 0));
+					_mm_storeu_ps(dst, _mm_shuffle_ps(xy01, zx, _MM_SHUFFLE(2, 0, 1, 0)));
+					__m128 yz1 = _mm_shuffle_ps(py, pz, _MM_SHUFFLE(1, 1, 1, 1));
+					_mm_storeu_ps(dst + 4, _mm_shuffle_ps(yz1, xy23, _MM_SHUFFLE(1, 0, 2, 0)));
+					__m128 z2x3 = _mm_shuffle_ps(pz, px, _MM_SHUFFLE(3, 3, 2, 2));
+					__m128 y3z3 = _mm_shuffle_ps(py, pz, _MM_SHUFFLE(3, 3, 3, 3));
+					_mm_storeu_ps(dst + 8, _mm_shuffle_ps(z2x3, y3z3, _MM_SHUFFLE(2, 0, 2, 0)));
+				}
+			}
+#elif K3D_VERTEXCODEC_NEON
+			inline float32x4_t HalfToFloat4(uint32x4_t h)
+			{
+				uint32x4_t bits = vandq_u32(h, vdupq_n_u32(0x7fff));
+				uint32x4_t sign = vshlq_n_u32(veorq_u32(h, bits), 16);
+				float32x4_t scaled = vmulq_f32(vreinterpretq_f32_u32(vshlq_n_u32(bits, 13)),
+					vreinterpretq_f32_u32(vdupq_n_u32((254 - 15) << 23)));
+				uint32x4_t wasInfNaN = vandq_u32(vcgtq_u32(bits, vdupq_n_u32(0x7bff)), vdupq_n_u32(255 << 23));
+				return vreinterpretq_f32_u32(vorrq_u32(vreinterpretq_u32_f32(scaled), vorrq_u32(sign, wasInfNaN)));
+			}
+
+			inline void DecodeOctahedral4(uint32x4_t nn, float32x4_t & x, float32x4_t & y, float32x4_t & z)
+			{
+				int32x4_t lanes = vreinterpretq_s32_u32(nn);
+				x = vmaxq_f32(vmulq_n_f32(vcvtq_f32_s32(vshrq_n_s32(vshlq_n_s32(lanes, 24), 24)), kSnorm8), vdupq_n_f32(-1.0f));
+				y = vmaxq_f32(vmulq_n_f32(vcvtq_f32_s32(vshrq_n_s32(vshlq_n_s32(lanes, 16), 24)), kSnorm8), vdupq_n_f32(-1.0f));
+				z = vsubq_f32(vsubq_f32(vdupq_n_f32(1.0f), vabsq_f32(x)), vabsq_f32(y));
+				float32x4_t t = vmaxq_f32(vnegq_f32(z), vdupq_n_f32(0.0f));
+				uint32x4_t signMask = vdupq_n_u32(0x80000000u);
+				x = vsubq_f32(x, vreinterpretq_f32_u32(vorrq_u32(vreinterpretq_u32_f32(t), vandq_u32(vreinterpretq_u32_f32(x), signMask))));
+				y = vsubq_f32(y, vreinterpretq_f32_u32(vorrq_u32(vreinterpretq_u32_f32(t), vandq_u32(vreinterpretq_u32_f32(y), signMask))));
+				float32x4_t length = vsqrtq_f32(vaddq_f32(vaddq_f32(vmulq_f32(x, x), vmulq_f32(y, y)), vmulq_f32(z, z)));
+				x = vdivq_f32(x, length);
+				y = vdivq_f32(y, length);
+				z = vdivq_f32(z, length);
+			}
+
+			/// 4 vertices of 'stride' bytes to 4 consecutive float vertices
+			template <bool HasNormal, bool HasUV>
+			void DecodeBlock(const kByte * src, size_t stride, float * dst,
+				float32x4_t const* scale, float32x4_t const* offset)
+			{
+				uint32x4_t r0 = vmovl_u16(vld1_u16((const uint16*)src));
+				uint32x4_t r1 = vmovl_u16(vld1_u16((const uint16*)(src + stride)));
+				uint32x4_t r2 = vmovl_u16(vld1_u16((const uint16*)(src + stride * 2)));
+				uint32x4_t r3 = vmovl_u16(vld1_u16((const uint16*)(src + stride * 3)));
+				// transposed, x, y, z and the normal lanes of the 4 vertices
+				uint32x4x2_t t01 = vtrnq_u32(r0, r1), t23 = vtrnq_u32(r2, r3);
+				uint32x4_t qx = vcombine_u32(vget_low_u32(t01.val[0]), vget_low_u32(t23.val[0]));
+				uint32x4_t qy = vcombine_u32(vget_low_u32(t01.val[1]), vget_low_u32(t23.val[1]));
+				uint32x4_t qz = vcombine_u32(vget_high_u32(t01.val[0]), vget_high_u32(t23.val[0]));
+				uint32x4_t qn = vcombine_u32(vget_high_u32(t01.val[1]), vget_high_u32(t23.val[1]));
+				float32x4x4_t out;
+				out.val[0] = vmlaq_f32(offset[0], vcvtq_f32_u32(qx), scale[0]);
+				out.val[1] = vmlaq_f32(offset[1], vcvtq_f32_u32(qy), scale[1]);
+				out.val[2] = vmlaq_f32(offset[2], vcvtq_f32_u32(qz), scale[2]);
+				float32x4_t nx = vdupq_n_f32(0.0f), ny = nx, nz = nx, u = nx, v = nx;
+				if (HasNormal)
+					DecodeOctahedral4(qn, nx, ny, nz);
+				if (HasUV)
+				{
+					uint32 lanes[4];
+					for (uint32 k = 0; k < 4; k++)
+						memcpy(&lanes[k], src + stride * k + 8, sizeof(uint32));
+					uint32x4_t uv = vld1q_u32(lanes);
+					u = HalfToFloat4(vandq_u32(uv, vdupq_n_u32(0xffff)));
+					v = HalfToFloat4(vshrq_n_u32(uv, 16));
+				}
+				// the float layouts interleave the attributes per vertex
+				float lanes[8][4];
+				vst1q_f32(lanes[0], out.val[0]); vst1q_f32(lanes[1], out.val[1]); vst1q_f32(lanes[2], out.val[2]);
+				vst1q_f32(lanes[3], nx); vst1q_f32(lanes[4], ny); vst1q_f32(lanes[5], nz);
+				vst1q_f32(lanes[6], u); vst1q_f32(lanes[7], v);
+				uint32 floats = 3 + (HasNormal ? 3 : 0) + (HasUV ? 2 : 0);
+				for (uint32 k = 0; k < 4; k++)
+				{
+					float * d = dst + k * floats;
+					d[0] = lanes[0][k]; d[1] = lanes[1][k]; d[2] = lanes[2][k];
+					if (HasNormal)
+					{
+						d[3] = lanes[3][k]; d[4] = lanes[4][k]; d[5] = lanes[5][k];
+					}
+					if (HasUV)
+					{
+						d[floats - 2] = lanes[6][k]; d[floats - 1] = lanes[7][k];
+					}
+				}
+			}
+#endif
+
+#if K3D_VERTEXCODEC_SSE2 || K3D_VERTEXCODEC_NEON
+			template <bool HasNormal, bool HasUV>
+			uint32 DecodeBlocks(const kByte * src, size_t stride, float * dst, uint32 count, PositionScale const& position)
+			{
+				const uint32 floats = 3 + (HasNormal ? 3 : 0) + (HasUV ? 2 : 0);
+#if K3D_VERTEXCODEC_SSE2
+				__m128 scale[3], offset[3];
+				for (uint32 k = 0; k < 3; k++)
+				{
+					scale[k] = _mm_set1_ps(position.Scale[k]);
+					offset[k] = _mm_set1_ps(position.Min[k]);
+				}
+#else
+				float32x4_t scale[3], offset[3];
+				for (uint32 k = 0; k < 3; k++)
+				{
+					scale[k] = vdupq_n_f32(position.Scale[k]);
+					offset[k] = vdupq_n_f32(position.Min[k]);
+				}
+#endif
+				uint32 v = 0;
+				for (; v + 4 <= count; v += 4)
+					DecodeBlock<HasNormal, HasUV>(src + v * stride, stride, dst + v * floats, scale, offset);
+				return v;
+			}
+#endif
+		}
+
+		VtxFormat GetQuantizedFormat(VtxFormat format)
+		{
+			const Layout * layout = FindLayout(format);
+			return layout && layout->Float == format ? layout->Quantized : VtxFormat::PER_INSTANCE;
+		}
+
+		VtxFormat GetFloatFormat(VtxFormat format)
+		{
+			const Layout * layout = FindLayout(format);
+			return layout && layout->Quantized == format ? layout->Float : VtxFormat::PER_INSTANCE;
+		}
+
+		uint16 FloatToHalf(float value)
+		{
+			const uint32 infinity = 255u << 23;
+			const uint32 halfOverflow = (127u + 16u) << 23;
+			const uint32 denormMagic = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+			uint32 bits = AsUint(value);
+			uint32 sign = bits & 0x80000000u;
+			bits ^= sign;
+			uint16 half;
+			if (bits >= halfOverflow)
+			{
+				half = bits > infinity ? 0x7e00 : 0x7c00;
+			}
+			else if (bits < (113u << 23))
+			{
+				// the float adder rounds the denormal
+				half = (uint16)(AsUint(AsFloat(bits) + AsFloat(denormMagic)) - denormMagic);
+			}
+			else
+			{
+				uint32 odd = (bits >> 13) & 1;
+				bits += ((uint32)(15 - 127) << 23) + 0xfff;
+				bits += odd;
+				half = (uint16)(bits >> 13);
+			}
+			return (uint16)(half | (sign >> 16));
+		}
+
+		float HalfToFloat(uint16 value)
+		{
+			uint32 bits = value & 0x7fffu;
+			uint32 sign = (uint32)(value & 0x8000u) << 16;
+			float scaled = AsFloat(bits << 13) * AsFloat((254u - 15u) << 23);
+			uint32 result = AsUint(scaled) | sign;
+			if (bits > 0x7bffu)
+				result |= 255u << 23;
+			return AsFloat(result);
+		}
+
+		void EncodeOctahedral(const float vector[3], int8 oct[2])
+		{
+			float n[3] = { vector[0], vector[1], vector[2] };
+			float l1 = fabsf(n[0]) + fabsf(n[1]) + fabsf(n[2]);
+			if (l1 <= 0.0f)
+			{
+				oct[0] = oct[1] = 0;
+				return;
+			}
+			float x = n[0] / l1, y = n[1] / l1;
+			if (n[2] < 0.0f)
+			{
+				float fx = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+				float fy = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+				x = fx;
+				y = fy;
+			}
+			Normalize(n);
+			// the closest of rounding each component down or up
+			float baseX = floorf(x * 127.0f), baseY = floorf(y * 127.0f);
+			float best = -2.0f;
+			for (uint32 i = 0; i < 4; i++)
+			{
+				float qx = std::min(std::max(baseX + (i & 1), -127.0f), 127.0f);
+				float qy = std::min(std::max(baseY + (i >> 1), -127.0f), 127.0f);
+				float decoded[3];
+				Unfold(qx, qy, decoded);
+				Normalize(decoded);
+				float match = Dot(decoded, n);
+				if (match > best)
+				{
+					best = match;
+					oct[0] = (int8)qx;
+					oct[1] = (int8)qy;
+				}
+			}
+		}
+
+		void DecodeOctahedral(const int8 oct[2], float vector[3])
+		{
+			Unfold((float)oct[0], (float)oct[1], vector);
+			Normalize(vector);
+		}
+
+		void DecodeOctahedral(float * dst, size_t dstStride, const int8 * oct, size_t octStride, uint32 count)
+		{
+			uint32 v = 0;
+#if K3D_VERTEXCODEC_SSE2
+			for (; v + 4 <= count; v += 4)
+			{
+				const kByte * src = (const kByte*)oct + v * octStride;
+				__m128i nn = _mm_set_epi32(src[octStride * 3] | src[octStride * 3 + 1] << 8, src[octStride * 2] | src[octStride * 2 + 1] << 8,
+					src[octStride] | src[octStride + 1] << 8, src[0] | src[1] << 8);
+				__m128 x, y, z;
+				DecodeOctahedral4(nn, x, y, z);
+				float lanes[3][4];
+				_mm_storeu_ps(lanes[0], x); _mm_storeu_ps(lanes[1], y); _mm_storeu_ps(lanes[2], z);
+				for (uint32 k = 0; k < 4; k++)
+				{
+					float * d = (float*)((kByte*)dst + (v + k) * dstStride);
+					d[0] = lanes[0][k]; d[1] = lanes[1][k]; d[2] = lanes[2][k];
+				}
+			}
+#elif K3D_VERTEXCODEC_NEON
+			for (; v + 4 <= count; v += 4)
+			{
+				const kByte * src = (const kByte*)oct + v * octStride;
+				uint32 pairs[4];
+				for (uint32 k = 0; k < 4; k++)
+					pairs[k] = src[octStride * k] | src[octStride * k + 1] << 8;
+				float32x4_t x, y, z;
+				DecodeOctahedral4(vld1q_u32(pairs), x, y, z);
+				float lanes[3][4];
+				vst1q_f32(lanes[0], x); vst1q_f32(lanes[1], y); vst1q_f32(lanes[2], z);
+				for (uint32 k = 0; k < 4; k++)
+				{
+					float * d = (float*)((kByte*)dst + (v + k) * dstStride);
+					d[0] = lanes[0][k]; d[1] = lanes[1][k]; d[2] = lanes[2][k];
+				}
+			}
+#endif
+			for (; v < count; v++)
+				DecodeOctahedral((const int8*)((const kByte*)oct + v * octStride), (float*)((kByte*)dst + v * dstStride));
+		}
+
+		void EncodeWeights(const float weights[4], uint8 packed[4])
+		{
+			float sum = weights[0] + weights[1] + weights[2] + weights[3];
+			float scale = sum > 0.0f ? 255.0f / sum : 0.0f;
+			int32 total = 0;
+			float residual[4];
+			for (uint32 k = 0; k < 4; k++)
+			{
+				float w = std::max(weights[k], 0.0f) * scale;
+				packed[k] = (uint8)std::min(w + 0.5f, 255.0f);
+				residual[k] = w - packed[k];
+				total += packed[k];
+			}
+			if (sum <= 0.0f)
+				return;
+			// the rounding error goes to the weight which lost or gained most
+			while (total != 255)
+			{
+				int32 step = total < 255 ? 1 : -1;
+				uint32 pick = 4;
+				for (uint32 k = 0; k < 4; k++)
+				{
+					if ((step > 0 && packed[k] < 255) || (step < 0 && packed[k] > 0))
+					{
+						if (pick == 4 || residual[k] * step > residual[pick] * step)
+							pick = k;
+					}
+				}
+				packed[pick] = (uint8)(packed[pick] + step);
+				residual[pick] -= (float)step;
+				total += step;
+			}
+		}
+
+		void DecodeWeights(float * dst, const uint8 * packed, size_t stride, uint32 count)
+		{
+			const float unorm8 = 1.0f / 255.0f;
+			uint32 v = 0;
+#if K3D_VERTEXCODEC_SSE2
+			const __m128i zero = _mm_setzero_si128();
+			for (; v < count; v++)
+			{
+				int32 bytes;
+				memcpy(&bytes, packed + v * stride, sizeof(bytes));
+				__m128i lanes = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(bytes), zero), zero);
+				_mm_storeu_ps(dst + v * 4, _mm_mul_ps(_mm_cvtepi32_ps(lanes), _mm_set1_ps(unorm8)));
+			}
+#elif K3D_VERTEXCODEC_NEON
+			for (; v < count; v++)
+			{
+				uint32 bytes;
+				memcpy(&bytes, packed + v * stride, sizeof(bytes));
+				uint16x4_t lanes = vget_low_u16(vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(bytes))));
+				vst1q_f32(dst + v * 4, vmulq_n_f32(vcvtq_f32_u32(vmovl_u16(lanes)), unorm8));
+			}
+#endif
+			for (; v < count; v++)
+			{
+				for (uint32 k = 0; k < 4; k++)
+					dst[v * 4 + k] = packed[v * stride + k] * unorm8;
+			}
+		}
+
+		bool Quantize(MeshData & mesh, Stats * stats)
+		{
+			const Layout * layout = FindLayout(mesh.GetVertexFormat());
+			uint32 numVertices = (uint32)mesh.GetVertexNum();
+			if (!layout || layout->Float != mesh.GetVertexFormat() || !numVertices || !mesh.GetVertexBuffer())
+				return false;
+			mesh.Detach();
+			uint32 floats = MeshData::GetVertexStride(layout->Float) / sizeof(float);
+			uint32 stride = MeshData::GetVertexStride(layout->Quantized);
+			const float * vertices = mesh.GetVertexBuffer();
+
+			float lo[3] = { FLT_MAX, FLT_MAX, FLT_MAX }, hi[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+			for (uint32 v = 0; v < numVertices; v++)
+			{
+				for (uint32 k = 0; k < 3; k++)
+				{
+					lo[k] = std::min(lo[k], vertices[v * floats + k]);
+					hi[k] = std::max(hi[k], vertices[v * floats + k]);
+				}
+			}
+			mesh.SetBBox(hi, lo);
+			PositionScale position(mesh);
+
+			std::vector<kByte> packed((size_t)numVertices * stride, 0);
+			Stats local = {};
+			for (uint32 v = 0; v < numVertices; v++)
+			{
+				const float * src = vertices + v * floats;
+				kByte * dst = packed.data() + (size_t)v * stride;
+				uint16 q[3];
+				for (uint32 k = 0; k < 3; k++)
+				{
+					float range = hi[k] - lo[k];
+					float scaled = range > 0.0f ? (src[k] - lo[k]) / range * 65535.0f : 0.0f;
+					q[k] = (uint16)std::min(std::max(scaled + 0.5f, 0.0f), 65535.0f);
+				}
+				memcpy(dst, q, sizeof(q));
+				if (layout->HasNormal)
+					EncodeOctahedral(src + layout->FloatNormal, (int8*)dst + 6);
+				if (layout->HasUV)
+				{
+					uint16 uv[2] = { FloatToHalf(src[layout->FloatUV]), FloatToHalf(src[layout->FloatUV + 1]) };
+					memcpy(dst + 8, uv, sizeof(uv));
+				}
+
+				float decoded[8];
+				DecodeVertex(dst, decoded, *layout, position);
+				for (uint32 k = 0; k < 3; k++)
+					local.MaxPositionError = std::max(local.MaxPositionError, fabsf(decoded[k] - src[k]));
+				if (layout->HasNormal)
+				{
+					float n[3] = { src[layout->FloatNormal], src[layout->FloatNormal + 1], src[layout->FloatNormal + 2] };
+					if (Dot(n, n) > 0.0f)
+					{
+						Normalize(n);
+						float match = std::min(Dot(n, decoded + layout->FloatNormal), 1.0f);
+						local.MaxNormalError = std::max(local.MaxNormalError, acosf(match) * 57.2957795f);
+					}
+				}
+				if (layout->HasUV)
+				{
+					for (uint32 k = 0; k < 2; k++)
+						local.MaxUVError = std::max(local.MaxUVError, fabsf(decoded[layout->FloatUV + k] - src[layout->FloatUV + k]));
+				}
+			}
+			local.FloatBytes = (uint64)numVertices * floats * sizeof(float);
+			local.QuantizedBytes = packed.size();
+
+			mesh.ReplaceVertexBuffer(layout->Quantized, (int)numVertices, packed.data());
+			if (stats)
+				*stats = local;
+			return true;
+		}
+
+		bool Decode(MeshData const& mesh, void * dst)
+		{
+			const Layout * layout = FindLayout(mesh.GetVertexFormat());
+			if (!layout || layout->Quantized != mesh.GetVertexFormat() || !mesh.GetVertexBuffer())
+				return false;
+			PositionScale position(mesh);
+			const kByte * src = (const kByte*)mesh.GetVertexBuffer();
+			uint32 stride = MeshData::GetVertexStride(layout->Quantized);
+			uint32 floats = MeshData::GetVertexStride(layout->Float) / sizeof(float);
+			uint32 count = (uint32)mesh.GetVertexNum();
+			float * out = (float*)dst;
+			uint32 v = 0;
+#if K3D_VERTEXCODEC_SSE2 || K3D_VERTEXCODEC_NEON
+			if (layout->HasNormal && layout->HasUV)
+				v = DecodeBlocks<true, true>(src, stride, out, count, position);
+			else if (layout->HasNormal)
+				v = DecodeBlocks<true, false>(src, stride, out, count, position);
+			else if (layout->HasUV)
+				v = DecodeBlocks<false, true>(src, stride, out, count, position);
+			else
+				v = DecodeBlocks<false, false>(src, stride, out, count, position);
+#endif
+			for (; v < count; v++)
+				DecodeVertex(src + (size_t)v * stride, out + (size_t)v * floats, *layout, position);
+			return true;
+		}
+
+		bool Dequantize(MeshData & mesh)
+		{
+			VtxFormat format = GetFloatFormat(mesh.GetVertexFormat());
+			uint32 numVertices = (uint32)mesh.GetVertexNum();
+			if (format == VtxFormat::PER_INSTANCE)
+				return false;
+			std::vector<float> vertices(MeshData::GetVertexByteWidth(format, numVertices) / sizeof(float));
+			if (!Decode(mesh, vertices.data()))
+				return false;
+			mesh.ReplaceVertexBuffer(format, (int)numVertices, vertices.data());
+			return true;
+		}
+
+		const char * GetDecodeKernel()
+		{
+#if K3D_VERTEXCODEC_SSE2
+			return "sse2";
+#elif K3D_VERTEXCODEC_NEON
+			return "neon";
+#else
+			return "scalar";
+#endif
+		}
+	}
+}
@@ -0,0 +1,68 @@
+#ifndef __VertexCodec_h__
+#define __VertexCodec_h__
+#pragma once
+
+#include <Interface/IMesh.h>
+
+namespace k3d
+{
+	class MeshData;
+
+	/// Quantized vertex formats (VtxFormat::POS3_U16...) and their codecs.
+	/// Positions are 16 bit unorm within the bounding box of the mesh, unit
+	/// vectors are octahedral snorm8 pairs, uvs half floats. Encoding runs in
+	/// the export pipeline, decoding for CPU side consumers uses SSE2 or NEON
+	/// where available, see GetDecodeKernel.
+	namespace VertexCodec
+	{
+		struct Stats
+		{
+			uint64	FloatBytes;
+			uint64	QuantizedBytes;
+			/// in mesh units
+			float	MaxPositionError;
+			/// in degrees
+			float	MaxNormalError;
+			float	MaxUVError;
+		};
+
+		/// the quantized format storing the attributes of a float one,
+		/// PER_INSTANCE if there is none
+		K3D_API VtxFormat	GetQuantizedFormat(VtxFormat format);
+		/// the float format a quantized one decodes to, PER_INSTANCE if 'format' isn't quantized
+		K3D_API VtxFormat	GetFloatFormat(VtxFormat format);
+
+		/// round to nearest even, out of range values become infinity
+		K3D_API uint16		FloatToHalf(float value);
+		K3D_API float		HalfToFloat(uint16 value);
+
+		/// unit vector (normal or tangent) to the closest of the octahedral
+		/// snorm8 pairs around it, about 0.6 degrees off at most
+		K3D_API void		EncodeOctahedral(const float vector[3], int8 oct[2]);
+		/// the result is normalized
+		K3D_API void		DecodeOctahedral(const int8 oct[2], float vector[3]);
+		/// 'count' unit vectors, the strides are in bytes
+		K3D_API void		DecodeOctahedral(float * dst, size_t dstStride, const int8 * oct, size_t octStride, uint32 count);
+
+		/// 4 skinning weights as unorm8 which sum up to 255 exactly
+		K3D_API void		EncodeWeights(const float weights[4], uint8 packed[4]);
+		/// 'count' weight quadruples to 4 floats each, 'stride' is the byte distance of the packed ones
+		K3D_API void		DecodeWeights(float * dst, const uint8 * packed, size_t stride, uint32 count);
+
+		/// Packs the vertices of a float mesh into GetQuantizedFormat() of its
+		/// format and sets the bounding box to the one the positions are
+		/// quantized in. Views are detached first.
+		/// \return false if the format has no quantized counterpart
+		K3D_API bool		Quantize(MeshData & mesh, Stats * stats = nullptr);
+		/// unpacks the vertices of a quantized mesh in GetFloatFormat() of its format
+		/// \param dst MeshData::GetVertexByteWidth(GetFloatFormat(format), vertexNum) bytes
+		K3D_API bool		Decode(MeshData const& mesh, void * dst);
+		/// turns a quantized mesh back into its float format
+		K3D_API bool		Dequantize(MeshData & mesh);
+
+		/// "sse2", "neon" or "scalar"
+		K3D_API const char *	GetDecodeKernel();
+	}
+}
+
+#endif
@@ -0,0 +1,411 @@
+#include "Kaleido3D.h"
+#include "VirtualFileSystem.h"
+#include "AssetManager.h"
+#include "Bundle.h"
+#include "Os.h"
+#include "LogUtil.h"
+#include "Utils/StringUtils.h"
+#include "Dispatch/ThreadPool.h"
+
+#include <algorithm>
+
+namespace k3d
+{
+	/// view into a mapping, the mapping outlives the asset
+	class MappedRangeAsset : public IAsset
+	{
+	public:
+		MappedRangeAsset(std::shared_ptr<Os::MemMapFile> const& file, uint64 offset, uint64 size)
+			: m_File(file), m_Data(file->FileData() + offset), m_Size(size), m_Pos(0)
+		{}
+
+		uint64		GetLength() override { return m_Size; }
+		const void*	GetBuffer() override { return m_Data; }
+
+		uint64 Read(void *data, uint64 size) override
+		{
+			size = std::min(size, m_Size - m_Pos);
+			memcpy(data, m_Data + m_Pos, (size_t)size);
+			m_Pos += size;
+			return size;
+		}
+
+		bool Seek(uint64 offset) override
+		{
+			if (offset > m_Size)
+				return false;
+			m_Pos = offset;
+			return true;
+		}
+
+	private:
+		std::shared_ptr<Os::MemMapFile>	m_File;
+		const kByte *					m_Data;
+		uint64							m_Size;
+		uint64							m_Pos;
+	};
+
+	class MemoryAsset : public IAsset
+	{
+	public:
+		explicit MemoryAsset(MemoryMount::Bytes const& bytes) : m_Bytes(bytes), m_Pos(0) {}
+
+		uint64		GetLength() override { return m_Bytes->size(); }
+		const void*	GetBuffer() override { return m_Bytes->data(); }
+
+		uint64 Read(void *data, uint64 size) override
+		{
+			size = std::min(size, (uint64)m_Bytes->size() - m_Pos);
+			memcpy(data, m_Bytes->data() + m_Pos, (size_t)size);
+			m_Pos += size;
+			return size;
+		}
+
+		bool Seek(uint64 offset) override
+		{
+			if (offset > m_Bytes->size())
+				return false;
+			m_Pos = offset;
+			return true;
+		}
+
+	private:
+		MemoryMount::Bytes	m_Bytes;
+		uint64				m_Pos;
+	};
+
+	//-------------------------------------------------------------------------------
+
+	void IMountPoint::NotifyChanged()
+	{
+		if (m_Owner)
+			m_Owner->InvalidateCache();
+	}
+
+	DirectoryMount::DirectoryMount(kString const& root)
+		: m_Root(root)
+	{
+		if (!m_Root.empty() && m_Root.back() != KT('/') && m_Root.back() != KT('\\'))
+			m_Root += KT('/');
+	}
+
+	bool DirectoryMount::Contains(kString const& relPath)
+	{
+		kString path = m_Root + relPath;
+#if K3DPLATFORM_OS_WIN
+		DWORD attrib = ::GetFileAttributesW(path.c_str());
+		return attrib != INVALID_FILE_ATTRIBUTES && !(attrib & FILE_ATTRIBUTE_DIRECTORY);
+#else
+		struct stat st;
+		return ::stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode);
+#endif
+	}
+
+	IAsset* DirectoryMount::Open(kString const& relPath)
+	{
+		auto file = std::make_shared<Os::MemMapFile>();
+		if (!file->Open((m_Root + relPath).c_str(), IORead))
+			return nullptr;
+		return new MappedRangeAsset(file, 0, (uint64)file->GetSize());
+	}
+
+	bool DirectoryMount::GetHostPath(kString const& relPath, kString & hostPath)
+	{
+		hostPath = m_Root + relPath;
+		return true;
+	}
+
+	//-------------------------------------------------------------------------------
+
+	BundleMount::BundleMount(const kchar * bundlePath)
+	{
+		EAssetVersion version;
+		if (AssetBundleReader::ReadVersion(bundlePath, version) && version == EAssetVersion::E20170601u)
+		{
+			std::unique_ptr<AssetBundleReader> reader(new AssetBundleReader);
+			if (!reader->Open(bundlePath))
+				return;
+			m_File = reader->GetFile();
+			m_Reader = std::move(reader);
+			return;
+		}
+		auto file = std::make_shared<Os::MemMapFile>();
+		if (!file->Open(bundlePath, IORead))
+		{
+			KLOG(Error, BundleMount, "Cann't open bundle (%s).", bundlePath);
+			return;
+		}
+		// version, table size, chunk table, then per chunk: type, data, end tag
+		const kByte * data = file->FileData();
+		uint64 size = (uint64)file->GetSize();
+		uint64 tableSize = 0;
+		if (size < sizeof(EAssetVersion) + sizeof(uint64))
+			return;
+		memcpy(&tableSize, data + sizeof(EAssetVersion), sizeof(uint64));
+		uint64 numChunks = tableSize / sizeof(AssetChunk);
+		uint64 offset = sizeof(EAssetVersion) + sizeof(uint64) + tableSize;
+		if (offset > size)
+			return;
+		for (uint64 i = 0; i < numChunks; i++)
+		{
+			AssetChunk chunk;
+			memcpy(&chunk, data + sizeof(EAssetVersion) + sizeof(uint64) + i * sizeof(AssetChunk), sizeof(AssetChunk));
+			ChunkRange range = { offset + sizeof(EAssetType), (uint64)chunk.Size };
+			offset += sizeof(EAssetType) + chunk.Size + sizeof(EAssetType);
+			if (chunk.Size < 0 || offset > size)
+			{
+				KLOG(Error, BundleMount, "Bundle (%s) is truncated.", bundlePath);
+				m_Chunks.clear();
+				return;
+			}
+			std::string name(chunk.Name, strnlen(chunk.Name, sizeof(chunk.Name)));
+			m_Chunks[kString(name.begin(), name.end())] = range;
+		}
+		m_File = file;
+	}
+
+	BundleMount::~BundleMount()
+	{
+	}
+
+	uint32 BundleMount::GetNumChunks() const
+	{
+		return m_Reader ? m_Reader->GetNumChunks() : (uint32)m_Chunks.size();
+	}
+
+	bool BundleMount::Contains(kString const& relPath)
+	{
+		if (m_Reader)
+		{
+			std::string name(relPath.begin(), relPath.end());
+			return m_Reader->Find(name.c_str(), name.size()).IsValid();
+		}
+		return m_Chunks.find(relPath) != m_Chunks.end();
+	}
+
+	IAsset* BundleMount::Open(kString const& relPath)
+	{
+		if (m_Reader)
+		{
+			std::string name(relPath.begin(), relPath.end());
+			auto view = m_Reader->Find(name.c_str(), name.size());
+			if (!view.IsValid())
+				return nullptr;
+			if (view.Compression != EChunkCompression::ENone)
+			{
+				auto bytes = std::make_shared<std::vector<kByte>>((size_t)view.RawSize);
+				if (!AssetBundleReader::Decode(view, bytes->data(), &Dispatch::ThreadPool::Global()))
+					return nullptr;
+				return new MemoryAsset(bytes);
+			}
+			return new MappedRangeAsset(m_File, view.Data - m_File->FileData(), view.Size);
+		}
+		auto iter = m_Chunks.find(relPath);
+		if (iter == m_Chunks.end())
+			return nullptr;
+		return new MappedRangeAsset(m_File, iter->second.Offset, iter->second.Size);
+	}
+
+	//-------------------------------------------------------------------------------
+
+	void MemoryMount::Add(kString const& relPath, Bytes const& bytes)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_Lock);
+			m_Files[relPath] = bytes;
+		}
+		NotifyChanged();
+	}
+
+	bool MemoryMount::Remove(kString const& relPath)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_Lock);
+			if (m_Files.erase(relPath) == 0)
+				return false;
+		}
+		NotifyChanged();
+		return true;
+	}
+
+	bool MemoryMount::Contains(kString const& relPath)
+	{
+		std::lock_guard<std::mutex> lock(m_Lock);
+		return m_Files.find(relPath) != m_Files.end();
+	}
+
+	IAsset* MemoryMount::Open(kString const& relPath)
+	{
+		std::lock_guard<std::mutex> lock(m_Lock);
+		auto iter = m_Files.find(relPath);
+		if (iter == m_Files.end())
+			return nullptr;
+		return new MemoryAsset(iter->second);
+	}
+
+	//-------------------------------------------------------------------------------
+
+	VirtualFileSystem::VirtualFileSystem()
+		: m_Generation(0)
+	{
+		memset(&m_Stats, 0, sizeof(m_Stats));
+	}
+
+	VirtualFileSystem::~VirtualFileSystem()
+	{
+		UnmountAll();
+	}
+
+	void VirtualFileSystem::Mount(kString const& virtualRoot, std::shared_ptr<IMountPoint> const& mount, int32 priority)
+	{
+		if (!mount)
+			return;
+		std::lock_guard<std::mutex> lock(m_Lock);
+		MountEntry entry;
+		entry.Root = virtualRoot.empty() ? virtualRoot : Normalize(virtualRoot.c_str());
+		if (!entry.Root.empty() && entry.Root.back() != KT('/'))
+			entry.Root += KT('/');
+		entry.Mount = mount;
+		entry.Priority = priority;
+		mount->m_Owner = this;
+		// after the mounts of the same priority
+		auto pos = std::find_if(m_Mounts.begin(), m_Mounts.end(),
+			[priority](MountEntry const& e) { return e.Priority < priority; });
+		m_Mounts.insert(pos, entry);
+		m_Cache.clear();
+		m_Generation++;
+	}
+
+	bool VirtualFileSystem::Unmount(IMountPoint * mount)
+	{
+		std::lock_guard<std::mutex> lock(m_Lock);
+		auto iter = std::find_if(m_Mounts.begin(), m_Mounts.end(),
+			[mount](MountEntry const& e) { return e.Mount.get() == mount; });
+		if (iter == m_Mounts.end())
+			return false;
+		iter->Mount->m_Owner = nullptr;
+		m_Mounts.erase(iter);
+		m_Cache.clear();
+		m_Generation++;
+		return true;
+	}
+
+	void VirtualFileSystem::UnmountAll()
+	{
+		std::lock_guard<std::mutex> lock(m_Lock);
+		for (auto & entry : m_Mounts)
+			entry.Mount->m_Owner = nullptr;
+		m_Mounts.clear();
+		m_Cache.clear();
+		m_Generation++;
+	}
+
+	uint32 VirtualFileSystem::GetNumMounts()
+	{
+		std::lock_guard<std::mutex> lock(m_Lock);
+		return (uint32)m_Mounts.size();
+	}
+
+	bool VirtualFileSystem::Exists(const kchar * path)
+	{
+		kString relPath;
+		return Resolve(path, relPath) != nullptr;
+	}
+
+	IAsset* VirtualFileSystem::Open(const kchar * path)
+	{
+		kString relPath;
+		auto mount = Resolve(path, relPath);
+		return mount ? mount->Open(relPath) : nullptr;
+	}
+
+	std::shared_ptr<IMountPoint> VirtualFileSystem::Resolve(const kchar * path, kString & relPath)
+	{
+		kString key = Normalize(path);
+		std::vector<MountEntry> mounts;
+		uint32 generation = 0;
+		{
+			std::lock_guard<std::mutex> lock(m_Lock);
+			m_Stats.NumLookups++;
+			auto iter = m_Cache.find(key);
+			if (iter != m_Cache.end())
+			{
+				m_Stats.NumCacheHits++;
+				if (!iter->second.Mount)
+					m_Stats.NumNegativeHits++;
+				relPath = iter->second.RelPath;
+				return iter->second.Mount;
+			}
+			mounts = m_Mounts;
+			generation = m_Generation;
+		}
+
+		// probe unlocked, directory mounts stat the disk
+		Resolution resolution;
+		uint32 numProbes = 0;
+		for (auto & entry : mounts)
+		{
+			if (key.compare(0, entry.Root.size(), entry.Root) != 0)
+				continue;
+			kString rel = key.substr(entry.Root.size());
+			numProbes++;
+			if (entry.Mount->Contains(rel))
+			{
+				resolution.Mount = entry.Mount;
+				resolution.RelPath = rel;
+				break;
+			}
+		}
+
+		std::lock_guard<std::mutex> lock(m_Lock);
+		m_Stats.NumMountProbes += numProbes;
+		if (generation == m_Generation)
+		{
+			// bound the cache, a full rebuild is cheap compared to the probes
+			if (m_Cache.size() >= (1u << 16))
+				m_Cache.clear();
+			m_Cache[key] = resolution;
+		}
+		relPath = resolution.RelPath;
+		return resolution.Mount;
+	}
+
+	void VirtualFileSystem::InvalidateCache()
+	{
+		std::lock_guard<std::mutex> lock(m_Lock);
+		m_Cache.clear();
+		m_Generation++;
+	}
+
+	VirtualFileSystem::Stats VirtualFileSystem::GetStats()
+	{
+		std::lock_guard<std::mutex> lock(m_Lock);
+		return m_Stats;
+	}
+
+	kString VirtualFileSystem::Normalize(const kchar * path)
+	{
+		kString result(path);
+		// "asset://a" is "asset/a", schemes are mount roots
+		size_t scheme = result.find(KT("://"));
+		if (scheme != kString::npos)
+			result.replace(scheme, 3, KT("/"));
+		std::replace(result.begin(), result.end(), KT('\\'), KT('/'));
+		kString normalized;
+		normalized.reserve(result.size());
+		for (size_t i = 0; i < result.size(); i++)
+		{
+			kchar c = result[i];
+			if (c == KT('/') && (normalized.empty() || normalized.back() == KT('/')))
+				continue;
+			if (c == KT('.') && (normalized.empty() || normalized.back() == KT('/'))
+				&& (i + 1 == result.size() || result[i + 1] == KT('/')))
+			{
+				i++;
+				continue;
+			}
+			normalized += c;
+		}
+		return normalized;
+	}
+}
@@ -0,0 +1,171 @@
+#ifndef __VirtualFileSystem_h__
+#define __VirtualFileSystem_h__
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace Os
+{
+	class	MemMapFile;
+}
+
+namespace k3d
+{
+	struct	IAsset;
+	class	AssetBundleReader;
+	class	VirtualFileSystem;
+
+	/// IMountPoint
+	/// A source of files for the VirtualFileSystem,
+	/// relative paths use '/' and have no leading separator
+	class K3D_API IMountPoint
+	{
+	public:
+		IMountPoint() : m_Owner(nullptr) {}
+		virtual ~IMountPoint() {}
+
+		virtual bool		Contains(kString const& relPath) = 0;
+		virtual IAsset*		Open(kString const& relPath) = 0;
+		/// path on disk, for mounts whose files can be opened directly
+		virtual bool		GetHostPath(kString const& relPath, kString & hostPath) { return false; }
+		virtual const char*	GetTypeName() const = 0;
+
+	protected:
+		/// drop cached resolutions after the content of the mount changed
+		void				NotifyChanged();
+
+	private:
+		friend class VirtualFileSystem;
+		VirtualFileSystem*	m_Owner;
+	};
+
+	/// DirectoryMount
+	/// Files under a root directory on disk
+	class K3D_API DirectoryMount : public IMountPoint
+	{
+	public:
+		explicit DirectoryMount(kString const& root);
+
+		bool		Contains(kString const& relPath) override;
+		IAsset*		Open(kString const& relPath) override;
+		bool		GetHostPath(kString const& relPath, kString & hostPath) override;
+		const char*	GetTypeName() const override { return "directory"; }
+
+	private:
+		kString		m_Root;
+	};
+
+	/// BundleMount
+	/// Chunks of a .bundle archive, addressed by chunk name. The bundle is
+	/// mapped once and assets are views into the mapping. Indexed (v2) bundles
+	/// are looked up through AssetBundleReader, v1 bundles are scanned on mount.
+	class K3D_API BundleMount : public IMountPoint
+	{
+	public:
+		explicit BundleMount(const kchar * bundlePath);
+		~BundleMount() override;
+
+		bool		IsValid() const { return m_File != nullptr; }
+		uint32		GetNumChunks() const;
+
+		bool		Contains(kString const& relPath) override;
+		IAsset*		Open(kString const& relPath) override;
+		const char*	GetTypeName() const override { return "bundle"; }
+
+	private:
+		struct ChunkRange
+		{
+			uint64	Offset;
+			uint64	Size;
+		};
+		std::shared_ptr<Os::MemMapFile>				m_File;
+		std::unique_ptr<AssetBundleReader>			m_Reader;
+		std::unordered_map<kString, ChunkRange>	m_Chunks;
+	};
+
+	/// MemoryMount
+	/// In-memory overlay, e.g. for generated or hot-patched files
+	class K3D_API MemoryMount : public IMountPoint
+	{
+	public:
+		typedef std::shared_ptr< const std::vector<kByte> > Bytes;
+
+		void		Add(kString const& relPath, Bytes const& bytes);
+		bool		Remove(kString const& relPath);
+
+		bool		Contains(kString const& relPath) override;
+		IAsset*		Open(kString const& relPath) override;
+		const char*	GetTypeName() const override { return "memory"; }
+
+	private:
+		std::mutex							m_Lock;
+		std::unordered_map<kString, Bytes>	m_Files;
+	};
+
+	/// VirtualFileSystem
+	/// Ordered mounts with a hashed path resolution cache. A path is resolved
+	/// once against the mounts, later lookups (found or not found) are one
+	/// hash probe until the mounts change.
+	/// Files created on disk after a negative lookup are not seen until
+	/// InvalidateCache() is called.
+	class K3D_API VirtualFileSystem
+	{
+	public:
+		struct Stats
+		{
+			uint64	NumLookups;
+			uint64	NumCacheHits;
+			uint64	NumNegativeHits;
+			uint64	NumMountProbes;
+		};
+
+		VirtualFileSystem();
+		~VirtualFileSystem();
+
+		/// \param virtualRoot prefix the mount is visible under, empty for the root
+		/// \param priority mounts are searched by descending priority, then mount order
+		void		Mount(kString const& virtualRoot, std::shared_ptr<IMountPoint> const& mount, int32 priority = 0);
+		bool		Unmount(IMountPoint * mount);
+		void		UnmountAll();
+		uint32		GetNumMounts();
+
+		bool		Exists(const kchar * path);
+		/// \return nullptr if no mount has the file
+		IAsset*		Open(const kchar * path);
+		/// the mount and its relative path which provide 'path'
+		std::shared_ptr<IMountPoint>	Resolve(const kchar * path, kString & relPath);
+
+		void		InvalidateCache();
+		Stats		GetStats();
+
+		/// '\\' to '/', "scheme://" to "scheme/", no leading "./" or '/', no "//"
+		static kString Normalize(const kchar * path);
+
+	private:
+		struct MountEntry
+		{
+			kString							Root;
+			std::shared_ptr<IMountPoint>	Mount;
+			int32							Priority;
+		};
+
+		struct Resolution
+		{
+			/// null for a negative entry
+			std::shared_ptr<IMountPoint>	Mount;
+			kString							RelPath;
+		};
+
+		std::mutex									m_Lock;
+		std::vector<MountEntry>						m_Mounts;
+		std::unordered_map<kString, Resolution>	m_Cache;
+		/// bumped by every change, resolutions of an older generation are not cached
+		uint32										m_Generation;
+		Stats										m_Stats;
+	};
+}
+
+#endif
@@ -1,6 +1,8 @@
 #include "Kaleido3D.h"
 #include "Camera.h"
 #include <Core/LogUtil.h>
+#include <Core/Meshlet.h>
+#include <Core/MeshSimplifier.h>
 #include <rapidjson/reader.h>
 #include <rapidjson/document.h>
 
@@ -225,4 +227,17 @@ namespace k3d
 			planes[i] = m_Planes[i].ToVec4();
 		}
 	}
-}
\ No newline at end of file
+
+	uint32 BaseCamera::CullMeshlets(MeshletData const& meshlets, uint32 * visible, MeshletCullStats * stats)
+	{
+		kMath::Vec4f planes[6];
+		GetFrustumPlanes(planes);
+		return k3d::CullMeshlets(meshlets, planes, m_CameraPosition, visible, stats);
+	}
+
+	uint32 BaseCamera::SelectLod(MeshLodData const& lods, const kMath::Vec3f& center, float viewportHeight, float maxPixelError)
+	{
+		float distance = kMath::Length(center - m_CameraPosition);
+		return lods.SelectLod(distance, MeshLodData::ProjectionScale(m_Fov, viewportHeight), maxPixelError);
+	}
+}
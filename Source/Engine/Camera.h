@@ -14,6 +14,10 @@ namespace kMath
 
 namespace k3d 
 {
+	class MeshletData;
+	struct MeshletCullStats;
+	class MeshLodData;
+
 	enum BoundType {
 		BO_YES,
 		BO_NO,
@@ -48,6 +52,10 @@ namespace k3d
 
 		BoundType IntersectBox(const kMath::AABB& aabb);
 		void GetFrustumPlanes(kMath::Vec4f planes[6]);
+		/// culls meshlets against the planes of the last CalcFrustumPlanes(), see k3d::CullMeshlets
+		uint32 CullMeshlets(MeshletData const& meshlets, uint32 * visible, MeshletCullStats * stats = nullptr);
+		/// the coarsest LOD of a mesh at 'center' within 'maxPixelError', see MeshLodData::SelectLod
+		uint32 SelectLod(MeshLodData const& lods, const kMath::Vec3f& center, float viewportHeight, float maxPixelError = 1.0f);
 
 		static BaseCamera* Load(const char* cameraJson);
 
@@ -1,5 +1,6 @@
 #include "Kaleido3D.h"
 #include "Engine.h"
+#include <Core/AssetManager.h>
 namespace k3d {
 
 	Engine::Engine()
@@ -16,6 +17,8 @@ namespace k3d {
 
 	void Engine::DoOnDrawFrame()
 	{
+		// reloaded assets are swapped in between two frames
+		AssetManager::Get().UpdateHotReload();
 	}
 
 
@@ -79,6 +79,7 @@ namespace
      DestColor,
      SrcAlpha,
      DestAlpha,
+     OneMinusSrcAlpha,
      BlendTypeNum
      */
     MTLBlendFactor g_BlendFactor[] = {
@@ -87,7 +88,8 @@ namespace
         MTLBlendFactorSourceColor,
         MTLBlendFactorDestinationColor,
         MTLBlendFactorSourceAlpha,
-        MTLBlendFactorDestinationAlpha
+        MTLBlendFactorDestinationAlpha,
+        MTLBlendFactorOneMinusSourceAlpha
     };
     /*
      Keep,
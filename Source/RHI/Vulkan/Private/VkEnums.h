@@ -51,7 +51,8 @@ VkBlendOp g_BlendOps[] = {
 VkBlendFactor g_Blend[] = {
   VK_BLEND_FACTOR_ZERO,      VK_BLEND_FACTOR_ONE,
   VK_BLEND_FACTOR_SRC_COLOR, VK_BLEND_FACTOR_DST_COLOR,
-  VK_BLEND_FACTOR_SRC_ALPHA, VK_BLEND_FACTOR_DST_ALPHA
+  VK_BLEND_FACTOR_SRC_ALPHA, VK_BLEND_FACTOR_DST_ALPHA,
+  VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA
 };
 
 VkCompareOp g_ComparisonFunc[] = {
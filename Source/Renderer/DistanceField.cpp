@@ -0,0 +1,800 @@
+#include "Kaleido3D.h"
+#include "DistanceField.h"
+#include <Core/Os.h>
+#include <Core/LogUtil.h>
+#include <Core/Bundle.h>
+#include <Core/Dispatch/ThreadPool.h>
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include FT_OUTLINE_H
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <string.h>
+
+namespace render
+{
+	namespace
+	{
+		const uint32 kFieldMagic = 0x4644334B; // "K3DF"
+		const uint32 kFieldVersion = 1;
+		const double kPi = 3.14159265358979323846;
+
+		struct Point
+		{
+			double	X;
+			double	Y;
+		};
+
+		inline Point operator+(Point a, Point b) { return { a.X + b.X, a.Y + b.Y }; }
+		inline Point operator-(Point a, Point b) { return { a.X - b.X, a.Y - b.Y }; }
+		inline Point operator*(double s, Point a) { return { s * a.X, s * a.Y }; }
+		inline double Dot(Point a, Point b) { return a.X * b.X + a.Y * b.Y; }
+		inline double Cross(Point a, Point b) { return a.X * b.Y - a.Y * b.X; }
+		inline double Length(Point a) { return std::sqrt(Dot(a, a)); }
+		inline Point Normalize(Point a)
+		{
+			double length = Length(a);
+			return length > 0.0 ? (1.0 / length) * a : Point{ 0.0, 0.0 };
+		}
+		inline double NonZeroSign(double value) { return value > 0.0 ? 1.0 : -1.0; }
+
+		/// channel masks of the MSDF edge colors
+		enum EColor : uint8
+		{
+			Black = 0,
+			Red = 1,
+			Green = 2,
+			Yellow = Red | Green,
+			Blue = 4,
+			Magenta = Red | Blue,
+			Cyan = Green | Blue,
+			White = Red | Green | Blue,
+		};
+
+		/// \brief signed distance of a point to an edge, positive on the side the
+		/// outline is filled for TrueType orientation
+		struct EdgeDistance
+		{
+			double	Distance;
+			/// |cos| between the edge and the direction to the point, 0 inside the
+			/// edge, breaks ties between edges meeting at a corner
+			double	Dot;
+			/// nearest parameter, outside [0, 1] beyond the ends
+			double	Param;
+		};
+
+		/// real roots of a x^2 + b x + c
+		int SolveQuadratic(double x[2], double a, double b, double c)
+		{
+			if (a == 0.0 || std::fabs(b) > 1e12 * std::fabs(a))
+			{
+				if (b == 0.0)
+					return 0;
+				x[0] = -c / b;
+				return 1;
+			}
+			double discriminant = b * b - 4.0 * a * c;
+			if (discriminant > 0.0)
+			{
+				discriminant = std::sqrt(discriminant);
+				x[0] = (-b + discriminant) / (2.0 * a);
+				x[1] = (-b - discriminant) / (2.0 * a);
+				return 2;
+			}
+			if (discriminant == 0.0)
+			{
+				x[0] = -b / (2.0 * a);
+				return 1;
+			}
+			return 0;
+		}
+
+		/// real roots of a x^3 + b x^2 + c x + d
+		int SolveCubic(double x[3], double a, double b, double c, double d)
+		{
+			if (a == 0.0 || std::fabs(b / a) >= 1e6)
+				return SolveQuadratic(x, b, c, d);
+			b /= a;
+			c /= a;
+			d /= a;
+			double b2 = b * b;
+			double q = (b2 - 3.0 * c) / 9.0;
+			double r = (b * (2.0 * b2 - 9.0 * c) + 27.0 * d) / 54.0;
+			double r2 = r * r, q3 = q * q * q;
+			b /= 3.0;
+			if (r2 < q3)
+			{
+				double t = std::acos(std::max(-1.0, std::min(1.0, r / std::sqrt(q3))));
+				double m = -2.0 * std::sqrt(q);
+				x[0] = m * std::cos(t / 3.0) - b;
+				x[1] = m * std::cos((t + 2.0 * kPi) / 3.0) - b;
+				x[2] = m * std::cos((t - 2.0 * kPi) / 3.0) - b;
+				return 3;
+			}
+			double u = (r < 0.0 ? 1.0 : -1.0) * std::pow(std::fabs(r) + std::sqrt(r2 - q3), 1.0 / 3.0);
+			double v = u == 0.0 ? 0.0 : q / u;
+			x[0] = u + v - b;
+			if (u == v || std::fabs(u - v) < 1e-12 * std::fabs(u + v))
+			{
+				x[1] = -0.5 * (u + v) - b;
+				return 2;
+			}
+			return 1;
+		}
+
+		struct Edge
+		{
+			/// 1 line, 2 quadratic, 3 cubic Bezier
+			int		Degree;
+			Point	P[4];
+			uint8	Color;
+			/// control point bounds, the curve stays inside
+			Point	Min;
+			Point	Max;
+
+			void UpdateBounds()
+			{
+				Min = Max = P[0];
+				for (int i = 1; i <= Degree; i++)
+				{
+					Min = { std::min(Min.X, P[i].X), std::min(Min.Y, P[i].Y) };
+					Max = { std::max(Max.X, P[i].X), std::max(Max.Y, P[i].Y) };
+				}
+			}
+
+			/// de Casteljau with its own parameter per level (blossom)
+			Point Blossom(double const* t) const
+			{
+				Point points[4] = { P[0], P[1], P[2], P[3] };
+				for (int level = 0; level < Degree; level++)
+					for (int i = 0; i < Degree - level; i++)
+						points[i] = points[i] + t[level] * (points[i + 1] - points[i]);
+				return points[0];
+			}
+
+			Point At(double t) const
+			{
+				double ts[3] = { t, t, t };
+				return Blossom(ts);
+			}
+
+			/// tangent, degenerate control points fall back to the chord
+			Point Direction(double t) const
+			{
+				Point direction;
+				switch (Degree)
+				{
+				case 1:
+					return P[1] - P[0];
+				case 2:
+					direction = (P[1] - P[0]) + t * ((P[2] - P[1]) - (P[1] - P[0]));
+					break;
+				default:
+				{
+					Point a = P[1] - P[0], b = P[2] - P[1], c = P[3] - P[2];
+					direction = (1.0 - t) * (1.0 - t) * a + 2.0 * (1.0 - t) * t * b + t * t * c;
+					if (direction.X == 0.0 && direction.Y == 0.0)
+						direction = t < 0.5 ? P[2] - P[0] : P[3] - P[1];
+					break;
+				}
+				}
+				if (direction.X == 0.0 && direction.Y == 0.0)
+					direction = P[Degree] - P[0];
+				return direction;
+			}
+
+			/// the part of the edge between t0 and t1
+			Edge Part(double t0, double t1) const
+			{
+				Edge part = *this;
+				for (int j = 0; j <= Degree; j++)
+				{
+					double ts[3];
+					for (int k = 0; k < Degree; k++)
+						ts[k] = k < Degree - j ? t0 : t1;
+					part.P[j] = Blossom(ts);
+				}
+				part.UpdateBounds();
+				return part;
+			}
+
+			EdgeDistance SignedDistance(Point p) const
+			{
+				if (Degree == 1)
+				{
+					Point aq = p - P[0], ab = P[1] - P[0];
+					double param = Dot(aq, ab) / Dot(ab, ab);
+					Point eq = (param > 0.5 ? P[1] : P[0]) - p;
+					double endpointDistance = Length(eq);
+					if (param > 0.0 && param < 1.0)
+					{
+						double ortho = Cross(aq, ab) / Length(ab);
+						if (std::fabs(ortho) < endpointDistance)
+							return { ortho, 0.0, param };
+					}
+					return { NonZeroSign(Cross(aq, ab)) * endpointDistance,
+						std::fabs(Dot(Normalize(ab), Normalize(eq))), param };
+				}
+
+				Point qa = P[0] - p;
+				Point start = Direction(0.0), end = Direction(1.0), last = P[Degree] - p;
+				double minDistance = NonZeroSign(Cross(start, qa)) * Length(qa);
+				double param = -Dot(qa, start) / Dot(start, start);
+				if (Length(last) < std::fabs(minDistance))
+				{
+					minDistance = NonZeroSign(Cross(end, last)) * Length(last);
+					param = 1.0 + Dot(p - P[Degree], end) / Dot(end, end);
+				}
+				if (Degree == 2)
+				{
+					// the nearest points solve (B(t) - p) . B'(t) = 0
+					Point ab = P[1] - P[0], br = P[2] - P[1] - ab;
+					double t[3];
+					int n = SolveCubic(t, Dot(br, br), 3.0 * Dot(ab, br), 2.0 * Dot(ab, ab) + Dot(qa, br), Dot(qa, ab));
+					for (int i = 0; i < n; i++)
+					{
+						if (t[i] <= 0.0 || t[i] >= 1.0)
+							continue;
+						Point qe = qa + 2.0 * t[i] * ab + t[i] * t[i] * br;
+						double distance = Length(qe);
+						if (distance <= std::fabs(minDistance))
+						{
+							minDistance = NonZeroSign(Cross(ab + t[i] * br, qe)) * distance;
+							param = t[i];
+						}
+					}
+				}
+				else
+				{
+					// Newton iterations from a few starts
+					Point ab = P[1] - P[0], br = P[2] - P[1] - ab, as = (P[3] - P[2]) - (P[2] - P[1]) - br;
+					for (int i = 0; i <= 4; i++)
+					{
+						double t = i / 4.0;
+						Point qe = qa + 3.0 * t * ab + 3.0 * t * t * br + t * t * t * as;
+						for (int step = 0; step < 4; step++)
+						{
+							Point d1 = 3.0 * ab + 6.0 * t * br + 3.0 * t * t * as;
+							Point d2 = 6.0 * br + 6.0 * t * as;
+							t -= Dot(qe, d1) / (Dot(d1, d1) + Dot(qe, d2));
+							if (t <= 0.0 || t >= 1.0)
+								break;
+							qe = qa + 3.0 * t * ab + 3.0 * t * t * br + t * t * t * as;
+							double distance = Length(qe);
+							if (distance < std::fabs(minDistance))
+							{
+								d1 = 3.0 * ab + 6.0 * t * br + 3.0 * t * t * as;
+								minDistance = NonZeroSign(Cross(d1, qe)) * distance;
+								param = t;
+							}
+						}
+					}
+				}
+				if (param >= 0.0 && param <= 1.0)
+					return { minDistance, 0.0, param };
+				if (param < 0.5)
+					return { minDistance, std::fabs(Dot(Normalize(start), Normalize(qa))), param };
+				return { minDistance, std::fabs(Dot(Normalize(end), Normalize(last))), param };
+			}
+
+			/// distance to the tangent line beyond the ends, keeps MSDF corners sharp
+			double PseudoDistance(EdgeDistance const& distance, Point p) const
+			{
+				if (distance.Param < 0.0)
+				{
+					Point dir = Normalize(Direction(0.0)), aq = p - P[0];
+					if (Dot(aq, dir) < 0.0)
+					{
+						double pseudo = Cross(aq, dir);
+						if (std::fabs(pseudo) <= std::fabs(distance.Distance))
+							return pseudo;
+					}
+				}
+				else if (distance.Param > 1.0)
+				{
+					Point dir = Normalize(Direction(1.0)), bq = p - P[Degree];
+					if (Dot(bq, dir) > 0.0)
+					{
+						double pseudo = Cross(bq, dir);
+						if (std::fabs(pseudo) <= std::fabs(distance.Distance))
+							return pseudo;
+					}
+				}
+				return distance.Distance;
+			}
+		};
+
+		typedef std::vector<Edge> Contour;
+
+		struct Shape
+		{
+			std::vector<Contour>	Contours;
+			/// 1 if the outline is filled right of its direction (TrueType), -1 if left
+			double					Orientation;
+		};
+
+		struct Decomposer
+		{
+			Shape*	Target;
+			Point	Last;
+
+			static Point ToPoint(const FT_Vector* v) { return { v->x / 64.0, v->y / 64.0 }; }
+
+			void Add(int degree, Point const* points)
+			{
+				Edge edge = {};
+				edge.Degree = degree;
+				edge.P[0] = Last;
+				for (int i = 0; i < degree; i++)
+					edge.P[i + 1] = points[i];
+				edge.Color = White;
+				edge.UpdateBounds();
+				Last = points[degree - 1];
+				// zero length edges have no direction
+				if (edge.Max.X > edge.Min.X || edge.Max.Y > edge.Min.Y)
+					Target->Contours.back().push_back(edge);
+			}
+
+			static int MoveTo(const FT_Vector* to, void* user)
+			{
+				Decomposer* self = (Decomposer*)user;
+				if (self->Target->Contours.empty() || !self->Target->Contours.back().empty())
+					self->Target->Contours.emplace_back();
+				self->Last = ToPoint(to);
+				return 0;
+			}
+
+			static int LineTo(const FT_Vector* to, void* user)
+			{
+				Point points[1] = { ToPoint(to) };
+				((Decomposer*)user)->Add(1, points);
+				return 0;
+			}
+
+			static int ConicTo(const FT_Vector* control, const FT_Vector* to, void* user)
+			{
+				Point points[2] = { ToPoint(control), ToPoint(to) };
+				((Decomposer*)user)->Add(2, points);
+				return 0;
+			}
+
+			static int CubicTo(const FT_Vector* control1, const FT_Vector* control2, const FT_Vector* to, void* user)
+			{
+				Point points[3] = { ToPoint(control1), ToPoint(control2), ToPoint(to) };
+				((Decomposer*)user)->Add(3, points);
+				return 0;
+			}
+		};
+
+		bool IsCorner(Point a, Point b)
+		{
+			// sin(3), directions turning by more than ~8 degrees
+			const double crossThreshold = 0.14112;
+			return Dot(a, b) <= 0.0 || std::fabs(Cross(a, b)) > crossThreshold;
+		}
+
+		/// next color of a spline, never 'banned' where a single channel is shared
+		uint8 SwitchColor(uint8 color, uint8 banned)
+		{
+			uint8 combined = color & banned;
+			if (combined == Red || combined == Green || combined == Blue)
+				return combined ^ White;
+			if (color == Black || color == White)
+				return Cyan;
+			int shifted = color << 1;
+			return (uint8)((shifted | shifted >> 3) & White);
+		}
+
+		/// -1, 0 or 1 for the first, middle and last third of n positions
+		int Trichotomy(int position, int n)
+		{
+			return int(3 + 2.875 * position / (n - 1) - 1.4375 + 0.5) - 3;
+		}
+
+		/// \brief colors the edges of every contour so that the two edges meeting
+		/// at a corner share exactly one channel
+		void ColorEdges(Shape& shape)
+		{
+			for (Contour& contour : shape.Contours)
+			{
+				std::vector<int> corners;
+				for (int i = 0; i < (int)contour.size(); i++)
+				{
+					Edge const& previous = contour[(i + contour.size() - 1) % contour.size()];
+					if (IsCorner(Normalize(previous.Direction(1.0)), Normalize(contour[i].Direction(0.0))))
+						corners.push_back(i);
+				}
+				if (corners.empty())
+				{
+					for (Edge& edge : contour)
+						edge.Color = White;
+				}
+				else if (corners.size() == 1)
+				{
+					// teardrop, split the contour in three around the corner
+					if (contour.size() < 3)
+					{
+						Contour parts;
+						for (int i = 0; i < (int)contour.size(); i++)
+						{
+							int index = (corners[0] + i) % contour.size();
+							for (int k = 0; k < 3; k++)
+								parts.push_back(contour[index].Part(k / 3.0, (k + 1) / 3.0));
+						}
+						contour.swap(parts);
+						corners[0] = 0;
+					}
+					const uint8 colors[3] = { Cyan, White, Magenta };
+					int n = (int)contour.size();
+					for (int i = 0; i < n; i++)
+						contour[(corners[0] + i) % n].Color = colors[1 + Trichotomy(i, n)];
+				}
+				else
+				{
+					int n = (int)contour.size(), numCorners = (int)corners.size(), spline = 0;
+					uint8 color = SwitchColor(White, Black), initial = color;
+					for (int i = 0; i < n; i++)
+					{
+						int index = (corners[0] + i) % n;
+						if (spline + 1 < numCorners && corners[spline + 1] == index)
+						{
+							spline++;
+							color = SwitchColor(color, spline == numCorners - 1 ? initial : (uint8)Black);
+						}
+						contour[index].Color = color;
+					}
+				}
+			}
+		}
+
+		inline double Median(double a, double b, double c)
+		{
+			return std::max(std::min(a, b), std::min(std::max(a, b), c));
+		}
+
+		inline uint8 Encode(double distance, double range)
+		{
+			double value = 0.5 + distance / (2.0 * range);
+			return (uint8)(std::max(0.0, std::min(1.0, value)) * 255.0 + 0.5);
+		}
+
+		/// \brief fills the W x H texels of 'glyph' with the field of 'shape'.
+		/// The sign comes from the nonzero winding of each row, distances from
+		/// the exact curves.
+		void Rasterize(Shape& shape, DistanceFieldFont::Glyph const& glyph, bool msdf, double range, uint8* texels)
+		{
+			if (msdf)
+				ColorEdges(shape);
+			std::vector<Edge const*> edges;
+			// rows cross the curves flattened finely enough for the sign
+			std::vector<Point> lines;
+			for (Contour const& contour : shape.Contours)
+			{
+				for (Edge const& edge : contour)
+				{
+					edges.push_back(&edge);
+					int steps = edge.Degree == 1 ? 1 : edge.Degree == 2 ? 8 : 16;
+					for (int s = 0; s < steps; s++)
+					{
+						lines.push_back(edge.At(s / (double)steps));
+						lines.push_back(edge.At((s + 1) / (double)steps));
+					}
+				}
+			}
+
+			uint32 channels = msdf ? 4 : 1;
+			std::vector<std::pair<double, int>> crossings;
+			for (uint32 row = 0; row < glyph.H; row++)
+			{
+				double y = glyph.Y - (double)row - 0.5;
+				crossings.clear();
+				for (size_t i = 0; i < lines.size(); i += 2)
+				{
+					Point a = lines[i], b = lines[i + 1];
+					if ((a.Y <= y) != (b.Y <= y))
+						crossings.push_back({ a.X + (y - a.Y) * (b.X - a.X) / (b.Y - a.Y), b.Y > a.Y ? 1 : -1 });
+				}
+				std::sort(crossings.begin(), crossings.end());
+				size_t next = 0;
+				int winding = 0;
+				for (uint32 column = 0; column < glyph.W; column++)
+				{
+					Point p = { glyph.X + (double)column + 0.5, y };
+					while (next < crossings.size() && crossings[next].first < p.X)
+						winding += crossings[next++].second;
+
+					double trueDistance = 1e30;
+					// nearest edge per channel, ties go to the edge pointing away from p
+					double best[3] = { 1e30, 1e30, 1e30 }, bestDot[3] = { 1, 1, 1 };
+					EdgeDistance nearest[3] = {};
+					Edge const* nearestEdge[3] = { nullptr, nullptr, nullptr };
+					for (Edge const* edge : edges)
+					{
+						// the curve is inside its control point bounds
+						double dx = std::max(0.0, std::max(edge->Min.X - p.X, p.X - edge->Max.X));
+						double dy = std::max(0.0, std::max(edge->Min.Y - p.Y, p.Y - edge->Max.Y));
+						double bound = std::sqrt(dx * dx + dy * dy);
+						double limit = trueDistance;
+						if (msdf)
+						{
+							for (int c = 0; c < 3; c++)
+								if (edge->Color & (1 << c))
+									limit = std::max(limit, best[c]);
+						}
+						if (bound > limit)
+							continue;
+						EdgeDistance distance = edge->SignedDistance(p);
+						double absolute = std::fabs(distance.Distance);
+						trueDistance = std::min(trueDistance, absolute);
+						if (!msdf)
+							continue;
+						for (int c = 0; c < 3; c++)
+						{
+							if ((edge->Color & (1 << c))
+								&& (absolute < best[c] || (absolute == best[c] && distance.Dot < bestDot[c])))
+							{
+								best[c] = absolute;
+								bestDot[c] = distance.Dot;
+								nearest[c] = distance;
+								nearestEdge[c] = edge;
+							}
+						}
+					}
+
+					double signedDistance = winding != 0 ? trueDistance : -trueDistance;
+					uint8* texel = texels + ((size_t)row * glyph.W + column) * channels;
+					if (!msdf)
+					{
+						texel[0] = Encode(signedDistance, range);
+						continue;
+					}
+					double rgb[3];
+					for (int c = 0; c < 3; c++)
+					{
+						rgb[c] = nearestEdge[c]
+							? shape.Orientation * nearestEdge[c]->PseudoDistance(nearest[c], p)
+							: signedDistance;
+					}
+					// the channels disagree with the outline at overlaps and clashes,
+					// the true distance is right there
+					if ((Median(rgb[0], rgb[1], rgb[2]) > 0.0) != (signedDistance > 0.0))
+						rgb[0] = rgb[1] = rgb[2] = signedDistance;
+					for (int c = 0; c < 3; c++)
+						texel[c] = Encode(rgb[c], range);
+					texel[3] = Encode(signedDistance, range);
+				}
+			}
+		}
+
+		std::atomic<uint32> s_NextFaceId(0x80000000u);
+	}
+
+	DistanceFieldFont::DistanceFieldFont()
+		: m_pFontLib(nullptr)
+		, m_pFontFace(nullptr)
+		, m_FaceId(s_NextFaceId++)
+		, m_FontHash()
+	{
+		FT_Init_FreeType((FT_Library*)&m_pFontLib);
+	}
+
+	DistanceFieldFont::~DistanceFieldFont()
+	{
+		if (m_pFontFace)
+			FT_Done_Face((FT_Face)m_pFontFace);
+		if (m_pFontLib)
+			FT_Done_FreeType((FT_Library)m_pFontLib);
+	}
+
+	bool DistanceFieldFont::Load(const char * fontPath, Options const & options)
+	{
+		if (m_pFontFace)
+		{
+			FT_Done_Face((FT_Face)m_pFontFace);
+			m_pFontFace = nullptr;
+		}
+		m_Glyphs.clear();
+		m_Texels.clear();
+		m_Options = options;
+		m_FaceId = s_NextFaceId++;
+
+		Os::File file;
+		if (!file.Open(fontPath, IORead))
+			return false;
+		std::vector<char> content((size_t)file.GetSize());
+		if (file.Read(content.data(), content.size()) != content.size())
+			return false;
+		m_FontHash = k3d::AssetCache::HashData(content.data(), content.size());
+		if (FT_New_Face((FT_Library)m_pFontLib, fontPath, 0, (FT_Face*)&m_pFontFace))
+		{
+			m_pFontFace = nullptr;
+			return false;
+		}
+		FT_Set_Pixel_Sizes((FT_Face)m_pFontFace, 0, m_Options.BaseSize);
+		return true;
+	}
+
+	bool DistanceFieldFont::Generate(const uint32 * codePoints, uint32 count, k3d::AssetCache * cache,
+		Dispatch::ThreadPool * workers, Stats * stats)
+	{
+		if (!m_pFontFace)
+			return false;
+		auto start = std::chrono::high_resolution_clock::now();
+		Stats result = {};
+		std::vector<uint32> sorted(codePoints, codePoints + count);
+		std::sort(sorted.begin(), sorted.end());
+		sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+
+		// the fields depend on the font content, the options and the glyph set
+		std::vector<uint32> params = { kFieldVersion, (uint32)m_Options.Mode, m_Options.BaseSize, m_Options.Range };
+		params.insert(params.end(), sorted.begin(), sorted.end());
+		k3d::AssetCacheKey key = k3d::AssetCache::MakeKey(m_FontHash, params.data(), params.size() * sizeof(uint32));
+		if (cache && cache->IsOpen() && LoadCache(*cache, key))
+		{
+			result.FromCache = true;
+		}
+		else
+		{
+			// FreeType isn't thread safe, the outlines are taken first
+			FT_Face face = (FT_Face)m_pFontFace;
+			FT_Outline_Funcs funcs = { &Decomposer::MoveTo, &Decomposer::LineTo, &Decomposer::ConicTo, &Decomposer::CubicTo, 0, 0 };
+			std::vector<Shape> shapes;
+			m_Glyphs.clear();
+			uint64 texels = 0;
+			int range = (int)m_Options.Range;
+			for (uint32 codePoint : sorted)
+			{
+				FT_UInt index = FT_Get_Char_Index(face, codePoint);
+				if (!index || FT_Load_Glyph(face, index, FT_LOAD_NO_HINTING | FT_LOAD_NO_BITMAP)
+					|| face->glyph->format != FT_GLYPH_FORMAT_OUTLINE)
+					continue;
+				FT_Outline& outline = face->glyph->outline;
+				Glyph glyph = { codePoint, 0, 0, 0, 0, face->glyph->advance.x / 64.0f, (uint32)texels };
+				Shape shape;
+				Decomposer decomposer = { &shape, { 0.0, 0.0 } };
+				FT_Outline_Decompose(&outline, &funcs, &decomposer);
+				shape.Contours.erase(std::remove_if(shape.Contours.begin(), shape.Contours.end(),
+					[](Contour const& contour) { return contour.empty(); }), shape.Contours.end());
+				shape.Orientation = FT_Outline_Get_Orientation(&outline) == FT_ORIENTATION_POSTSCRIPT ? -1.0 : 1.0;
+				if (!shape.Contours.empty())
+				{
+					FT_BBox box;
+					FT_Outline_Get_CBox(&outline, &box);
+					int left = (int)std::floor(box.xMin / 64.0) - range, right = (int)std::ceil(box.xMax / 64.0) + range;
+					int bottom = (int)std::floor(box.yMin / 64.0) - range, top = (int)std::ceil(box.yMax / 64.0) + range;
+					glyph.X = left;
+					glyph.Y = top;
+					glyph.W = right - left;
+					glyph.H = top - bottom;
+					texels += (uint64)glyph.W * glyph.H * GetChannels();
+				}
+				m_Glyphs.push_back(glyph);
+				shapes.push_back(std::move(shape));
+			}
+			m_Texels.assign((size_t)texels, 0);
+
+			Dispatch::ThreadPool & pool = workers ? *workers : Dispatch::ThreadPool::Global();
+			bool msdf = m_Options.Mode == EMode::MSDF;
+			pool.ParallelFor(0, (uint32)m_Glyphs.size(), 4, [&](uint32 begin, uint32 end)
+			{
+				for (uint32 i = begin; i < end; i++)
+				{
+					if (m_Glyphs[i].W)
+						Rasterize(shapes[i], m_Glyphs[i], msdf, m_Options.Range, m_Texels.data() + m_Glyphs[i].Offset);
+				}
+			});
+			result.Generated = (uint32)m_Glyphs.size();
+			if (cache && cache->IsOpen())
+				StoreCache(*cache, key);
+		}
+		result.Glyphs = (uint32)m_Glyphs.size();
+		result.Milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		if (stats)
+			*stats = result;
+		return true;
+	}
+
+	DistanceFieldFont::Glyph const * DistanceFieldFont::Find(uint32 codePoint) const
+	{
+		auto it = std::lower_bound(m_Glyphs.begin(), m_Glyphs.end(), codePoint,
+			[](Glyph const& glyph, uint32 value) { return glyph.CodePoint < value; });
+		return it != m_Glyphs.end() && it->CodePoint == codePoint ? &*it : nullptr;
+	}
+
+	GlyphAtlas::Glyph const * DistanceFieldFont::Acquire(uint32 codePoint, GlyphAtlas & atlas) const
+	{
+		Glyph const* glyph = Find(codePoint);
+		if (!glyph || atlas.GetChannels() != (int)GetChannels())
+			return nullptr;
+		// one entry serves every size
+		GlyphKey key = { m_FaceId, 0, codePoint };
+		GlyphAtlas::Glyph const* entry = atlas.Find(key);
+		if (entry)
+			return entry;
+		GlyphAtlas::Glyph metrics = { glyph->X, glyph->Y, (int)glyph->W, (int)glyph->H,
+			(int)std::lround(glyph->Advance), -1, 0, 0 };
+		return atlas.Insert(key, metrics, GetField(*glyph), (int)(glyph->W * GetChannels()));
+	}
+
+	float DistanceFieldFont::SampleCoverage(Glyph const & glyph, float x, float y, float pixelSize) const
+	{
+		if (!glyph.W)
+			return 0.0f;
+		float scale = m_Options.BaseSize / pixelSize;
+		// texel centers at whole numbers
+		float fx = x * scale - glyph.X - 0.5f, fy = glyph.Y - y * scale - 0.5f;
+		int x0 = (int)std::floor(fx), y0 = (int)std::floor(fy);
+		float tx = fx - x0, ty = fy - y0;
+		uint32 channels = GetChannels();
+		const uint8* field = GetField(glyph);
+		float value[3];
+		for (uint32 c = 0; c < std::min(channels, 3u); c++)
+		{
+			float texel[2][2];
+			for (int j = 0; j < 2; j++)
+				for (int i = 0; i < 2; i++)
+				{
+					int u = x0 + i, v = y0 + j;
+					// beyond the padding is outside
+					texel[j][i] = u < 0 || v < 0 || u >= (int)glyph.W || v >= (int)glyph.H ? 0.0f
+						: field[((size_t)v * glyph.W + u) * channels + c] / 255.0f;
+				}
+			value[c] = (texel[0][0] * (1 - tx) + texel[0][1] * tx) * (1 - ty) + (texel[1][0] * (1 - tx) + texel[1][1] * tx) * ty;
+		}
+		float sample = channels == 1 ? value[0] : (float)Median(value[0], value[1], value[2]);
+		float pixels = (sample - 0.5f) * GetShaderParams().DistanceSpan / scale;
+		return std::max(0.0f, std::min(1.0f, pixels + 0.5f));
+	}
+
+	bool DistanceFieldFont::LoadCache(k3d::AssetCache & cache, k3d::AssetCacheKey const & key)
+	{
+		k3d::AssetCacheEntry entry;
+		auto path = cache.Find(key, entry);
+		if (path.empty() || entry.Compression != (uint32)k3d::EChunkCompression::ENone)
+			return false;
+		Os::File file;
+		uint32 header[4];
+		if (!file.Open(path.c_str(), IORead)
+			|| file.ReadAt(header, sizeof(header), sizeof(entry)) != sizeof(header) || header[0] != kFieldMagic)
+			return false;
+		uint64 numTexels = header[2] | ((uint64)header[3] << 32);
+		if (entry.Size != sizeof(header) + header[1] * sizeof(Glyph) + numTexels)
+			return false;
+		std::vector<Glyph> glyphs(header[1]);
+		std::vector<uint8> texels((size_t)numTexels);
+		uint64 offset = sizeof(entry) + sizeof(header);
+		if (file.ReadAt(glyphs.data(), glyphs.size() * sizeof(Glyph), offset) != glyphs.size() * sizeof(Glyph)
+			|| file.ReadAt(texels.data(), texels.size(), offset + glyphs.size() * sizeof(Glyph)) != texels.size())
+			return false;
+		// a damaged entry must not point Find or GetField outside the set
+		uint64 channels = GetChannels();
+		for (size_t i = 0; i < glyphs.size(); i++)
+		{
+			Glyph const& glyph = glyphs[i];
+			if ((uint64)glyph.Offset + (uint64)glyph.W * glyph.H * channels > numTexels
+				|| (i > 0 && glyphs[i - 1].CodePoint >= glyph.CodePoint))
+				return false;
+		}
+		m_Glyphs.swap(glyphs);
+		m_Texels.swap(texels);
+		return true;
+	}
+
+	void DistanceFieldFont::StoreCache(k3d::AssetCache & cache, k3d::AssetCacheKey const & key) const
+	{
+		uint64 numTexels = m_Texels.size();
+		uint32 header[4] = { kFieldMagic, (uint32)m_Glyphs.size(), (uint32)numTexels, (uint32)(numTexels >> 32) };
+		std::vector<uint8> data(sizeof(header) + m_Glyphs.size() * sizeof(Glyph) + m_Texels.size());
+		memcpy(data.data(), header, sizeof(header));
+		if (!m_Glyphs.empty())
+			memcpy(data.data() + sizeof(header), m_Glyphs.data(), m_Glyphs.size() * sizeof(Glyph));
+		if (!m_Texels.empty())
+			memcpy(data.data() + sizeof(header) + m_Glyphs.size() * sizeof(Glyph), m_Texels.data(), m_Texels.size());
+		k3d::AssetCacheEntry entry = { k3d::kAssetCacheMagic, (uint32)k3d::EChunkCompression::ENone,
+			data.size(), data.size(), k3d::AssetCache::HashData(data.data(), data.size()) };
+		if (!cache.Store(key, entry, data.data()))
+			KLOG(Warn, DistanceFieldFont, "Unable to cache the glyph fields.");
+	}
+}
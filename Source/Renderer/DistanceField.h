@@ -0,0 +1,125 @@
+#pragma once
+#include "GlyphAtlas.h"
+#include <Core/AssetCache.h>
+#include <vector>
+
+namespace Dispatch
+{
+	class ThreadPool;
+}
+
+namespace render
+{
+	/// \brief Signed distance fields of the glyphs of a font, generated once at
+	/// a base size from the outlines so one atlas serves every text size.
+	///
+	/// SDF stores the distance to the outline in one channel. MSDF colors the
+	/// edges of each contour so corners meet in different channels, and
+	/// stores three pseudo distances with the true distance in alpha; the
+	/// median of the three keeps corners sharp under magnification. Values are
+	/// 0.5 + distance / (2 * Range), positive inside. Glyph sets are generated
+	/// in parallel and stored in an AssetCache keyed by the font content and
+	/// the options.
+	class K3D_API DistanceFieldFont
+	{
+	public:
+		enum class EMode : uint32
+		{
+			SDF,
+			MSDF,
+		};
+
+		struct Options
+		{
+			EMode	Mode;
+			/// em size in pixels the fields are generated at
+			uint32	BaseSize;
+			/// largest distance in pixels at BaseSize the field holds, also the
+			/// padding around every glyph
+			uint32	Range;
+
+			Options()
+				: Mode(EMode::MSDF)
+				, BaseSize(32)
+				, Range(4)
+			{
+			}
+		};
+
+		/// metrics in pixels at BaseSize
+		struct Glyph
+		{
+			uint32	CodePoint;
+			/// left and top edge of the field from the origin, y up
+			int32	X;
+			int32	Y;
+			/// field size in texels, 0 for glyphs without outline
+			uint32	W;
+			uint32	H;
+			float	Advance;
+			/// of the field in the texel data
+			uint32	Offset;
+		};
+
+		/// the uniform block of TextRenderSDF.frag, std140
+		struct ShaderParams
+		{
+			/// texels between the field values 0 and 1, 2 * Range
+			float	DistanceSpan;
+			/// GetChannels(), SDF is sampled from alpha and MSDF from the median of RGB
+			uint32	Channels;
+			float	Padding[2];
+		};
+
+		struct Stats
+		{
+			uint32	Glyphs;
+			/// glyphs generated, 0 if the set came from the cache
+			uint32	Generated;
+			bool	FromCache;
+			double	Milliseconds;
+		};
+
+		DistanceFieldFont();
+		~DistanceFieldFont();
+
+		/// \return false if the font can't be opened
+		bool				Load(const char* fontPath, Options const& options = Options());
+		/// \brief replaces the glyph set by the fields of 'codePoints' the font has.
+		/// \param cache read first and updated, if open
+		/// \param workers the global pool if null
+		bool				Generate(const uint32* codePoints, uint32 count, k3d::AssetCache* cache = nullptr,
+								Dispatch::ThreadPool* workers = nullptr, Stats* stats = nullptr);
+
+		Options const&		GetOptions() const { return m_Options; }
+		/// bytes per texel, 1 for SDF, 4 for MSDF
+		uint32				GetChannels() const { return m_Options.Mode == EMode::MSDF ? 4 : 1; }
+		/// what the text shader needs to match SampleCoverage
+		ShaderParams		GetShaderParams() const { return { 2.0f * m_Options.Range, GetChannels(), { 0.0f, 0.0f } }; }
+		uint32				GetNumGlyphs() const { return (uint32)m_Glyphs.size(); }
+		Glyph const*		Find(uint32 codePoint) const;
+		const uint8*		GetField(Glyph const& glyph) const { return m_Texels.data() + glyph.Offset; }
+
+		/// \brief copies the field into 'atlas', which must have GetChannels() channels.
+		/// Every text size uses the same entry, X, Y, W, H of the atlas glyph are at BaseSize.
+		GlyphAtlas::Glyph const*	Acquire(uint32 codePoint, GlyphAtlas& atlas) const;
+
+		/// \brief CPU reference of the text shader: coverage of a pixel of 'glyph'
+		/// drawn at 'pixelSize', from a bilinear field sample (median for MSDF).
+		/// \param x, y pixel center at 'pixelSize' from the glyph origin, y up
+		float				SampleCoverage(Glyph const& glyph, float x, float y, float pixelSize) const;
+
+	private:
+		bool				LoadCache(k3d::AssetCache& cache, k3d::AssetCacheKey const& key);
+		void				StoreCache(k3d::AssetCache& cache, k3d::AssetCacheKey const& key) const;
+
+		Options				m_Options;
+		void*				m_pFontLib;
+		void*				m_pFontFace;
+		uint32				m_FaceId;
+		k3d::AssetCacheKey	m_FontHash;
+		/// sorted by code point
+		std::vector<Glyph>	m_Glyphs;
+		std::vector<uint8>	m_Texels;
+	};
+}
@@ -1,6 +1,9 @@
 #include "Kaleido3D.h"
 #include "FontRenderer.h"
+#include <Core/AssetManager.h>
 #include <Core/Module.h>
+#include <Core/LogUtil.h>
+#include <memory>
 #include <ft2build.h>
 #include FT_FREETYPE_H
 
@@ -9,6 +12,8 @@ namespace render
 	FontManager::FontManager()
 		: m_PixelSize(0)
 		, m_Color(0xffffffff)
+		, m_FaceId(0)
+		, m_Frame(0)
 		, m_pFontLib(nullptr)
 		, m_pFontFace(nullptr)
 	{
@@ -29,19 +34,30 @@ namespace render
 		}
 	}
 
-	void FontManager::LoadLib(const char * fontPath)
+	bool FontManager::LoadLib(const char * fontPath)
 	{
 		if (m_pFontFace)
 		{
 			FT_Done_Face((FT_Face)m_pFontFace);
 			m_pFontFace = nullptr;
 		}
-		FT_New_Face((FT_Library)m_pFontLib, fontPath, 0, (FT_Face*)&m_pFontFace);
+		// glyphs of the previous face are keyed by the old id and age out of the atlas
+		m_FaceId++;
+		m_Failed.clear();
+		if (FT_New_Face((FT_Library)m_pFontLib, fontPath, 0, (FT_Face*)&m_pFontFace))
+		{
+			m_pFontFace = nullptr;
+			return false;
+		}
+		return true;
 	}
 
 	void FontManager::ChangeFontSize(int height)
 	{
-		FT_Set_Pixel_Sizes((FT_Face)m_pFontFace, 0, height);
+		if (m_pFontFace)
+			FT_Set_Pixel_Sizes((FT_Face)m_pFontFace, 0, height);
+		if (height != m_PixelSize)
+			m_Failed.clear();
 		m_PixelSize = height;
 	}
 
@@ -50,74 +66,158 @@ namespace render
 		m_Color = color;
 	}
 
-	unsigned int* GlyphTexture(const FT_Bitmap& bitmap, const unsigned int& color)
+	uint32 NextCodePoint(const unsigned char* text, uint64 length, uint64& i)
 	{
-		unsigned int* buffer = new unsigned int[bitmap.width * bitmap.rows * 4];
-		for (int y = 0; y< bitmap.rows; y++)
+		uint32 c = text[i++];
+		int follow = c >= 0xf0 ? 3 : c >= 0xe0 ? 2 : c >= 0xc0 ? 1 : 0;
+		if (!follow || i + follow > length)
+			return c;
+		uint32 cp = c & (0x3f >> follow);
+		for (int k = 0; k < follow; k++)
 		{
-			for (int x = 0; x < bitmap.width; x++)
-			{
-				unsigned int pixel = (color & 0xffffff00);
-				unsigned int alpha = bitmap.buffer[(y * bitmap.pitch) + x];
-				pixel |= alpha;
-				buffer[(y*bitmap.width) + x] = pixel;
-			}
+			if ((text[i + k] & 0xc0) != 0x80)
+				return c;
+			cp = (cp << 6) | (text[i + k] & 0x3f);
 		}
-		return buffer;
+		i += follow;
+		return cp;
 	}
 
 	TextQuads FontManager::AcquireText(const::k3d::String & text)
 	{
+		TextQuads quadlist;
+		AcquireText(text, quadlist);
+		return quadlist;
+	}
+
+	void FontManager::AcquireText(const::k3d::String & text, TextQuads & quads)
+	{
+		quads.Clear();
 		if(text.Length()==0 || !m_pFontFace)
-			return TextQuads();
+			return;
+		const unsigned char* bytes = (const unsigned char*)text.Data();
+		for (uint64 i = 0; i < text.Length(); )
+		{
+			GlyphAtlas::Glyph const* glyph = AcquireGlyph(NextCodePoint(bytes, text.Length(), i));
+			if (glyph)
+				quads.Append({ glyph->X, glyph->Y, glyph->W, glyph->H, glyph->HSpace, glyph->Page, glyph->U, glyph->V });
+		}
+	}
+
+	namespace
+	{
+		const uint64 kNever = ~0ull;
+	}
+
+	GlyphAtlas::Glyph const* FontManager::AcquireGlyph(uint32 codePoint)
+	{
+		if (!m_pFontFace)
+			return nullptr;
+		GlyphKey key = { m_FaceId, (uint32)m_PixelSize, codePoint };
+		GlyphAtlas::Glyph const* glyph = m_Atlas.Find(key);
+		if (glyph)
+			return glyph;
+		auto failed = m_Failed.find(key);
+		if (failed != m_Failed.end() && (failed->second == kNever || failed->second >= m_Frame))
+			return nullptr;
+		bool reported = failed != m_Failed.end();
 		FT_Face face = (FT_Face)m_pFontFace;
-		TextQuads quadlist;
-		for (unsigned int i = 0; i < text.Length(); i++) 
+		// embedded strikes would come out as 1 bit bitmaps
+		if (FT_Load_Char(face, codePoint, FT_LOAD_RENDER | FT_LOAD_NO_HINTING | FT_LOAD_NO_BITMAP))
 		{
-			FT_Load_Char(face, text[i], FT_LOAD_RENDER | FT_LOAD_NO_HINTING);
-			unsigned int *bytes = GlyphTexture(face->glyph->bitmap, m_Color);
-			int width = face->glyph->bitmap.width;
-			int height = face->glyph->bitmap.rows; 
-			int x = face->glyph->metrics.horiBearingX / m_PixelSize;
-			int y =	face->glyph->metrics.horiBearingY / m_PixelSize;
-			int next = face->glyph->metrics.horiAdvance / m_PixelSize;
-			quadlist.Append({ x,y, width, height, next, bytes});
+			m_Failed[key] = kNever;
+			return nullptr;
 		}
-		return quadlist;
+		FT_GlyphSlot slot = face->glyph;
+		FT_Bitmap const& bitmap = slot->bitmap;
+		if (bitmap.pixel_mode != FT_PIXEL_MODE_GRAY && bitmap.rows)
+		{
+			m_Failed[key] = kNever;
+			return nullptr;
+		}
+		// the bitmap sits on whole pixels around the outline, the advance is 26.6 fixed point
+		GlyphAtlas::Glyph metrics = {
+			slot->bitmap_left, slot->bitmap_top,
+			(int)bitmap.width, (int)bitmap.rows, (int)(slot->metrics.horiAdvance >> 6), -1, 0, 0 };
+		const uint8* rows = bitmap.buffer;
+		if (bitmap.pitch < 0 && bitmap.rows)
+			rows -= (ptrdiff_t)bitmap.pitch * (bitmap.rows - 1);
+		glyph = m_Atlas.Insert(key, metrics, rows, bitmap.pitch);
+		if (glyph)
+		{
+			if (reported)
+				m_Failed.erase(failed);
+			return glyph;
+		}
+		// larger than a page never fits, otherwise every page was in use this frame
+		// and a page may be evicted in the next one
+		int pageSize = m_Atlas.GetPageSize();
+		bool tooLarge = (int)bitmap.width + 1 > pageSize || (int)bitmap.rows + 1 > pageSize;
+		m_Failed[key] = tooLarge ? kNever : m_Frame;
+		if (!reported)
+			KLOG(Warn, FontManager, "Glyph %u doesn't fit into the atlas.", codePoint);
+		return nullptr;
+	}
+
+	int FontManager::GetKerning(uint32 left, uint32 right) const
+	{
+		FT_Face face = (FT_Face)m_pFontFace;
+		if (!face || !FT_HAS_KERNING(face))
+			return 0;
+		FT_Vector delta = {};
+		FT_Get_Kerning(face, FT_Get_Char_Index(face, left), FT_Get_Char_Index(face, right), FT_KERNING_DEFAULT, &delta);
+		return (int)(delta.x >> 6);
 	}
 
-	CharTexture::CharTexture(k3d::NGFXDeviceRef device, TextQuad const & quad)
+	int FontManager::GetLineHeight() const
+	{
+		FT_Face face = (FT_Face)m_pFontFace;
+		return face && face->size ? (int)(face->size->metrics.height >> 6) : m_PixelSize;
+	}
+
+	AtlasTexture::AtlasTexture(k3d::NGFXDeviceRef device, int size)
 	{
 		k3d::ResourceDesc texDesc;
 		texDesc.Type = NGFX_TEXTURE_2D;
 		texDesc.ViewFlags = NGFX_RESOURCE_SHADER_RESOURCE_VIEW;
 		texDesc.Flag = NGFX_ACCESS_HOST_VISIBLE;
-		texDesc.TextureDesc.Format = NGFX_PIXEL_FORMAT_RGBA8_UNORM; // TODO font color fmt inconsistent
-		texDesc.TextureDesc.Width = quad.W;
-		texDesc.TextureDesc.Height = quad.H;
+		texDesc.TextureDesc.Format = NGFX_PIXEL_FORMAT_RGBA8_UNORM; // no single channel format yet
+		texDesc.TextureDesc.Width = size;
+		texDesc.TextureDesc.Height = size;
 		texDesc.TextureDesc.Layers = 1;
 		texDesc.TextureDesc.MipLevels = 1;
 		texDesc.TextureDesc.Depth = 1;
 		m_Texture = ::k3d::DynamicPointerCast<k3d::NGFXTexture>(device->CreateResource(texDesc));
+		k3d::SRVDesc viewDesc;
+		m_Texture->SetResourceView(device->CreateShaderResourceView(k3d::StaticPointerCast<k3d::NGFXResource>(m_Texture), viewDesc));
+		// glyphs own a gutter, clamping keeps the page edges from wrapping around
+		k3d::SamplerState samplerDesc;
+		samplerDesc.U = samplerDesc.V = samplerDesc.W = NGFX_ADDRESS_MODE_CLAMP;
+		m_Texture->BindSampler(device->CreateSampler(samplerDesc));
+		m_Pending = { 0, 0, 0, 0 };
+	}
 
-		uint64 sz = m_Texture->GetSize();
-		void * pData = m_Texture->Map(0, sz);
+	void AtlasTexture::Update(k3d::NGFXDeviceRef device, GlyphAtlas const& atlas, int page, GlyphAtlas::Rect const& rect)
+	{
 		k3d::SubResourceLayout layout = {};
 		k3d::TextureSpec spec = { NGFX_ASPECT_COLOR,0,0 };
 		device->QueryTextureSubResourceLayout(m_Texture, spec, &layout);
-		if (quad.W * 4 == layout.RowPitch)
+		void * pData = m_Texture->Map(0, m_Texture->GetSize());
+		const uint8* coverage = atlas.GetPageData(page);
+		int pageSize = atlas.GetPageSize();
+		int channels = atlas.GetChannels();
+		for (int y = 0; y < rect.H; y++)
 		{
-			memcpy(pData, quad.Pixels, sz);
-		}
-		else
-		{
-			for (int y = 0; y < quad.H; y++)
+			uint32_t *row = (uint32_t *)((char *)pData + layout.RowPitch * (rect.Y + y)) + rect.X;
+			const uint8* src = coverage + ((rect.Y + y) * pageSize + rect.X) * channels;
+			if (channels == 4)
 			{
-				uint32_t *row = (uint32_t *)((char *)pData + layout.RowPitch * y);
-				for (int x = 0; x < quad.W; x++)
-				{
-					row[x] = quad.Pixels[x + y * quad.W];
-				}
+				memcpy(row, src, rect.W * 4);
+				continue;
+			}
+			for (int x = 0; x < rect.W; x++)
+			{
+				row[x] = 0x00ffffffu | ((uint32_t)src[x] << 24);
 			}
 		}
 		m_Texture->UnMap();
@@ -129,6 +229,28 @@ namespace render
 		cmd->Execute(false);
 #endif
 	}
+
+	void AtlasTexture::Invalidate(GlyphAtlas::Rect const& rect)
+	{
+		if (m_Pending.W == 0)
+		{
+			m_Pending = rect;
+			return;
+		}
+		int x1 = std::max(m_Pending.X + m_Pending.W, rect.X + rect.W), y1 = std::max(m_Pending.Y + m_Pending.H, rect.Y + rect.H);
+		m_Pending.X = std::min(m_Pending.X, rect.X);
+		m_Pending.Y = std::min(m_Pending.Y, rect.Y);
+		m_Pending.W = x1 - m_Pending.X;
+		m_Pending.H = y1 - m_Pending.Y;
+	}
+
+	void AtlasTexture::UpdatePending(k3d::NGFXDeviceRef device, GlyphAtlas const& atlas, int page)
+	{
+		if (m_Pending.W == 0)
+			return;
+		Update(device, atlas, page, m_Pending);
+		m_Pending = { 0, 0, 0, 0 };
+	}
 	
 	short CharRenderer::s_Indices[] = { 0, 1, 3, 2 };
 	
@@ -169,13 +291,49 @@ namespace render
 		m_IndexBuffer->UnMap();
 	}
 	
-	CharTexture::~CharTexture()
+	AtlasTexture::~AtlasTexture()
+	{
+	}
+
+	namespace
 	{
+		bool CompileShader(k3d::IShCompiler::Ptr const& compiler, const char* path, NGFXShaderType type, k3d::NGFXShaderBundle& shader)
+		{
+			std::unique_ptr<k3d::IAsset> file(k3d::AssetManager::Open(path));
+			uint64 length = file ? file->GetLength() : 0;
+			if (!length)
+			{
+				KLOG(Error, FontRenderer, "Error opening %s.", path);
+				return false;
+			}
+			std::vector<char> source(length + 1);
+			file->Read(source.data(), length);
+			source[length] = 0;
+			k3d::NGFXShaderDesc desc = { NGFX_SHADER_FORMAT_TEXT, NGFX_SHADER_LANG_GLSL, NGFX_SHADER_PROFILE_MODERN, type, "main" };
+			if (compiler->Compile(k3d::String(source.data()), desc, shader) != k3d::NGFX_SHADER_COMPILE_OK)
+			{
+				KLOG(Error, FontRenderer, "Error compiling %s.", path);
+				return false;
+			}
+			return true;
+		}
 	}
 
-	FontRenderer::FontRenderer(k3d::NGFXDeviceRef const& device)
+	FontRenderer::FontRenderer(k3d::NGFXDeviceRef const& device, uint32 framesInFlight)
 		: m_Device(device)
+		, m_Batcher(m_FontManager)
+		, m_Viewport()
+		, m_Frames(std::max(framesInFlight, 1u))
+		, m_FrameIndex(0)
 	{
+		for (auto& frame : m_Frames)
+		{
+			k3d::ResourceDesc uboDesc;
+			uboDesc.ViewFlags = NGFX_RESOURCE_CONSTANT_BUFFER_VIEW;
+			uboDesc.Flag = NGFX_ACCESS_HOST_COHERENT | NGFX_ACCESS_HOST_VISIBLE;
+			uboDesc.Size = sizeof(Viewport);
+			frame.ViewportBuffer = m_Device->CreateResource(uboDesc);
+		}
 	}
 	
 	FontRenderer::~FontRenderer()
@@ -188,14 +346,122 @@ namespace render
 		if (!shMod)
 			return;
 		auto glslc = shMod->CreateShaderCompiler(NGFX_RHI_VULKAN);
+		k3d::NGFXShaderBundle vertSh, fragSh;
+		if (!glslc
+			|| !CompileShader(glslc, "asset://Test/TextRender.vert", NGFX_SHADER_TYPE_VERTEX, vertSh)
+			|| !CompileShader(glslc, "asset://Test/TextRender.frag", NGFX_SHADER_TYPE_FRAGMENT, fragSh))
+			return;
+
+		m_PipelineLayout = m_Device->CreatePipelineLayout(vertSh.BindingTable | fragSh.BindingTable);
+		// groups obtained before belong to no layout
+		for (auto& frame : m_Frames)
+			frame.BindingGroups.assign(frame.BindingGroups.size(), nullptr);
+
+		k3d::RenderPipelineStateDesc desc;
+		k3d::AttachmentState attachment;
+		attachment.Blend.Enable = true;
+		attachment.Blend.Src = NGFX_BLEND_FACTOR_SRC_ALPHA;
+		attachment.Blend.Dest = NGFX_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+		attachment.Blend.SrcBlendAlpha = NGFX_BLEND_FACTOR_ONE;
+		attachment.Blend.DestBlendAlpha = NGFX_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+		desc.AttachmentsBlend.Append(attachment);
+		desc.Rasterizer.CullMode = NGFX_CULL_MODE_NONE;
+		desc.PrimitiveTopology = NGFX_PRIMITIVE_TRIANGLE_STRIP;
+		// one instance per glyph, the quad corners come from the vertex index
+		desc.InputState.Attribs[0] = { NGFX_VERTEX_FORMAT_FLOAT4X32, offsetof(TextBatcher::Instance, Rect), 0 };
+		desc.InputState.Attribs[1] = { NGFX_VERTEX_FORMAT_FLOAT4X32, offsetof(TextBatcher::Instance, UV), 0 };
+		desc.InputState.Attribs[2] = { NGFX_VERTEX_FORMAT_FLOAT4X32, offsetof(TextBatcher::Instance, Color), 0 };
+		desc.InputState.Layouts[0] = { NGFX_VERTEX_INPUT_RATE_PER_INSTANCE, sizeof(TextBatcher::Instance) };
+		desc.VertexShader = vertSh;
+		desc.PixelShader = fragSh;
+		m_TextRenderPSO = m_Device->CreateRenderPipelineState(desc, m_PipelineLayout, pRenderPass);
+	}
 
-    // compile shaders
+	void FontRenderer::SetViewport(int width, int height)
+	{
+		m_Viewport.InvSize[0] = width > 0 ? 1.0f / width : 0.0f;
+		m_Viewport.InvSize[1] = height > 0 ? 1.0f / height : 0.0f;
+	}
 
-    // create pso and binding groups
+	void FontRenderer::Begin()
+	{
+		m_FrameIndex = (m_FrameIndex + 1) % (uint32)m_Frames.size();
+		m_Batcher.Begin();
 	}
 
-  void FontRenderer::Draw(k3d::String const & Text, kMath::Vec3f Position)
-  {
-  }
+	void FontRenderer::Draw(k3d::String const & Text, kMath::Vec3f Position)
+	{
+		m_Batcher.AddText(Text, Position[0], Position[1], (uint32)m_FontManager.GetPaintColor());
+	}
+
+	void FontRenderer::Flush(k3d::NGFXRenderCommandEncoderRef const& encoder)
+	{
+		m_Batcher.End();
+		FrameResources& frame = m_Frames[m_FrameIndex];
+		UploadAtlas(frame);
+		uint64 size = m_Batcher.GetNumInstances() * sizeof(TextBatcher::Instance);
+		if (!size)
+			return;
+		if (!frame.InstanceBuffer || frame.InstanceBuffer->GetSize() < size)
+		{
+			k3d::ResourceDesc vboDesc;
+			vboDesc.ViewFlags = NGFX_RESOURCE_VERTEX_BUFFER_VIEW;
+			vboDesc.Flag = NGFX_ACCESS_HOST_COHERENT | NGFX_ACCESS_HOST_VISIBLE;
+			vboDesc.Size = size * 2;
+			frame.InstanceBuffer = m_Device->CreateResource(vboDesc);
+		}
+		void * ptr = frame.InstanceBuffer->Map(0, size);
+		m_Batcher.WriteInstances(ptr);
+		frame.InstanceBuffer->UnMap();
+		ptr = frame.ViewportBuffer->Map(0, sizeof(Viewport));
+		memcpy(ptr, &m_Viewport, sizeof(Viewport));
+		frame.ViewportBuffer->UnMap();
+		if (!m_TextRenderPSO || !encoder)
+			return;
+
+		encoder->SetPipelineState(0, m_TextRenderPSO);
+		encoder->SetPrimitiveType(NGFX_PRIMITIVE_TRIANGLE_STRIP);
+		k3d::VertexBufferView view = { frame.InstanceBuffer->GetLocation(), (uint32)size, sizeof(TextBatcher::Instance) };
+		encoder->SetVertexBuffer(0, view);
+		for (auto const& batch : m_Batcher.GetBatches())
+		{
+			encoder->SetBindingGroup(frame.BindingGroups[batch.Page]);
+			// the quad corners come from the vertex index
+			encoder->DrawInstanced(k3d::DrawInstancedParam(4, batch.Count, 0, batch.First));
+		}
+	}
+
+	void FontRenderer::UploadAtlas(FrameResources& frame)
+	{
+		GlyphAtlas& atlas = m_FontManager.GetAtlas();
+		for (int page = 0; page < atlas.GetNumPages(); page++)
+		{
+			GlyphAtlas::Rect rect;
+			if (atlas.GetDirtyRect(page, rect))
+			{
+				// every frame's copy of the page catches up when its frame comes around again
+				for (auto& other : m_Frames)
+				{
+					if (page < (int)other.AtlasTextures.size())
+						other.AtlasTextures[page].Invalidate(rect);
+				}
+				atlas.ClearDirty(page);
+			}
+			if (page == (int)frame.AtlasTextures.size())
+			{
+				// a new copy starts out with the whole page
+				frame.AtlasTextures.emplace_back(m_Device, atlas.GetPageSize());
+				frame.AtlasTextures.back().Invalidate({ 0, 0, atlas.GetPageSize(), atlas.GetPageSize() });
+				frame.BindingGroups.push_back(nullptr);
+			}
+			if (!frame.BindingGroups[page] && m_PipelineLayout)
+			{
+				frame.BindingGroups[page] = m_PipelineLayout->ObtainBindingGroup();
+				frame.BindingGroups[page]->Update(0, frame.ViewportBuffer);
+				frame.BindingGroups[page]->Update(1, k3d::StaticPointerCast<k3d::NGFXResource>(frame.AtlasTextures[page].GetTexture()));
+			}
+			frame.AtlasTextures[page].UpdatePending(m_Device, atlas, page);
+		}
+	}
 	
 }
\ No newline at end of file
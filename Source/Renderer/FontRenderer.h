@@ -4,7 +4,10 @@
 #include <KTL/String.hpp>
 #include <Math/kMath.hpp>
 
+#include "GlyphAtlas.h"
+#include "TextBatcher.h"
 #include <unordered_map>
+#include <vector>
 
 namespace render {
 class TextQuad
@@ -15,40 +18,84 @@ public:
   int W;
   int H;
   int HSpace;
-  unsigned int* Pixels;
+  /// atlas page and texel position, Page is -1 for blank glyphs
+  int Page;
+  int U;
+  int V;
 };
 
 typedef ::k3d::DynArray<TextQuad> TextQuads;
 
+/// decodes the UTF-8 sequence at 'i' and moves past it, bytes of broken sequences come out as they are
+uint32 NextCodePoint(const unsigned char* text, uint64 length, uint64& i);
+
 class K3D_API FontManager
 {
 public:
   FontManager();
   ~FontManager();
 
-  void LoadLib(const char* fontPath);
+  /// \return false if the font can't be opened
+  bool LoadLib(const char* fontPath);
   void ChangeFontSize(int height);
   void SetPaintColor(int color);
-
+  int GetPaintColor() const { return m_Color; }
+
+  /// glyphs acquired since the last call stay in the atlas until the next one
+  void BeginFrame()
+  {
+    m_Atlas.BeginFrame();
+    m_Frame++;
+  }
+  /// quads of the UTF-8 'text', only glyphs missing in the atlas are rasterized
   TextQuads AcquireText(const ::k3d::String& text);
+  /// as above, reusing the storage of 'quads'
+  void AcquireText(const ::k3d::String& text, TextQuads& quads);
+  /// \return the cached or newly rasterized glyph, null if it has none or doesn't fit,
+  /// failures aren't retried before the face or size changes, or the next frame
+  /// if the atlas was only full
+  GlyphAtlas::Glyph const* AcquireGlyph(uint32 codePoint);
+  /// horizontal adjustment between two code points in pixels
+  int GetKerning(uint32 left, uint32 right) const;
+  int GetLineHeight() const;
+  int GetPixelSize() const { return m_PixelSize; }
+  /// changes with every font loaded
+  uint32 GetFaceId() const { return m_FaceId; }
+
+  GlyphAtlas const& GetAtlas() const { return m_Atlas; }
+  GlyphAtlas& GetAtlas() { return m_Atlas; }
 
 private:
   int m_PixelSize;
   int m_Color;
+  uint32 m_FaceId;
+  uint64 m_Frame;
+  /// glyphs that failed, with the frame they may be retried after, or kNever
+  std::unordered_map<GlyphKey, uint64, GlyphKeyHash> m_Failed;
   void* m_pFontLib;
   void* m_pFontFace;
-  // Cache
+  GlyphAtlas m_Atlas;
 };
 
-class CharTexture
+/// RGBA8 copy of an atlas page, white with the coverage in alpha, or the
+/// distance field texels as they are
+class AtlasTexture
 {
 public:
-  CharTexture(k3d::NGFXDeviceRef device, TextQuad const& quad);
-  ~CharTexture();
+  AtlasTexture(k3d::NGFXDeviceRef device, int size);
+  ~AtlasTexture();
+  /// copies 'rect' of 'page' only
+  void Update(k3d::NGFXDeviceRef device, GlyphAtlas const& atlas, int page,
+              GlyphAtlas::Rect const& rect);
+  /// adds 'rect' to the texels copied by the next UpdatePending
+  void Invalidate(GlyphAtlas::Rect const& rect);
+  /// copies the texels invalidated since the last call
+  void UpdatePending(k3d::NGFXDeviceRef device, GlyphAtlas const& atlas, int page);
   k3d::NGFXTextureRef GetTexture() const { return m_Texture; }
 
 private:
   k3d::NGFXTextureRef m_Texture;
+  GlyphAtlas::Rect m_Pending;
 };
 
 class CharRenderer
@@ -71,18 +118,57 @@ private:
   k3d::NGFXResourceRef m_IndexBuffer;
 };
 
+/// The instances, the viewport and the atlas textures are kept once per frame
+/// in flight, so a frame never rewrites what the GPU may still read. The
+/// caller waits for its frame fence before starting more than 'framesInFlight'
+/// frames.
 class FontRenderer
 {
 public:
-  explicit FontRenderer(k3d::NGFXDeviceRef const& device);
+  explicit FontRenderer(k3d::NGFXDeviceRef const& device, uint32 framesInFlight = 2);
   ~FontRenderer();
+  /// builds the pipeline from TextRender.vert and TextRender.frag for 'pRenderPass'
   void InitPSO(k3d::NGFXRenderpassRef pRenderPass);
+  /// size of the render target in pixels
+  void SetViewport(int width, int height);
+  /// starts collecting the text of a frame, in the next set of frame resources
+  void Begin();
+  /// queues 'Text' at the pixel position, in the paint color
   void Draw(k3d::String const& Text, kMath::Vec3f Position);
+  /// uploads the atlas and the instances, and draws the queued text with one
+  /// instanced draw per atlas page
+  void Flush(k3d::NGFXRenderCommandEncoderRef const& encoder);
+
+  FontManager& GetFontManager() { return m_FontManager; }
+  TextBatcher const& GetBatcher() const { return m_Batcher; }
 
 private:
+  /// the uniform block of TextRender.vert, std140
+  struct Viewport
+  {
+    float InvSize[2];
+    float Padding[2];
+  };
+
+  struct FrameResources
+  {
+    k3d::NGFXResourceRef InstanceBuffer;
+    k3d::NGFXResourceRef ViewportBuffer;
+    std::vector<AtlasTexture> AtlasTextures;
+    /// per page, the viewport at binding 0 and the atlas texture at binding 1
+    std::vector<k3d::NGFXBindingGroupRef> BindingGroups;
+  };
+
+  /// uploads the dirty rects of the atlas pages to the textures of 'frame'
+  void UploadAtlas(FrameResources& frame);
+
   k3d::NGFXDeviceRef m_Device;
-  k3d::RenderPipelineStateRef m_TextRenderPSO;
+  k3d::NGFXPipelineStateRef m_TextRenderPSO;
+  k3d::NGFXPipelineLayoutRef m_PipelineLayout;
   FontManager m_FontManager;
-  std::unordered_map<char, CharTexture> m_TexCache;
+  TextBatcher m_Batcher;
+  Viewport m_Viewport;
+  std::vector<FrameResources> m_Frames;
+  uint32 m_FrameIndex;
 };
 }
\ No newline at end of file
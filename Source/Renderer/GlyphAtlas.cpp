@@ -0,0 +1,214 @@
+#include "Kaleido3D.h"
+#include "GlyphAtlas.h"
+#include <algorithm>
+#include <string.h>
+
+namespace render
+{
+	GlyphAtlas::GlyphAtlas(int pageSize, int maxPages, int channels)
+		: m_PageSize(pageSize)
+		, m_MaxPages(std::max(maxPages, 1))
+		, m_Channels(channels)
+		, m_Frame(1)
+		, m_Generation(0)
+		, m_Stats()
+	{
+	}
+
+	void GlyphAtlas::BeginFrame()
+	{
+		m_Frame++;
+	}
+
+	GlyphAtlas::Glyph const* GlyphAtlas::Find(GlyphKey const& key)
+	{
+		auto it = m_Glyphs.find(key);
+		if (it == m_Glyphs.end())
+		{
+			m_Stats.Misses++;
+			return nullptr;
+		}
+		m_Stats.Hits++;
+		if (it->second.Page >= 0)
+			Touch(it->second.Page);
+		return &it->second;
+	}
+
+	GlyphAtlas::Glyph const* GlyphAtlas::Insert(GlyphKey const& key, Glyph const& glyph, const uint8* coverage, int pitch)
+	{
+		auto it = m_Glyphs.find(key);
+		if (it != m_Glyphs.end())
+			return &it->second;
+		Glyph entry = glyph;
+		entry.Page = -1;
+		entry.U = entry.V = 0;
+		if (glyph.W <= 0 || glyph.H <= 0)
+		{
+			entry.W = entry.H = 0;
+			return &(m_Glyphs[key] = entry);
+		}
+		// right and bottom gutter, so filtering never reads the neighbours
+		int w = glyph.W + 1, h = glyph.H + 1;
+		if (w > m_PageSize || h > m_PageSize)
+			return nullptr;
+
+		int page = -1, x = 0, y = 0;
+		for (int i = 0; i < (int)m_Pages.size() && page < 0; i++)
+		{
+			if (Allocate(m_Pages[i], w, h, x, y))
+				page = i;
+		}
+		if (page < 0 && (int)m_Pages.size() < m_MaxPages)
+		{
+			m_Pages.emplace_back();
+			m_Stats.PageAllocations++;
+			page = (int)m_Pages.size() - 1;
+			m_Pages[page].Pixels.resize((size_t)m_PageSize * m_PageSize * m_Channels);
+			Reset(m_Pages[page]);
+			Allocate(m_Pages[page], w, h, x, y);
+		}
+		if (page < 0)
+		{
+			for (int i = 0; i < (int)m_Pages.size(); i++)
+			{
+				if (m_Pages[i].LastUse < m_Frame && (page < 0 || m_Pages[i].LastUse < m_Pages[page].LastUse))
+					page = i;
+			}
+			if (page < 0)
+				return nullptr;
+			Reset(m_Pages[page]);
+			m_Stats.Evictions++;
+			m_Generation++;
+			Allocate(m_Pages[page], w, h, x, y);
+		}
+
+		Page& target = m_Pages[page];
+		size_t rowBytes = (size_t)glyph.W * m_Channels;
+		for (int row = 0; row < glyph.H; row++)
+		{
+			uint8* dst = target.Pixels.data() + ((size_t)(y + row) * m_PageSize + x) * m_Channels;
+			memcpy(dst, coverage + (ptrdiff_t)row * pitch, rowBytes);
+			memset(dst + rowBytes, 0, m_Channels);
+		}
+		memset(target.Pixels.data() + ((size_t)(y + glyph.H) * m_PageSize + x) * m_Channels, 0, (size_t)w * m_Channels);
+
+		Rect& dirty = target.Dirty;
+		if (dirty.W == 0)
+		{
+			dirty = { x, y, w, h };
+		}
+		else
+		{
+			int x1 = std::max(dirty.X + dirty.W, x + w), y1 = std::max(dirty.Y + dirty.H, y + h);
+			dirty.X = std::min(dirty.X, x);
+			dirty.Y = std::min(dirty.Y, y);
+			dirty.W = x1 - dirty.X;
+			dirty.H = y1 - dirty.Y;
+		}
+		target.Keys.push_back(key);
+		Touch(page);
+
+		entry.Page = page;
+		entry.U = x;
+		entry.V = y;
+		return &(m_Glyphs[key] = entry);
+	}
+
+	void GlyphAtlas::Clear()
+	{
+		m_Glyphs.clear();
+		m_Pages.clear();
+		m_Generation++;
+	}
+
+	bool GlyphAtlas::GetDirtyRect(int page, Rect& rect) const
+	{
+		rect = m_Pages[page].Dirty;
+		return rect.W > 0;
+	}
+
+	void GlyphAtlas::ClearDirty(int page)
+	{
+		m_Pages[page].Dirty = { 0, 0, 0, 0 };
+	}
+
+	void GlyphAtlas::ResetStats()
+	{
+		m_Stats = Stats();
+	}
+
+	bool GlyphAtlas::Allocate(Page& page, int w, int h, int& x, int& y)
+	{
+		std::vector<Node>& nodes = page.Skyline;
+		int best = -1, bestTop = m_PageSize + 1, bestWidth = m_PageSize + 1;
+		for (int i = 0; i < (int)nodes.size(); i++)
+		{
+			if (nodes[i].X + w > m_PageSize)
+				break;
+			// lowest top over the nodes the glyph spans
+			int top = 0, left = w;
+			for (int j = i; left > 0; j++)
+			{
+				top = std::max(top, nodes[j].Y);
+				left -= nodes[j].W;
+			}
+			if (top + h > m_PageSize)
+				continue;
+			if (top + h < bestTop || (top + h == bestTop && nodes[i].W < bestWidth))
+			{
+				best = i;
+				bestTop = top + h;
+				bestWidth = nodes[i].W;
+				x = nodes[i].X;
+				y = top;
+			}
+		}
+		if (best < 0)
+			return false;
+
+		nodes.insert(nodes.begin() + best, Node{ x, y + h, w });
+		// cut the nodes now below the new one
+		for (size_t i = best + 1; i < nodes.size(); )
+		{
+			int edge = nodes[i - 1].X + nodes[i - 1].W;
+			if (nodes[i].X >= edge)
+				break;
+			int shrink = edge - nodes[i].X;
+			nodes[i].X += shrink;
+			nodes[i].W -= shrink;
+			if (nodes[i].W > 0)
+				break;
+			nodes.erase(nodes.begin() + i);
+		}
+		for (size_t i = 0; i + 1 < nodes.size(); )
+		{
+			if (nodes[i].Y == nodes[i + 1].Y)
+			{
+				nodes[i].W += nodes[i + 1].W;
+				nodes.erase(nodes.begin() + i + 1);
+			}
+			else
+			{
+				i++;
+			}
+		}
+		return true;
+	}
+
+	void GlyphAtlas::Reset(Page& page)
+	{
+		for (GlyphKey const& key : page.Keys)
+			m_Glyphs.erase(key);
+		page.Keys.clear();
+		page.Skyline.assign(1, Node{ 0, 0, m_PageSize });
+		// wasted space under the skyline must not keep pixels of evicted glyphs
+		memset(page.Pixels.data(), 0, page.Pixels.size());
+		page.Dirty = { 0, 0, m_PageSize, m_PageSize };
+		page.LastUse = 0;
+	}
+
+	void GlyphAtlas::Touch(int page)
+	{
+		m_Pages[page].LastUse = m_Frame;
+	}
+}
@@ -0,0 +1,132 @@
+#pragma once
+#include <vector>
+#include <unordered_map>
+
+namespace render
+{
+	/// identifies a rasterized glyph, Face changes with every font loaded
+	struct GlyphKey
+	{
+		uint32	Face;
+		uint32	Size;
+		uint32	CodePoint;
+
+		bool operator==(GlyphKey const& rhs) const
+		{
+			return Face == rhs.Face && Size == rhs.Size && CodePoint == rhs.CodePoint;
+		}
+	};
+
+	struct GlyphKeyHash
+	{
+		size_t operator()(GlyphKey const& key) const
+		{
+			uint64 h = ((uint64)key.Face << 48) ^ ((uint64)key.Size << 32) ^ key.CodePoint;
+			h ^= h >> 33;
+			h *= 0xff51afd7ed558ccdull;
+			h ^= h >> 33;
+			return (size_t)h;
+		}
+	};
+
+	/// \brief 8 bit coverage (or 4 channel distance field) pages shared by all
+	/// glyphs of a font manager.
+	/// Glyphs are packed bottom-left on a skyline with a one texel gutter. When
+	/// every page is full, the least recently used page is emptied and packed
+	/// again: skyline space can't be given back glyph by glyph, and a glyph kept
+	/// alive by text drawn every frame keeps its whole page. Pages touched in the
+	/// current frame are never evicted, so glyphs returned since the last
+	/// BeginFrame stay valid until the next one.
+	class K3D_API GlyphAtlas
+	{
+	public:
+		struct Rect
+		{
+			int		X;
+			int		Y;
+			int		W;
+			int		H;
+		};
+
+		struct Glyph
+		{
+			/// bearing, size and advance in pixels
+			int		X;
+			int		Y;
+			int		W;
+			int		H;
+			int		HSpace;
+			/// -1 for glyphs without pixels
+			int		Page;
+			int		U;
+			int		V;
+		};
+
+		struct Stats
+		{
+			uint64	Hits;
+			uint64	Misses;
+			/// pages emptied for new glyphs
+			uint64	Evictions;
+			/// pages created, the only allocations after warm up
+			uint64	PageAllocations;
+		};
+
+		/// \param channels bytes per texel, 1 for coverage, 4 for MSDF fields
+		GlyphAtlas(int pageSize = 512, int maxPages = 4, int channels = 1);
+
+		/// starts a frame, glyphs found or inserted before are candidates for eviction again
+		void				BeginFrame();
+		/// \return null if 'key' isn't cached
+		Glyph const*		Find(GlyphKey const& key);
+		/// \brief copies 'coverage' (glyph.W x glyph.H texels, 'pitch' bytes per row) into a page.
+		/// \return null if the glyph is larger than a page, or every page was used this frame
+		Glyph const*		Insert(GlyphKey const& key, Glyph const& glyph, const uint8* coverage, int pitch);
+		/// keeps 'page' from eviction this frame, for users holding on to glyphs without Find
+		void				Touch(int page);
+		/// drops every glyph and page
+		void				Clear();
+		/// changes whenever glyphs are evicted or cleared, positions taken before are stale then
+		uint64				GetGeneration() const { return m_Generation; }
+
+		int					GetPageSize() const { return m_PageSize; }
+		int					GetChannels() const { return m_Channels; }
+		int					GetNumPages() const { return (int)m_Pages.size(); }
+		const uint8*		GetPageData(int page) const { return m_Pages[page].Pixels.data(); }
+		/// \return false if 'page' didn't change since the last ClearDirty
+		bool				GetDirtyRect(int page, Rect& rect) const;
+		void				ClearDirty(int page);
+
+		Stats const&		GetStats() const { return m_Stats; }
+		void				ResetStats();
+
+	private:
+		struct Node
+		{
+			int		X;
+			int		Y;
+			int		W;
+		};
+
+		struct Page
+		{
+			std::vector<uint8>		Pixels;
+			std::vector<Node>		Skyline;
+			std::vector<GlyphKey>	Keys;
+			uint64					LastUse;
+			Rect					Dirty;
+		};
+
+		bool				Allocate(Page& page, int w, int h, int& x, int& y);
+		void				Reset(Page& page);
+
+		int					m_PageSize;
+		int					m_MaxPages;
+		int					m_Channels;
+		uint64				m_Frame;
+		uint64				m_Generation;
+		std::vector<Page>	m_Pages;
+		std::unordered_map<GlyphKey, Glyph, GlyphKeyHash>	m_Glyphs;
+		Stats				m_Stats;
+	};
+}
@@ -0,0 +1,155 @@
+#include "Kaleido3D.h"
+#include "TextBatcher.h"
+#include "FontRenderer.h"
+#include <chrono>
+#include <string.h>
+
+namespace render
+{
+	TextBatcher::TextBatcher(FontManager& fonts, Options const& options)
+		: m_Fonts(fonts)
+		, m_Options(options)
+		, m_Frame(0)
+		, m_Stats()
+	{
+	}
+
+	void TextBatcher::Begin()
+	{
+		m_Frame++;
+		m_Fonts.BeginFrame();
+		for (auto& page : m_Pages)
+			page.clear();
+		m_Batches.clear();
+		m_Stats = Stats();
+		if (m_Options.KeepFrames && m_Frame % m_Options.KeepFrames == 0)
+		{
+			for (auto it = m_Layouts.begin(); it != m_Layouts.end(); )
+			{
+				if (it->second.LastFrame + m_Options.KeepFrames < m_Frame)
+					it = m_Layouts.erase(it);
+				else
+					++it;
+			}
+		}
+	}
+
+	void TextBatcher::AddText(::k3d::String const& text, float x, float y, uint32 color)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		m_Stats.Strings++;
+		if (!m_Options.CacheLayouts)
+		{
+			Build(text, m_Scratch);
+			m_Stats.LayoutMisses++;
+			Emit(m_Scratch, x, y, color);
+		}
+		else
+		{
+			uint32 face = m_Fonts.GetFaceId();
+			int size = m_Fonts.GetPixelSize();
+			uint64 key = std::hash<::k3d::String>()(text) ^ ((uint64)face << 40) ^ ((uint64)size << 24);
+			Layout& layout = m_Layouts[key];
+			if (layout.Face != face || layout.Size != size
+				|| layout.Generation != m_Fonts.GetAtlas().GetGeneration()
+				|| layout.Text.size() != text.Length()
+				|| memcmp(layout.Text.data(), text.Data(), layout.Text.size()))
+			{
+				Build(text, layout);
+				layout.Text.assign(text.Data(), (size_t)text.Length());
+				m_Stats.LayoutMisses++;
+			}
+			else
+			{
+				m_Stats.LayoutHits++;
+			}
+			layout.LastFrame = m_Frame;
+			Emit(layout, x, y, color);
+		}
+		m_Stats.Milliseconds += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	void TextBatcher::End()
+	{
+		uint32 first = 0;
+		for (int page = 0; page < (int)m_Pages.size(); page++)
+		{
+			uint32 count = (uint32)m_Pages[page].size();
+			if (count)
+				m_Batches.push_back({ page, first, count });
+			first += count;
+		}
+		m_Stats.Instances = first;
+		m_Stats.Batches = (uint32)m_Batches.size();
+	}
+
+	void TextBatcher::WriteInstances(void* dst) const
+	{
+		Instance* out = (Instance*)dst;
+		for (auto const& page : m_Pages)
+		{
+			if (!page.empty())
+				memcpy(out, page.data(), page.size() * sizeof(Instance));
+			out += page.size();
+		}
+	}
+
+	void TextBatcher::Build(::k3d::String const& text, Layout& layout)
+	{
+		layout.Glyphs.clear();
+		layout.Face = m_Fonts.GetFaceId();
+		layout.Size = m_Fonts.GetPixelSize();
+		const unsigned char* bytes = (const unsigned char*)text.Data();
+		float scale = 1.0f / m_Fonts.GetAtlas().GetPageSize();
+		int lineHeight = m_Fonts.GetLineHeight();
+		int penX = 0, penY = 0;
+		uint32 previous = 0;
+		for (uint64 i = 0; i < text.Length(); )
+		{
+			uint32 codePoint = NextCodePoint(bytes, text.Length(), i);
+			if (codePoint == '\n')
+			{
+				penX = 0;
+				penY += lineHeight;
+				previous = 0;
+				continue;
+			}
+			if (previous)
+				penX += m_Fonts.GetKerning(previous, codePoint);
+			previous = codePoint;
+			GlyphAtlas::Glyph const* glyph = m_Fonts.AcquireGlyph(codePoint);
+			if (!glyph)
+				continue;
+			if (glyph->Page >= 0)
+			{
+				Placed placed = {
+					{ (float)(penX + glyph->X), (float)(penY - glyph->Y), (float)glyph->W, (float)glyph->H },
+					{ glyph->U * scale, glyph->V * scale, (glyph->U + glyph->W) * scale, (glyph->V + glyph->H) * scale },
+					glyph->Page };
+				layout.Glyphs.push_back(placed);
+			}
+			penX += glyph->HSpace;
+		}
+		// glyphs inserted for this layout may have evicted others, but never its own
+		layout.Generation = m_Fonts.GetAtlas().GetGeneration();
+	}
+
+	void TextBatcher::Emit(Layout const& layout, float x, float y, uint32 color)
+	{
+		GlyphAtlas& atlas = m_Fonts.GetAtlas();
+		float rgba[4] = {
+			(color >> 24) / 255.0f, ((color >> 16) & 0xff) / 255.0f,
+			((color >> 8) & 0xff) / 255.0f, (color & 0xff) / 255.0f };
+		for (Placed const& placed : layout.Glyphs)
+		{
+			if (placed.Page >= (int)m_Pages.size())
+				m_Pages.resize(placed.Page + 1);
+			// cached layouts skip Find, their pages must stay for this frame all the same
+			atlas.Touch(placed.Page);
+			m_Pages[placed.Page].push_back({
+				{ x + placed.Rect[0], y + placed.Rect[1], placed.Rect[2], placed.Rect[3] },
+				{ placed.UV[0], placed.UV[1], placed.UV[2], placed.UV[3] },
+				{ rgba[0], rgba[1], rgba[2], rgba[3] } });
+		}
+	}
+}
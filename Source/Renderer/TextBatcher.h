@@ -0,0 +1,107 @@
+#pragma once
+#include <KTL/String.hpp>
+#include "GlyphAtlas.h"
+#include <string>
+
+namespace render
+{
+	class FontManager;
+
+	/// \brief Lays out every string of a frame into one stream of instanced
+	/// quads, grouped by atlas page so a frame takes one draw per page. Kerning,
+	/// UTF-8 decoding and line breaks run once per string: layouts are cached by
+	/// text, face and size, and only moved and tinted while the atlas keeps
+	/// their glyphs.
+	class K3D_API TextBatcher
+	{
+	public:
+		/// one glyph quad, the vertex shader expands it from the vertex index
+		struct Instance
+		{
+			/// left, top, width, height in pixels
+			float	Rect[4];
+			/// left, top, right, bottom in atlas texture coordinates
+			float	UV[4];
+			/// RGBA in 0..1
+			float	Color[4];
+		};
+
+		/// instances [First, First + Count) sample atlas page Page
+		struct Batch
+		{
+			int		Page;
+			uint32	First;
+			uint32	Count;
+		};
+
+		struct Options
+		{
+			bool	CacheLayouts;
+			/// layouts not drawn for this many frames are dropped
+			uint32	KeepFrames;
+
+			Options()
+				: CacheLayouts(true)
+				, KeepFrames(60)
+			{
+			}
+		};
+
+		struct Stats
+		{
+			uint32	Strings;
+			uint32	LayoutHits;
+			uint32	LayoutMisses;
+			uint32	Instances;
+			uint32	Batches;
+			double	Milliseconds;
+		};
+
+		explicit TextBatcher(FontManager& fonts, Options const& options = Options());
+
+		/// starts a frame, also for the atlas of the font manager
+		void					Begin();
+		/// \param x, y left end of the first baseline, in pixels from the top left
+		/// \param color 0xRRGGBBAA
+		void					AddText(::k3d::String const& text, float x, float y, uint32 color = 0xffffffff);
+		/// groups the instances of the frame into batches
+		void					End();
+
+		uint32					GetNumInstances() const { return m_Stats.Instances; }
+		/// copies GetNumInstances() instances in batch order to 'dst'
+		void					WriteInstances(void* dst) const;
+		std::vector<Batch> const&	GetBatches() const { return m_Batches; }
+		Stats const&			GetStats() const { return m_Stats; }
+
+	private:
+		struct Placed
+		{
+			float	Rect[4];
+			float	UV[4];
+			int		Page;
+		};
+
+		struct Layout
+		{
+			std::string			Text;
+			uint32				Face;
+			int					Size;
+			uint64				Generation;
+			uint64				LastFrame;
+			std::vector<Placed>	Glyphs;
+		};
+
+		void					Build(::k3d::String const& text, Layout& layout);
+		void					Emit(Layout const& layout, float x, float y, uint32 color);
+
+		FontManager&			m_Fonts;
+		Options					m_Options;
+		uint64					m_Frame;
+		std::unordered_map<uint64, Layout>	m_Layouts;
+		Layout					m_Scratch;
+		/// instances of the frame, by page
+		std::vector<std::vector<Instance>>	m_Pages;
+		std::vector<Batch>		m_Batches;
+		Stats					m_Stats;
+	};
+}
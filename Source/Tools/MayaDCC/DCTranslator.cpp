@@ -15,6 +15,7 @@
 #include <maya/MFnSkinCluster.h>
 
 #include <Core/MeshData.h>
+#include <Core/MeshOptimizer.h>
 #include <Core/CameraData.h>
 #include <Core/LogUtil.h>
 
@@ -201,7 +202,7 @@ MS DCTranslator::exportAll()
 			//WriteTheMesh Here
 			if (status == MS::kSuccess)
 			{
-				m_Bundle->Serialize(pMesh.get());
+				m_Bundle->Serialize(std::shared_ptr<MeshData>(std::move(pMesh)));
 				MGlobal::displayInfo("Write Mesh finished...\n");
 			}
 			else {
@@ -273,7 +274,7 @@ MS DCTranslator::exportSelected()
 					//WriteTheMesh Here
 					if (status == MS::kSuccess) 
 					{
-						m_Bundle->Serialize(pMesh.get());
+						m_Bundle->Serialize(std::shared_ptr<MeshData>(std::move(pMesh)));
 						MGlobal::displayInfo("Write Mesh finished.");
 					}
 					else {
@@ -349,6 +350,14 @@ MS DCTranslator::GetMeshFromNode(MDagPath &dagPath, MS &status, MeshData &mesh)
 
 		mesh.SetPrimType(PrimType::TRIANGLES);
 
+		MeshOptimizer::Result result;
+		if (MeshOptimizer::Optimize(mesh, MeshOptimizer::Options(), &result)) {
+			char info[128];
+			snprintf(info, sizeof(info), "vertex cache ACMR %.3f -> %.3f, ATVR %.3f -> %.3f",
+				result.Before.ACMR, result.After.ACMR, result.Before.ATVR, result.After.ATVR);
+			MGlobal::displayInfo(info);
+		}
+
 	}
 
 	if (status != MS::kSuccess) {
@@ -1,4 +0,0 @@
-INCLUDEPATH += $$PWD
-
-SOURCES += $$PWD/NvTriStrip.cpp \
-            $$PWD/NvTriStripObjects.cpp
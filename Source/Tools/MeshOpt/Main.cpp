@@ -0,0 +1,231 @@
+#if WIN32
+#pragma comment(linker, "/SUBSYSTEM:CONSOLE")
+#endif
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include "Kaleido3D.h"
+#include <Core/Os.h>
+#include <Core/LogUtil.h>
+#include <Core/Bundle.h>
+#include <Core/MeshData.h>
+#include <Core/MeshOptimizer.h>
+#include <Core/Meshlet.h>
+#include <Core/MeshSimplifier.h>
+#include <Core/VertexCodec.h>
+using namespace std;
+using namespace k3d;
+
+void PrintUsage()
+{
+  cout << "usage: MeshOpt <input.bundle> <output.bundle> [options]\n"
+          "  --method forsyth|tipsify  vertex cache ordering (tipsify)\n"
+          "  --cache <n>               simulated vertex cache size (16)\n"
+          "  --overdraw <threshold>    ACMR growth allowed for overdraw order, 0 disables (1.05)\n"
+          "  --no-fetch                keep the vertex order\n"
+          "  --meshlets                add the meshlets of every mesh\n"
+          "  --lods <n>                add a chain of up to n LODs to every mesh\n"
+          "  --lod-error <error>       error limit of each LOD step, relative to the mesh size (0.01)\n"
+          "  --quantize                pack the vertices into 16 bit positions, octahedral normals and half uvs\n"
+          "  --compress                store the chunks LZ compressed\n"
+          "meshlets and LODs in the input are rebuilt for the meshes that get reordered\n";
+}
+
+void PrintStats(const char* name, MeshOptimizer::Result const& result)
+{
+  cout << name << ": " << result.Before.NumTriangles << " triangles, ACMR "
+       << result.Before.ACMR << " -> " << result.After.ACMR << ", ATVR "
+       << result.Before.ATVR << " -> " << result.After.ATVR << endl;
+}
+
+int main(int argc, const char* argv[])
+{
+  if (argc < 3) {
+    PrintUsage();
+    return 1;
+  }
+  MeshOptimizer::Options options;
+  MeshLodData::BuildOptions lodOptions;
+  bool compress = false, meshlets = false, quantize = false, lods = false;
+  for (int i = 3; i < argc; i++) {
+    string arg = argv[i];
+    if (arg == "--method" && i + 1 < argc) {
+      string method = argv[++i];
+      options.Method = method == "forsyth" ? MeshOptimizer::ECacheMethod::Forsyth
+                                           : MeshOptimizer::ECacheMethod::Tipsify;
+    } else if (arg == "--cache" && i + 1 < argc) {
+      options.CacheSize = (uint32)stoul(argv[++i]);
+    } else if (arg == "--overdraw" && i + 1 < argc) {
+      options.OverdrawThreshold = stof(argv[++i]);
+    } else if (arg == "--no-fetch") {
+      options.ReorderVertexFetch = false;
+    } else if (arg == "--meshlets") {
+      meshlets = true;
+    } else if (arg == "--lods" && i + 1 < argc) {
+      lodOptions.MaxLods = (uint32)stoul(argv[++i]);
+      lods = lodOptions.MaxLods > 1;
+    } else if (arg == "--lod-error" && i + 1 < argc) {
+      lodOptions.Simplify.TargetError = stof(argv[++i]);
+    } else if (arg == "--quantize") {
+      quantize = true;
+    } else if (arg == "--compress") {
+      compress = true;
+    } else {
+      PrintUsage();
+      return 1;
+    }
+  }
+
+  string input = argv[1], output = argv[2];
+  AssetBundleReader reader;
+  if (!reader.Open(kString(input.begin(), input.end()).c_str())) {
+    KLOG(Fatal, MeshOpt, "Unable to open %s.", argv[1]);
+    return 1;
+  }
+  AssetBundleWriter writer;
+  if (!writer.Open(kString(output.begin(), output.end()).c_str())) {
+    KLOG(Fatal, MeshOpt, "Unable to create %s.", argv[2]);
+    return 1;
+  }
+  if (compress)
+    writer.SetCompression(EChunkCompression::ELZ, LZ::High);
+
+  MeshOptimizer::Result total;
+  memset(&total, 0, sizeof(total));
+  uint32 numMeshlets = 0;
+  uint64 floatBytes = 0, quantizedBytes = 0;
+  vector<SpMesh> meshes;
+  vector<string> meshNames;
+  vector<bool> reordered(reader.GetNumChunks(), false);
+  for (uint32 i = 0; i < reader.GetNumChunks(); i++) {
+    AssetChunkView chunk = reader.GetChunk(i);
+    if (chunk.Type != EAssetType::EMesh)
+      continue;
+    string name(chunk.Name, chunk.NameLength);
+    SpMesh mesh = MeshData::CreateFromChunk(chunk, reader.GetFile());
+    MeshOptimizer::Result result;
+    if (mesh && MeshOptimizer::Optimize(*mesh, options, &result)) {
+      PrintStats(name.c_str(), result);
+      total.Before.NumTriangles += result.Before.NumTriangles;
+      total.Before.NumMisses += result.Before.NumMisses;
+      total.Before.NumVertices += result.Before.NumVertices;
+      total.After.NumMisses += result.After.NumMisses;
+      meshes.push_back(mesh);
+      meshNames.push_back(name);
+      reordered[i] = true;
+    }
+  }
+  // the meshlets and LODs of reordered meshes index the former vertex order,
+  // they are rebuilt instead of copied
+  set<string> staleMeshlets, staleLods, rebuildMeshlets;
+  // LOD chunk name -> number of LODs it had
+  map<string, uint32> rebuildLods;
+  for (auto& name : meshNames) {
+    staleMeshlets.insert(MeshletData::ChunkName(name.c_str()));
+    staleLods.insert(MeshLodData::ChunkName(name.c_str()));
+  }
+  for (uint32 i = 0; i < reader.GetNumChunks(); i++) {
+    if (reordered[i])
+      continue;
+    AssetChunkView chunk = reader.GetChunk(i);
+    string name(chunk.Name, chunk.NameLength);
+    if (chunk.Type == EAssetType::EMeshlets && staleMeshlets.count(name)) {
+      rebuildMeshlets.insert(name);
+      continue;
+    }
+    if (chunk.Type == EAssetType::EMeshLods && staleLods.count(name)) {
+      SpMeshLods former = MeshLodData::CreateFromChunk(chunk);
+      rebuildLods[name] = former ? former->GetLodNum() : lodOptions.MaxLods;
+      continue;
+    }
+    // everything else is copied
+    vector<kByte> data((size_t)chunk.RawSize);
+    if (!AssetBundleReader::Decode(chunk, data.data())) {
+      KLOG(Fatal, MeshOpt, "Chunk %s is corrupted.", name.c_str());
+      return 1;
+    }
+    writer.AddChunk(name.c_str(), chunk.Type, data.data(), data.size());
+  }
+
+  vector<SpMeshLods> chains(meshes.size());
+  if (lods) {
+    auto start = chrono::high_resolution_clock::now();
+    BuildMeshLods(meshes.data(), chains.data(), (uint32)meshes.size(), lodOptions);
+    double ms = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+    for (size_t m = 0; m < meshes.size(); m++) {
+      if (!chains[m])
+        continue;
+      cout << meshNames[m] << ": lods";
+      for (uint32 l = 0; l < chains[m]->GetLodNum(); l++)
+        cout << " " << chains[m]->GetLods()[l].IndexCount / 3 << " (" << chains[m]->GetLods()[l].Error << ")";
+      cout << endl;
+    }
+    cout << "lods of " << meshes.size() << " meshes built in " << ms << " ms" << endl;
+  } else {
+    // rebuilt as deep as they were
+    for (size_t m = 0; m < meshes.size(); m++) {
+      auto former = rebuildLods.find(MeshLodData::ChunkName(meshNames[m].c_str()));
+      if (former == rebuildLods.end())
+        continue;
+      MeshLodData::BuildOptions rebuild = lodOptions;
+      rebuild.MaxLods = former->second;
+      chains[m] = make_shared<MeshLodData>();
+      if (!chains[m]->Build(*meshes[m], rebuild))
+        chains[m] = nullptr;
+    }
+  }
+  for (size_t m = 0; m < meshes.size(); m++) {
+    SpMesh mesh = meshes[m];
+    const char* name = meshNames[m].c_str();
+    // meshlet bounds are computed from the float positions
+    auto clusters = make_shared<MeshletData>();
+    bool hasMeshlets = (meshlets || rebuildMeshlets.count(MeshletData::ChunkName(name))) &&
+                       clusters->Build(*mesh);
+    VertexCodec::Stats stats;
+    if (quantize && VertexCodec::Quantize(*mesh, &stats)) {
+      cout << name << ": vertices " << stats.FloatBytes << " -> " << stats.QuantizedBytes
+           << " bytes, error " << stats.MaxPositionError << ", " << stats.MaxNormalError
+           << " deg, " << stats.MaxUVError << endl;
+      floatBytes += stats.FloatBytes;
+      quantizedBytes += stats.QuantizedBytes;
+    }
+    writer.AddChunk(name, EAssetType::EMesh, [mesh](Archive& archive) {
+      archive << EMeshVersion::VERSION_1_1;
+      archive << *mesh;
+    });
+    if (hasMeshlets) {
+      numMeshlets += clusters->GetMeshletNum();
+      writer.AddChunk(MeshletData::ChunkName(name).c_str(), EAssetType::EMeshlets,
+                      [clusters](Archive& archive) {
+                        archive << EMeshletVersion::VERSION_1_0;
+                        archive << *clusters;
+                      });
+    }
+    SpMeshLods chain = chains[m];
+    if (chain) {
+      writer.AddChunk(MeshLodData::ChunkName(name).c_str(), EAssetType::EMeshLods,
+                      [chain](Archive& archive) {
+                        archive << EMeshLodVersion::VERSION_1_0;
+                        archive << *chain;
+                      });
+    }
+  }
+  if (!writer.Finish())
+    return 1;
+  if (total.Before.NumTriangles) {
+    cout << meshes.size() << " meshes, ACMR "
+         << (float)total.Before.NumMisses / total.Before.NumTriangles << " -> "
+         << (float)total.After.NumMisses / total.Before.NumTriangles << ", ATVR "
+         << (float)total.Before.NumMisses / total.Before.NumVertices << " -> "
+         << (float)total.After.NumMisses / total.Before.NumVertices << endl;
+    if (numMeshlets)
+      cout << numMeshlets << " meshlets" << endl;
+    if (quantizedBytes)
+      cout << "vertices " << floatBytes << " -> " << quantizedBytes << " bytes ("
+           << 100.0 * quantizedBytes / floatBytes << "%)" << endl;
+  }
+  return 0;
+}
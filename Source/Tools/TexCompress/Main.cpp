@@ -0,0 +1,155 @@
+#if WIN32
+#pragma comment(linker, "/SUBSYSTEM:CONSOLE")
+#endif
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "Kaleido3D.h"
+#include <Core/Os.h>
+#include <Core/LogUtil.h>
+#include <Core/Bundle.h>
+#include <Core/ImageData.h>
+#include <Core/MipGenerator.h>
+#include <Core/TextureCompressor.h>
+using namespace std;
+using namespace k3d;
+
+void PrintUsage()
+{
+  cout << "usage: TexCompress <input.bundle> <output.bundle> [options]\n"
+          "  --format bc1|bc3|bc4|bc5|bc7  block format of the 8 bit images (bc7)\n"
+          "  --quality fast|normal|high    encoder effort (normal)\n"
+          "  --mips                        build the mip chain of images without one\n"
+          "  --alpha-threshold <n>         bc1: alpha below n becomes transparent (0)\n"
+          "  --ktx2                        store KTX2 instead of DDS files\n"
+          "  --compress                    store the chunks LZ compressed\n";
+}
+
+/// the SRGB variant of 'format' for sRGB sources
+EImageFormat GetTarget(EImageFormat format, EImageFormat source)
+{
+  bool srgb = source == EImageFormat::RGBA8_SRGB || source == EImageFormat::BGRA8_SRGB;
+  switch (format) {
+  case EImageFormat::BC1_UNORM:
+    return srgb ? EImageFormat::BC1_SRGB : format;
+  case EImageFormat::BC3_UNORM:
+    return srgb ? EImageFormat::BC3_SRGB : format;
+  case EImageFormat::BC7_UNORM:
+    return srgb ? EImageFormat::BC7_SRGB : format;
+  default:
+    return format;
+  }
+}
+
+int main(int argc, const char* argv[])
+{
+  if (argc < 3) {
+    PrintUsage();
+    return 1;
+  }
+  TextureCompressor::Options options;
+  EImageFormat format = EImageFormat::BC7_UNORM;
+  bool compress = false, mips = false, ktx2 = false;
+  for (int i = 3; i < argc; i++) {
+    string arg = argv[i];
+    if (arg == "--format" && i + 1 < argc) {
+      string name = argv[++i];
+      format = name == "bc1" ? EImageFormat::BC1_UNORM
+             : name == "bc3" ? EImageFormat::BC3_UNORM
+             : name == "bc4" ? EImageFormat::BC4_UNORM
+             : name == "bc5" ? EImageFormat::BC5_UNORM
+                             : EImageFormat::BC7_UNORM;
+    } else if (arg == "--quality" && i + 1 < argc) {
+      string quality = argv[++i];
+      options.Quality = quality == "fast"   ? TextureCompressor::EQuality::Fast
+                      : quality == "high"   ? TextureCompressor::EQuality::High
+                                            : TextureCompressor::EQuality::Normal;
+    } else if (arg == "--mips") {
+      mips = true;
+    } else if (arg == "--alpha-threshold" && i + 1 < argc) {
+      const char* value = argv[++i];
+      char* end = nullptr;
+      unsigned long threshold = strtoul(value, &end, 10);
+      if (!isdigit((unsigned char)value[0]) || *end != 0 || threshold > 255) {
+        KLOG(Fatal, TexCompress, "--alpha-threshold takes 0 to 255, not %s.", value);
+        return 1;
+      }
+      options.AlphaThreshold = (uint8)threshold;
+    } else if (arg == "--ktx2") {
+      ktx2 = true;
+    } else if (arg == "--compress") {
+      compress = true;
+    } else {
+      PrintUsage();
+      return 1;
+    }
+  }
+
+  string input = argv[1], output = argv[2];
+  AssetBundleReader reader;
+  if (!reader.Open(kString(input.begin(), input.end()).c_str())) {
+    KLOG(Fatal, TexCompress, "Unable to open %s.", argv[1]);
+    return 1;
+  }
+  AssetBundleWriter writer;
+  if (!writer.Open(kString(output.begin(), output.end()).c_str())) {
+    KLOG(Fatal, TexCompress, "Unable to create %s.", argv[2]);
+    return 1;
+  }
+  if (compress)
+    writer.SetCompression(EChunkCompression::ELZ, LZ::High);
+
+  uint32 numImages = 0;
+  uint64 pixels = 0, bytesBefore = 0, bytesAfter = 0;
+  double ms = 0.0;
+  for (uint32 i = 0; i < reader.GetNumChunks(); i++) {
+    AssetChunkView chunk = reader.GetChunk(i);
+    string name(chunk.Name, chunk.NameLength);
+    auto image = chunk.Type == EAssetType::EImage
+                   ? ImageData::CreateFromChunk(chunk, reader.GetFile())
+                   : nullptr;
+    if (image && TextureCompressor::IsSupportedSource(image->GetFormat())) {
+      if (mips && image->GetMipLevs() == 1 && MipGenerator::IsSupported(image->GetFormat())) {
+        auto chain = MipGenerator::Generate(*image);
+        if (chain)
+          image = chain;
+      }
+      EImageFormat target = GetTarget(format, image->GetFormat());
+      TextureCompressor::Stats stats;
+      auto compressed = TextureCompressor::Compress(*image, target, options, nullptr, &stats);
+      vector<kByte> file;
+      if (compressed && (ktx2 ? compressed->WriteKTX2(file) : compressed->WriteDDS(file))) {
+        cout << name << ": " << image->GetWidth() << "x" << image->GetHeight() << ", "
+             << image->GetMipLevs() << " levels, " << chunk.RawSize << " -> " << file.size()
+             << " bytes, PSNR " << stats.PSNR << " dB, " << stats.Milliseconds << " ms" << endl;
+        writer.AddChunk(name.c_str(), EAssetType::EImage, file.data(), file.size());
+        numImages++;
+        pixels += stats.Blocks * 16;
+        bytesBefore += chunk.RawSize;
+        bytesAfter += file.size();
+        ms += stats.Milliseconds;
+        continue;
+      }
+    }
+    // everything else is copied
+    vector<kByte> data((size_t)chunk.RawSize);
+    if (!AssetBundleReader::Decode(chunk, data.data())) {
+      KLOG(Fatal, TexCompress, "Chunk %s is corrupted.", name.c_str());
+      return 1;
+    }
+    writer.AddChunk(name.c_str(), chunk.Type, data.data(), data.size());
+  }
+  if (!writer.Finish())
+    return 1;
+  if (numImages) {
+    cout << numImages << " images, " << bytesBefore << " -> " << bytesAfter << " bytes, ";
+    // tiny images may take no measurable time
+    if (ms > 0.0)
+      cout << pixels / ms / 1000.0 << " MPix/s ";
+    cout << "with " << TextureCompressor::GetKernel() << endl;
+  }
+  return 0;
+}